@@ -33,6 +33,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 #include <sys/stat.h>
 //#include <unistd.h>
 
@@ -40,6 +41,30 @@
 #include "findTable.h"
 #include "config.h"
 
+#if !defined(_WIN32) && defined(HAVE_UNISTD_H)
+#include <unistd.h>
+#endif
+#if !defined(_WIN32) && defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+#define IMAGE_SUFFIX ".lbt"	/*extension of precompiled table images */
+
+/* The state of the compiler is private to each thread where the 
+* compiler supports it, so that different tables can be compiled at 
+* the same time. Otherwise compilation is serialized. */
+#if defined(_MSC_VER)
+#define THREADLOCAL __declspec (thread)
+#elif defined(__GNUC__) && (defined(_WIN32) || defined(HAVE_PTHREAD_H))
+#define THREADLOCAL __thread
+#endif
+#ifdef THREADLOCAL
+#define PARALLELCOMPILE 1
+#else
+#define THREADLOCAL
+#endif
+
 #define QUOTESUB 28		/*Stand-in for double quotes in strings */
 
 
@@ -142,9 +167,12 @@ outOfMemory ()
 static char dataPath[MAXSTRING];
 static char *dataPathPtr;
 
+static void forgetResolvedTables ();
+
 char *EXPORT_CALL
 lou_setDataPath (char *path)
 {
+  forgetResolvedTables ();
   dataPathPtr = NULL;
   if (path == NULL)
     return NULL;
@@ -178,20 +206,607 @@ typedef struct
 }
 CharsString;
 
-static int errorCount;
-static int warningCount;
-static TranslationTableHeader *table;
-static TranslationTableOffset tableSize;
-static TranslationTableOffset tableUsed;
+static THREADLOCAL int errorCount;
+static THREADLOCAL int warningCount;
+static THREADLOCAL TranslationTableHeader *table;
+static THREADLOCAL unsigned int tableSize;
+static THREADLOCAL unsigned int tableUsed;
+static THREADLOCAL int tableTooLarge;	/*for its offsets, reported once */
+/* Only the built-in rules are compiled so far */
+static THREADLOCAL int freshTable = 0;
 
+/* A file read while compiling a table, and when it was last changed */
 typedef struct
+{
+  char *fileName;
+  time_t modified;
+} SourceFile;
+
+typedef struct louTable
 {
   void *next;
   void *table;
+  void *mapping;		/*image mapped by mapTableImage, if any */
+  size_t mappingSize;
+  SourceFile *files;		/*the table was compiled from, for reloading */
+  int numFiles;
+  double compileTime;		/*seconds taken to compile or map the table */
+  struct louTable *canonical;	/*the entry of the same files under another list */
+  char *fileList;		/*the files the list resolved to, one per line */
+  unsigned long int fileListHash;
+  volatile long references;	/*to the table, or EVICTED */
+  volatile long lastUsed;	/*tableClock when the table was last used */
+  unsigned long int tableListHash;
   int tableListLength;
   char tableList[1];
 } ChainEntry;
-static ChainEntry *tableChain = NULL;
+
+/* Compiled tables are kept in a hash of chains. Entries are only ever 
+* added at the head of a chain, after they are complete, so lookups 
+* need no lock. Changes to the chains and to cached tables are 
+* serialized by compileLock, and so is compilation itself unless 
+* PARALLELCOMPILE is defined. The saved include states are guarded by 
+* includeLock. 
+*
+* A list resolving to the same files as a list already compiled gets an 
+* entry of its own pointing to the canonical entry of those files, so 
+* they share one table. Lists which only begin with the same files 
+* share nothing: the files that follow change the characters and the 
+* heads of the chains of those before them in place, so a table made of 
+* the first files and copied on write would be copied almost whole. 
+* Every use of a table holds a reference to it. 
+* With a cap on the cache, the tables no longer referenced are evicted 
+* least recently used first while the tables together are larger than 
+* the cap. Their entries stay in the chains, marked EVICTED, and the 
+* table is compiled into its entry again when it is next asked for. */
+#define CHAINHASHNUM 61
+#define EVICTED -1
+static ChainEntry *tableChain[CHAINHASHNUM];
+static ChainEntry *lastTrans = NULL;
+static volatile long tableCacheSize = 0;	/*no cap */
+static volatile long tableClock = 0;	/*ticks when another table is used */
+
+/* Changed whenever a table is freed or added to, see getTableGeneration */
+static volatile int tableGeneration;
+
+#if defined(_WIN32)
+#include <windows.h>
+static SRWLOCK compileLock = SRWLOCK_INIT;
+static SRWLOCK includeLock = SRWLOCK_INIT;
+static SRWLOCK resolveLock = SRWLOCK_INIT;
+static SRWLOCK profileLock = SRWLOCK_INIT;
+static SRWLOCK metricsLock = SRWLOCK_INIT;
+#define lockCompiler() AcquireSRWLockExclusive (&compileLock)
+#define unlockCompiler() ReleaseSRWLockExclusive (&compileLock)
+#define lockIncludes() AcquireSRWLockExclusive (&includeLock)
+#define unlockIncludes() ReleaseSRWLockExclusive (&includeLock)
+#define lockResolved() AcquireSRWLockExclusive (&resolveLock)
+#define unlockResolved() ReleaseSRWLockExclusive (&resolveLock)
+#define lockProfiles() AcquireSRWLockExclusive (&profileLock)
+#define unlockProfiles() ReleaseSRWLockExclusive (&profileLock)
+#define lockMetrics() AcquireSRWLockExclusive (&metricsLock)
+#define unlockMetrics() ReleaseSRWLockExclusive (&metricsLock)
+static CONDITION_VARIABLE tableCompiled = CONDITION_VARIABLE_INIT;
+#define waitForTables() \
+  SleepConditionVariableSRW (&tableCompiled, &compileLock, INFINITE, 0)
+#define tablesCompiled() WakeAllConditionVariable (&tableCompiled)
+#elif defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+static pthread_mutex_t compileLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t includeLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t resolveLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t profileLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t metricsLock = PTHREAD_MUTEX_INITIALIZER;
+#define lockCompiler() pthread_mutex_lock (&compileLock)
+#define unlockCompiler() pthread_mutex_unlock (&compileLock)
+#define lockIncludes() pthread_mutex_lock (&includeLock)
+#define unlockIncludes() pthread_mutex_unlock (&includeLock)
+#define lockResolved() pthread_mutex_lock (&resolveLock)
+#define unlockResolved() pthread_mutex_unlock (&resolveLock)
+#define lockProfiles() pthread_mutex_lock (&profileLock)
+#define unlockProfiles() pthread_mutex_unlock (&profileLock)
+#define lockMetrics() pthread_mutex_lock (&metricsLock)
+#define unlockMetrics() pthread_mutex_unlock (&metricsLock)
+static pthread_cond_t tableCompiled = PTHREAD_COND_INITIALIZER;
+#define waitForTables() pthread_cond_wait (&tableCompiled, &compileLock)
+#define tablesCompiled() pthread_cond_broadcast (&tableCompiled)
+#else
+#define lockCompiler()
+#define unlockCompiler()
+#define lockIncludes()
+#define unlockIncludes()
+#define lockResolved()
+#define unlockResolved()
+#define lockProfiles()
+#define unlockProfiles()
+#define lockMetrics()
+#define unlockMetrics()
+#define waitForTables()
+#define tablesCompiled()
+#endif
+
+#ifdef PARALLELCOMPILE
+#define lockCompilation()
+#define unlockCompilation()
+#else
+#define lockCompilation() lockCompiler ()
+#define unlockCompilation() unlockCompiler ()
+#endif
+
+#if defined(__GNUC__)
+#define loadPointer(p) __atomic_load_n (&(p), __ATOMIC_ACQUIRE)
+#define storePointer(p, v) __atomic_store_n (&(p), (v), __ATOMIC_RELEASE)
+#elif defined(_WIN32)
+#define loadPointer(p) \
+  InterlockedCompareExchangePointer ((PVOID volatile *) &(p), NULL, NULL)
+#define storePointer(p, v) \
+  InterlockedExchangePointer ((PVOID volatile *) &(p), (v))
+#else
+#define loadPointer(p) (p)
+#define storePointer(p, v) ((p) = (v))
+#endif
+
+/* The reference counts of cached tables */
+#if defined(__GNUC__)
+#define loadLong(p) __atomic_load_n (&(p), __ATOMIC_ACQUIRE)
+#define storeLong(p, v) __atomic_store_n (&(p), (v), __ATOMIC_RELEASE)
+#define swapLong(p, old, new) \
+  __atomic_compare_exchange_n (&(p), &(old), (new), 0, __ATOMIC_ACQ_REL, \
+			       __ATOMIC_ACQUIRE)
+#elif defined(_WIN32)
+#define loadLong(p) InterlockedCompareExchange (&(p), 0, 0)
+#define storeLong(p, v) InterlockedExchange (&(p), (v))
+#define swapLong(p, old, new) \
+  (InterlockedCompareExchange (&(p), (new), (old)) == (old))
+#else
+#define loadLong(p) (p)
+#define storeLong(p, v) ((p) = (v))
+#define swapLong(p, old, new) ((p) == (old) ? ((p) = (new), 1) : 0)
+#endif
+
+#if defined(__GNUC__)
+#define addLong(p, n) __atomic_add_fetch (&(p), (n), __ATOMIC_ACQ_REL)
+#elif defined(_WIN32)
+#define addLong(p, n) (InterlockedExchangeAdd (&(p), (n)) + (n))
+#else
+#define addLong(p, n) ((p) += (n))
+#endif
+
+double
+currentTime (void)
+{
+#if defined(_WIN32)
+  LARGE_INTEGER count;
+  LARGE_INTEGER frequency;
+  QueryPerformanceCounter (&count);
+  QueryPerformanceFrequency (&frequency);
+  return (double) count.QuadPart / frequency.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+#else
+  return (double) clock () / CLOCKS_PER_SEC;
+#endif
+}
+
+/* Compile profiling. The time since profileMark and the growth of the 
+* table since profileBytes are charged to the current phase, file and 
+* rule family whenever one of them changes. profilePhase is -1 when no 
+* table is being profiled. */
+static THREADLOCAL CompileProfile *compileProfile;
+static THREADLOCAL int profilePhase = -1;
+static THREADLOCAL int profileFile = -1;
+static THREADLOCAL int profileFamily = -1;
+static THREADLOCAL double profileMark;
+static THREADLOCAL unsigned int profileBytes;
+
+void
+profileCompilation (CompileProfile * profile)
+{
+  compileProfile = profile;
+}
+
+void
+freeCompileProfile (CompileProfile * profile)
+{
+  int k;
+  for (k = 0; k < profile->numFiles; k++)
+    free (profile->files[k].fileName);
+  free (profile->files);
+  profile->files = NULL;
+  profile->numFiles = 0;
+}
+
+static void
+profileCharge ()
+{
+  double now = currentTime ();
+  double elapsed = now - profileMark;
+  int bytes = (int) tableUsed - (int) profileBytes;
+  compileProfile->phaseTime[profilePhase] += elapsed;
+  if (profileFile >= 0)
+    {
+      compileProfile->files[profileFile].time += elapsed;
+      compileProfile->files[profileFile].bytes += bytes;
+    }
+  if (profileFamily >= 0)
+    {
+      compileProfile->familyTime[profileFamily] += elapsed;
+      compileProfile->familyBytes[profileFamily] += bytes;
+    }
+  profileMark = now;
+  profileBytes = tableUsed;
+}
+
+static void
+profileStart ()
+{
+  if (!compileProfile)
+    return;
+  profileMark = currentTime ();
+  profileBytes = tableUsed;
+  profilePhase = profileParsing;
+  profileFile = profileFamily = -1;
+}
+
+static void
+profileStop ()
+{
+  if (profilePhase < 0)
+    return;
+  profileCharge ();
+  profilePhase = -1;
+}
+
+static int
+profileSetPhase (int phase)
+{
+  int oldPhase = profilePhase;
+  if (profilePhase < 0)
+    return oldPhase;
+  profileCharge ();
+  profilePhase = phase;
+  return oldPhase;
+}
+
+static int
+profileEnterFile (const char *fileName)
+{
+  int oldFile = profileFile;
+  int k;
+  if (profilePhase < 0)
+    return oldFile;
+  profileCharge ();
+  for (k = 0; k < compileProfile->numFiles; k++)
+    if (strcmp (compileProfile->files[k].fileName, fileName) == 0)
+      break;
+  if (k == compileProfile->numFiles)
+    {
+      if (!(compileProfile->files = realloc (compileProfile->files,
+					     (k + 1) * sizeof (ProfileFile))))
+	outOfMemory ();
+      memset (&compileProfile->files[k], 0, sizeof (ProfileFile));
+      if (!(compileProfile->files[k].fileName = strdup (fileName)))
+	outOfMemory ();
+      compileProfile->numFiles++;
+    }
+  profileFile = k;
+  return oldFile;
+}
+
+static void
+profileLeaveFile (int oldFile)
+{
+  if (profilePhase < 0)
+    return;
+  profileCharge ();
+  profileFile = oldFile;
+}
+
+static void
+profileRule (int family)
+{
+  if (profilePhase < 0)
+    return;
+  profileCharge ();
+  profileFamily = family;
+  if (family < 0)
+    return;
+  compileProfile->familyRules[family]++;
+  if (profileFile >= 0)
+    compileProfile->files[profileFile].rules++;
+}
+
+/* Rule profiling. While ruleProfiling is on, each table used for 
+* forward translation has a RuleProfile in ruleProfiles, counting how 
+* often each rule was tried and applied by the offset of the rule. A 
+* table compiled meanwhile notes in ruleLocations where each of its 
+* rules was found, which its profile then keeps. The offsets of new 
+* rules only grow, except that a dropped duplicate gives its space to 
+* the next rule, so the locations are in order. */
+typedef struct
+{
+  TranslationTableOffset offset;
+  int file;			/*in files of the profile */
+  int line;
+} RuleLocation;
+
+struct RuleProfile
+{
+  struct RuleProfile *next;
+  const TranslationTableHeader *table;
+  unsigned int numSlots;
+  volatile long *counts;	/*tried and applied, two for each offset */
+  double times[RULEPROFILE_TIMES];
+  RuleLocation *locations;
+  int numLocations;
+  char **files;
+  int numFiles;
+};
+
+static volatile int ruleProfiling = 0;
+static RuleProfile *ruleProfiles = NULL;
+static THREADLOCAL int recordingLocations = 0;
+static THREADLOCAL RuleLocation *ruleLocations;
+static THREADLOCAL int numRuleLocations;
+static THREADLOCAL int ruleLocationsSize;
+static THREADLOCAL char **locationFiles;
+static THREADLOCAL int numLocationFiles;
+
+static void
+forgetRuleLocations ()
+{
+  int k;
+  for (k = 0; k < numLocationFiles; k++)
+    free (locationFiles[k]);
+  free (locationFiles);
+  free (ruleLocations);
+  locationFiles = NULL;
+  ruleLocations = NULL;
+  numLocationFiles = numRuleLocations = ruleLocationsSize = 0;
+}
+
+static void
+noteRuleLocation (FileInfo * nested, TranslationTableOffset offset)
+{
+  RuleLocation *location;
+  int file;
+  if (numRuleLocations
+      && ruleLocations[numRuleLocations - 1].offset >= offset)
+    {
+      if (ruleLocations[numRuleLocations - 1].offset > offset)
+	return;
+      numRuleLocations--;
+    }
+  /* Rules made up by the compiler come from no file */
+  if (nested == NULL || nested->fileName == NULL)
+    return;
+  /* Most rules come from the same file as the one before */
+  for (file = numLocationFiles - 1; file >= 0; file--)
+    if (strcmp (locationFiles[file], nested->fileName) == 0)
+      break;
+  if (file < 0)
+    {
+      if (!(locationFiles = realloc (locationFiles, (numLocationFiles + 1)
+				     * sizeof (char *)))
+	  || !(locationFiles[numLocationFiles] = strdup (nested->fileName)))
+	outOfMemory ();
+      file = numLocationFiles++;
+    }
+  if (numRuleLocations == ruleLocationsSize)
+    {
+      ruleLocationsSize = ruleLocationsSize ? 2 * ruleLocationsSize : 256;
+      if (!(ruleLocations = realloc (ruleLocations, ruleLocationsSize
+				     * sizeof (RuleLocation))))
+	outOfMemory ();
+    }
+  location = &ruleLocations[numRuleLocations++];
+  location->offset = offset;
+  location->file = file;
+  location->line = nested->lineNumber;
+}
+
+static RuleProfile *
+findRuleProfile (const TranslationTableHeader * table)
+{
+  RuleProfile *profile;
+  for (profile = loadPointer (ruleProfiles); profile; profile = profile->next)
+    if (profile->table == table)
+      return profile;
+  return NULL;
+}
+
+static RuleProfile *
+newRuleProfile (const TranslationTableHeader * table)
+{
+/* Called with the profiles locked */
+  RuleProfile *profile;
+  if (!(profile = calloc (1, sizeof (RuleProfile))))
+    outOfMemory ();
+  profile->table = table;
+  profile->numSlots = table->tableSize / SLOTSIZE;
+  if (!(profile->counts = calloc (2 * (size_t) profile->numSlots + 2,
+				  sizeof (long))))
+    outOfMemory ();
+  profile->next = ruleProfiles;
+  storePointer (ruleProfiles, profile);
+  return profile;
+}
+
+static void
+freeRuleProfile (RuleProfile * profile)
+{
+  int k;
+  for (k = 0; k < profile->numFiles; k++)
+    free (profile->files[k]);
+  free (profile->files);
+  free (profile->locations);
+  free ((void *) profile->counts);
+  free (profile);
+}
+
+static void
+keepRuleLocations (const TranslationTableHeader * table)
+{
+/* Give the locations noted while compiling table to its profile */
+  RuleProfile *profile;
+  int k;
+  lockProfiles ();
+  if (!(profile = findRuleProfile (table)))
+    profile = newRuleProfile (table);
+  for (k = 0; k < profile->numFiles; k++)
+    free (profile->files[k]);
+  free (profile->files);
+  free (profile->locations);
+  profile->locations = ruleLocations;
+  profile->numLocations = numRuleLocations;
+  profile->files = locationFiles;
+  profile->numFiles = numLocationFiles;
+  unlockProfiles ();
+  ruleLocations = NULL;
+  locationFiles = NULL;
+  numLocationFiles = numRuleLocations = ruleLocationsSize = 0;
+}
+
+static void
+forgetRuleProfile (const TranslationTableHeader * table)
+{
+/* The table is being freed. Nothing can be translating with it. */
+  RuleProfile **link;
+  RuleProfile *profile;
+  lockProfiles ();
+  for (link = &ruleProfiles; (profile = *link); link = &profile->next)
+    if (profile->table == table)
+      {
+	storePointer (*link, profile->next);
+	freeRuleProfile (profile);
+	break;
+      }
+  unlockProfiles ();
+}
+
+static void
+freeRuleProfiles ()
+{
+  RuleProfile *profile;
+  lockProfiles ();
+  while ((profile = ruleProfiles))
+    {
+      ruleProfiles = profile->next;
+      freeRuleProfile (profile);
+    }
+  unlockProfiles ();
+}
+
+RuleProfile *
+getRuleProfile (const TranslationTableHeader * table)
+{
+  RuleProfile *profile;
+  if (!ruleProfiling || table == NULL)
+    return NULL;
+  if ((profile = findRuleProfile (table)))
+    return profile;
+  lockProfiles ();
+  if (!(profile = findRuleProfile (table)))
+    profile = newRuleProfile (table);
+  unlockProfiles ();
+  return profile;
+}
+
+void
+countRule (RuleProfile * profile, const TranslationTableRule * rule,
+	   int applied)
+{
+  const char *start = (const char *) profile->table->ruleArea;
+  unsigned int offset;
+  if ((const char *) rule < start)
+    return;
+  offset = ((const char *) rule - start) / SLOTSIZE;
+  if (offset >= profile->numSlots)
+    return;
+  addLong (profile->counts[2 * offset + (applied != 0)], 1);
+}
+
+void
+addRuleProfileTimes (RuleProfile * profile, const double *times)
+{
+  int k;
+  lockProfiles ();
+  for (k = 0; k < RULEPROFILE_TIMES; k++)
+    profile->times[k] += times[k];
+  unlockProfiles ();
+}
+
+/* The profile set by lou_setRuleOrderProfile, sorted by the name of the 
+* file without its directory and the line */
+typedef struct
+{
+  char *file;
+  int line;
+  unsigned long applied;
+} RuleHeat;
+
+static RuleHeat *ruleOrder = NULL;
+static int numRuleOrder = 0;
+
+static const char *
+baseName (const char *fileName)
+{
+  const char *name = fileName;
+  const char *k;
+  for (k = fileName; *k; k++)
+    if (*k == '/' || *k == '\\')
+      name = k + 1;
+  return name;
+}
+
+static int
+compareRuleHeats (const void *a, const void *b)
+{
+  const RuleHeat *heat1 = a;
+  const RuleHeat *heat2 = b;
+  int cmp = strcmp (heat1->file, heat2->file);
+  return cmp ? cmp : heat1->line - heat2->line;
+}
+
+static void
+freeRuleOrder ()
+{
+  int k;
+  for (k = 0; k < numRuleOrder; k++)
+    free (ruleOrder[k].file);
+  free (ruleOrder);
+  ruleOrder = NULL;
+  numRuleOrder = 0;
+}
+
+static unsigned long
+ruleHeat (TranslationTableOffset offset)
+{
+/* How often the profile says the rule at offset of the table being 
+* compiled was applied, going by where it was found */
+  RuleHeat key;
+  const RuleHeat *heat;
+  int low = 0, high = numRuleLocations - 1, middle;
+  while (low <= high)
+    {
+      middle = (low + high) / 2;
+      if (ruleLocations[middle].offset == offset)
+	break;
+      if (ruleLocations[middle].offset < offset)
+	low = middle + 1;
+      else
+	high = middle - 1;
+    }
+  if (low > high)
+    return 0;
+  key.file = (char *) baseName (locationFiles[ruleLocations[middle].file]);
+  key.line = ruleLocations[middle].line;
+  heat = bsearch (&key, ruleOrder, numRuleOrder, sizeof (RuleHeat),
+		  compareRuleHeats);
+  return heat ? heat->applied : 0;
+}
 
 static const char *characterClassNames[] = {
   "space",
@@ -213,8 +828,8 @@ struct CharacterClass
   widechar length;
   widechar name[1];
 };
-static struct CharacterClass *characterClasses;
-static TranslationTableCharacterAttributes characterClassAttribute;
+static THREADLOCAL struct CharacterClass *characterClasses;
+static THREADLOCAL TranslationTableCharacterAttributes characterClassAttribute;
 
 static const char *opcodeNames[CTO_None] = {
   "include",
@@ -339,22 +954,23 @@ static const char *opcodeNames[CTO_None] = {
   "hyphen",
   "nobreak"
 };
-static short opcodeLengths[CTO_None] = { 0 };
+static THREADLOCAL short opcodeLengths[CTO_None] = { 0 };
 
-static char scratchBuf[MAXSTRING];
+static THREADLOCAL char scratchBuf[MAXSTRING];
 
 char *
-showString (widechar const *chars, int length)
+showStringInBuffer (widechar const *chars, int length, char *buffer,
+		    int bufferSize)
 {
 /*Translate a string of characters to the encoding used in character 
 * operands */
   int charPos;
   int bufPos = 0;
-  scratchBuf[bufPos++] = '\'';
+  buffer[bufPos++] = '\'';
   for (charPos = 0; charPos < length; charPos++)
     {
       if (chars[charPos] >= 32 && chars[charPos] < 127)
-	scratchBuf[bufPos++] = (char) chars[charPos];
+	buffer[bufPos++] = (char) chars[charPos];
       else
 	{
 	  char hexbuf[20];
@@ -388,19 +1004,25 @@ showString (widechar const *chars, int length)
 	      leadingZeros = 0;
 	      break;
 	    }
-	  if ((bufPos + leadingZeros + hexLength + 4) >= sizeof (scratchBuf))
+	  if ((bufPos + leadingZeros + hexLength + 4) >= bufferSize)
 	    break;
-	  scratchBuf[bufPos++] = '\\';
-	  scratchBuf[bufPos++] = escapeLetter;
+	  buffer[bufPos++] = '\\';
+	  buffer[bufPos++] = escapeLetter;
 	  for (hexPos = 0; hexPos < leadingZeros; hexPos++)
-	    scratchBuf[bufPos++] = '0';
+	    buffer[bufPos++] = '0';
 	  for (hexPos = 0; hexPos < hexLength; hexPos++)
-	    scratchBuf[bufPos++] = hexbuf[hexPos];
+	    buffer[bufPos++] = hexbuf[hexPos];
 	}
     }
-  scratchBuf[bufPos++] = '\'';
-  scratchBuf[bufPos] = 0;
-  return scratchBuf;
+  buffer[bufPos++] = '\'';
+  buffer[bufPos] = 0;
+  return buffer;
+}
+
+char *
+showString (widechar const *chars, int length)
+{
+  return showStringInBuffer (chars, length, scratchBuf, sizeof (scratchBuf));
 }
 
 char *
@@ -490,20 +1112,60 @@ showAttributes (TranslationTableCharacterAttributes a)
 
 static void compileError (FileInfo * nested, char *format, ...);
 
+static int
+getAByte (FileInfo * nested)
+{
+/*Return the next byte of the file, which is read a block at a time */
+  if (nested->bufferPos >= nested->bufferLength)
+    {
+      nested->bufferPos = 0;
+      nested->bufferLength =
+	fread (nested->buffer, 1, sizeof (nested->buffer), nested->in);
+      if (nested->bufferLength <= 0)
+	{
+	  nested->bufferLength = 0;
+	  return EOF;
+	}
+    }
+  return nested->buffer[nested->bufferPos++];
+}
+
 static int
 getAChar (FileInfo * nested)
 {
 /*Read a big endian, little *ndian or ASCII 8 file and convert it to 
-* 16- or 32-bit unsigned integers */
+* 16- or 32-bit unsigned integers. UTF-8 files are read like ASCII 8 
+* ones and decoded by parseChars. */
   int ch1 = 0, ch2 = 0;
   widechar character;
+  if (nested->status > 2)
+    /* The encoding is known */
+    switch (nested->encoding)
+      {
+      case ascii8:
+	return getAByte (nested);
+      case bigEndian:
+	if ((ch1 = getAByte (nested)) == EOF
+	    || (ch2 = getAByte (nested)) == EOF)
+	  return EOF;
+	character = (ch1 << 8) | ch2;
+	return (int) character;
+      case littleEndian:
+	if ((ch1 = getAByte (nested)) == EOF
+	    || (ch2 = getAByte (nested)) == EOF)
+	  return EOF;
+	character = (ch2 << 8) | ch1;
+	return (int) character;
+      default:
+	break;
+      }
   if (nested->encoding == ascii8)
     if (nested->status == 2)
       {
 	nested->status++;
 	return nested->checkencoding[1];
       }
-  while ((ch1 = fgetc (nested->in)) != EOF)
+  while ((ch1 = getAByte (nested)) != EOF)
     {
       if (nested->status < 2)
 	nested->checkencoding[nested->status] = ch1;
@@ -522,10 +1184,18 @@ getAChar (FileInfo * nested)
 	      nested->encoding = ascii8;
 	      return nested->checkencoding[0];
 	    }
+	  else if (nested->checkencoding[0] == 0xef
+		   && nested->checkencoding[1] == 0xbb
+		   && getAByte (nested) == 0xbf)
+	    {
+	      /* Skip the UTF-8 byte order mark */
+	      nested->encoding = ascii8;
+	      nested->status++;
+	    }
 	  else
 	    {
 	      compileError (nested,
-			    "encoding is neither big-endian, little-endian nor ASCII 8.");
+			    "encoding is neither big-endian, little-endian, UTF-8 nor ASCII 8.");
 	      ch1 = EOF;
 	      break;;
 	    }
@@ -539,14 +1209,14 @@ getAChar (FileInfo * nested)
 	  return ch1;
 	  break;
 	case bigEndian:
-	  ch2 = fgetc (nested->in);
+	  ch2 = getAByte (nested);
 	  if (ch2 == EOF)
 	    break;
 	  character = (ch1 << 8) | ch2;
 	  return (int) character;
 	  break;
 	case littleEndian:
-	  ch2 = fgetc (nested->in);
+	  ch2 = getAByte (nested);
 	  if (ch2 == EOF)
 	    break;
 	  character = (ch2 << 8) | ch1;
@@ -565,6 +1235,7 @@ getALine (FileInfo * nested)
 /*Read a line of widechar's from an input file */
   int ch;
   int pch = 0;
+  int phase = profileSetPhase (profileReading);
   nested->linelen = 0;
   while ((ch = getAChar (nested)) != EOF)
     {
@@ -582,13 +1253,14 @@ getALine (FileInfo * nested)
     }
   nested->line[nested->linelen] = 0;
   nested->linepos = 0;
+  profileSetPhase (phase);
   if (ch == EOF)
     return 0;
   nested->lineNumber++;
   return 1;
 }
 
-static int lastToken;
+static THREADLOCAL int lastToken;
 static int
 getToken (FileInfo * nested, CharsString * result, const char *description)
 {
@@ -674,68 +1346,208 @@ compileWarning (FileInfo * nested, char *format, ...)
 #endif
 }
 
-static int
-allocateSpaceInTable (FileInfo * nested, TranslationTableOffset * offset,
-		      int count)
+/* While a table is compiled it lives in an arena: a range of address 
+* space reserved up front and committed ARENACHUNK bytes at a time as 
+* the table grows, so that it never moves and is never copied. When 
+* compilation is finished finishTable copies it once into a block of 
+* exactly the size used. Where no address space can be reserved, or the 
+* table outgrows it, the table is grown with realloc instead. */
+#define ARENARESERVE (256 * 1024 * 1024)
+#define ARENACHUNK (64 * 1024)
+static THREADLOCAL int tableInArena;
+static THREADLOCAL int duplicateRules;	/*dropped by dropDuplicateRule */
+static THREADLOCAL int duplicateRuleBytes;
+
+#if defined(_WIN32) || (defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H))
+#if !defined(_WIN32) && !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+static void *
+reserveArena ()
 {
-/* allocate memory for translation table and expand previously allocated 
-* memory if necessary */
-  int spaceNeeded = ((count + OFFSETSIZE - 1) / OFFSETSIZE) * OFFSETSIZE;
-  TranslationTableOffset size = tableUsed + spaceNeeded;
-  if (size > tableSize)
-    {
-      void *newTable;
-      size += (size / OFFSETSIZE);
-      newTable = realloc (table, size);
-      if (!newTable)
-	{
-	  compileError (nested, "Not enough memory for translation table.");
-	  outOfMemory ();
-	}
-      memset (((unsigned char *) newTable) + tableSize, 0, size - tableSize);
-      /* update references to the old table */
-      {
-	ChainEntry *entry;
-	for (entry = tableChain; entry != NULL; entry = entry->next)
-	  if (entry->table == table)
-	    entry->table = (TranslationTableHeader *) newTable;
-      }
-      table = (TranslationTableHeader *) newTable;
-      tableSize = size;
-    }
-  if (offset != NULL)
-    {
-      *offset = (tableUsed - sizeof (*table)) / OFFSETSIZE;
-      tableUsed += spaceNeeded;
-    }
-  return 1;
+#ifdef _WIN32
+  return VirtualAlloc (NULL, ARENARESERVE, MEM_RESERVE, PAGE_NOACCESS);
+#else
+  void *arena = mmap (NULL, ARENARESERVE, PROT_NONE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return arena == MAP_FAILED ? NULL : arena;
+#endif
 }
 
 static int
-reserveSpaceInTable (FileInfo * nested, int count)
+commitArena (void *arena, size_t size)
 {
-  return (allocateSpaceInTable (nested, NULL, count));
+#ifdef _WIN32
+  return VirtualAlloc (arena, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+  return mprotect (arena, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+static void
+releaseArena (void *arena)
+{
+#ifdef _WIN32
+  VirtualFree (arena, 0, MEM_RELEASE);
+#else
+  munmap (arena, ARENARESERVE);
+#endif
 }
 
+#else
+#define reserveArena() NULL
+#define commitArena(arena, size) 0
+#define releaseArena(arena)
+#endif
+
 static int
-allocateHeader (FileInfo * nested)
+growTableArena (unsigned int size)
+{
+/* Commit enough of the arena for size bytes. Fresh pages are zero. */
+  size_t committed;
+  if (size > ARENARESERVE)
+    return 0;
+  committed = ((size + ARENACHUNK - 1) / ARENACHUNK) * ARENACHUNK;
+  if (committed > ARENARESERVE)
+    committed = ARENARESERVE;
+  if (!commitArena (table, committed))
+    return 0;
+  tableSize = committed;
+  return 1;
+}
+
+static void
+allocateTable (unsigned int size)
+{
+/* Start a new zeroed table of at least size bytes */
+  tableInArena = 0;
+  if ((table = reserveArena ()))
+    {
+      tableInArena = 1;
+      if (growTableArena (size))
+	return;
+      releaseArena (table);
+      tableInArena = 0;
+    }
+  if (!(table = calloc (size, 1)))
+    outOfMemory ();
+  tableSize = size;
+}
+
+static void
+discardTable ()
+{
+  if (tableInArena)
+    releaseArena (table);
+  else
+    free (table);
+  tableInArena = 0;
+  table = NULL;
+}
+
+static void *
+moveTableOutOfArena (unsigned int size)
+{
+  void *newTable = malloc (size);
+  if (newTable)
+    {
+      memcpy (newTable, table, tableSize);
+      releaseArena (table);
+      tableInArena = 0;
+    }
+  return newTable;
+}
+
+static void
+finishTable ()
+{
+/* Copy the table out of the arena, or trim it, to the size used */
+  void *trimmed;
+  logMessage (LOG_DEBUG, "%d duplicate rules dropped, saving %d bytes; "
+	      "%d unused bytes trimmed", duplicateRules, duplicateRuleBytes,
+	      tableSize - tableUsed);
+  if (tableInArena)
+    {
+      tableSize = tableUsed;
+      if (!(trimmed = moveTableOutOfArena (tableUsed)))
+	outOfMemory ();
+      table = trimmed;
+    }
+  else if (tableSize > tableUsed && (trimmed = realloc (table, tableUsed)))
+    table = trimmed;
+  tableSize = tableUsed;
+}
+
+static int
+allocateSpaceInTable (FileInfo * nested, TranslationTableOffset * offset,
+		      int count)
+{
+/* allocate memory for translation table and expand previously allocated 
+* memory if necessary */
+  int spaceNeeded = ((count + SLOTSIZE - 1) / SLOTSIZE) * SLOTSIZE;
+  unsigned int size = tableUsed + spaceNeeded;
+  if (offset != NULL
+      && (size - sizeof (*table)) / SLOTSIZE > MAXTABLEOFFSET)
+    {
+      if (!tableTooLarge)
+	compileError (nested, "Table too large for %d-bit offsets.",
+		      OFFSETBITS);
+      tableTooLarge = 1;
+      return 0;
+    }
+  if (size > tableSize && !(tableInArena && growTableArena (size)))
+    {
+      void *newTable;
+      size += (size / SLOTSIZE);
+      if (tableInArena)
+	newTable = moveTableOutOfArena (size);
+      else
+	newTable = realloc (table, size);
+      if (!newTable)
+	{
+	  compileError (nested, "Not enough memory for translation table.");
+	  outOfMemory ();
+	}
+      memset (((unsigned char *) newTable) + tableSize, 0, size - tableSize);
+      /* update references to the old table */
+      {
+	ChainEntry *entry;
+	int bucket;
+	for (bucket = 0; bucket < CHAINHASHNUM; bucket++)
+	  for (entry = loadPointer (tableChain[bucket]); entry != NULL;
+	       entry = entry->next)
+	    if (loadPointer (entry->table) == table)
+	      storePointer (entry->table, newTable);
+      }
+      table = (TranslationTableHeader *) newTable;
+      tableSize = size;
+    }
+  if (offset != NULL)
+    {
+      *offset = (tableUsed - sizeof (*table)) / SLOTSIZE;
+      tableUsed += spaceNeeded;
+    }
+  return 1;
+}
+
+static int
+reserveSpaceInTable (FileInfo * nested, int count)
+{
+  return (allocateSpaceInTable (nested, NULL, count));
+}
+
+static int
+allocateHeader (FileInfo * nested)
 {
 /*Allocate memory for the table header and a guess on the number of 
 * rules */
-  const TranslationTableOffset startSize = 2 * sizeof (*table);
+  const unsigned int startSize = 2 * sizeof (*table);
   if (table)
     return 1;
-  tableUsed = sizeof (*table) + OFFSETSIZE;	/*So no offset is ever zero */
-  if (!(table = malloc (startSize)))
-    {
-      compileError (nested, "Not enough memory");
-      if (table != NULL)
-	free (table);
-      table = NULL;
-      outOfMemory ();
-    }
-  memset (table, 0, startSize);
-  tableSize = startSize;
+  tableUsed = sizeof (*table) + SLOTSIZE;	/*So no offset is ever zero */
+  tableTooLarge = 0;
+  allocateTable (startSize);
   return 1;
 }
 
@@ -748,6 +1560,42 @@ stringHash (const widechar * c)
   return (int) makeHash;
 }
 
+static TranslationTableOffset *
+forRuleChains (int *count)
+{
+/* The forRules chains of the table being compiled, which are in the 
+* header until buildForRuleBuckets spreads them over a number of chains 
+* that suits the table. */
+  if (table->forRuleBuckets)
+    {
+      *count = 1 << table->forRuleHashBits;
+      return OFFSETARRAY (table->ruleArea, table->forRuleBuckets);
+    }
+  *count = HASHNUM;
+  return table->forRules;
+}
+
+static TranslationTableOffset *
+forRuleChain (const widechar * c)
+{
+/*The forRules chain of a rule beginning with the characters at c */
+  int count;
+  TranslationTableOffset *chains = forRuleChains (&count);
+  if (table->forRuleBuckets)
+    return &chains[FORRULEHASH (c[0], c[1], table->forRuleHashBits)];
+  return &chains[stringHash (c)];
+}
+
+TranslationTableOffset
+findForRules (const TranslationTableHeader * table, widechar c1, widechar c2)
+{
+  if (table->forRuleBuckets)
+    return OFFSETARRAY (table->ruleArea, table->forRuleBuckets)
+      [FORRULEHASH (c1, c2, table->forRuleHashBits)];
+  return table->forRules[(((unsigned long int) c1 << 8) +
+			  (unsigned long int) c2) % HASHNUM];
+}
+
 int
 charHash (widechar c)
 {
@@ -755,6 +1603,18 @@ charHash (widechar c)
   return (int) makeHash;
 }
 
+int
+wordIndexSlot (unsigned int hash, unsigned int displacement, int numWords)
+{
+  unsigned int mixed = hash ^ (displacement * 0x9e3779b1U);
+  mixed ^= mixed >> 16;
+  mixed *= 0x85ebca6bU;
+  mixed ^= mixed >> 13;
+  mixed *= 0xc2b2ae35U;
+  mixed ^= mixed >> 16;
+  return (int) (mixed % (unsigned int) numWords);
+}
+
 static TranslationTableCharacter *
 compile_findCharOrDots (widechar c, int m)
 {
@@ -779,9 +1639,14 @@ compile_findCharOrDots (widechar c, int m)
   return NULL;
 }
 
-static TranslationTableCharacter noChar = { 0, 0, 0, CTC_Space, 32, 32, 32 };
+static TranslationTableCharacter noChar =
+  { 0, 0, 0, CTC_Space, 32, 32, 32, 0 };
 static TranslationTableCharacter noDots =
-  { 0, 0, 0, CTC_Space, B16, B16, B16 };
+  { 0, 0, 0, CTC_Space, B16, B16, B16, 0 };
+static THREADLOCAL TranslationTableCharacter noRoom;	/*given by 
+							   addCharOrDots 
+							   once the table 
+							   is too large */
 static char *unknownDots (widechar dots);
 
 static TranslationTableCharacter *
@@ -822,7 +1687,12 @@ addCharOrDots (FileInfo * nested, widechar c, int m)
   if ((character = compile_findCharOrDots (c, m)))
     return character;
   if (!allocateSpaceInTable (nested, &offset, sizeof (*character)))
-    return NULL;
+    {
+      /* The table will not be used, but the caller still wants 
+       * somewhere to put the character */
+      memset (&noRoom, 0, sizeof (noRoom));
+      return &noRoom;
+    }
   character = (TranslationTableCharacter *) & table->ruleArea[offset];
   memset (character, 0, sizeof (*character));
   character->realchar = c;
@@ -850,7 +1720,8 @@ addCharOrDots (FileInfo * nested, widechar c, int m)
 }
 
 static CharOrDots *
-getCharOrDots (widechar c, int m)
+getCharOrDotsInTable (const TranslationTableHeader * table, widechar c,
+		      int m)
 {
   CharOrDots *cdPtr;
   TranslationTableOffset bucket;
@@ -869,24 +1740,185 @@ getCharOrDots (widechar c, int m)
   return NULL;
 }
 
+static CharOrDots *
+getCharOrDots (widechar c, int m)
+{
+  return getCharOrDotsInTable (table, c, m);
+}
+
+static TranslationTableSlot
+lookUpDisplayIndex (const TranslationTableHeader * table,
+		    TranslationTableOffset index, widechar c)
+{
+  TranslationTableOffset page =
+    table->ruleArea[index + (unsigned long int) c / CHARINDEXPAGE];
+  if (!page)
+    return 0;
+  return table->ruleArea[page + (unsigned long int) c % CHARINDEXPAGE];
+}
+
 widechar
-getDotsForChar (widechar c)
+getDotsForCharInTable (const TranslationTableHeader * table, widechar c)
 {
-  CharOrDots *cdPtr = getCharOrDots (c, 0);
-  if (cdPtr)
+  CharOrDots *cdPtr;
+  TranslationTableSlot found;
+  if (table->charToDotsIndex && INCHARINDEX (c))
+    {
+      if ((found = lookUpDisplayIndex (table, table->charToDotsIndex, c)))
+	return found - 1;
+      return B16;
+    }
+  if ((cdPtr = getCharOrDotsInTable (table, c, 0)))
     return cdPtr->found;
   return B16;
 }
 
 widechar
-getCharFromDots (widechar d)
+getCharFromDotsInTable (const TranslationTableHeader * table, widechar d)
 {
-  CharOrDots *cdPtr = getCharOrDots (d, 1);
-  if (cdPtr)
+  CharOrDots *cdPtr;
+  TranslationTableSlot found;
+  if (table->dotsToCharIndex && INCHARINDEX (d))
+    {
+      if ((found = lookUpDisplayIndex (table, table->dotsToCharIndex, d)))
+	return found - 1;
+      return ' ';
+    }
+  if ((cdPtr = getCharOrDotsInTable (table, d, 1)))
     return cdPtr->found;
   return ' ';
 }
 
+static void
+convertWithDisplayIndex (const TranslationTableHeader * table,
+			 TranslationTableOffset index, int m,
+			 const widechar * inbuf, widechar * outbuf,
+			 int length)
+{
+/* Look each of inbuf up in the index of charToDots (m = 0) or dotsToChar 
+* (m = 1). Text and braille mostly stay in one page, so the page of the 
+* last lookup is kept. */
+  const TranslationTableSlot *page = NULL;
+  unsigned long int pageNum = CHARINDEXSIZE;
+  unsigned long int c;
+  widechar missing = m ? ' ' : B16;
+  int k;
+  for (k = 0; k < length; k++)
+    {
+      c = inbuf[k];
+      if (m && !(c & B16) && (c & 0xff00) == 0x2800)	/*Unicode braille */
+	c = (c & 0x00ff) | B16;
+      if (c / CHARINDEXPAGE != pageNum)
+	{
+	  if (c >= CHARINDEXSIZE)
+	    {
+	      outbuf[k] = m ? getCharFromDotsInTable (table, c) :
+		getDotsForCharInTable (table, c);
+	      continue;
+	    }
+	  pageNum = c / CHARINDEXPAGE;
+	  page = table->ruleArea[index + pageNum] ?
+	    &table->ruleArea[table->ruleArea[index + pageNum]] : NULL;
+	}
+      if (page && page[c % CHARINDEXPAGE])
+	outbuf[k] = page[c % CHARINDEXPAGE] - 1;
+      else
+	outbuf[k] = missing;
+    }
+}
+
+void
+getDotsForCharsInTable (const TranslationTableHeader * table,
+			const widechar * chars, widechar * dots, int length)
+{
+  int k;
+  if (table->charToDotsIndex)
+    convertWithDisplayIndex (table, table->charToDotsIndex, 0, chars, dots,
+			     length);
+  else
+    for (k = 0; k < length; k++)
+      dots[k] = getDotsForCharInTable (table, chars[k]);
+}
+
+void
+getCharsFromDotsInTable (const TranslationTableHeader * table,
+			 const widechar * dots, widechar * chars, int length)
+{
+  int k;
+  widechar d;
+  if (table->dotsToCharIndex)
+    convertWithDisplayIndex (table, table->dotsToCharIndex, 1, dots, chars,
+			     length);
+  else
+    for (k = 0; k < length; k++)
+      {
+	d = dots[k];
+	if (!(d & B16) && (d & 0xff00) == 0x2800)	/*Unicode braille */
+	  d = (d & 0x00ff) | B16;
+	chars[k] = getCharFromDotsInTable (table, d);
+      }
+}
+
+static const TranslationTableHeader *
+lastTable ()
+{
+  ChainEntry *entry = loadPointer (lastTrans);
+  const TranslationTableHeader *last;
+  /* The table may have been evicted since */
+  if (entry == NULL || !(last = loadPointer (entry->table)))
+    return table;
+  return last;
+}
+
+widechar
+getDotsForChar (widechar c)
+{
+  return getDotsForCharInTable (lastTable (), c);
+}
+
+widechar
+getCharFromDots (widechar d)
+{
+  return getCharFromDotsInTable (lastTable (), d);
+}
+
+static int
+putDisplayIndex (FileInfo * nested, int m, widechar c, widechar found)
+{
+/* Enter found for c in the index of charToDots (m = 0) or dotsToChar 
+* (m = 1), making the index or its page if need be. Like the chains, the 
+* index is made as the table is compiled, so it is never out of date. 
+* Its entries are slots, as found + 1 may not fit in an offset. */
+  TranslationTableOffset index = m ? table->dotsToCharIndex :
+    table->charToDotsIndex;
+  TranslationTableOffset page;
+  if (!INCHARINDEX (c))
+    return 1;
+  if (!index)
+    {
+      if (!allocateSpaceInTable (nested, &index,
+				 (CHARINDEXSIZE / CHARINDEXPAGE) *
+				 SLOTSIZE))
+	return 0;
+      memset (&table->ruleArea[index], 0,
+	      (CHARINDEXSIZE / CHARINDEXPAGE) * SLOTSIZE);
+      if (m)
+	table->dotsToCharIndex = index;
+      else
+	table->charToDotsIndex = index;
+    }
+  if (!(page = table->ruleArea[index + (unsigned long int) c /
+			       CHARINDEXPAGE]))
+    {
+      if (!allocateSpaceInTable (nested, &page, CHARINDEXPAGE * SLOTSIZE))
+	return 0;
+      memset (&table->ruleArea[page], 0, CHARINDEXPAGE * SLOTSIZE);
+      table->ruleArea[index + (unsigned long int) c / CHARINDEXPAGE] = page;
+    }
+  table->ruleArea[page + (unsigned long int) c % CHARINDEXPAGE] = found + 1;
+  return 1;
+}
+
 static int
 putCharAndDots (FileInfo * nested, widechar c, widechar d)
 {
@@ -914,6 +1946,8 @@ putCharAndDots (FileInfo * nested, widechar c, widechar d)
 	    oldcdPtr = (CharOrDots *) & table->ruleArea[oldcdPtr->next];
 	  oldcdPtr->next = offset;
 	}
+      if (!putDisplayIndex (nested, 0, c, d))
+	return 0;
     }
   if (!(cdPtr = getCharOrDots (d, 1)))
     {
@@ -934,6 +1968,8 @@ putCharAndDots (FileInfo * nested, widechar c, widechar d)
 	    oldcdPtr = (CharOrDots *) & table->ruleArea[oldcdPtr->next];
 	  oldcdPtr->next = offset;
 	}
+      if (!putDisplayIndex (nested, 1, d, c))
+	return 0;
     }
   return 1;
 }
@@ -942,7 +1978,7 @@ static char *
 unknownDots (widechar dots)
 {
 /*Print out dot numbers */
-  static char buffer[20];
+  static THREADLOCAL char buffer[20];
   int k = 1;
   buffer[0] = '\\';
   if ((dots & B1))
@@ -980,8 +2016,8 @@ unknownDots (widechar dots)
   return buffer;
 }
 
-static TranslationTableOffset newRuleOffset = 0;
-static TranslationTableRule *newRule = NULL;
+static THREADLOCAL TranslationTableOffset newRuleOffset = 0;
+static THREADLOCAL TranslationTableRule *newRule = NULL;
 
 static int
 charactersDefined (FileInfo * nested)
@@ -1021,8 +2057,76 @@ charactersDefined (FileInfo * nested)
   return noErrors;
 }
 
-static int noback = 0;
-static int nofor = 0;
+static THREADLOCAL int noback = 0;
+static THREADLOCAL int nofor = 0;
+static THREADLOCAL TranslationTableOffset *newRuleChains[2];	/*the new 
+								   rule was linked into */
+static THREADLOCAL TranslationTableCharacter *newRuleCharacters[2];
+static THREADLOCAL int newRuleDeferred;	/*not linked backward yet */
+static THREADLOCAL int forRulesLinked;	/*rules added to forRules */
+static THREADLOCAL int passRulesLinked;	/*multipass rules added */
+static THREADLOCAL int backRulesLinked;	/*rules added to backRules */
+
+/* Parts of a table left out until they are first used, see 
+* lou_setLazyCompilation. The backward rules for more than one cell are 
+* recorded in the order they were added, so that linking them later 
+* gives the same chains. Those for one cell share their chains with some 
+* forward rules, and are linked at once. */
+static int lazyCompilation = 0;
+static THREADLOCAL int lazyParts;	/*of the table being compiled */
+static THREADLOCAL TranslationTableOffset *deferredBackRules;
+static THREADLOCAL int numDeferredBackRules;
+static THREADLOCAL int maxDeferredBackRules;
+static THREADLOCAL char *deferredHyphenation;	/*file name of the 
+						   patterns */
+
+static void
+deferBackRule ()
+{
+  if (numDeferredBackRules >= maxDeferredBackRules)
+    {
+      TranslationTableOffset *more;
+      maxDeferredBackRules = maxDeferredBackRules ?
+	2 * maxDeferredBackRules : 1024;
+      if (!(more = realloc (deferredBackRules, maxDeferredBackRules *
+			    sizeof (*deferredBackRules))))
+	outOfMemory ();
+      deferredBackRules = more;
+    }
+  deferredBackRules[numDeferredBackRules++] = newRuleOffset;
+}
+
+static void
+forgetDeferredParts ()
+{
+  numDeferredBackRules = 0;
+  free (deferredHyphenation);
+  deferredHyphenation = NULL;
+}
+
+static void
+storeDeferredParts ()
+{
+/* Record in the table what was left out of it */
+  TranslationTableOffset offset;
+  int length;
+  if (numDeferredBackRules && allocateSpaceInTable (NULL, &offset,
+						    numDeferredBackRules *
+						    OFFSETSIZE))
+    {
+      memcpy (&table->ruleArea[offset], deferredBackRules,
+	      numDeferredBackRules * OFFSETSIZE);
+      table->lazyBackRules = offset;
+      table->numLazyBackRules = numDeferredBackRules;
+    }
+  length = deferredHyphenation ? strlen (deferredHyphenation) + 1 : 0;
+  if (length && allocateSpaceInTable (NULL, &offset, length))
+    {
+      memcpy (&table->ruleArea[offset], deferredHyphenation, length);
+      table->lazyHyphenation = offset;
+    }
+  forgetDeferredParts ();
+}
 
 /*The following functions are 
 called by addRule to handle various 
@@ -1052,7 +2156,8 @@ add_0_single (FileInfo * nested)
     }
   if (newRule->opcode >= CTO_Space && newRule->opcode < CTO_UpLow)
     character->definitionRule = newRuleOffset;
-  currentOffsetPtr = &character->otherRules;
+  newRuleCharacters[0] = character;
+  currentOffsetPtr = newRuleChains[0] = &character->otherRules;
   while (*currentOffsetPtr)
     {
       currentRule = (TranslationTableRule *)
@@ -1074,7 +2179,9 @@ add_0_multiple ()
 /*direction = 0 newRule->charslen > 1*/
   TranslationTableRule *currentRule = NULL;
   TranslationTableOffset *currentOffsetPtr =
-    &table->forRules[stringHash (&newRule->charsdots[0])];
+    forRuleChain (&newRule->charsdots[0]);
+  newRuleChains[0] = currentOffsetPtr;
+  forRulesLinked++;
   while (*currentOffsetPtr)
     {
       currentRule = (TranslationTableRule *)
@@ -1108,7 +2215,8 @@ add_1_single (FileInfo * nested)
   dots = definedCharOrDots (nested, newRule->charsdots[newRule->charslen], 1);
   if (newRule->opcode >= CTO_Space && newRule->opcode < CTO_UpLow)
     dots->definitionRule = newRuleOffset;
-  currentOffsetPtr = &dots->otherRules;
+  newRuleCharacters[1] = dots;
+  currentOffsetPtr = newRuleChains[1] = &dots->otherRules;
   while (*currentOffsetPtr)
     {
       currentRule = (TranslationTableRule *)
@@ -1138,6 +2246,8 @@ add_1_multiple ()
   if (newRule->opcode == CTO_NoBreak || newRule->opcode == CTO_SwapCc ||
       (newRule->opcode >= CTO_Context && newRule->opcode <= CTO_Pass4))
     return;
+  backRulesLinked++;
+  newRuleChains[1] = currentOffsetPtr;
   while (*currentOffsetPtr)
     {
       int currentLength;
@@ -1199,6 +2309,82 @@ addPassRule (FileInfo * nested)
   return 1;
 }
 
+static int
+sameAsNewRule (const TranslationTableRule * rule)
+{
+  return rule->opcode == newRule->opcode && rule->after == newRule->after
+    && rule->before == newRule->before
+    && rule->charslen == newRule->charslen
+    && rule->dotslen == newRule->dotslen
+    && memcmp (rule->charsdots, newRule->charsdots,
+	       CHARSIZE * (rule->charslen + rule->dotslen)) == 0;
+}
+
+static TranslationTableOffset
+findEarlierSameRule (TranslationTableOffset offset, int direction)
+{
+/* Find a rule with the same contents ahead of the new rule in a chain */
+  TranslationTableRule *currentRule;
+  while (offset != newRuleOffset)
+    {
+      currentRule = (TranslationTableRule *) & table->ruleArea[offset];
+      if (sameAsNewRule (currentRule))
+	return offset;
+      offset = direction ? currentRule->dotsnext : currentRule->charsnext;
+    }
+  return 0;
+}
+
+static void
+unlinkNewRule (TranslationTableOffset * offsetPtr, int direction)
+{
+  TranslationTableRule *currentRule;
+  while (*offsetPtr != newRuleOffset)
+    {
+      currentRule = (TranslationTableRule *) & table->ruleArea[*offsetPtr];
+      offsetPtr = direction ? &currentRule->dotsnext :
+	&currentRule->charsnext;
+    }
+  *offsetPtr = direction ? newRule->dotsnext : newRule->charsnext;
+}
+
+static void
+dropDuplicateRule (int ruleSize)
+{
+/* Rules in a chain are tried in order, so a rule which comes after one 
+* with the same contents in every chain it is in can never be used. 
+* Drop it, and give back its space if nothing was allocated after it. */
+  TranslationTableOffset same[2] = { 0, 0 };
+  int spaceNeeded = ((ruleSize + SLOTSIZE - 1) / SLOTSIZE) * SLOTSIZE;
+  int direction;
+  if ((!newRuleChains[0] && !newRuleChains[1]) || newRuleDeferred)
+    return;
+  for (direction = 0; direction < 2; direction++)
+    if (newRuleChains[direction] && !(same[direction] =
+				      findEarlierSameRule (*newRuleChains
+							   [direction],
+							   direction)))
+      return;
+  for (direction = 0; direction < 2; direction++)
+    if (newRuleChains[direction])
+      {
+	unlinkNewRule (newRuleChains[direction], direction);
+	if (newRuleCharacters[direction] &&
+	    newRuleCharacters[direction]->definitionRule == newRuleOffset)
+	  newRuleCharacters[direction]->definitionRule = same[direction];
+      }
+  duplicateRules++;
+  if (sizeof (*table) + newRuleOffset * SLOTSIZE + spaceNeeded ==
+      tableUsed)
+    {
+      memset (newRule, 0, spaceNeeded);
+      tableUsed -= spaceNeeded;
+      duplicateRuleBytes += spaceNeeded;
+    }
+  newRuleOffset = same[0] ? same[0] : same[1];
+  newRule = (TranslationTableRule *) & table->ruleArea[newRuleOffset];
+}
+
 static int
   addRule
   (FileInfo * nested,
@@ -1212,12 +2398,21 @@ static int
 * chains and chaining both the chars and dots strings */
   int ruleSize = sizeof (TranslationTableRule) - (DEFAULTRULESIZE * CHARSIZE);
   int direction = 0;		/*0 = forward translation; 1 = bacward */
+  int phase;
   if (ruleChars)
     ruleSize += CHARSIZE * ruleChars->length;
   if (ruleDots)
     ruleSize += CHARSIZE * ruleDots->length;
+  /* A rule which goes in a forRules chain also keeps its characters 
+   * in lowercase, filled in by foldForRules */
+  if (ruleChars && ruleChars->length > 1 && !nofor
+      && opcode != CTO_SwapCc && opcode != CTO_SwapCd
+      && opcode != CTO_SwapDd)
+    ruleSize += CHARSIZE * ruleChars->length;
   if (!allocateSpaceInTable (nested, &newRuleOffset, ruleSize))
     return 0;
+  if (recordingLocations)
+    noteRuleLocation (nested, newRuleOffset);
   newRule = (TranslationTableRule *) & table->ruleArea[newRuleOffset];
   newRule->opcode = opcode;
   newRule->after = after;
@@ -1237,15 +2432,31 @@ static int
     return 0;
 
   /*link new rule into table. */
+  newRuleChains[0] = newRuleChains[1] = NULL;
+  newRuleCharacters[0] = newRuleCharacters[1] = NULL;
+  newRuleDeferred = 0;
   if (opcode == CTO_SwapCc || opcode == CTO_SwapCd || opcode == CTO_SwapDd)
     return 1;
+  phase = profileSetPhase (profileInserting);
+  if (opcode >= CTO_Context && opcode <= CTO_Pass4)
+    passRulesLinked++;
   if (opcode >= CTO_Context && opcode <= CTO_Pass4 && newRule->charslen == 0)
-    return addPassRule (nested);
+    {
+      direction = addPassRule (nested);
+      profileSetPhase (phase);
+      return direction;
+    }
   if (newRule->charslen == 0 || nofor)
     direction = 1;
   while (direction < 2)
     {
-      if (direction == 0 && newRule->charslen == 1)
+      if (direction == 1 && newRule->dotslen > 1 && !noback
+	  && (lazyParts & LOU_LAZY_BACKTRANSLATION))
+	{
+	  deferBackRule ();
+	  newRuleDeferred = 1;
+	}
+      else if (direction == 0 && newRule->charslen == 1)
 	add_0_single (nested);
       else if (direction == 0 && newRule->charslen > 1)
 	add_0_multiple ();
@@ -1260,6 +2471,8 @@ static int
       if (newRule->dotslen == 0)
 	direction = 2;
     }
+  dropDuplicateRule (ruleSize);
+  profileSetPhase (phase);
   return 1;
 }
 
@@ -1342,7 +2555,7 @@ allocateCharacterClasses ()
 static TranslationTableOpcode
 getOpcode (FileInfo * nested, const CharsString * token)
 {
-  static TranslationTableOpcode lastOpcode = 0;
+  static THREADLOCAL TranslationTableOpcode lastOpcode = 0;
   TranslationTableOpcode opcode = lastOpcode;
 
   do
@@ -1368,7 +2581,7 @@ TranslationTableOpcode
 findOpcodeNumber (const char *toFind)
 {
 /* Used by tools such as lou_debug */
-  static TranslationTableOpcode lastOpcode = 0;
+  static THREADLOCAL TranslationTableOpcode lastOpcode = 0;
   TranslationTableOpcode opcode = lastOpcode;
   int length = strlen (toFind);
   do
@@ -1781,7 +2994,7 @@ struct RuleName
   widechar length;
   widechar name[1];
 };
-static struct RuleName *ruleNames = NULL;
+static THREADLOCAL struct RuleName *ruleNames = NULL;
 static TranslationTableOffset
 findRuleName (const CharsString * name)
 {
@@ -1867,6 +3080,87 @@ compileSwapDots (FileInfo * nested, CharsString * source, CharsString * dest)
   return 1;
 }
 
+static int
+compareSwapMatches (const void *a, const void *b)
+{
+  const SwapMatch *match1 = a;
+  const SwapMatch *match2 = b;
+  if (match1->ch != match2->ch)
+    return (int) match1->ch - (int) match2->ch;
+  return (int) match1->match - (int) match2->match;
+}
+
+static int
+makeSwapIndex (FileInfo * nested)
+{
+/* Index the matches of the swap rule just added by character, so that 
+* the translators find a character among them by bisection and know 
+* where its replacement begins without counting the replacements. The 
+* matches of a swapdd rule are cells, each after its length. */
+  SwapMatch matches[MAXSTRING];
+  const widechar *replacements;
+  TranslationTableOffset indexOffset;
+  SwapIndex *index;
+  int total = 0;
+  int count = 0;
+  int k, rep, pos;
+  int step = newRule->opcode == CTO_SwapDd ? 2 : 1;
+  for (k = step - 1; k < newRule->charslen; k += step)
+    {
+      matches[total].ch = newRule->charsdots[k];
+      matches[total].match = total;
+      total++;
+    }
+  qsort (matches, total, sizeof (SwapMatch), compareSwapMatches);
+  for (k = 0; k < total; k++)
+    if (!count || matches[count - 1].ch != matches[k].ch)
+      matches[count++] = matches[k];
+  replacements = &newRule->charsdots[newRule->charslen];
+  for (k = 0; k < count; k++)
+    {
+      pos = 0;
+      for (rep = 0; rep < matches[k].match && pos < newRule->dotslen; rep++)
+	{
+	  if (!replacements[pos])
+	    break;
+	  pos += replacements[pos];
+	}
+      if (rep < matches[k].match || pos > newRule->dotslen)
+	pos = newRule->dotslen;
+      matches[k].replacement = pos;
+    }
+  if (!allocateSpaceInTable (nested, &indexOffset, sizeof (SwapIndex)
+			     + count * sizeof (SwapMatch)))
+    return 0;
+  newRule = (TranslationTableRule *) & table->ruleArea[newRuleOffset];
+  index = (SwapIndex *) & table->ruleArea[indexOffset];
+  index->count = count;
+  memcpy (index->matches, matches, count * sizeof (SwapMatch));
+  newRule->charsnext = indexOffset;
+  return 1;
+}
+
+const SwapMatch *
+findSwapMatch (const TranslationTableHeader * table,
+	       const TranslationTableRule * swapRule, widechar c)
+{
+  const SwapIndex *index =
+    (SwapIndex *) & table->ruleArea[swapRule->charsnext];
+  int low = 0;
+  int high = index->count;
+  while (low < high)
+    {
+      int middle = (low + high) / 2;
+      if (index->matches[middle].ch < c)
+	low = middle + 1;
+      else
+	high = middle;
+    }
+  if (low < index->count && index->matches[low].ch == c)
+    return &index->matches[low];
+  return NULL;
+}
+
 static int
 compileSwap (FileInfo * nested, TranslationTableOpcode opcode)
 {
@@ -1903,6 +3197,8 @@ compileSwap (FileInfo * nested, TranslationTableOpcode opcode)
     }
   if (!addRule (nested, opcode, &ruleChars, &ruleDots, 0, 0))
     return 0;
+  if (!makeSwapIndex (nested))
+    return 0;
   if (!addRuleName (nested, &name))
     return 0;
   return 1;
@@ -1921,19 +3217,19 @@ getNumber (widechar * source, widechar * dest)
 }
 
 /* Start of multipass compiler*/
-static CharsString passRuleChars;
-static CharsString passRuleDots;
-static CharsString passHoldString;
-static CharsString passLine;
-static int passLinepos;
-static int passPrevLinepos;
-static widechar passHoldNumber;
-static widechar passEmphasis;
-static TranslationTableCharacterAttributes passAttributes;
-static FileInfo *passNested;
-static TranslationTableOpcode passOpcode;
-static widechar *passInstructions;
-static int passIC;
+static THREADLOCAL CharsString passRuleChars;
+static THREADLOCAL CharsString passRuleDots;
+static THREADLOCAL CharsString passHoldString;
+static THREADLOCAL CharsString passLine;
+static THREADLOCAL int passLinepos;
+static THREADLOCAL int passPrevLinepos;
+static THREADLOCAL widechar passHoldNumber;
+static THREADLOCAL widechar passEmphasis;
+static THREADLOCAL TranslationTableCharacterAttributes passAttributes;
+static THREADLOCAL FileInfo *passNested;
+static THREADLOCAL TranslationTableOpcode passOpcode;
+static THREADLOCAL widechar *passInstructions;
+static THREADLOCAL int passIC;
 
 static int
 passGetAttributes ()
@@ -2152,7 +3448,7 @@ struct PassName
   widechar length;
   widechar name[1];
 };
-static struct PassName *passNames = NULL;
+static THREADLOCAL struct PassName *passNames = NULL;
 
 static int
 passFindName (const CharsString * name)
@@ -2206,6 +3502,17 @@ passAddName (CharsString * name, int var)
   return 1;
 }
 
+static void
+deallocatePassNames ()
+{
+  while (passNames)
+    {
+      struct PassName *curname = passNames;
+      passNames = passNames->next;
+      free (curname);
+    }
+}
+
 static pass_Codes
 passGetScriptToken ()
 {
@@ -3230,11 +4537,13 @@ compileBrailleIndicator (FileInfo * nested, char *ermsg,
 {
   CharsString token;
   CharsString cells;
+  /* rule is in the table header, which addRule may move */
+  ptrdiff_t field = (char *) rule - (char *) table;
   if (getToken (nested, &token, ermsg))
     if (parseDots (nested, &cells, &token))
       if (!addRule (nested, opcode, NULL, &cells, 0, 0))
 	return 0;
-  *rule = newRuleOffset;
+  *(TranslationTableOffset *) ((char *) table + field) = newRuleOffset;
   return 1;
 }
 
@@ -3427,175 +4736,171 @@ compileUplow (FileInfo * nested)
 
 /*Functions for compiling hyphenation tables*/
 
-typedef struct			/*hyphenation dictionary: finite state machine */
+typedef struct			/*transition made while building the machine */
 {
-  int numStates;
+  int state;
+  int newState;
+  widechar ch;
+} HyphenEdge;
+
+typedef struct			/*hyphenation dictionary: finite state machine */
+{
+  int numStates;
   HyphenationState *states;
+  int *inEdge;
+  int *fallback;
+  int numEdges;
+  int maxEdges;
+  HyphenEdge *edges;
+  int hashSize;
+  int *hash;
 } HyphenDict;
 
-#define DEFAULTSTATE 0xffff
-#define HYPHENHASHSIZE 8191
+#define DEFAULTSTATE -1
+#define HYPHENHASHSIZE 8192
 
-typedef struct
-{
-  void *next;
-  CharsString *key;
-  int val;
-} HyphenHashEntry;
+/* The states are the prefixes of the pattern words, so they form a trie.
+ * Transitions are found through an open addressing hash table keyed by
+ * state and character, which holds indexes into the edges array. */
 
-typedef struct
+static unsigned int
+hyphenTransHash (int state, widechar ch)
 {
-  HyphenHashEntry *entries[HYPHENHASHSIZE];
-} HyphenHashTab;
+  unsigned int h = ((unsigned int) state << 16 ^ ch) * 0x9e3779b1;
+  return h ^ (h >> 15);
+}
 
-/* a hash function from ASU - adapted from Gtk+ */
-static unsigned int
-hyphenStringHash (const CharsString * s)
+static int
+hyphenFindTrans (HyphenDict * dict, int state, widechar ch)
 {
-  int k;
-  unsigned int h = 0, g;
-  for (k = 0; k < s->length; k++)
+  unsigned int i = hyphenTransHash (state, ch) & (dict->hashSize - 1);
+  HyphenEdge *edge;
+  while (dict->hash[i])
     {
-      h = (h << 4) + s->chars[k];
-      if ((g = h & 0xf0000000))
-	{
-	  h = h ^ (g >> 24);
-	  h = h ^ g;
-	}
+      edge = &dict->edges[dict->hash[i] - 1];
+      if (edge->state == state && edge->ch == ch)
+	return edge->newState;
+      i = (i + 1) & (dict->hashSize - 1);
     }
-  return h;
+  return DEFAULTSTATE;
 }
 
-static HyphenHashTab *
-hyphenHashNew ()
+static void
+hyphenHashEdge (HyphenDict * dict, int edgeNum)
 {
-  HyphenHashTab *hashTab;
-  if (!(hashTab = malloc (sizeof (HyphenHashTab))))
-    outOfMemory ();
-  memset (hashTab, 0, sizeof (HyphenHashTab));
-  return hashTab;
+  HyphenEdge *edge = &dict->edges[edgeNum];
+  unsigned int i = hyphenTransHash (edge->state, edge->ch) &
+    (dict->hashSize - 1);
+  while (dict->hash[i])
+    i = (i + 1) & (dict->hashSize - 1);
+  dict->hash[i] = edgeNum + 1;
 }
 
-static void
-hyphenHashFree (HyphenHashTab * hashTab)
+static int
+hyphenGetNewState (HyphenDict * dict)
 {
-  int i;
-  HyphenHashEntry *e, *next;
-  for (i = 0; i < HYPHENHASHSIZE; i++)
-    for (e = hashTab->entries[i]; e; e = next)
-      {
-	next = e->next;
-	free (e->key);
-	free (e);
-      }
-  free (hashTab);
+  int size;
+  /* predicate is true if dict->numStates is a power of two */
+  if (!(dict->numStates & (dict->numStates - 1)))
+    {
+      size = dict->numStates ? dict->numStates << 1 : 1;
+      dict->states = realloc (dict->states, size *
+			      sizeof (HyphenationState));
+      dict->inEdge = realloc (dict->inEdge, size * sizeof (int));
+      dict->fallback = realloc (dict->fallback, size * sizeof (int));
+      if (!dict->states || !dict->inEdge || !dict->fallback)
+	outOfMemory ();
+    }
+  dict->fallback[dict->numStates] = -1;
+  memset (&dict->states[dict->numStates], 0, sizeof (HyphenationState));
+  return dict->numStates++;
 }
 
-/* assumes that key is not already present! */
+/* add a transition from state1 to state2 through ch - assumes that the
+   transition does not already exist */
 static void
-hyphenHashInsert (HyphenHashTab * hashTab, const CharsString * key, int val)
+hyphenAddTrans (HyphenDict * dict, int state1, int state2, widechar ch)
 {
-  int i, j;
-  HyphenHashEntry *e;
-  i = hyphenStringHash (key) % HYPHENHASHSIZE;
-  if (!(e = malloc (sizeof (HyphenHashEntry))))
-    outOfMemory ();
-  e->next = hashTab->entries[i];
-  e->key = malloc ((key->length + 1) * CHARSIZE);
-  if (!e->key)
-    outOfMemory ();
-  e->key->length = key->length;
-  for (j = 0; j < key->length; j++)
-    e->key->chars[j] = key->chars[j];
-  e->val = val;
-  hashTab->entries[i] = e;
+  int k;
+  if (dict->numEdges == dict->maxEdges)
+    {
+      dict->maxEdges = dict->maxEdges ? dict->maxEdges << 1 : 1024;
+      if (!(dict->edges = realloc (dict->edges, dict->maxEdges *
+				   sizeof (HyphenEdge))))
+	outOfMemory ();
+    }
+  dict->edges[dict->numEdges].state = state1;
+  dict->edges[dict->numEdges].ch = ch;
+  dict->edges[dict->numEdges].newState = state2;
+  dict->inEdge[state2] = dict->numEdges;
+  dict->states[state1].numTrans++;
+  if (2 * (dict->numEdges + 1) > dict->hashSize)
+    {
+      dict->hashSize <<= 1;
+      free (dict->hash);
+      if (!(dict->hash = calloc (dict->hashSize, sizeof (int))))
+	outOfMemory ();
+      for (k = 0; k < dict->numEdges; k++)
+	hyphenHashEdge (dict, k);
+    }
+  hyphenHashEdge (dict, dict->numEdges++);
 }
 
-/* return val if found, otherwise DEFAULTSTATE */
+/* The fallback state is the longest proper suffix of the state's word
+ * which is also a state. It is found from the fallback of the state
+ * the transition came from, as in the Aho-Corasick algorithm. */
 static int
-hyphenHashLookup (HyphenHashTab * hashTab, const CharsString * key)
+hyphenFallback (HyphenDict * dict, int state)
 {
-  int i, j;
-  HyphenHashEntry *e;
-  if (key->length == 0)
-    return 0;
-  i = hyphenStringHash (key) % HYPHENHASHSIZE;
-  for (e = hashTab->entries[i]; e; e = e->next)
+  HyphenEdge *edge;
+  int fallback;
+  int next;
+  if (dict->fallback[state] >= 0)
+    return dict->fallback[state];
+  edge = &dict->edges[dict->inEdge[state]];
+  fallback = 0;
+  if (edge->state)
     {
-      if (key->length != e->key->length)
-	continue;
-      for (j = 0; j < key->length; j++)
-	if (key->chars[j] != e->key->chars[j])
-	  break;
-      if (j == key->length)
-	return e->val;
+      fallback = hyphenFallback (dict, edge->state);
+      while ((next = hyphenFindTrans (dict, fallback, edge->ch))
+	     == DEFAULTSTATE && fallback)
+	fallback = hyphenFallback (dict, fallback);
+      if (next != DEFAULTSTATE)
+	fallback = next;
     }
-  return DEFAULTSTATE;
+  dict->fallback[state] = fallback;
+  return fallback;
 }
 
 static int
-hyphenGetNewState (HyphenDict * dict, HyphenHashTab * hashTab, const
-		   CharsString * string)
-{
-  hyphenHashInsert (hashTab, string, dict->numStates);
-  /* predicate is true if dict->numStates is a power of two */
-  if (!(dict->numStates & (dict->numStates - 1)))
-    dict->states = realloc (dict->states, (dict->numStates << 1) *
-			    sizeof (HyphenationState));
-  if (!dict->states)
-    outOfMemory ();
-  dict->states[dict->numStates].hyphenPattern = 0;
-  dict->states[dict->numStates].fallbackState = DEFAULTSTATE;
-  dict->states[dict->numStates].numTrans = 0;
-  dict->states[dict->numStates].trans.pointer = NULL;
-  return dict->numStates++;
-}
-
-/* add a transition from state1 to state2 through ch - assumes that the
-   transition does not already exist */
-static void
-hyphenAddTrans (HyphenDict * dict, int state1, int state2, widechar ch)
+compareHyphenTrans (const void *a, const void *b)
 {
-  int numTrans;
-  numTrans = dict->states[state1].numTrans;
-  if (numTrans == 0)
-    dict->states[state1].trans.pointer = malloc (sizeof (HyphenationTrans));
-  else if (!(numTrans & (numTrans - 1)))
-    dict->states[state1].trans.pointer = realloc
-      (dict->states[state1].trans.pointer,
-       (numTrans << 1) * sizeof (HyphenationTrans));
-  dict->states[state1].trans.pointer[numTrans].ch = ch;
-  dict->states[state1].trans.pointer[numTrans].newState = state2;
-  dict->states[state1].numTrans++;
+  return (int) ((const HyphenationTrans *) a)->ch -
+    (int) ((const HyphenationTrans *) b)->ch;
 }
 
 static int
 compileHyphenation (FileInfo * nested, CharsString * encoding)
 {
   CharsString hyph;
-  HyphenationTrans *holdPointer;
-  HyphenHashTab *hashTab;
+  HyphenationTrans *trans;
   CharsString word;
   char pattern[MAXSTRING];
-  unsigned int stateNum = 0, lastState = 0;
+  unsigned char *storedPattern;
+  int stateNum = 0, newState;
   int i, j, k = encoding->length;
-  widechar ch;
-  int found;
-  HyphenHashEntry *e;
+  int known;
+  int *firstTrans;
   HyphenDict dict;
   TranslationTableOffset holdOffset;
   /*Set aside enough space for hyphenation states and transitions in 
    * translation table. Must be done before anything else*/
   reserveSpaceInTable (nested, 250000);
-  hashTab = hyphenHashNew ();
-  dict.numStates = 1;
-  dict.states = malloc (sizeof (HyphenationState));
-  if (!dict.states)
+  memset (&dict, 0, sizeof (dict));
+  dict.hashSize = HYPHENHASHSIZE;
+  if (!(dict.hash = calloc (dict.hashSize, sizeof (int))))
     outOfMemory ();
-  dict.states[0].hyphenPattern = 0;
-  dict.states[0].fallbackState = DEFAULTSTATE;
-  dict.states[0].numTrans = 0;
-  dict.states[0].trans.pointer = NULL;
+  hyphenGetNewState (&dict);
   do
     {
       if (encoding->chars[0] == 'I')
@@ -3631,74 +4936,89 @@ compileHyphenation (FileInfo * nested, CharsString * encoding)
       word.length = j;
       pattern[j + 1] = 0;
       for (i = 0; pattern[i] == '0'; i++);
-      found = hyphenHashLookup (hashTab, &word);
-      if (found != DEFAULTSTATE)
-	stateNum = found;
-      else
-	stateNum = hyphenGetNewState (&dict, hashTab, &word);
-      k = j + 2 - i;
-      if (k > 0)
+      /* follow the longest prefix of the word which is already a state */
+      stateNum = 0;
+      for (known = 0; known < word.length; known++)
 	{
-	  allocateSpaceInTable (nested,
-				&dict.states[stateNum].hyphenPattern, k);
-	  memcpy (&table->ruleArea[dict.states[stateNum].hyphenPattern],
-		  &pattern[i], k);
+	  newState = hyphenFindTrans (&dict, stateNum, word.chars[known]);
+	  if (newState == DEFAULTSTATE)
+	    break;
+	  stateNum = newState;
 	}
-      /* now, put in the prefix transitions */
-      while (found == DEFAULTSTATE)
+      if (known < word.length)
 	{
-	  lastState = stateNum;
-	  ch = word.chars[word.length-- - 1];
-	  found = hyphenHashLookup (hashTab, &word);
-	  if (found != DEFAULTSTATE)
-	    stateNum = found;
-	  else
-	    stateNum = hyphenGetNewState (&dict, hashTab, &word);
-	  hyphenAddTrans (&dict, stateNum, lastState, ch);
+	  /* the new states are numbered from the whole word back to the
+	   * prefix, and their transitions added in the same order */
+	  newState = dict.numStates;
+	  for (j = word.length; j > known; j--)
+	    hyphenGetNewState (&dict);
+	  for (j = word.length; j > known; j--)
+	    hyphenAddTrans (&dict, j - 1 > known ?
+			    newState + word.length - j + 1 : stateNum,
+			    newState + word.length - j, word.chars[j - 1]);
+	  stateNum = newState;
+	}
+      /* the digits are stored after their number, which saves
+       * hyphenate a strlen at every pattern it finds */
+      k = word.length + 2 - i;
+      if (k > 256)
+	compileError (nested, "hyphenation pattern too long");
+      else if (k > 0 && allocateSpaceInTable (nested,
+					       &dict.states[stateNum].
+					       hyphenPattern, k + 1))
+	{
+	  storedPattern = (unsigned char *)
+	    &table->ruleArea[dict.states[stateNum].hyphenPattern];
+	  storedPattern[0] = k - 1;
+	  memcpy (&storedPattern[1], &pattern[i], k);
 	}
     }
   while (getALine (nested));
   /* put in the fallback states */
-  for (i = 0; i < HYPHENHASHSIZE; i++)
+  for (i = 1; i < dict.numStates; i++)
+    dict.states[i].fallbackState = hyphenFallback (&dict, i);
+  free (dict.hash);
+/*Transfer hyphenation information to table*/
+  /* sort the transitions by state, and those of a state by character
+   * so that hyphenate can search them */
+  if (!(firstTrans = malloc ((dict.numStates + 1) * sizeof (int)))
+      || !(trans = malloc ((dict.numEdges + 1) * sizeof (HyphenationTrans))))
+    outOfMemory ();
+  firstTrans[0] = 0;
+  for (i = 0; i < dict.numStates; i++)
+    firstTrans[i + 1] = firstTrans[i] + dict.states[i].numTrans;
+  for (i = 0; i < dict.numEdges; i++)
     {
-      for (e = hashTab->entries[i]; e; e = e->next)
-	{
-	  for (j = 1; j <= e->key->length; j++)
-	    {
-	      word.length = 0;
-	      for (k = j; k < e->key->length; k++)
-		word.chars[word.length++] = e->key->chars[k];
-	      stateNum = hyphenHashLookup (hashTab, &word);
-	      if (stateNum != DEFAULTSTATE)
-		break;
-	    }
-	  if (e->val)
-	    dict.states[e->val].fallbackState = stateNum;
-	}
+      j = firstTrans[dict.edges[i].state]++;
+      trans[j].ch = dict.edges[i].ch;
+      trans[j].newState = dict.edges[i].newState;
     }
-  hyphenHashFree (hashTab);
-/*Transfer hyphenation information to table*/
+  free (dict.edges);
+  free (dict.inEdge);
+  free (dict.fallback);
   for (i = 0; i < dict.numStates; i++)
+    if (dict.states[i].numTrans
+	&& allocateSpaceInTable (nested, &dict.states[i].trans.offset,
+				 dict.states[i].numTrans *
+				 sizeof (HyphenationTrans)))
+      {
+	qsort (&trans[firstTrans[i] - dict.states[i].numTrans],
+	       dict.states[i].numTrans, sizeof (HyphenationTrans),
+	       compareHyphenTrans);
+	memcpy (&table->ruleArea[dict.states[i].trans.offset],
+		&trans[firstTrans[i] - dict.states[i].numTrans],
+		dict.states[i].numTrans * sizeof (HyphenationTrans));
+      }
+  free (trans);
+  free (firstTrans);
+  if (!allocateSpaceInTable (nested, &holdOffset, dict.numStates *
+			     sizeof (HyphenationState)))
     {
-      if (dict.states[i].numTrans == 0)
-	dict.states[i].trans.offset = 0;
-      else
-	{
-	  holdPointer = dict.states[i].trans.pointer;
-	  allocateSpaceInTable (nested,
-				&dict.states[i].trans.offset,
-				dict.states[i].numTrans *
-				sizeof (HyphenationTrans));
-	  memcpy (&table->ruleArea[dict.states[i].trans.offset],
-		  holdPointer,
-		  dict.states[i].numTrans * sizeof (HyphenationTrans));
-	  free (holdPointer);
-	}
+      free (dict.states);
+      return 0;
     }
-  allocateSpaceInTable (nested,
-			&holdOffset, dict.numStates *
-			sizeof (HyphenationState));
   table->hyphenStatesArray = holdOffset;
+  table->numHyphenStates = dict.numStates;
   /* Prevents segmentajion fault if table is reallocated */
   memcpy (&table->ruleArea[table->hyphenStatesArray], &dict.states[0],
 	  dict.numStates * sizeof (HyphenationState));
@@ -3741,9 +5061,11 @@ compileNoBreak (FileInfo * nested)
 	return 0;
     }
   for (k = 0; k < dotsBefore.length; k++)
-    dotsBefore.chars[k] = getCharFromDots (dotsBefore.chars[k]);
+    dotsBefore.chars[k] =
+      getCharFromDotsInTable (table, dotsBefore.chars[k]);
   for (k = 0; k < dotsAfter.length; k++)
-    dotsAfter.chars[k] = getCharFromDots (dotsAfter.chars[k]);
+    dotsAfter.chars[k] =
+      getCharFromDotsInTable (table, dotsAfter.chars[k]);
   if (!addRule (nested, CTO_NoBreak, &dotsBefore, &dotsAfter, 0, 0))
     return 0;
   table->noBreak = newRuleOffset;
@@ -3803,6 +5125,22 @@ compileCharDef (FileInfo * nested,
   return 1;
 }
 
+static int
+opcodeFamily (TranslationTableOpcode opcode)
+{
+/*The rule family an opcode is profiled under */
+  if ((opcode >= CTO_Space && opcode <= CTO_Display)
+      || opcode == CTO_CompDots || opcode == CTO_Comp6)
+    return profileCharacters;
+  if ((opcode >= CTO_Context && opcode <= CTO_Pass4)
+      || (opcode >= CTO_SwapCc && opcode <= CTO_SwapDd))
+    return profileMultipass;
+  if (opcode == CTO_Replace
+      || (opcode >= CTO_Repeated && opcode <= CTO_NoBreak))
+    return profileTranslationRules;
+  return profileOther;
+}
+
 static int
 compileRule (FileInfo * nested)
 {
@@ -3828,10 +5166,25 @@ doOpcode:
 				  eqasc2uni ((unsigned char *) "UTF-8",
 					     token.chars, 5)))
     {
+      freshTable = 0;
+      profileRule (profileHyphenation);
+      if (lazyParts & LOU_LAZY_HYPHENATION)
+	{
+	  /* Only the last patterns in a table are used */
+	  free (deferredHyphenation);
+	  if (!(deferredHyphenation = strdup (nested->fileName)))
+	    outOfMemory ();
+	  while (getALine (nested));
+	  return 1;
+	}
       compileHyphenation (nested, &token);
       return 1;
     }
   opcode = getOpcode (nested, &token);
+  if (opcode != CTO_IncludeFile)
+    freshTable = 0;
+  if (opcode != CTO_NoBack && opcode != CTO_NoFor)
+    profileRule (opcodeFamily (opcode));
   switch (opcode)
     {				/*Carry out operations */
     case CTO_None:
@@ -4409,6 +5762,7 @@ lou_readCharFromFile (const char *fileName, int *mode)
       nested.encoding = noEncoding;
       nested.status = 0;
       nested.lineNumber = 0;
+      nested.bufferPos = nested.bufferLength = 0;
       if (!(nested.in = fopen (nested.fileName, "r")))
 	{
 	  logMessage (LOG_ERROR, "Cannot open file '%s'", nested.fileName);
@@ -4447,6 +5801,7 @@ compileString (const char *inString)
   for (k = 0; inString[k]; k++)
     nested.line[k] = inString[k];
   nested.line[k] = 0;
+  nested.linelen = k;
   return compileRule (&nested);
 }
 
@@ -4456,6 +5811,8 @@ makeDoubleRule (TranslationTableOpcode opcode, TranslationTableOffset
 {
   CharsString dots;
   TranslationTableRule *rule;
+  /* doubleRule is in the table header, which addRule may move */
+  ptrdiff_t field = (char *) doubleRule - (char *) table;
   if (!*singleRule || *doubleRule)
     return 1;
   rule = (TranslationTableRule *) & table->ruleArea[*singleRule];
@@ -4465,574 +5822,4703 @@ makeDoubleRule (TranslationTableOpcode opcode, TranslationTableOffset
   dots.length = 2 * rule->dotslen;
   if (!addRule (NULL, opcode, NULL, &dots, 0, 0))
     return 0;
-  *doubleRule = newRuleOffset;
+  *(TranslationTableOffset *) ((char *) table + field) = newRuleOffset;
   return 1;
 }
 
 static int
-setDefaults ()
+buildCharacterIndex (int m)
 {
-  if (!table->lenBeginCaps)
-    table->lenBeginCaps = 2;
-  makeDoubleRule (CTO_FirstWordItal, &table->lastWordItalBefore,
-		  &table->firstWordItal);
-  if (!table->lenItalPhrase)
-    table->lenItalPhrase = 4;
-  makeDoubleRule (CTO_FirstWordBold, &table->lastWordBoldBefore,
-		  &table->firstWordBold);
-  if (!table->lenBoldPhrase)
-    table->lenBoldPhrase = 4;
-  makeDoubleRule (CTO_FirstWordUnder, &table->lastWordUnderBefore,
-		  &table->firstWordUnder);
-  if (!table->lenUnderPhrase)
-    table->lenUnderPhrase = 4;
-  if (table->numPasses == 0)
-    table->numPasses = 1;
+/* Make the index used by findCharOrDots for characters (m = 0) or dot 
+* patterns (m = 1). Each entry of the top level is the offset of a page, 
+* or 0 if nothing in that page is defined. An index made before, when 
+* lou_compileString adds to a table, is brought up to date instead. */
+  TranslationTableOffset index = m ? table->dotsIndex :
+    table->characterIndex;
+  TranslationTableOffset page;
+  TranslationTableOffset bucket;
+  TranslationTableCharacter *character;
+  unsigned long int c;
+  int k;
+  if (!index)
+    {
+      if (!allocateSpaceInTable (NULL, &index,
+				 (CHARINDEXSIZE / CHARINDEXPAGE) *
+				 OFFSETSIZE))
+	return 0;
+      memset (&table->ruleArea[index], 0,
+	      (CHARINDEXSIZE / CHARINDEXPAGE) * OFFSETSIZE);
+    }
+  for (k = 0; k < HASHNUM; k++)
+    for (bucket = m ? table->dots[k] : table->characters[k]; bucket;
+	 bucket = character->next)
+      {
+	character = (TranslationTableCharacter *) & table->ruleArea[bucket];
+	c = character->realchar;
+	if (c >= CHARINDEXSIZE)
+	  continue;
+	if (!(page = OFFSETARRAY (table->ruleArea, index)[c / CHARINDEXPAGE]))
+	  {
+	    if (!allocateSpaceInTable (NULL, &page,
+				       CHARINDEXPAGE * OFFSETSIZE))
+	      return 0;
+	    memset (&table->ruleArea[page], 0, CHARINDEXPAGE * OFFSETSIZE);
+	    OFFSETARRAY (table->ruleArea, index)[c / CHARINDEXPAGE] = page;
+	    character =
+	      (TranslationTableCharacter *) & table->ruleArea[bucket];
+	  }
+	/* The first definition in a chain is the one that counts */
+	if (!OFFSETARRAY (table->ruleArea, page)[c % CHARINDEXPAGE])
+	  OFFSETARRAY (table->ruleArea, page)[c % CHARINDEXPAGE] = bucket;
+      }
+  if (m)
+    table->dotsIndex = index;
+  else
+    table->characterIndex = index;
   return 1;
 }
 
-/* =============== *
- * TABLE RESOLVING *
- * =============== *
- *
- * A table resolver is a function that resolves a `tableList` path against a
- * `base` path, and returns the resolved table(s) as a list of absolute file
- * paths.
- *
- * The function must have the following signature:
- *
- *     char ** (const char * tableList, const char * base)
- *
- * In general, `tableList` is a path in the broad sense. The default
- * implementation accepts only *file* paths. But another implementation could
- * for instance handle URI's. `base` is always a file path however.
- *
- * The idea is to give other programs that use liblouis the ability to define
- * their own table resolver (in C, Java, Python, etc.) when the default
- * resolver is not satisfying. (see also lou_registerTableResolver)
- *
- */
+typedef struct
+{
+  TranslationTableOffset rule;
+  int sequence;			/*position in the chains */
+  int length;
+  const widechar *chars;	/*characters or dots of the rule */
+} TrieEntry;
 
-/**
- * Resolve a single (sub)table.
- * 
- * Tries to resolve `table` against `base` if base is an absolute path. If
- * that fails, searches `searchPath`.
- *
- */
-static char *
-resolveSubtable (const char *table, const char *base, const char *searchPath)
+typedef struct
 {
-  char *tableFile;
-  static struct stat info;
-  
-  if (table == NULL || table[0] == '\0')
-    return NULL;
-  tableFile = (char *) malloc (MAXSTRING * sizeof(char));
-  
-  //
-  // First try to resolve against base
-  //
-  if (base)
+  TrieEntry *entries;
+  int numNodes;
+  int *parent;
+  int *firstEdge;
+  int *numEdges;
+  int *firstRule;
+  int *numRules;
+  int edgesUsed;
+  widechar *edgeChars;
+  int *edgeChild;
+  int maxDepth;			/*0 for none */
+  int sequenced;		/*the rules are backward ones, whose places 
+				   in the chains are stored */
+} TrieBuilder;
+
+/* A node with no more rules than this below it keeps them all, rather 
+ * than have children */
+#define TRIEBUCKETSIZE 8
+
+/* The whole-word index is not made if a bucket of it has more words */
+#define WORDINDEXBUCKET 32
+
+/* Nor for fewer words, which the trie finds about as quickly */
+#define MINWORDINDEX 1024
+
+/* Walking the backRules chains is quicker than walking the trie unless 
+ * a cell is met on average by chains at least this long */
+#define BACKTRIECHAIN 32
+
+static int
+compareTrieEntries (const void *p1, const void *p2)
+{
+  const TrieEntry *entry1 = p1;
+  const TrieEntry *entry2 = p2;
+  int k;
+  for (k = 0; k < entry1->length && k < entry2->length; k++)
+    if (entry1->chars[k] != entry2->chars[k])
+      return entry1->chars[k] < entry2->chars[k] ? -1 : 1;
+  if (entry1->length != entry2->length)
+    return entry1->length - entry2->length;
+  return entry1->sequence - entry2->sequence;
+}
+
+static int
+compareTrieSequence (const void *p1, const void *p2)
+{
+  return ((const TrieEntry *) p1)->sequence -
+    ((const TrieEntry *) p2)->sequence;
+}
+
+static int
+makeTrieNode (TrieBuilder * builder, int first, int end, int depth,
+	      int parent)
+{
+/* Make the node for the sorted entries from first to end, which share 
+* their first depth characters */
+  TrieEntry *entries = builder->entries;
+  int node = builder->numNodes++;
+  int edge, next, k, m;
+  builder->parent[node] = parent;
+  builder->firstRule[node] = first;
+  builder->numEdges[node] = 0;
+  for (k = first; k < end && entries[k].length == depth; k++);
+  if (k == end || end - first <= TRIEBUCKETSIZE
+      || (builder->maxDepth && depth == builder->maxDepth))
     {
-      int k;
-      strcpy (tableFile, base);
-      for (k = strlen (tableFile); k >= 0 && tableFile[k] != DIR_SEP; k--)
-	;
-      tableFile[++k] = '\0';
-      strcat (tableFile, table);
-      if (stat (tableFile, &info) == 0 && !(info.st_mode & S_IFDIR))
-	return tableFile;
+      qsort (&entries[first], end - first, sizeof (TrieEntry),
+	     compareTrieSequence);
+      builder->numRules[node] = end - first;
+      return node;
     }
-  
-  //
-  // It could be an absolute path, or a path relative to the current working
-  // directory
-  //
-  strcpy (tableFile, table);
-  if (stat (tableFile, &info) == 0 && !(info.st_mode & S_IFDIR))
-    return tableFile;
-  
-  //
-  // Then search `LOUIS_TABLEPATH`, `dataPath` and `programPath`
-  //
-  if (searchPath[0] != '\0')
+  builder->numRules[node] = k - first;
+  /* The entries left are grouped by their next character */
+  for (m = k; m < end; m = next)
     {
-      char *dir;
-      int last;
-      char *cp;
-      char *searchPath_copy = strdup (searchPath + 1);
-      for (dir = searchPath_copy; ; dir = cp + 1)
-	{
-	  for (cp = dir; *cp != '\0' && *cp != ','; cp++)
-	    ;
-	  last = (*cp == '\0');
-	  *cp = '\0';
-	  if (dir == cp)
-	    dir = ".";
-	  sprintf (tableFile, "%s%c%s", dir, DIR_SEP, table);
-	  if (stat (tableFile, &info) == 0 && !(info.st_mode & S_IFDIR)) 
-	    {
-	      free(searchPath_copy);
-	      return tableFile;
-	    }
-	  if (last)
-	    break;
-	}
-      free(searchPath_copy);
+      for (next = m; next < end
+	   && entries[next].chars[depth] == entries[m].chars[depth]; next++);
+      builder->numEdges[node]++;
     }
-  free (tableFile);
-  return NULL;
+  edge = builder->firstEdge[node] = builder->edgesUsed;
+  builder->edgesUsed += builder->numEdges[node];
+  for (m = k; m < end; m = next)
+    {
+      for (next = m; next < end
+	   && entries[next].chars[depth] == entries[m].chars[depth]; next++);
+      builder->edgeChars[edge] = entries[m].chars[depth];
+      builder->edgeChild[edge++] =
+	makeTrieNode (builder, m, next, depth + 1, node);
+    }
+  return node;
 }
 
-char *
-getTablePath()
+static int
+storeTrie (TrieBuilder * builder, int numEntries, int numChars,
+	   TranslationTableOffset * root)
 {
-  char searchPath[MAXSTRING];
-  char *path;
-  char *cp;
-  cp = searchPath;
-  path = getenv ("LOUIS_TABLEPATH");
-  if (path != NULL && path[0] != '\0')
-    cp += sprintf (cp, ",%s", path);
-  path = lou_getDataPath ();
-  if (path != NULL && path[0] != '\0')
-    cp += sprintf (cp, ",%s%c%s%c%s", path, DIR_SEP, "liblouis", DIR_SEP,
-		   "tables");
-#ifdef _WIN32
-  path = lou_getProgramPath ();
-  if (path != NULL && path[0] != '\0')
-    cp += sprintf (cp, ",%s%s", path, "\\share\\liblouis\\tables");
-#else
-  cp += sprintf (cp, ",%s", TABLESDIR);
-#endif
-  return strdup(searchPath);
+/* Sort the entries of the builder, make the trie of their characters 
+* and store it in the table. The entries are sorted by their characters 
+* and then by their place in the chains, so the rules of a node are 
+* stored together in the order of the chain. */
+  const int nodeSize = sizeof (ForRuleNode) / SLOTSIZE;
+  const int edgeSize = sizeof (ForRuleEdge) / SLOTSIZE;
+  const int ruleSize = sizeof (TrieRule) / SLOTSIZE;
+  TranslationTableOffset nodes, edges, rules;
+  ForRuleNode *node;
+  ForRuleEdge *edge;
+  TrieRule *trieRule;
+  const TranslationTableRule *rule;
+  const widechar *chars;
+  int k, m;
+  qsort (builder->entries, numEntries, sizeof (TrieEntry),
+	 compareTrieEntries);
+  /* There are at most numChars nodes besides the root */
+  if (!(builder->parent = malloc ((numChars + 1) * sizeof (int)))
+      || !(builder->firstEdge = malloc ((numChars + 1) * sizeof (int)))
+      || !(builder->numEdges = malloc ((numChars + 1) * sizeof (int)))
+      || !(builder->firstRule = malloc ((numChars + 1) * sizeof (int)))
+      || !(builder->numRules = malloc ((numChars + 1) * sizeof (int)))
+      || !(builder->edgeChars = malloc ((numChars + 1) * CHARSIZE))
+      || !(builder->edgeChild = malloc ((numChars + 1) * sizeof (int))))
+    outOfMemory ();
+  makeTrieNode (builder, 0, numEntries, 0, 0);
+  if (!allocateSpaceInTable (NULL, &nodes,
+			     builder->numNodes * nodeSize * SLOTSIZE)
+      || !allocateSpaceInTable (NULL, &edges,
+				builder->edgesUsed * edgeSize * SLOTSIZE)
+      || !allocateSpaceInTable (NULL, &rules,
+				numEntries * ruleSize * SLOTSIZE))
+    return 0;
+  for (k = 0; k < builder->numNodes; k++)
+    {
+      node = (ForRuleNode *) & table->ruleArea[nodes + k * nodeSize];
+      node->parent = k ? nodes + builder->parent[k] * nodeSize : 0;
+      node->numChildren = builder->numEdges[k];
+      node->children = node->numChildren ?
+	edges + builder->firstEdge[k] * edgeSize : 0;
+      node->numRules = builder->numRules[k];
+      node->rules = node->numRules ?
+	rules + builder->firstRule[k] * ruleSize : 0;
+    }
+  for (k = 0; k < builder->edgesUsed; k++)
+    {
+      edge = (ForRuleEdge *) & table->ruleArea[edges + k * edgeSize];
+      edge->ch = builder->edgeChars[k];
+      edge->node = nodes + builder->edgeChild[k] * nodeSize;
+    }
+  /* The table may have moved, so the characters are taken from the 
+   * rules again */
+  for (k = 0; k < numEntries; k++)
+    {
+      trieRule = (TrieRule *) & table->ruleArea[rules + k * ruleSize];
+      rule = (TranslationTableRule *) &
+	table->ruleArea[builder->entries[k].rule];
+      trieRule->rule = builder->entries[k].rule;
+      trieRule->sequence = builder->sequenced ?
+	builder->entries[k].sequence : 0;
+      trieRule->opcode = rule->opcode;
+      trieRule->charslen = rule->charslen;
+      trieRule->dotslen = rule->dotslen;
+      chars = builder->sequenced ? &rule->charsdots[rule->charslen] :
+	&rule->charsdots[rule->charslen + rule->dotslen];
+      for (m = 0; m < TRIERULEPREFIX; m++)
+	trieRule->prefix[m] = m < builder->entries[k].length ? chars[m] : 0;
+    }
+  *root = nodes;
+  free (builder->edgeChild);
+  free (builder->edgeChars);
+  free (builder->numRules);
+  free (builder->firstRule);
+  free (builder->numEdges);
+  free (builder->firstEdge);
+  free (builder->parent);
+  return 1;
 }
 
-/**
- * The default table resolver
- *
- * Tries to resolve tableList against base. The search path is set to
- * `LOUIS_TABLEPATH`, `dataPath` and `programPath` (in that order).
- *
- * @param table A file path, may be absolute or relative. May be a list of
- *              tables separated by comma's. In that case, the first table
- *              is used as the base for the other subtables.
- * @param base A file path or directory path, or NULL.
- * @return The file paths of the resolved subtables, or NULL if the table
- *         could not be resolved.
- *
- */
-static char **
-defaultTableResolver (const char *tableList, const char *base)
+static int
+compareRuleKeys (const void *a, const void *b)
 {
-  char * searchPath;
-  char **tableFiles;
-  char *subTable;
-  char *tableList_copy;
-  char *cp;
-  int last;
-  int k;
-  
-  /* Set up search path */
-  searchPath = getTablePath();
-  
-  /* Count number of subtables in table list */
-  k = 0;
-  for (cp = (char *)tableList; *cp != '\0'; cp++)
-    if (*cp == ',')
-      k++;
-  tableFiles = (char **) malloc ((k + 2) * sizeof(char *));
-  
-  /* Resolve subtables */
-  k = 0;
-  tableList_copy = strdup (tableList);
-  for (subTable = tableList_copy; ; subTable = cp + 1)
+  const widechar *key1 = a;
+  const widechar *key2 = b;
+  if (key1[0] != key2[0])
+    return key1[0] < key2[0] ? -1 : 1;
+  return key1[1] < key2[1] ? -1 : key1[1] > key2[1];
+}
+
+static int
+buildForRuleBuckets ()
+{
+/* Spread the rules of the forRules chains in the header over about as 
+* many chains as there are pairs of characters the rules begin with, 
+* rounded up to a power of two, so that the chains stay short whatever the 
+* script, see FORRULEHASH. Each chain keeps its order of rules. A rule 
+* of one character that came after a rule, see foldForRules, moves with 
+* it, as it is reached from the otherRules of a dot pattern. */
+  TranslationTableOffset *chains;
+  TranslationTableOffset *currentOffsetPtr;
+  TranslationTableOffset offset, next, last, bucketsOffset;
+  TranslationTableRule *rule, *currentRule;
+  widechar *keys;			/*the first two characters of each rule */
+  int numRules = 0, numKeys = 0, numPairs = 0, bits = 4;
+  int bucket, k;
+  if (table->forRuleBuckets)
+    return 1;
+  for (bucket = 0; bucket < HASHNUM; bucket++)
+    for (offset = table->forRules[bucket]; offset; offset = rule->charsnext)
+      {
+	rule = (TranslationTableRule *) & table->ruleArea[offset];
+	numRules++;
+      }
+  if (numRules)
     {
-      for (cp = subTable; *cp != '\0' && *cp != ','; cp++);
-      last = (*cp == '\0');
-      *cp = '\0';
-      if (!(tableFiles[k++] = resolveSubtable (subTable, base, searchPath)))
-	{
-	  logMessage (LOG_ERROR, "Cannot resolve table '%s'", subTable);
-	  free(searchPath);
-	  free(tableList_copy);
-	  free (tableFiles);
-	  return NULL;
-	}
-      if (k == 1)
-	base = subTable;
-      if (last)
-	break;
+      if (!(keys = malloc (numRules * 2 * CHARSIZE)))
+	outOfMemory ();
+      for (bucket = 0; bucket < HASHNUM; bucket++)
+	for (offset = table->forRules[bucket]; offset;
+	     offset = rule->charsnext)
+	  {
+	    rule = (TranslationTableRule *) & table->ruleArea[offset];
+	    if (rule->charslen >= 2)
+	      {
+		keys[2 * numKeys] = rule->charsdots[0];
+		keys[2 * numKeys++ + 1] = rule->charsdots[1];
+	      }
+	  }
+      qsort (keys, numKeys, 2 * CHARSIZE, compareRuleKeys);
+      for (k = 0; k < numKeys; k++)
+	if (!k || compareRuleKeys (&keys[2 * k], &keys[2 * k - 2]))
+	  numPairs++;
+      free (keys);
     }
-  free(searchPath);
-  free(tableList_copy);
-  tableFiles[k] = NULL;
-  return tableFiles;
+  while ((1 << bits) < numPairs && bits < 20)
+    bits++;
+  if (!allocateSpaceInTable (NULL, &bucketsOffset, (1 << bits) * OFFSETSIZE))
+    return 0;
+  chains = OFFSETARRAY (table->ruleArea, bucketsOffset);
+  for (bucket = 0; bucket < HASHNUM; bucket++)
+    for (offset = table->forRules[bucket]; offset; offset = next)
+      {
+	rule = (TranslationTableRule *) & table->ruleArea[offset];
+	last = offset;
+	next = rule->charsnext;
+	while (next && ((TranslationTableRule *)
+			& table->ruleArea[next])->charslen < 2)
+	  {
+	    last = next;
+	    next = ((TranslationTableRule *) & table->ruleArea[next])->charsnext;
+	  }
+	currentOffsetPtr = &chains[FORRULEHASH (rule->charsdots[0],
+						rule->charsdots[1], bits)];
+	while (*currentOffsetPtr)
+	  {
+	    currentRule = (TranslationTableRule *)
+	      & table->ruleArea[*currentOffsetPtr];
+	    if (rule->charslen > currentRule->charslen)
+	      break;
+	    if (rule->charslen == currentRule->charslen)
+	      if ((currentRule->opcode == CTO_Always)
+		  && (rule->opcode != CTO_Always))
+		break;
+	    currentOffsetPtr = &currentRule->charsnext;
+	  }
+	((TranslationTableRule *) & table->ruleArea[last])->charsnext =
+	  *currentOffsetPtr;
+	*currentOffsetPtr = offset;
+      }
+  memset (table->forRules, 0, sizeof (table->forRules));
+  table->forRuleBuckets = bucketsOffset;
+  table->forRuleHashBits = bits;
+  return 1;
 }
 
-static char ** (* tableResolver) (const char *tableList, const char *base) =
-  &defaultTableResolver;
+static void
+foldForRules ()
+{
+/* Fill in the lowercase characters kept after the find and replacement 
+* strings of the rules in the forRules chains, so that they need not be 
+* looked up each time a rule is tried. A character which is not defined 
+* stands for itself, as with findCharOrDots. A rule of one character 
+* can end up in a chain after a rule of the dots it shares the otherRules 
+* of, see add_0_single, so it has no room for a copy and is passed over. */
+  TranslationTableOffset offset;
+  TranslationTableRule *rule;
+  TranslationTableCharacter *character;
+  widechar *lowercase;
+  TranslationTableOffset *chains;
+  int count, bucket, k;
+  chains = forRuleChains (&count);
+  for (bucket = 0; bucket < count; bucket++)
+    for (offset = chains[bucket]; offset; offset = rule->charsnext)
+      {
+	rule = (TranslationTableRule *) & table->ruleArea[offset];
+	if (rule->charslen < 2)
+	  continue;
+	lowercase = &rule->charsdots[rule->charslen + rule->dotslen];
+	for (k = 0; k < rule->charslen; k++)
+	  {
+	    character = compile_findCharOrDots (rule->charsdots[k], 0);
+	    lowercase[k] = character ? character->lowercase :
+	      rule->charsdots[k];
+	  }
+      }
+}
 
-static char **
-copyStringArray(const char ** array)
+static int
+interchangeable (const TranslationTableRule * rule1,
+		 const TranslationTableRule * rule2)
 {
-  int len;
-  char ** copy;
-  if (!array)
-    return NULL;
-  len = 0;
-  while (array[len]) len++;
-  copy = malloc((len + 1) * sizeof(char *));
-  copy[len] = NULL;
-  while (len)
+/* Whether two rules of a run of orderRuleChain can never match at the 
+* same place, so that which is tried first makes no difference */
+  return memcmp (&rule1->charsdots[rule1->charslen + rule1->dotslen],
+		 &rule2->charsdots[rule2->charslen + rule2->dotslen],
+		 rule1->charslen * CHARSIZE) != 0;
+}
+
+static void
+orderRuleChain (TranslationTableOffset * offsetPtr)
+{
+/* Put the rules of a forRules chain the profile of 
+* lou_setRuleOrderProfile says are applied most often first. Rules are 
+* only moved within a run of rules as long as one another whose 
+* opcodes are both always or both something else, which add_0_multiple 
+* keeps in the order they were defined in, and only past rules with 
+* other lowercase characters, so the same rule is still found at every 
+* place. A chain is left alone from the first rule of one character 
+* on, see buildForRuleBuckets, as otherRules chains lead into it. */
+  TranslationTableOffset *run = NULL;
+  unsigned long *heats = NULL;
+  int runSize = 0;
+  while (*offsetPtr)
     {
-      len--;
-      copy[len] = strdup (array[len]);
+      TranslationTableOffset offset = *offsetPtr;
+      TranslationTableRule *first = (TranslationTableRule *)
+	& table->ruleArea[offset];
+      TranslationTableRule *rule;
+      int numRun = 0, k, j;
+      if (first->charslen < 2)
+	break;
+      while (offset)
+	{
+	  rule = (TranslationTableRule *) & table->ruleArea[offset];
+	  if (rule->charslen != first->charslen
+	      || (rule->opcode == CTO_Always) != (first->opcode == CTO_Always))
+	    break;
+	  if (numRun == runSize)
+	    {
+	      runSize = runSize ? 2 * runSize : 16;
+	      if (!(run = realloc (run, runSize * sizeof (*run)))
+		  || !(heats = realloc (heats, runSize * sizeof (*heats))))
+		outOfMemory ();
+	    }
+	  run[numRun] = offset;
+	  heats[numRun++] = ruleHeat (offset);
+	  offset = rule->charsnext;
+	}
+      /* Insertion sort, which keeps rules of the same heat in order */
+      for (k = 1; k < numRun; k++)
+	for (j = k; j > 0 && heats[j] > heats[j - 1]
+	     && interchangeable ((TranslationTableRule *) &
+				 table->ruleArea[run[j]],
+				 (TranslationTableRule *) &
+				 table->ruleArea[run[j - 1]]); j--)
+	  {
+	    TranslationTableOffset swapOffset = run[j];
+	    unsigned long swapHeat = heats[j];
+	    run[j] = run[j - 1];
+	    heats[j] = heats[j - 1];
+	    run[j - 1] = swapOffset;
+	    heats[j - 1] = swapHeat;
+	  }
+      for (k = 0; k < numRun; k++)
+	{
+	  *offsetPtr = run[k];
+	  offsetPtr = &((TranslationTableRule *)
+			& table->ruleArea[run[k]])->charsnext;
+	}
+      *offsetPtr = offset;
     }
-  return copy;
+  free (run);
+  free (heats);
 }
 
-char **
-resolveTable (const char *tableList, const char *base)
+static void
+orderForRules ()
 {
-  return copyStringArray((*tableResolver) (tableList, base));
+  TranslationTableOffset *chains;
+  int count, bucket;
+  if (!ruleOrder || !numRuleLocations)
+    return;
+  chains = forRuleChains (&count);
+  for (bucket = 0; bucket < count; bucket++)
+    orderRuleChain (&chains[bucket]);
 }
 
-/**
- * Register a new table resolver. Overrides the default resolver.
- *
- * @param resolver The new resolver as a function pointer.
- *
- */
-void EXPORT_CALL
-lou_registerTableResolver (char ** (* resolver) (const char *tableList, const char *base))
+static int
+buildRuleFilter (const widechar * pairs, int numPairs,
+		 TranslationTableOffset * filter, int *bits)
 {
-  tableResolver = resolver;
+/* Make a filter with about eight bits for each pair of characters or 
+* cells in pairs, and set the bit of each, see RULEPAIRBIT. Looking up 
+* a pair that begins no rule then costs one load, and about one in ten 
+* of them still has its bit set. */
+  TranslationTableOffset offset;
+  int k, hash;
+  *bits = 6;
+  while ((1 << *bits) < 8 * numPairs && *bits < 20)
+    (*bits)++;
+  if (!allocateSpaceInTable (NULL, &offset, (1 << *bits) / 8))
+    return 0;
+  memset (&table->ruleArea[offset], 0, (1 << *bits) / 8);
+  for (k = 0; k < numPairs; k++)
+    {
+      hash = FORRULEHASH (pairs[2 * k], pairs[2 * k + 1], *bits);
+      table->ruleArea[offset + hash / 32] |= 1U << (hash % 32);
+    }
+  *filter = offset;
+  return 1;
 }
 
-static int fileCount = 0;
+static int
+isIndexableWord (const TranslationTableRule * rule)
+{
+/* Whether the rule can match only a whole run of input characters which 
+* are neither spaces nor punctuation, so that findIndexedWord finds it 
+* from the characters of the run */
+  const widechar *lowercase =
+    &rule->charsdots[rule->charslen + rule->dotslen];
+  const TranslationTableCharacter *character;
+  int k;
+  if ((rule->opcode != CTO_WholeWord && rule->opcode != CTO_Contraction
+       && rule->opcode != CTO_LowWord) || rule->charslen > MAXINDEXEDWORD)
+    return 0;
+  for (k = 0; k < rule->charslen; k++)
+    if (!(character = compile_findCharOrDots (lowercase[k], 0))
+	|| (character->attributes & (CTC_Space | CTC_Punctuation)))
+      return 0;
+  return 1;
+}
 
-/**
- * Compile a single file
- *
- */
 static int
-compileFile (const char *fileName)
+bucketIndexedWords (const TranslationTableOffset * words, int numWords,
+		    unsigned int seed, int numBuckets, unsigned int *hashes,
+		    int *buckets, int *bucketStart, int *members)
 {
-  FileInfo nested;
-  fileCount++;
-  nested.fileName = fileName;
-  nested.encoding = noEncoding;
-  nested.status = 0;
-  nested.lineNumber = 0;
-  if ((nested.in = fopen (nested.fileName, "rb")))
+/* Find the bucket of each word for seed and its hash for wordIndexSlot, 
+* and sort the words by bucket, those of bucket b from 
+* members[bucketStart[b]] on. Return the size of the largest bucket, or 
+* 0 if two words of a bucket have the same hash. */
+  const TranslationTableRule *rule;
+  const widechar *lowercase;
+  unsigned int hash;
+  int bucket, largest = 0;
+  int k, m;
+  memset (bucketStart, 0, (numBuckets + 1) * sizeof (int));
+  for (k = 0; k < numWords; k++)
     {
-      while (getALine (&nested))
-	compileRule (&nested);
-      fclose (nested.in);
-      return 1;
+      rule = (TranslationTableRule *) & table->ruleArea[words[k]];
+      lowercase = &rule->charsdots[rule->charslen + rule->dotslen];
+      hash = seed;
+      hashes[k] = 0;
+      for (m = 0; m < rule->charslen; m++)
+	{
+	  hash = WORDINDEXHASH (hash, lowercase[m]);
+	  hashes[k] = WORDINDEXSLOTHASH (hashes[k], lowercase[m]);
+	}
+      buckets[k] = hash & (numBuckets - 1);
+      bucketStart[buckets[k] + 1]++;
     }
-  else
-    logMessage (LOG_ERROR, "Cannot open table '%s'", nested.fileName);
-  errorCount++;
-  return 0;
+  for (bucket = 0; bucket < numBuckets; bucket++)
+    {
+      if (bucketStart[bucket + 1] > largest)
+	largest = bucketStart[bucket + 1];
+      bucketStart[bucket + 1] += bucketStart[bucket];
+    }
+  for (k = 0; k < numWords; k++)
+    members[bucketStart[buckets[k]]++] = k;
+  for (bucket = numBuckets; bucket > 0; bucket--)
+    bucketStart[bucket] = bucketStart[bucket - 1];
+  bucketStart[0] = 0;
+  for (bucket = 0; bucket < numBuckets; bucket++)
+    for (k = bucketStart[bucket]; k < bucketStart[bucket + 1]; k++)
+      for (m = bucketStart[bucket]; m < k; m++)
+	if (hashes[members[m]] == hashes[members[k]])
+	  return 0;
+  return largest;
 }
 
-/** 
- * Free a char** array 
- */
-static void 
-free_tablefiles(char **tables) {
-  char **table;
-  if (!tables) return;
-  for (table = tables; *table; table++)
-    free(*table);
-  free(tables);
+static int
+placeWordBucket (const unsigned int *hashes, const int *bucket, int size,
+		 int numWords, int *slotWords)
+{
+/* Give the words of a bucket the slots of the first displacement at 
+* which they are all free, and return it, or -1 if there is none */
+  int slots[WORDINDEXBUCKET];
+  int displacement, k, m;
+  for (displacement = 0; displacement <= 16 * numWords + 1024;
+       displacement++)
+    {
+      for (k = 0; k < size; k++)
+	{
+	  slots[k] = wordIndexSlot (hashes[bucket[k]], displacement,
+				    numWords);
+	  if (slotWords[slots[k]] >= 0)
+	    break;
+	  for (m = 0; m < k && slots[m] != slots[k]; m++);
+	  if (m < k)
+	    break;
+	}
+      if (k == size)
+	{
+	  for (k = 0; k < size; k++)
+	    slotWords[slots[k]] = bucket[k];
+	  return displacement;
+	}
+    }
+  return -1;
 }
 
-/**
- * Implement include opcode
- *
- */
 static int
-includeFile (FileInfo * nested, CharsString * includedFile)
+buildWordIndex (const TranslationTableOffset * words, int numWords)
 {
+/* Put the rules at words, no two with the same lowercase characters, 
+* in a minimal perfect hash of these characters, made by hash and 
+* displace: the buckets, of two words on average, are placed largest 
+* first, each with the first displacement which gives all its words 
+* free slots. Another seed is taken while two words of a bucket have 
+* the same hash for wordIndexSlot. Return 0, leaving no index, if it 
+* cannot be made. */
+  unsigned int *hashes;
+  int *buckets, *bucketStart, *members, *slotWords, *displacements;
+  TranslationTableOffset offset;
+  unsigned int seed = 0;
+  int numBuckets, bits = 0, largest = 0, longest = 0;
+  int size, bucket, attempt;
   int k;
-  char includeThis[MAXSTRING];
-  char **tableFiles;
-  int rv;
-  for (k = 0; k < includedFile->length; k++)
-    includeThis[k] = (char) includedFile->chars[k];
-  includeThis[k] = 0;
-  tableFiles = resolveTable (includeThis, nested->fileName);
-  if (tableFiles == NULL)
+  const TranslationTableRule *rule;
+  while ((1 << bits) * 2 < numWords)
+    bits++;
+  numBuckets = 1 << bits;
+  hashes = malloc (numWords * sizeof (unsigned int));
+  buckets = malloc (numWords * sizeof (int));
+  displacements = malloc (numBuckets * sizeof (int));
+  bucketStart = malloc ((numBuckets + 1) * sizeof (int));
+  members = malloc (numWords * sizeof (int));
+  slotWords = malloc (numWords * sizeof (int));
+  if (!hashes || !buckets || !displacements || !bucketStart || !members
+      || !slotWords)
+    outOfMemory ();
+  for (attempt = 0; attempt < 8 && !largest; attempt++)
     {
-      errorCount++;
-      return 0;
+      seed = 2166136261U + attempt * 0x9e3779b9U;
+      largest = bucketIndexedWords (words, numWords, seed, numBuckets,
+				    hashes, buckets, bucketStart, members);
     }
-  if (tableFiles[1] != NULL)
+  if (largest > WORDINDEXBUCKET)
+    largest = 0;
+  for (k = 0; k < numWords; k++)
+    slotWords[k] = -1;
+  for (size = largest; size > 0; size--)
+    for (bucket = 0; bucket < numBuckets && largest; bucket++)
+      if (bucketStart[bucket + 1] - bucketStart[bucket] == size
+	  && (displacements[bucket] =
+	      placeWordBucket (hashes, &members[bucketStart[bucket]], size,
+			       numWords, slotWords)) < 0)
+	largest = 0;
+  if (largest && allocateSpaceInTable (NULL, &offset,
+				       (numBuckets + numWords) * SLOTSIZE))
     {
-      errorCount++;
-      free_tablefiles(tableFiles);
-      logMessage (LOG_ERROR, "Table list not supported in include statement: 'include %s'", includeThis);
-      return 0;
+      for (bucket = 0; bucket < numBuckets; bucket++)
+	table->ruleArea[offset + bucket] =
+	  bucketStart[bucket + 1] > bucketStart[bucket] ?
+	  displacements[bucket] : 0;
+      for (k = 0; k < numWords; k++)
+	{
+	  table->ruleArea[offset + numBuckets + k] = words[slotWords[k]];
+	  rule = (TranslationTableRule *) & table->ruleArea[words[k]];
+	  if (rule->charslen > longest)
+	    longest = rule->charslen;
+	}
+      table->wordIndex = offset;
+      table->wordIndexSeed = seed;
+      table->wordIndexBits = bits;
+      table->numIndexedWords = numWords;
+      table->longestIndexedWord = longest;
     }
-  rv = compileFile (*tableFiles);
-  free_tablefiles(tableFiles);
-  return rv;
+  else
+    largest = 0;
+  free (slotWords);
+  free (members);
+  free (bucketStart);
+  free (displacements);
+  free (buckets);
+  free (hashes);
+  return largest != 0;
 }
 
-/**
- * Compile source tables into a table in memory
- *
- */
-static void *
-compileTranslationTable (const char *tableList)
+static int
+buildForRuleTrie ()
 {
-  char **tableFiles;
-  char **subTable;
-  errorCount = warningCount = fileCount = 0;
-  table = NULL;
-  characterClasses = NULL;
-  ruleNames = NULL;
-  if (tableList == NULL)
-    return NULL;
-  if (!opcodeLengths[0])
+/* Make a trie of the lowercase characters, see foldForRules, of the 
+* rules in the forRules chains, so that for_selectRule finds the rules 
+* matching at a position in one walk instead of trying every rule in a 
+* chain. A rule goes in only if its lowercase characters hash to the 
+* chain it is in, because for_selectRule could not reach it otherwise, 
+* and only if it has the two characters or more of a rule added to the 
+* chain. The whole-word rules which isIndexableWord accepts and no other 
+* rule has the characters of go in the whole-word index instead, if 
+* there are MINWORDINDEX of them. */
+  TrieBuilder builder;
+  widechar *chars;
+  int numEntries = 0, numChars = 0;
+  TranslationTableOffset offset;
+  TranslationTableOffset *chains;
+  TranslationTableOffset *words;
+  TranslationTableRule *rule;
+  widechar *pairs;
+  char *indexed;
+  int count, bucket, result, k, m, numWords;
+  table->forRuleTrie = table->forRuleFilter = table->wordIndex = 0;
+  chains = forRuleChains (&count);
+  for (bucket = 0; bucket < count; bucket++)
+    for (offset = chains[bucket]; offset; offset = rule->charsnext)
+      {
+	rule = (TranslationTableRule *) & table->ruleArea[offset];
+	numEntries++;
+	numChars += rule->charslen;
+      }
+  if (!numEntries)
+    return 1;
+  memset (&builder, 0, sizeof (builder));
+  if (!(builder.entries = malloc (numEntries * sizeof (TrieEntry)))
+      || !(chars = malloc (numChars * CHARSIZE)))
+    outOfMemory ();
+  numEntries = numChars = 0;
+  for (bucket = 0; bucket < count; bucket++)
+    for (offset = chains[bucket]; offset; offset = rule->charsnext)
+      {
+	rule = (TranslationTableRule *) & table->ruleArea[offset];
+	if (rule->charslen < 2)
+	  continue;
+	memcpy (&chars[numChars],
+		&rule->charsdots[rule->charslen + rule->dotslen],
+		rule->charslen * CHARSIZE);
+	if (forRuleChain (&chars[numChars]) != &chains[bucket])
+	  continue;
+	builder.entries[numEntries].rule = offset;
+	builder.entries[numEntries].sequence = numEntries;
+	builder.entries[numEntries].length = rule->charslen;
+	builder.entries[numEntries].chars = &chars[numChars];
+	numChars += rule->charslen;
+	numEntries++;
+      }
+  /* Rules with the same characters are next to each other once sorted */
+  qsort (builder.entries, numEntries, sizeof (TrieEntry),
+	 compareTrieEntries);
+  if (!(words = malloc ((numEntries + 1) * OFFSETSIZE))
+      || !(indexed = calloc (numEntries + 1, 1)))
+    outOfMemory ();
+  for (k = numWords = 0; k < numEntries; k++)
     {
-      TranslationTableOpcode opcode;
-      for (opcode = 0; opcode < CTO_None; opcode++)
-	opcodeLengths[opcode] = strlen (opcodeNames[opcode]);
+      for (m = k - 1; m <= k + 1; m += 2)
+	if (m >= 0 && m < numEntries
+	    && builder.entries[m].length == builder.entries[k].length
+	    && !memcmp (builder.entries[m].chars, builder.entries[k].chars,
+			builder.entries[k].length * CHARSIZE))
+	  break;
+      if (m > k + 1 && isIndexableWord ((TranslationTableRule *) &
+					 table->ruleArea[builder.entries
+							 [k].rule]))
+	{
+	  indexed[k] = 1;
+	  words[numWords++] = builder.entries[k].rule;
+	}
     }
-  allocateHeader (NULL);
-  /* Compile things that are necesary for the proper operation of 
-     liblouis or liblouisxml or liblouisutdml */
-  compileString ("space \\s 0");
-  compileString ("noback sign \\x0000 0");
-  compileString ("space \\x00a0 a unbreakable space");
-  compileString ("space \\x001b 1b escape");
-  compileString ("space \\xffff 123456789abcdef ENDSEGMENT");
-  
-  /* Compile all subtables in the list */
-  if (!(tableFiles = resolveTable (tableList, NULL)))
+  /* The trie is left with the other rules, unless none are left */
+  if (numWords >= MINWORDINDEX && numWords < numEntries
+      && buildWordIndex (words, numWords))
+    {
+      for (k = m = 0; k < numEntries; k++)
+	if (!indexed[k])
+	  builder.entries[m++] = builder.entries[k];
+      numEntries = m;
+    }
+  free (indexed);
+  free (words);
+  result = storeTrie (&builder, numEntries, numChars, &table->forRuleTrie);
+  /* for_selectRule looks at the filter before walking the trie */
+  if (!(pairs = malloc (numEntries * 2 * CHARSIZE)))
+    outOfMemory ();
+  for (k = 0; k < numEntries; k++)
+    {
+      pairs[2 * k] = builder.entries[k].chars[0];
+      pairs[2 * k + 1] = builder.entries[k].chars[1];
+    }
+  if (result)
+    result = buildRuleFilter (pairs, numEntries, &table->forRuleFilter,
+			      &table->forRuleFilterBits);
+  free (pairs);
+  free (chars);
+  free (builder.entries);
+  return result;
+}
+
+static int
+buildBackRuleFilter ()
+{
+/* Make the filter of the first two cells of the rules in the backRules 
+* chains, which back_selectRule looks at before walking the chain or the 
+* trie. There is none while backward rules are left out of the table. */
+  TranslationTableOffset offset;
+  TranslationTableRule *rule;
+  widechar *pairs;
+  int numPairs = 0, bucket, result;
+  table->backRuleFilter = 0;
+  if (numDeferredBackRules || table->lazyBackRules)
+    return 1;
+  for (bucket = 0; bucket < HASHNUM; bucket++)
+    for (offset = table->backRules[bucket]; offset; offset = rule->dotsnext)
+      {
+	rule = (TranslationTableRule *) & table->ruleArea[offset];
+	/* A rule of one cell could match any second cell */
+	if (rule->dotslen < 2)
+	  return 1;
+	numPairs++;
+      }
+  if (!numPairs)
+    return 1;
+  if (!(pairs = malloc (numPairs * 2 * CHARSIZE)))
+    outOfMemory ();
+  numPairs = 0;
+  for (bucket = 0; bucket < HASHNUM; bucket++)
+    for (offset = table->backRules[bucket]; offset; offset = rule->dotsnext)
+      {
+	rule = (TranslationTableRule *) & table->ruleArea[offset];
+	pairs[2 * numPairs] = rule->charsdots[rule->charslen];
+	pairs[2 * numPairs++ + 1] = rule->charsdots[rule->charslen + 1];
+      }
+  result = buildRuleFilter (pairs, numPairs, &offset,
+			    &table->backRuleFilterBits);
+  if (result)
+    table->backRuleFilter = offset;
+  free (pairs);
+  return result;
+}
+
+static int
+buildBackRuleTrie ()
+{
+/* Make a trie of the dots of the rules in the backRules chains, for 
+* back_selectRule. The chains are ordered by the length of the dots and 
+* characters together, not of the dots alone, so each rule keeps its 
+* place in its chain and the rules found in one walk, which all come 
+* from the same chain, are tried in that order. As for forward rules, 
+* a rule goes in only if the lowercase of its first two cells hashes to 
+* its chain. Nothing is made while backward rules are left out of the 
+* table, see lou_setLazyCompilation, or when the chains are short. */
+  TrieBuilder builder;
+  int numEntries = 0, numChars = 0, chainLength;
+  double chainWeight = 0;
+  TranslationTableOffset offset;
+  TranslationTableRule *rule;
+  TranslationTableCharacter *character;
+  const widechar *dots;
+  widechar lower[2];
+  int bucket, k;
+  table->backRuleTrie = 0;
+  if (numDeferredBackRules || table->lazyBackRules)
+    return 1;
+  for (bucket = 0; bucket < HASHNUM; bucket++)
+    {
+      chainLength = 0;
+      for (offset = table->backRules[bucket]; offset;
+	   offset = rule->dotsnext)
+	{
+	  rule = (TranslationTableRule *) & table->ruleArea[offset];
+	  chainLength++;
+	  numChars += rule->dotslen;
+	}
+      numEntries += chainLength;
+      chainWeight += (double) chainLength * chainLength;
+    }
+  /* Taking each rule to be met as often, a lookup walks a chain as often 
+   * as it has rules */
+  if (!numEntries || chainWeight < (double) BACKTRIECHAIN * numEntries)
+    return 1;
+  memset (&builder, 0, sizeof (builder));
+  builder.maxDepth = BACKTRIEDEPTH;
+  builder.sequenced = 1;
+  if (!(builder.entries = malloc (numEntries * sizeof (TrieEntry))))
+    outOfMemory ();
+  numEntries = numChars = 0;
+  for (bucket = 0; bucket < HASHNUM; bucket++)
+    for (k = 0, offset = table->backRules[bucket]; offset;
+	 offset = rule->dotsnext, k++)
+      {
+	rule = (TranslationTableRule *) & table->ruleArea[offset];
+	dots = &rule->charsdots[rule->charslen];
+	/* back_findCharOrDots gives B16 for dots it does not know */
+	character = compile_findCharOrDots (dots[0], 1);
+	lower[0] = character ? character->lowercase : B16;
+	character = compile_findCharOrDots (dots[1], 1);
+	lower[1] = character ? character->lowercase : B16;
+	if ((((unsigned long int) lower[0] << 8) + lower[1]) % HASHNUM !=
+	    bucket)
+	  continue;
+	builder.entries[numEntries].rule = offset;
+	builder.entries[numEntries].sequence = k;
+	builder.entries[numEntries].length = rule->dotslen;
+	/* The trie is made before the table can move */
+	builder.entries[numEntries].chars = dots;
+	numChars += rule->dotslen;
+	numEntries++;
+      }
+  k = storeTrie (&builder, numEntries, numChars, &table->backRuleTrie);
+  free (builder.entries);
+  return k;
+}
+
+static void
+makePassRuleGuard (const TranslationTableRule * rule, PassRuleGuard * guard)
+{
+/* Find what the first character must be for the test of the pass rule 
+* to succeed, from the first instruction which looks at it. Tests which 
+* may not start at that character, such as ones beginning with a 
+* lookback or a search, get no guard. */
+  const widechar *instructions = &rule->charsdots[rule->charslen];
+  const TranslationTableRule *group;
+  int passCharDots = !(rule->opcode == CTO_Context
+		       || rule->opcode == CTO_Correct);
+  int k = 0;
+  guard->attributes = 0;
+  guard->swapRule = 0;
+  guard->ch = 0;
+  while (k < rule->dotslen)
+    switch (instructions[k])
+      {
+      case pass_not:
+	/* A test of a variable or of the position looks at no 
+	 * character whether or not it is negated */
+	switch (k + 1 < rule->dotslen ? instructions[k + 1] : pass_not)
+	  {
+	  case pass_first:
+	  case pass_last:
+	  case pass_eq:
+	  case pass_lt:
+	  case pass_gt:
+	  case pass_lteq:
+	  case pass_gteq:
+	    k++;
+	    break;
+	  default:
+	    return;
+	  }
+	break;
+      case pass_first:
+      case pass_last:
+      case pass_startReplace:
+      case pass_endReplace:
+	k++;
+	break;
+      case pass_eq:
+      case pass_lt:
+      case pass_gt:
+      case pass_lteq:
+      case pass_gteq:
+	k += 3;
+	break;
+      case pass_string:
+      case pass_dots:
+	if (instructions[k + 1])
+	  guard->ch = instructions[k + 2];
+	return;
+      case pass_attributes:
+	if (instructions[k + 3])
+	  guard->attributes = (instructions[k + 1] << 16) |
+	    instructions[k + 2];
+	return;
+      case pass_groupstart:
+      case pass_groupend:
+	group = (TranslationTableRule *) & table->ruleArea
+	  [(instructions[k + 1] << 16) | instructions[k + 2]];
+	guard->ch = group->charsdots[2 * passCharDots +
+				     (instructions[k] == pass_groupend)];
+	return;
+      case pass_swap:
+	if (instructions[k + 3])
+	  guard->swapRule = (instructions[k + 1] << 16) | instructions[k + 2];
+	return;
+      default:
+	return;
+      }
+}
+
+static int
+buildPassRuleGuards ()
+{
+/* Make for each pass the list of the guards of the rules in its 
+* attribOrSwapRules chain, in the order of the chain, so that 
+* findAttribOrSwapRules runs the test of a rule only at the characters 
+* it can match. */
+  const int guardSize = sizeof (PassRuleGuard) / SLOTSIZE;
+  TranslationTableOffset offset, guards;
+  TranslationTableRule *rule;
+  PassRuleGuard *guard;
+  int pass, numRules;
+  for (pass = 0; pass < 5; pass++)
+    {
+      table->passRuleGuards[pass] = 0;
+      numRules = 0;
+      for (offset = table->attribOrSwapRules[pass]; offset;
+	   offset = rule->charsnext)
+	{
+	  rule = (TranslationTableRule *) & table->ruleArea[offset];
+	  numRules++;
+	}
+      if (!numRules)
+	continue;
+      if (!allocateSpaceInTable (NULL, &guards,
+				 (numRules + 1) * sizeof (PassRuleGuard)))
+	return 0;
+      numRules = 0;
+      for (offset = table->attribOrSwapRules[pass]; offset;
+	   offset = rule->charsnext)
+	{
+	  rule = (TranslationTableRule *) & table->ruleArea[offset];
+	  guard = (PassRuleGuard *) & table->ruleArea[guards +
+						      numRules++ * guardSize];
+	  guard->rule = offset;
+	  makePassRuleGuard (rule, guard);
+	}
+      guard = (PassRuleGuard *) & table->ruleArea[guards +
+						  numRules * guardSize];
+      memset (guard, 0, sizeof (PassRuleGuard));
+      table->passRuleGuards[pass] = guards;
+    }
+  return 1;
+}
+
+static void
+markPassStart (PassStartFilter * filter, widechar c)
+{
+  filter->chars[(c & 0xff) >> 3] |= 1 << (c & 7);
+}
+
+static void
+addPassStart (const TranslationTableRule * rule)
+{
+/* Record in the filter of the pass of a rule the characters at which 
+* the rule may begin to match. A rule whose test begins with its 
+* characters is found through them; for any other rule the guard of 
+* its test tells. */
+  PassStartFilter *filter;
+  const TranslationTableCharacter *character;
+  const TranslationTableRule *swapRule;
+  PassRuleGuard guard;
+  int k, step;
+  switch (rule->opcode)
+    {
+    case CTO_Correct:
+      filter = &table->passStarts[0];
+      break;
+    case CTO_Pass2:
+      filter = &table->passStarts[2];
+      break;
+    case CTO_Pass3:
+      filter = &table->passStarts[3];
+      break;
+    case CTO_Pass4:
+      filter = &table->passStarts[4];
+      break;
+    default:
+      return;
+    }
+  if (rule->charslen)
+    {
+      markPassStart (filter, rule->charsdots[0]);
+      if (rule->opcode == CTO_Correct
+	  && (character = compile_findCharOrDots (rule->charsdots[0], 0)))
+	markPassStart (filter, character->lowercase);
+      return;
+    }
+  makePassRuleGuard (rule, &guard);
+  if (guard.ch)
+    markPassStart (filter, guard.ch);
+  else if (guard.swapRule)
+    {
+      swapRule = (TranslationTableRule *) & table->ruleArea[guard.swapRule];
+      step = swapRule->opcode == CTO_SwapDd ? 2 : 1;
+      for (k = step - 1; k < swapRule->charslen; k += step)
+	markPassStart (filter, swapRule->charsdots[k]);
+    }
+  else if (guard.attributes)
+    filter->attributes |= guard.attributes;
+  else
+    filter->anywhere = 1;
+}
+
+static void
+buildPassStartFilters ()
+{
+/* Make the filters with which a translation skips the passes none of 
+* whose rules can match its text. The first pass is never skipped. */
+  TranslationTableCharacter *character;
+  TranslationTableRule *rule;
+  TranslationTableOffset offset, bucket;
+  TranslationTableOffset *chains;
+  int count, k;
+  memset (table->passStarts, 0, sizeof (table->passStarts));
+  table->passStarts[1].anywhere = 1;
+  for (k = 0; k < 5; k++)
+    for (offset = table->attribOrSwapRules[k]; offset;
+	 offset = rule->charsnext)
+      {
+	rule = (TranslationTableRule *) & table->ruleArea[offset];
+	addPassStart (rule);
+      }
+  chains = forRuleChains (&count);
+  for (k = 0; k < count; k++)
+    for (offset = chains[k]; offset; offset = rule->charsnext)
+      {
+	rule = (TranslationTableRule *) & table->ruleArea[offset];
+	addPassStart (rule);
+      }
+  for (k = 0; k < HASHNUM; k++)
+    {
+      for (bucket = table->characters[k]; bucket; bucket = character->next)
+	{
+	  character = (TranslationTableCharacter *) & table->ruleArea[bucket];
+	  for (offset = character->otherRules; offset;
+	       offset = rule->charsnext)
+	    {
+	      rule = (TranslationTableRule *) & table->ruleArea[offset];
+	      addPassStart (rule);
+	    }
+	}
+      for (bucket = table->dots[k]; bucket; bucket = character->next)
+	{
+	  character = (TranslationTableCharacter *) & table->ruleArea[bucket];
+	  for (offset = character->otherRules; offset;
+	       offset = rule->charsnext)
+	    {
+	      rule = (TranslationTableRule *) & table->ruleArea[offset];
+	      addPassStart (rule);
+	    }
+	}
+    }
+}
+
+static int
+collectSyllableRules (SyllableRule * rules, widechar * pairs, int chars)
+{
+/* The syllable rules markSyllables tries, or their number if rules is 
+* NULL: if chars is 0 those of the forRules chains in the order of the 
+* chains, which keeps the order of the rules with the same first two 
+* characters as they share a chain, with these characters in pairs, 
+* else the first one in the otherRules of each character. */
+  TranslationTableCharacter *character;
+  TranslationTableRule *rule;
+  TranslationTableOffset offset, bucket;
+  TranslationTableOffset *chains;
+  widechar c;
+  int count, numRules = 0, k;
+  if (!chars)
+    {
+      chains = forRuleChains (&count);
+      for (k = 0; k < count; k++)
+	for (offset = chains[k]; offset; offset = rule->charsnext)
+	  {
+	    rule = (TranslationTableRule *) & table->ruleArea[offset];
+	    if (rule->opcode != CTO_Syllable || rule->charslen < 2)
+	      continue;
+	    if (rules)
+	      {
+		rules[numRules].rule = offset;
+		rules[numRules].character = 0;
+		memcpy (&pairs[2 * numRules],
+			&rule->charsdots[rule->charslen + rule->dotslen],
+			2 * CHARSIZE);
+	      }
+	    numRules++;
+	  }
+      return numRules;
+    }
+  for (k = 0; k < HASHNUM; k++)
+    for (bucket = table->characters[k]; bucket; bucket = character->next)
+      {
+	character = (TranslationTableCharacter *) & table->ruleArea[bucket];
+	for (offset = character->otherRules; offset;
+	     offset = rule->charsnext)
+	  {
+	    rule = (TranslationTableRule *) & table->ruleArea[offset];
+	    if (rule->opcode == CTO_Syllable)
+	      break;
+	  }
+	if (!offset)
+	  continue;
+	if (rules)
+	  {
+	    rules[numRules].rule = offset;
+	    rules[numRules].character = bucket;
+	    c = character->realchar;
+	    table->syllableChars[(c & 0xff) >> 3] |= 1 << (c & 7);
+	  }
+	numRules++;
+      }
+  return numRules;
+}
+
+static int
+buildSyllableRules ()
+{
+/* Gather the syllable rules, so that markSyllables need not walk the 
+* chains of rules at every character to find them */
+  TranslationTableOffset offset, filter;
+  widechar *pairs;
+  int numRules, numChars, result;
+  table->syllableRules = table->syllableFilter = 0;
+  table->numSyllableRules = table->numSyllableChars = 0;
+  memset (table->syllableChars, 0, sizeof (table->syllableChars));
+  if (!table->syllables)
+    return 1;
+  numRules = collectSyllableRules (NULL, NULL, 0);
+  numChars = collectSyllableRules (NULL, NULL, 1);
+  if (!numRules && !numChars)
+    return 1;
+  if (!allocateSpaceInTable (NULL, &offset, (numRules + numChars) *
+			     sizeof (SyllableRule)))
+    return 0;
+  if (!(pairs = malloc ((numRules + 1) * 2 * CHARSIZE)))
+    outOfMemory ();
+  collectSyllableRules ((SyllableRule *) & table->ruleArea[offset], pairs,
+			0);
+  collectSyllableRules ((SyllableRule *) & table->ruleArea[offset] +
+			numRules, NULL, 1);
+  result = !numRules || buildRuleFilter (pairs, numRules, &filter,
+					 &table->syllableFilterBits);
+  free (pairs);
+  if (!result)
+    return 0;
+  table->syllableRules = offset;
+  table->numSyllableRules = numRules;
+  table->numSyllableChars = numChars;
+  if (numRules)
+    table->syllableFilter = filter;
+  return 1;
+}
+
+static int
+buildCompCells ()
+{
+/* Record the cell doCompTrans puts for each character below 256, from 
+* its compdots rule or else from its definition, so that a run of them 
+* is put at once. A character put as more than one cell, or undefined, 
+* is left to the rules. The cells of a table are filled in anew when 
+* rules are added, where they are. */
+  TranslationTableCharacter *character;
+  TranslationTableRule *rule;
+  TranslationTableOffset offset;
+  widechar *cells;
+  int c;
+  if (!table->compCells)
+    {
+      if (!allocateSpaceInTable (NULL, &offset, 256 * CHARSIZE))
+	return 0;
+      table->compCells = offset;
+    }
+  cells = (widechar *) & table->ruleArea[table->compCells];
+  for (c = 0; c < 256; c++)
+    {
+      cells[c] = 0;
+      if ((offset = table->compdotsPattern[c]))
+	{
+	  rule = (TranslationTableRule *) & table->ruleArea[offset];
+	  if (rule->charslen == 1 && rule->dotslen == 1)
+	    cells[c] = rule->charsdots[1];
+	  continue;
+	}
+      if (!(character = compile_findCharOrDots (c, 0))
+	  || !character->definitionRule)
+	continue;
+      rule = (TranslationTableRule *)
+	& table->ruleArea[character->definitionRule];
+      if (rule->dotslen == 1)
+	cells[c] = rule->charsdots[1];
+      else if (!rule->dotslen)
+	cells[c] = getDotsForCharInTable (table, c);
+    }
+  return 1;
+}
+
+static void
+markFastLetters ()
+{
+/* Record in fastDots the cell of every letter or digit which 
+* translateString may copy without selecting a rule: a letter neither 
+* upper case nor of another class, whose only rule is its own one-cell 
+* definition with no before or after condition, or a digit of no other 
+* class than litdigit whose first rule is such a definition, since that 
+* is always chosen, and with which no rule of the trie begins. Without 
+* the trie nothing is marked. */
+  const ForRuleNode *root = NULL;
+  const ForRuleEdge *edges = NULL;
+  TranslationTableCharacter *character;
+  TranslationTableRule *rule;
+  TranslationTableOffset bucket;
+  int k, m;
+  if (table->forRuleTrie)
+    {
+      root = (ForRuleNode *) & table->ruleArea[table->forRuleTrie];
+      edges = (ForRuleEdge *) & table->ruleArea[root->children];
+      if (root->numRules)
+	root = NULL;
+    }
+  for (k = 0; k < HASHNUM; k++)
+    for (bucket = table->characters[k]; bucket; bucket = character->next)
+      {
+	character = (TranslationTableCharacter *) & table->ruleArea[bucket];
+	character->fastDots = 0;
+	if (!root || !character->otherRules)
+	  continue;
+	rule = (TranslationTableRule *) &
+	  table->ruleArea[character->otherRules];
+	if ((character->attributes & CTC_Letter)
+	    && !(character->attributes & ~(CTC_Letter | CTC_LowerCase)))
+	  {
+	    if ((rule->opcode != CTO_Letter && rule->opcode != CTO_LowerCase)
+		|| rule->charsnext)
+	      continue;
+	  }
+	else if ((character->attributes & CTC_Digit)
+		 && !(character->attributes & ~(CTC_Digit | CTC_LitDigit)))
+	  {
+	    if (rule->opcode != CTO_Digit && rule->opcode != CTO_LitDigit)
+	      continue;
+	  }
+	else
+	  continue;
+	if (rule->before || rule->after
+	    || rule->charslen != 1 || rule->dotslen != 1)
+	  continue;
+	for (m = 0; m < root->numChildren; m++)
+	  if (edges[m].ch == character->lowercase)
+	    break;
+	if (m == root->numChildren)
+	  character->fastDots = rule->charsdots[1];
+      }
+}
+
+static int
+setDefaults ()
+{
+  if (!table->lenBeginCaps)
+    table->lenBeginCaps = 2;
+  makeDoubleRule (CTO_FirstWordItal, &table->lastWordItalBefore,
+		  &table->firstWordItal);
+  if (!table->lenItalPhrase)
+    table->lenItalPhrase = 4;
+  makeDoubleRule (CTO_FirstWordBold, &table->lastWordBoldBefore,
+		  &table->firstWordBold);
+  if (!table->lenBoldPhrase)
+    table->lenBoldPhrase = 4;
+  makeDoubleRule (CTO_FirstWordUnder, &table->lastWordUnderBefore,
+		  &table->firstWordUnder);
+  if (!table->lenUnderPhrase)
+    table->lenUnderPhrase = 4;
+  if (table->numPasses == 0)
+    table->numPasses = 1;
+  return 1;
+}
+
+/* Freezing builds what translation reads in place of the chains the 
+* rules were linked into while compiling: the character indexes, the 
+* tries of rules and their filters, the fast letters and the guards of 
+* the passes. It is the one place they are built, after the defaults 
+* are set and before the table is trimmed and shared. A table that is 
+* frozen is only read, except through lou_compileString, which freezes 
+* it again. */
+
+#define FREEZE_ALL 0		/*the table was compiled */
+#define FREEZE_COMPLETED 1	/*a lazy part was compiled */
+#define FREEZE_ADDED 2		/*rules were added to a frozen table */
+
+static int
+freezeTable (int how)
+{
+  int ok, k;
+  switch (how)
+    {
+    case FREEZE_ALL:
+      if (!buildCharacterIndex (0) || !buildCharacterIndex (1))
+	return 0;
+      buildForRuleBuckets ();
+      foldForRules ();
+      orderForRules ();
+      buildForRuleTrie ();
+      buildBackRuleTrie ();
+      buildBackRuleFilter ();
+      markFastLetters ();
+      buildPassRuleGuards ();
+      buildPassStartFilters ();
+      return buildSyllableRules () && buildCompCells ();
+    case FREEZE_COMPLETED:
+      if (!table->backRuleTrie)
+	{
+	  buildBackRuleTrie ();
+	  buildBackRuleFilter ();
+	}
+      return buildCharacterIndex (0) && buildCharacterIndex (1);
+    case FREEZE_ADDED:
+      /* for_selectRule goes back to the chains rather than leave a new 
+       * rule out */
+      if (forRulesLinked)
+	table->forRuleTrie = table->forRuleFilter = table->wordIndex = 0;
+      /* and so does back_selectRule */
+      if (backRulesLinked || numDeferredBackRules)
+	table->backRuleTrie = table->backRuleFilter = 0;
+      /* and findAttribOrSwapRules to the chains, and no pass is skipped */
+      if (passRulesLinked)
+	{
+	  memset (table->passRuleGuards, 0, sizeof (table->passRuleGuards));
+	  for (k = 0; k < 5; k++)
+	    table->passStarts[k].anywhere = 1;
+	}
+      /* The new rule may have defined characters, and changed what some 
+       * characters are in lowercase */
+      ok = buildCharacterIndex (0) && buildCharacterIndex (1);
+      if (ok)
+	foldForRules ();
+      markFastLetters ();
+      /* The new rule may be a syllable rule, or define a character */
+      if (ok)
+	ok = buildSyllableRules () && buildCompCells ();
+      return ok;
+    }
+  return 0;
+}
+
+/* =============== *
+ * TABLE RESOLVING *
+ * =============== *
+ *
+ * A table resolver is a function that resolves a `tableList` path against a
+ * `base` path, and returns the resolved table(s) as a list of absolute file
+ * paths.
+ *
+ * The function must have the following signature:
+ *
+ *     char ** (const char * tableList, const char * base)
+ *
+ * In general, `tableList` is a path in the broad sense. The default
+ * implementation accepts only *file* paths. But another implementation could
+ * for instance handle URI's. `base` is always a file path however.
+ *
+ * The idea is to give other programs that use liblouis the ability to define
+ * their own table resolver (in C, Java, Python, etc.) when the default
+ * resolver is not satisfying. (see also lou_registerTableResolver)
+ *
+ */
+
+/* The subtables resolved are remembered, so that the same name from 
+* the same directory is not looked for again with a stat of every 
+* candidate. The entries hold for one search path, and are forgotten 
+* when the search path or the resolver changes, when lou_setDataPath is 
+* called and by lou_free. A file found by a name relative to the 
+* current directory is not remembered. */
+
+#define RESOLVEDHASHNUM 127
+
+typedef struct ResolvedTable
+{
+  struct ResolvedTable *next;
+  char *name;
+  char *directory;		/*of the base, or "" if there was none */
+  char *fileName;
+} ResolvedTable;
+
+static ResolvedTable *resolvedTables[RESOLVEDHASHNUM];
+static char *resolvedSearchPath = NULL;
+
+static unsigned int
+resolvedHash (const char *name, const char *directory)
+{
+  unsigned long int makeHash = 5381;
+  for (; *name; name++)
+    makeHash = (makeHash << 5) + makeHash + (unsigned char) *name;
+  for (; *directory; directory++)
+    makeHash = (makeHash << 5) + makeHash + (unsigned char) *directory;
+  return makeHash % RESOLVEDHASHNUM;
+}
+
+static void
+forgetResolvedTablesLocked ()
+{
+  ResolvedTable *entry;
+  int bucket;
+  for (bucket = 0; bucket < RESOLVEDHASHNUM; bucket++)
+    while ((entry = resolvedTables[bucket]))
+      {
+	resolvedTables[bucket] = entry->next;
+	free (entry->name);
+	free (entry->directory);
+	free (entry->fileName);
+	free (entry);
+      }
+  free (resolvedSearchPath);
+  resolvedSearchPath = NULL;
+}
+
+static void
+forgetResolvedTables ()
+{
+  lockResolved ();
+  forgetResolvedTablesLocked ();
+  unlockResolved ();
+}
+
+static void
+useSearchPath (const char *searchPath)
+{
+/* Forget the subtables resolved with another search path */
+  lockResolved ();
+  if (resolvedSearchPath == NULL || strcmp (resolvedSearchPath, searchPath))
+    {
+      forgetResolvedTablesLocked ();
+      if (!(resolvedSearchPath = strdup (searchPath)))
+	outOfMemory ();
+    }
+  unlockResolved ();
+}
+
+static char *
+findResolvedTable (const char *name, const char *directory)
+{
+  ResolvedTable *entry;
+  char *fileName = NULL;
+  lockResolved ();
+  for (entry = resolvedTables[resolvedHash (name, directory)]; entry;
+       entry = entry->next)
+    if (!strcmp (entry->name, name) && !strcmp (entry->directory, directory))
+      {
+	if (!(fileName = strdup (entry->fileName)))
+	  outOfMemory ();
+	break;
+      }
+  unlockResolved ();
+  return fileName;
+}
+
+static void
+rememberResolvedTable (const char *name, const char *directory,
+		       const char *fileName)
+{
+  ResolvedTable *entry;
+  unsigned int bucket = resolvedHash (name, directory);
+  if (!(entry = malloc (sizeof (*entry)))
+      || !(entry->name = strdup (name))
+      || !(entry->directory = strdup (directory))
+      || !(entry->fileName = strdup (fileName)))
+    outOfMemory ();
+  lockResolved ();
+  entry->next = resolvedTables[bucket];
+  resolvedTables[bucket] = entry;
+  unlockResolved ();
+}
+
+/**
+ * Resolve a single (sub)table.
+ * 
+ * Tries to resolve `table` against `base` if base is an absolute path. If
+ * that fails, searches `searchPath`.
+ *
+ */
+static char *
+resolveSubtable (const char *table, const char *base, const char *searchPath)
+{
+  char *tableFile;
+  char directory[MAXSTRING];
+  struct stat info;
+  
+  if (table == NULL || table[0] == '\0')
+    return NULL;
+  directory[0] = '\0';
+  if (base)
+    {
+      int k;
+      strcpy (directory, base);
+      for (k = strlen (directory); k >= 0 && directory[k] != DIR_SEP; k--)
+	;
+      directory[++k] = '\0';
+    }
+  if ((tableFile = findResolvedTable (table, directory)))
+    return tableFile;
+  tableFile = (char *) malloc (MAXSTRING * sizeof(char));
+  
+  //
+  // First try to resolve against base
+  //
+  if (base)
+    {
+      strcpy (tableFile, directory);
+      strcat (tableFile, table);
+      if (stat (tableFile, &info) == 0 && !(info.st_mode & S_IFDIR))
+	{
+	  if (directory[0])
+	    rememberResolvedTable (table, directory, tableFile);
+	  return tableFile;
+	}
+    }
+  
+  //
+  // It could be an absolute path, or a path relative to the current working
+  // directory
+  //
+  strcpy (tableFile, table);
+  if (stat (tableFile, &info) == 0 && !(info.st_mode & S_IFDIR))
+    {
+      if (table[0] == DIR_SEP)
+	rememberResolvedTable (table, directory, tableFile);
+      return tableFile;
+    }
+  
+  //
+  // Then search `LOUIS_TABLEPATH`, `dataPath` and `programPath`
+  //
+  if (searchPath[0] != '\0')
+    {
+      char *dir;
+      int last;
+      char *cp;
+      char *searchPath_copy = strdup (searchPath + 1);
+      for (dir = searchPath_copy; ; dir = cp + 1)
+	{
+	  for (cp = dir; *cp != '\0' && *cp != ','; cp++)
+	    ;
+	  last = (*cp == '\0');
+	  *cp = '\0';
+	  if (dir == cp)
+	    dir = ".";
+	  sprintf (tableFile, "%s%c%s", dir, DIR_SEP, table);
+	  if (stat (tableFile, &info) == 0 && !(info.st_mode & S_IFDIR)) 
+	    {
+	      free(searchPath_copy);
+	      rememberResolvedTable (table, directory, tableFile);
+	      return tableFile;
+	    }
+	  if (last)
+	    break;
+	}
+      free(searchPath_copy);
+    }
+  free (tableFile);
+  return NULL;
+}
+
+char *
+getTablePath()
+{
+  char searchPath[MAXSTRING];
+  char *path;
+  char *cp;
+  cp = searchPath;
+  path = getenv ("LOUIS_TABLEPATH");
+  if (path != NULL && path[0] != '\0')
+    cp += sprintf (cp, ",%s", path);
+  path = lou_getDataPath ();
+  if (path != NULL && path[0] != '\0')
+    cp += sprintf (cp, ",%s%c%s%c%s", path, DIR_SEP, "liblouis", DIR_SEP,
+		   "tables");
+#ifdef _WIN32
+  path = lou_getProgramPath ();
+  if (path != NULL && path[0] != '\0')
+    cp += sprintf (cp, ",%s%s", path, "\\share\\liblouis\\tables");
+#else
+  cp += sprintf (cp, ",%s", TABLESDIR);
+#endif
+  return strdup(searchPath);
+}
+
+/**
+ * The default table resolver
+ *
+ * Tries to resolve tableList against base. The search path is set to
+ * `LOUIS_TABLEPATH`, `dataPath` and `programPath` (in that order).
+ *
+ * @param table A file path, may be absolute or relative. May be a list of
+ *              tables separated by comma's. In that case, the first table
+ *              is used as the base for the other subtables.
+ * @param base A file path or directory path, or NULL.
+ * @return The file paths of the resolved subtables, or NULL if the table
+ *         could not be resolved.
+ *
+ */
+static char **
+defaultTableResolver (const char *tableList, const char *base)
+{
+  char * searchPath;
+  char **tableFiles;
+  char *subTable;
+  char *tableList_copy;
+  char *cp;
+  int last;
+  int k;
+  
+  /* Set up search path */
+  searchPath = getTablePath();
+  useSearchPath (searchPath);
+  
+  /* Count number of subtables in table list */
+  k = 0;
+  for (cp = (char *)tableList; *cp != '\0'; cp++)
+    if (*cp == ',')
+      k++;
+  tableFiles = (char **) malloc ((k + 2) * sizeof(char *));
+  
+  /* Resolve subtables */
+  k = 0;
+  tableList_copy = strdup (tableList);
+  for (subTable = tableList_copy; ; subTable = cp + 1)
+    {
+      for (cp = subTable; *cp != '\0' && *cp != ','; cp++);
+      last = (*cp == '\0');
+      *cp = '\0';
+      if (!(tableFiles[k++] = resolveSubtable (subTable, base, searchPath)))
+	{
+	  logMessage (LOG_ERROR, "Cannot resolve table '%s'", subTable);
+	  free(searchPath);
+	  free(tableList_copy);
+	  free (tableFiles);
+	  return NULL;
+	}
+      if (k == 1)
+	base = subTable;
+      if (last)
+	break;
+    }
+  free(searchPath);
+  free(tableList_copy);
+  tableFiles[k] = NULL;
+  return tableFiles;
+}
+
+static char ** (* tableResolver) (const char *tableList, const char *base) =
+  &defaultTableResolver;
+
+static char **
+copyStringArray(const char ** array)
+{
+  int len;
+  char ** copy;
+  if (!array)
+    return NULL;
+  len = 0;
+  while (array[len]) len++;
+  copy = malloc((len + 1) * sizeof(char *));
+  copy[len] = NULL;
+  while (len)
+    {
+      len--;
+      copy[len] = strdup (array[len]);
+    }
+  return copy;
+}
+
+char **
+resolveTable (const char *tableList, const char *base)
+{
+  return copyStringArray((*tableResolver) (tableList, base));
+}
+
+/**
+ * Register a new table resolver. Overrides the default resolver.
+ *
+ * @param resolver The new resolver as a function pointer.
+ *
+ */
+void EXPORT_CALL
+lou_registerTableResolver (char ** (* resolver) (const char *tableList, const char *base))
+{
+  tableResolver = resolver;
+  forgetResolvedTables ();
+}
+
+static THREADLOCAL int fileCount = 0;
+
+/* Included files are compiled only once while they are unchanged. When 
+* a file is included before anything else has been compiled, the state 
+* of the compiler afterwards depends only on that file and the ones it 
+* includes, so it is saved and reused by later tables beginning with the 
+* same include, as long as the files and the way they are found stay the 
+* same. */
+
+typedef struct CompiledInclude
+{
+  struct CompiledInclude *next;
+  char *fileName;
+  char *searchPath;
+  char **(*resolver) (const char *tableList, const char *base);
+  SourceFile *files;
+  int numFiles;
+  TranslationTableHeader *table;
+  unsigned int tableSize;
+  unsigned int tableUsed;
+  struct CharacterClass *characterClasses;
+  TranslationTableCharacterAttributes characterClassAttribute;
+  struct RuleName *ruleNames;
+  struct PassName *passNames;
+} CompiledInclude;
+
+static CompiledInclude *compiledIncludes = NULL;
+static THREADLOCAL int includeDepth = 0;
+/* The files read by the current compilation */
+static THREADLOCAL SourceFile *filesRead = NULL;
+static THREADLOCAL int numFilesRead = 0;
+static THREADLOCAL int maxFilesRead = 0;
+
+static void
+addFileRead (const char *fileName, time_t modified)
+{
+  if (numFilesRead == maxFilesRead)
+    {
+      maxFilesRead = maxFilesRead ? 2 * maxFilesRead : 16;
+      if (!(filesRead = realloc (filesRead,
+				 maxFilesRead * sizeof (*filesRead))))
+	outOfMemory ();
+    }
+  if (!(filesRead[numFilesRead].fileName = strdup (fileName)))
+    outOfMemory ();
+  filesRead[numFilesRead++].modified = modified;
+}
+
+static void
+forgetFilesRead ()
+{
+  while (numFilesRead > 0)
+    free (filesRead[--numFilesRead].fileName);
+}
+
+static void
+takeFilesRead (ChainEntry * entry)
+{
+/* Hand the files read by the last compilation over to entry */
+  entry->files = filesRead;
+  entry->numFiles = numFilesRead;
+  filesRead = NULL;
+  numFilesRead = maxFilesRead = 0;
+}
+
+static void
+addFilesRead (ChainEntry * entry)
+{
+/* Add the files read while completing the table of entry to its files */
+  if (!numFilesRead)
+    return;
+  if (!(entry->files = realloc (entry->files, (entry->numFiles
+					       + numFilesRead)
+				* sizeof (*entry->files))))
+    outOfMemory ();
+  memcpy (&entry->files[entry->numFiles], filesRead,
+	  numFilesRead * sizeof (*filesRead));
+  entry->numFiles += numFilesRead;
+  numFilesRead = 0;
+}
+
+static void
+freeSourceFiles (SourceFile * files, int numFiles)
+{
+  int k;
+  for (k = 0; k < numFiles; k++)
+    free (files[k].fileName);
+  free (files);
+}
+
+static int
+sourceFilesUnchanged (const SourceFile * files, int numFiles)
+{
+  struct stat info;
+  int k;
+  for (k = 0; k < numFiles; k++)
+    if (stat (files[k].fileName, &info) != 0
+	|| info.st_mtime != files[k].modified)
+      return 0;
+  return 1;
+}
+
+static void
+recordTableFiles (char **tableFiles)
+{
+/* Record the table files when a table is mapped from an image which 
+* does not list what it was compiled from. */
+  struct stat info;
+  for (; *tableFiles; tableFiles++)
+    if (stat (*tableFiles, &info) == 0)
+      addFileRead (*tableFiles, info.st_mtime);
+}
+
+static struct CharacterClass *
+copyCharacterClasses (const struct CharacterClass *classes)
+{
+  struct CharacterClass *first = NULL;
+  struct CharacterClass **last = &first;
+  size_t size;
+  for (; classes; classes = classes->next)
+    {
+      size = sizeof (*classes) + CHARSIZE * (classes->length - 1);
+      if (!(*last = malloc (size)))
+	outOfMemory ();
+      memcpy (*last, classes, size);
+      last = &(*last)->next;
+    }
+  *last = NULL;
+  return first;
+}
+
+static struct RuleName *
+copyRuleNames (const struct RuleName *names)
+{
+  struct RuleName *first = NULL;
+  struct RuleName **last = &first;
+  size_t size;
+  for (; names; names = names->next)
+    {
+      size = sizeof (*names) + CHARSIZE * (names->length - 1);
+      if (!(*last = malloc (size)))
+	outOfMemory ();
+      memcpy (*last, names, size);
+      last = &(*last)->next;
+    }
+  *last = NULL;
+  return first;
+}
+
+static struct PassName *
+copyPassNames (const struct PassName *names)
+{
+  struct PassName *first = NULL;
+  struct PassName **last = &first;
+  size_t size;
+  for (; names; names = names->next)
+    {
+      size = sizeof (*names) + CHARSIZE * (names->length - 1);
+      if (!(*last = malloc (size)))
+	outOfMemory ();
+      memcpy (*last, names, size);
+      last = &(*last)->next;
+    }
+  *last = NULL;
+  return first;
+}
+
+static void
+freeCompiledInclude (CompiledInclude * include)
+{
+  struct CharacterClass *class;
+  struct RuleName *name;
+  struct PassName *passName;
+  while ((class = include->characterClasses))
+    {
+      include->characterClasses = class->next;
+      free (class);
+    }
+  while ((name = include->ruleNames))
+    {
+      include->ruleNames = name->next;
+      free (name);
+    }
+  while ((passName = include->passNames))
+    {
+      include->passNames = passName->next;
+      free (passName);
+    }
+  freeSourceFiles (include->files, include->numFiles);
+  free (include->searchPath);
+  free (include->fileName);
+  free (include->table);
+  free (include);
+}
+
+static void
+freeCompiledIncludes ()
+{
+  CompiledInclude *include;
+  while ((include = compiledIncludes))
+    {
+      compiledIncludes = include->next;
+      freeCompiledInclude (include);
+    }
+}
+
+static void
+saveCompiledInclude (const char *fileName, int firstFile)
+{
+/* Save the state of the compiler after compiling fileName, which was 
+* included into a fresh table. firstFile is the index in filesRead of 
+* fileName. */
+  CompiledInclude *include;
+  int k;
+  if (!(include = calloc (1, sizeof (*include))))
+    outOfMemory ();
+  if (!(include->fileName = strdup (fileName)))
+    outOfMemory ();
+  if (!(include->searchPath = getTablePath ()))
+    outOfMemory ();
+  include->resolver = tableResolver;
+  include->numFiles = numFilesRead - firstFile;
+  if (!(include->files = malloc (include->numFiles * sizeof (SourceFile))))
+    outOfMemory ();
+  for (k = 0; k < include->numFiles; k++)
+    {
+      include->files[k].modified = filesRead[firstFile + k].modified;
+      if (!(include->files[k].fileName =
+	    strdup (filesRead[firstFile + k].fileName)))
+	outOfMemory ();
+    }
+  if (!(include->table = malloc (tableUsed)))
+    outOfMemory ();
+  memcpy (include->table, table, tableUsed);
+  include->tableSize = tableSize;
+  include->tableUsed = tableUsed;
+  include->characterClasses = copyCharacterClasses (characterClasses);
+  include->characterClassAttribute = characterClassAttribute;
+  include->ruleNames = copyRuleNames (ruleNames);
+  include->passNames = copyPassNames (passNames);
+  include->next = compiledIncludes;
+  compiledIncludes = include;
+}
+
+static int
+compiledIncludeIsCurrent (const CompiledInclude * include)
+{
+/* Check that the files would still be found in the same places and 
+* that none of them has changed since. */
+  char *searchPath;
+  int same;
+  if (include->resolver != tableResolver)
+    return 0;
+  if (!(searchPath = getTablePath ()))
+    outOfMemory ();
+  same = strcmp (include->searchPath, searchPath) == 0;
+  free (searchPath);
+  return same && sourceFilesUnchanged (include->files, include->numFiles);
+}
+
+static CompiledInclude *
+findCompiledInclude (const char *fileName)
+{
+  CompiledInclude **link;
+  CompiledInclude *include;
+  for (link = &compiledIncludes; (include = *link); link = &include->next)
+    if (strcmp (include->fileName, fileName) == 0)
+      {
+	if (compiledIncludeIsCurrent (include))
+	  return include;
+	*link = include->next;
+	freeCompiledInclude (include);
+	return NULL;
+      }
+  return NULL;
+}
+
+static void
+restoreCompiledInclude (const CompiledInclude * include)
+{
+  int k;
+  discardTable ();
+  allocateTable (include->tableSize);
+  memcpy (table, include->table, include->tableUsed);
+  tableUsed = include->tableUsed;
+  deallocateCharacterClasses ();
+  characterClasses = copyCharacterClasses (include->characterClasses);
+  characterClassAttribute = include->characterClassAttribute;
+  deallocateRuleNames ();
+  ruleNames = copyRuleNames (include->ruleNames);
+  deallocatePassNames ();
+  passNames = copyPassNames (include->passNames);
+  for (k = 0; k < include->numFiles; k++)
+    addFileRead (include->files[k].fileName, include->files[k].modified);
+}
+
+/**
+ * Compile a single file
+ *
+ */
+static int
+compileFile (const char *fileName)
+{
+  FileInfo nested;
+  const CompiledInclude *include;
+  int fresh = freshTable && !lazyParts && !compileProfile
+    && !recordingLocations;
+  int firstFile = numFilesRead;
+  int parentFile, phase, opened;
+  struct stat info;
+  fileCount++;
+  if (fresh)
+    {
+      lockIncludes ();
+      if ((include = findCompiledInclude (fileName)))
+	restoreCompiledInclude (include);
+      unlockIncludes ();
+      if (include)
+	{
+	  freshTable = 0;
+	  return 1;
+	}
+    }
+  nested.fileName = fileName;
+  nested.encoding = noEncoding;
+  nested.status = 0;
+  nested.lineNumber = 0;
+  nested.bufferPos = nested.bufferLength = 0;
+  parentFile = profileEnterFile (fileName);
+  phase = profileSetPhase (profileReading);
+  opened = (nested.in = fopen (nested.fileName, "rb")) != NULL
+    && stat (nested.fileName, &info) == 0;
+  profileSetPhase (phase);
+  if (nested.in)
+    {
+      if (opened)
+	addFileRead (nested.fileName, info.st_mtime);
+      else
+	fresh = 0;
+      while (getALine (&nested))
+	{
+	  profileSetPhase (profileParsing);
+	  compileRule (&nested);
+	  profileRule (-1);
+	}
+      fclose (nested.in);
+      profileLeaveFile (parentFile);
+      if (fresh && includeDepth > 0 && !errorCount)
+	{
+	  lockIncludes ();
+	  saveCompiledInclude (fileName, firstFile);
+	  unlockIncludes ();
+	}
+      return 1;
+    }
+  else
+    logMessage (LOG_ERROR, "Cannot open table '%s'", nested.fileName);
+  profileLeaveFile (parentFile);
+  errorCount++;
+  return 0;
+}
+
+/** 
+ * Free a char** array 
+ */
+static void 
+free_tablefiles(char **tables) {
+  char **table;
+  if (!tables) return;
+  for (table = tables; *table; table++)
+    free(*table);
+  free(tables);
+}
+
+/* Precompiled table images. A compiled table contains no pointers, only 
+* offsets into ruleArea, so it can be written to a file as it is and 
+* mapped back into memory later. The image header records everything 
+* that must match for the layout to be the same. It is followed by the 
+* list of the files the table was compiled from, includes and all, and 
+* then by the table itself.
+*
+* A library built with 2-byte offsets, see OFFSETBITS, makes the same
+* layout with every offset half as wide, so its images are smaller and
+* are still read in place. offsetSize keeps an image from being mapped
+* by a library built the other way. Rules are not packed any further,
+* since a packed rule could not be read in place. */
+
+#define IMAGE_FORMAT_VERSION 17
+#define IMAGE_BYTE_ORDER 0x01020304
+
+typedef struct
+{
+  char magic[8];
+  unsigned int formatVersion;
+  unsigned int headerSize;
+  unsigned int charSize;
+  unsigned int offsetSize;
+  unsigned int attributesSize;
+  unsigned int byteOrder;
+  unsigned int bytesUsed;
+  unsigned int checksum;
+  unsigned int numDependencies;
+  unsigned int dependencySize;	/*bytes of the file list after the header */
+  char libraryVersion[24];
+} TableImageHeader;
+
+/* A file of the list, followed by its name. The names of files in the 
+* directory of the first one, which is the table itself, are kept 
+* relative to it, so that images installed with their tables still 
+* find them. */
+typedef struct
+{
+  unsigned int modified[2];	/*low and high 32 bits of the time */
+  unsigned int inTableDirectory;
+  unsigned int nameSize;	/*bytes of the name, padded to a multiple of 8 */
+} ImageDependency;
+
+#define IMAGEPADDING(size) (((size) + 7) & ~7)
+
+static const char imageMagic[8] = { 'l', 'o', 'u', 'i', 's', 't', 'b', 'l' };
+static int compiledTablesEnabled = 1;
+
+/* Set by compileTranslationTable when it maps an image rather than 
+* compiling. */
+static THREADLOCAL void *imageMapping;
+static THREADLOCAL size_t imageMappingSize;
+static THREADLOCAL int compileFromSource;	/*ignore images when reloading */
+
+void
+enableCompiledTables (int enable)
+{
+  compiledTablesEnabled = enable;
+}
+
+static unsigned int
+imageChecksum (const unsigned char *data, size_t length)
+{
+  /* FNV-1a */
+  unsigned int makeHash = 2166136261u;
+  size_t k;
+  for (k = 0; k < length; k++)
+    {
+      makeHash ^= data[k];
+      makeHash *= 16777619u;
+    }
+  return makeHash;
+}
+
+static int
+directoryLength (const char *fileName)
+{
+/* The length of the directory part of fileName, its separator included */
+  int length = strlen (fileName);
+  while (length > 0 && fileName[length - 1] != '/'
+	 && fileName[length - 1] != DIR_SEP)
+    length--;
+  return length;
+}
+
+static int
+sameModificationTime (const unsigned int *modified, time_t time)
+{
+  return modified[0] == (unsigned int) time
+    && modified[1] == (unsigned int) (time / 65536 / 65536);
+}
+
+static char *
+makeImageDependencies (const SourceFile * files, int numFiles,
+		       unsigned int *size)
+{
+/* The list of files stored in an image. It takes *size bytes. */
+  ImageDependency *dependency;
+  char *list;
+  const char *name;
+  size_t maxSize = 0;
+  int tableDirectory;
+  int k;
+  for (k = 0; k < numFiles; k++)
+    maxSize += sizeof (*dependency)
+      + IMAGEPADDING (strlen (files[k].fileName) + 1);
+  if (!(list = calloc (1, maxSize + 1)))
+    outOfMemory ();
+  tableDirectory = numFiles ? directoryLength (files[0].fileName) : 0;
+  dependency = (ImageDependency *) list;
+  for (k = 0; k < numFiles; k++)
+    {
+      name = files[k].fileName;
+      dependency->modified[0] = (unsigned int) files[k].modified;
+      dependency->modified[1] =
+	(unsigned int) (files[k].modified / 65536 / 65536);
+      if ((dependency->inTableDirectory =
+	   strncmp (name, files[0].fileName, tableDirectory) == 0))
+	name += tableDirectory;
+      dependency->nameSize = IMAGEPADDING (strlen (name) + 1);
+      strcpy ((char *) (dependency + 1), name);
+      dependency = (ImageDependency *) ((char *) (dependency + 1)
+					+ dependency->nameSize);
+    }
+  *size = (char *) dependency - list;
+  return list;
+}
+
+static int
+imageDependenciesUnchanged (const TableImageHeader * header,
+			    time_t imageTime, const char *tableFile)
+{
+/* Check that none of the files an image was made from has changed, and 
+* note them as read, so that the table is reloaded when they change. A 
+* file is taken to be unchanged if it still has the time it had then, 
+* or is older than the image, as when images are installed after their 
+* tables. */
+  const char *list = (const char *) (header + 1);
+  const ImageDependency *dependency;
+  const char *name;
+  char fileName[MAXSTRING];
+  unsigned int position = 0;
+  unsigned int k;
+  int tableDirectory = directoryLength (tableFile);
+  int firstFile = numFilesRead;
+  struct stat info;
+  for (k = 0; k < header->numDependencies; k++)
+    {
+      if (header->dependencySize - position < sizeof (*dependency))
+	break;
+      dependency = (const ImageDependency *) (list + position);
+      position += sizeof (*dependency);
+      if (dependency->nameSize == 0
+	  || header->dependencySize - position < dependency->nameSize)
+	break;
+      name = list + position;
+      position += dependency->nameSize;
+      if (name[dependency->nameSize - 1])
+	break;
+      if (dependency->inTableDirectory)
+	{
+	  if (tableDirectory + strlen (name) >= MAXSTRING)
+	    break;
+	  memcpy (fileName, tableFile, tableDirectory);
+	  strcpy (&fileName[tableDirectory], name);
+	  name = fileName;
+	}
+      if (stat (name, &info) != 0
+	  || (!sameModificationTime (dependency->modified, info.st_mtime)
+	      && info.st_mtime > imageTime))
+	break;
+      addFileRead (name, info.st_mtime);
+    }
+  if (k == header->numDependencies)
+    return 1;
+  while (numFilesRead > firstFile)
+    free (filesRead[--numFilesRead].fileName);
+  return 0;
+}
+
+static void
+makeImageHeader (TableImageHeader * header,
+		 const TranslationTableHeader * image)
+{
+  memset (header, 0, sizeof (*header));
+  memcpy (header->magic, imageMagic, sizeof (imageMagic));
+  header->formatVersion = IMAGE_FORMAT_VERSION;
+  header->headerSize = sizeof (TranslationTableHeader);
+  header->charSize = CHARSIZE;
+  header->offsetSize = OFFSETSIZE;
+  header->attributesSize = sizeof (TranslationTableCharacterAttributes);
+  header->byteOrder = IMAGE_BYTE_ORDER;
+  strncpy (header->libraryVersion, PACKAGE_VERSION,
+	   sizeof (header->libraryVersion) - 1);
+  if (image != NULL)
+    {
+      header->bytesUsed = image->bytesUsed;
+      header->checksum = imageChecksum ((const unsigned char *) image,
+					image->bytesUsed);
+    }
+}
+
+static int
+writeTableImage (const TranslationTableHeader * source, const char *fileName,
+		 const SourceFile * files, int numFiles)
+{
+/* files are those the table was compiled from */
+  TableImageHeader header;
+  TranslationTableHeader *image;
+  char *dependencies;
+  FILE *imageFile;
+  int ok;
+  /* The image holds no free space, so record its real size. */
+  if (!(image = malloc (source->bytesUsed)))
+    outOfMemory ();
+  memcpy (image, source, source->bytesUsed);
+  image->tableSize = image->bytesUsed;
+  makeImageHeader (&header, image);
+  header.numDependencies = numFiles;
+  dependencies = makeImageDependencies (files, numFiles,
+					&header.dependencySize);
+  if (!(imageFile = fopen (fileName, "wb")))
+    {
+      logMessage (LOG_ERROR, "Cannot create compiled table %s", fileName);
+      free (dependencies);
+      free (image);
+      return 0;
+    }
+  ok = fwrite (&header, sizeof (header), 1, imageFile) == 1
+    && (!header.dependencySize
+	|| fwrite (dependencies, header.dependencySize, 1, imageFile) == 1)
+    && fwrite (image, image->bytesUsed, 1, imageFile) == 1;
+  if (fclose (imageFile) != 0)
+    ok = 0;
+  free (dependencies);
+  free (image);
+  if (!ok)
+    {
+      logMessage (LOG_ERROR, "Cannot write compiled table %s", fileName);
+      remove (fileName);
+    }
+  return ok;
+}
+
+static void
+unmapTableImage (void *mapping, size_t mappingSize)
+{
+  if (mappingSize == 0)
+    return;			/*a built-in image */
+#if defined(_WIN32)
+  UnmapViewOfFile (mapping);
+#elif defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+  munmap (mapping, mappingSize);
+#else
+  free (mapping);
+#endif
+}
+
+static void *
+mapTableImage (const char *fileName, size_t * mappingSize)
+{
+/* Map a whole image file read-only. Returns NULL if it cannot be read. */
+  void *mapping = NULL;
+#if defined(_WIN32)
+  HANDLE file;
+  HANDLE fileMapping;
+  LARGE_INTEGER size;
+  file = CreateFileA (fileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+		      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return NULL;
+  if (GetFileSizeEx (file, &size) && size.QuadPart > 0)
+    {
+      fileMapping = CreateFileMappingA (file, NULL, PAGE_READONLY, 0, 0,
+					NULL);
+      if (fileMapping != NULL)
+	{
+	  mapping = MapViewOfFile (fileMapping, FILE_MAP_READ, 0, 0, 0);
+	  CloseHandle (fileMapping);
+	}
+      *mappingSize = (size_t) size.QuadPart;
+    }
+  CloseHandle (file);
+#elif defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+  int fd;
+  struct stat info;
+  if ((fd = open (fileName, O_RDONLY)) < 0)
+    return NULL;
+  if (fstat (fd, &info) == 0 && info.st_size > 0)
+    {
+      mapping = mmap (NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping == MAP_FAILED)
+	mapping = NULL;
+      *mappingSize = info.st_size;
+    }
+  close (fd);
+#else
+  FILE *imageFile;
+  long size;
+  if (!(imageFile = fopen (fileName, "rb")))
+    return NULL;
+  if (fseek (imageFile, 0, SEEK_END) == 0 && (size = ftell (imageFile)) > 0
+      && fseek (imageFile, 0, SEEK_SET) == 0)
+    {
+      if (!(mapping = malloc (size)))
+	outOfMemory ();
+      if (fread (mapping, size, 1, imageFile) != 1)
+	{
+	  free (mapping);
+	  mapping = NULL;
+	}
+      *mappingSize = size;
+    }
+  fclose (imageFile);
+#endif
+  return mapping;
+}
+
+static TranslationTableHeader *
+checkTableImage (const void *data, size_t size, int checksum)
+{
+/* Return the table of an image, or NULL if it was not made by a 
+* compatible library. The checksum is left out for images linked into 
+* the program, which cannot have been damaged on disk. */
+  TableImageHeader expected;
+  const TableImageHeader *header = data;
+  TranslationTableHeader *image;
+  if (size < sizeof (*header) || header->dependencySize % 8
+      || size - sizeof (*header) < header->dependencySize
+      + sizeof (TranslationTableHeader))
+    return NULL;
+  image = (TranslationTableHeader *) ((char *) data + sizeof (*header)
+				      + header->dependencySize);
+  makeImageHeader (&expected, NULL);
+  if (memcmp (header->magic, expected.magic, sizeof (expected.magic))
+      || header->formatVersion != expected.formatVersion
+      || header->headerSize != expected.headerSize
+      || header->charSize != expected.charSize
+      || header->offsetSize != expected.offsetSize
+      || header->attributesSize != expected.attributesSize
+      || header->byteOrder != expected.byteOrder
+      || memcmp (header->libraryVersion, expected.libraryVersion,
+		 sizeof (expected.libraryVersion))
+      || header->bytesUsed != size - sizeof (*header)
+      - header->dependencySize
+      || image->bytesUsed != header->bytesUsed
+      || (checksum
+	  && header->checksum != imageChecksum ((const unsigned char *) image,
+						header->bytesUsed)))
+    return NULL;
+  return image;
+}
+
+static TranslationTableHeader *
+loadTableImage (const char *fileName, void **mapping, size_t * mappingSize)
+{
+/* Map an image and check that it was made by a compatible library. */
+  TranslationTableHeader *image;
+  if (!(*mapping = mapTableImage (fileName, mappingSize)))
+    return NULL;
+  if (!(image = checkTableImage (*mapping, *mappingSize, 1)))
+    {
+      logMessage (LOG_WARN, "%s is not a usable compiled table", fileName);
+      unmapTableImage (*mapping, *mappingSize);
+      *mapping = NULL;
+      return NULL;
+    }
+  return image;
+}
+
+/* Built-in images. Images linked into the program as data are 
+* registered with lou_registerCompiledTable under the table list they 
+* were made from, and are then used for it as if mapped, with a mapping 
+* size of 0 so that they are never unmapped. The list is only ever 
+* added to, and lasts as long as the process. */
+
+typedef struct BuiltinTable
+{
+  struct BuiltinTable *next;
+  const void *data;
+  TranslationTableHeader *image;
+  char tableList[1];
+} BuiltinTable;
+
+static BuiltinTable *builtinTables = NULL;
+
+static const BuiltinTable *
+findBuiltinTable (const char *tableList)
+{
+  const BuiltinTable *builtin;
+  for (builtin = loadPointer (builtinTables); builtin;
+       builtin = builtin->next)
+    if (strcmp (builtin->tableList, tableList) == 0)
+      return builtin;
+  return NULL;
+}
+
+static TranslationTableHeader *
+findTableImage (const char *tableFile)
+{
+/* Look for an up to date image next to a table file. */
+  char *imageName;
+  struct stat tableInfo;
+  struct stat imageInfo;
+  TranslationTableHeader *image = NULL;
+  if (!compiledTablesEnabled || compileFromSource || compileProfile)
+    return NULL;
+  if (!(imageName = malloc (strlen (tableFile) + sizeof (IMAGE_SUFFIX))))
+    outOfMemory ();
+  strcpy (imageName, tableFile);
+  strcat (imageName, IMAGE_SUFFIX);
+  if (stat (tableFile, &tableInfo) == 0 && stat (imageName, &imageInfo) == 0
+      && imageInfo.st_mtime >= tableInfo.st_mtime)
+    {
+      image = loadTableImage (imageName, &imageMapping, &imageMappingSize);
+      if (image && !imageDependenciesUnchanged (imageMapping,
+						imageInfo.st_mtime,
+						tableFile))
+	{
+	  logMessage (LOG_DEBUG, "%s is out of date", imageName);
+	  unmapTableImage (imageMapping, imageMappingSize);
+	  imageMapping = NULL;
+	  image = NULL;
+	}
+      if (image)
+	logMessage (LOG_DEBUG, "Using compiled table %s", imageName);
+    }
+  free (imageName);
+  return image;
+}
+
+/* Shared images. When a compiled table path is set, every table list 
+* that is compiled is also written there as an image and then mapped, 
+* so that all processes using the table share one copy of it. */
+
+static char compiledTablePath[MAXSTRING];
+static char *compiledTablePathPtr;
+
+char *EXPORT_CALL
+lou_setCompiledTablePath (const char *path)
+{
+  compiledTablePathPtr = NULL;
+  if (path == NULL || strlen (path) >= MAXSTRING - 32)
+    return NULL;
+  strcpy (compiledTablePath, path);
+  compiledTablePathPtr = compiledTablePath;
+  return compiledTablePathPtr;
+}
+
+char *EXPORT_CALL
+lou_getCompiledTablePath ()
+{
+  return compiledTablePathPtr;
+}
+
+static char *
+sharedImageName (char **tableFiles)
+{
+/* The image for a list of table files, named after the first file 
+* followed by a hash of the whole list and the library version. Returns 
+* NULL if no compiled table path is set. */
+  const char *path = compiledTablePathPtr;
+  const char *base;
+  char **subTable;
+  char *imageName;
+  unsigned int makeHash;
+  if (!compiledTablesEnabled)
+    return NULL;
+  if (path == NULL && !(path = getenv ("LOUIS_COMPILEDTABLEPATH")))
+    return NULL;
+  if (!path[0] || !tableFiles[0])
+    return NULL;
+  makeHash = imageChecksum ((const unsigned char *) PACKAGE_VERSION,
+			    strlen (PACKAGE_VERSION));
+  for (subTable = tableFiles; *subTable; subTable++)
+    makeHash = makeHash * 31 + imageChecksum ((const unsigned char *)
+					      *subTable, strlen (*subTable));
+  base = tableFiles[0] + directoryLength (tableFiles[0]);
+  if (!(imageName = malloc (strlen (path) + strlen (base) + 16
+			    + sizeof (IMAGE_SUFFIX))))
+    outOfMemory ();
+  sprintf (imageName, "%s%c%s-%08x%s", path, DIR_SEP, base, makeHash,
+	   IMAGE_SUFFIX);
+  return imageName;
+}
+
+static TranslationTableHeader *
+findSharedImage (char **tableFiles)
+{
+/* Map the shared image of tableFiles if it is newer than all of them and 
+* none of the files they include has changed. */
+  char *imageName;
+  char **subTable;
+  struct stat info;
+  time_t imageTime;
+  TranslationTableHeader *image = NULL;
+  if (compileFromSource || compileProfile
+      || !(imageName = sharedImageName (tableFiles)))
+    return NULL;
+  if (stat (imageName, &info) == 0)
+    {
+      imageTime = info.st_mtime;
+      for (subTable = tableFiles; *subTable; subTable++)
+	if (stat (*subTable, &info) != 0 || info.st_mtime > imageTime)
+	  break;
+      if (!*subTable)
+	image = loadTableImage (imageName, &imageMapping, &imageMappingSize);
+      if (image && !imageDependenciesUnchanged (imageMapping, imageTime,
+						tableFiles[0]))
+	{
+	  logMessage (LOG_DEBUG, "%s is out of date", imageName);
+	  unmapTableImage (imageMapping, imageMappingSize);
+	  imageMapping = NULL;
+	  image = NULL;
+	}
+    }
+  free (imageName);
+  return image;
+}
+
+static TranslationTableHeader *
+shareCompiledTable (TranslationTableHeader * compiled, char **tableFiles)
+{
+/* Write the newly compiled table to its shared image and map that 
+* instead. The image is written under a temporary name and renamed, so 
+* other processes never see it half written. The temporary name 
+* includes the address of the table, so that threads compiling the same 
+* list do not clash. Returns compiled if the image cannot be made. */
+  char *imageName;
+  char *tempName;
+  TranslationTableHeader *image = NULL;
+  if (!(imageName = sharedImageName (tableFiles)))
+    return compiled;
+  if (!(tempName = malloc (strlen (imageName) + 24)))
+    outOfMemory ();
+#ifdef _WIN32
+  sprintf (tempName, "%s.%lu.%lx", imageName,
+	   (unsigned long) GetCurrentProcessId (),
+	   (unsigned long) (size_t) compiled);
+#else
+  sprintf (tempName, "%s.%lu.%lx", imageName, (unsigned long) getpid (),
+	   (unsigned long) (size_t) compiled);
+#endif
+  if (writeTableImage (compiled, tempName, filesRead, numFilesRead))
+    {
+      if (rename (tempName, imageName) != 0)
+	/* Another process got there first */
+	remove (tempName);
+      image = loadTableImage (imageName, &imageMapping, &imageMappingSize);
+    }
+  free (tempName);
+  free (imageName);
+  if (!image)
+    return compiled;
+  free (compiled);
+  return image;
+}
+
+/**
+ * Implement include opcode
+ *
+ */
+static int
+includeFile (FileInfo * nested, CharsString * includedFile)
+{
+  int k;
+  char includeThis[MAXSTRING];
+  char **tableFiles;
+  int rv, phase;
+  for (k = 0; k < includedFile->length; k++)
+    includeThis[k] = (char) includedFile->chars[k];
+  includeThis[k] = 0;
+  phase = profileSetPhase (profileResolving);
+  tableFiles = resolveTable (includeThis, nested->fileName);
+  profileSetPhase (phase);
+  if (tableFiles == NULL)
+    {
+      errorCount++;
+      return 0;
+    }
+  if (tableFiles[1] != NULL)
+    {
+      errorCount++;
+      free_tablefiles(tableFiles);
+      logMessage (LOG_ERROR, "Table list not supported in include statement: 'include %s'", includeThis);
+      return 0;
+    }
+  includeDepth++;
+  rv = compileFile (*tableFiles);
+  includeDepth--;
+  free_tablefiles(tableFiles);
+  return rv;
+}
+
+/**
+ * Compile source tables into a table in memory
+ *
+ */
+static void *
+compileTranslationTable (const char *tableList, char **resolved)
+{
+/* resolved, if not NULL, holds the files of tableList, which are 
+* resolved here otherwise. It is left for the caller to free. */
+  char **tableFiles;
+  char **subTable;
+  const BuiltinTable *builtin;
+  errorCount = warningCount = fileCount = 0;
+  table = NULL;
+  tableInArena = 0;
+  /* Tables compiled while rules are profiled, or ordered by a profile, 
+   * note where each rule is, so they are compiled from their source and 
+   * completely */
+  forgetRuleLocations ();
+  recordingLocations = ruleProfiling || ruleOrder != NULL;
+  lazyParts = recordingLocations ? 0 : lazyCompilation;
+  forgetDeferredParts ();
+  duplicateRules = duplicateRuleBytes = 0;
+  characterClasses = NULL;
+  ruleNames = NULL;
+  deallocatePassNames ();
+  forgetFilesRead ();
+  imageMapping = NULL;
+  if (tableList == NULL)
+    return NULL;
+  if ((builtin = findBuiltinTable (tableList)))
+    {
+      imageMapping = (void *) builtin->data;
+      imageMappingSize = 0;
+      return builtin->image;
+    }
+  if (!opcodeLengths[0])
+    {
+      TranslationTableOpcode opcode;
+      for (opcode = 0; opcode < CTO_None; opcode++)
+	opcodeLengths[opcode] = strlen (opcodeNames[opcode]);
+    }
+  tableFiles = resolved ? resolved : resolveTable (tableList, NULL);
+  if (!tableFiles)
+    {
+      errorCount++;
+      goto cleanup;
+    }
+  /* A single table may have been compiled already */
+  if (!recordingLocations && ((tableFiles[0] && !tableFiles[1]
+			       && (table = findTableImage (tableFiles[0])))
+			      || (table = findSharedImage (tableFiles))))
+    {
+      /* The files the image lists have been noted as read, but an image 
+       * saved from a table loaded from an image lists none */
+      if (!numFilesRead)
+	recordTableFiles (tableFiles);
+      if (tableFiles != resolved)
+	free_tablefiles (tableFiles);
+      return table;
+    }
+  allocateHeader (NULL);
+  profileStart ();
+  /* Compile things that are necesary for the proper operation of 
+     liblouis or liblouisxml or liblouisutdml */
+  compileString ("space \\s 0");
+  compileString ("noback sign \\x0000 0");
+  compileString ("space \\x00a0 a unbreakable space");
+  compileString ("space \\x001b 1b escape");
+  compileString ("space \\xffff 123456789abcdef ENDSEGMENT");
+  freshTable = 1;
+  
+  /* Compile all subtables in the list */
+  for (subTable = tableFiles; *subTable; subTable++)
+    if (!compileFile (*subTable))
+      goto cleanup;
+  
+/* Clean up after compiling files */
+cleanup:
+  freshTable = 0;
+  lazyParts = 0;
+  if (characterClasses)
+    deallocateCharacterClasses ();
+  if (ruleNames)
+    deallocateRuleNames ();
+  if (passNames)
+    deallocatePassNames ();
+  if (warningCount)
+    logMessage (LOG_WARN, "%d warnings issued", warningCount);
+  if (!errorCount)
+    {
+      profileSetPhase (profileFinishing);
+      setDefaults ();
+      /* A table whose indexes could not all be built is not used half 
+       * built */
+      if (!freezeTable (FREEZE_ALL) && !errorCount)
+	errorCount++;
+    }
+  if (!errorCount)
+    {
+      storeDeferredParts ();
+      finishTable ();
+      table->tableSize = tableSize;
+      table->bytesUsed = tableUsed;
+      profileStop ();
+      /* An image is mapped read-only, so it must be complete */
+      if (!table->lazyBackRules && !table->lazyHyphenation)
+	table = shareCompiledTable (table, tableFiles);
+      if (ruleProfiling)
+	keepRuleLocations (table);
+    }
+  else
+    {
+      logMessage (LOG_ERROR, "%d errors found.", errorCount);
+      profileStop ();
+      forgetFilesRead ();
+      forgetDeferredParts ();
+      discardTable ();
+      /* Leave extParseChars and extParseDots usable */
+      errorCount = 0;
+    }
+  forgetRuleLocations ();
+  recordingLocations = 0;
+  if (tableFiles != resolved)
+    free_tablefiles (tableFiles);
+  return (void *) table;
+}
+
+static unsigned long int
+tableListHash (const char *tableList, int tableListLen)
+{
+  unsigned long int makeHash = 5381;
+  int k;
+  for (k = 0; k < tableListLen; k++)
+    makeHash = (makeHash << 5) + makeHash + (unsigned char) tableList[k];
+  return makeHash;
+}
+
+static ChainEntry *
+findTableEntry (const char *tableList, int tableListLen,
+		unsigned long int makeHash)
+{
+/* Returns the canonical entry of tableList */
+  ChainEntry *currentEntry =
+    loadPointer (tableChain[makeHash % CHAINHASHNUM]);
+  while (currentEntry != NULL)
+    {
+      if (makeHash == currentEntry->tableListHash
+	  && tableListLen == currentEntry->tableListLength
+	  && memcmp (&currentEntry->tableList[0], tableList,
+		     tableListLen) == 0)
+	return currentEntry->canonical ? currentEntry->canonical :
+	  currentEntry;
+      currentEntry = currentEntry->next;
+    }
+  return NULL;
+}
+
+static ChainEntry *
+findEntryOfFiles (const char *fileList, unsigned long int fileListHash)
+{
+  ChainEntry *entry;
+  int bucket;
+  for (bucket = 0; bucket < CHAINHASHNUM; bucket++)
+    for (entry = loadPointer (tableChain[bucket]); entry != NULL;
+	 entry = entry->next)
+      if (entry->fileList && entry->fileListHash == fileListHash
+	  && strcmp (entry->fileList, fileList) == 0)
+	return entry;
+  return NULL;
+}
+
+static char *
+joinTableFiles (char **tableFiles)
+{
+  char *fileList;
+  char **subTable;
+  size_t length = 1;
+  for (subTable = tableFiles; *subTable; subTable++)
+    length += strlen (*subTable) + 1;
+  if (!(fileList = malloc (length)))
+    outOfMemory ();
+  fileList[0] = 0;
+  for (subTable = tableFiles; *subTable; subTable++)
+    {
+      strcat (fileList, *subTable);
+      strcat (fileList, "\n");
+    }
+  return fileList;
+}
+
+static ChainEntry *
+newTableEntry (const char *tableList, int tableListLen,
+	       unsigned long int makeHash)
+{
+  ChainEntry *entry = malloc (sizeof (ChainEntry) + tableListLen);
+  if (!entry)
+    outOfMemory ();
+  memset (entry, 0, sizeof (ChainEntry));
+  entry->tableListHash = makeHash;
+  entry->tableListLength = tableListLen;
+  memcpy (&entry->tableList[0], tableList, tableListLen);
+  return entry;
+}
+
+static void
+addTableEntry (ChainEntry * entry)
+{
+/* Must be called with the compiler locked */
+  entry->next = tableChain[entry->tableListHash % CHAINHASHNUM];
+  storePointer (tableChain[entry->tableListHash % CHAINHASHNUM], entry);
+}
+
+static void
+freeEntryTable (ChainEntry * entry)
+{
+  if (entry->mapping)
+    unmapTableImage (entry->mapping, entry->mappingSize);
+  else
+    free (entry->table);
+}
+
+static void
+touchTable (ChainEntry * entry)
+{
+/* Mark the table as the one used last, if there is a cap */
+  if (loadLong (tableCacheSize) > 0
+      && loadLong (entry->lastUsed) != loadLong (tableClock))
+    storeLong (entry->lastUsed, addLong (tableClock, 1));
+}
+
+static int
+takeReference (ChainEntry * entry)
+{
+/* Returns 0 if the table has been evicted */
+  long references;
+  do
+    {
+      references = loadLong (entry->references);
+      if (references == EVICTED)
+	return 0;
+    }
+  while (!swapLong (entry->references, references, references + 1));
+  touchTable (entry);
+  return 1;
+}
+
+static void
+dropReference (ChainEntry * entry)
+{
+  long references;
+  do
+    {
+      references = loadLong (entry->references);
+      if (references <= 0)
+	return;
+    }
+  while (!swapLong (entry->references, references, references - 1));
+}
+
+static size_t
+tableBytes (const ChainEntry * entry)
+{
+  if (entry->mapping)
+    return entry->mappingSize;
+  return ((const TranslationTableHeader *) entry->table)->tableSize;
+}
+
+static void
+evictTables ()
+{
+/* Must be called with the compiler locked. Evict the tables nobody 
+* uses, least recently used first, until the rest fit in the cap. */
+  ChainEntry *entry;
+  ChainEntry *victim;
+  long unused;
+  size_t total;
+  int bucket;
+  while (tableCacheSize > 0)
+    {
+      total = 0;
+      victim = NULL;
+      for (bucket = 0; bucket < CHAINHASHNUM; bucket++)
+	for (entry = tableChain[bucket]; entry != NULL; entry = entry->next)
+	  {
+	    if (entry->canonical || loadLong (entry->references) == EVICTED)
+	      continue;
+	    total += tableBytes (entry);
+	    if (loadLong (entry->references) == 0
+		&& (victim == NULL
+		    || loadLong (entry->lastUsed) < victim->lastUsed))
+	      victim = entry;
+	  }
+      if (total <= (size_t) tableCacheSize || victim == NULL)
+	return;
+      unused = 0;
+      /* Unless it was taken in the meantime */
+      if (!swapLong (victim->references, unused, EVICTED))
+	continue;
+      logMessage (LOG_DEBUG, "Evicting %.*s from the table cache",
+		  victim->tableListLength, victim->tableList);
+      forgetRuleProfile (victim->table);
+      freeEntryTable (victim);
+      freeSourceFiles (victim->files, victim->numFiles);
+      victim->files = NULL;
+      victim->numFiles = 0;
+      victim->mapping = NULL;
+      storePointer (victim->table, NULL);
+      tableGeneration++;
+    }
+}
+
+static void
+fillTableEntry (ChainEntry * entry, void *table, void *mapping,
+		size_t mappingSize, double compileTime)
+{
+/* Must be called with the compiler locked. Put a table into a new or 
+* evicted entry, with a reference for the caller. */
+  entry->mapping = mapping;
+  entry->mappingSize = mappingSize;
+  entry->compileTime = compileTime;
+  addMetric (metricTableCompiles, 1);
+  addMetric (metricCompileMicroseconds, (long) (compileTime * 1e6));
+  storeLong (entry->lastUsed, addLong (tableClock, 1));
+  storePointer (entry->table, table);
+  storeLong (entry->references, 1);
+}
+
+static ChainEntry *
+recompileTable (ChainEntry * entry)
+{
+/* Must be called with the compiler unlocked. Compile an evicted table 
+* into its entry again, and return the entry with a reference taken, 
+* or NULL if it no longer compiles. */
+  char *tableList;
+  void *newTable;
+  void *mapping;
+  size_t mappingSize;
+  double compileTime;
+  if (!(tableList = malloc (entry->tableListLength + 1)))
+    outOfMemory ();
+  memcpy (tableList, entry->tableList, entry->tableListLength);
+  tableList[entry->tableListLength] = 0;
+  lockCompilation ();
+  if (takeReference (entry))
+    {
+      unlockCompilation ();
+      free (tableList);
+      return entry;
+    }
+  compileTime = currentTime ();
+  newTable = compileTranslationTable (tableList, NULL);
+  compileTime = currentTime () - compileTime;
+  mapping = imageMapping;
+  mappingSize = imageMappingSize;
+  imageMapping = NULL;
+  unlockCompilation ();
+  free (tableList);
+  if (!newTable)
+    return NULL;
+  lockCompiler ();
+  if (takeReference (entry))
+    {
+      /* Another thread compiled it in the meantime */
+      unlockCompiler ();
+      if (mapping)
+	unmapTableImage (mapping, mappingSize);
+      else
+	free (newTable);
+      forgetFilesRead ();
+      return entry;
+    }
+  takeFilesRead (entry);
+  fillTableEntry (entry, newTable, mapping, mappingSize, compileTime);
+  evictTables ();
+  unlockCompiler ();
+  return entry;
+}
+
+/* The files of the tables being compiled by compileAndCacheTable, so 
+* that a thread asking for one of them waits for it to be cached rather 
+* than compile it too. Guarded by compileLock. */
+typedef struct PendingTable
+{
+  struct PendingTable *next;
+  const char *fileList;
+  unsigned long int fileListHash;
+} PendingTable;
+
+static PendingTable *pendingTables = NULL;
+
+static int
+tableIsPending (const char *fileList, unsigned long int fileListHash)
+{
+  PendingTable *pending;
+  for (pending = pendingTables; pending != NULL; pending = pending->next)
+    if (pending->fileListHash == fileListHash
+	&& strcmp (pending->fileList, fileList) == 0)
+      return 1;
+  return 0;
+}
+
+static void
+removePendingTable (PendingTable * pending)
+{
+/* Must be called with the compiler locked */
+  PendingTable **link;
+  for (link = &pendingTables; *link != NULL; link = &(*link)->next)
+    if (*link == pending)
+      {
+	*link = pending->next;
+	break;
+      }
+  tablesCompiled ();
+}
+
+static ChainEntry *
+compileAndCacheTable (const char *tableList, int tableListLen,
+		      unsigned long int makeHash)
+{
+/* Must be called with the compiler unlocked. Returns the entry of 
+* tableList with a reference taken for the caller. Another thread may 
+* have compiled the same table in the meantime, in which case that 
+* table is kept and this one dropped. A list of the same files as a 
+* table already cached gets an entry pointing to that table. */
+  ChainEntry *newEntry;
+  ChainEntry *entry;
+  char **tableFiles;
+  char *fileList;
+  unsigned long int fileListHash;
+  void *newTable = NULL;
+  void *mapping = NULL;
+  size_t mappingSize = 0;
+  double compileTime = 0;
+  PendingTable pending;
+  int compile;
+  if (findBuiltinTable (tableList))
+    {
+      /* A built-in image is not looked for in the table path */
+      tableFiles = NULL;
+      if (!(fileList = strdup (tableList)))
+	outOfMemory ();
+    }
+  else
+    {
+      if (!(tableFiles = resolveTable (tableList, NULL)))
+	return NULL;
+      fileList = joinTableFiles (tableFiles);
+    }
+  fileListHash = tableListHash (fileList, strlen (fileList));
+  newEntry = newTableEntry (tableList, tableListLen, makeHash);
+  pending.fileList = fileList;
+  pending.fileListHash = fileListHash;
+  lockCompiler ();
+  while (!(entry = findTableEntry (tableList, tableListLen, makeHash))
+	 && !(entry = findEntryOfFiles (fileList, fileListHash))
+	 && tableIsPending (fileList, fileListHash))
+    waitForTables ();
+  if ((compile = entry == NULL))
+    {
+      pending.next = pendingTables;
+      pendingTables = &pending;
+    }
+  unlockCompiler ();
+  lockCompilation ();
+  if (compile)
+    {
+      compileTime = currentTime ();
+      newTable = compileTranslationTable (tableList, tableFiles);
+      compileTime = currentTime () - compileTime;
+      if (newTable)
+	{
+	  mapping = imageMapping;
+	  mappingSize = imageMappingSize;
+	  takeFilesRead (newEntry);
+	}
+      imageMapping = NULL;
+    }
+  unlockCompilation ();
+  free_tablefiles (tableFiles);
+  /*Add the new entry to the table chain. */
+  lockCompiler ();
+  if (compile)
+    removePendingTable (&pending);
+  if ((entry = findTableEntry (tableList, tableListLen, makeHash)))
+    {
+      /* Another thread compiled it in the meantime */
+      unlockCompiler ();
+      freeSourceFiles (newEntry->files, newEntry->numFiles);
+      free (newEntry);
+      free (fileList);
+    }
+  else if ((entry = findEntryOfFiles (fileList, fileListHash)))
+    {
+      /* Keep the new entry as another name for the table */
+      freeSourceFiles (newEntry->files, newEntry->numFiles);
+      newEntry->files = NULL;
+      newEntry->numFiles = 0;
+      newEntry->canonical = entry;
+      addTableEntry (newEntry);
+      unlockCompiler ();
+      free (fileList);
+    }
+  else if (newTable)
+    {
+      newEntry->fileList = fileList;
+      newEntry->fileListHash = fileListHash;
+      fillTableEntry (newEntry, newTable, mapping, mappingSize, compileTime);
+      addTableEntry (newEntry);
+      evictTables ();
+      unlockCompiler ();
+      return newEntry;
+    }
+  else
+    {
+      unlockCompiler ();
+      free (newEntry);
+      free (fileList);
+      return NULL;
+    }
+  if (newTable)
+    {
+      if (mapping)
+	unmapTableImage (mapping, mappingSize);
+      else
+	free (newTable);
+    }
+  return takeReference (entry) ? entry : recompileTable (entry);
+}
+
+static ChainEntry *
+getTableEntry (const char *tableList)
+{
+/*Keep track of which tables have already been compiled. Returns the 
+* entry of the table with a reference taken for the caller. */
+  int tableListLen;
+  unsigned long int makeHash;
+  ChainEntry *entry;
+  if (tableList == NULL || *tableList == 0)
+    return NULL;
+  tableListLen = strlen (tableList);
+  makeHash = tableListHash (tableList, tableListLen);
+  if (!(entry = findTableEntry (tableList, tableListLen, makeHash)))
+    {
+      addMetric (metricTableMisses, 1);
+      entry = compileAndCacheTable (tableList, tableListLen, makeHash);
+    }
+  else if (!takeReference (entry))
+    {
+      addMetric (metricTableMisses, 1);
+      entry = recompileTable (entry);
+    }
+  else
+    addMetric (metricTableHits, 1);
+  if (!entry)
+    return NULL;
+  /* Only write when the table changes, so that threads using the same 
+   * table do not contend for this cache line. */
+  if (loadPointer (lastTrans) != entry)
+    storePointer (lastTrans, entry);
+  return entry;
+}
+
+static void *
+getTable (const char *tableList)
+{
+/* The reference taken is kept, since the caller may keep the table */
+  ChainEntry *entry = getTableEntry (tableList);
+  if (!entry)
+    return NULL;
+  return loadPointer (entry->table);
+}
+
+void *
+getTableFromHandle (const louTable * handle)
+{
+  if (handle == NULL)
+    return NULL;
+  return loadPointer (((ChainEntry *) handle)->table);
+}
+
+char *
+getLastTableList ()
+{
+  ChainEntry *entry = loadPointer (lastTrans);
+  if (entry == NULL)
+    return NULL;
+  strncpy (scratchBuf, entry->tableList, entry->tableListLength);
+  scratchBuf[entry->tableListLength] = 0;
+  return scratchBuf;
+}
+
+void *EXPORT_CALL
+lou_getTable (const char *tableList)
+{
+  void *table = NULL;
+  if (tableList == NULL || tableList[0] == 0)
+    return NULL;
+  table = getTable (tableList);
+  if (!table)
+    logMessage (LOG_ERROR, "%s could not be found", tableList);
+  return table;
+}
+
+/* Preloading. Worker threads take the next table list that nobody has 
+* taken yet and compile it, so that lists which take long do not hold 
+* up the others. */
+
+typedef struct
+{
+  const char **tableLists;
+  int count;
+  volatile long next;		/*first list not yet taken by a worker */
+  int *loaded;
+  double *seconds;		/*taken by each list, or NULL */
+} PreloadJob;
+
+static void
+runPreloadWorker (PreloadJob * job)
+{
+  const louTable *handle;
+  long k;
+  for (;;)
+    {
+#if defined(_WIN32)
+      k = InterlockedExchangeAdd (&job->next, 1);
+#elif defined(__GNUC__)
+      k = __atomic_fetch_add (&job->next, 1, __ATOMIC_RELAXED);
+#else
+      k = job->next++;
+#endif
+      if (k >= job->count)
+	break;
+      if (job->seconds)
+	job->seconds[k] = currentTime ();
+      handle = lou_openTable (job->tableLists[k]);
+      if (job->seconds)
+	job->seconds[k] = currentTime () - job->seconds[k];
+      job->loaded[k] = handle != NULL;
+      lou_closeTable (handle);
+    }
+}
+
+#if defined(PARALLELCOMPILE) && defined(_WIN32)
+static DWORD WINAPI
+preloadThread (LPVOID arg)
+{
+  runPreloadWorker (arg);
+  return 0;
+}
+#elif defined(PARALLELCOMPILE) && defined(HAVE_PTHREAD_H)
+static void *
+preloadThread (void *arg)
+{
+  runPreloadWorker (arg);
+  return NULL;
+}
+#endif
+
+int EXPORT_CALL
+lou_preloadTables (const char **tableLists, int count, int threads)
+{
+  return lou_compileTables (tableLists, count, threads, NULL, NULL);
+}
+
+int EXPORT_CALL
+lou_compileTables (const char **tableLists, int count, int threads,
+		   int *results, double *seconds)
+{
+  PreloadJob job;
+  int loaded = 0;
+  int k, started = 1;
+#if defined(PARALLELCOMPILE) && defined(_WIN32)
+  HANDLE *threadHandles;
+#elif defined(PARALLELCOMPILE) && defined(HAVE_PTHREAD_H)
+  pthread_t *threadHandles;
+#endif
+  if (tableLists == NULL || count <= 0)
+    return 0;
+  if (threads <= 0)
+    threads = processorCount ();
+  if (threads > count)
+    threads = count;
+  job.tableLists = tableLists;
+  job.count = count;
+  job.next = 0;
+  job.seconds = seconds;
+  if (!(job.loaded = results)
+      && !(job.loaded = calloc (count, sizeof (int))))
+    outOfMemory ();
+#if defined(PARALLELCOMPILE) && (defined(_WIN32) || defined(HAVE_PTHREAD_H))
+  if (!(threadHandles = malloc (threads * sizeof (*threadHandles))))
+    outOfMemory ();
+  /* The calling thread is the first worker */
+  for (started = 1; started < threads; started++)
+    {
+#ifdef _WIN32
+      if (!(threadHandles[started] = CreateThread (NULL, 0, preloadThread,
+						   &job, 0, NULL)))
+	break;
+#else
+      if (pthread_create (&threadHandles[started], NULL, preloadThread,
+			  &job))
+	break;
+#endif
+    }
+#endif
+  runPreloadWorker (&job);
+#if defined(PARALLELCOMPILE) && (defined(_WIN32) || defined(HAVE_PTHREAD_H))
+  for (k = 1; k < started; k++)
+    {
+#ifdef _WIN32
+      WaitForSingleObject (threadHandles[k], INFINITE);
+      CloseHandle (threadHandles[k]);
+#else
+      pthread_join (threadHandles[k], NULL);
+#endif
+    }
+  free (threadHandles);
+#endif
+  for (k = 0; k < count; k++)
+    loaded += job.loaded[k];
+  if (job.loaded != results)
+    free (job.loaded);
+  return loaded;
+}
+
+/* Preloading in the background. Each call of lou_preloadTablesAsync 
+* starts its own workers on a copy of the lists, and is remembered until 
+* lou_waitForPreload joins them. A table is cached as soon as it is 
+* compiled, and a thread asking for a table still being compiled waits 
+* for it in compileAndCacheTable. */
+
+typedef struct AsyncPreload
+{
+  struct AsyncPreload *next;
+  PreloadJob job;
+  char **tableLists;
+  int numThreads;
+#if defined(PARALLELCOMPILE) && defined(_WIN32)
+  HANDLE *threadHandles;
+#elif defined(PARALLELCOMPILE) && defined(HAVE_PTHREAD_H)
+  pthread_t *threadHandles;
+#endif
+} AsyncPreload;
+
+static AsyncPreload *asyncPreloads = NULL;	/*guarded by compileLock */
+
+int EXPORT_CALL
+lou_preloadTablesAsync (const char **tableLists, int count, int threads)
+{
+  AsyncPreload *preload;
+  int k;
+  if (tableLists == NULL || count <= 0)
+    return 0;
+  if (threads <= 0)
+    threads = processorCount ();
+  if (threads > count)
+    threads = count;
+  if (!(preload = calloc (1, sizeof (*preload)))
+      || !(preload->tableLists = malloc (count * sizeof (char *)))
+      || !(preload->job.loaded = calloc (count, sizeof (int))))
+    outOfMemory ();
+  for (k = 0; k < count; k++)
+    {
+      if (!(preload->tableLists[k] = malloc (strlen (tableLists[k]) + 1)))
+	outOfMemory ();
+      strcpy (preload->tableLists[k], tableLists[k]);
+    }
+  preload->job.tableLists = (const char **) preload->tableLists;
+  preload->job.count = count;
+#if defined(PARALLELCOMPILE) && (defined(_WIN32) || defined(HAVE_PTHREAD_H))
+  if (!(preload->threadHandles =
+	malloc (threads * sizeof (*preload->threadHandles))))
+    outOfMemory ();
+  for (; preload->numThreads < threads; preload->numThreads++)
+    {
+#ifdef _WIN32
+      if (!(preload->threadHandles[preload->numThreads] =
+	    CreateThread (NULL, 0, preloadThread, &preload->job, 0, NULL)))
+	break;
+#else
+      if (pthread_create (&preload->threadHandles[preload->numThreads], NULL,
+			  preloadThread, &preload->job))
+	break;
+#endif
+    }
+#endif
+  /* Without threads the lists are compiled before returning */
+  if (!preload->numThreads)
+    runPreloadWorker (&preload->job);
+  lockCompiler ();
+  preload->next = asyncPreloads;
+  asyncPreloads = preload;
+  unlockCompiler ();
+  return preload->numThreads;
+}
+
+int EXPORT_CALL
+lou_waitForPreload ()
+{
+  AsyncPreload *preload;
+  int loaded = 0;
+  int k;
+  lockCompiler ();
+  preload = asyncPreloads;
+  asyncPreloads = NULL;
+  unlockCompiler ();
+  while (preload)
+    {
+      AsyncPreload *next = preload->next;
+#if defined(PARALLELCOMPILE) && (defined(_WIN32) || defined(HAVE_PTHREAD_H))
+      for (k = 0; k < preload->numThreads; k++)
+	{
+#ifdef _WIN32
+	  WaitForSingleObject (preload->threadHandles[k], INFINITE);
+	  CloseHandle (preload->threadHandles[k]);
+#else
+	  pthread_join (preload->threadHandles[k], NULL);
+#endif
+	}
+      free (preload->threadHandles);
+#endif
+      for (k = 0; k < preload->job.count; k++)
+	{
+	  loaded += preload->job.loaded[k];
+	  free (preload->tableLists[k]);
+	}
+      free (preload->job.loaded);
+      free (preload->tableLists);
+      free (preload);
+      preload = next;
+    }
+  return loaded;
+}
+
+/* Reloading. A table whose source files changed is compiled again and 
+* swapped into its entry. The old table may still be in use by a 
+* translation that started before, so it is only freed by lou_free. */
+
+typedef struct RetiredTable
+{
+  struct RetiredTable *next;
+  ChainEntry *entry;		/*the table was retired from */
+  void *table;
+  void *mapping;
+  size_t mappingSize;
+} RetiredTable;
+
+static RetiredTable *retiredTables = NULL;
+
+static void
+retireTable (ChainEntry * entry)
+{
+/* Must be called with the compiler locked */
+  RetiredTable *retired = malloc (sizeof (RetiredTable));
+  if (!retired)
+    outOfMemory ();
+  retired->entry = entry;
+  retired->table = entry->table;
+  retired->mapping = entry->mapping;
+  retired->mappingSize = entry->mappingSize;
+  retired->next = retiredTables;
+  retiredTables = retired;
+}
+
+static void
+freeRetiredTables ()
+{
+  RetiredTable *retired;
+  while ((retired = retiredTables))
+    {
+      retiredTables = retired->next;
+      if (retired->mapping)
+	unmapTableImage (retired->mapping, retired->mappingSize);
+      else
+	free (retired->table);
+      free (retired);
+    }
+}
+
+static int
+reloadTableEntry (ChainEntry * entry)
+{
+  char *tableList;
+  SourceFile *files;
+  void *newTable;
+  void *mapping;
+  size_t mappingSize;
+  double startTime;
+  lockCompiler ();
+  files = entry->files;
+  if (files == NULL || sourceFilesUnchanged (files, entry->numFiles))
+    {
+      unlockCompiler ();
+      return 0;
+    }
+  if (!(tableList = malloc (entry->tableListLength + 1)))
+    outOfMemory ();
+  memcpy (tableList, entry->tableList, entry->tableListLength);
+  tableList[entry->tableListLength] = 0;
+  unlockCompiler ();
+  lockCompilation ();
+  compileFromSource = 1;
+  startTime = currentTime ();
+  newTable = compileTranslationTable (tableList, NULL);
+  compileFromSource = 0;
+  mapping = imageMapping;
+  mappingSize = imageMappingSize;
+  imageMapping = NULL;
+  unlockCompilation ();
+  if (!newTable)
+    {
+      logMessage (LOG_ERROR, "%s could not be reloaded, keeping it as it was",
+		  tableList);
+      free (tableList);
+      return 0;
+    }
+  free (tableList);
+  lockCompiler ();
+  if (entry->files != files)
+    {
+      /* Another thread reloaded it in the meantime */
+      unlockCompiler ();
+      if (mapping)
+	unmapTableImage (mapping, mappingSize);
+      else
+	free (newTable);
+      forgetFilesRead ();
+      return 0;
+    }
+  retireTable (entry);
+  freeSourceFiles (entry->files, entry->numFiles);
+  takeFilesRead (entry);
+  entry->compileTime = currentTime () - startTime;
+  addMetric (metricTableCompiles, 1);
+  addMetric (metricCompileMicroseconds, (long) (entry->compileTime * 1e6));
+  entry->mapping = mapping;
+  entry->mappingSize = mappingSize;
+  storePointer (entry->table, newTable);
+  unlockCompiler ();
+  return 1;
+}
+
+int EXPORT_CALL
+lou_reloadTables ()
+{
+  ChainEntry *entry;
+  int reloaded = 0;
+  int bucket;
+  for (bucket = 0; bucket < CHAINHASHNUM; bucket++)
+    for (entry = loadPointer (tableChain[bucket]); entry != NULL;
+	 entry = entry->next)
+      reloaded += reloadTableEntry (entry);
+  return reloaded;
+}
+
+/* Lazy compilation. The parts left out of a table are compiled into a 
+* copy of it, which takes its place like a reloaded table, so that 
+* translations still using the old one are not disturbed. The offsets 
+* of everything already in the table stay the same. */
+
+void EXPORT_CALL
+lou_setLazyCompilation (int parts)
+{
+  lazyCompilation = parts & (LOU_LAZY_HYPHENATION | LOU_LAZY_BACKTRANSLATION);
+}
+
+static ChainEntry *
+findEntryOfTable (const void *lazyTable)
+{
+/* Must be called with the compiler locked */
+  ChainEntry *entry;
+  RetiredTable *retired;
+  int bucket;
+  for (bucket = 0; bucket < CHAINHASHNUM; bucket++)
+    for (entry = tableChain[bucket]; entry != NULL; entry = entry->next)
+      if (entry->table == lazyTable)
+	return entry;
+  for (retired = retiredTables; retired != NULL; retired = retired->next)
+    if (retired->table == lazyTable)
+      return retired->entry;
+  return NULL;
+}
+
+static int
+compileDeferredHyphenation ()
+{
+  char *fileName;
+  if (!table->lazyHyphenation)
+    return 1;
+  if (!(fileName = strdup ((char *) &table->ruleArea[table->lazyHyphenation])))
+    outOfMemory ();
+  table->lazyHyphenation = 0;
+  compileFile (fileName);
+  forgetFilesRead ();
+  if (errorCount)
+    logMessage (LOG_ERROR, "%d errors found in %s.", errorCount, fileName);
+  free (fileName);
+  return !errorCount;
+}
+
+static void
+linkDeferredBackRules ()
+{
+  int k;
+  for (k = 0; k < table->numLazyBackRules; k++)
+    {
+      newRuleOffset =
+	OFFSETARRAY (table->ruleArea, table->lazyBackRules)[k];
+      newRule = (TranslationTableRule *) & table->ruleArea[newRuleOffset];
+      add_1_multiple ();
+    }
+  table->lazyBackRules = table->numLazyBackRules = 0;
+}
+
+static void
+copyTableToComplete (const TranslationTableHeader * lazyTable)
+{
+  allocateTable (lazyTable->bytesUsed);
+  memcpy (table, lazyTable, lazyTable->bytesUsed);
+  tableUsed = lazyTable->bytesUsed;
+}
+
+void *
+completeTable (const void *lazyTable, int parts)
+{
+  ChainEntry *entry;
+  const TranslationTableHeader *current;
+  void *complete;
+  lockCompiler ();
+  if (!(entry = findEntryOfTable (lazyTable)))
+    {
+      unlockCompiler ();
+      return (void *) lazyTable;
+    }
+  /* The table may already have been completed by another thread */
+  current = entry->table;
+  if (!(((parts & LOU_LAZY_HYPHENATION) && current->lazyHyphenation)
+	|| ((parts & LOU_LAZY_BACKTRANSLATION) && current->lazyBackRules)))
+    {
+      unlockCompiler ();
+      return (void *) current;
+    }
+  errorCount = warningCount = fileCount = 0;
+  lazyParts = 0;
+  forgetFilesRead ();
+  copyTableToComplete (current);
+  if ((parts & LOU_LAZY_HYPHENATION) && !compileDeferredHyphenation ())
+    {
+      /* Go on without hyphenation rather than try again on every call */
+      discardTable ();
+      copyTableToComplete (current);
+      table->lazyHyphenation = 0;
+      errorCount = 0;
+    }
+  if (parts & LOU_LAZY_BACKTRANSLATION)
+    linkDeferredBackRules ();
+  freezeTable (FREEZE_COMPLETED);
+  finishTable ();
+  table->tableSize = tableSize;
+  table->bytesUsed = tableUsed;
+  retireTable (entry);
+  entry->mapping = NULL;
+  addFilesRead (entry);
+  storePointer (entry->table, table);
+  complete = table;
+  table = NULL;
+  unlockCompiler ();
+  return complete;
+}
+
+louTable *EXPORT_CALL
+lou_openTable (const char *tableList)
+{
+  ChainEntry *entry;
+  if (tableList == NULL || tableList[0] == 0)
+    return NULL;
+  if (!(entry = getTableEntry (tableList)))
+    logMessage (LOG_ERROR, "%s could not be found", tableList);
+  return entry;
+}
+
+void EXPORT_CALL
+lou_closeTable (const louTable * handle)
+{
+  if (handle != NULL)
+    dropReference ((ChainEntry *) handle);
+}
+
+void EXPORT_CALL
+lou_setTableCacheSize (long maxBytes)
+{
+  lockCompiler ();
+  storeLong (tableCacheSize, maxBytes > 0 ? maxBytes : 0);
+  evictTables ();
+  unlockCompiler ();
+}
+
+/* Statistics. Rules are counted by walking every chain they can be 
+* found through, so swap rules, which are only used from multipass 
+* rules, are not counted. */
+
+static void
+countChain (int *histogram, int *longest, int length)
+{
+  if (length > *longest)
+    *longest = length;
+  histogram[length < LOU_CHAINLENGTHS ? length : LOU_CHAINLENGTHS - 1]++;
+}
+
+static int
+countRules (const TranslationTableHeader * header,
+	    TranslationTableOffset offset, int direction,
+	    unsigned char *seen, louTableStats * stats)
+{
+/* Count the rules in a chain which were not counted before, and return 
+* the length of the chain */
+  const TranslationTableRule *rule;
+  int length = 0;
+  for (; offset; offset = direction ? rule->dotsnext : rule->charsnext)
+    {
+      rule = (const TranslationTableRule *) & header->ruleArea[offset];
+      length++;
+      if (seen[offset / 8] & (1 << (offset % 8)))
+	continue;
+      seen[offset / 8] |= 1 << (offset % 8);
+      stats->numRules++;
+      if (rule->opcode < CTO_None && rule->opcode < LOU_OPCODES)
+	stats->ruleCounts[rule->opcode]++;
+      else
+	stats->otherRules++;
+    }
+  return length;
+}
+
+static int
+countCharacters (const TranslationTableHeader * header,
+		 TranslationTableOffset offset, int direction,
+		 unsigned char *seen, louTableStats * stats)
+{
+  const TranslationTableCharacter *character;
+  int length = 0;
+  for (; offset; offset = character->next)
+    {
+      character = (const TranslationTableCharacter *)
+	& header->ruleArea[offset];
+      countRules (header, character->otherRules, direction, seen, stats);
+      length++;
+    }
+  return length;
+}
+
+int EXPORT_CALL
+lou_getTableStats (const louTable * handle, louTableStats * stats)
+{
+  const ChainEntry *entry = (const ChainEntry *) handle;
+  const TranslationTableHeader *header;
+  const HyphenationState *states;
+  unsigned char *seen;
+  int k;
+  if (entry == NULL || stats == NULL)
+    return 0;
+  header = loadPointer (entry->table);
+  memset (stats, 0, sizeof (*stats));
+  stats->compileTime = entry->compileTime;
+  stats->bytesUsed = header->bytesUsed;
+  stats->tableSize = header->tableSize;
+  if (!(seen = calloc (header->bytesUsed / SLOTSIZE / 8 + 1, 1)))
+    outOfMemory ();
+  if (header->forRuleBuckets)
+    for (k = 0; k < 1 << header->forRuleHashBits; k++)
+      countChain (stats->forRuleChains, &stats->longestForRuleChain,
+		  countRules (header,
+			      OFFSETARRAY (header->ruleArea,
+					   header->forRuleBuckets)[k], 0,
+			      seen, stats));
+  else
+    for (k = 0; k < HASHNUM; k++)
+      countChain (stats->forRuleChains, &stats->longestForRuleChain,
+		  countRules (header, header->forRules[k], 0, seen, stats));
+  for (k = 0; k < HASHNUM; k++)
+    {
+      countChain (stats->backRuleChains, &stats->longestBackRuleChain,
+		  countRules (header, header->backRules[k], 1, seen, stats));
+      countChain (stats->characterChains, &stats->longestCharacterChain,
+		  countCharacters (header, header->characters[k], 0, seen,
+				   stats));
+      countChain (stats->dotsChains, &stats->longestDotsChain,
+		  countCharacters (header, header->dots[k], 1, seen, stats));
+    }
+  for (k = 0; k < 5; k++)
+    stats->passRules[k] =
+      countRules (header, header->attribOrSwapRules[k], 0, seen, stats);
+  free (seen);
+  if (header->hyphenStatesArray)
+    {
+      states = (const HyphenationState *)
+	& header->ruleArea[header->hyphenStatesArray];
+      stats->hyphenStates = header->numHyphenStates;
+      for (k = 0; k < stats->hyphenStates; k++)
+	stats->hyphenTransitions += states[k].numTrans;
+    }
+  return 1;
+}
+
+static int
+chainCount (const TranslationTableHeader * header, int kind)
+{
+  if (kind == 0 && header->forRuleBuckets)
+    return 1 << header->forRuleHashBits;
+  return HASHNUM;
+}
+
+static TranslationTableOffset
+chainStart (const TranslationTableHeader * header, int kind, int k)
+{
+  switch (kind)
+    {
+    case 0:
+      if (header->forRuleBuckets)
+	return OFFSETARRAY (header->ruleArea, header->forRuleBuckets)[k];
+      return header->forRules[k];
+    case 1:
+      return header->backRules[k];
+    case 2:
+      return header->characters[k];
+    default:
+      return header->dots[k];
+    }
+}
+
+static TranslationTableOffset
+chainNext (const TranslationTableHeader * header, int kind,
+	   TranslationTableOffset offset, widechar * prefix)
+{
+/* The entry after the one at offset, putting the beginning of that one 
+ * in prefix */
+  if (kind < 2)
+    {
+      const TranslationTableRule *rule = (const TranslationTableRule *)
+	& header->ruleArea[offset];
+      const widechar *chars =
+	kind == 0 ? rule->charsdots : &rule->charsdots[rule->charslen];
+      int length = kind == 0 ? rule->charslen : rule->dotslen;
+      prefix[0] = length > 0 ? chars[0] : 0;
+      prefix[1] = length > 1 ? chars[1] : 0;
+      return kind == 0 ? rule->charsnext : rule->dotsnext;
+    }
+  else
+    {
+      const TranslationTableCharacter *character =
+	(const TranslationTableCharacter *) & header->ruleArea[offset];
+      prefix[0] = character->realchar;
+      prefix[1] = 0;
+      return character->next;
+    }
+}
+
+static int
+chainLength (const TranslationTableHeader * header, int kind, int k)
+{
+  TranslationTableOffset offset = chainStart (header, kind, k);
+  widechar prefix[2];
+  int length = 0;
+  for (; offset; offset = chainNext (header, kind, offset, prefix))
+    length++;
+  return length;
+}
+
+static int
+comparePrefixes (const void *a, const void *b)
+{
+  const widechar *p = a;
+  const widechar *q = b;
+  if (p[0] != q[0])
+    return p[0] < q[0] ? -1 : 1;
+  if (p[1] != q[1])
+    return p[1] < q[1] ? -1 : 1;
+  return 0;
+}
+
+static void
+reportChain (const TranslationTableHeader * header, int kind, int k,
+	     ChainReport * report)
+{
+/* Find the most common beginnings of the entries of a chain */
+  TranslationTableOffset offset = chainStart (header, kind, k);
+  widechar (*prefixes)[2];
+  int n = 0, run, j, m;
+  memset (report, 0, sizeof (*report));
+  report->length = chainLength (header, kind, k);
+  if (!(prefixes = malloc (report->length * sizeof (*prefixes))))
+    outOfMemory ();
+  while (offset)
+    offset = chainNext (header, kind, offset, prefixes[n++]);
+  qsort (prefixes, n, sizeof (*prefixes), comparePrefixes);
+  for (j = 0; j < n; j += run)
+    {
+      for (run = 1; j + run < n
+	   && !comparePrefixes (prefixes[j], prefixes[j + run]); run++);
+      report->numPrefixes++;
+      /* Keep the most common, in order */
+      for (m = report->numPrefixes < CHAINPREFIXES ? report->numPrefixes - 1
+	   : CHAINPREFIXES; m > 0 && report->prefixCounts[m - 1] < run; m--)
+	if (m < CHAINPREFIXES)
+	  {
+	    report->prefixCounts[m] = report->prefixCounts[m - 1];
+	    memcpy (report->prefixes[m], report->prefixes[m - 1],
+		    sizeof (report->prefixes[m]));
+	  }
+      if (m < CHAINPREFIXES)
+	{
+	  report->prefixCounts[m] = run;
+	  memcpy (report->prefixes[m], prefixes[j], sizeof (prefixes[j]));
+	}
+    }
+  free (prefixes);
+}
+
+int
+worstChains (const TranslationTableHeader * header, int kind,
+	     ChainReport * chains, int max, double *meanLength)
+{
+  int *longest;
+  int count = chainCount (header, kind);
+  int found = 0, k, m, length;
+  double entries = 0, weight = 0;
+  if (header == NULL || max <= 0)
+    return 0;
+  if (!(longest = malloc (max * 2 * sizeof (int))))
+    outOfMemory ();
+  /* The longest chains, as pairs of length and chain, longest first */
+  for (k = 0; k < count; k++)
+    {
+      if (!(length = chainLength (header, kind, k)))
+	continue;
+      entries += length;
+      weight += (double) length * length;
+      for (m = found < max ? found : max; m > 0 && longest[2 * (m - 1)]
+	   < length; m--)
+	if (m < max)
+	  {
+	    longest[2 * m] = longest[2 * (m - 1)];
+	    longest[2 * m + 1] = longest[2 * (m - 1) + 1];
+	  }
+      if (m < max)
+	{
+	  longest[2 * m] = length;
+	  longest[2 * m + 1] = k;
+	  if (found < max)
+	    found++;
+	}
+    }
+  for (m = 0; m < found; m++)
+    reportChain (header, kind, longest[2 * m + 1], &chains[m]);
+  free (longest);
+  if (meanLength != NULL)
+    *meanLength = entries ? weight / entries : 0;
+  return found;
+}
+
+const char *EXPORT_CALL
+lou_getOpcodeName (int opcode)
+{
+  if (opcode < 0 || opcode >= CTO_None)
+    return NULL;
+  return opcodeNames[opcode];
+}
+
+void EXPORT_CALL
+lou_setRuleProfiling (int enable)
+{
+  ruleProfiling = enable != 0;
+}
+
+static const RuleLocation *
+findRuleLocation (const RuleProfile * profile, TranslationTableOffset offset)
+{
+  int low = 0;
+  int high = profile->numLocations - 1;
+  while (low <= high)
+    {
+      int middle = (low + high) / 2;
+      if (profile->locations[middle].offset == offset)
+	return &profile->locations[middle];
+      if (profile->locations[middle].offset < offset)
+	low = middle + 1;
+      else
+	high = middle - 1;
+    }
+  return NULL;
+}
+
+static int
+compareRuleCounts (const void *a, const void *b)
+{
+  const louRuleCount *count1 = a;
+  const louRuleCount *count2 = b;
+  if (count1->tried != count2->tried)
+    return count1->tried < count2->tried ? 1 : -1;
+  if (count1->applied != count2->applied)
+    return count1->applied < count2->applied ? 1 : -1;
+  return count1->line - count2->line;
+}
+
+int EXPORT_CALL
+lou_getRuleProfile (const louTable * handle, louRuleProfile * result)
+{
+  const TranslationTableHeader *header = getTableFromHandle (handle);
+  RuleProfile *profile;
+  TranslationTableOffset offset;
+  int numRules = 0;
+  if (result == NULL)
+    return 0;
+  memset (result, 0, sizeof (*result));
+  if (header == NULL)
+    return 0;
+  lockProfiles ();
+  if (!(profile = findRuleProfile (header)))
+    {
+      unlockProfiles ();
+      return 0;
+    }
+  for (offset = 0; offset < profile->numSlots; offset++)
+    if (loadLong (profile->counts[2 * offset])
+	|| loadLong (profile->counts[2 * offset + 1]))
+      numRules++;
+  if (numRules && !(result->rules = malloc (numRules * sizeof (louRuleCount))))
+    outOfMemory ();
+  for (offset = 0; offset < profile->numSlots
+       && result->numRules < numRules; offset++)
+    {
+      louRuleCount *count = &result->rules[result->numRules];
+      const RuleLocation *location;
+      count->tried = loadLong (profile->counts[2 * offset]);
+      count->applied = loadLong (profile->counts[2 * offset + 1]);
+      if (!count->tried && !count->applied)
+	continue;
+      count->opcode =
+	((const TranslationTableRule *) & header->ruleArea[offset])->opcode;
+      location = findRuleLocation (profile, offset);
+      count->fileName = location ? profile->files[location->file] : NULL;
+      count->line = location ? location->line : 0;
+      result->numRules++;
+    }
+  result->selectTime = profile->times[ruleProfileSelecting];
+  result->testTime = profile->times[ruleProfileTesting];
+  result->indicatorTime = profile->times[ruleProfileIndicators];
+  unlockProfiles ();
+  if (result->numRules)
+    qsort (result->rules, result->numRules, sizeof (louRuleCount),
+	   compareRuleCounts);
+  return 1;
+}
+
+void EXPORT_CALL
+lou_freeRuleProfile (louRuleProfile * profile)
+{
+  if (profile == NULL)
+    return;
+  free (profile->rules);
+  profile->rules = NULL;
+  profile->numRules = 0;
+}
+
+void EXPORT_CALL
+lou_resetRuleProfile (const louTable * handle)
+{
+  const TranslationTableHeader *header = getTableFromHandle (handle);
+  RuleProfile *profile;
+  TranslationTableOffset offset;
+  if (header == NULL)
+    return;
+  lockProfiles ();
+  if ((profile = findRuleProfile (header)))
+    {
+      for (offset = 0; offset < 2 * profile->numSlots; offset++)
+	storeLong (profile->counts[offset], 0);
+      memset (profile->times, 0, sizeof (profile->times));
+    }
+  unlockProfiles ();
+}
+
+int EXPORT_CALL
+lou_writeRuleProfile (const louTable * table, const char *fileName)
+{
+  louRuleProfile profile;
+  FILE *file;
+  int k, ok;
+  if (!lou_getRuleProfile (table, &profile))
+    return 0;
+  if (!(file = fopen (fileName, "w")))
+    {
+      lou_freeRuleProfile (&profile);
+      return 0;
+    }
+  for (k = 0; k < profile.numRules; k++)
+    if (profile.rules[k].fileName)
+      fprintf (file, "%lu %lu %d %s\n", profile.rules[k].applied,
+	       profile.rules[k].tried, profile.rules[k].line,
+	       profile.rules[k].fileName);
+  ok = !ferror (file);
+  if (fclose (file))
+    ok = 0;
+  lou_freeRuleProfile (&profile);
+  return ok;
+}
+
+int EXPORT_CALL
+lou_setRuleOrderProfile (const char *fileName)
+{
+  char line[MAXSTRING];
+  RuleHeat *heats = NULL;
+  int numHeats = 0, heatsSize = 0, k, j;
+  unsigned long applied, tried;
+  int lineNumber, length, start;
+  FILE *file;
+  if (fileName == NULL)
+    {
+      freeRuleOrder ();
+      return 1;
+    }
+  if (!(file = fopen (fileName, "r")))
+    return 0;
+  while (fgets (line, sizeof (line), file))
+    {
+      length = strlen (line);
+      while (length && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+	line[--length] = 0;
+      if (sscanf (line, "%lu %lu %d %n", &applied, &tried, &lineNumber,
+		  &start) < 3 || !line[start])
+	continue;
+      if (numHeats == heatsSize)
+	{
+	  heatsSize = heatsSize ? 2 * heatsSize : 256;
+	  if (!(heats = realloc (heats, heatsSize * sizeof (RuleHeat))))
+	    outOfMemory ();
+	}
+      if (!(heats[numHeats].file = strdup (baseName (&line[start]))))
+	outOfMemory ();
+      heats[numHeats].line = lineNumber;
+      heats[numHeats++].applied = applied;
+    }
+  fclose (file);
+  /* The same file may have been profiled from several directories */
+  if (numHeats)
+    qsort (heats, numHeats, sizeof (RuleHeat), compareRuleHeats);
+  for (k = j = 0; k < numHeats; k++)
+    if (j && !compareRuleHeats (&heats[j - 1], &heats[k]))
+      {
+	heats[j - 1].applied += heats[k].applied;
+	free (heats[k].file);
+      }
+    else
+      heats[j++] = heats[k];
+  freeRuleOrder ();
+  ruleOrder = heats;
+  numRuleOrder = j;
+  return 1;
+}
+
+/* Trace events. Each thread puts them in its own buffer, so no lock is 
+* needed, and the oldest are dropped to make room. */
+#define TRACEEVENTS 4096	/*events kept for each thread */
+
+typedef struct
+{
+  louTraceEvent events[TRACEEVENTS];
+  int first;			/*the oldest event */
+  int count;
+  unsigned long dropped;
+} TraceBuffer;
+
+volatile int traceEvents = 0;
+static THREADLOCAL TraceBuffer *traceBuffer = NULL;
+
+void
+addTraceEvent (int kind, int backward, int pass, int value, int src,
+	       int dest)
+{
+  TraceBuffer *buffer = traceBuffer;
+  louTraceEvent *event;
+  if (buffer == NULL
+      && !(buffer = traceBuffer = calloc (1, sizeof (TraceBuffer))))
+    outOfMemory ();
+  if (buffer->count == TRACEEVENTS)
+    {
+      buffer->first = (buffer->first + 1) % TRACEEVENTS;
+      buffer->count--;
+      buffer->dropped++;
+    }
+  event = &buffer->events[(buffer->first + buffer->count++) % TRACEEVENTS];
+  event->kind = kind;
+  event->backward = backward;
+  event->pass = pass;
+  event->value = value;
+  event->src = src;
+  event->dest = dest;
+  event->time = currentTime ();
+}
+
+void EXPORT_CALL
+lou_setTraceEvents (int enable)
+{
+  traceEvents = enable != 0;
+  if (!enable)
+    {
+      free (traceBuffer);
+      traceBuffer = NULL;
+    }
+}
+
+int EXPORT_CALL
+lou_takeTraceEvents (louTraceEvent * events, int max, unsigned long *dropped)
+{
+  TraceBuffer *buffer = traceBuffer;
+  int count, k;
+  if (dropped != NULL)
+    *dropped = buffer ? buffer->dropped : 0;
+  if (buffer == NULL || events == NULL || max <= 0)
+    return 0;
+  count = buffer->count < max ? buffer->count : max;
+  for (k = 0; k < count; k++)
+    events[k] = buffer->events[(buffer->first + k) % TRACEEVENTS];
+  buffer->first = (buffer->first + count) % TRACEEVENTS;
+  buffer->count -= count;
+  buffer->dropped = 0;
+  return count;
+}
+
+/* Metrics. Each thread counts in a block of its own, so that counting 
+* takes no lock and no atomic operation, and lou_getMetrics adds the 
+* blocks of all threads up. A block outlives its thread, so that what it 
+* counted is kept. */
+
+typedef struct MetricsBlock
+{
+  struct MetricsBlock *next;
+  volatile unsigned long counts[METRICS];
+} MetricsBlock;
+
+static MetricsBlock *metricsBlocks;
+static THREADLOCAL MetricsBlock *threadMetrics;
+
+void
+addMetric (int metric, long n)
+{
+  MetricsBlock *block = threadMetrics;
+  if (block == NULL)
+    {
+      if (!(block = calloc (1, sizeof (MetricsBlock))))
+	outOfMemory ();
+      lockMetrics ();
+      block->next = metricsBlocks;
+      metricsBlocks = block;
+      unlockMetrics ();
+      threadMetrics = block;
+    }
+  block->counts[metric] += n;
+}
+
+void
+countTranslation (int backward, int length, int done, int status)
+{
+  addMetric (backward ? metricBackTranslations : metricTranslations, 1);
+  addMetric (backward ? metricBackTranslatedCells : metricTranslatedChars,
+	     length);
+  if (status != louWorkDone)
+    addMetric (metricWorkStopped, 1);
+  else if (done < length)
+    addMetric (metricOutputFull, 1);
+}
+
+int EXPORT_CALL
+lou_getMetrics (louMetrics * metrics)
+{
+  unsigned long counts[METRICS];
+  const MetricsBlock *block;
+  int k;
+  if (metrics == NULL)
+    return 0;
+  memset (counts, 0, sizeof (counts));
+  lockMetrics ();
+  for (block = metricsBlocks; block != NULL; block = block->next)
+    for (k = 0; k < METRICS; k++)
+      counts[k] += block->counts[k];
+  unlockMetrics ();
+  metrics->translations = counts[metricTranslations];
+  metrics->translatedChars = counts[metricTranslatedChars];
+  metrics->backTranslations = counts[metricBackTranslations];
+  metrics->backTranslatedCells = counts[metricBackTranslatedCells];
+  metrics->outputFull = counts[metricOutputFull];
+  metrics->workStopped = counts[metricWorkStopped];
+  metrics->tableHits = counts[metricTableHits];
+  metrics->tableMisses = counts[metricTableMisses];
+  metrics->tableCompiles = counts[metricTableCompiles];
+  metrics->compileSeconds = counts[metricCompileMicroseconds] / 1e6;
+  metrics->scratchBytes = (long) counts[metricScratchBytes];
+  return 1;
+}
+
+/* Context used by the functions which do not take one explicitly. */
+static louContext defaultContext;
+
+int
+getTableGeneration (void)
+{
+  return tableGeneration;
+}
+
+louContext *
+getContext (louContext * ctx)
+{
+  return ctx ? ctx : &defaultContext;
+}
+
+void EXPORT_CALL
+lou_setWordCacheSize (louContext * ctx, int size)
+{
+  ctx = getContext (ctx);
+  freeWordCache (ctx->wordCache);
+  ctx->wordCache = NULL;
+  freeBackWordCache (ctx->backWordCache);
+  ctx->backWordCache = NULL;
+  ctx->wordCacheSize = size > 0 ? size : 0;
+}
+
+louContext *EXPORT_CALL
+lou_createContext ()
+{
+  louContext *ctx = calloc (1, sizeof (louContext));
+  if (!ctx)
+    outOfMemory ();
+  return ctx;
+}
+
+static void
+dropBuffer (louContext * ctx, void **buffer, int *size, size_t unit)
+{
+  if (*buffer == NULL)
+    return;
+  free (*buffer);
+  ctx->scratchBytes -= (*size + 4) * unit;
+  addMetric (metricScratchBytes, -(long) ((*size + 4) * unit));
+  *buffer = NULL;
+  *size = 0;
+}
+
+static void
+freeContextBuffers (louContext * ctx)
+{
+  dropBuffer (ctx, (void **) &ctx->typebuf, &ctx->sizeTypebuf,
+	      sizeof (unsigned short));
+  dropBuffer (ctx, (void **) &ctx->destSpacing, &ctx->sizeDestSpacing, 1);
+  dropBuffer (ctx, (void **) &ctx->passbuf1, &ctx->sizePassbuf1, CHARSIZE);
+  dropBuffer (ctx, (void **) &ctx->passbuf2, &ctx->sizePassbuf2, CHARSIZE);
+  dropBuffer (ctx, (void **) &ctx->srcMapping, &ctx->sizeSrcMapping,
+	      sizeof (int));
+  dropBuffer (ctx, (void **) &ctx->prevSrcMapping, &ctx->sizePrevSrcMapping,
+	      sizeof (int));
+  dropBuffer (ctx, (void **) &ctx->inputAttributes,
+	      &ctx->sizeInputAttributes,
+	      sizeof (TranslationTableCharacterAttributes));
+  dropBuffer (ctx, (void **) &ctx->inputLowercase, &ctx->sizeInputLowercase,
+	      CHARSIZE);
+  dropBuffer (ctx, (void **) &ctx->result, &ctx->sizeResult, CHARSIZE);
+  dropBuffer (ctx, (void **) &ctx->resultPositions,
+	      &ctx->sizeResultPositions, sizeof (int));
+  dropBuffer (ctx, (void **) &ctx->hyphens, &ctx->sizeHyphens, 1);
+  freeWordCache (ctx->wordCache);
+  ctx->wordCache = NULL;
+  freeBackWordCache (ctx->backWordCache);
+  ctx->backWordCache = NULL;
+}
+
+void EXPORT_CALL
+lou_freeContext (louContext * ctx)
+{
+  if (ctx == NULL || ctx == &defaultContext)
+    return;
+  freeContextBuffers (ctx);
+  free (ctx);
+}
+
+static void *
+growBuffer (louContext * ctx, void **buffer, int *size, int needed,
+	    size_t unit)
+{
+/* A buffer of at least needed elements, made anew if the one held is
+ * too small, or much too big and over the scratch limit */
+  if (needed > *size || (ctx->scratchLimit > 0 && *size > 2 * needed
+			 && (*size + 4) * unit > (size_t) ctx->scratchLimit))
     {
-      errorCount++;
-      goto cleanup;
+      if (*buffer != NULL)
+	ctx->scratchShrinks += needed < *size;
+      dropBuffer (ctx, buffer, size, unit);
+      if (!(*buffer = malloc ((needed + 4) * unit)))
+	outOfMemory ();
+      *size = needed;
+      ctx->scratchBytes += (needed + 4) * unit;
+      addMetric (metricScratchBytes, (long) ((needed + 4) * unit));
+      ctx->scratchAllocs++;
+      if (ctx->scratchBytes > ctx->peakScratchBytes)
+	ctx->peakScratchBytes = ctx->scratchBytes;
     }
-  for (subTable = tableFiles; *subTable; subTable++)
-    if (!compileFile (*subTable))
-      goto cleanup;
-  
-/* Clean up after compiling files */
-cleanup:
-  free_tablefiles(tableFiles);
-  if (characterClasses)
-    deallocateCharacterClasses ();
-  if (ruleNames)
-    deallocateRuleNames ();
-  if (warningCount)
-    logMessage (LOG_WARN, "%d warnings issued", warningCount);
-  if (!errorCount)
+  return *buffer;
+}
+
+static void
+shrinkBuffer (louContext * ctx, void **buffer, int *size, size_t unit)
+{
+  if (*buffer != NULL && (*size + 4) * unit > (size_t) ctx->scratchLimit)
     {
-      setDefaults ();
-      table->tableSize = tableSize;
-      table->bytesUsed = tableUsed;
+      dropBuffer (ctx, buffer, size, unit);
+      ctx->scratchShrinks++;
     }
+}
+
+void
+shrinkScratch (louContext * ctx)
+{
+/* Called when a translation is done. The buffers of the result of
+ * lou_translateAlloc are still in use and shrink when next needed. */
+  if (ctx == NULL)
+    ctx = &defaultContext;
+  if (ctx->scratchLimit <= 0)
+    return;
+  shrinkBuffer (ctx, (void **) &ctx->typebuf, &ctx->sizeTypebuf,
+		sizeof (unsigned short));
+  shrinkBuffer (ctx, (void **) &ctx->destSpacing, &ctx->sizeDestSpacing, 1);
+  shrinkBuffer (ctx, (void **) &ctx->passbuf1, &ctx->sizePassbuf1,
+		CHARSIZE);
+  shrinkBuffer (ctx, (void **) &ctx->passbuf2, &ctx->sizePassbuf2,
+		CHARSIZE);
+  shrinkBuffer (ctx, (void **) &ctx->srcMapping, &ctx->sizeSrcMapping,
+		sizeof (int));
+  shrinkBuffer (ctx, (void **) &ctx->prevSrcMapping,
+		&ctx->sizePrevSrcMapping, sizeof (int));
+  shrinkBuffer (ctx, (void **) &ctx->inputAttributes,
+		&ctx->sizeInputAttributes,
+		sizeof (TranslationTableCharacterAttributes));
+  shrinkBuffer (ctx, (void **) &ctx->inputLowercase,
+		&ctx->sizeInputLowercase, CHARSIZE);
+  shrinkBuffer (ctx, (void **) &ctx->hyphens, &ctx->sizeHyphens, 1);
+}
+
+void EXPORT_CALL
+lou_setWorkBudget (louContext * ctx, long maxSteps, double maxSeconds)
+{
+  ctx = getContext (ctx);
+  ctx->maxSteps = maxSteps > 0 ? maxSteps : 0;
+  ctx->maxSeconds = maxSeconds > 0 ? maxSeconds : 0;
+}
+
+void EXPORT_CALL
+lou_cancelTranslation (louContext * ctx)
+{
+  getContext (ctx)->cancelled = 1;
+}
+
+int EXPORT_CALL
+lou_getWorkStatus (louContext * ctx)
+{
+  return getContext (ctx)->workStatus;
+}
+
+/* The clock is read only every so many steps */
+#define CLOCKSTEPS 64
+
+void
+startWork (louContext * ctx, WorkBudget * work)
+{
+  ctx = getContext (ctx);
+  ctx->cancelled = 0;
+  ctx->workStatus = louWorkDone;
+  work->ctx = ctx;
+  work->limited = ctx->maxSteps > 0 || ctx->maxSeconds > 0;
+  work->stepsLeft = ctx->maxSteps > 0 ? ctx->maxSteps : -1;
+  work->deadline = ctx->maxSeconds > 0 ? currentTime () + ctx->maxSeconds : 0;
+  work->steps = 0;
+  work->status = louWorkDone;
+}
+
+int
+spendWork (WorkBudget * work)
+{
+  if (work->status != louWorkDone)
+    return 1;
+  if (work->ctx != NULL && work->ctx->cancelled)
+    work->status = louWorkCancelled;
+  else if (work->stepsLeft >= 0 && work->stepsLeft-- == 0)
+    work->status = louWorkExhausted;
+  else if (work->deadline > 0 && ++work->steps % CLOCKSTEPS == 0
+	   && currentTime () > work->deadline)
+    work->status = louWorkTimedOut;
   else
-    {
-      logMessage (LOG_ERROR, "%d errors found.", errorCount);
-      if (table)
-	free (table);
-      table = NULL;
-    }
-  return (void *) table;
+    return 0;
+  /* Later passes stop at once */
+  work->limited = 1;
+  return 1;
 }
 
-static ChainEntry *lastTrans = NULL;
-static void *
-getTable (const char *tableList)
+void
+endWork (WorkBudget * work)
 {
-/*Keep track of which tables have already been compiled */
-  int tableListLen;
-  ChainEntry *currentEntry = NULL;
-  ChainEntry *lastEntry = NULL;
-  void *newTable;
-  if (tableList == NULL || *tableList == 0)
-    return NULL;
-  errorCount = fileCount = 0;
-  tableListLen = strlen (tableList);
-  /*See if this is the last table used. */
-  if (lastTrans != NULL)
-    if (tableListLen == lastTrans->tableListLength && (memcmp
-						       (&lastTrans->
-							tableList
-							[0],
-							tableList,
-							tableListLen)) == 0)
-      return (table = lastTrans->table);
-/*See if Table has already been compiled*/
-  currentEntry = tableChain;
-  while (currentEntry != NULL)
-    {
-      if (tableListLen == currentEntry->tableListLength && (memcmp
-							    (&currentEntry->
-							     tableList
-							     [0],
-							     tableList,
-							     tableListLen))
-	  == 0)
-	{
-	  lastTrans = currentEntry;
-	  return (table = currentEntry->table);
-	}
-      lastEntry = currentEntry;
-      currentEntry = currentEntry->next;
-    }
-  if ((newTable = compileTranslationTable (tableList)))
+  if (work->ctx != NULL)
     {
-      /*Add a new entry to the table chain. */
-      int entrySize = sizeof (ChainEntry) + tableListLen;
-      ChainEntry *newEntry = malloc (entrySize);
-      if (!newEntry)
-	outOfMemory ();
-      if (tableChain == NULL)
-	tableChain = newEntry;
-      else
-	lastEntry->next = newEntry;
-      newEntry->next = NULL;
-      newEntry->table = newTable;
-      newEntry->tableListLength = tableListLen;
-      memcpy (&newEntry->tableList[0], tableList, tableListLen);
-      lastTrans = newEntry;
-      return newEntry->table;
+      work->ctx->workStatus = work->status;
+      work->ctx->cancelled = 0;
     }
-  return NULL;
 }
 
-char *
-getLastTableList ()
+void EXPORT_CALL
+lou_setScratchLimit (louContext * ctx, int bytes)
 {
-  if (lastTrans == NULL)
-    return NULL;
-  strncpy (scratchBuf, lastTrans->tableList, lastTrans->tableListLength);
-  scratchBuf[lastTrans->tableListLength] = 0;
-  return scratchBuf;
+  ctx = getContext (ctx);
+  ctx->scratchLimit = bytes > 0 ? bytes : 0;
+  shrinkScratch (ctx);
 }
 
-void *EXPORT_CALL
-lou_getTable (const char *tableList)
+int EXPORT_CALL
+lou_getContextStats (louContext * ctx, louContextStats * stats)
 {
-  void *table = NULL;
-  if (tableList == NULL || tableList[0] == 0)
-    return NULL;
-  errorCount = fileCount = 0;
-  table = getTable (tableList);
-  if (!table)
-    logMessage (LOG_ERROR, "%s could not be found", tableList);
-  return table;
+  if (stats == NULL)
+    return 0;
+  ctx = getContext (ctx);
+  stats->scratchBytes = ctx->scratchBytes;
+  stats->peakScratchBytes = ctx->peakScratchBytes;
+  stats->scratchAllocs = ctx->scratchAllocs;
+  stats->scratchShrinks = ctx->scratchShrinks;
+  return 1;
 }
 
-static unsigned char *destSpacing = NULL;
-static int sizeDestSpacing = 0;
-static unsigned short *typebuf = NULL;
-static int sizeTypebuf = 0;
-static widechar *passbuf1 = NULL;
-static int sizePassbuf1 = 0;
-static widechar *passbuf2 = NULL;
-static int sizePassbuf2 = 0;
-static int *srcMapping = NULL;
-static int *prevSrcMapping = NULL;
-static int sizeSrcMapping = 0;
-static int sizePrevSrcMapping = 0;
 void *
-liblouis_allocMem (AllocBuf buffer, int srcmax, int destmax)
+liblouis_allocMem (louContext * ctx, AllocBuf buffer, int srcmax,
+		   int destmax)
 {
+  int mapSize;
+  if (ctx == NULL)
+    ctx = &defaultContext;
   if (srcmax < 1024)
     srcmax = 1024;
   if (destmax < 1024)
     destmax = 1024;
+  mapSize = srcmax >= destmax ? srcmax : destmax;
   switch (buffer)
     {
     case alloc_typebuf:
-      if (destmax > sizeTypebuf)
-	{
-	  if (typebuf != NULL)
-	    free (typebuf);
-	  typebuf = malloc ((destmax + 4) * sizeof (unsigned short));
-	  if (!typebuf)
-	    outOfMemory ();
-	  sizeTypebuf = destmax;
-	}
-      return typebuf;
+      return growBuffer (ctx, (void **) &ctx->typebuf, &ctx->sizeTypebuf,
+			 destmax, sizeof (unsigned short));
     case alloc_destSpacing:
-      if (destmax > sizeDestSpacing)
-	{
-	  if (destSpacing != NULL)
-	    free (destSpacing);
-	  destSpacing = malloc (destmax + 4);
-	  if (!destSpacing)
-	    outOfMemory ();
-	  sizeDestSpacing = destmax;
-	}
-      return destSpacing;
+      return growBuffer (ctx, (void **) &ctx->destSpacing,
+			 &ctx->sizeDestSpacing, destmax, 1);
     case alloc_passbuf1:
-      if (destmax > sizePassbuf1)
-	{
-	  if (passbuf1 != NULL)
-	    free (passbuf1);
-	  passbuf1 = malloc ((destmax + 4) * CHARSIZE);
-	  if (!passbuf1)
-	    outOfMemory ();
-	  sizePassbuf1 = destmax;
-	}
-      return passbuf1;
+      return growBuffer (ctx, (void **) &ctx->passbuf1, &ctx->sizePassbuf1,
+			 destmax, CHARSIZE);
     case alloc_passbuf2:
-      if (destmax > sizePassbuf2)
-	{
-	  if (passbuf2 != NULL)
-	    free (passbuf2);
-	  passbuf2 = malloc ((destmax + 4) * CHARSIZE);
-	  if (!passbuf2)
-	    outOfMemory ();
-	  sizePassbuf2 = destmax;
-	}
-      return passbuf2;
+      return growBuffer (ctx, (void **) &ctx->passbuf2, &ctx->sizePassbuf2,
+			 destmax, CHARSIZE);
     case alloc_srcMapping:
-      {
-	int mapSize;
-	if (srcmax >= destmax)
-	  mapSize = srcmax;
-	else
-	  mapSize = destmax;
-	if (mapSize > sizeSrcMapping)
-	  {
-	    if (srcMapping != NULL)
-	      free (srcMapping);
-	    srcMapping = malloc ((mapSize + 4) * sizeof (int));
-	    if (!srcMapping)
-	      outOfMemory ();
-	    sizeSrcMapping = mapSize;
-	  }
-      }
-      return srcMapping;
+      return growBuffer (ctx, (void **) &ctx->srcMapping,
+			 &ctx->sizeSrcMapping, mapSize, sizeof (int));
     case alloc_prevSrcMapping:
-      {
-	int mapSize;
-	if (srcmax >= destmax)
-	  mapSize = srcmax;
-	else
-	  mapSize = destmax;
-	if (mapSize > sizePrevSrcMapping)
-	  {
-	    if (prevSrcMapping != NULL)
-	      free (prevSrcMapping);
-	    prevSrcMapping = malloc ((mapSize + 4) * sizeof (int));
-	    if (!prevSrcMapping)
-	      outOfMemory ();
-	    sizePrevSrcMapping = mapSize;
-	  }
-      }
-      return prevSrcMapping;
+      return growBuffer (ctx, (void **) &ctx->prevSrcMapping,
+			 &ctx->sizePrevSrcMapping, mapSize, sizeof (int));
+    case alloc_inputAttributes:
+      return growBuffer (ctx, (void **) &ctx->inputAttributes,
+			 &ctx->sizeInputAttributes, srcmax,
+			 sizeof (TranslationTableCharacterAttributes));
+    case alloc_inputLowercase:
+      return growBuffer (ctx, (void **) &ctx->inputLowercase,
+			 &ctx->sizeInputLowercase, srcmax, CHARSIZE);
+    case alloc_result:
+      return growBuffer (ctx, (void **) &ctx->result, &ctx->sizeResult,
+			 destmax, CHARSIZE);
+    case alloc_resultPositions:
+      return growBuffer (ctx, (void **) &ctx->resultPositions,
+			 &ctx->sizeResultPositions, destmax, sizeof (int));
+    case alloc_hyphens:
+      return growBuffer (ctx, (void **) &ctx->hyphens, &ctx->sizeHyphens,
+			 srcmax, 1);
     default:
       return NULL;
     }
@@ -5043,44 +10529,36 @@ lou_free ()
 {
   ChainEntry *currentEntry;
   ChainEntry *previousEntry;
+  int bucket;
+  lou_waitForPreload ();
   closeLogFile();
-  if (tableChain != NULL)
+  lockCompiler ();
+  for (bucket = 0; bucket < CHAINHASHNUM; bucket++)
     {
-      currentEntry = tableChain;
+      currentEntry = tableChain[bucket];
       while (currentEntry)
 	{
-	  free (currentEntry->table);
+	  freeEntryTable (currentEntry);
+	  freeSourceFiles (currentEntry->files, currentEntry->numFiles);
+	  free (currentEntry->fileList);
 	  previousEntry = currentEntry;
 	  currentEntry = currentEntry->next;
 	  free (previousEntry);
 	}
-      tableChain = NULL;
-      lastTrans = NULL;
-    }
-  if (typebuf != NULL)
-    free (typebuf);
-  typebuf = NULL;
-  sizeTypebuf = 0;
-  if (destSpacing != NULL)
-    free (destSpacing);
-  destSpacing = NULL;
-  sizeDestSpacing = 0;
-  if (passbuf1 != NULL)
-    free (passbuf1);
-  passbuf1 = NULL;
-  sizePassbuf1 = 0;
-  if (passbuf2 != NULL)
-    free (passbuf2);
-  passbuf2 = NULL;
-  sizePassbuf2 = 0;
-  if (srcMapping != NULL)
-    free (srcMapping);
-  srcMapping = NULL;
-  sizeSrcMapping = 0;
-  if (prevSrcMapping != NULL)
-    free (prevSrcMapping);
-  prevSrcMapping = NULL;
-  sizePrevSrcMapping = 0;
+      tableChain[bucket] = NULL;
+    }
+  freeRetiredTables ();
+  freeRuleProfiles ();
+  tableGeneration++;
+  lastTrans = NULL;
+  table = NULL;
+  unlockCompiler ();
+  lockIncludes ();
+  freeCompiledIncludes ();
+  unlockIncludes ();
+  forgetResolvedTables ();
+  freeContextBuffers (&defaultContext);
+  defaultContext.overlay = NULL;
   opcodeLengths[0] = 0;
 }
 
@@ -5100,9 +10578,343 @@ lou_charSize ()
 int EXPORT_CALL
 lou_compileString (const char *tableList, const char *inString)
 {
-  if (!lou_getTable (tableList))
+  ChainEntry *entry;
+  int result;
+  if (tableList == NULL || tableList[0] == 0)
+    return 0;
+  /* The reference taken is kept, so that the rules added are never lost 
+   * by evicting the table */
+  if (!(entry = getTableEntry (tableList)))
+    {
+      logMessage (LOG_ERROR, "%s could not be found", tableList);
+      return 0;
+    }
+  /* New rules must come after the ones left out */
+  completeTable (loadPointer (entry->table),
+		 LOU_LAZY_HYPHENATION | LOU_LAZY_BACKTRANSLATION);
+  lockCompiler ();
+  /* The table may not be the one compiled last, so pick up its sizes 
+   * before adding to it. */
+  errorCount = warningCount = 0;
+  lazyParts = 0;
+  if (entry->mapping)
+    {
+      /* A mapped image is read-only, so change a copy of it. */
+      TranslationTableHeader *image = entry->table;
+      if (!(table = malloc (image->bytesUsed)))
+	outOfMemory ();
+      memcpy (table, image, image->bytesUsed);
+      storePointer (entry->table, table);
+      unmapTableImage (entry->mapping, entry->mappingSize);
+      entry->mapping = NULL;
+    }
+  table = entry->table;
+  tableSize = table->tableSize;
+  tableUsed = table->bytesUsed;
+  forRulesLinked = passRulesLinked = backRulesLinked = 0;
+  tableGeneration++;
+  result = compileString (inString);
+  result = freezeTable (FREEZE_ADDED) && result;
+  table->tableSize = tableSize;
+  table->bytesUsed = tableUsed;
+  storePointer (lastTrans, entry);
+  unlockCompiler ();
+  return result;
+}
+
+/* User dictionaries. Their rules are parsed like those of a table but
+* kept apart from it, so the table is neither changed nor copied. */
+
+typedef struct
+{
+  TranslationTableRule *rule;
+  int line;
+} OverlayRule;
+
+static int
+overlayOpcode (TranslationTableOpcode opcode)
+{
+/* Whether a rule of a user dictionary may have this opcode */
+  switch (opcode)
+    {
+    case CTO_Always:
+    case CTO_WholeWord:
+    case CTO_LowWord:
+    case CTO_LargeSign:
+    case CTO_JoinableWord:
+    case CTO_SuffixableWord:
+    case CTO_PrefixableWord:
+    case CTO_BegWord:
+    case CTO_BegMidWord:
+    case CTO_MidWord:
+    case CTO_MidEndWord:
+    case CTO_EndWord:
+    case CTO_PartWord:
+      return 1;
+    default:
+      return 0;
+    }
+}
+
+static const TranslationTableCharacter *
+findCharInTable (const TranslationTableHeader * header, widechar c)
+{
+  TranslationTableOffset bucket = header->characters[c % HASHNUM];
+  const TranslationTableCharacter *character;
+  while (bucket)
+    {
+      character = (TranslationTableCharacter *) & header->ruleArea[bucket];
+      if (character->realchar == c)
+	return character;
+      bucket = character->next;
+    }
+  return NULL;
+}
+
+static TranslationTableRule *
+compileOverlayRule (FileInfo * nested, const TranslationTableHeader * header)
+{
+/* Parse a line of a user dictionary. Return NULL if it has an error or
+* no rule. */
+  CharsString token;
+  CharsString ruleChars;
+  CharsString ruleDots;
+  TranslationTableOpcode opcode;
+  TranslationTableRule *rule;
+  const TranslationTableCharacter *character;
+  int k;
+  if (!getToken (nested, &token, NULL) || token.chars[0] == '#'
+      || token.chars[0] == '<')
+    return NULL;
+  if ((opcode = getOpcode (nested, &token)) == CTO_None)
+    return NULL;
+  if (!overlayOpcode (opcode))
+    {
+      compileError (nested, "opcode %s cannot be used in a user dictionary",
+		    opcodeNames[opcode]);
+      return NULL;
+    }
+  if (!getRuleCharsText (nested, &ruleChars)
+      || !getRuleDotsPattern (nested, &ruleDots))
+    return NULL;
+  if (!ruleDots.length)
+    {
+      compileError (nested, "the dots of a user dictionary rule must be "
+		    "given");
+      return NULL;
+    }
+  if (!(rule = malloc (sizeof (TranslationTableRule)
+		       - DEFAULTRULESIZE * CHARSIZE
+		       + CHARSIZE * (2 * ruleChars.length + ruleDots.length))))
+    outOfMemory ();
+  memset (rule, 0, sizeof (TranslationTableRule)
+	  - DEFAULTRULESIZE * CHARSIZE);
+  rule->opcode = opcode;
+  rule->charslen = ruleChars.length;
+  rule->dotslen = ruleDots.length;
+  memcpy (&rule->charsdots[0], ruleChars.chars, CHARSIZE * rule->charslen);
+  memcpy (&rule->charsdots[rule->charslen], ruleDots.chars,
+	  CHARSIZE * rule->dotslen);
+  for (k = 0; k < rule->charslen; k++)
+    {
+      if (!(character = findCharInTable (header, ruleChars.chars[k])))
+	{
+	  compileError (nested, "Character %s is not defined",
+			showString (&ruleChars.chars[k], 1));
+	  free (rule);
+	  return NULL;
+	}
+      rule->charsdots[rule->charslen + rule->dotslen + k] =
+	character->lowercase;
+    }
+  return rule;
+}
+
+static int
+compareOverlayRules (const void *a, const void *b)
+{
+/* By the lowercase of the first character, then longest first, then in
+* the order of the lines */
+  const OverlayRule *rule1 = a;
+  const OverlayRule *rule2 = b;
+  widechar first1 = rule1->rule->charsdots[rule1->rule->charslen
+					   + rule1->rule->dotslen];
+  widechar first2 = rule2->rule->charsdots[rule2->rule->charslen
+					   + rule2->rule->dotslen];
+  if (first1 != first2)
+    return first1 < first2 ? -1 : 1;
+  if (rule1->rule->charslen != rule2->rule->charslen)
+    return rule2->rule->charslen - rule1->rule->charslen;
+  return rule1->line - rule2->line;
+}
+
+louOverlay *EXPORT_CALL
+lou_compileOverlay (const louTable * handle, const char *rules)
+{
+  const TranslationTableHeader *header = getTableFromHandle (handle);
+  louOverlay *overlay;
+  OverlayRule *sorted = NULL;
+  int numSorted = 0, maxSorted = 0;
+  TranslationTableRule *rule;
+  FileInfo nested;
+  int k;
+  if (header == NULL || rules == NULL)
+    return NULL;
+  errorCount = warningCount = 0;
+  nested.fileName = "user dictionary";
+  nested.encoding = noEncoding;
+  nested.status = 0;
+  for (nested.lineNumber = 1; *rules; nested.lineNumber++)
+    {
+      for (k = 0; rules[k] && rules[k] != '\n'; k++)
+	if (k < MAXSTRING - 1)
+	  nested.line[k] = rules[k];
+      if (k >= MAXSTRING - 1)
+	compileError (&nested, "the line is too long");
+      else
+	{
+	  nested.line[k] = 0;
+	  nested.linelen = k;
+	  nested.linepos = 0;
+	  if ((rule = compileOverlayRule (&nested, header)))
+	    {
+	      if (numSorted == maxSorted)
+		{
+		  maxSorted = maxSorted ? 2 * maxSorted : 16;
+		  if (!(sorted = realloc (sorted,
+					  maxSorted * sizeof (OverlayRule))))
+		    outOfMemory ();
+		}
+	      sorted[numSorted].rule = rule;
+	      sorted[numSorted].line = nested.lineNumber;
+	      numSorted++;
+	    }
+	}
+      rules += rules[k] ? k + 1 : k;
+    }
+  if (!(overlay = calloc (1, sizeof (louOverlay)))
+      || !(overlay->rules = malloc ((numSorted + 1)
+				    * sizeof (TranslationTableRule *))))
+    outOfMemory ();
+  overlay->table = handle;
+  overlay->numRules = numSorted;
+  if (numSorted)
+    qsort (sorted, numSorted, sizeof (OverlayRule), compareOverlayRules);
+  for (k = 0; k < numSorted; k++)
+    overlay->rules[k] = sorted[k].rule;
+  free (sorted);
+  if (errorCount)
+    {
+      logMessage (LOG_ERROR, "%d errors found in the user dictionary",
+		  errorCount);
+      lou_freeOverlay (overlay);
+      return NULL;
+    }
+  return overlay;
+}
+
+void EXPORT_CALL
+lou_freeOverlay (louOverlay * overlay)
+{
+  int k;
+  if (overlay == NULL)
+    return;
+  for (k = 0; k < overlay->numRules; k++)
+    free (overlay->rules[k]);
+  free (overlay->rules);
+  free (overlay);
+}
+
+void EXPORT_CALL
+lou_setContextOverlay (louContext * ctx, const louOverlay * overlay)
+{
+  getContext (ctx)->overlay = overlay;
+}
+
+int EXPORT_CALL
+lou_saveCompiledTable (const char *tableList, const char *fileName)
+{
+  const louTable *handle;
+  const TranslationTableHeader *compiled;
+  int saved;
+  if (fileName == NULL || !(handle = lou_openTable (tableList)))
+    return 0;
+  compiled = completeTable (getTableFromHandle (handle),
+			    LOU_LAZY_HYPHENATION | LOU_LAZY_BACKTRANSLATION);
+  saved = writeTableImage (compiled, fileName, handle->files,
+			   handle->numFiles);
+  lou_closeTable (handle);
+  return saved;
+}
+
+void *EXPORT_CALL
+lou_loadCompiledTable (const char *tableList, const char *fileName)
+{
+  int tableListLen;
+  unsigned long int makeHash;
+  ChainEntry *entry;
+  TranslationTableHeader *image;
+  void *mapping;
+  size_t mappingSize;
+  double startTime = currentTime ();
+  if (tableList == NULL || tableList[0] == 0 || fileName == NULL)
+    return NULL;
+  tableListLen = strlen (tableList);
+  makeHash = tableListHash (tableList, tableListLen);
+  lockCompiler ();
+  /* The reference taken is kept, since the table is returned */
+  if ((entry = findTableEntry (tableList, tableListLen, makeHash))
+      && takeReference (entry))
+    {
+      unlockCompiler ();
+      return entry->table;
+    }
+  if (!(image = loadTableImage (fileName, &mapping, &mappingSize)))
+    {
+      unlockCompiler ();
+      logMessage (LOG_ERROR, "Cannot load compiled table %s", fileName);
+      return NULL;
+    }
+  if (entry)
+    /* The table was evicted */
+    fillTableEntry (entry, image, mapping, mappingSize,
+		    currentTime () - startTime);
+  else
+    {
+      entry = newTableEntry (tableList, tableListLen, makeHash);
+      fillTableEntry (entry, image, mapping, mappingSize,
+		      currentTime () - startTime);
+      addTableEntry (entry);
+    }
+  evictTables ();
+  unlockCompiler ();
+  return image;
+}
+
+int EXPORT_CALL
+lou_registerCompiledTable (const char *tableList, const void *image,
+			   int size)
+{
+  BuiltinTable *builtin;
+  TranslationTableHeader *table;
+  if (tableList == NULL || tableList[0] == 0 || image == NULL || size <= 0)
     return 0;
-  return compileString (inString);
+  if (!(table = checkTableImage (image, size, 0)))
+    {
+      logMessage (LOG_ERROR, "The compiled table of %s was not made by "
+		  "this version of liblouis", tableList);
+      return 0;
+    }
+  if (!(builtin = malloc (sizeof (*builtin) + strlen (tableList))))
+    outOfMemory ();
+  builtin->data = image;
+  builtin->image = table;
+  strcpy (builtin->tableList, tableList);
+  lockCompiler ();
+  builtin->next = builtinTables;
+  storePointer (builtinTables, builtin);
+  unlockCompiler ();
+  return 1;
 }
 
 /**
@@ -180,6 +180,7 @@ typedef struct
 {
   char * name;
   List * features;
+  int order;	/* The number of tables indexed before */
 } TableMeta;
 
 /*
@@ -410,15 +411,14 @@ widestrToStr(const widechar * str, size_t n)
 }
 
 /*
- * Extract a list of features from a table.
+ * Return the file a table resolves to, or NULL if it does not resolve to
+ * exactly one file. The returned string must be freed by the caller.
  */
-static List *
-analyzeTable(const char * table)
+static char *
+resolveTableFile(const char * table)
 {
-  static char fileName[MAXSTRING];
   char ** resolved;
-  List * features = NULL;
-  FileInfo info;
+  char * fileName;
   int k;
   resolved = resolveTable(table, NULL);
   if (resolved == NULL)
@@ -426,20 +426,32 @@ analyzeTable(const char * table)
       logMessage(LOG_ERROR, "Cannot resolve table '%s'", table);
       return NULL;
     }
-  sprintf(fileName, "%s", *resolved);
-  k = 0;
+  fileName = strdup(*resolved);
   for (k = 0; resolved[k]; k++)
     free(resolved[k]);
   free(resolved);
   if (k > 1)
     {
       logMessage(LOG_ERROR, "Table '%s' resolves to more than one file", table);
+      free(fileName);
       return NULL;
     }
+  return fileName;
+}
+
+/*
+ * Extract a list of features from a table file.
+ */
+static List *
+analyzeTable(const char * fileName)
+{
+  List * features = NULL;
+  FileInfo info;
   info.fileName = fileName;
   info.encoding = noEncoding;
   info.status = 0;
   info.lineNumber = 0;
+  info.bufferPos = info.bufferLength = 0;
   if ((info.in = fopen(info.fileName, "rb")))
     {
       while (getALine(&info))
@@ -518,30 +530,396 @@ analyzeTable(const char * table)
 	       info.linepos);
   else
     logMessage(LOG_ERROR, "Unexpected newline on line %d", info.lineNumber);
+  fclose(info.in);
   list_free(features);
   return NULL;
 }
 
+/* ================================ INDEX ================================= */
+
+/*
+ * The tables indexed, most recently indexed first, and an inverted index of
+ * their features: a hash table, keyed on the key and value of a feature, of
+ * lists of postings that point to the tables with that feature.
+ */
+
+#define FEATUREHASHNUM 251
+
+typedef struct
+{
+  const Feature * feature;
+  TableMeta * table;
+} Posting;
+
 static List * tableIndex = NULL;
+static List * featureIndex[FEATUREHASHNUM];
+static int tablesIndexed = 0;
 
-void EXPORT_CALL
-lou_indexTables(const char ** tables)
+static unsigned int
+featureHash(const Feature * f)
 {
-  const char ** table;
+  unsigned int h = 0;
+  const char * c;
+  for (c = f->key; *c; c++)
+    h = h * 31 + (unsigned char)*c;
+  h = h * 31 + ':';
+  for (c = f->val; *c; c++)
+    h = h * 31 + (unsigned char)*c;
+  return h % FEATUREHASHNUM;
+}
+
+static void
+tableMeta_free(TableMeta * m)
+{
+  if (m)
+    {
+      free(m->name);
+      list_free(m->features);
+      free(m);
+    }
+}
+
+static void
+clearIndex(void)
+{
+  int k;
+  for (k = 0; k < FEATUREHASHNUM; k++)
+    {
+      list_free(featureIndex[k]);
+      featureIndex[k] = NULL;
+    }
   list_free(tableIndex);
   tableIndex = NULL;
+  tablesIndexed = 0;
+}
+
+/*
+ * Add a table with its features to the index. The index takes over the list
+ * of features.
+ */
+static void
+addToIndex(const char * name, List * features)
+{
+  TableMeta m = { strdup(name), features, tablesIndexed++ };
+  TableMeta * table = memcpy(malloc(sizeof(m)), &m, sizeof(m));
+  List * l;
+  tableIndex = list_conj(tableIndex, table, NULL, NULL, (void (*)(void *))tableMeta_free);
+  for (l = features; l; l = l->tail)
+    {
+      Posting p = { l->head, table };
+      unsigned int h = featureHash(l->head);
+      featureIndex[h] = list_conj(featureIndex[h], memcpy(malloc(sizeof(p)), &p, sizeof(p)),
+				  NULL, NULL, free);
+    }
+}
+
+/* ================================ CACHE ================================= */
+
+/*
+ * An index can be kept in a cache file, so that the tables need not be read
+ * again as long as they have not changed. The file is in UTF-8 and starts
+ * with the line in INDEXCACHEHEADER. Then comes a line for each table with
+ * its name, the file it resolves to, the time the file was modified, its size
+ * and the number of its features, separated by tabs, followed by a line for
+ * each feature with its key and value separated by a tab. Tables without
+ * features are in the file too.
+ */
+
+#define INDEXCACHEHEADER "liblouis table index 1\n"
+
+typedef struct
+{
+  const char * name;
+  const char * fileName;
+  long mtime;
+  long size;
+  int numFeatures;
+  const char * features;	/* The keys and values, each ended by a null */
+} CacheEntry;
+
+typedef struct
+{
+  char * name;
+  char * fileName;
+  long mtime;
+  long size;
+  List * features;	/* Owned by the index */
+} IndexedFile;
+
+/*
+ * Return the field starting at `*pos' and ended by `sep', with `sep' replaced
+ * by a null, and move `*pos' past it. Returns NULL if the field is ended by
+ * anything else.
+ */
+static char *
+nextField(char ** pos, char sep)
+{
+  char * field = *pos;
+  size_t n = strcspn(field, "\t\n");
+  if (field[n] != sep)
+    return NULL;
+  field[n] = '\0';
+  *pos = &field[n + 1];
+  return field;
+}
+
+/*
+ * Read a cache file with a single read into a buffer, and make an array of
+ * its entries pointing into the buffer. Returns the buffer, which must be
+ * freed by the caller along with `*entries', or NULL if the file cannot be
+ * read or is not a valid cache.
+ */
+static char *
+readIndexCache(const char * cacheFile, CacheEntry ** entries, int * numEntries)
+{
+  FILE * file;
+  struct stat info;
+  char * buffer;
+  char * pos;
+  char * field;
+  int size = 0;
+  *entries = NULL;
+  *numEntries = 0;
+  if (stat(cacheFile, &info) != 0 || !(file = fopen(cacheFile, "rb")))
+    return NULL;
+  if (!(buffer = malloc(info.st_size + 1)))
+    {
+      fclose(file);
+      return NULL;
+    }
+  if (fread(buffer, 1, info.st_size, file) != info.st_size)
+    goto invalid;
+  fclose(file);
+  file = NULL;
+  buffer[info.st_size] = '\0';
+  if (strncmp(buffer, INDEXCACHEHEADER, strlen(INDEXCACHEHEADER)) != 0)
+    goto invalid;
+  pos = &buffer[strlen(INDEXCACHEHEADER)];
+  while (*pos)
+    {
+      CacheEntry e;
+      int k;
+      if (!(e.name = nextField(&pos, '\t'))
+	  || !(e.fileName = nextField(&pos, '\t'))
+	  || !(field = nextField(&pos, '\t')))
+	goto invalid;
+      e.mtime = strtol(field, NULL, 10);
+      if (!(field = nextField(&pos, '\t')))
+	goto invalid;
+      e.size = strtol(field, NULL, 10);
+      if (!(field = nextField(&pos, '\n')))
+	goto invalid;
+      e.numFeatures = atoi(field);
+      e.features = pos;
+      for (k = 0; k < e.numFeatures; k++)
+	if (!nextField(&pos, '\t') || !nextField(&pos, '\n'))
+	  goto invalid;
+      if (*numEntries == size)
+	{
+	  CacheEntry * more;
+	  size = size ? 2 * size : 64;
+	  if (!(more = realloc(*entries, size * sizeof(CacheEntry))))
+	    goto invalid;
+	  *entries = more;
+	}
+      (*entries)[(*numEntries)++] = e;
+    }
+  return buffer;
+ invalid:
+  logMessage(LOG_WARN, "%s is not a valid table index", cacheFile);
+  if (file)
+    fclose(file);
+  free(buffer);
+  free(*entries);
+  *entries = NULL;
+  *numEntries = 0;
+  return NULL;
+}
+
+/*
+ * Find the entry for a table in a cache, if its file has not changed. The
+ * entry at `*next' is tried first, as the tables are usually indexed in the
+ * same order as they were before, and `*next' is moved past the entry found.
+ */
+static const CacheEntry *
+findCacheEntry(const CacheEntry * entries, int numEntries, int * next,
+	       const char * name, const char * fileName, long mtime, long size)
+{
+  int k;
+  for (k = 0; k < numEntries; k++)
+    {
+      const CacheEntry * e = &entries[(*next + k) % numEntries];
+      if (strcmp(e->name, name) == 0)
+	{
+	  if (strcmp(e->fileName, fileName) != 0 || e->mtime != mtime || e->size != size)
+	    return NULL;
+	  *next = (*next + k + 1) % numEntries;
+	  return e;
+	}
+    }
+  return NULL;
+}
+
+/*
+ * Make a sorted list of the features of a cache entry.
+ */
+static List *
+cachedFeatures(const CacheEntry * e)
+{
+  List * features = NULL;
+  const char * key = e->features;
+  int k;
+  for (k = 0; k < e->numFeatures; k++)
+    {
+      const char * val = key + strlen(key) + 1;
+      Feature f = feature_new(key, val);
+      features = list_conj(features, memcpy(malloc(sizeof(f)), &f, sizeof(f)),
+			   (int (*)(void *, void *))cmpKeys, NULL,
+			   (void (*)(void *))feature_free);
+      key = val + strlen(val) + 1;
+    }
+  return features;
+}
+
+/*
+ * Return true if a string can be written as a field of a cache file.
+ */
+static int
+isCacheField(const char * s)
+{
+  return strcspn(s, "\t\n") == strlen(s);
+}
+
+/*
+ * Write the files indexed to a cache file. The cache is written to a
+ * temporary file first and then renamed, so that it is never seen half
+ * written.
+ */
+static void
+writeIndexCache(const char * cacheFile, const IndexedFile * files, int numFiles)
+{
+  char * tempFile = malloc(strlen(cacheFile) + 5);
+  FILE * file;
+  int k, ok;
+  sprintf(tempFile, "%s.tmp", cacheFile);
+  if (!(file = fopen(tempFile, "wb")))
+    {
+      logMessage(LOG_WARN, "Cannot write table index %s", tempFile);
+      free(tempFile);
+      return;
+    }
+  fputs(INDEXCACHEHEADER, file);
+  for (k = 0; k < numFiles; k++)
+    {
+      const IndexedFile * f = &files[k];
+      List * l;
+      if (!isCacheField(f->name) || !isCacheField(f->fileName))
+	continue;
+      fprintf(file, "%s\t%s\t%ld\t%ld\t%d\n", f->name, f->fileName, f->mtime, f->size,
+	      list_size(f->features));
+      for (l = f->features; l; l = l->tail)
+	fprintf(file, "%s\t%s\n", ((Feature *)l->head)->key, ((Feature *)l->head)->val);
+    }
+  ok = !ferror(file);
+  if (fclose(file) != 0)
+    ok = 0;
+#ifdef _WIN32
+  if (ok)
+    remove(cacheFile);
+#endif
+  if (!ok || rename(tempFile, cacheFile) != 0)
+    {
+      logMessage(LOG_WARN, "Cannot write table index %s", cacheFile);
+      remove(tempFile);
+    }
+  free(tempFile);
+}
+
+/*
+ * Index tables, taking the features of the tables that have not changed from
+ * `cacheFile' if it is not NULL, and writing the cache again if any table had
+ * to be read.
+ */
+static void
+indexTables(const char ** tables, const char * cacheFile)
+{
+  const char ** table;
+  CacheEntry * entries = NULL;
+  char * cache = NULL;
+  IndexedFile * files = NULL;
+  int numEntries = 0;
+  int numFiles = 0;
+  int next = 0;
+  int changed = 0;
+  int k;
+  clearIndex();
+  if (cacheFile)
+    {
+      for (table = tables; *table; table++)
+	numFiles++;
+      files = malloc((numFiles + 1) * sizeof(IndexedFile));
+      numFiles = 0;
+      cache = readIndexCache(cacheFile, &entries, &numEntries);
+    }
   for (table = tables; *table; table++)
     {
-      logMessage(LOG_DEBUG, "Analyzing table %s", *table);
-      List * features = analyzeTable(*table);
-      if (features)
+      char * fileName;
+      struct stat info;
+      const CacheEntry * e = NULL;
+      List * features;
+      int cached;
+      if (!(fileName = resolveTableFile(*table)))
+	continue;
+      cached = cacheFile && stat(fileName, &info) == 0;
+      if (cached)
+	e = findCacheEntry(entries, numEntries, &next, *table, fileName,
+			   (long)info.st_mtime, (long)info.st_size);
+      if (e)
+	features = cachedFeatures(e);
+      else
+	{
+	  logMessage(LOG_DEBUG, "Analyzing table %s", *table);
+	  features = analyzeTable(fileName);
+	  changed = 1;
+	}
+      if (cached)
 	{
-	  TableMeta m = { strdup(*table), features };
-	  tableIndex = list_conj(tableIndex, memcpy(malloc(sizeof(m)), &m, sizeof(m)), NULL, NULL, free);
+	  IndexedFile f = { strdup(*table), fileName, (long)info.st_mtime,
+			    (long)info.st_size, features };
+	  files[numFiles++] = f;
 	}
+      else
+	free(fileName);
+      if (features)
+	addToIndex(*table, features);
     }
   if (!tableIndex)
     logMessage(LOG_WARN, "No tables were indexed");
+  if (cacheFile)
+    {
+      if (changed || numFiles != numEntries)
+	writeIndexCache(cacheFile, files, numFiles);
+      for (k = 0; k < numFiles; k++)
+	{
+	  free(files[k].name);
+	  free(files[k].fileName);
+	}
+      free(files);
+      free(entries);
+      free(cache);
+    }
+}
+
+void EXPORT_CALL
+lou_indexTables(const char ** tables)
+{
+  indexTables(tables, NULL);
+}
+
+void EXPORT_CALL
+lou_indexTablesCached(const char ** tables, const char * cacheFile)
+{
+  indexTables(tables, cacheFile);
 }
 
 #ifdef _WIN32
@@ -614,22 +992,37 @@ lou_findTable(const char * query)
     }
   List * queryFeatures = parseQuery(query);
   int bestQuotient = 0;
-  char * bestMatch = NULL;
+  TableMeta * bestMatch = NULL;
   List * l;
-  for (l = tableIndex; l; l = l->tail)
+  /* Only a table with a feature of the query can have a positive match
+     quotient, so only the tables posted under the features of the query are
+     scored. Of the tables with the same quotient the last one indexed wins. */
+  for (l = queryFeatures; l; l = l->tail)
     {
-      TableMeta * table = l->head;
-      int q = matchFeatureLists(queryFeatures, table->features, 0);
-      if (q > bestQuotient)
+      const Feature * f = l->head;
+      List * p;
+      for (p = featureIndex[featureHash(f)]; p; p = p->tail)
 	{
-	  bestQuotient = q;
-	  bestMatch = strdup(table->name);
+	  Posting * posting = p->head;
+	  if (strcmp(posting->feature->key, f->key) == 0
+	      && strcmp(posting->feature->val, f->val) == 0)
+	    {
+	      TableMeta * table = posting->table;
+	      int q = matchFeatureLists(queryFeatures, table->features, 0);
+	      if (q > bestQuotient
+		  || (q == bestQuotient && bestMatch && table->order > bestMatch->order))
+		{
+		  bestQuotient = q;
+		  bestMatch = table;
+		}
+	    }
 	}
     }
+  list_free(queryFeatures);
   if (bestMatch)
      {
-       logMessage(LOG_INFO, "Best match: %s (%d)", bestMatch, bestQuotient);
-       return bestMatch;
+       logMessage(LOG_INFO, "Best match: %s (%d)", bestMatch->name, bestQuotient);
+       return strdup(bestMatch->name);
      }
   else
     {
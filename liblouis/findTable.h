@@ -32,10 +32,15 @@ extern "C"
 
   typedef enum { noEncoding, bigEndian, littleEndian, ascii8 } EncodingType;
 
+#define FILEBUFSIZE 8192
+
   typedef struct
   {
     const char *fileName;
     FILE *in;
+    unsigned char buffer[FILEBUFSIZE];	/* Block read from in */
+    int bufferPos;
+    int bufferLength;
     int lineNumber;
     EncodingType encoding;
     int status;
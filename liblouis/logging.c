@@ -39,11 +39,17 @@ void logWidecharBuf(logLevels level, const char *msg, const widechar *wbuf, int
    * Give space for additional message (+ strlen(msg))
    * Remember the null terminator (+ 1)
    */
-  int logBufSize = (wlen * ((sizeof(widechar) * 2) + 3)) + 1 + strlen(msg);
-  char *logMsg = malloc(logBufSize);
-  char *p = logMsg;
+  int logBufSize;
+  char *logMsg;
+  char *p;
   char *formatString;
   int i = 0;
+  if (!logEnabled(level))
+    return;
+  logBufSize = (wlen * ((sizeof(widechar) * 2) + 3)) + 1 + strlen(msg);
+  if (!(logMsg = malloc(logBufSize)))
+    return;
+  p = logMsg;
   if (sizeof(widechar) == 2)
     formatString = "0x%04X ";
   else
@@ -74,7 +80,7 @@ void EXPORT_CALL lou_registerLogCallback(logcallback callback)
     logCallbackFunction = callback;
 }
 
-static logLevels logLevel = LOG_INFO;
+logLevels logLevel = LOG_INFO;
 void EXPORT_CALL lou_setLogLevel(logLevels level)
 {
   logLevel = level;
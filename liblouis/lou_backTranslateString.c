@@ -33,26 +33,87 @@
 
 #include "louis.h"
 
-static const TranslationTableHeader *table;	/*translation table */
-static int src, srcmax;
-static int dest, destmax;
-static int mode;
-static int currentPass = 1;
-static widechar *currentInput;
-static widechar *passbuf1 = NULL;
-static widechar *passbuf2 = NULL;
-static widechar *currentOutput;
-static unsigned char *typebuf = NULL;
-static int *srcMapping = NULL;
-static char *spacebuf;
-static int backTranslateString ();
-static int makeCorrections ();
-static int translatePass ();
-
-static int *outputPositions;
-static int *inputPositions;
-static int cursorPosition;
-static int cursorStatus;
+/* All of the state of a single back-translation. An instance lives on 
+* the stack of the entry point, so that concurrent calls do not 
+* interfere with each other. */
+typedef struct
+{
+  const TranslationTableHeader *table;	/*translation table */
+  int src, srcmax;
+  int dest, destmax;
+  int mode;
+  int currentPass;
+  widechar *currentInput;
+  widechar *passbuf1;
+  widechar *passbuf2;
+  widechar *currentOutput;
+  unsigned char *typebuf;
+  int *srcMapping;
+  char *spacebuf;
+  int *outputPositions;
+  int *inputPositions;
+  int cursorPosition;
+  int cursorStatus;
+  int *states;
+  char currentTypeform;
+  int nextUpper;
+  int allUpper;
+  int itsANumber;
+  int itsALetter;
+  int itsCompbrl;
+  int currentCharslen;
+  int currentDotslen;		/*length of current find string */
+  int previousSrc;
+  TranslationTableOpcode currentOpcode;
+  TranslationTableOpcode previousOpcode;
+  const TranslationTableRule *currentRule;	/*pointer to current rule in 
+						   table */
+  widechar before, after;
+  TranslationTableCharacterAttributes beforeAttributes;
+  TranslationTableCharacterAttributes afterAttributes;
+  int doingMultind;
+  const TranslationTableRule *multindRule;
+  int passVariables[NUMVAR];
+  int passSrc;
+  const widechar *passInstructions;
+  int passIC;			/*Instruction counter */
+  int startMatch;
+  int endMatch;
+  int startReplace;
+  int endReplace;
+  TranslationTableCharacter noChar;
+  TranslationTableCharacter noDots;
+  widechar prevc;
+  TranslationTableCharacterAttributes preva;
+  TranslationTableRule pseudoRule;
+/*The word being remembered in the word cache, if wordStart is not -1. 
+* Its translation may only depend on the input up to wordLimit, the 
+* blank cell after it. */
+  struct BackWordCache *wordCache;
+  int wordStart;
+  int wordLimit;
+  int wordDest;
+  int wordUnsafe;
+  unsigned int wordHash;
+  int wordBefore;
+  int wordState;
+  TranslationTableOpcode wordPrevOpcode;
+  WorkBudget work;
+} BackTranslationState;
+
+#define NOWORDLIMIT 0x7fffffff	/*wordLimit when no word is remembered */
+
+static int backTranslateString (BackTranslationState *st);
+static struct BackWordCache *getBackWordCache (louContext * ctx);
+static int makeCorrections (BackTranslationState *st);
+static int translatePass (BackTranslationState *st);
+static int backTranslateWithContext (louContext * ctx,
+				     const char *tableList,
+				     const widechar * inbuf, int *inlen,
+				     widechar * outbuf, int *outlen,
+				     formtype *typeform, char *spacing,
+				     int *outputPos, int *inputPos,
+				     int *cursorPos, int modex);
 
 int EXPORT_CALL
 lou_backTranslateString (const char *tableList, const widechar
@@ -73,8 +134,47 @@ lou_backTranslate (const char *tableList, const
 		   formtype *typeform, char *spacing, int
 		   *outputPos, int *inputPos, int *cursorPos, int modex)
 {
-  int k;
-  int goodTrans = 1;
+  return backTranslateWithContext (NULL, tableList, inbuf, inlen, outbuf,
+				   outlen, typeform, spacing, outputPos,
+				   inputPos, cursorPos, modex);
+}
+
+int EXPORT_CALL
+lou_backTranslateWithTable (const louTable * handle, louContext * ctx,
+			    const widechar * inbuf, int *inlen,
+			    widechar * outbuf, int *outlen,
+			    formtype *typeform, char *spacing,
+			    int *outputPos, int *inputPos, int *cursorPos,
+			    int modex)
+{
+  return backTranslateWithTable (ctx, getTableFromHandle (handle), inbuf,
+				 inlen, outbuf, outlen, typeform, spacing,
+				 outputPos, inputPos, cursorPos, modex);
+}
+
+int EXPORT_CALL
+lou_backTranslateCtx (louContext * ctx, const char *tableList,
+		      const widechar * inbuf, int *inlen, widechar * outbuf,
+		      int *outlen, formtype *typeform, char *spacing,
+		      int *outputPos, int *inputPos, int *cursorPos,
+		      int modex)
+{
+  if (ctx == NULL)
+    return 0;
+  return backTranslateWithContext (ctx, tableList, inbuf, inlen, outbuf,
+				   outlen, typeform, spacing, outputPos,
+				   inputPos, cursorPos, modex);
+}
+
+static int
+backTranslateWithContext (louContext * ctx, const char *tableList,
+			  const widechar * inbuf, int *inlen,
+			  widechar * outbuf, int *outlen,
+			  formtype *typeform, char *spacing, int *outputPos,
+			  int *inputPos, int *cursorPos, int modex)
+{
+  const louTable *handle;
+  int rv;
   if (tableList == NULL || inbuf == NULL || inlen == NULL || outbuf ==
       NULL || outlen == NULL)
     return 0;
@@ -83,208 +183,252 @@ lou_backTranslate (const char *tableList, const
 				inlen, outbuf, outlen,
 				typeform, spacing, outputPos, inputPos,
 				cursorPos, modex);
-  table = lou_getTable (tableList);
-  if (table == NULL)
+  handle = lou_openTable (tableList);
+  rv = backTranslateWithTable (ctx, getTableFromHandle (handle), inbuf,
+			       inlen, outbuf, outlen, typeform, spacing,
+			       outputPos, inputPos, cursorPos, modex);
+  lou_closeTable (handle);
+  return rv;
+}
+
+static int
+backTranslate (louContext * ctx, const TranslationTableHeader * table,
+	       const widechar * inbuf, int *inlen, widechar * outbuf,
+	       int *outlen, formtype *typeform, char *spacing,
+	       int *outputPos, int *inputPos, int *cursorPos, int *states,
+	       int modex)
+{
+  BackTranslationState state;
+  BackTranslationState *st = &state;
+  int k;
+  int length;
+  int goodTrans = 1;
+  if (table == NULL || inbuf == NULL || inlen == NULL || outbuf == NULL
+      || outlen == NULL)
     return 0;
-  srcmax = 0;
-  while (srcmax < *inlen && inbuf[srcmax])
-    srcmax++;
-  destmax = *outlen;
-  typebuf = (unsigned char *) typeform;
-  spacebuf = spacing;
-  outputPositions = outputPos;
+  if (table->lazyBackRules)
+    table = completeTable (table, LOU_LAZY_BACKTRANSLATION);
+  traceEvent (louTraceStart, 1, 0, 0, *inlen, 0);
+  memset (st, 0, sizeof (*st));
+  st->currentTypeform = plain_text;
+  st->table = table;
+  startWork (ctx, &st->work);
+  st->wordStart = -1;
+  st->wordLimit = NOWORDLIMIT;
+  /* Remembered words leave out the bookkeeping these need */
+  if (typeform == NULL && spacing == NULL && outputPos == NULL
+      && inputPos == NULL && cursorPos == NULL)
+    st->wordCache = getBackWordCache (ctx);
+  st->srcmax = 0;
+  while (st->srcmax < *inlen && inbuf[st->srcmax])
+    st->srcmax++;
+  length = st->srcmax;
+  st->destmax = *outlen;
+  st->typebuf = (unsigned char *) typeform;
+  st->spacebuf = spacing;
+  st->outputPositions = outputPos;
   if (outputPos != NULL)
-    for (k = 0; k < srcmax; k++)
+    for (k = 0; k < st->srcmax; k++)
       outputPos[k] = -1;
-  inputPositions = inputPos;
+  st->inputPositions = inputPos;
   if (cursorPos != NULL)
-    cursorPosition = *cursorPos;
+    st->cursorPosition = *cursorPos;
   else
-    cursorPosition = -1;
-  cursorStatus = 0;
-  mode = modex;
-  if (!(passbuf1 = liblouis_allocMem (alloc_passbuf1, srcmax, destmax)))
+    st->cursorPosition = -1;
+  st->cursorStatus = 0;
+  st->states = states;
+  if (states != NULL)
+    memset (states, 0, (st->srcmax + 1) * sizeof (int));
+  st->mode = modex;
+  if (!(st->passbuf1 = liblouis_allocMem (ctx, alloc_passbuf1, st->srcmax,
+					  st->destmax)))
     return 0;
-  if (typebuf != NULL)
-    memset (typebuf, '0', destmax);
-  if (spacebuf != NULL)
-    memset (spacebuf, '*', destmax);
-  for (k = 0; k < srcmax; k++)
-    if ((mode & dotsIO))
-      passbuf1[k] = inbuf[k] | 0x8000;
-    else
-      passbuf1[k] = getDotsForChar (inbuf[k]);
-  passbuf1[srcmax] = getDotsForChar (' ');
-  if (!(srcMapping = liblouis_allocMem (alloc_srcMapping, srcmax, destmax)))
+  if (st->typebuf != NULL)
+    memset (st->typebuf, '0', st->destmax);
+  if (st->spacebuf != NULL)
+    memset (st->spacebuf, '*', st->destmax);
+  if ((st->mode & dotsIO))
+    for (k = 0; k < st->srcmax; k++)
+      if ((inbuf[k] & 0xff00) == 0x2800)	/*Unicode braille */
+	st->passbuf1[k] = (inbuf[k] & 0x00ff) | 0x8000;
+      else
+	st->passbuf1[k] = inbuf[k] | 0x8000;
+  else
+    getDotsForCharsInTable (st->table, inbuf, st->passbuf1, st->srcmax);
+  st->passbuf1[st->srcmax] = getDotsForCharInTable (st->table, ' ');
+  if (!(st->srcMapping = liblouis_allocMem (ctx, alloc_srcMapping, st->srcmax,
+					    st->destmax)))
     return 0;
-  for (k = 0; k <= srcmax; k++)
-    srcMapping[k] = k;
-  srcMapping[srcmax] = srcmax;
-  currentInput = passbuf1;
-  if ((!(mode & pass1Only)) && (table->numPasses > 1 || table->corrections))
+  for (k = 0; k <= st->srcmax; k++)
+    st->srcMapping[k] = k;
+  st->srcMapping[st->srcmax] = st->srcmax;
+  st->currentInput = st->passbuf1;
+  if ((!(st->mode & pass1Only)) && (st->table->numPasses > 1
+				    || st->table->corrections))
     {
-      if (!(passbuf2 = liblouis_allocMem (alloc_passbuf2, srcmax, destmax)))
+      if (!(st->passbuf2 = liblouis_allocMem (ctx, alloc_passbuf2, st->srcmax,
+					      st->destmax)))
 	return 0;
     }
-  currentPass = table->numPasses;
-  if ((mode & pass1Only))
+  st->currentPass = st->table->numPasses;
+  if ((st->mode & pass1Only))
     {
-      currentOutput = outbuf;
-      goodTrans = backTranslateString ();
+      st->currentOutput = outbuf;
+      goodTrans = backTranslateString (st);
     }
   else
-    switch (table->numPasses + (table->corrections << 3))
+    switch (st->table->numPasses + (st->table->corrections << 3))
       {
       case 1:
-	currentOutput = outbuf;
-	goodTrans = backTranslateString ();
+	st->currentOutput = outbuf;
+	goodTrans = backTranslateString (st);
 	break;
       case 2:
-	currentOutput = passbuf2;
-	goodTrans = translatePass ();
+	st->currentOutput = st->passbuf2;
+	goodTrans = translatePass (st);
 	if (!goodTrans)
 	  break;
-	currentPass--;
-	srcmax = dest;
-	currentInput = passbuf2;
-	currentOutput = outbuf;
-	goodTrans = backTranslateString ();
+	st->currentPass--;
+	st->srcmax = st->dest;
+	st->currentInput = st->passbuf2;
+	st->currentOutput = outbuf;
+	goodTrans = backTranslateString (st);
 	break;
       case 3:
-	currentOutput = passbuf2;
-	goodTrans = translatePass ();
+	st->currentOutput = st->passbuf2;
+	goodTrans = translatePass (st);
 	if (!goodTrans)
 	  break;
-	currentPass--;
-	srcmax = dest;
-	currentInput = passbuf2;
-	currentOutput = passbuf1;
-	goodTrans = translatePass ();
+	st->currentPass--;
+	st->srcmax = st->dest;
+	st->currentInput = st->passbuf2;
+	st->currentOutput = st->passbuf1;
+	goodTrans = translatePass (st);
 	if (!goodTrans)
 	  break;
-	currentInput = passbuf1;
-	currentOutput = outbuf;
-	currentPass--;
-	srcmax = src;
-	goodTrans = backTranslateString ();
+	st->currentInput = st->passbuf1;
+	st->currentOutput = outbuf;
+	st->currentPass--;
+	st->srcmax = st->src;
+	goodTrans = backTranslateString (st);
 	break;
       case 4:
-	currentOutput = passbuf2;
-	goodTrans = translatePass ();
+	st->currentOutput = st->passbuf2;
+	goodTrans = translatePass (st);
 	if (!goodTrans)
 	  break;
-	currentPass--;
-	srcmax = dest;
-	currentInput = passbuf2;
-	currentOutput = passbuf1;
-	goodTrans = translatePass ();
+	st->currentPass--;
+	st->srcmax = st->dest;
+	st->currentInput = st->passbuf2;
+	st->currentOutput = st->passbuf1;
+	goodTrans = translatePass (st);
 	if (!goodTrans)
 	  break;
-	currentInput = passbuf1;
-	currentOutput = passbuf2;
-	srcmax = dest;
-	currentPass--;
-	goodTrans = translatePass ();
+	st->currentInput = st->passbuf1;
+	st->currentOutput = st->passbuf2;
+	st->srcmax = st->dest;
+	st->currentPass--;
+	goodTrans = translatePass (st);
 	if (!goodTrans)
 	  break;
-	currentInput = passbuf2;
-	currentOutput = outbuf;
-	currentPass--;
-	srcmax = dest;
-	goodTrans = backTranslateString ();
+	st->currentInput = st->passbuf2;
+	st->currentOutput = outbuf;
+	st->currentPass--;
+	st->srcmax = st->dest;
+	goodTrans = backTranslateString (st);
 	break;
       case 9:
-	currentOutput = passbuf2;
-	goodTrans = backTranslateString ();
+	st->currentOutput = st->passbuf2;
+	goodTrans = backTranslateString (st);
 	if (!goodTrans)
 	  break;
-	currentInput = passbuf2;
-	currentOutput = outbuf;
-	currentPass--;
-	srcmax = dest;
-	goodTrans = makeCorrections ();
+	st->currentInput = st->passbuf2;
+	st->currentOutput = outbuf;
+	st->currentPass--;
+	st->srcmax = st->dest;
+	goodTrans = makeCorrections (st);
 	break;
       case 10:
-	currentOutput = passbuf2;
-	goodTrans = translatePass ();
+	st->currentOutput = st->passbuf2;
+	goodTrans = translatePass (st);
 	if (!goodTrans)
 	  break;
-	currentPass--;
-	srcmax = dest;
-	currentInput = passbuf2;
-	currentOutput = passbuf1;
-	goodTrans = backTranslateString ();
+	st->currentPass--;
+	st->srcmax = st->dest;
+	st->currentInput = st->passbuf2;
+	st->currentOutput = st->passbuf1;
+	goodTrans = backTranslateString (st);
 	if (!goodTrans)
 	  break;
-	currentInput = passbuf1;
-	currentOutput = outbuf;
-	currentPass--;
-	srcmax = dest;
-	goodTrans = makeCorrections ();
+	st->currentInput = st->passbuf1;
+	st->currentOutput = outbuf;
+	st->currentPass--;
+	st->srcmax = st->dest;
+	goodTrans = makeCorrections (st);
 	break;
       case 11:
-	currentOutput = passbuf2;
-	goodTrans = translatePass ();
+	st->currentOutput = st->passbuf2;
+	goodTrans = translatePass (st);
 	if (!goodTrans)
 	  break;
-	currentPass--;
-	srcmax = dest;
-	currentInput = passbuf2;
-	currentOutput = passbuf1;
-	goodTrans = translatePass ();
+	st->currentPass--;
+	st->srcmax = st->dest;
+	st->currentInput = st->passbuf2;
+	st->currentOutput = st->passbuf1;
+	goodTrans = translatePass (st);
 	if (!goodTrans)
 	  break;
-	currentInput = passbuf1;
-	currentOutput = passbuf2;
-	currentPass--;
-	srcmax = dest;
-	goodTrans = backTranslateString ();
+	st->currentInput = st->passbuf1;
+	st->currentOutput = st->passbuf2;
+	st->currentPass--;
+	st->srcmax = st->dest;
+	goodTrans = backTranslateString (st);
 	if (!goodTrans)
 	  break;
-	currentInput = passbuf2;
-	currentOutput = outbuf;
-	currentPass--;
-	srcmax = dest;
-	goodTrans = makeCorrections ();
+	st->currentInput = st->passbuf2;
+	st->currentOutput = outbuf;
+	st->currentPass--;
+	st->srcmax = st->dest;
+	goodTrans = makeCorrections (st);
 	break;
       case 12:
-	currentOutput = passbuf2;
-	goodTrans = translatePass ();
+	st->currentOutput = st->passbuf2;
+	goodTrans = translatePass (st);
 	if (!goodTrans)
 	  break;
-	currentPass--;
-	srcmax = dest;
-	currentInput = passbuf2;
-	currentOutput = passbuf1;
-	goodTrans = translatePass ();
+	st->currentPass--;
+	st->srcmax = st->dest;
+	st->currentInput = st->passbuf2;
+	st->currentOutput = st->passbuf1;
+	goodTrans = translatePass (st);
 	if (!goodTrans)
 	  break;
-	currentInput = passbuf1;
-	currentOutput = passbuf2;
-	srcmax = dest;
-	currentPass--;
-	goodTrans = translatePass ();
+	st->currentInput = st->passbuf1;
+	st->currentOutput = st->passbuf2;
+	st->srcmax = st->dest;
+	st->currentPass--;
+	goodTrans = translatePass (st);
 	if (!goodTrans)
 	  break;
-	currentInput = passbuf2;
-	currentOutput = passbuf1;
-	currentPass--;
-	srcmax = dest;
-	goodTrans = backTranslateString ();
+	st->currentInput = st->passbuf2;
+	st->currentOutput = st->passbuf1;
+	st->currentPass--;
+	st->srcmax = st->dest;
+	goodTrans = backTranslateString (st);
 	if (!goodTrans)
 	  break;
-	currentInput = passbuf1;
-	currentOutput = outbuf;
-	currentPass--;
-	srcmax = dest;
-	goodTrans = makeCorrections ();
+	st->currentInput = st->passbuf1;
+	st->currentOutput = outbuf;
+	st->currentPass--;
+	st->srcmax = st->dest;
+	goodTrans = makeCorrections (st);
 	break;
       default:
 	break;
       }
-  if (src < *inlen)
-    *inlen = srcMapping[src];
-  *outlen = dest;
+  if (st->src < *inlen)
+    *inlen = st->srcMapping[st->src];
+  *outlen = st->dest;
   if (outputPos != NULL)
     {
       int lastpos = 0;
@@ -295,69 +439,93 @@ lou_backTranslate (const char *tableList, const
 	  lastpos = outputPos[k];
     }
   if (cursorPos != NULL)
-    *cursorPos = cursorPosition;
+    *cursorPos = st->cursorPosition;
+  endWork (&st->work);
+  countTranslation (1, length, goodTrans ? *inlen : length,
+		    st->work.status);
+  if (st->work.status != louWorkDone)
+    goodTrans = 0;
+  shrinkScratch (ctx);
+  traceEvent (louTraceEnd, 1, 0, goodTrans, st->src, st->dest);
   return goodTrans;
 }
 
-static char currentTypeform = plain_text;
-static int nextUpper = 0;
-static int allUpper = 0;
-static int itsANumber = 0;
-static int itsALetter = 0;
-static int itsCompbrl = 0;
-static int currentCharslen;
-static int currentDotslen;	/*length of current find string */
-static int previousSrc;
-static TranslationTableOpcode currentOpcode;
-static TranslationTableOpcode previousOpcode;
-static const TranslationTableRule *currentRule;	/*pointer to current rule in 
-						   table */
+int
+backTranslateWithTable (louContext * ctx,
+			const TranslationTableHeader * table,
+			const widechar * inbuf, int *inlen,
+			widechar * outbuf, int *outlen, formtype *typeform,
+			char *spacing, int *outputPos, int *inputPos,
+			int *cursorPos, int modex)
+{
+  return backTranslate (ctx, table, inbuf, inlen, outbuf, outlen, typeform,
+			spacing, outputPos, inputPos, cursorPos, NULL, modex);
+}
+
+int
+backTranslateWithStates (louContext * ctx,
+			 const TranslationTableHeader * table,
+			 const widechar * inbuf, int *inlen,
+			 widechar * outbuf, int *outlen, int *outputPos,
+			 int *inputPos, int *cursorPos, int *states,
+			 int modex)
+{
+  return backTranslate (ctx, table, inbuf, inlen, outbuf, outlen, NULL,
+			NULL, outputPos, inputPos, cursorPos, states, modex);
+}
+
 static TranslationTableCharacter *
-back_findCharOrDots (widechar c, int m)
+back_findCharOrDots (BackTranslationState *st, widechar c, int m)
 {
 /*Look up character or dot pattern in the appropriate  
-* table. */
-  static TranslationTableCharacter noChar =
-    { 0, 0, 0, CTC_Space, 32, 32, 32 };
-  static TranslationTableCharacter noDots =
-    { 0, 0, 0, CTC_Space, B16, B16, B16 };
+* table. The hash chains are walked rather than the index findCharOrDots 
+* uses or an open-addressing table: they are short, their heads are in 
+* the header, and a longer lookup keeps this from being inlined, which 
+* costs back-translation about a tenth of its speed. */
+  static const TranslationTableCharacter noChar =
+    { 0, 0, 0, CTC_Space, 32, 32, 32, 0 };
+  static const TranslationTableCharacter noDots =
+    { 0, 0, 0, CTC_Space, B16, B16, B16, 0 };
   TranslationTableCharacter *notFound;
   TranslationTableCharacter *character;
   TranslationTableOffset bucket;
   unsigned long int makeHash = (unsigned long int) c % HASHNUM;
   if (m == 0)
-    {
-      bucket = table->characters[makeHash];
-      notFound = &noChar;
-    }
+    bucket = st->table->characters[makeHash];
   else
-    {
-      bucket = table->dots[makeHash];
-      notFound = &noDots;
-    }
+    bucket = st->table->dots[makeHash];
   while (bucket)
     {
-      character = (TranslationTableCharacter *) & table->ruleArea[bucket];
+      character = (TranslationTableCharacter *) & st->table->ruleArea[bucket];
       if (character->realchar == c)
 	return character;
       bucket = character->next;
     }
+  if (m == 0)
+    {
+      notFound = &st->noChar;
+      *notFound = noChar;
+    }
+  else
+    {
+      notFound = &st->noDots;
+      *notFound = noDots;
+    }
   notFound->realchar = notFound->uppercase = notFound->lowercase = c;
   return notFound;
 }
 
 static int
-checkAttr (const widechar c, const TranslationTableCharacterAttributes
+checkAttr (BackTranslationState *st, const widechar c,
+	   const TranslationTableCharacterAttributes
 	   a, int m)
 {
-  static widechar prevc = 0;
-  static TranslationTableCharacterAttributes preva = 0;
-  if (c != prevc)
+  if (c != st->prevc)
     {
-      preva = (back_findCharOrDots (c, m))->attributes;
-      prevc = c;
+      st->preva = (back_findCharOrDots (st, c, m))->attributes;
+      st->prevc = c;
     }
-  return ((preva & a) ? 1 : 0);
+  return ((st->preva & a) ? 1 : 0);
 }
 
 static int
@@ -372,36 +540,50 @@ compareDots (const widechar * address1, const widechar * address2, int count)
   return 1;
 }
 
-static widechar before, after;
-static TranslationTableCharacterAttributes beforeAttributes;
-static TranslationTableCharacterAttributes afterAttributes;
 static void
-back_setBefore ()
+checkWordLimit (BackTranslationState *st)
 {
-  before = (dest == 0) ? ' ' : currentOutput[dest - 1];
-  beforeAttributes = (back_findCharOrDots (before, 0))->attributes;
+/*Whether the rule in currentRule, which takes in the blank cell after 
+* the word being remembered, matches the input up to that cell, so that 
+* what follows decides if it is used */
+  const widechar *dots =
+    &st->currentRule->charsdots[st->currentRule->charslen];
+  int k;
+  if (st->src + st->currentDotslen <= st->wordLimit)
+    return;
+  for (k = 0; st->src + k <= st->wordLimit; k++)
+    if (dots[k] != st->currentInput[st->src + k])
+      return;
+  st->wordUnsafe = 1;
+}
+
+static void
+back_setBefore (BackTranslationState *st)
+{
+  st->before = (st->dest == 0) ? ' ' : st->currentOutput[st->dest - 1];
+  st->beforeAttributes = (back_findCharOrDots (st, st->before, 0))->attributes;
 }
 
 static void
-back_setAfter (int length)
+back_setAfter (BackTranslationState *st, int length)
 {
-  after = (src + length < srcmax) ? currentInput[src + length] : ' ';
-  afterAttributes = (back_findCharOrDots (after, 1))->attributes;
+  st->after = (st->src + length < st->srcmax) ? st->currentInput[st->src + length] : ' ';
+  st->afterAttributes = (back_findCharOrDots (st, st->after, 1))->attributes;
 }
 
 
 static int
-isBegWord ()
+isBegWord (BackTranslationState *st)
 {
 /*See if this is really the beginning of a word. Look at what has 
 * already been translated. */
   int k;
-  if (dest == 0)
+  if (st->dest == 0)
     return 1;
-  for (k = dest - 1; k >= 0; k--)
+  for (k = st->dest - 1; k >= 0; k--)
     {
       const TranslationTableCharacter *ch =
-	back_findCharOrDots (currentOutput[k], 0);
+	back_findCharOrDots (st, st->currentOutput[k], 0);
       if (ch->attributes & CTC_Space)
 	break;
       if (ch->attributes & (CTC_Letter | CTC_Digit | CTC_Math | CTC_Sign))
@@ -411,18 +593,18 @@ isBegWord ()
 }
 
 static int
-isEndWord ()
+isEndWord (BackTranslationState *st)
 {
 /*See if this is really the end of a word. */
   int k;
   const TranslationTableCharacter *dots;
   TranslationTableOffset testRuleOffset;
   TranslationTableRule *testRule;
-  for (k = src + currentDotslen; k < srcmax; k++)
+  for (k = st->src + st->currentDotslen; k < st->srcmax; k++)
     {
       int postpuncFound = 0;
       int TranslationFound = 0;
-      dots = back_findCharOrDots (currentInput[k], 1);
+      dots = back_findCharOrDots (st, st->currentInput[k], 1);
       testRuleOffset = dots->otherRules;
       if (dots->attributes & CTC_Space)
 	break;
@@ -431,7 +613,7 @@ isEndWord ()
       while (testRuleOffset)
 	{
 	  testRule =
-	    (TranslationTableRule *) & table->ruleArea[testRuleOffset];
+	    (TranslationTableRule *) & st->table->ruleArea[testRuleOffset];
 	  if (testRule->charslen > 1)
 	    TranslationFound = 1;
 	  if (testRule->opcode == CTO_PostPunc)
@@ -446,142 +628,394 @@ isEndWord ()
   return 1;
 }
 static int
-findBrailleIndicatorRule (TranslationTableOffset offset)
+findBrailleIndicatorRule (BackTranslationState *st,
+			  TranslationTableOffset offset)
 {
   if (!offset)
     return 0;
-  currentRule = (TranslationTableRule *) & table->ruleArea[offset];
-  currentOpcode = currentRule->opcode;
-  currentDotslen = currentRule->dotslen;
+  st->currentRule = (TranslationTableRule *) & st->table->ruleArea[offset];
+  st->currentOpcode = st->currentRule->opcode;
+  st->currentDotslen = st->currentRule->dotslen;
   return 1;
 }
 
-static int doingMultind = 0;
-static const TranslationTableRule *multindRule;
 
 static int
-handleMultind ()
+handleMultind (BackTranslationState *st)
 {
 /*Handle multille braille indicators*/
   int found = 0;
-  if (!doingMultind)
+  if (!st->doingMultind)
     return 0;
-  switch (multindRule->charsdots[multindRule->charslen - doingMultind])
+  switch (st->multindRule->charsdots[st->multindRule->charslen - st->doingMultind])
     {
     case CTO_CapitalSign:
-      found = findBrailleIndicatorRule (table->capitalSign);
+      found = findBrailleIndicatorRule (st, st->table->capitalSign);
       break;
     case CTO_BeginCapitalSign:
-      found = findBrailleIndicatorRule (table->beginCapitalSign);
+      found = findBrailleIndicatorRule (st, st->table->beginCapitalSign);
       break;
     case CTO_EndCapitalSign:
-      found = findBrailleIndicatorRule (table->endCapitalSign);
+      found = findBrailleIndicatorRule (st, st->table->endCapitalSign);
       break;
     case CTO_LetterSign:
-      found = findBrailleIndicatorRule (table->letterSign);
+      found = findBrailleIndicatorRule (st, st->table->letterSign);
       break;
     case CTO_NumberSign:
-      found = findBrailleIndicatorRule (table->numberSign);
+      found = findBrailleIndicatorRule (st, st->table->numberSign);
       break;
     case CTO_LastWordItalBefore:
-      found = findBrailleIndicatorRule (table->lastWordItalBefore);
+      found = findBrailleIndicatorRule (st, st->table->lastWordItalBefore);
       break;
     case CTO_BegItal:
-      found = findBrailleIndicatorRule (table->firstLetterItal);
+      found = findBrailleIndicatorRule (st, st->table->firstLetterItal);
       break;
     case CTO_LastLetterItal:
-      found = findBrailleIndicatorRule (table->lastLetterItal);
+      found = findBrailleIndicatorRule (st, st->table->lastLetterItal);
       break;
     case CTO_LastWordBoldBefore:
-      found = findBrailleIndicatorRule (table->lastWordBoldBefore);
+      found = findBrailleIndicatorRule (st, st->table->lastWordBoldBefore);
       break;
     case CTO_FirstLetterBold:
-      found = findBrailleIndicatorRule (table->firstLetterBold);
+      found = findBrailleIndicatorRule (st, st->table->firstLetterBold);
       break;
     case CTO_LastLetterBold:
-      found = findBrailleIndicatorRule (table->lastLetterBold);
+      found = findBrailleIndicatorRule (st, st->table->lastLetterBold);
       break;
     case CTO_LastWordUnderBefore:
-      found = findBrailleIndicatorRule (table->lastWordUnderBefore);
+      found = findBrailleIndicatorRule (st, st->table->lastWordUnderBefore);
       break;
     case CTO_FirstLetterUnder:
-      found = findBrailleIndicatorRule (table->firstLetterUnder);
+      found = findBrailleIndicatorRule (st, st->table->firstLetterUnder);
       break;
     case CTO_EndUnder:
-      found = findBrailleIndicatorRule (table->lastLetterUnder);
+      found = findBrailleIndicatorRule (st, st->table->lastLetterUnder);
       break;
     case CTO_BegComp:
-      found = findBrailleIndicatorRule (table->begComp);
+      found = findBrailleIndicatorRule (st, st->table->begComp);
       break;
     case CTO_EndComp:
-      found = findBrailleIndicatorRule (table->endComp);
+      found = findBrailleIndicatorRule (st, st->table->endComp);
       break;
     default:
       found = 0;
       break;
     }
-  doingMultind--;
+  st->doingMultind--;
   return found;
 }
 
-static int passVariables[NUMVAR];
-static int passSrc;
-static const widechar *passInstructions;
-static int passIC;		/*Instruction counter */
-static int startMatch;
-static int endMatch;
-static int startReplace;
-static int endReplace;
 
-static int back_passDoTest ();
-static int back_passDoAction ();
+static int back_passDoTest (BackTranslationState *st);
+static int back_passDoAction (BackTranslationState *st);
 
 static int
-findAttribOrSwapRules ()
+findAttribOrSwapRules (BackTranslationState *st)
 {
   TranslationTableOffset ruleOffset;
-  if (src == previousSrc)
+  if (st->src == st->previousSrc)
     return 0;
-  ruleOffset = table->attribOrSwapRules[currentPass];
-  currentCharslen = 0;
+  ruleOffset = st->table->attribOrSwapRules[st->currentPass];
+  st->currentCharslen = 0;
   while (ruleOffset)
     {
-      currentRule = (TranslationTableRule *) & table->ruleArea[ruleOffset];
-      currentOpcode = currentRule->opcode;
-      if (back_passDoTest ())
+      st->currentRule = (TranslationTableRule *) & st->table->ruleArea[ruleOffset];
+      st->currentOpcode = st->currentRule->opcode;
+      if (back_passDoTest (st))
+	return 1;
+      ruleOffset = st->currentRule->charsnext;
+    }
+  return 0;
+}
+
+static int
+back_checkRule (BackTranslationState *st)
+{
+/*See whether the rule in currentRule, whose dots match the input, can 
+* be used here */
+  back_setAfter (st, st->currentDotslen);
+  if ((!st->currentRule->after || (st->beforeAttributes
+			       & st->currentRule->after)) &&
+      (!st->currentRule->before || (st->afterAttributes
+				& st->currentRule->before)))
+    {
+      switch (st->currentOpcode)
+	{		/*check validity of this Translation */
+	case CTO_Space:
+	case CTO_Digit:
+	case CTO_Letter:
+	case CTO_UpperCase:
+	case CTO_LowerCase:
+	case CTO_Punctuation:
+	case CTO_Math:
+	case CTO_Sign:
+	case CTO_ExactDots:
+	case CTO_NoCross:
+	case CTO_Repeated:
+	case CTO_Replace:
+	case CTO_Hyphen:
+	  return 1;
+	case CTO_LitDigit:
+	  if (st->itsANumber)
+	    return 1;
+	  break;
+	case CTO_CapitalRule:
+	case CTO_BeginCapitalRule:
+	case CTO_EndCapitalRule:
+	case CTO_FirstLetterItalRule:
+	case CTO_LastLetterItalRule:
+	case CTO_LastWordBoldBeforeRule:
+	case CTO_LastLetterBoldRule:
+	case CTO_FirstLetterUnderRule:
+	case CTO_LastLetterUnderRule:
+	case CTO_NumberRule:
+	case CTO_BegCompRule:
+	case CTO_EndCompRule:
+	  return 1;
+	case CTO_LetterRule:
+	  if (!(st->beforeAttributes &
+		CTC_Letter) && (st->afterAttributes & CTC_Letter))
+	    return 1;
+	  break;
+	case CTO_MultInd:
+	  st->doingMultind = st->currentDotslen;
+	  st->multindRule = st->currentRule;
+	  if (handleMultind (st))
+	    return 1;
+	  break;
+	case CTO_LargeSign:
+	  return 1;
+	case CTO_WholeWord:
+	  if (st->itsALetter || st->itsANumber)
+	    break;
+	  /* fall through */
+	case CTO_Contraction:
+	  if ((st->beforeAttributes & (CTC_Space | CTC_Punctuation))
+	      && ((st->afterAttributes & CTC_Space)
+		  || isEndWord (st)))
+	    return 1;
+	  break;
+	case CTO_LowWord:
+	  if ((st->beforeAttributes & CTC_Space)
+	      && (st->afterAttributes & CTC_Space) &&
+	      (st->previousOpcode != CTO_JoinableWord))
+	    return 1;
+	  break;
+	case CTO_JoinNum:
+	case CTO_JoinableWord:
+	  if ((st->beforeAttributes & (CTC_Space |
+				   CTC_Punctuation))
+	      && !((st->afterAttributes & CTC_Space)))
+	    return 1;
+	  break;
+	case CTO_SuffixableWord:
+	  if (st->beforeAttributes & (CTC_Space | CTC_Punctuation))
+	    return 1;
+	  break;
+	case CTO_PrefixableWord:
+	  if ((st->beforeAttributes & (CTC_Space | CTC_Letter |
+				   CTC_Punctuation))
+	      && isEndWord (st))
+	    return 1;
+	  break;
+	case CTO_BegWord:
+	  if ((st->beforeAttributes & (CTC_Space | CTC_Punctuation))
+	      && (!isEndWord (st)))
+	    return 1;
+	  break;
+	case CTO_BegMidWord:
+	  if ((st->beforeAttributes & (CTC_Letter | CTC_Space |
+				   CTC_Punctuation))
+	      && (!isEndWord (st)))
+	    return 1;
+	  break;
+	case CTO_PartWord:
+	  if (!(st->beforeAttributes & CTC_LitDigit)
+	      && (st->beforeAttributes & CTC_Letter || !isEndWord (st)))
+	    return 1;
+	  break;
+	case CTO_MidWord:
+	  if (st->beforeAttributes & CTC_Letter && !isEndWord (st))
+	    return 1;
+	  break;
+	case CTO_MidEndWord:
+	  if ((st->beforeAttributes & CTC_Letter))
+	    return 1;
+	  break;
+	case CTO_EndWord:
+	  if ((st->beforeAttributes & CTC_Letter)
+	      && isEndWord (st))
+	    return 1;
+	  break;
+	case CTO_BegNum:
+	  if (st->beforeAttributes & (CTC_Space | CTC_Punctuation)
+	      && (st->afterAttributes & (CTC_LitDigit | CTC_Sign)))
+	    return 1;
+	  break;
+	case CTO_MidNum:
+	  if (st->beforeAttributes & CTC_Digit &&
+	      st->afterAttributes & CTC_LitDigit)
+	    return 1;
+	  break;
+	case CTO_EndNum:
+	  if (st->itsANumber
+	      && !(st->afterAttributes & CTC_LitDigit))
+	    return 1;
+	  break;
+	case CTO_DecPoint:
+	  if (st->afterAttributes & (CTC_Digit | CTC_LitDigit))
+	    return 1;
+	  break;
+	case CTO_PrePunc:
+	  if (isBegWord (st))
+	    return 1;
+	  break;
+
+	case CTO_PostPunc:
+	  if (isEndWord (st))
+	    return 1;
+	  break;
+	case CTO_Always:
+	  if ((st->beforeAttributes & CTC_LitDigit) &&
+	      (st->afterAttributes & CTC_LitDigit) &&
+	      st->currentRule->charslen > 1)
+	    break;
+	  return 1;
+	default:
+	  break;
+	}
+    }
+  return 0;
+}
+
+static int
+back_selectTrieRule (BackTranslationState *st, int length)
+{
+/*Follow the input down the trie of backward rules, then try the rules 
+* of the nodes on the way in the order of their chain, so that the rule 
+* chosen is the one the chain would give. */
+  const TrieRule *rules[BACKTRIEDEPTH + 1];
+  int numRules[BACKTRIEDEPTH + 1];
+  int ruleDepth[BACKTRIEDEPTH + 1];
+  const ForRuleNode *node;
+  const ForRuleEdge *edges;
+  const TrieRule *candidate;
+  const widechar *dots;
+  TranslationTableOffset offset = st->table->backRuleTrie;
+  widechar cell;
+  int depth, numNodes = 0, best, low, high, middle;
+  int k;
+  for (depth = 0;; depth++)
+    {
+      node = (ForRuleNode *) & st->table->ruleArea[offset];
+      if (node->numChildren && st->src + depth > st->wordLimit)
+	st->wordUnsafe = 1;
+      if (node->numRules)
+	{
+	  rules[numNodes] = (TrieRule *) & st->table->ruleArea[node->rules];
+	  numRules[numNodes] = node->numRules;
+	  ruleDepth[numNodes++] = depth;
+	}
+      if (depth == length || !node->numChildren)
+	break;
+      edges = (ForRuleEdge *) & st->table->ruleArea[node->children];
+      cell = st->currentInput[st->src + depth];
+      low = 0;
+      high = node->numChildren;
+      while (low < high)
+	{
+	  middle = (low + high) / 2;
+	  if (edges[middle].ch < cell)
+	    low = middle + 1;
+	  else
+	    high = middle;
+	}
+      if (low == node->numChildren || edges[low].ch != cell)
+	break;
+      offset = edges[low].node;
+    }
+  while (numNodes)
+    {
+      /* The node whose next rule comes first in the chain */
+      best = 0;
+      for (k = 1; k < numNodes; k++)
+	if (rules[k]->sequence < rules[best]->sequence)
+	  best = k;
+      candidate = rules[best];
+      st->currentRule = (TranslationTableRule *) & st->table->ruleArea
+	[candidate->rule];
+      depth = ruleDepth[best];
+      rules[best]++;
+      if (!--numRules[best])
+	{
+	  numNodes--;
+	  rules[best] = rules[numNodes];
+	  numRules[best] = numRules[numNodes];
+	  ruleDepth[best] = ruleDepth[numNodes];
+	}
+      st->currentOpcode = candidate->opcode;
+      st->currentDotslen = candidate->dotslen;
+      checkWordLimit (st);
+      if (st->currentDotslen > length)
+	continue;
+      /* The rule itself is only looked at past the cells kept with the 
+       * trie */
+      for (k = depth; k < st->currentDotslen && k < TRIERULEPREFIX; k++)
+	if (candidate->prefix[k] != st->currentInput[st->src + k])
+	  break;
+      if (k < st->currentDotslen && k < TRIERULEPREFIX)
+	continue;
+      dots = &st->currentRule->charsdots[st->currentRule->charslen];
+      for (; k < st->currentDotslen; k++)
+	if (dots[k] != st->currentInput[st->src + k])
+	  break;
+      if (k == st->currentDotslen && back_checkRule (st))
 	return 1;
-      ruleOffset = currentRule->charsnext;
     }
   return 0;
 }
 
 static void
-back_selectRule ()
+back_selectRule (BackTranslationState *st)
 {
 /*check for valid back-translations */
-  int length = srcmax - src;
+  int length = st->srcmax - st->src;
   TranslationTableOffset ruleOffset = 0;
-  static TranslationTableRule pseudoRule = { 0 };
   unsigned long int makeHash = 0;
   const TranslationTableCharacter *dots =
-    back_findCharOrDots (currentInput[src], 1);
+    back_findCharOrDots (st, st->currentInput[st->src], 1);
   int tryThis;
-  if (handleMultind ())
+  if (handleMultind (st))
     return;
   for (tryThis = 0; tryThis < 3; tryThis++)
     {
       switch (tryThis)
 	{
 	case 0:
-	  if (length < 2 || (itsANumber && (dots->attributes & CTC_LitDigit)))
+	  if (length < 2 || (st->itsANumber
+			     && (dots->attributes & CTC_LitDigit)))
 	    break;
+	  /* No rule begins with these two cells, and none can match 
+	   * across the end of a remembered word */
+	  if (st->table->backRuleFilter && st->src + 1 <= st->wordLimit
+	      && !RULEPAIRBIT (st->table->ruleArea, st->table->backRuleFilter,
+			       st->table->backRuleFilterBits,
+			       st->currentInput[st->src],
+			       st->currentInput[st->src + 1]))
+	    break;
+	  if (st->table->backRuleTrie)
+	    {
+	      if (back_selectTrieRule (st, length))
+		return;
+	      break;
+	    }
 	  /*Hash function optimized for backward translation */
 	  makeHash = (unsigned long int) dots->lowercase << 8;
 	  makeHash += (unsigned long int) (back_findCharOrDots
-					   (currentInput[src + 1],
+					   (st, st->currentInput[st->src + 1],
 					    1))->lowercase;
 	  makeHash %= HASHNUM;
-	  ruleOffset = table->backRules[makeHash];
+	  ruleOffset = st->table->backRules[makeHash];
 	  break;
 	case 1:
 	  if (!(length >= 1))
@@ -590,250 +1024,114 @@ back_selectRule ()
 	  ruleOffset = dots->otherRules;
 	  break;
 	case 2:		/*No rule found */
-	  currentRule = &pseudoRule;
-	  currentOpcode = pseudoRule.opcode = CTO_None;
-	  currentDotslen = pseudoRule.dotslen = 1;
-	  pseudoRule.charsdots[0] = currentInput[src];
-	  pseudoRule.charslen = 0;
+	  st->currentRule = &st->pseudoRule;
+	  st->currentOpcode = st->pseudoRule.opcode = CTO_None;
+	  st->currentDotslen = st->pseudoRule.dotslen = 1;
+	  st->pseudoRule.charsdots[0] = st->currentInput[st->src];
+	  st->pseudoRule.charslen = 0;
 	  return;
 	  break;
 	}
       while (ruleOffset)
 	{
-	  currentRule =
-	    (TranslationTableRule *) & table->ruleArea[ruleOffset];
-	  currentOpcode = currentRule->opcode;
-	  currentDotslen = currentRule->dotslen;
-	  if (((currentDotslen <= length) &&
-	       compareDots (&currentInput[src],
-			    &currentRule->charsdots[currentRule->charslen],
-			    currentDotslen)))
+	  st->currentRule =
+	    (TranslationTableRule *) & st->table->ruleArea[ruleOffset];
+	  st->currentOpcode = st->currentRule->opcode;
+	  st->currentDotslen = st->currentRule->dotslen;
+	  checkWordLimit (st);
+	  if (((st->currentDotslen <= length) &&
+	       compareDots (&st->currentInput[st->src],
+			    &st->currentRule->charsdots[st->currentRule->charslen],
+			    st->currentDotslen)))
 	    {
-	      /* check this rule */
-	      back_setAfter (currentDotslen);
-	      if ((!currentRule->after || (beforeAttributes
-					   & currentRule->after)) &&
-		  (!currentRule->before || (afterAttributes
-					    & currentRule->before)))
-		{
-		  switch (currentOpcode)
-		    {		/*check validity of this Translation */
-		    case CTO_Space:
-		    case CTO_Digit:
-		    case CTO_Letter:
-		    case CTO_UpperCase:
-		    case CTO_LowerCase:
-		    case CTO_Punctuation:
-		    case CTO_Math:
-		    case CTO_Sign:
-		    case CTO_ExactDots:
-		    case CTO_NoCross:
-		    case CTO_Repeated:
-		    case CTO_Replace:
-		    case CTO_Hyphen:
-		      return;
-		    case CTO_LitDigit:
-		      if (itsANumber)
-			return;
-		      break;
-		    case CTO_CapitalRule:
-		    case CTO_BeginCapitalRule:
-		    case CTO_EndCapitalRule:
-		    case CTO_FirstLetterItalRule:
-		    case CTO_LastLetterItalRule:
-		    case CTO_LastWordBoldBeforeRule:
-		    case CTO_LastLetterBoldRule:
-		    case CTO_FirstLetterUnderRule:
-		    case CTO_LastLetterUnderRule:
-		    case CTO_NumberRule:
-		    case CTO_BegCompRule:
-		    case CTO_EndCompRule:
-		      return;
-		    case CTO_LetterRule:
-		      if (!(beforeAttributes &
-			    CTC_Letter) && (afterAttributes & CTC_Letter))
-			return;
-		      break;
-		    case CTO_MultInd:
-		      doingMultind = currentDotslen;
-		      multindRule = currentRule;
-		      if (handleMultind ())
-			return;
-		      break;
-		    case CTO_LargeSign:
-		      return;
-		    case CTO_WholeWord:
-		      if (itsALetter || itsANumber)
-			break;
-		    case CTO_Contraction:
-		      if ((beforeAttributes & (CTC_Space | CTC_Punctuation))
-			  && ((afterAttributes & CTC_Space) || isEndWord ()))
-			return;
-		      break;
-		    case CTO_LowWord:
-		      if ((beforeAttributes & CTC_Space) && (afterAttributes
-							     & CTC_Space) &&
-			  (previousOpcode != CTO_JoinableWord))
-			return;
-		      break;
-		    case CTO_JoinNum:
-		    case CTO_JoinableWord:
-		      if ((beforeAttributes & (CTC_Space |
-					       CTC_Punctuation))
-			  && !((afterAttributes & CTC_Space)))
-			return;
-		      break;
-		    case CTO_SuffixableWord:
-		      if (beforeAttributes & (CTC_Space | CTC_Punctuation))
-			return;
-		      break;
-		    case CTO_PrefixableWord:
-		      if ((beforeAttributes & (CTC_Space | CTC_Letter |
-					       CTC_Punctuation))
-			  && isEndWord ())
-			return;
-		      break;
-		    case CTO_BegWord:
-		      if ((beforeAttributes & (CTC_Space | CTC_Punctuation))
-			  && (!isEndWord ()))
-			return;
-		      break;
-		    case CTO_BegMidWord:
-		      if ((beforeAttributes & (CTC_Letter | CTC_Space |
-					       CTC_Punctuation))
-			  && (!isEndWord ()))
-			return;
-		      break;
-		    case CTO_PartWord:
-		      if (!(beforeAttributes & 
-		      CTC_LitDigit) && (beforeAttributes & CTC_Letter || 
-		      !isEndWord ()))
-			return;
-		      break;
-		    case CTO_MidWord:
-		      if (beforeAttributes & CTC_Letter && !isEndWord ())
-			return;
-		      break;
-		    case CTO_MidEndWord:
-		      if ((beforeAttributes & CTC_Letter))
-			return;
-		      break;
-		    case CTO_EndWord:
-		      if ((beforeAttributes & CTC_Letter) && isEndWord ())
-			return;
-		      break;
-		    case CTO_BegNum:
-		      if (beforeAttributes & (CTC_Space | CTC_Punctuation)
-			  && (afterAttributes & (CTC_LitDigit | CTC_Sign)))
-			return;
-		      break;
-		    case CTO_MidNum:
-		      if (beforeAttributes & CTC_Digit &&
-			  afterAttributes & CTC_LitDigit)
-			return;
-		      break;
-		    case CTO_EndNum:
-		      if (itsANumber && !(afterAttributes & CTC_LitDigit))
-			return;
-		      break;
-		    case CTO_DecPoint:
-		      if (afterAttributes & (CTC_Digit | CTC_LitDigit))
-			return;
-		      break;
-		    case CTO_PrePunc:
-		      if (isBegWord ())
-			return;
-		      break;
-
-		    case CTO_PostPunc:
-		      if (isEndWord ())
-			return;
-		      break;
-		    case CTO_Always:
-		    if ((beforeAttributes & CTC_LitDigit) && 
-		    (afterAttributes & CTC_LitDigit) && 
-		    currentRule->charslen > 1)
-		    break;
-		    return;
-		    default:
-		      break;
-		    }
-		}
+	      if (back_checkRule (st))
+		return;
 	    }			/*Done with checking this rule */
-	  ruleOffset = currentRule->dotsnext;
+	  ruleOffset = st->currentRule->dotsnext;
 	}
     }
 }
 
 static int
-putchars (const widechar * chars, int count)
+putchars (BackTranslationState *st, const widechar * chars, int count)
 {
   int k = 0;
-  if (!count || (dest + count) > destmax)
+  if (!count || (st->dest + count) > st->destmax)
     return 0;
-  if (nextUpper)
+  if (st->nextUpper)
     {
-      currentOutput[dest++] =
-	(back_findCharOrDots (chars[k++], 0))->uppercase;
-      nextUpper = 0;
+      st->currentOutput[st->dest++] =
+	(back_findCharOrDots (st, chars[k++], 0))->uppercase;
+      st->nextUpper = 0;
     }
-  if (!allUpper)
+  if (!st->allUpper)
     {
-      memcpy (&currentOutput[dest], &chars[k], CHARSIZE * (count - k));
-      dest += count - k;
+      memcpy (&st->currentOutput[st->dest], &chars[k], CHARSIZE * (count - k));
+      st->dest += count - k;
     }
   else
     for (; k < count; k++)
-      currentOutput[dest++] = (back_findCharOrDots (chars[k], 0))->uppercase;
+      st->currentOutput[st->dest++] = (back_findCharOrDots (st, chars[k],
+							    0))->uppercase;
   return 1;
 }
 
 static int
-back_updatePositions (const widechar * outChars, int inLength, int outLength)
+back_setPositions (BackTranslationState *st, int inLength, int outLength)
 {
   int k;
-  if ((dest + outLength) > destmax || (src + inLength) > srcmax)
+  if ((st->dest + outLength) > st->destmax
+      || (st->src + inLength) > st->srcmax)
     return 0;
-  if (!cursorStatus && cursorPosition >= src &&
-      cursorPosition < (src + inLength))
+  if (!st->cursorStatus && st->cursorPosition >= st->src &&
+      st->cursorPosition < (st->src + inLength))
     {
-      cursorPosition = dest + outLength / 2;
-      cursorStatus = 1;
+      st->cursorPosition = st->dest + outLength / 2;
+      st->cursorStatus = 1;
     }
-  if (inputPositions != NULL || outputPositions != NULL)
+  if (st->inputPositions != NULL || st->outputPositions != NULL)
     {
       if (outLength <= inLength)
 	{
 	  for (k = 0; k < outLength; k++)
 	    {
-	      if (inputPositions != NULL)
-		inputPositions[dest + k] = srcMapping[src + k];
-	      if (outputPositions != NULL)
-		outputPositions[srcMapping[src + k]] = dest + k;
+	      if (st->inputPositions != NULL)
+		st->inputPositions[st->dest + k] = st->srcMapping[st->src + k];
+	      if (st->outputPositions != NULL)
+		st->outputPositions[st->srcMapping[st->src + k]] = st->dest + k;
 	    }
 	  for (k = outLength; k < inLength; k++)
-	    if (outputPositions != NULL)
-	      outputPositions[srcMapping[src + k]] = dest + outLength - 1;
+	    if (st->outputPositions != NULL)
+	      st->outputPositions[st->srcMapping[st->src + k]] = st->dest + outLength - 1;
 	}
       else
 	{
 	  for (k = 0; k < inLength; k++)
 	    {
-	      if (inputPositions != NULL)
-		inputPositions[dest + k] = srcMapping[src + k];
-	      if (outputPositions != NULL)
-		outputPositions[srcMapping[src + k]] = dest + k;
+	      if (st->inputPositions != NULL)
+		st->inputPositions[st->dest + k] = st->srcMapping[st->src + k];
+	      if (st->outputPositions != NULL)
+		st->outputPositions[st->srcMapping[st->src + k]] = st->dest + k;
 	    }
 	  for (k = inLength; k < outLength; k++)
-	    if (inputPositions != NULL)
-	      inputPositions[dest + k] = srcMapping[src + inLength - 1];
+	    if (st->inputPositions != NULL)
+	      st->inputPositions[st->dest + k] = st->srcMapping[st->src + inLength - 1];
 	}
     }
-  return putchars (outChars, outLength);
+  return 1;
 }
 
 static int
-undefinedDots (widechar dots)
+back_updatePositions (BackTranslationState *st, const widechar * outChars,
+		      int inLength, int outLength)
+{
+  if (!back_setPositions (st, inLength, outLength))
+    return 0;
+  return putchars (st, outChars, outLength);
+}
+
+static int
+undefinedDots (BackTranslationState *st, widechar dots)
 {
 /*Print out dot numbers */
   widechar buffer[20];
@@ -870,100 +1168,136 @@ undefinedDots (widechar dots)
   if ((dots & B15))
     buffer[k++] = 'F';
   buffer[k++] = '/';
-  if ((dest + k) > destmax)
+  if (!back_setPositions (st, 1, k))
     return 0;
-  memcpy (&currentOutput[dest], buffer, k * CHARSIZE);
-  dest += k;
+  memcpy (&st->currentOutput[st->dest], buffer, k * CHARSIZE);
+  st->dest += k;
   return 1;
 }
 
 static int
-putCharacter (widechar dots)
+putCharacter (BackTranslationState *st, widechar dots)
 {
 /*Output character(s) corresponding to a Unicode braille Character*/
   TranslationTableOffset offset =
-    (back_findCharOrDots (dots, 0))->definitionRule;
+    (back_findCharOrDots (st, dots, 0))->definitionRule;
   if (offset)
     {
       widechar c;
       const TranslationTableRule *rule = (TranslationTableRule
-					  *) & table->ruleArea[offset];
+					  *) & st->table->ruleArea[offset];
       if (rule->charslen)
-	return back_updatePositions (&rule->charsdots[0],
+	return back_updatePositions (st, &rule->charsdots[0],
 				     rule->dotslen, rule->charslen);
-      c = getCharFromDots (dots);
-      return back_updatePositions (&c, 1, 1);
+      c = getCharFromDotsInTable (st->table, dots);
+      return back_updatePositions (st, &c, 1, 1);
     }
-  return undefinedDots (dots);
+  return undefinedDots (st, dots);
 }
 
 static int
-putCharacters (const widechar * characters, int count)
+putCharacters (BackTranslationState *st, const widechar * characters,
+	       int count)
 {
   int k;
   for (k = 0; k < count; k++)
-    if (!putCharacter (characters[k]))
+    if (!putCharacter (st, characters[k]))
       return 0;
   return 1;
 }
 
 static int
-insertSpace ()
+insertSpace (BackTranslationState *st)
 {
   widechar c = ' ';
-  if (!back_updatePositions (&c, 1, 1))
+  if (!back_updatePositions (st, &c, 1, 1))
     return 0;
-  if (spacebuf)
-    spacebuf[dest - 1] = '1';
+  if (st->spacebuf)
+    st->spacebuf[st->dest - 1] = '1';
   return 1;
 }
 
 static int
-compareChars (const widechar * address1, const widechar * address2, int
+compareChars (BackTranslationState *st, const widechar * address1,
+	      const widechar * address2, int
 	      count, int m)
 {
   int k;
   if (!count)
     return 0;
   for (k = 0; k < count; k++)
-    if ((back_findCharOrDots (address1[k], m))->lowercase !=
-	(back_findCharOrDots (address2[k], m))->lowercase)
+    if ((back_findCharOrDots (st, address1[k], m))->lowercase !=
+	(back_findCharOrDots (st, address2[k], m))->lowercase)
       return 0;
   return 1;
 }
 
 static int
-makeCorrections ()
+correctionMayStart (BackTranslationState *st, widechar c)
+{
+/*Whether the filter of the corrections made when the table was 
+* compiled lets one begin to match at the character c, also through 
+* its lowercase form. */
+  const PassStartFilter *filter = &st->table->passStarts[0];
+  const TranslationTableCharacter *character;
+  if (filter->anywhere || (filter->chars[(c & 0xff) >> 3] & (1 << (c & 7))))
+    return 1;
+  character = back_findCharOrDots (st, c, 0);
+  if (filter->attributes & character->attributes)
+    return 1;
+  c = character->lowercase;
+  return (filter->chars[(c & 0xff) >> 3] & (1 << (c & 7))) != 0;
+}
+
+static int
+makeCorrections (BackTranslationState *st)
 {
   int k;
-  if (!table->corrections)
+  if (!st->table->corrections)
     return 1;
-  src = 0;
-  dest = 0;
+  traceEvent (louTracePass, 1, 0, 0, 0, 0);
+  st->src = 0;
+  st->dest = 0;
   for (k = 0; k < NUMVAR; k++)
-    passVariables[k] = 0;
-  while (src < srcmax)
+    st->passVariables[k] = 0;
+  while (st->src < st->srcmax)
     {
-      int length = srcmax - src;
-      const TranslationTableCharacter *character = back_findCharOrDots
-	(currentInput[src], 0);
+      int length = st->srcmax - st->src;
+      const TranslationTableCharacter *character;
       const TranslationTableCharacter *character2;
       int tryThis = 0;
-      if (!findAttribOrSwapRules ())
+      if (outOfWork (&st->work))
+	goto failure;
+      if (!correctionMayStart (st, st->currentInput[st->src]))
+	{
+	  /* No correction begins here; copy up to where one may */
+	  for (length = 1; st->src + length < st->srcmax
+	       && !correctionMayStart (st, st->currentInput[st->src + length]);
+	       length++);
+	  if (length > st->destmax - st->dest)
+	    length = st->destmax - st->dest;
+	  memcpy (&st->currentOutput[st->dest], &st->currentInput[st->src],
+		  length * CHARSIZE);
+	  for (; length; length--)
+	    st->srcMapping[st->dest++] = st->srcMapping[st->src++];
+	  if (st->dest >= st->destmax && st->src < st->srcmax)
+	    goto failure;
+	  continue;
+	}
+      character = back_findCharOrDots (st, st->currentInput[st->src], 0);
+      if (!findAttribOrSwapRules (st))
 	while (tryThis < 3)
 	  {
 	    TranslationTableOffset ruleOffset = 0;
-	    unsigned long int makeHash = 0;
 	    switch (tryThis)
 	      {
 	      case 0:
 		if (!(length >= 2))
 		  break;
-		makeHash = (unsigned long int) character->lowercase << 8;
-		character2 = back_findCharOrDots (currentInput[src + 1], 0);
-		makeHash += (unsigned long int) character2->lowercase;
-		makeHash %= HASHNUM;
-		ruleOffset = table->forRules[makeHash];
+		character2 = back_findCharOrDots (st,
+						  st->currentInput[st->src + 1], 0);
+		ruleOffset = findForRules (st->table, character->lowercase,
+					   character2->lowercase);
 		break;
 	      case 1:
 		if (!(length >= 1))
@@ -972,44 +1306,46 @@ makeCorrections ()
 		ruleOffset = character->otherRules;
 		break;
 	      case 2:		/*No rule found */
-		currentOpcode = CTO_Always;
+		st->currentOpcode = CTO_Always;
 		ruleOffset = 0;
 		break;
 	      }
 	    while (ruleOffset)
 	      {
-		currentRule =
-		  (TranslationTableRule *) & table->ruleArea[ruleOffset];
-		currentOpcode = currentRule->opcode;
-		currentCharslen = currentRule->charslen;
-		if (tryThis == 1 || (currentCharslen <= length &&
-				     compareChars (&currentRule->
+		st->currentRule =
+		  (TranslationTableRule *) & st->table->ruleArea[ruleOffset];
+		st->currentOpcode = st->currentRule->opcode;
+		st->currentCharslen = st->currentRule->charslen;
+		if (tryThis == 1 || (st->currentCharslen <= length &&
+				     compareChars (st, &st->currentRule->
 						   charsdots[0],
-						   &currentInput[src],
-						   currentCharslen, 0)))
+						   &st->currentInput[st->src],
+						   st->currentCharslen, 0)))
 		  {
-		    if (currentOpcode == CTO_Correct && back_passDoTest ())
+		    if (st->currentOpcode == CTO_Correct
+			&& back_passDoTest (st))
 		      {
 			tryThis = 4;
 			break;
 		      }
 		  }
-		ruleOffset = currentRule->charsnext;
+		ruleOffset = st->currentRule->charsnext;
 	      }
 	    tryThis++;
 	  }
-      switch (currentOpcode)
+      switch (st->currentOpcode)
 	{
 	case CTO_Always:
-	  if (dest >= destmax)
+	  if (st->dest >= st->destmax)
 	    goto failure;
-	  srcMapping[dest] = srcMapping[src];
-	  currentOutput[dest++] = currentInput[src++];
+	  st->srcMapping[st->dest] = st->srcMapping[st->src];
+	  st->currentOutput[st->dest++] = st->currentInput[st->src++];
 	  break;
 	case CTO_Correct:
-	  if (!back_passDoAction ())
+	  traceEvent (louTraceRule, 1, 0, CTO_Correct, st->src, st->dest);
+	  if (!back_passDoAction (st))
 	    goto failure;
-	  src = endReplace;
+	  st->src = st->endReplace;
 	  break;
 	default:
 	  break;
@@ -1019,97 +1355,384 @@ failure:
   return 1;
 }
 
+/* The word cache remembers the translation of words of cells between 
+* blank cells, with the state the translator is left in, and plays it 
+* back when the word comes again after the same character and with the 
+* same state. A word is remembered only if no rule tried on it looked 
+* past the blank cell after it. */
+
+#define BACKCACHEWORD 24	/*longest word remembered */
+#define BACKCACHECHARS 48	/*longest translation remembered */
+
+typedef struct
+{
+  const TranslationTableHeader *table;
+  unsigned int hash;
+  int mode;
+  int before;			/*character before the word, -1 at the start */
+  int state;			/*see backWordState */
+  TranslationTableOpcode prevOpcode;
+  int length;			/*of the word and the blank cell after it */
+  widechar cells[BACKCACHEWORD + 1];
+  int outlen;
+  widechar chars[BACKCACHECHARS];
+  /*The state after the word */
+  int endState;
+  TranslationTableOpcode endPrevOpcode;
+  widechar prevc;
+  TranslationTableCharacterAttributes preva;
+  int newer, older;		/*least recently used list */
+  int chain;			/*next in the hash bucket */
+} BackWordCacheEntry;
+
+struct BackWordCache
+{
+  int size;
+  int used;
+  int generation;
+  int newest, oldest;
+  int numBuckets;		/*a power of two */
+  int *buckets;
+  BackWordCacheEntry *entries;
+};
+
+void
+freeBackWordCache (struct BackWordCache *cache)
+{
+  if (cache == NULL)
+    return;
+  free (cache->buckets);
+  free (cache->entries);
+  free (cache);
+}
+
+static void
+clearBackWordCache (struct BackWordCache *cache)
+{
+  int k;
+  for (k = 0; k < cache->numBuckets; k++)
+    cache->buckets[k] = -1;
+  cache->used = 0;
+  cache->newest = cache->oldest = -1;
+  cache->generation = getTableGeneration ();
+}
+
+static struct BackWordCache *
+getBackWordCache (louContext * ctx)
+{
+  struct BackWordCache *cache;
+  ctx = getContext (ctx);
+  if (!ctx->wordCacheSize)
+    return NULL;
+  if (!(cache = ctx->backWordCache))
+    {
+      if (!(cache = calloc (1, sizeof (*cache)))
+	  || !(cache->entries = malloc (ctx->wordCacheSize
+					* sizeof (BackWordCacheEntry))))
+	outOfMemory ();
+      cache->size = ctx->wordCacheSize;
+      for (cache->numBuckets = 1; cache->numBuckets < cache->size;
+	   cache->numBuckets <<= 1);
+      if (!(cache->buckets = malloc (cache->numBuckets * sizeof (int))))
+	outOfMemory ();
+      clearBackWordCache (cache);
+      ctx->backWordCache = cache;
+    }
+  else if (cache->generation != getTableGeneration ())
+    clearBackWordCache (cache);
+  return cache;
+}
+
+static void
+unlinkBackWord (struct BackWordCache *cache, int k)
+{
+  BackWordCacheEntry *entry = &cache->entries[k];
+  if (entry->newer >= 0)
+    cache->entries[entry->newer].older = entry->older;
+  else
+    cache->newest = entry->older;
+  if (entry->older >= 0)
+    cache->entries[entry->older].newer = entry->newer;
+  else
+    cache->oldest = entry->newer;
+}
+
+static void
+makeNewestBackWord (struct BackWordCache *cache, int k)
+{
+  BackWordCacheEntry *entry = &cache->entries[k];
+  entry->newer = -1;
+  entry->older = cache->newest;
+  if (cache->newest >= 0)
+    cache->entries[cache->newest].newer = k;
+  else
+    cache->oldest = k;
+  cache->newest = k;
+}
+
 static int
-backTranslateString ()
+isBlankCell (BackTranslationState *st, widechar dots)
+{
+/*Unlike checkAttr, this leaves prevc and preva alone */
+  return (back_findCharOrDots (st, dots, 1)->attributes & CTC_Space) != 0;
+}
+
+static int
+backWordState (BackTranslationState *st)
+{
+/*The state carried from word to word, in one number */
+  return st->nextUpper | (st->allUpper << 1) | (st->itsANumber << 2)
+    | (st->itsALetter << 3) | (st->itsCompbrl << 4)
+    | ((unsigned char) st->currentTypeform << 8);
+}
+
+static void
+setBackWordState (BackTranslationState *st, int state)
+{
+  st->nextUpper = state & 1;
+  st->allUpper = (state >> 1) & 1;
+  st->itsANumber = (state >> 2) & 1;
+  st->itsALetter = (state >> 3) & 1;
+  st->itsCompbrl = (state >> 4) & 1;
+  st->currentTypeform = (char) (state >> 8);
+}
+
+static int
+backWordLength (BackTranslationState *st)
+{
+/*The number of cells of a word starting at src after a blank cell and 
+* followed by one, or 0 if it is not such a word */
+  int end;
+  if (st->src > 0 && !isBlankCell (st, st->currentInput[st->src - 1]))
+    return 0;
+  for (end = st->src; end < st->srcmax && end - st->src <= BACKCACHEWORD;
+       end++)
+    if (isBlankCell (st, st->currentInput[end]))
+      break;
+  if (end == st->src || end == st->srcmax || end - st->src > BACKCACHEWORD)
+    return 0;
+  return end - st->src;
+}
+
+static int
+isBackWord (const BackWordCacheEntry * entry, BackTranslationState *st,
+	    int length)
+{
+  return entry->hash == st->wordHash && entry->table == st->table
+    && entry->mode == st->mode && entry->before == st->wordBefore
+    && entry->state == st->wordState
+    && entry->prevOpcode == st->previousOpcode
+    && entry->length == length + 1
+    && !memcmp (entry->cells, &st->currentInput[st->src],
+		(length + 1) * CHARSIZE);
+}
+
+static void
+rememberBackWord (BackTranslationState *st)
+{
+/*Called when the translation of the word being remembered has reached 
+* the blank cell after it */
+  struct BackWordCache *cache = st->wordCache;
+  BackWordCacheEntry *entry;
+  int outlen = st->dest - st->wordDest;
+  int k;
+  if (st->wordUnsafe || st->doingMultind || outlen > BACKCACHECHARS)
+    return;
+  if (cache->used < cache->size)
+    k = cache->used++;
+  else
+    {
+      int *link;
+      k = cache->oldest;
+      unlinkBackWord (cache, k);
+      for (link = &cache->buckets[cache->entries[k].hash
+				  & (cache->numBuckets - 1)];
+	   *link != k; link = &cache->entries[*link].chain);
+      *link = cache->entries[k].chain;
+    }
+  entry = &cache->entries[k];
+  entry->table = st->table;
+  entry->hash = st->wordHash;
+  entry->mode = st->mode;
+  entry->before = st->wordBefore;
+  entry->state = st->wordState;
+  entry->prevOpcode = st->wordPrevOpcode;
+  entry->length = st->wordLimit - st->wordStart + 1;
+  memcpy (entry->cells, &st->currentInput[st->wordStart],
+	  entry->length * CHARSIZE);
+  entry->outlen = outlen;
+  memcpy (entry->chars, &st->currentOutput[st->wordDest],
+	  outlen * CHARSIZE);
+  entry->endState = backWordState (st);
+  entry->endPrevOpcode = st->previousOpcode;
+  entry->prevc = st->prevc;
+  entry->preva = st->preva;
+  entry->chain = cache->buckets[st->wordHash & (cache->numBuckets - 1)];
+  cache->buckets[st->wordHash & (cache->numBuckets - 1)] = k;
+  makeNewestBackWord (cache, k);
+}
+
+static int
+useBackWordCache (BackTranslationState *st)
+{
+/*Called at the top of the translation loop. Play back the translation 
+* of a remembered word starting at src and return 1, or start 
+* remembering it and return 0. */
+  struct BackWordCache *cache = st->wordCache;
+  const BackWordCacheEntry *entry;
+  unsigned int hash;
+  int length, k;
+  if (st->wordStart >= 0)
+    {
+      if (st->src == st->wordLimit)
+	rememberBackWord (st);
+      else if (st->src < st->wordLimit)
+	return 0;
+      st->wordStart = -1;
+      st->wordLimit = NOWORDLIMIT;
+    }
+  if (st->doingMultind || !(length = backWordLength (st)))
+    return 0;
+  /* isBegWord looks back in the output as far as a space */
+  st->wordBefore = st->dest > 0 ? st->currentOutput[st->dest - 1] : -1;
+  if (st->wordBefore >= 0 && !(back_findCharOrDots (st, st->wordBefore, 0)
+			       ->attributes & CTC_Space))
+    return 0;
+  st->wordState = backWordState (st);
+  hash = 2166136261U;
+  for (k = 0; k <= length; k++)
+    hash = (hash ^ st->currentInput[st->src + k]) * 16777619U;
+  hash = (hash ^ (unsigned int) st->wordBefore ^ st->previousOpcode
+	  ^ ((unsigned int) st->wordState << 8)
+	  ^ ((unsigned int) st->mode << 20)) * 16777619U;
+  st->wordHash = hash;
+  for (k = cache->buckets[hash & (cache->numBuckets - 1)]; k >= 0;
+       k = entry->chain)
+    {
+      entry = &cache->entries[k];
+      if (isBackWord (entry, st, length))
+	break;
+    }
+  if (k >= 0 && st->dest + entry->outlen <= st->destmax)
+    {
+      memcpy (&st->currentOutput[st->dest], entry->chars,
+	      entry->outlen * CHARSIZE);
+      st->dest += entry->outlen;
+      setBackWordState (st, entry->endState);
+      st->previousOpcode = entry->endPrevOpcode;
+      st->prevc = entry->prevc;
+      st->preva = entry->preva;
+      st->src += length;
+      unlinkBackWord (cache, k);
+      makeNewestBackWord (cache, k);
+      return 1;
+    }
+  st->wordStart = st->src;
+  st->wordLimit = st->src + length;
+  st->wordDest = st->dest;
+  st->wordUnsafe = 0;
+  st->wordPrevOpcode = st->previousOpcode;
+  return 0;
+}
+
+static int
+backTranslateString (BackTranslationState *st)
 {
 /*Back translation */
   int srcword = 0;
   int destword = 0;		/* last word translated */
-  nextUpper = allUpper = itsANumber = itsALetter = itsCompbrl = 0;
-  previousOpcode = CTO_None;
-  src = dest = 0;
-  while (src < srcmax)
+  st->nextUpper = st->allUpper = st->itsANumber = st->itsALetter = st->itsCompbrl = 0;
+  st->previousOpcode = CTO_None;
+  traceEvent (louTracePass, 1, 1, 0, 0, 0);
+  st->src = st->dest = 0;
+  while (st->src < st->srcmax)
     {
 /*the main translation loop */
-      back_setBefore ();
-      back_selectRule ();
+      if (outOfWork (&st->work))
+	goto failure;
+      if (st->wordCache && useBackWordCache (st))
+	continue;
+      back_setBefore (st);
+      back_selectRule (st);
+      if (st->currentOpcode != CTO_None)
+	traceEvent (louTraceRule, 1, 1, st->currentOpcode, st->src, st->dest);
       /* processing before replacement */
-      switch (currentOpcode)
+      switch (st->currentOpcode)
 	{
 	case CTO_Hyphen:
-	    itsANumber = 0;
+	    st->itsANumber = 0;
 	  break;
 	case CTO_LargeSign:
-	  if (previousOpcode == CTO_LargeSign)
-	    if (!insertSpace ())
+	  if (st->previousOpcode == CTO_LargeSign)
+	    if (!insertSpace (st))
 	      goto failure;
 	  break;
 	case CTO_CapitalRule:
-	  nextUpper = 1;
-	  src += currentDotslen;
+	  st->nextUpper = 1;
+	  st->src += st->currentDotslen;
 	  continue;
 	  break;
 	case CTO_BeginCapitalRule:
-	  allUpper = 1;
-	  src += currentDotslen;
+	  st->allUpper = 1;
+	  st->src += st->currentDotslen;
 	  continue;
 	  break;
 	case CTO_EndCapitalRule:
-	  allUpper = 0;
-	  src += currentDotslen;
+	  st->allUpper = 0;
+	  st->src += st->currentDotslen;
 	  continue;
 	  break;
 	case CTO_LetterRule:
-	  itsALetter = 1;
-	  itsANumber = 0;
-	  src += currentDotslen;
+	  st->itsALetter = 1;
+	  st->itsANumber = 0;
+	  st->src += st->currentDotslen;
 	  continue;
 	  break;
 	case CTO_NumberRule:
-	  itsANumber = 1;
-	  src += currentDotslen;
+	  st->itsANumber = 1;
+	  st->src += st->currentDotslen;
 	  continue;
 	  break;
 	case CTO_FirstLetterItalRule:
-	  currentTypeform = italic;
-	  src += currentDotslen;
+	  st->currentTypeform = italic;
+	  st->src += st->currentDotslen;
 	  continue;
 	  break;
 	case CTO_LastLetterItalRule:
-	  currentTypeform = plain_text;
-	  src += currentDotslen;
+	  st->currentTypeform = plain_text;
+	  st->src += st->currentDotslen;
 	  continue;
 	  break;
 	case CTO_FirstLetterBoldRule:
-	  currentTypeform = bold;
-	  src += currentDotslen;
+	  st->currentTypeform = bold;
+	  st->src += st->currentDotslen;
 	  continue;
 	  break;
 	case CTO_LastLetterBoldRule:
-	  currentTypeform = plain_text;
-	  src += currentDotslen;
+	  st->currentTypeform = plain_text;
+	  st->src += st->currentDotslen;
 	  continue;
 	  break;
 	case CTO_FirstLetterUnderRule:
-	  currentTypeform = underline;
-	  src += currentDotslen;
+	  st->currentTypeform = underline;
+	  st->src += st->currentDotslen;
 	  continue;
 	  break;
 	case CTO_LastLetterUnderRule:
-	  currentTypeform = plain_text;
-	  src += currentDotslen;
+	  st->currentTypeform = plain_text;
+	  st->src += st->currentDotslen;
 	  continue;
 	  break;
 	case CTO_BegCompRule:
-	  itsCompbrl = 1;
-	  currentTypeform = computer_braille;
-	  src += currentDotslen;
+	  st->itsCompbrl = 1;
+	  st->currentTypeform = computer_braille;
+	  st->src += st->currentDotslen;
 	  continue;
 	  break;
 	case CTO_EndCompRule:
-	  itsCompbrl = 0;
-	  currentTypeform = plain_text;
-	  src += currentDotslen;
+	  st->itsCompbrl = 0;
+	  st->currentTypeform = plain_text;
+	  st->src += st->currentDotslen;
 	  continue;
 	  break;
 
@@ -1118,83 +1741,89 @@ backTranslateString ()
 	}
 
       /* replacement processing */
-      switch (currentOpcode)
+      switch (st->currentOpcode)
 	{
 	case CTO_Replace:
-	  src += currentDotslen;
+	  st->src += st->currentDotslen;
 	  if (!putCharacters
-	      (&currentRule->charsdots[0], currentRule->charslen))
+	      (st, &st->currentRule->charsdots[0], st->currentRule->charslen))
 	    goto failure;
 	  break;
 	case CTO_None:
-	  if (!undefinedDots (currentInput[src]))
+	  if (!undefinedDots (st, st->currentInput[st->src]))
 	    goto failure;
-	  src++;
+	  st->src++;
 	  break;
 	case CTO_BegNum:
-	  itsANumber = 1;
+	  st->itsANumber = 1;
 	  goto insertChars;
 	case CTO_EndNum:
-	  itsANumber = 0;
+	  st->itsANumber = 0;
 	  goto insertChars;
 	case CTO_Space:
-	  itsALetter = itsANumber = allUpper = nextUpper = 0;
+	  st->itsALetter = st->itsANumber = st->allUpper = st->nextUpper = 0;
 	default:
 	insertChars:
-	  if (currentRule->charslen)
+	  if (st->currentRule->charslen)
 	    {
 	      if (!back_updatePositions
-		  (&currentRule->charsdots[0],
-		   currentRule->dotslen, currentRule->charslen))
+		  (st, &st->currentRule->charsdots[0],
+		   st->currentRule->dotslen, st->currentRule->charslen))
 		goto failure;
-	      src += currentDotslen;
+	      st->src += st->currentDotslen;
 	    }
 	  else
 	    {
-	      int srclim = src + currentDotslen;
+	      int srclim = st->src + st->currentDotslen;
 	      while (1)
 		{
-		  if (!putCharacter (currentInput[src]))
+		  if (!putCharacter (st, st->currentInput[st->src]))
 		    goto failure;
-		  if (++src == srclim)
+		  if (++st->src == srclim)
 		    break;
 		}
 	    }
 	}
 
+      /* A space rule clears all but the opcode before it */
+      if (st->states != NULL && st->currentOpcode == CTO_Space
+	  && st->src < st->srcmax)
+	st->states[st->srcMapping[st->src]] = st->previousOpcode + 1;
       /* processing after replacement */
-      switch (currentOpcode)
+      switch (st->currentOpcode)
 	{
 	case CTO_JoinNum:
 	case CTO_JoinableWord:
-	  if (!insertSpace ())
+	  if (!insertSpace (st))
 	    goto failure;
 	  break;
 	default:
 	  break;
 	}
-      if (((src > 0) && checkAttr (currentInput[src - 1], CTC_Space, 1)
-	   && (currentOpcode != CTO_JoinableWord)))
+      if (((st->src > 0) && checkAttr (st, st->currentInput[st->src - 1],
+				       CTC_Space, 1)
+	   && (st->currentOpcode != CTO_JoinableWord)))
 	{
-	  srcword = src;
-	  destword = dest;
+	  srcword = st->src;
+	  destword = st->dest;
 	}
-      if ((currentOpcode >= CTO_Always && currentOpcode <= CTO_None) ||
-	  (currentOpcode >= CTO_Digit && currentOpcode <= CTO_LitDigit))
-	previousOpcode = currentOpcode;
+      if ((st->currentOpcode >= CTO_Always && st->currentOpcode <= CTO_None) ||
+	  (st->currentOpcode >= CTO_Digit
+	   && st->currentOpcode <= CTO_LitDigit))
+	st->previousOpcode = st->currentOpcode;
     }				/*end of translation loop */
 failure:
 
-  if (destword != 0 && src < srcmax && !checkAttr (currentInput[src],
-						   CTC_Space, 1))
+  if (destword != 0 && st->src < st->srcmax
+      && !checkAttr (st, st->currentInput[st->src], CTC_Space, 1))
     {
-      src = srcword;
-      dest = destword;
+      st->src = srcword;
+      st->dest = destword;
     }
-  if (src < srcmax)
+  if (st->src < st->srcmax)
     {
-      while (checkAttr (currentInput[src], CTC_Space, 1))
-	if (++src == srcmax)
+      while (checkAttr (st, st->currentInput[st->src], CTC_Space, 1))
+	if (++st->src == st->srcmax)
 	  break;
     }
   return 1;
@@ -1203,116 +1832,87 @@ failure:
 /*Multipass translation*/
 
 static int
-matchcurrentInput ()
+matchcurrentInput (BackTranslationState *st)
 {
   int k;
-  int kk = passSrc;
-  for (k = passIC + 2; k < passIC + 2 + passInstructions[passIC + 1]; k++)
-    if (passInstructions[k] != currentInput[kk++])
+  int kk = st->passSrc;
+  for (k = st->passIC + 2; k < st->passIC + 2 + st->passInstructions[st->passIC + 1]; k++)
+    if (st->passInstructions[k] != st->currentInput[kk++])
       return 0;
   return 1;
 }
 
 static int
-back_swapTest ()
+back_swapTest (BackTranslationState *st)
 {
   int curLen;
   int curTest;
-  int curSrc = passSrc;
+  int curSrc = st->passSrc;
   TranslationTableOffset swapRuleOffset;
   TranslationTableRule *swapRule;
   swapRuleOffset =
-    (passInstructions[passIC + 1] << 16) | passInstructions[passIC + 2];
-  swapRule = (TranslationTableRule *) & table->ruleArea[swapRuleOffset];
-  for (curLen = 0; curLen < passInstructions[passIC] + 3; curLen++)
+    (st->passInstructions[st->passIC + 1] << 16) | st->passInstructions[st->passIC + 2];
+  swapRule = (TranslationTableRule *) & st->table->ruleArea[swapRuleOffset];
+  for (curLen = 0; curLen < st->passInstructions[st->passIC] + 3; curLen++)
     {
-      for (curTest = 0; curTest < swapRule->charslen; curTest++)
-	{
-	  if (currentInput[curSrc] == swapRule->charsdots[curTest])
-	    break;
-	}
-      if (curTest == swapRule->charslen)
+      if (!findSwapMatch (st->table, swapRule, st->currentInput[curSrc]))
 	return 0;
       curSrc++;
     }
-  if (passInstructions[passIC + 2] == passInstructions[passIC + 3])
+  if (st->passInstructions[st->passIC + 2] == st->passInstructions[st->passIC + 3])
     {
-      passSrc = curSrc;
+      st->passSrc = curSrc;
       return 1;
     }
-  while (curLen < passInstructions[passIC + 4])
+  while (curLen < st->passInstructions[st->passIC + 4])
     {
       for (curTest = 0; curTest < swapRule->charslen; curTest++)
 	{
-	  if (currentInput[curSrc] != swapRule->charsdots[curTest])
+	  if (st->currentInput[curSrc] != swapRule->charsdots[curTest])
 	    break;
 	}
       if (curTest < swapRule->charslen)
 	if (curTest < swapRule->charslen)
 	  {
-	    passSrc = curSrc;
+	    st->passSrc = curSrc;
 	    return 1;
 	  }
       curSrc++;
       curLen++;
     }
-  passSrc = curSrc;
+  st->passSrc = curSrc;
   return 1;
 }
 
 static int
-back_swapReplace (int startSrc, int maxLen)
+back_swapReplace (BackTranslationState *st, int startSrc, int maxLen)
 {
   TranslationTableOffset swapRuleOffset;
   TranslationTableRule *swapRule;
+  const SwapMatch *match;
   widechar *replacements;
-  int curRep;
   int curPos;
-  int lastPos = 0;
-  int lastRep = 0;
-  int curTest;
   int curSrc = startSrc;
   swapRuleOffset =
-    (passInstructions[passIC + 1] << 16) | passInstructions[passIC + 2];
-  swapRule = (TranslationTableRule *) & table->ruleArea[swapRuleOffset];
+    (st->passInstructions[st->passIC + 1] << 16) | st->passInstructions[st->passIC + 2];
+  swapRule = (TranslationTableRule *) & st->table->ruleArea[swapRuleOffset];
   replacements = &swapRule->charsdots[swapRule->charslen];
   while (curSrc < maxLen)
     {
-      for (curTest = 0; curTest < swapRule->charslen; curTest++)
-	{
-	  if (currentInput[curSrc] == swapRule->charsdots[curTest])
-	    break;
-	}
-      if (curTest == swapRule->charslen)
+      if (!(match = findSwapMatch (st->table, swapRule,
+				   st->currentInput[curSrc])))
 	return curSrc;
-      if (curTest >= lastRep)
-	{
-	  curPos = lastPos;
-	  curRep = lastRep;
-	}
-      else
+      curPos = match->replacement;
+      if (curPos < swapRule->dotslen)
 	{
-	  curPos = 0;
-	  curRep = 0;
-	}
-      while (curPos < swapRule->dotslen)
-	{
-	  if (curRep == curTest)
-	    {
-	      int k;
-	      if ((dest + replacements[curPos] - 1) >= destmax)
-		return 0;
-	      for (k = dest + replacements[curPos] - 2; k >= dest; --k)
-		srcMapping[k] = srcMapping[curSrc];
-	      memcpy (&currentOutput[dest], &replacements[curPos + 1],
-		      (replacements[curPos] - 1) * CHARSIZE);
-	      dest += replacements[curPos] - 1;
-	      lastPos = curPos;
-	      lastRep = curRep;
-	      break;
-	    }
-	  curRep++;
-	  curPos += replacements[curPos];
+	  int k;
+	  if ((st->dest + replacements[curPos] - 1) >= st->destmax)
+	    return 0;
+	  for (k = st->dest + replacements[curPos] - 2; k >= st->dest; --k)
+	    st->srcMapping[k] = st->srcMapping[curSrc];
+	  memcpy (&st->currentOutput[st->dest], &replacements[curPos + 1],
+		  (replacements[curPos] - 1) * CHARSIZE);
+	  st->dest += replacements[curPos] - 1;
 	}
       curSrc++;
     }
@@ -1320,122 +1920,123 @@ back_swapReplace (int startSrc, int maxLen)
 }
 
 static int
-back_passDoTest ()
+back_passDoTest (BackTranslationState *st)
 {
   int k;
   int m;
   int not = 0;
   TranslationTableCharacterAttributes attributes;
-  passSrc = src;
-  passInstructions = &currentRule->charsdots[currentCharslen];
-  passIC = 0;
-  startMatch = passSrc;
-  startReplace = -1;
-  if (currentOpcode == CTO_Correct)
+  st->passSrc = st->src;
+  st->passInstructions = &st->currentRule->charsdots[st->currentCharslen];
+  st->passIC = 0;
+  st->startMatch = st->passSrc;
+  st->startReplace = -1;
+  if (st->currentOpcode == CTO_Correct)
     m = 0;
   else
     m = 1;
-  while (passIC < currentRule->dotslen)
+  while (st->passIC < st->currentRule->dotslen)
     {
       int itsTrue = 1;
-      if (passSrc > srcmax)
+      if (st->passSrc > st->srcmax)
 	return 0;
-      switch (passInstructions[passIC])
+      switch (st->passInstructions[st->passIC])
 	{
 	case pass_first:
-	  if (passSrc != 0)
+	  if (st->passSrc != 0)
 	    itsTrue = 0;
-	  passIC++;
+	  st->passIC++;
 	  break;
 	case pass_last:
-	  if (passSrc != (srcmax - 1))
+	  if (st->passSrc != (st->srcmax - 1))
 	    itsTrue = 0;
-	  passIC++;
+	  st->passIC++;
 	  break;
 	case pass_lookback:
-	  passSrc -= passInstructions[passIC + 1];
-	  if (passSrc < -1)
-	    passSrc = -1;
-	  passIC += 2;
+	  st->passSrc -= st->passInstructions[st->passIC + 1];
+	  if (st->passSrc < -1)
+	    st->passSrc = -1;
+	  st->passIC += 2;
 	  break;
 	case pass_not:
 	  not = 1;
-	  passIC++;
+	  st->passIC++;
 	  continue;
 	case pass_string:
 	case pass_dots:
-	  itsTrue = matchcurrentInput ();
-	  passSrc += passInstructions[passIC + 1];
-	  passIC += passInstructions[passIC + 1] + 2;
+	  itsTrue = matchcurrentInput (st);
+	  st->passSrc += st->passInstructions[st->passIC + 1];
+	  st->passIC += st->passInstructions[st->passIC + 1] + 2;
 	  break;
 	case pass_startReplace:
-	  startReplace = passSrc;
-	  passIC++;
+	  st->startReplace = st->passSrc;
+	  st->passIC++;
 	  break;
 	case pass_endReplace:
-	  endReplace = passSrc;
-	  passIC++;
+	  st->endReplace = st->passSrc;
+	  st->passIC++;
 	  break;
 	case pass_attributes:
-	  attributes = (passInstructions[passIC + 1] << 16) |
-	    passInstructions[passIC + 2];
-	  for (k = 0; k < passInstructions[passIC + 3]; k++)
+	  attributes = (st->passInstructions[st->passIC + 1] << 16) |
+	    st->passInstructions[st->passIC + 2];
+	  for (k = 0; k < st->passInstructions[st->passIC + 3]; k++)
 	    itsTrue =
-	      (((back_findCharOrDots (currentInput[passSrc++], m)->
+	      (((back_findCharOrDots (st, st->currentInput[st->passSrc++], m)->
 		 attributes & attributes)) ? 1 : 0);
 	  if (itsTrue)
-	    for (k = passInstructions[passIC + 3]; k <
-		 passInstructions[passIC + 4]; k++)
+	    for (k = st->passInstructions[st->passIC + 3]; k <
+		 st->passInstructions[st->passIC + 4]; k++)
 	      {
 		if (!
-		    (back_findCharOrDots (currentInput[passSrc], 1)->
+		    (back_findCharOrDots (st, st->currentInput[st->passSrc],
+					  1)->
 		     attributes & attributes))
 		  break;
-		passSrc++;
+		st->passSrc++;
 	      }
-	  passIC += 5;
+	  st->passIC += 5;
 	  break;
 	case pass_swap:
-	  itsTrue = back_swapTest ();
-	  passIC += 5;
+	  itsTrue = back_swapTest (st);
+	  st->passIC += 5;
 	  break;
 	case pass_eq:
-	  if (passVariables[passInstructions[passIC + 1]] !=
-	      passInstructions[passIC + 2])
+	  if (st->passVariables[st->passInstructions[st->passIC + 1]] !=
+	      st->passInstructions[st->passIC + 2])
 	    itsTrue = 0;
-	  passIC += 3;
+	  st->passIC += 3;
 	  break;
 	case pass_lt:
-	  if (passVariables[passInstructions[passIC + 1]] >=
-	      passInstructions[passIC + 2])
+	  if (st->passVariables[st->passInstructions[st->passIC + 1]] >=
+	      st->passInstructions[st->passIC + 2])
 	    itsTrue = 0;
-	  passIC += 3;
+	  st->passIC += 3;
 	  break;
 	case pass_gt:
-	  if (passVariables[passInstructions[passIC + 1]] <=
-	      passInstructions[passIC + 2])
+	  if (st->passVariables[st->passInstructions[st->passIC + 1]] <=
+	      st->passInstructions[st->passIC + 2])
 	    itsTrue = 0;
-	  passIC += 3;
+	  st->passIC += 3;
 	  break;
 	case pass_lteq:
-	  if (passVariables[passInstructions[passIC + 1]] >
-	      passInstructions[passIC + 2])
+	  if (st->passVariables[st->passInstructions[st->passIC + 1]] >
+	      st->passInstructions[st->passIC + 2])
 	    itsTrue = 0;
-	  passIC += 3;
+	  st->passIC += 3;
 	  break;
 	case pass_gteq:
-	  if (passVariables[passInstructions[passIC + 1]] <
-	      passInstructions[passIC + 2])
+	  if (st->passVariables[st->passInstructions[st->passIC + 1]] <
+	      st->passInstructions[st->passIC + 2])
 	    itsTrue = 0;
-	  passIC += 3;
+	  st->passIC += 3;
 	  break;
 	case pass_endTest:
-	  passIC++;
-	  endMatch = passSrc;
-	  if (startReplace == -1)
+	  st->passIC++;
+	  st->endMatch = st->passSrc;
+	  if (st->startReplace == -1)
 	    {
-	      startReplace = startMatch;
-	      endReplace = endMatch;
+	      st->startReplace = st->startMatch;
+	      st->endReplace = st->endMatch;
 	    }
 	  return 1;
 	  break;
@@ -1450,64 +2051,67 @@ back_passDoTest ()
 }
 
 static int
-back_passDoAction ()
+back_passDoAction (BackTranslationState *st)
 {
   int k;
-  if ((dest + startReplace - startMatch) > destmax)
+  if ((st->dest + st->startReplace - st->startMatch) > st->destmax)
     return 0;
-  memmove (&srcMapping[dest], &srcMapping[startMatch],
-	   (startReplace - startMatch) * sizeof (int));
-  for (k = startMatch; k < startReplace; k++)
-    currentOutput[dest++] = currentInput[k];
-  while (passIC < currentRule->dotslen)
-    switch (passInstructions[passIC])
+  memmove (&st->srcMapping[st->dest], &st->srcMapping[st->startMatch],
+	   (st->startReplace - st->startMatch) * sizeof (int));
+  for (k = st->startMatch; k < st->startReplace; k++)
+    st->currentOutput[st->dest++] = st->currentInput[k];
+  while (st->passIC < st->currentRule->dotslen)
+    switch (st->passInstructions[st->passIC])
       {
       case pass_string:
       case pass_dots:
-	if ((dest + passInstructions[passIC + 1]) > destmax)
+	if ((st->dest + st->passInstructions[st->passIC + 1]) > st->destmax)
 	  return 0;
-	for (k = 0; k < passInstructions[passIC + 1]; ++k)
-	  srcMapping[dest + k] = startMatch;
-	memcpy (&currentOutput[dest], &passInstructions[passIC + 2],
-		passInstructions[passIC + 1] * CHARSIZE);
-	dest += passInstructions[passIC + 1];
-	passIC += passInstructions[passIC + 1] + 2;
+	for (k = 0; k < st->passInstructions[st->passIC + 1]; ++k)
+	  st->srcMapping[st->dest + k] = st->startMatch;
+	memcpy (&st->currentOutput[st->dest],
+		&st->passInstructions[st->passIC + 2],
+		st->passInstructions[st->passIC + 1] * CHARSIZE);
+	st->dest += st->passInstructions[st->passIC + 1];
+	st->passIC += st->passInstructions[st->passIC + 1] + 2;
 	break;
       case pass_eq:
-	passVariables[passInstructions[passIC + 1]] =
-	  passInstructions[passIC + 2];
-	passIC += 3;
+	st->passVariables[st->passInstructions[st->passIC + 1]] =
+	  st->passInstructions[st->passIC + 2];
+	st->passIC += 3;
 	break;
       case pass_hyphen:
-	passVariables[passInstructions[passIC + 1]]--;
-	if (passVariables[passInstructions[passIC + 1]] < 0)
-	  passVariables[passInstructions[passIC + 1]] = 0;
-	passIC += 2;
+	st->passVariables[st->passInstructions[st->passIC + 1]]--;
+	if (st->passVariables[st->passInstructions[st->passIC + 1]] < 0)
+	  st->passVariables[st->passInstructions[st->passIC + 1]] = 0;
+	st->passIC += 2;
 	break;
       case pass_plus:
-	passVariables[passInstructions[passIC + 1]]++;
-	passIC += 2;
+	st->passVariables[st->passInstructions[st->passIC + 1]]++;
+	st->passIC += 2;
 	break;
       case pass_swap:
-	if (!back_swapReplace (startReplace, endReplace - startReplace))
+	if (!back_swapReplace (st, st->startReplace,
+			       st->endReplace - st->startReplace))
 	  return 0;
-	passIC += 3;
+	st->passIC += 3;
 	break;
       case pass_omit:
-	passIC++;
+	st->passIC++;
 	break;
       case pass_copy:
-	dest -= startReplace - startMatch;
-	k = endReplace - startReplace;
-	if ((dest + k) > destmax)
+	st->dest -= st->startReplace - st->startMatch;
+	k = st->endReplace - st->startReplace;
+	if ((st->dest + k) > st->destmax)
 	  return 0;
-	memmove (&srcMapping[dest], &srcMapping[startReplace],
+	memmove (&st->srcMapping[st->dest], &st->srcMapping[st->startReplace],
 		 k * sizeof (int));
-	memcpy (&currentOutput[dest], &currentInput[startReplace],
+	memcpy (&st->currentOutput[st->dest],
+		&st->currentInput[st->startReplace],
 		k * CHARSIZE);
-	dest += k;
-	passIC++;
-	endReplace = passSrc;
+	st->dest += k;
+	st->passIC++;
+	st->endReplace = st->passSrc;
 	break;
       default:
 	return 0;
@@ -1516,28 +2120,27 @@ back_passDoAction ()
 }
 
 static int
-checkDots ()
+checkDots (BackTranslationState *st)
 {
   int k;
-  int kk = src;
-  for (k = 0; k < currentCharslen; k++)
-    if (currentRule->charsdots[k] != currentInput[kk++])
+  int kk = st->src;
+  for (k = 0; k < st->currentCharslen; k++)
+    if (st->currentRule->charsdots[k] != st->currentInput[kk++])
       return 0;
   return 1;
 }
 
 static void
-for_passSelectRule ()
+for_passSelectRule (BackTranslationState *st)
 {
-  int length = srcmax - src;
+  int length = st->srcmax - st->src;
   const TranslationTableCharacter *dots;
   const TranslationTableCharacter *dots2;
   int tryThis;
   TranslationTableOffset ruleOffset = 0;
-  unsigned long int makeHash = 0;
-  if (findAttribOrSwapRules ())
+  if (findAttribOrSwapRules (st))
     return;
-  dots = back_findCharOrDots (currentInput[src], 1);
+  dots = back_findCharOrDots (st, st->currentInput[st->src], 1);
   for (tryThis = 0; tryThis < 3; tryThis++)
     {
       switch (tryThis)
@@ -1545,12 +2148,9 @@ for_passSelectRule ()
 	case 0:
 	  if (!(length >= 2))
 	    break;
-/*Hash function optimized for forward translation */
-	  makeHash = (unsigned long int) dots->lowercase << 8;
-	  dots2 = back_findCharOrDots (currentInput[src + 1], 1);
-	  makeHash += (unsigned long int) dots2->lowercase;
-	  makeHash %= HASHNUM;
-	  ruleOffset = table->forRules[makeHash];
+	  dots2 = back_findCharOrDots (st, st->currentInput[st->src + 1], 1);
+	  ruleOffset = findForRules (st->table, dots->lowercase,
+				     dots2->lowercase);
 	  break;
 	case 1:
 	  if (!(length >= 1))
@@ -1559,83 +2159,89 @@ for_passSelectRule ()
 	  ruleOffset = dots->otherRules;
 	  break;
 	case 2:		/*No rule found */
-	  currentOpcode = CTO_Always;
+	  st->currentOpcode = CTO_Always;
 	  return;
 	  break;
 	}
       while (ruleOffset)
 	{
-	  currentRule =
-	    (TranslationTableRule *) & table->ruleArea[ruleOffset];
-	  currentOpcode = currentRule->opcode;
-	  currentCharslen = currentRule->charslen;
-	  if (tryThis == 1 || ((currentCharslen <= length) && checkDots ()))
+	  st->currentRule =
+	    (TranslationTableRule *) & st->table->ruleArea[ruleOffset];
+	  st->currentOpcode = st->currentRule->opcode;
+	  st->currentCharslen = st->currentRule->charslen;
+	  if (tryThis == 1 || ((st->currentCharslen <= length)
+			       && checkDots (st)))
 /* check this rule */
-	    switch (currentOpcode)
+	    switch (st->currentOpcode)
 	      {			/*check validity of this Translation */
 	      case CTO_Pass2:
-		if (currentPass != 2)
+		if (st->currentPass != 2)
 		  break;
-		if (!back_passDoTest ())
+		if (!back_passDoTest (st))
 		  break;
 		return;
 	      case CTO_Pass3:
-		if (currentPass != 3)
+		if (st->currentPass != 3)
 		  break;
-		if (!back_passDoTest ())
+		if (!back_passDoTest (st))
 		  break;
 		return;
 	      case CTO_Pass4:
-		if (currentPass != 4)
+		if (st->currentPass != 4)
 		  break;
-		if (!back_passDoTest ())
+		if (!back_passDoTest (st))
 		  break;
 		return;
 	      default:
 		break;
 	      }
-	  ruleOffset = currentRule->charsnext;
+	  ruleOffset = st->currentRule->charsnext;
 	}
     }
   return;
 }
 
 static int
-translatePass ()
+translatePass (BackTranslationState *st)
 {
   int k;
-  previousOpcode = CTO_None;
-  src = dest = 0;
+  st->previousOpcode = CTO_None;
+  traceEvent (louTracePass, 1, st->currentPass, 0, 0, 0);
+  st->src = st->dest = 0;
   for (k = 0; k < NUMVAR; k++)
-    passVariables[k] = 0;
-  while (src < srcmax)
+    st->passVariables[k] = 0;
+  while (st->src < st->srcmax)
     {				/*the main multipass translation loop */
-      for_passSelectRule ();
-      switch (currentOpcode)
+      if (outOfWork (&st->work))
+	goto failure;
+      for_passSelectRule (st);
+      switch (st->currentOpcode)
 	{
 	case CTO_Pass2:
 	case CTO_Pass3:
 	case CTO_Pass4:
-	  if (!back_passDoAction ())
+	  traceEvent (louTraceRule, 1, st->currentPass, st->currentOpcode,
+		      st->src, st->dest);
+	  if (!back_passDoAction (st))
 	    goto failure;
-	  src = endReplace;
+	  st->src = st->endReplace;
 	  break;
 	case CTO_Always:
-	  if ((dest + 1) > destmax)
+	  if ((st->dest + 1) > st->destmax)
 	    goto failure;
-	  srcMapping[dest] = srcMapping[src];
-	  currentOutput[dest++] = currentInput[src++];
+	  st->srcMapping[st->dest] = st->srcMapping[st->src];
+	  st->currentOutput[st->dest++] = st->currentInput[st->src++];
 	  break;
 	default:
 	  goto failure;
 	}
     }
-  srcMapping[dest] = srcMapping[src];
+  st->srcMapping[st->dest] = st->srcMapping[st->src];
 failure:
-  if (src < srcmax)
+  if (st->src < st->srcmax)
     {
-      while (checkAttr (currentInput[src], CTC_Space, 1))
-	if (++src == srcmax)
+      while (checkAttr (st, st->currentInput[st->src], CTC_Space, 1))
+	if (++st->src == st->srcmax)
 	  break;
     }
   return 1;
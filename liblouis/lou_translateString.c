@@ -32,13 +32,142 @@
 #include <string.h>
 
 #include "louis.h"
+#include "config.h"
 #include "transcommon.ci"
 
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#endif
+
 #define MIN(a,b) (((a)<(b))?(a):(b))
+#define MAX(a,b) (((a)>(b))?(a):(b))
+#define NOWORDLIMIT 0x7fffffff	/*wordLimit when no word is remembered */
+
+static int translateString (TranslationState *st);
+static void initTranslationState (TranslationState * st);
+
+static TranslationTableCharacterAttributes
+inputAttributes (TranslationState * st, int pos)
+{
+/* The attributes of currentInput[pos], taken from the buffer filled at 
+* the start of the first pass while there is one. */
+  if (st->inputAttributesBuffer && pos >= 0 && pos < st->srcmax)
+    return st->inputAttributesBuffer[pos];
+  return (findCharOrDots (st, st->currentInput[pos], 0))->attributes;
+}
+
+static widechar
+inputLowercase (TranslationState * st, int pos)
+{
+  if (st->inputLowercaseBuffer && pos >= 0 && pos < st->srcmax)
+    return st->inputLowercaseBuffer[pos];
+  return (findCharOrDots (st, st->currentInput[pos], 0))->lowercase;
+}
+
+static int
+checkInputAttr (TranslationState * st, int pos,
+		const TranslationTableCharacterAttributes a)
+{
+  return (inputAttributes (st, pos) & a) ? 1 : 0;
+}
+
+/* Scanning for the boundaries of words. These find the first position 
+* from pos towards end, or the last from pos back to start, whose 
+* attributes have any of a if present is 1, or none of them if it is 0. 
+* They return end, or start - 1, if there is none. While the buffer of 
+* attributes is filled they walk it directly. Runs are a word or a few 
+* spaces long, too short for vector compares to pay for their setup. */
+
+static int
+nextInputAttr (TranslationState * st, int pos, int end,
+	       const TranslationTableCharacterAttributes a, int present)
+{
+  const TranslationTableCharacterAttributes *attributes =
+    st->inputAttributesBuffer;
+  if (attributes == NULL || pos < 0 || end > st->srcmax)
+    {
+      while (pos < end && checkInputAttr (st, pos, a) != present)
+	pos++;
+    }
+  else if (present)
+    {
+      while (pos < end && !(attributes[pos] & a))
+	pos++;
+    }
+  else
+    while (pos < end && (attributes[pos] & a))
+      pos++;
+  return pos;
+}
+
+static int
+previousInputAttr (TranslationState * st, int pos, int start,
+		   const TranslationTableCharacterAttributes a, int present)
+{
+  const TranslationTableCharacterAttributes *attributes =
+    st->inputAttributesBuffer;
+  if (attributes == NULL || start < 0 || pos >= st->srcmax)
+    {
+      while (pos >= start && checkInputAttr (st, pos, a) != present)
+	pos--;
+    }
+  else if (present)
+    {
+      while (pos >= start && !(attributes[pos] & a))
+	pos--;
+    }
+  else
+    while (pos >= start && (attributes[pos] & a))
+      pos--;
+  return pos;
+}
 
-static int translateString ();
-static int compbrlStart = 0;
-static int compbrlEnd = 0;
+static struct WordCache *getWordCache (louContext * ctx);
+static int translateWithContext (louContext * ctx, const char *tableList,
+				 const widechar * inbufx, int *inlen,
+				 widechar * outbuf, int *outlen,
+				 formtype *typeform, char *spacing,
+				 int *outputPos, int *inputPos,
+				 int *cursorPos,
+				 const TranslationTableRule ** rules,
+				 int *rulesLen, int modex);
+static int translateWithTable (louContext * ctx,
+			       const TranslationTableHeader * table,
+			       const widechar * inbufx, int *inlen,
+			       widechar * outbuf, int *outlen,
+			       formtype *typeform, char *spacing,
+			       int *outputPos, int *inputPos, int *cursorPos,
+			       const TranslationTableRule ** rules,
+			       int *rulesLen, int modex);
+static int translateWithSpans (louContext * ctx,
+			       const TranslationTableHeader * table,
+			       const widechar * inbufx, int *inlen,
+			       widechar * outbuf, int *outlen,
+			       formtype *typeform,
+			       const louEmphasisSpan * spans, int numSpans,
+			       char *spacing, int *outputPos, int *inputPos,
+			       int *cursorPos,
+			       const TranslationTableRule ** rules,
+			       int *rulesLen, int modex);
+static int hyphenateWithTable (const TranslationTableHeader * table,
+			       const widechar * inbuf, int inlen,
+			       char *hyphens, int mode);
+static int hyphenateTextWithTable (const TranslationTableHeader * table,
+				   const widechar * inbuf, int inlen,
+				   char *hyphens);
+static int dotsToCharWithTable (const TranslationTableHeader * table,
+				widechar * inbuf, widechar * outbuf,
+				int length);
+static int charToDotsWithTable (const TranslationTableHeader * table,
+				const widechar * inbuf, widechar * outbuf,
+				int length, int mode);
 
 int EXPORT_CALL
 lou_translateString (const char *tableList, const widechar
@@ -64,6 +193,1551 @@ lou_translate (const char *tableList, const widechar
 			  NULL, NULL, modex);
 }
 
+int EXPORT_CALL
+lou_translateCtx (louContext * ctx, const char *tableList,
+		  const widechar * inbufx, int *inlen, widechar * outbuf,
+		  int *outlen, formtype *typeform, char *spacing,
+		  int *outputPos, int *inputPos, int *cursorPos, int modex)
+{
+  if (ctx == NULL)
+    return 0;
+  return translateWithContext (ctx, tableList, inbufx, inlen, outbuf,
+			       outlen, typeform, spacing, outputPos,
+			       inputPos, cursorPos, NULL, NULL, modex);
+}
+
+int EXPORT_CALL
+lou_translateWithTable (const louTable * handle, louContext * ctx,
+			const widechar * inbufx, int *inlen,
+			widechar * outbuf, int *outlen, formtype *typeform,
+			char *spacing, int *outputPos, int *inputPos,
+			int *cursorPos, int modex)
+{
+  return translateWithTable (ctx, getTableFromHandle (handle), inbufx,
+			     inlen, outbuf, outlen, typeform, spacing,
+			     outputPos, inputPos, cursorPos, NULL, NULL,
+			     modex);
+}
+
+int EXPORT_CALL
+lou_translateWithSpans (const louTable * handle, louContext * ctx,
+			const widechar * inbuf, int *inlen,
+			widechar * outbuf, int *outlen,
+			const louEmphasisSpan * spans, int numSpans,
+			int *outputPos, int *inputPos, int *cursorPos,
+			int mode)
+{
+  int k;
+  if (numSpans < 0 || (spans == NULL && numSpans > 0))
+    return 0;
+  for (k = 0; k < numSpans; k++)
+    if (spans[k].start < 0 || spans[k].length < 0)
+      return 0;
+  return translateWithSpans (ctx, getTableFromHandle (handle), inbuf,
+			     inlen, outbuf, outlen, NULL, spans, numSpans,
+			     NULL, outputPos, inputPos, cursorPos, NULL, NULL,
+			     mode);
+}
+
+#define BATCHATTEMPTS 5		/*sizes of output tried before a string 
+				   of a batch or stream is given up */
+
+static int
+translateBatchString (louContext * ctx, const TranslationTableHeader * table,
+		      const widechar * inbuf, int inlen,
+		      const formtype * typeform, widechar * outbuf,
+		      int *outlen, int *inputPos, formtype ** typeBuffer,
+		      int *typeBufferSize, int mode)
+{
+/* Translate one string of a batch. Returns 1 on success, 0 if the 
+* translation failed and -1 if it may not have fit in outlen. As in 
+* translateAlloc, a translation that fits leaves more than MAXSTRING 
+* places unused, since the translator stops short of the end of the 
+* output without saying so. The caller's typeform is copied first, 
+* since translation overwrites it with information about the output. */
+  formtype *types = NULL;
+  int size;
+  int room = *outlen;
+  int k = inlen;
+  if (typeform != NULL)
+    {
+      size = inlen > *outlen ? inlen : *outlen;
+      if (size > *typeBufferSize)
+	{
+	  if (!(*typeBuffer = realloc (*typeBuffer, size * sizeof (formtype))))
+	    outOfMemory ();
+	  *typeBufferSize = size;
+	}
+      types = *typeBuffer;
+      memcpy (types, typeform, inlen * sizeof (formtype));
+    }
+  if (!translateWithTable (ctx, table, inbuf, &k, outbuf, outlen, types,
+			   NULL, NULL, inputPos, NULL, NULL, NULL, mode))
+    return 0;
+  return *outlen < room - MAXSTRING ? 1 : -1;
+}
+
+static int
+translateBatchRoom (louContext * ctx, const TranslationTableHeader * table,
+		    const widechar * inbuf, int inlen,
+		    const formtype * typeform, widechar ** buffer,
+		    int *bufferSize, int used, int *outlen,
+		    formtype ** typeBuffer, int *typeBufferSize, int mode)
+{
+/* Translate one string of a batch into *buffer after its first used 
+* places, growing it until the translation fits. Returns 1 on success 
+* and 0 if the string could not be translated. */
+  int room = 2 * inlen + 2 * MAXSTRING;
+  int attempts, rv;
+  for (attempts = 0; attempts < BATCHATTEMPTS; attempts++)
+    {
+      if (used + room > *bufferSize)
+	{
+	  *bufferSize = 2 * *bufferSize + room;
+	  if (!(*buffer = realloc (*buffer, *bufferSize * CHARSIZE)))
+	    outOfMemory ();
+	}
+      *outlen = room;
+      if ((rv = translateBatchString (ctx, table, inbuf, inlen, typeform,
+				      &(*buffer)[used], outlen, NULL,
+				      typeBuffer, typeBufferSize, mode)) != -1)
+	return rv;
+      room *= 2;
+    }
+  return 0;
+}
+
+int EXPORT_CALL
+lou_translateBatch (const louTable * handle, louContext * ctx, int count,
+		    const widechar * inbuf, const int *inOffsets,
+		    const int *inLengths, const formtype * typeform,
+		    widechar * outbuf, int outSize, int *outOffsets,
+		    int *outLengths, int mode)
+{
+/* Translate count strings into one output arena. Returns the number of 
+* strings translated, which is less than count if the arena filled up 
+* or a translation failed. Each string is translated where there is 
+* room for it to be done in full, then copied to the arena. */
+  const TranslationTableHeader *table = getTableFromHandle (handle);
+  formtype *typeBuffer = NULL;
+  int typeBufferSize = 0;
+  widechar *buffer = NULL;
+  int bufferSize = 0;
+  int outUsed = 0;
+  int done;
+  int outlen;
+  if (table == NULL || count < 0 || inbuf == NULL || inOffsets == NULL
+      || inLengths == NULL || outbuf == NULL || outOffsets == NULL
+      || outLengths == NULL)
+    return 0;
+  for (done = 0; done < count; done++)
+    {
+      if (!translateBatchRoom (ctx, table, &inbuf[inOffsets[done]],
+			       inLengths[done],
+			       typeform ? &typeform[inOffsets[done]] : NULL,
+			       &buffer, &bufferSize, 0, &outlen, &typeBuffer,
+			       &typeBufferSize, mode)
+	  || outlen > outSize - outUsed)
+	break;
+      memcpy (&outbuf[outUsed], buffer, outlen * CHARSIZE);
+      outOffsets[done] = outUsed;
+      outLengths[done] = outlen;
+      outUsed += outlen;
+    }
+  free (buffer);
+  free (typeBuffer);
+  return done;
+}
+
+/* Parallel batches. Each worker thread takes the next few strings of 
+* the batch, translates them into a buffer of its own and records where 
+* each translation is. When all the workers have finished, the 
+* translations are copied to the output in order, so the result does 
+* not depend on how the strings were shared out. */
+
+#if defined(_WIN32) || (defined(HAVE_PTHREAD_H) && defined(__GNUC__))
+#define BATCHTHREADS 1
+#endif
+
+#define BATCHCHUNK 8		/*strings taken by a worker at a time */
+
+typedef struct
+{
+  const TranslationTableHeader *table;
+  int count;
+  const widechar *inbuf;
+  const int *inOffsets;
+  const int *inLengths;
+  const formtype *typeform;
+  int outSize;
+  int mode;
+  volatile long next;		/*first string not yet taken by a worker */
+  int *resultWorker;
+  int *resultOffset;
+  int *resultLength;		/*-1 if the string could not be translated */
+} BatchJob;
+
+typedef struct
+{
+  BatchJob *job;
+  int number;
+  louContext *ctx;
+  widechar *buffer;
+  int bufferSize;
+  int bufferUsed;
+  formtype *typeBuffer;
+  int typeBufferSize;
+} BatchWorker;
+
+static void
+runBatchWorker (BatchWorker * worker)
+{
+  BatchJob *job = worker->job;
+  int first, last, k;
+  int outlen, rv;
+  for (;;)
+    {
+#if defined(_WIN32)
+      first = InterlockedExchangeAdd (&job->next, BATCHCHUNK);
+#elif defined(__GNUC__)
+      first = __atomic_fetch_add (&job->next, BATCHCHUNK, __ATOMIC_RELAXED);
+#else
+      first = job->next;
+      job->next += BATCHCHUNK;
+#endif
+      if (first >= job->count)
+	break;
+      last = first + BATCHCHUNK;
+      if (last > job->count)
+	last = job->count;
+      for (k = first; k < last; k++)
+	{
+	  rv = translateBatchRoom (worker->ctx, job->table,
+				   &job->inbuf[job->inOffsets[k]],
+				   job->inLengths[k],
+				   job->typeform ?
+				   &job->typeform[job->inOffsets[k]] : NULL,
+				   &worker->buffer, &worker->bufferSize,
+				   worker->bufferUsed, &outlen,
+				   &worker->typeBuffer,
+				   &worker->typeBufferSize, job->mode);
+	  job->resultWorker[k] = worker->number;
+	  job->resultOffset[k] = worker->bufferUsed;
+	  job->resultLength[k] = rv == 1 ? outlen : -1;
+	  if (rv == 1)
+	    worker->bufferUsed += outlen;
+	}
+    }
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI
+batchThread (LPVOID arg)
+{
+  runBatchWorker (arg);
+  return 0;
+}
+#elif defined(BATCHTHREADS)
+static void *
+batchThread (void *arg)
+{
+  runBatchWorker (arg);
+  return NULL;
+}
+#endif
+
+int
+processorCount (void)
+{
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo (&info);
+  return info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  long count = sysconf (_SC_NPROCESSORS_ONLN);
+  return count > 0 ? count : 1;
+#else
+  return 1;
+#endif
+}
+
+int EXPORT_CALL
+lou_translateBatchParallel (const louTable * handle, int threads,
+			    int count, const widechar * inbuf,
+			    const int *inOffsets, const int *inLengths,
+			    const formtype * typeform, widechar * outbuf,
+			    int outSize, int *outOffsets, int *outLengths,
+			    int mode)
+{
+  BatchJob job;
+  BatchWorker *workers;
+  int outUsed = 0;
+  int done, length, k, started;
+#if defined(_WIN32)
+  HANDLE *threadHandles;
+#elif defined(BATCHTHREADS)
+  pthread_t *threadHandles;
+#endif
+  if (!(job.table = getTableFromHandle (handle)) || count < 0
+      || inbuf == NULL || inOffsets == NULL || inLengths == NULL
+      || outbuf == NULL || outOffsets == NULL || outLengths == NULL)
+    return 0;
+  if (threads <= 0)
+    threads = processorCount ();
+  if (threads > (count + BATCHCHUNK - 1) / BATCHCHUNK)
+    threads = (count + BATCHCHUNK - 1) / BATCHCHUNK;
+#ifndef BATCHTHREADS
+  threads = 1;
+#endif
+  if (threads <= 1)
+    {
+      louContext *ctx = lou_createContext ();
+      done = lou_translateBatch (handle, ctx, count, inbuf, inOffsets,
+				 inLengths, typeform, outbuf, outSize,
+				 outOffsets, outLengths, mode);
+      lou_freeContext (ctx);
+      return done;
+    }
+  job.count = count;
+  job.inbuf = inbuf;
+  job.inOffsets = inOffsets;
+  job.inLengths = inLengths;
+  job.typeform = typeform;
+  job.outSize = outSize;
+  job.mode = mode;
+  job.next = 0;
+  if (!(job.resultWorker = malloc (3 * count * sizeof (int))))
+    outOfMemory ();
+  job.resultOffset = job.resultWorker + count;
+  job.resultLength = job.resultOffset + count;
+  if (!(workers = calloc (threads, sizeof (BatchWorker))))
+    outOfMemory ();
+#ifdef BATCHTHREADS
+  if (!(threadHandles = malloc (threads * sizeof (*threadHandles))))
+    outOfMemory ();
+#endif
+  for (k = 0; k < threads; k++)
+    {
+      workers[k].job = &job;
+      workers[k].number = k;
+      workers[k].ctx = lou_createContext ();
+    }
+  /* The calling thread is the first worker */
+  for (k = 1; k < threads; k++)
+    {
+#if defined(_WIN32)
+      if (!(threadHandles[k] = CreateThread (NULL, 0, batchThread,
+					     &workers[k], 0, NULL)))
+	break;
+#elif defined(BATCHTHREADS)
+      if (pthread_create (&threadHandles[k], NULL, batchThread,
+			  &workers[k]))
+	break;
+#endif
+    }
+  started = k;
+  runBatchWorker (&workers[0]);
+  for (k = 1; k < started; k++)
+    {
+#if defined(_WIN32)
+      WaitForSingleObject (threadHandles[k], INFINITE);
+      CloseHandle (threadHandles[k]);
+#elif defined(BATCHTHREADS)
+      pthread_join (threadHandles[k], NULL);
+#endif
+    }
+  for (done = 0; done < count; done++)
+    {
+      length = job.resultLength[done];
+      if (length < 0 || outUsed + length > outSize)
+	break;
+      memcpy (&outbuf[outUsed],
+	      &workers[job.resultWorker[done]].buffer[job.resultOffset[done]],
+	      length * CHARSIZE);
+      outOffsets[done] = outUsed;
+      outLengths[done] = length;
+      outUsed += length;
+    }
+  for (k = 0; k < threads; k++)
+    {
+      lou_freeContext (workers[k].ctx);
+      free (workers[k].buffer);
+      free (workers[k].typeBuffer);
+    }
+#ifdef BATCHTHREADS
+  free (threadHandles);
+#endif
+  free (workers);
+  free (job.resultWorker);
+  return done;
+}
+
+/* Streaming translation. Input is collected until there is enough of 
+* it, then translated up to the last place where cutting it cannot 
+* change the translation, and the rest is kept for the next piece. */
+
+#define STREAMCHUNK 4096	/*input collected before translating */
+#define STREAMMAXCHUNK (4 * STREAMCHUNK)	/*cut here even if unsafe */
+
+struct louStream
+{
+  const louTable *table;
+  louContext *ctx;
+  int mode;
+  louStreamCallback callback;
+  void *userData;
+  widechar *input;		/*input not yet translated */
+  formtype *typeform;		/*NULL until some typeform is fed */
+  int inputLength;
+  int inputStart;		/*position of input[0] in the whole stream */
+  widechar *output;
+  int *outputPositions;
+  int outputSize;
+  formtype *typeBuffer;
+  int typeBufferSize;
+};
+
+louStream *EXPORT_CALL
+lou_openStream (const louTable * table, int mode,
+		louStreamCallback callback, void *userData)
+{
+  louStream *stream;
+  if (table == NULL || callback == NULL)
+    return NULL;
+  if (!(stream = calloc (1, sizeof (louStream))))
+    outOfMemory ();
+  if (!(stream->input = malloc (STREAMMAXCHUNK * CHARSIZE)))
+    outOfMemory ();
+  stream->table = table;
+  stream->ctx = lou_createContext ();
+  stream->mode = mode;
+  stream->callback = callback;
+  stream->userData = userData;
+  return stream;
+}
+
+static int
+isStreamSpace (TranslationState * st, widechar c)
+{
+  return (findCharOrDots (st, c, 0)->attributes & CTC_Space) != 0;
+}
+
+static int
+isSafeCut (TranslationState * st, const widechar * input,
+	   const formtype * typeform, int k)
+{
+/* Whether input can be cut before input[k], with k at least 2: after a 
+* space, with no emphasis or capitals running across the space. */
+  if (!isStreamSpace (st, input[k - 1]) || isStreamSpace (st, input[k])
+      || isStreamSpace (st, input[k - 2]))
+    return 0;
+  if (typeform && (typeform[k - 2] & EMPHASIS) && (typeform[k] & EMPHASIS))
+    return 0;
+  if ((findCharOrDots (st, input[k - 2], 0)->attributes & CTC_UpperCase)
+      && (findCharOrDots (st, input[k], 0)->attributes & CTC_UpperCase))
+    return 0;
+  return 1;
+}
+
+static int
+safeStreamCut (const louStream * stream, TranslationState * st)
+{
+/* Find the last place where the pending input can be cut. Returns 0 if 
+* there is none. */
+  int k;
+  for (k = stream->inputLength - 1; k >= 2; k--)
+    if (isSafeCut (st, stream->input, stream->typeform, k))
+      return k;
+  return 0;
+}
+
+static int
+translateStreamPiece (louStream * stream, int length)
+{
+/* Translate the first length characters of the pending input and pass 
+* the result to the callback. */
+  const TranslationTableHeader *table = getTableFromHandle (stream->table);
+  int outlen, rv, k, attempts;
+  int room = 2 * length + 2 * MAXSTRING;
+  for (attempts = 0;; attempts++)
+    {
+      if (room > stream->outputSize)
+	{
+	  if (!(stream->output = realloc (stream->output, room * CHARSIZE))
+	      || !(stream->outputPositions =
+		   realloc (stream->outputPositions, room * sizeof (int))))
+	    outOfMemory ();
+	  stream->outputSize = room;
+	}
+      outlen = room;
+      rv = translateBatchString (stream->ctx, table, stream->input, length,
+				 stream->typeform, stream->output, &outlen,
+				 stream->outputPositions, &stream->typeBuffer,
+				 &stream->typeBufferSize, stream->mode);
+      if (rv != -1)
+	break;
+      if (attempts == BATCHATTEMPTS - 1)
+	return 0;
+      room *= 2;
+    }
+  if (!rv)
+    return 0;
+  for (k = 0; k < outlen; k++)
+    stream->outputPositions[k] += stream->inputStart;
+  stream->callback (stream->output, outlen, stream->outputPositions,
+		    stream->userData);
+  stream->inputLength -= length;
+  stream->inputStart += length;
+  memmove (stream->input, &stream->input[length],
+	   stream->inputLength * CHARSIZE);
+  if (stream->typeform)
+    memmove (stream->typeform, &stream->typeform[length],
+	     stream->inputLength * sizeof (formtype));
+  return 1;
+}
+
+int EXPORT_CALL
+lou_feedStream (louStream * stream, const widechar * inbuf, int inlen,
+		const formtype * typeform)
+{
+  TranslationState state;
+  TranslationState *st = &state;
+  int cut, piece;
+  if (stream == NULL || inbuf == NULL || inlen < 0)
+    return 0;
+  initTranslationState (st);
+  if (!(st->table = getTableFromHandle (stream->table)))
+    return 0;
+  if (typeform && !stream->typeform)
+    {
+      if (!(stream->typeform = calloc (STREAMMAXCHUNK, sizeof (formtype))))
+	outOfMemory ();
+    }
+  while (inlen > 0)
+    {
+      piece = STREAMMAXCHUNK - stream->inputLength;
+      if (piece > inlen)
+	piece = inlen;
+      memcpy (&stream->input[stream->inputLength], inbuf, piece * CHARSIZE);
+      if (typeform)
+	memcpy (&stream->typeform[stream->inputLength], typeform,
+		piece * sizeof (formtype));
+      else if (stream->typeform)
+	memset (&stream->typeform[stream->inputLength], 0,
+		piece * sizeof (formtype));
+      stream->inputLength += piece;
+      inbuf += piece;
+      if (typeform)
+	typeform += piece;
+      inlen -= piece;
+      while (stream->inputLength >= STREAMCHUNK)
+	{
+	  if (!(cut = safeStreamCut (stream, st)))
+	    {
+	      if (stream->inputLength < STREAMMAXCHUNK)
+		break;
+	      cut = stream->inputLength;
+	    }
+	  if (!translateStreamPiece (stream, cut))
+	    return 0;
+	}
+    }
+  return 1;
+}
+
+int EXPORT_CALL
+lou_flushStream (louStream * stream)
+{
+  if (stream == NULL)
+    return 0;
+  if (stream->inputLength == 0)
+    return 1;
+  return translateStreamPiece (stream, stream->inputLength);
+}
+
+void EXPORT_CALL
+lou_closeStream (louStream * stream)
+{
+  if (stream == NULL)
+    return;
+  lou_freeContext (stream->ctx);
+  free (stream->input);
+  free (stream->typeform);
+  free (stream->output);
+  free (stream->outputPositions);
+  free (stream->typeBuffer);
+  free (stream);
+}
+
+/* Retranslation after an edit. The input around the change is 
+* translated again, from a safe cut before it to one after it with two 
+* words more on each side, and spliced into the previous translation. 
+* The extra words before the change and the nearer one after it must 
+* come out as they did before, or else the whole input is translated 
+* again. The farther word after it gives that one its context. The same 
+* is done for back-translation, with cuts at blank cells. */
+
+static int
+outputCut (const int *inputPos, int outlen, int cut)
+{
+/* The number of output characters translated from the input before 
+* cut, or -1 if they are not all ahead of the others. */
+  int k;
+  int count = 0;
+  for (k = 0; k < outlen; k++)
+    if (inputPos[k] < cut)
+      {
+	if (count != k)
+	  return -1;
+	count++;
+      }
+  return count;
+}
+
+static int
+isBlankCell (TranslationState * st, widechar c)
+{
+/* Whether c of the input of a back-translation is a blank cell */
+  widechar dots = (st->mode & dotsIO) ? c | 0x8000 :
+    getDotsForCharInTable (st->table, c);
+  return (findCharOrDots (st, dots, 1)->attributes & CTC_Space) != 0;
+}
+
+static int
+isRetranslationCut (TranslationState * st, const widechar * input, int k,
+		    int backward)
+{
+  if (!backward)
+    return isSafeCut (st, input, NULL, k);
+  return isBlankCell (st, input[k - 1]) && !isBlankCell (st, input[k])
+    && !isBlankCell (st, input[k - 2]);
+}
+
+static int
+cutBefore (TranslationState * st, const widechar * input, int k,
+	   int backward)
+{
+/* The last safe cut at or before k, or 0 */
+  for (; k >= 2; k--)
+    if (isRetranslationCut (st, input, k, backward))
+      return k;
+  return 0;
+}
+
+static int
+cutAfter (TranslationState * st, const widechar * input, int length, int k,
+	  int backward)
+{
+/* The first safe cut at or after k, or length */
+  for (k = MAX (k, 2); k < length; k++)
+    if (isRetranslationCut (st, input, k, backward))
+      return k;
+  return length;
+}
+
+static int
+retranslateWindow (louContext * ctx, const TranslationTableHeader * table,
+		   const widechar * inbuf, int inlen, int *cursor,
+		   widechar ** outbuf, int *outlen, int **outputPos,
+		   int **inputPos, int *states, int mode, int backward)
+{
+/* Translate inbuf into buffers allocated here, growing them until the 
+* output does not fill them. Returns 0 if the translation failed and -1 
+* if a back-translation stopped before the end of inbuf. */
+  int room = 2 * inlen + 64;
+  int start = cursor != NULL ? *cursor : -1;
+  int k, result;
+  if (!(*outputPos = malloc ((inlen + 1) * sizeof (int))))
+    outOfMemory ();
+  *outbuf = NULL;
+  *inputPos = NULL;
+  while (1)
+    {
+      if (!(*outbuf = realloc (*outbuf, room * CHARSIZE))
+	  || !(*inputPos = realloc (*inputPos, room * sizeof (int))))
+	outOfMemory ();
+      k = inlen;
+      *outlen = room;
+      if (cursor != NULL)
+	*cursor = start;
+      if (backward)
+	result = backTranslateWithStates (ctx, table, inbuf, &k, *outbuf,
+					  outlen, *outputPos, *inputPos,
+					  cursor, states, mode);
+      else
+	result = translateWithTable (ctx, table, inbuf, &k, *outbuf, outlen,
+				     NULL, NULL, *outputPos, *inputPos,
+				     cursor, NULL, NULL, mode);
+      if (!result)
+	return 0;
+      /* Back-translation stops short of the end of the buffer when what 
+       * comes next does not fit, and then skips blank cells after it */
+      if (backward && *outlen + 64 < room)
+	return k < inlen ? -1 : 1;
+      if (!backward && *outlen < room)
+	return 1;
+      room *= 2;
+    }
+}
+
+static int
+previousState (louContext * ctx, const TranslationTableHeader * table,
+	       const louTranslation * previous, int from, int to, int at,
+	       int mode)
+{
+/* The state a back-translation of the previous input from from to to 
+* leaves at at, as backTranslateWithStates gives it */
+  widechar *outbuf = NULL;
+  int *outputPos = NULL;
+  int *inputPos = NULL;
+  int *states;
+  int outlen, state = 0;
+  if (!(states = malloc ((to - from + 1) * sizeof (int))))
+    outOfMemory ();
+  if (retranslateWindow (ctx, table, &previous->inbuf[from], to - from, NULL,
+			 &outbuf, &outlen, &outputPos, &inputPos, states,
+			 mode, 1) == 1)
+    state = states[at - from];
+  free (outbuf);
+  free (outputPos);
+  free (inputPos);
+  free (states);
+  return state;
+}
+
+static int
+retranslate (const louTable * handle, louContext * ctx,
+	     const louTranslation * previous, const widechar * inbuf,
+	     int *inlen, widechar * outbuf, int *outlen, int *outputPos,
+	     int *inputPos, int *cursorPos, int mode, int backward)
+{
+  TranslationState state;
+  TranslationState *st = &state;
+  const TranslationTableHeader *table;
+  widechar *winOutbuf = NULL;
+  int *winOutputPos = NULL;
+  int *winInputPos = NULL;
+  int *states = NULL;
+  int winOutlen;
+  int oldlen, newlen, delta;
+  int start, end;		/*the changed part of the new input */
+  int a00, a0, a, b, b0, b00;	/*the cuts around it */
+  int oldA00, oldA, oldB, oldB0;	/*where they are in the output */
+  int winA, winB, winB0;
+  int cursor = cursorPos != NULL ? *cursorPos : -1;
+  int winCursor = -1;
+  int total, shift, k;
+  if (previous == NULL || inbuf == NULL || inlen == NULL || *inlen < 0
+      || outbuf == NULL || outlen == NULL)
+    return 0;
+  initTranslationState (st);
+  if (!(table = st->table = getTableFromHandle (handle)))
+    return 0;
+  st->mode = mode;
+  oldlen = previous->inlen;
+  newlen = *inlen;
+  delta = newlen - oldlen;
+  if (previous->inbuf == NULL || previous->outbuf == NULL
+      || previous->outputPos == NULL || previous->inputPos == NULL
+      || oldlen < 0 || newlen < 3)
+    goto full;
+  for (start = 0; start < oldlen && start < newlen
+       && previous->inbuf[start] == inbuf[start]; start++);
+  for (k = 0; k < oldlen - start && k < newlen - start
+       && previous->inbuf[oldlen - 1 - k] == inbuf[newlen - 1 - k]; k++);
+  end = newlen - k;
+  if (backward)
+    {
+      /* A 0 ends the input of a back-translation */
+      for (k = 0; k < newlen; k++)
+	if (!inbuf[k])
+	  goto full;
+      /* The first pass to reach the cursor places it in its own output, 
+       * which other passes then change */
+      if (cursor >= 0 && !(mode & pass1Only)
+	  && (table->numPasses > 1 || table->corrections))
+	goto full;
+    }
+  else if ((mode & (compbrlAtCursor | compbrlLeftCursor)))
+    {
+      /* The correct opcode can move the input under the computer braille 
+       * part, so where it ends up depends on all the text before it */
+      if (table->corrections)
+	goto full;
+      /* The words at the old and new cursor change form */
+      if (previous->cursorPos >= 0 && previous->cursorPos < start)
+	start = previous->cursorPos;
+      else if (previous->cursorPos >= oldlen - k)
+	end = MAX (end, previous->cursorPos + delta + 1);
+      if (cursor >= 0 && cursor < start)
+	start = cursor;
+      end = MAX (end, cursor + 1);
+      end = MIN (end, newlen);
+    }
+  a = cutBefore (st, inbuf, MIN (start, newlen - 1), backward);
+  a0 = cutBefore (st, inbuf, a - 1, backward);
+  a00 = cutBefore (st, inbuf, a0 - 1, backward);
+  b = cutAfter (st, inbuf, newlen, MAX (end, 2), backward);
+  b0 = cutAfter (st, inbuf, newlen, b + 1, backward);
+  b00 = cutAfter (st, inbuf, newlen, b0 + 1, backward);
+  if (a00 == 0 && b00 == newlen)
+    goto full;
+  /* Back-translation puts the cursor in the middle of what the rule 
+   * under it gives, so it is only known inside the window */
+  if (backward && cursor >= 0 && (cursor < a || cursor >= b))
+    goto full;
+  if ((backward || (mode & (compbrlAtCursor | compbrlLeftCursor)))
+      && cursor >= a00 && cursor < b00)
+    winCursor = cursor - a00;
+  if (backward && !(states = malloc ((b00 - a00 + 1) * sizeof (int))))
+    outOfMemory ();
+  switch (retranslateWindow (ctx, table, &inbuf[a00], b00 - a00,
+			     winCursor >= 0 ? &winCursor : NULL, &winOutbuf,
+			     &winOutlen, &winOutputPos, &winInputPos, states,
+			     mode, backward))
+    {
+    case 0:
+      goto failure;
+    case -1:
+      goto fallBack;
+    }
+  /* What back-translation carries over from word to word must have 
+   * been cleared by a space rule at the cuts before and after the words 
+   * compared with the previous translation, and be left the same at the 
+   * one after them as the previous input left it */
+  if (backward && ((a0 > 0 && !states[a0 - a00])
+		   || (b0 < newlen && (!states[b0 - a00]
+				       || states[b0 - a00] !=
+				       previousState (ctx, table, previous,
+						      a00, b00 - delta,
+						      b0 - delta, mode)))))
+    goto fallBack;
+  /* A cursor on no rule is left where it was, in the whole input */
+  if (backward && cursor >= 0 && winCursor == cursor - a00)
+    goto fallBack;
+  oldA00 = outputCut (previous->inputPos, previous->outlen, a00);
+  oldA = outputCut (previous->inputPos, previous->outlen, a);
+  oldB = outputCut (previous->inputPos, previous->outlen, b - delta);
+  oldB0 = outputCut (previous->inputPos, previous->outlen, b0 - delta);
+  winA = outputCut (winInputPos, winOutlen, a - a00);
+  winB = outputCut (winInputPos, winOutlen, b - a00);
+  winB0 = outputCut (winInputPos, winOutlen, b0 - a00);
+  if (oldA00 < 0 || oldA < 0 || oldB < 0 || oldB0 < 0 || winA < 0
+      || winB < 0 || winB0 < 0 || winA != oldA - oldA00
+      || winB0 - winB != oldB0 - oldB
+      || memcmp (winOutbuf, &previous->outbuf[oldA00], winA * CHARSIZE)
+      || memcmp (&winOutbuf[winB], &previous->outbuf[oldB],
+		 (winB0 - winB) * CHARSIZE))
+    goto fallBack;
+  for (k = 0; k < winA; k++)
+    if (winInputPos[k] + a00 != previous->inputPos[oldA00 + k])
+      goto fallBack;
+  for (k = winB; k < winB0; k++)
+    if (winInputPos[k] + a00 - delta != previous->inputPos[oldB + k - winB])
+      goto fallBack;
+  for (k = a00; k < a; k++)
+    if (winOutputPos[k - a00] + oldA00 != previous->outputPos[k])
+      goto fallBack;
+  for (k = b; k < b0; k++)
+    if (winOutputPos[k - a00] - winB != previous->outputPos[k - delta] - oldB)
+      goto fallBack;
+  total = oldA + winB - winA + previous->outlen - oldB;
+  if (total > *outlen)
+    goto fallBack;
+  shift = oldA + winB - winA - oldB;
+  memcpy (outbuf, previous->outbuf, oldA * CHARSIZE);
+  memcpy (&outbuf[oldA], &winOutbuf[winA], (winB - winA) * CHARSIZE);
+  memcpy (&outbuf[oldA + winB - winA], &previous->outbuf[oldB],
+	  (previous->outlen - oldB) * CHARSIZE);
+  if (inputPos != NULL)
+    {
+      memcpy (inputPos, previous->inputPos, oldA * sizeof (int));
+      for (k = winA; k < winB; k++)
+	inputPos[oldA + k - winA] = winInputPos[k] + a00;
+      for (k = oldB; k < previous->outlen; k++)
+	inputPos[k + shift] = previous->inputPos[k] + delta;
+    }
+  if (outputPos != NULL)
+    {
+      memcpy (outputPos, previous->outputPos, a * sizeof (int));
+      for (k = a; k < b; k++)
+	outputPos[k] = winOutputPos[k - a00] - winA + oldA;
+      for (k = b; k < newlen; k++)
+	outputPos[k] = previous->outputPos[k - delta] + shift;
+    }
+  if (backward && cursor >= 0)
+    *cursorPos = winCursor - winA + oldA;
+  else if (cursor >= 0)
+    {
+      if (cursor >= newlen)
+	*cursorPos = total;
+      else if (cursor < a)
+	*cursorPos = previous->outputPos[cursor];
+      else if (cursor < b)
+	*cursorPos = winOutputPos[cursor - a00] - winA + oldA;
+      else
+	*cursorPos = previous->outputPos[cursor - delta] + shift;
+    }
+  *outlen = total;
+  free (winOutbuf);
+  free (winOutputPos);
+  free (winInputPos);
+  free (states);
+  return 1;
+fallBack:
+  free (winOutbuf);
+  free (winOutputPos);
+  free (winInputPos);
+  free (states);
+full:
+  if (backward)
+    return backTranslateWithTable (ctx, table, inbuf, inlen, outbuf, outlen,
+				   NULL, NULL, outputPos, inputPos,
+				   cursorPos, mode);
+  return translateWithTable (ctx, table, inbuf, inlen, outbuf, outlen, NULL,
+			     NULL, outputPos, inputPos, cursorPos, NULL,
+			     NULL, mode);
+failure:
+  free (winOutbuf);
+  free (winOutputPos);
+  free (winInputPos);
+  free (states);
+  return 0;
+}
+
+int EXPORT_CALL
+lou_retranslate (const louTable * handle, louContext * ctx,
+		 const louTranslation * previous, const widechar * inbuf,
+		 int *inlen, widechar * outbuf, int *outlen, int *outputPos,
+		 int *inputPos, int *cursorPos, int mode)
+{
+  return retranslate (handle, ctx, previous, inbuf, inlen, outbuf, outlen,
+		      outputPos, inputPos, cursorPos, mode, 0);
+}
+
+int EXPORT_CALL
+lou_backRetranslate (const louTable * handle, louContext * ctx,
+		     const louTranslation * previous, const widechar * inbuf,
+		     int *inlen, widechar * outbuf, int *outlen,
+		     int *outputPos, int *inputPos, int *cursorPos, int mode)
+{
+  return retranslate (handle, ctx, previous, inbuf, inlen, outbuf, outlen,
+		      outputPos, inputPos, cursorPos, mode, 1);
+}
+
+/* Parallel back-translation. The input is cut at blank cells into a 
+* segment for each thread, and each segment is back-translated in a 
+* window reaching to the cut before it and the cut after it, so that 
+* neighbouring windows overlap by a word on each side of the cut between 
+* them. The segments are joined if at every cut what is carried over 
+* was cleared by a space rule in both windows, leaving the same opcode, 
+* and the two windows give the same output and maps for the words 
+* around it. Otherwise the whole input is back-translated on the 
+* calling thread, so the result is always that of one back-translation. */
+
+#define SEGMENTCELLS 2048	/*fewest cells worth a thread */
+
+typedef struct
+{
+  const TranslationTableHeader *table;
+  louContext *ctx;
+  const widechar *inbuf;
+  int mode;
+  int start, end;		/*the window of the input back-translated */
+  int from, to;			/*the part of it whose output is kept */
+  widechar *outbuf;
+  int outlen;
+  int *outputPos;
+  int *inputPos;
+  int *states;
+  int result;
+} BackSegment;
+
+static void
+runBackSegment (BackSegment * segment)
+{
+  int length = segment->end - segment->start;
+  if (!(segment->states = malloc ((length + 1) * sizeof (int))))
+    outOfMemory ();
+  segment->result = retranslateWindow (segment->ctx, segment->table,
+				       &segment->inbuf[segment->start],
+				       length, NULL, &segment->outbuf,
+				       &segment->outlen, &segment->outputPos,
+				       &segment->inputPos, segment->states,
+				       segment->mode, 1);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI
+backSegmentThread (LPVOID arg)
+{
+  runBackSegment (arg);
+  return 0;
+}
+#elif defined(BATCHTHREADS)
+static void *
+backSegmentThread (void *arg)
+{
+  runBackSegment (arg);
+  return NULL;
+}
+#endif
+
+static int
+segmentsAgree (const BackSegment * left, const BackSegment * right)
+{
+/* Whether two neighbouring windows agree at the cut between their 
+* segments and on the words either side of it */
+  int cut = right->from;
+  int state = left->states[cut - left->start];
+  int leftStart, leftCut, rightCut, rightEnd, k;
+  if (!state || state != right->states[cut - right->start])
+    return 0;
+  leftStart = outputCut (left->inputPos, left->outlen,
+			 right->start - left->start);
+  leftCut = outputCut (left->inputPos, left->outlen, cut - left->start);
+  rightCut = outputCut (right->inputPos, right->outlen, cut - right->start);
+  rightEnd = outputCut (right->inputPos, right->outlen,
+			left->end - right->start);
+  if (leftStart < 0 || leftCut < 0 || rightCut < 0 || rightEnd < 0
+      || leftCut - leftStart != rightCut
+      || left->outlen - leftStart != rightEnd
+      || memcmp (&left->outbuf[leftStart], right->outbuf,
+		 rightEnd * CHARSIZE))
+    return 0;
+  for (k = 0; k < rightEnd; k++)
+    if (left->inputPos[leftStart + k] + left->start !=
+	right->inputPos[k] + right->start)
+      return 0;
+  for (k = cut; k < left->end; k++)
+    if (left->outputPos[k - left->start] - leftStart !=
+	right->outputPos[k - right->start])
+      return 0;
+  return 1;
+}
+
+int EXPORT_CALL
+lou_backTranslateParallel (const louTable * handle, int threads,
+			   const widechar * inbuf, int *inlen,
+			   widechar * outbuf, int *outlen, int *outputPos,
+			   int *inputPos, int mode)
+{
+  TranslationState state;
+  TranslationState *st = &state;
+  const TranslationTableHeader *table;
+  BackSegment *segments;
+  louContext *ctx;
+  int length, count, total, first, last, done, k, m;
+  int result = 0;
+#if defined(_WIN32)
+  HANDLE *threadHandles;
+#elif defined(BATCHTHREADS)
+  pthread_t *threadHandles;
+#endif
+  initTranslationState (st);
+  if (!(table = st->table = getTableFromHandle (handle)) || inbuf == NULL
+      || inlen == NULL || *inlen < 0 || outbuf == NULL || outlen == NULL)
+    return 0;
+  st->mode = mode;
+  length = *inlen;
+  if (threads <= 0)
+    threads = processorCount ();
+  count = MIN (threads, length / SEGMENTCELLS);
+#ifndef BATCHTHREADS
+  count = 1;
+#endif
+  /* A 0 ends the input of a back-translation */
+  for (k = 0; k < length && count > 1; k++)
+    if (!inbuf[k])
+      count = 1;
+  if (table->lazyBackRules)
+    table = completeTable (table, LOU_LAZY_BACKTRANSLATION);
+  if (count <= 1)
+    {
+      ctx = lou_createContext ();
+      result = backTranslateWithTable (ctx, table, inbuf, inlen, outbuf,
+				       outlen, NULL, NULL, outputPos,
+				       inputPos, NULL, mode);
+      lou_freeContext (ctx);
+      return result;
+    }
+  if (!(segments = calloc (count, sizeof (BackSegment))))
+    outOfMemory ();
+  /* Cut where the segments would be of equal length, at the next blank 
+   * cell, dropping the segments that come out too short */
+  for (k = m = 0; k < count; k++)
+    {
+      segments[m].from = k ? cutAfter (st, inbuf, length,
+				       (int) ((long) k * length / count),
+				       1) : 0;
+      if (m && segments[m].from <= segments[m - 1].from + 2)
+	continue;
+      if (segments[m].from >= length - 2)
+	break;
+      m++;
+    }
+  count = m;
+  for (k = 0; k < count; k++)
+    {
+      segments[k].table = table;
+      segments[k].ctx = lou_createContext ();
+      segments[k].inbuf = inbuf;
+      segments[k].mode = mode;
+      segments[k].to = k + 1 < count ? segments[k + 1].from : length;
+      segments[k].start = k ? cutBefore (st, inbuf, segments[k].from - 1,
+					 1) : 0;
+      segments[k].end = k + 1 < count ? cutAfter (st, inbuf, length,
+						  segments[k].to + 1,
+						  1) : length;
+    }
+#ifdef BATCHTHREADS
+  if (!(threadHandles = malloc (count * sizeof (*threadHandles))))
+    outOfMemory ();
+#endif
+  /* The calling thread takes the first segment, and those no thread 
+   * could be started for */
+  for (k = 1; k < count; k++)
+    {
+#if defined(_WIN32)
+      if (!(threadHandles[k] = CreateThread (NULL, 0, backSegmentThread,
+					     &segments[k], 0, NULL)))
+	break;
+#elif defined(BATCHTHREADS)
+      if (pthread_create (&threadHandles[k], NULL, backSegmentThread,
+			  &segments[k]))
+	break;
+#endif
+    }
+  done = k;
+  runBackSegment (&segments[0]);
+  for (k = done; k < count; k++)
+    runBackSegment (&segments[k]);
+  for (k = 1; k < done; k++)
+    {
+#if defined(_WIN32)
+      WaitForSingleObject (threadHandles[k], INFINITE);
+      CloseHandle (threadHandles[k]);
+#elif defined(BATCHTHREADS)
+      pthread_join (threadHandles[k], NULL);
+#endif
+    }
+  total = 0;
+  for (k = 0; k < count; k++)
+    {
+          if (segments[k].result != 1
+	  || (k && !segmentsAgree (&segments[k - 1], &segments[k])))
+	break;
+      total += outputCut (segments[k].inputPos, segments[k].outlen,
+			  segments[k].to - segments[k].start)
+	- outputCut (segments[k].inputPos, segments[k].outlen,
+		     segments[k].from - segments[k].start);
+    }
+  if (k < count || total > *outlen)
+    result = backTranslateWithTable (segments[0].ctx, table, inbuf, inlen,
+				     outbuf, outlen, NULL, NULL, outputPos,
+				     inputPos, NULL, mode);
+  else
+    {
+      total = 0;
+      for (k = 0; k < count; k++)
+	{
+	  BackSegment *segment = &segments[k];
+	  first = outputCut (segment->inputPos, segment->outlen,
+			     segment->from - segment->start);
+	  last = outputCut (segment->inputPos, segment->outlen,
+			    segment->to - segment->start);
+	  memcpy (&outbuf[total], &segment->outbuf[first],
+		  (last - first) * CHARSIZE);
+	  if (inputPos != NULL)
+	    for (m = first; m < last; m++)
+	      inputPos[total + m - first] =
+		segment->inputPos[m] + segment->start;
+	  if (outputPos != NULL)
+	    for (m = segment->from; m < segment->to; m++)
+	      outputPos[m] = segment->outputPos[m - segment->start] - first
+		+ total;
+	  total += last - first;
+	}
+      *outlen = total;
+      result = 1;
+    }
+  for (k = 0; k < count; k++)
+    {
+      lou_freeContext (segments[k].ctx);
+      free (segments[k].outbuf);
+      free (segments[k].outputPos);
+      free (segments[k].inputPos);
+      free (segments[k].states);
+    }
+#ifdef BATCHTHREADS
+  free (threadHandles);
+#endif
+  free (segments);
+  return result;
+}
+
+#define UTF8STRING 512
+
+static void *
+localOrAllocated (void *local, int localCount, int count, int size)
+{
+  void *buffer = local;
+  if (count > localCount && !(buffer = malloc (count * size)))
+    outOfMemory ();
+  return buffer;
+}
+
+static int
+decodeUtf8 (const unsigned char *bytes, int length, widechar * chars,
+	    int *charStart)
+{
+/* Decode length bytes of UTF-8 into chars, setting charStart[k] to the
+* offset of the bytes of chars[k] and charStart of the end to length.
+* Both halves of a surrogate pair get the offset of the character.
+* Returns the number of chars, or -1 for invalid UTF-8. */
+  static const unsigned long minimum[] = { 0, 0x80, 0x800, 0x10000 };
+  unsigned long ch;
+  int in = 0, out = 0;
+  int numBytes, k;
+  while (in < length)
+    {
+      ch = bytes[in];
+      if (ch < 0x80)
+	numBytes = 0;
+      else if ((ch & 0xe0) == 0xc0)
+	numBytes = 1;
+      else if ((ch & 0xf0) == 0xe0)
+	numBytes = 2;
+      else if ((ch & 0xf8) == 0xf0)
+	numBytes = 3;
+      else
+	return -1;
+      if (in + numBytes >= length)
+	return -1;
+      ch &= 0x7f >> numBytes;
+      for (k = 1; k <= numBytes; k++)
+	{
+	  if ((bytes[in + k] & 0xc0) != 0x80)
+	    return -1;
+	  ch = (ch << 6) | (bytes[in + k] & 0x3f);
+	}
+      if (ch < minimum[numBytes] || ch > 0x10ffff
+	  || (ch >= 0xd800 && ch < 0xe000))
+	return -1;
+      charStart[out] = in;
+      if (CHARSIZE == 2 && ch > 0xffff)
+	{
+	  ch -= 0x10000;
+	  chars[out++] = (widechar) (0xd800 | (ch >> 10));
+	  charStart[out] = in;
+	  ch = 0xdc00 | (ch & 0x3ff);
+	}
+      chars[out++] = (widechar) ch;
+      in += numBytes + 1;
+    }
+  charStart[out] = length;
+  return out;
+}
+
+static int
+encodeUtf8 (const widechar * chars, int k, int length,
+	    unsigned char *bytes, int *numBytes)
+{
+/* Put the UTF-8 of the character at chars[k] in bytes and its length
+* in numBytes. Returns the number of chars it takes, 2 for a surrogate
+* pair. */
+  unsigned long ch = chars[k];
+  int taken = 1;
+  if (ch >= 0xd800 && ch < 0xdc00 && k + 1 < length
+      && chars[k + 1] >= 0xdc00 && chars[k + 1] < 0xe000)
+    {
+      ch = 0x10000 + ((ch - 0xd800) << 10) + (chars[k + 1] - 0xdc00);
+      taken = 2;
+    }
+  else if (ch > 0x10ffff || (ch >= 0xd800 && ch < 0xe000))
+    ch = 0xfffd;
+  if (ch < 0x80)
+    {
+      bytes[0] = (unsigned char) ch;
+      *numBytes = 1;
+      return taken;
+    }
+  if (ch < 0x800)
+    *numBytes = 2;
+  else if (ch < 0x10000)
+    *numBytes = 3;
+  else
+    *numBytes = 4;
+  for (k = *numBytes - 1; k > 0; k--)
+    {
+      bytes[k] = (unsigned char) (0x80 | (ch & 0x3f));
+      ch >>= 6;
+    }
+  bytes[0] = (unsigned char) ((0xff00 >> *numBytes) | ch);
+  return taken;
+}
+
+static int
+translateUtf8 (const louTable * handle, louContext * ctx,
+	       const char *inbuf, int *inlen, char *outbuf, int *outlen,
+	       int *outputPos, int *inputPos, int mode, int backward)
+{
+/* The input is decoded once and the output is encoded straight into
+* outbuf. charInPos holds the input position of each output char until
+* it has been encoded and then the unit offset of its encoding, which
+* is what outputPos maps to. */
+  widechar localChars[UTF8STRING], localOut[UTF8STRING];
+  int localStart[UTF8STRING + 1];
+  int localOutPos[UTF8STRING], localInPos[UTF8STRING];
+  const TranslationTableHeader *table = getTableFromHandle (handle);
+  widechar *chars = localChars, *out = localOut;
+  int *charStart = localStart;
+  int *charOutPos = localOutPos, *charInPos = localInPos;
+  unsigned char bytes[4];
+  int charUnits = (mode & utf8CharPositions);
+  int n, m, consumed, written, units;
+  int numBytes, taken, j, k, b;
+  int result = 0;
+  if (table == NULL || inbuf == NULL || inlen == NULL || *inlen < 0
+      || outbuf == NULL || outlen == NULL || *outlen < 0)
+    return 0;
+  mode &= ~utf8CharPositions;
+  chars = localOrAllocated (localChars, UTF8STRING, *inlen, CHARSIZE);
+  charStart = localOrAllocated (localStart, UTF8STRING + 1, *inlen + 1,
+				sizeof (int));
+  charOutPos = localOrAllocated (localOutPos, UTF8STRING, *inlen,
+				 sizeof (int));
+  out = localOrAllocated (localOut, UTF8STRING, *outlen, CHARSIZE);
+  charInPos = localOrAllocated (localInPos, UTF8STRING, *outlen,
+				sizeof (int));
+  if ((n = decodeUtf8 ((const unsigned char *) inbuf, *inlen, chars,
+		       charStart)) < 0)
+    goto done;
+  m = *outlen;
+  if (backward)
+    {
+      if (!backTranslateWithTable (ctx, table, chars, &n, out, &m, NULL,
+				   NULL, charOutPos, charInPos, NULL, mode))
+	goto done;
+    }
+  else if (!translateWithTable (ctx, table, chars, &n, out, &m, NULL, NULL,
+				charOutPos, charInPos, NULL, NULL, NULL, mode))
+    goto done;
+  consumed = n;
+  written = units = 0;
+  for (j = 0; j < m; j += taken)
+    {
+      taken = encodeUtf8 (out, j, m, bytes, &numBytes);
+      if (written + numBytes > *outlen)
+	{
+	  consumed = charInPos[j];
+	  break;
+	}
+      memcpy (&outbuf[written], bytes, numBytes);
+      b = charUnits ? 1 : numBytes;
+      if (inputPos != NULL)
+	for (k = 0; k < b; k++)
+	  inputPos[units + k] = charInPos[j];
+      for (k = 0; k < taken; k++)
+	charInPos[j + k] = units;
+      written += numBytes;
+      units += b;
+    }
+  m = j;
+  *inlen = charStart[consumed];
+  *outlen = written;
+  if (charUnits)
+    {
+      b = 0;
+      for (k = 0; k <= n; k++)
+	{
+	  charStart[k] = b;
+	  if (k < n && !(CHARSIZE == 2 && chars[k] >= 0xd800
+			 && chars[k] < 0xdc00))
+	    b++;
+	}
+    }
+  if (inputPos != NULL)
+    for (k = 0; k < units; k++)
+      inputPos[k] = charStart[inputPos[k]];
+  if (outputPos != NULL)
+    for (k = 0; k < consumed; k = j)
+      {
+	for (j = k + 1; j < consumed && charStart[j] == charStart[k]; j++);
+	for (b = charStart[k]; b < charStart[j]; b++)
+	  outputPos[b] = charOutPos[k] < m ? charInPos[charOutPos[k]] : units;
+      }
+  result = 1;
+done:
+  if (chars != localChars)
+    free (chars);
+  if (charStart != localStart)
+    free (charStart);
+  if (charOutPos != localOutPos)
+    free (charOutPos);
+  if (out != localOut)
+    free (out);
+  if (charInPos != localInPos)
+    free (charInPos);
+  return result;
+}
+
+int EXPORT_CALL
+lou_translateUtf8 (const louTable * handle, louContext * ctx,
+		   const char *inbuf, int *inlen, char *outbuf, int *outlen,
+		   int *outputPos, int *inputPos, int mode)
+{
+  return translateUtf8 (handle, ctx, inbuf, inlen, outbuf, outlen,
+			outputPos, inputPos, mode, 0);
+}
+
+int EXPORT_CALL
+lou_backTranslateUtf8 (const louTable * handle, louContext * ctx,
+		       const char *inbuf, int *inlen, char *outbuf,
+		       int *outlen, int *outputPos, int *inputPos, int mode)
+{
+  return translateUtf8 (handle, ctx, inbuf, inlen, outbuf, outlen,
+			outputPos, inputPos, mode, 1);
+}
+
+int EXPORT_CALL
+lou_hyphenateUtf8 (const louTable * handle, const char *inbuf, int inlen,
+		   char *hyphens, int mode)
+{
+  widechar localChars[UTF8STRING];
+  int localStart[UTF8STRING + 1];
+  char localHyphens[UTF8STRING + 1];
+  widechar *chars;
+  int *charStart;
+  char *charHyphens;
+  int n, j, k, b;
+  int result = 0;
+  if (inbuf == NULL || inlen < 0 || hyphens == NULL)
+    return 0;
+  chars = localOrAllocated (localChars, UTF8STRING, inlen, CHARSIZE);
+  charStart = localOrAllocated (localStart, UTF8STRING + 1, inlen + 1,
+				sizeof (int));
+  charHyphens = localOrAllocated (localHyphens, UTF8STRING + 1, inlen + 1,
+				  1);
+  if ((n = decodeUtf8 ((const unsigned char *) inbuf, inlen, chars,
+		       charStart)) < 0
+      || !hyphenateWithTable (getTableFromHandle (handle), chars, n,
+			      charHyphens, mode))
+    goto done;
+  for (k = 0; k < n; k = j)
+    {
+      for (j = k + 1; j < n && charStart[j] == charStart[k]; j++);
+      hyphens[charStart[k]] = charHyphens[k];
+      for (b = charStart[k] + 1; b < charStart[j]; b++)
+	hyphens[b] = '0';
+    }
+  hyphens[inlen] = 0;
+  result = 1;
+done:
+  if (chars != localChars)
+    free (chars);
+  if (charStart != localStart)
+    free (charStart);
+  if (charHyphens != localHyphens)
+    free (charHyphens);
+  return result;
+}
+
+static void *
+allocateWithMalloc (int size, void *data)
+{
+  return malloc (size);
+}
+
+static int
+translateAlloc (const louTable * handle, louContext * ctx,
+		const widechar * inbuf, int inlen, widechar ** outbuf,
+		int *outlen, int *outputPos, int **inputPos, int *cursorPos,
+		int mode, louAllocator allocate, void *data, int backward)
+{
+/* The translation is made in buffers of the context large enough for 
+* any but an unusually long output, and is made again in larger ones 
+* only when it did not fit. A translation that fits leaves more than 
+* MAXSTRING places unused, more than any rule puts out at once. Some 
+* tables stop before the end of the input, or report more input 
+* consumed than they were given, and the translation is then taken as 
+* it is, as translateWithTable gives it. */
+  const TranslationTableHeader *table = getTableFromHandle (handle);
+  widechar *result;
+  int *resultPositions = NULL;
+  int length, size, n, m, attempts;
+  int cursor = -1;
+  if (table == NULL || inbuf == NULL || inlen < 0 || outbuf == NULL
+      || outlen == NULL)
+    return 0;
+  for (length = 0; length < inlen && inbuf[length]; length++);
+  size = 2 * length + 2 * MAXSTRING;
+  for (attempts = 0;; attempts++)
+    {
+      result = liblouis_allocMem (ctx, alloc_result, 0, size);
+      if (inputPos != NULL)
+	resultPositions = liblouis_allocMem (ctx, alloc_resultPositions, 0,
+					     size);
+      n = length;
+      m = size;
+      if (cursorPos != NULL)
+	cursor = *cursorPos;
+      if ((backward ? backTranslateWithTable (ctx, table, inbuf, &n, result,
+					       &m, NULL, NULL, outputPos,
+					       resultPositions,
+					       cursorPos ? &cursor : NULL,
+					       mode)
+	   : translateWithTable (ctx, table, inbuf, &n, result, &m, NULL,
+				 NULL, outputPos, resultPositions,
+				 cursorPos ? &cursor : NULL, NULL, NULL,
+				 mode)) && m < size - MAXSTRING)
+	break;
+      if (attempts == 4)
+	return 0;
+      size *= 2;
+    }
+  if (!allocate)
+    allocate = allocateWithMalloc;
+  if (!(*outbuf = allocate ((m + 1) * CHARSIZE, data)))
+    return 0;
+  memcpy (*outbuf, result, m * CHARSIZE);
+  (*outbuf)[m] = 0;
+  if (inputPos != NULL)
+    {
+      if (!(*inputPos = allocate ((m + 1) * sizeof (int), data)))
+	return 0;
+      memcpy (*inputPos, resultPositions, m * sizeof (int));
+    }
+  *outlen = m;
+  if (cursorPos != NULL)
+    *cursorPos = cursor;
+  return 1;
+}
+
+int EXPORT_CALL
+lou_translateAlloc (const louTable * handle, louContext * ctx,
+		    const widechar * inbuf, int inlen, widechar ** outbuf,
+		    int *outlen, int *outputPos, int **inputPos,
+		    int *cursorPos, int mode, louAllocator allocate,
+		    void *data)
+{
+  return translateAlloc (handle, ctx, inbuf, inlen, outbuf, outlen,
+			 outputPos, inputPos, cursorPos, mode, allocate, data,
+			 0);
+}
+
+int EXPORT_CALL
+lou_backTranslateAlloc (const louTable * handle, louContext * ctx,
+			const widechar * inbuf, int inlen, widechar ** outbuf,
+			int *outlen, int *outputPos, int **inputPos,
+			int *cursorPos, int mode, louAllocator allocate,
+			void *data)
+{
+  return translateAlloc (handle, ctx, inbuf, inlen, outbuf, outlen,
+			 outputPos, inputPos, cursorPos, mode, allocate, data,
+			 1);
+}
+
 int
 trace_translate (const char *tableList, const widechar * inbufx,
 		 int *inlen, widechar * outbuf, int *outlen,
@@ -72,208 +1746,355 @@ trace_translate (const char *tableList, const widechar * inbufx,
 		 const TranslationTableRule ** rules, int *rulesLen,
 		 int modex)
 {
-  int k;
-  int goodTrans = 1;
+  return translateWithContext (NULL, tableList, inbufx, inlen, outbuf,
+			       outlen, typeform, spacing, outputPos,
+			       inputPos, cursorPos, rules, rulesLen, modex);
+}
+
+static void
+initTranslationState (TranslationState * st)
+{
+  memset (st, 0, sizeof (*st));
+  st->currentPass = 1;
+  st->prevTypeform = plain_text;
+  st->prevType = plain_text;
+  st->curType = plain_text;
+  st->startType = -1;
+  st->wordStart = -1;
+  st->wordLimit = NOWORDLIMIT;
+}
+
+static int
+translateWithContext (louContext * ctx, const char *tableList,
+		      const widechar * inbufx, int *inlen, widechar * outbuf,
+		      int *outlen, formtype *typeform, char *spacing,
+		      int *outputPos, int *inputPos, int *cursorPos,
+		      const TranslationTableRule ** rules, int *rulesLen,
+		      int modex)
+{
+  const louTable *handle;
+  int rv;
   if (tableList == NULL || inbufx == NULL || inlen == NULL || outbuf ==
       NULL || outlen == NULL)
     return 0;
-  logMessage(LOG_DEBUG, "Performing translation: tableList=%s, inlen=%d", tableList, *inlen);
-  logWidecharBuf(LOG_DEBUG, "Inbuf=", inbufx, *inlen);
+  if (logEnabled(LOG_DEBUG))
+    logMessage(LOG_DEBUG, "Performing translation: tableList=%s, inlen=%d", tableList, *inlen);
   if ((modex & otherTrans))
     return other_translate (tableList, inbufx,
 			    inlen, outbuf, outlen,
 			    typeform, spacing, outputPos, inputPos, cursorPos,
 			    modex);
-  table = lou_getTable (tableList);
-  if (table == NULL || *inlen < 0 || *outlen < 0)
+  handle = lou_openTable (tableList);
+  rv = translateWithTable (ctx, getTableFromHandle (handle), inbufx, inlen,
+			   outbuf, outlen, typeform, spacing, outputPos,
+			   inputPos, cursorPos, rules, rulesLen, modex);
+  lou_closeTable (handle);
+  return rv;
+}
+
+static int
+markEmphasisSpans (unsigned short *typebuf, int length,
+		   const louEmphasisSpan * spans, int numSpans)
+{
+/*Set the emphasis of the runs in spans in typebuf, which is cleared. 
+* Returns whether anything is emphasized. */
+  int haveEmphasis = 0;
+  int k, j, end;
+  unsigned short emphasis;
+  for (k = 0; k < numSpans; k++)
+    {
+      if (!(emphasis = spans[k].emphasis & EMPHASIS))
+	continue;
+      end = spans[k].start + spans[k].length;
+      if (end > length)
+	end = length;
+      for (j = spans[k].start; j < end; j++)
+	typebuf[j] |= emphasis;
+      if (spans[k].start < end)
+	haveEmphasis = 1;
+    }
+  return haveEmphasis;
+}
+
+static int
+translateWithTable (louContext * ctx, const TranslationTableHeader * table,
+		    const widechar * inbufx, int *inlen, widechar * outbuf,
+		    int *outlen, formtype *typeform, char *spacing,
+		    int *outputPos, int *inputPos, int *cursorPos,
+		    const TranslationTableRule ** rules, int *rulesLen,
+		    int modex)
+{
+  return translateWithSpans (ctx, table, inbufx, inlen, outbuf, outlen,
+			     typeform, NULL, 0, spacing, outputPos, inputPos,
+			     cursorPos, rules, rulesLen, modex);
+}
+
+static int
+translateWithSpans (louContext * ctx, const TranslationTableHeader * table,
+		    const widechar * inbufx, int *inlen, widechar * outbuf,
+		    int *outlen, formtype *typeform,
+		    const louEmphasisSpan * spans, int numSpans,
+		    char *spacing, int *outputPos, int *inputPos,
+		    int *cursorPos, const TranslationTableRule ** rules,
+		    int *rulesLen, int modex)
+{
+  TranslationState state;
+  TranslationState *st = &state;
+  int k;
+  int needMapping;
+  int length;
+  int goodTrans = 1;
+  if (table == NULL || inbufx == NULL || inlen == NULL || outbuf == NULL
+      || outlen == NULL || *inlen < 0 || *outlen < 0)
     return 0;
-  currentInput = (widechar *) inbufx;
-  srcmax = 0;
-  while (srcmax < *inlen && currentInput[srcmax])
-    srcmax++;
-  destmax = *outlen;
-  haveEmphasis = 0;
-  if (!(typebuf = liblouis_allocMem (alloc_typebuf, srcmax, destmax)))
+  if (logEnabled(LOG_DEBUG))
+    logWidecharBuf(LOG_DEBUG, "Inbuf=", inbufx, *inlen);
+  traceEvent (louTraceStart, 0, 0, 0, *inlen, 0);
+  initTranslationState (st);
+  st->table = table;
+  startWork (ctx, &st->work);
+  if ((st->overlay = st->work.ctx->overlay)
+      && getTableFromHandle (st->overlay->table) != table)
+    st->overlay = NULL;
+  st->currentInput = (widechar *) inbufx;
+  st->srcmax = 0;
+  while (st->srcmax < *inlen && st->currentInput[st->srcmax])
+    st->srcmax++;
+  length = st->srcmax;
+  st->destmax = *outlen;
+  st->haveEmphasis = 0;
+  /* The emphasis is looked at one past the end of the input */
+  if (!(st->typebuf = liblouis_allocMem (ctx, alloc_typebuf, st->srcmax,
+					 st->destmax > st->srcmax ?
+					 st->destmax : st->srcmax + 1)))
     return 0;
+  st->typebuf[st->srcmax] = 0;
   if (typeform != NULL)
     {
-      for (k = 0; k < srcmax; k++)
-	if ((typebuf[k] = typeform[k] & EMPHASIS))
-	  haveEmphasis = 1;
+      for (k = 0; k < st->srcmax; k++)
+	if ((st->typebuf[k] = typeform[k] & EMPHASIS))
+	  st->haveEmphasis = 1;
+    }
+  else
+    {
+      memset (st->typebuf, 0, st->srcmax * sizeof (unsigned short));
+      if (spans != NULL)
+	st->haveEmphasis =
+	  markEmphasisSpans (st->typebuf, st->srcmax, spans, numSpans);
     }
-  else
-    memset (typebuf, 0, srcmax * sizeof (unsigned short));
   if (!(spacing == NULL || *spacing == 'X'))
-    srcSpacing = (unsigned char *) spacing;
-  outputPositions = outputPos;
+    st->srcSpacing = (unsigned char *) spacing;
+  st->outputPositions = outputPos;
   if (outputPos != NULL)
-    for (k = 0; k < srcmax; k++)
+    for (k = 0; k < st->srcmax; k++)
       outputPos[k] = -1;
-  inputPositions = inputPos;
-  mode = modex;
+  st->inputPositions = inputPos;
+  st->mode = modex;
   if (cursorPos != NULL && *cursorPos >= 0)
     {
-      cursorStatus = 0;
-      cursorPosition = *cursorPos;
-      if ((mode & (compbrlAtCursor | compbrlLeftCursor)))
+      st->cursorStatus = 0;
+      st->cursorPosition = *cursorPos;
+      if ((st->mode & (compbrlAtCursor | compbrlLeftCursor)))
 	{
-	  compbrlStart = cursorPosition;
-	  if (checkAttr (currentInput[compbrlStart], CTC_Space, 0))
-	    compbrlEnd = compbrlStart + 1;
+	  st->compbrlStart = st->cursorPosition;
+	  if (checkInputAttr (st, st->compbrlStart, CTC_Space))
+	    st->compbrlEnd = st->compbrlStart + 1;
 	  else
 	    {
-	      while (compbrlStart >= 0 && !checkAttr
-		     (currentInput[compbrlStart], CTC_Space, 0))
-		compbrlStart--;
-	      compbrlStart++;
-	      compbrlEnd = cursorPosition;
-	      if (!(mode & compbrlLeftCursor))
-		while (compbrlEnd < srcmax && !checkAttr
-		       (currentInput[compbrlEnd], CTC_Space, 0))
-		  compbrlEnd++;
+	      st->compbrlStart = previousInputAttr (st, st->compbrlStart, 0,
+						    CTC_Space, 1) + 1;
+	      st->compbrlEnd = st->cursorPosition;
+	      if (!(st->mode & compbrlLeftCursor))
+		st->compbrlEnd = nextInputAttr (st, st->compbrlEnd,
+						st->srcmax, CTC_Space, 1);
 	    }
 	}
     }
   else
     {
-      cursorPosition = -1;
-      cursorStatus = 1;		/*so it won't check cursor position */
+      st->cursorPosition = -1;
+      st->cursorStatus = 1;		/*so it won't check cursor position */
     }
-  if (!(passbuf1 = liblouis_allocMem (alloc_passbuf1, srcmax, destmax)))
+  if (!(st->passbuf1 = liblouis_allocMem (ctx, alloc_passbuf1, st->srcmax,
+					  st->destmax)))
     return 0;
-  if (!(srcMapping = liblouis_allocMem (alloc_srcMapping, srcmax, destmax)))
+  if (!(st->attributesBuffer =
+	liblouis_allocMem (ctx, alloc_inputAttributes, st->srcmax,
+			   st->destmax)))
     return 0;
-  if (!
-      (prevSrcMapping =
-       liblouis_allocMem (alloc_prevSrcMapping, srcmax, destmax)))
+  if (!(st->lowercaseBuffer =
+	liblouis_allocMem (ctx, alloc_inputLowercase, st->srcmax,
+			   st->destmax)))
     return 0;
-  for (k = 0; k <= srcmax; k++)
-    srcMapping[k] = k;
-  srcMapping[srcmax] = srcmax;
-  if ((!(mode & pass1Only)) && (table->numPasses > 1 || table->corrections))
+  /* The maps of input positions are kept only for the positions asked 
+   * for, and for the typeforms when there are corrections. They are 
+   * copied from pass to pass only for the positions, so both start out 
+   * as the identity */
+  needMapping = outputPos != NULL || inputPos != NULL;
+  if (needMapping || st->table->corrections)
+    {
+      if (!(st->srcMapping = liblouis_allocMem (ctx, alloc_srcMapping,
+						st->srcmax, st->destmax)))
+	return 0;
+      if (!(st->prevSrcMapping = liblouis_allocMem (ctx, alloc_prevSrcMapping,
+						    st->srcmax, st->destmax)))
+	return 0;
+      for (k = 0; k <= st->srcmax; k++)
+	st->srcMapping[k] = st->prevSrcMapping[k] = k;
+    }
+  if ((!(st->mode & pass1Only)) && (st->table->numPasses > 1
+				    || st->table->corrections))
     {
-      if (!(passbuf2 = liblouis_allocMem (alloc_passbuf2, srcmax, destmax)))
+      if (!(st->passbuf2 = liblouis_allocMem (ctx, alloc_passbuf2, st->srcmax,
+					      st->destmax)))
 	return 0;
     }
-  if (srcSpacing != NULL)
+  if (st->srcSpacing != NULL)
     {
-      if (!(destSpacing = liblouis_allocMem (alloc_destSpacing, srcmax,
-					     destmax)))
+      if (!(st->destSpacing = liblouis_allocMem (ctx, alloc_destSpacing,
+						 st->srcmax,
+					     st->destmax)))
 	goodTrans = 0;
       else
-	memset (destSpacing, '*', destmax);
+	memset (st->destSpacing, '*', st->destmax);
     }
-  appliedRulesCount = 0;
+  st->appliedRulesCount = 0;
   if (rules != NULL && rulesLen != NULL)
     {
-      appliedRules = rules;
-      maxAppliedRules = *rulesLen;
+      st->appliedRules = rules;
+      st->maxAppliedRules = *rulesLen;
     }
   else
     {
-      appliedRules = NULL;
-      maxAppliedRules = 0;
+      st->appliedRules = NULL;
+      st->maxAppliedRules = 0;
     }
-  currentPass = 0;
-  if ((mode & pass1Only))
+  st->ruleProfile = getRuleProfile (table);
+  memset (st->profileTimes, 0, sizeof (st->profileTimes));
+  /* Remembered words leave out the bookkeeping these need */
+  if (st->appliedRules == NULL && st->ruleProfile == NULL
+      && st->srcSpacing == NULL
+      && outputPos == NULL && inputPos == NULL && !st->haveEmphasis
+      && st->cursorStatus == 1 && st->table->forRuleTrie && !st->overlay
+      && !(st->mode & (compbrlAtCursor | compbrlLeftCursor)))
+    st->wordCache = getWordCache (ctx);
+  st->currentPass = 0;
+  if ((st->mode & pass1Only))
     {
-      currentOutput = passbuf1;
-      memcpy (prevSrcMapping, srcMapping, destmax * sizeof (int));
-      goodTrans = translateString ();
-      currentPass = 5;		/*Certainly > table->numPasses */
+      st->currentOutput = st->passbuf1;
+      goodTrans = translateString (st);
+      st->currentPass = 5;		/*Certainly > table->numPasses */
     }
-  while (currentPass <= table->numPasses && goodTrans)
+  while (st->currentPass <= st->table->numPasses && goodTrans)
     {
-      memcpy (prevSrcMapping, srcMapping, destmax * sizeof (int));
-      switch (currentPass)
+      switch (st->currentPass)
 	{
 	case 0:
-	  if (table->corrections)
+	  if (st->table->corrections && passCanApply (st))
 	    {
-	      currentOutput = passbuf2;
-	      goodTrans = makeCorrections ();
-	      currentInput = passbuf2;
-	      srcmax = dest;
+	      if (needMapping)
+		memcpy (st->prevSrcMapping, st->srcMapping,
+			(st->srcmax + 1) * sizeof (int));
+	      st->currentOutput = st->passbuf2;
+	      goodTrans = makeCorrections (st);
+	      st->currentInput = st->passbuf2;
+	      st->srcmax = st->dest;
 	    }
 	  break;
 	case 1:
-	  currentOutput = passbuf1;
-	  goodTrans = translateString ();
+	  if (needMapping)
+	    memcpy (st->prevSrcMapping, st->srcMapping,
+		    (st->srcmax + 1) * sizeof (int));
+	  st->currentOutput = st->passbuf1;
+	  goodTrans = translateString (st);
 	  break;
 	case 2:
-	  srcmax = dest;
-	  currentInput = passbuf1;
-	  currentOutput = passbuf2;
-	  goodTrans = translatePass ();
-	  break;
 	case 3:
-	  srcmax = dest;
-	  currentInput = passbuf2;
-	  currentOutput = passbuf1;
-	  goodTrans = translatePass ();
-	  break;
 	case 4:
-	  srcmax = dest;
-	  currentInput = passbuf1;
-	  currentOutput = passbuf2;
-	  goodTrans = translatePass ();
+	  /* A pass none of whose rules can match would copy its input */
+	  st->srcmax = st->dest;
+	  st->currentInput = st->currentOutput;
+	  if (!passCanApply (st))
+	    break;
+	  if (needMapping)
+	    memcpy (st->prevSrcMapping, st->srcMapping,
+		    (st->srcmax + 1) * sizeof (int));
+	  if (st->currentInput == st->passbuf1)
+	    st->currentOutput = st->passbuf2;
+	  else
+	    st->currentOutput = st->passbuf1;
+	  goodTrans = translatePass (st);
 	  break;
 	default:
 	  break;
 	}
-      currentPass++;
+      st->currentPass++;
     }
   if (goodTrans)
     {
-      for (k = 0; k < dest; k++)
+      if (typeform != NULL)
 	{
-	  if (typeform != NULL)
+	  for (k = 0; k < st->dest; k++)
 	    {
-	      if ((currentOutput[k] & (B7 | B8)))
+	      if ((st->currentOutput[k] & (B7 | B8)))
 		typeform[k] = '8';
 	      else
 		typeform[k] = '0';
 	    }
-	  if ((mode & dotsIO))
-	    {
-	      if ((mode & ucBrl))
-		outbuf[k] = ((currentOutput[k] & 0xff) | 0x2800);
-	      else
-		outbuf[k] = currentOutput[k];
-	    }
-	  else
-	    outbuf[k] = getCharFromDots (currentOutput[k]);
 	}
-      *inlen = realInlen;
-      *outlen = dest;
-      if (inputPositions != NULL)
-	memcpy (inputPositions, srcMapping, dest * sizeof (int));
+      /* Put the cells out in the encoding asked for in one go */
+      if (!(st->mode & dotsIO))
+	getCharsFromDotsInTable (st->table, st->currentOutput, outbuf,
+				 st->dest);
+      else if ((st->mode & ucBrl))
+	for (k = 0; k < st->dest; k++)
+	  outbuf[k] = (st->currentOutput[k] & 0xff) | 0x2800;
+      else
+	memcpy (outbuf, st->currentOutput, st->dest * CHARSIZE);
+      *inlen = st->realInlen;
+      *outlen = st->dest;
+      if (st->inputPositions != NULL)
+	memcpy (st->inputPositions, st->srcMapping, st->dest * sizeof (int));
       if (outputPos != NULL)
 	{
+	  /* A table can report more input than it was given, but 
+	   * outputPos only has room for srcmax */
 	  int lastpos = 0;
-	  for (k = 0; k < *inlen; k++)
+	  for (k = 0; k < *inlen && k < st->srcmax; k++)
 	    if (outputPos[k] == -1)
 	      outputPos[k] = lastpos;
 	    else
 	      lastpos = outputPos[k];
 	}
     }
-  if (destSpacing != NULL)
+  if (st->destSpacing != NULL)
     {
-      memcpy (srcSpacing, destSpacing, srcmax);
-      srcSpacing[srcmax] = 0;
+      memcpy (st->srcSpacing, st->destSpacing, st->srcmax);
+      st->srcSpacing[st->srcmax] = 0;
     }
   if (cursorPos != NULL && *cursorPos != -1)
     {
       if (outputPos != NULL)
 	*cursorPos = outputPos[*cursorPos];
       else
-	*cursorPos = cursorPosition;
+	*cursorPos = st->cursorPosition;
     }
   if (rulesLen != NULL)
-    *rulesLen = appliedRulesCount;
-  logMessage(LOG_DEBUG, "Translation complete: outlen=%d", *outlen);
-  logWidecharBuf(LOG_DEBUG, "Outbuf=", (const widechar *)outbuf, *outlen);
+    *rulesLen = st->appliedRulesCount;
+  if (st->ruleProfile)
+    addRuleProfileTimes (st->ruleProfile, st->profileTimes);
+  endWork (&st->work);
+  countTranslation (0, length, goodTrans ? *inlen : length,
+		    st->work.status);
+  if (st->work.status != louWorkDone)
+    goodTrans = 0;
+  shrinkScratch (ctx);
+  traceEvent (louTraceEnd, 0, 0, goodTrans, st->src, st->dest);
+  if (logEnabled(LOG_DEBUG))
+    {
+      logMessage(LOG_DEBUG, "Translation complete: outlen=%d", *outlen);
+      logWidecharBuf(LOG_DEBUG, "Outbuf=", (const widechar *)outbuf, *outlen);
+    }
   return goodTrans;
 }
 
@@ -327,35 +2148,58 @@ lou_translatePrehyphenated (const char *tableList,
   return rv;
 }
 
-static TranslationTableOpcode indicOpcode;
-static const TranslationTableRule *indicRule;
-static int dontContract = 0;
+int EXPORT_CALL
+lou_translateHyphenated (const char *tableList,
+			 const widechar * inbuf, int *inlen,
+			 widechar * outbuf, int *outlen,
+			 formtype *typeform, char *spacing,
+			 int *outputPos, int *inputPos, int *cursorPos,
+			 char *outputHyphens, int mode)
+{
+/* Hyphenate the characters and carry the hyphens over to the cells 
+* in the same translation */
+  char localHyphens[MAXSTRING];
+  char *inputHyphens = localHyphens;
+  const louTable *handle;
+  int rv;
+  if (inbuf == NULL || inlen == NULL || outputHyphens == NULL || *inlen < 0)
+    return 0;
+  if (*inlen + 1 > MAXSTRING
+      && !(inputHyphens = (char *) malloc (*inlen + 1)))
+    outOfMemory ();
+  handle = lou_openTable (tableList);
+  rv = hyphenateTextWithTable (getTableFromHandle (handle), inbuf, *inlen,
+			       inputHyphens);
+  lou_closeTable (handle);
+  rv = rv && lou_translatePrehyphenated (tableList, inbuf, inlen, outbuf, outlen,
+				   typeform, spacing, outputPos, inputPos,
+				   cursorPos, inputHyphens, outputHyphens,
+				   mode);
+  if (inputHyphens != localHyphens)
+    free (inputHyphens);
+  return rv;
+}
 
-static int
-hyphenate (const widechar * word, int wordSize, char *hyphens)
+static void
+hyphenateWord (const TranslationTableHeader * table,
+	       const widechar * prepWord, int wordSize, char *hyphens)
 {
-  widechar *prepWord;
+/* Run the hyphenation state machine over prepWord, which holds the
+* wordSize lowercase letters of a word between two periods, and set
+* hyphens[0] to hyphens[wordSize - 1] */
   int i, k, limit;
-  int stateNum;
+  int low, high, middle;
+  TranslationTableOffset stateNum;
   widechar ch;
   HyphenationState *statesArray = (HyphenationState *)
     & table->ruleArea[table->hyphenStatesArray];
   HyphenationState *currentState;
   HyphenationTrans *transitionsArray;
-  char *hyphenPattern;
+  unsigned char *hyphenPattern;
+  int patternLength;
   int patternOffset;
-  if (!table->hyphenStatesArray || (wordSize + 3) > MAXSTRING)
-    return 0;
-  prepWord = (widechar *) calloc (wordSize + 3, sizeof (widechar));
-  /* prepWord is of the format ".hello."
-   * hyphens is the length of the word "hello" "00000" */
-  prepWord[0] = '.';
   for (i = 0; i < wordSize; i++)
-    {
-      prepWord[i + 1] = (findCharOrDots (word[i], 0))->lowercase;
-      hyphens[i] = '0';
-    }
-  prepWord[wordSize + 1] = '.';
+    hyphens[i] = '0';
 
   /* now, run the finite state machine */
   stateNum = 0;
@@ -366,25 +2210,32 @@ hyphenate (const widechar * word, int wordSize, char *hyphens)
       ch = prepWord[i];
       while (1)
 	{
-	  if (stateNum == 0xffff)
-	    {
-	      stateNum = 0;
-	      goto nextLetter;
-	    }
 	  currentState = &statesArray[stateNum];
 	  if (currentState->trans.offset)
 	    {
+	      /* the transitions are sorted by character. Only long lists
+	       * are bisected, scanning a few dozen up to ch is quicker */
 	      transitionsArray = (HyphenationTrans *) &
 		table->ruleArea[currentState->trans.offset];
-	      for (k = 0; k < currentState->numTrans; k++)
+	      low = 0;
+	      high = currentState->numTrans;
+	      while (high - low > 64)
 		{
-		  if (transitionsArray[k].ch == ch)
-		    {
-		      stateNum = transitionsArray[k].newState;
-		      goto stateFound;
-		    }
+		  middle = (low + high) / 2;
+		  if (transitionsArray[middle].ch < ch)
+		    low = middle + 1;
+		  else
+		    high = middle + 1;
 		}
+	      for (; low < high && transitionsArray[low].ch <= ch; low++)
+		if (transitionsArray[low].ch == ch)
+		  {
+		    stateNum = transitionsArray[low].newState;
+		    goto stateFound;
+		  }
 	    }
+	  if (!stateNum)
+	    goto nextLetter;
 	  stateNum = currentState->fallbackState;
 	}
     stateFound:
@@ -392,14 +2243,15 @@ hyphenate (const widechar * word, int wordSize, char *hyphens)
       if (currentState->hyphenPattern)
 	{
 	  hyphenPattern =
-	    (char *) &table->ruleArea[currentState->hyphenPattern];
-	  patternOffset = i + 1 - strlen (hyphenPattern);
+	    (unsigned char *) &table->ruleArea[currentState->hyphenPattern];
+	  patternLength = *hyphenPattern++;
+	  patternOffset = i + 1 - patternLength;
 
 	  /* Need to ensure that we don't overrun hyphens,
 	   * in some cases hyphenPattern is longer than the remaining letters,
 	   * and if we write out all of it we would have overshot our buffer. */
-	  limit = MIN (strlen (hyphenPattern), wordSize - patternOffset);
-	  for (k = 0; k < limit; k++)
+	  limit = MIN (patternLength, wordSize - patternOffset);
+	  for (k = MAX (0, -patternOffset); k < limit; k++)
 	    {
 	      if (hyphens[patternOffset + k] < hyphenPattern[k])
 		hyphens[patternOffset + k] = hyphenPattern[k];
@@ -407,168 +2259,191 @@ hyphenate (const widechar * word, int wordSize, char *hyphens)
 	}
     nextLetter:;
     }
+}
+
+static int
+hyphenate (TranslationState *st, const widechar * word, int wordSize,
+	   char *hyphens)
+{
+  widechar prepWord[MAXSTRING];
+  int i;
+  if (st->table->lazyHyphenation)
+    st->table = completeTable (st->table, LOU_LAZY_HYPHENATION);
+  if (!st->table->hyphenStatesArray || (wordSize + 3) > MAXSTRING)
+    return 0;
+  /* prepWord is of the format ".hello."
+   * hyphens is the length of the word "hello" "00000" */
+  prepWord[0] = '.';
+  for (i = 0; i < wordSize; i++)
+    prepWord[i + 1] = (findCharOrDots (st, word[i], 0))->lowercase;
+  prepWord[wordSize + 1] = '.';
+  hyphenateWord (st->table, prepWord, wordSize, hyphens);
   hyphens[wordSize] = 0;
-  free (prepWord);
   return 1;
 }
 
-static int destword;
-static int srcword;
-static int doCompTrans (int start, int end);
+static int doCompTrans (TranslationState *st, int start, int end);
 
 static int
-for_updatePositions (const widechar * outChars, int inLength, int outLength)
+for_updatePositions (TranslationState *st, const widechar * outChars,
+		     int inLength, int outLength)
 {
   int k;
-  if ((dest + outLength) > destmax || (src + inLength) > srcmax)
+  if ((st->dest + outLength) > st->destmax
+      || (st->src + inLength) > st->srcmax)
     return 0;
-  memcpy (&currentOutput[dest], outChars, outLength * CHARSIZE);
-  if (!cursorStatus)
+  memcpy (&st->currentOutput[st->dest], outChars, outLength * CHARSIZE);
+  if (!st->cursorStatus)
     {
-      if ((mode & (compbrlAtCursor | compbrlLeftCursor)))
+      if ((st->mode & (compbrlAtCursor | compbrlLeftCursor)))
 	{
-	  if (src >= compbrlStart)
+	  if (st->src >= st->compbrlStart)
 	    {
-	      cursorStatus = 2;
-	      return (doCompTrans (compbrlStart, compbrlEnd));
+	      st->cursorStatus = 2;
+	      return (doCompTrans (st, st->compbrlStart, st->compbrlEnd));
 	    }
 	}
-      else if (cursorPosition >= src && cursorPosition < (src + inLength))
+      else if (st->cursorPosition >= st->src
+	       && st->cursorPosition < (st->src + inLength))
 	{
-	  cursorPosition = dest;
-	  cursorStatus = 1;
+	  st->cursorPosition = st->dest;
+	  st->cursorStatus = 1;
 	}
-      else if (currentInput[cursorPosition] == 0 &&
-	       cursorPosition == (src + inLength))
+      else if (st->currentInput[st->cursorPosition] == 0 &&
+	       st->cursorPosition == (st->src + inLength))
 	{
-	  cursorPosition = dest + outLength / 2 + 1;
-	  cursorStatus = 1;
+	  st->cursorPosition = st->dest + outLength / 2 + 1;
+	  st->cursorStatus = 1;
 	}
     }
-  else if (cursorStatus == 2 && cursorPosition == src)
-    cursorPosition = dest;
-  if (inputPositions != NULL || outputPositions != NULL)
+  else if (st->cursorStatus == 2 && st->cursorPosition == st->src)
+    st->cursorPosition = st->dest;
+  if (st->inputPositions != NULL || st->outputPositions != NULL)
     {
       if (outLength <= inLength)
 	{
 	  for (k = 0; k < outLength; k++)
 	    {
-	      if (inputPositions != NULL)
-		srcMapping[dest + k] = prevSrcMapping[src];
-	      if (outputPositions != NULL)
-		outputPositions[prevSrcMapping[src + k]] = dest;
+	      if (st->inputPositions != NULL)
+		st->srcMapping[st->dest + k] = st->prevSrcMapping[st->src];
+	      if (st->outputPositions != NULL)
+		st->outputPositions[st->prevSrcMapping[st->src + k]] = st->dest;
 	    }
 	  for (k = outLength; k < inLength; k++)
-	    if (outputPositions != NULL)
-	      outputPositions[prevSrcMapping[src + k]] = dest;
+	    if (st->outputPositions != NULL)
+	      st->outputPositions[st->prevSrcMapping[st->src + k]] = st->dest;
 	}
       else
 	{
 	  for (k = 0; k < inLength; k++)
 	    {
-	      if (inputPositions != NULL)
-		srcMapping[dest + k] = prevSrcMapping[src];
-	      if (outputPositions != NULL)
-		outputPositions[prevSrcMapping[src + k]] = dest;
+	      if (st->inputPositions != NULL)
+		st->srcMapping[st->dest + k] = st->prevSrcMapping[st->src];
+	      if (st->outputPositions != NULL)
+		st->outputPositions[st->prevSrcMapping[st->src + k]] = st->dest;
 	    }
 	  for (k = inLength; k < outLength; k++)
-	    if (inputPositions != NULL)
-	      srcMapping[dest + k] = prevSrcMapping[src];
+	    if (st->inputPositions != NULL)
+	      st->srcMapping[st->dest + k] = st->prevSrcMapping[st->src];
 	}
     }
-  dest += outLength;
+  st->dest += outLength;
   return 1;
 }
 
 static int
-syllableBreak ()
+syllableBreak (TranslationState *st)
 {
+/* Whether the rule at src would cross a hyphenation point. The word 
+* is hyphenated once, when the first nocross rule is tried in it. */
   int wordStart = 0;
   int wordEnd = 0;
   int wordSize = 0;
   int k = 0;
-  char *hyphens = NULL;
-  for (wordStart = src; wordStart >= 0; wordStart--)
-    if (!((findCharOrDots (currentInput[wordStart], 0))->attributes &
-	  CTC_Letter))
-      {
-	wordStart++;
-	break;
-      }
-  if (wordStart < 0)
-    wordStart = 0;
-  for (wordEnd = src; wordEnd < srcmax; wordEnd++)
-    if (!((findCharOrDots (currentInput[wordEnd], 0))->attributes &
-	  CTC_Letter))
-      {
-	wordEnd--;
-	break;
-      }
-  if (wordEnd == srcmax)
-    wordEnd--;
-  /* At this stage wordStart is the 0 based index of the first letter in the word,
-   * wordEnd is the 0 based index of the last letter in the word.
-   * example: "hello" wordstart=0, wordEnd=4. */
-  wordSize = wordEnd - wordStart + 1;
-  hyphens = (char *) calloc (wordSize + 1, sizeof (char));
-  if (!hyphenate (&currentInput[wordStart], wordSize, hyphens))
-    {
-      free (hyphens);
-      return 0;
+  if (st->hyphenInput != st->currentInput || st->src < st->hyphenStart
+      || st->src > st->hyphenEnd)
+    {
+      wordStart = previousInputAttr (st, st->src, 0, CTC_Letter, 0) + 1;
+      wordEnd = nextInputAttr (st, st->src, st->srcmax, CTC_Letter, 0) - 1;
+      /* At this stage wordStart is the 0 based index of the first letter in the word,
+       * wordEnd is the 0 based index of the last letter in the word.
+       * example: "hello" wordstart=0, wordEnd=4. */
+      wordSize = wordEnd - wordStart + 1;
+      if (wordSize <= 0)
+	return 0;
+      if (st->hyphens == NULL
+	  && !(st->hyphens = liblouis_allocMem (st->work.ctx, alloc_hyphens,
+						st->srcmax, st->destmax)))
+	return 0;
+      memset (st->hyphens, 0, wordSize + 1);
+      st->hyphenResult = hyphenate (st, &st->currentInput[wordStart],
+				    wordSize, st->hyphens);
+      st->hyphenInput = st->currentInput;
+      st->hyphenStart = wordStart;
+      st->hyphenEnd = wordEnd;
     }
-  for (k = src - wordStart + 1; k < (src - wordStart + transCharslen); k++)
-    if (hyphens[k] & 1)
-      {
-	free (hyphens);
-	return 1;
-      }
-  free (hyphens);
+  if (!st->hyphenResult)
+    return 0;
+  wordStart = st->hyphenStart;
+  wordSize = st->hyphenEnd - wordStart + 1;
+  for (k = st->src - wordStart + 1; k < (st->src - wordStart + st->transCharslen)
+       && k < wordSize; k++)
+    if (st->hyphens[k] & 1)
+      return 1;
   return 0;
 }
 
-static TranslationTableCharacter *curCharDef;
-static widechar before, after;
-static TranslationTableCharacterAttributes beforeAttributes;
-static TranslationTableCharacterAttributes afterAttributes;
 static void
-setBefore ()
+setBefore (TranslationState *st)
 {
-  if (src >= 2 && currentInput[src - 1] == ENDSEGMENT)
-    before = currentInput[src - 2];
+  int before;
+  if (st->src >= 2 && st->currentInput[st->src - 1] == ENDSEGMENT)
+    before = st->src - 2;
+  else
+    before = st->src - 1;
+  if (before < 0)
+    {
+      st->before = ' ';
+      st->beforeAttributes = (findCharOrDots (st, ' ', 0))->attributes;
+    }
   else
-    before = (src == 0) ? ' ' : currentInput[src - 1];
-  beforeAttributes = (findCharOrDots (before, 0))->attributes;
+    {
+      st->before = st->currentInput[before];
+      st->beforeAttributes = inputAttributes (st, before);
+    }
 }
 
 static void
-setAfter (int length)
+setAfter (TranslationState *st, int length)
 {
-  if ((src + length + 2) < srcmax && currentInput[src + 1] == ENDSEGMENT)
-    after = currentInput[src + 2];
+  int after;
+  if ((st->src + length + 2) < st->srcmax
+      && st->currentInput[st->src + 1] == ENDSEGMENT)
+    after = st->src + 2;
+  else
+    after = st->src + length;
+  if (after >= st->srcmax)
+    {
+      st->after = ' ';
+      st->afterAttributes = (findCharOrDots (st, ' ', 0))->attributes;
+    }
   else
-    after = (src + length < srcmax) ? currentInput[src + length] : ' ';
-  afterAttributes = (findCharOrDots (after, 0))->attributes;
+    {
+      st->after = st->currentInput[after];
+      st->afterAttributes = inputAttributes (st, after);
+    }
 }
 
-static int prevTypeform = plain_text;
-static int prevSrc = 0;
-static TranslationTableRule pseudoRule = {
-  0
-};
-
 static int
-brailleIndicatorDefined (TranslationTableOffset offset)
+brailleIndicatorDefined (TranslationState *st, TranslationTableOffset offset)
 {
   if (!offset)
     return 0;
-  indicRule = (TranslationTableRule *) & table->ruleArea[offset];
-  indicOpcode = indicRule->opcode;
+  st->indicRule = (TranslationTableRule *) & st->table->ruleArea[offset];
+  st->indicOpcode = st->indicRule->opcode;
   return 1;
 }
 
-static int prevType = plain_text;
-static int curType = plain_text;
-
 typedef enum
 {
   firstWord,
@@ -581,82 +2456,78 @@ typedef enum
   lenPhrase
 } emphCodes;
 
-static int wordsMarked = 0;
-static int finishEmphasis = 0;
-static int wordCount = 0;
-static int lastWord = 0;
-static int startType = -1;
-static int endType = 0;
-
 static void
-markWords (const TranslationTableOffset * offset)
+markWords (TranslationState *st, const TranslationTableOffset * offset)
 {
 /*Mark the beginnings of words*/
   int numWords = 0;
   int k;
-  wordsMarked = 1;
+  st->wordsMarked = 1;
   numWords = offset[lenPhrase];
   if (!numWords)
     numWords = 4;
-  if (wordCount < numWords)
+  if (st->wordCount < numWords)
     {
-      for (k = src; k < endType; k++)
-	if (!checkAttr (currentInput[k - 1], CTC_Letter | CTC_Digit, 0) &&
-	    checkAttr (currentInput[k], CTC_Digit | CTC_Letter, 0))
-	  typebuf[k] |= STARTWORD;
+      for (k = st->src; k < st->endType; k++)
+	if (!checkInputAttr (st, k - 1, CTC_Letter | CTC_Digit) &&
+	    checkInputAttr (st, k, CTC_Digit | CTC_Letter))
+	  st->typebuf[k] |= STARTWORD;
     }
   else
     {
       int firstWord = 1;
-      int lastWord = src;
-      for (k = src; k < endType; k++)
+      int lastWord = st->src;
+      for (k = st->src; k < st->endType; k++)
 	{
-	  if (!checkAttr (currentInput[k - 1], CTC_Letter | CTC_Digit, 0)
-	      && checkAttr (currentInput[k], CTC_Digit | CTC_Letter, 0))
+	  if (!checkInputAttr (st, k - 1, CTC_Letter | CTC_Digit)
+	      && checkInputAttr (st, k, CTC_Digit | CTC_Letter))
 	    {
 	      if (firstWord)
 		{
-		  typebuf[k] |= FIRSTWORD;
+		  st->typebuf[k] |= FIRSTWORD;
 		  firstWord = 0;
 		}
 	      else
 		lastWord = k;
 	    }
 	}
-      typebuf[lastWord] |= STARTWORD;
+      st->typebuf[lastWord] |= STARTWORD;
     }
 }
 
 static int
-insertIndicators ()
+insertIndicators (TranslationState *st)
 {
 /*Insert italic, bold, etc. indicators before words*/
   int typeMark;
   int ruleFound = 0;
-  if (!wordsMarked || !haveEmphasis)
+  if (!st->wordsMarked || !st->haveEmphasis)
     return 1;
-  typeMark = typebuf[src] & (STARTWORD | FIRSTWORD);
+  typeMark = st->typebuf[st->src] & (STARTWORD | FIRSTWORD);
   if (!typeMark)
     return 1;
-  switch (typebuf[src] & EMPHASIS)
+  switch (st->typebuf[st->src] & EMPHASIS)
     {
     case italic:
       if ((typeMark & FIRSTWORD))
-	ruleFound = brailleIndicatorDefined (table->firstWordItal);
+	ruleFound = brailleIndicatorDefined (st, st->table->firstWordItal);
       else
-	ruleFound = brailleIndicatorDefined (table->lastWordItalBefore);
+	ruleFound = brailleIndicatorDefined (st,
+					     st->table->lastWordItalBefore);
       break;
     case bold:
       if ((typeMark & FIRSTWORD))
-	ruleFound = brailleIndicatorDefined (table->firstWordBold);
+	ruleFound = brailleIndicatorDefined (st, st->table->firstWordBold);
       else
-	ruleFound = brailleIndicatorDefined (table->lastWordBoldBefore);
+	ruleFound = brailleIndicatorDefined (st,
+					     st->table->lastWordBoldBefore);
       break;
     case underline:
       if ((typeMark & FIRSTWORD))
-	ruleFound = brailleIndicatorDefined (table->firstWordUnder);
+	ruleFound = brailleIndicatorDefined (st, st->table->firstWordUnder);
       else
-	ruleFound = brailleIndicatorDefined (table->lastWordUnderBefore);
+	ruleFound = brailleIndicatorDefined (st,
+					     st->table->lastWordUnderBefore);
       break;
     default:
       ruleFound = 0;
@@ -665,140 +2536,133 @@ insertIndicators ()
   if (ruleFound)
     {
       if (!for_updatePositions
-	  (&indicRule->charsdots[0], 0, indicRule->dotslen))
+	  (st, &st->indicRule->charsdots[0], 0, st->indicRule->dotslen))
 	return 0;
     }
   return 1;
 }
 
 static int
-validMatch ()
+validMatch (TranslationState *st, int lowercaseMatched)
 {
-/*Analyze the typeform parameter and also check for capitalization*/
-  TranslationTableCharacter *currentInputChar;
-  TranslationTableCharacter *ruleChar;
+/*Analyze the typeform parameter and also check for capitalization. If 
+* lowercaseMatched is set the characters are already known to match. */
+  TranslationTableCharacterAttributes attr;
   TranslationTableCharacterAttributes prevAttr = 0;
   int k;
-  int kk = 0;
-  if (!transCharslen)
+  if (!st->transCharslen)
     return 0;
-  for (k = src; k < src + transCharslen; k++)
+  if (!lowercaseMatched && !matchRuleLowercase (st, st->transRule, st->src))
+    return 0;
+  for (k = st->src; k < st->src + st->transCharslen; k++)
     {
-      if (currentInput[k] == ENDSEGMENT)
+      if (st->currentInput[k] == ENDSEGMENT)
 	{
-	  if (k == src && transCharslen == 1)
+	  if (k == st->src && st->transCharslen == 1)
 	    return 1;
 	  else
 	    return 0;
 	}
-      currentInputChar = findCharOrDots (currentInput[k], 0);
-      if (k == src)
-	prevAttr = currentInputChar->attributes;
-      ruleChar = findCharOrDots (transRule->charsdots[kk++], 0);
-      if ((currentInputChar->lowercase != ruleChar->lowercase))
-	return 0;
-      if (typebuf != NULL && (typebuf[src] & capsemph) == 0 &&
-	  (typebuf[k] | typebuf[src]) != (typebuf[src]))
+      attr = inputAttributes (st, k);
+      if (k == st->src)
+	prevAttr = attr;
+      if (st->typebuf != NULL && (st->typebuf[st->src] & capsemph) == 0 &&
+	  (st->typebuf[k] | st->typebuf[st->src]) != (st->typebuf[st->src]))
 	return 0;
-      if (currentInputChar->attributes != CTC_Letter)
+      if (attr != CTC_Letter)
 	{
-	  if (k != (src + 1) && (prevAttr &
+	  if (k != (st->src + 1) && (prevAttr &
 				 CTC_Letter)
-	      && (currentInputChar->attributes & CTC_Letter)
+	      && (attr & CTC_Letter)
 	      &&
-	      ((currentInputChar->
-		attributes & (CTC_LowerCase | CTC_UpperCase |
+	      ((attr & (CTC_LowerCase | CTC_UpperCase |
 			      CTC_Letter)) !=
 	       (prevAttr & (CTC_LowerCase | CTC_UpperCase | CTC_Letter))))
 	    return 0;
 	}
-      prevAttr = currentInputChar->attributes;
+      prevAttr = attr;
     }
   return 1;
 }
 
 static int
-checkMultCaps ()
+checkMultCaps (TranslationState *st)
 {
   int k;
-  for (k = 0; k < table->lenBeginCaps; k++)
-    if (k >= srcmax - src ||
-	!checkAttr (currentInput[src + k], CTC_UpperCase, 0))
+  for (k = 0; k < st->table->lenBeginCaps; k++)
+    if (k >= st->srcmax - st->src ||
+	!checkInputAttr (st, st->src + k, CTC_UpperCase))
       return 0;
   return 1;
 }
 
-static int prevPrevType = 0;
-static int nextType = 0;
-static TranslationTableCharacterAttributes prevPrevAttr = 0;
 
 static int
-beginEmphasis (const TranslationTableOffset * offset)
+beginEmphasis (TranslationState *st, const TranslationTableOffset * offset)
 {
-  if (src != startType)
+  if (st->src != st->startType)
     {
-      wordCount = finishEmphasis = wordsMarked = 0;
-      startType = lastWord = src;
-      for (endType = src; endType < srcmax; endType++)
+      st->wordCount = st->finishEmphasis = st->wordsMarked = 0;
+      st->startType = st->lastWord = st->src;
+      for (st->endType = st->src; st->endType < st->srcmax; st->endType++)
 	{
-	  if ((typebuf[endType] & EMPHASIS) != curType)
+	  if ((st->typebuf[st->endType] & EMPHASIS) != st->curType)
 	    break;
-	  if (checkAttr (currentInput[endType - 1], CTC_Space, 0)
-	      && !checkAttr (currentInput[endType], CTC_Space, 0))
+	  if (checkInputAttr (st, st->endType - 1, CTC_Space)
+	      && !checkInputAttr (st, st->endType, CTC_Space))
 	    {
-	      lastWord = endType;
-	      wordCount++;
+	      st->lastWord = st->endType;
+	      st->wordCount++;
 	    }
 	}
     }
-  if ((beforeAttributes & CTC_Letter) && (endType - startType) ==
-      1 && brailleIndicatorDefined (offset[singleLetter]))
+  if ((st->beforeAttributes & CTC_Letter) && (st->endType - st->startType) ==
+      1 && brailleIndicatorDefined (st, offset[singleLetter]))
     return 1;
   else
-    if ((beforeAttributes & CTC_Letter) && brailleIndicatorDefined
-	(offset[firstLetter]))
+    if ((st->beforeAttributes & CTC_Letter) && brailleIndicatorDefined
+	(st, offset[firstLetter]))
     return 1;
-  else if (brailleIndicatorDefined (offset[lastWordBefore]))
+  else if (brailleIndicatorDefined (st, offset[lastWordBefore]))
     {
-      markWords (offset);
+      markWords (st, offset);
       return 0;
     }
   else
-    return (brailleIndicatorDefined (offset[firstWord]));
+    return (brailleIndicatorDefined (st, offset[firstWord]));
   return 0;
 }
 
 static int
-endEmphasis (const TranslationTableOffset * offset)
+endEmphasis (TranslationState *st, const TranslationTableOffset * offset)
 {
-  if (wordsMarked)
+  if (st->wordsMarked)
     return 0;
-  if (prevPrevType != prevType && nextType != prevType &&
-      brailleIndicatorDefined (offset[singleLetter]))
+  if (st->prevPrevType != st->prevType && st->nextType != st->prevType &&
+      brailleIndicatorDefined (st, offset[singleLetter]))
     return 0;
   else
-    if ((finishEmphasis || src == srcmax - 1 || (src < srcmax && ((findCharOrDots
-					      (currentInput[src + 1],
-					       0))->attributes &
+    if ((st->finishEmphasis || st->src == st->srcmax - 1
+	 || (st->src < st->srcmax && (inputAttributes (st, st->src + 1) &
 					     CTC_Letter)))
-	&& brailleIndicatorDefined (offset[lastLetter]))
+	&& brailleIndicatorDefined (st, offset[lastLetter]))
     return 1;
   else
-    return (brailleIndicatorDefined (offset[lastWordAfter]));
+    return (brailleIndicatorDefined (st, offset[lastWordAfter]));
   return 0;
 }
 
 static int
-doCompEmph ()
+doCompEmph (TranslationState *st)
 {
   int endEmph;
-  for (endEmph = src; (typebuf[endEmph] & computer_braille) && endEmph
-       <= srcmax; endEmph++);
-  return doCompTrans (src, endEmph);
+  for (endEmph = st->src; (st->typebuf[endEmph] & computer_braille) && endEmph
+       <= st->srcmax; endEmph++);
+  return doCompTrans (st, st->src, endEmph);
 }
 
 static int
-insertBrailleIndicators (int finish)
+doInsertBrailleIndicators (TranslationState *st, int finish)
 {
 /*Insert braille indicators such as italic, bold, capital, 
 * letter, number, etc.*/
@@ -819,42 +2683,43 @@ insertBrailleIndicators (int finish)
   int k;
   if (finish == 2)
     {
-      while (dest > 0 && (currentOutput[dest - 1] == 0 ||
-			  currentOutput[dest - 1] == B16))
-	dest--;
-      finishEmphasis = 1;
-      prevType = prevPrevType = prevTypeform & EMPHASIS;
-      curType = plain_text;
+      while (st->dest > 0 && (st->currentOutput[st->dest - 1] == 0 ||
+			  st->currentOutput[st->dest - 1] == B16))
+	st->dest--;
+      st->finishEmphasis = 1;
+      st->prevType = st->prevPrevType = st->prevTypeform & EMPHASIS;
+      st->curType = plain_text;
       checkWhat = checkEndTypeform;
     }
   else
     {
-      if (src == prevSrc && !finish)
+      if (st->src == st->prevSrc && !finish)
 	return 1;
-      if (src != prevSrc)
+      if (st->src != st->prevSrc)
 	{
-	  if (haveEmphasis && src < srcmax - 1)
-	    nextType = typebuf[src + 1] & EMPHASIS;
+	  if (st->haveEmphasis && st->src < st->srcmax - 1)
+	    st->nextType = st->typebuf[st->src + 1] & EMPHASIS;
 	  else
-	    nextType = plain_text;
-	  if (src > 2)
+	    st->nextType = plain_text;
+	  if (st->src > 2)
 	    {
-	      if (haveEmphasis)
-		prevPrevType = typebuf[src - 2] & EMPHASIS;
+	      if (st->haveEmphasis)
+		st->prevPrevType = st->typebuf[st->src - 2] & EMPHASIS;
 	      else
-		prevPrevType = plain_text;
-	      prevPrevAttr =
-		(findCharOrDots (currentInput[src - 2], 0))->attributes;
+		st->prevPrevType = plain_text;
+	      st->prevPrevAttr =
+		inputAttributes (st, st->src - 2);
 	    }
 	  else
 	    {
-	      prevPrevType = plain_text;
-	      prevPrevAttr = CTC_Space;
+	      st->prevPrevType = plain_text;
+	      st->prevPrevAttr = CTC_Space;
 	    }
-	  if (haveEmphasis && (typebuf[src] & EMPHASIS) != prevTypeform)
+	  if (st->haveEmphasis
+	      && (st->typebuf[st->src] & EMPHASIS) != st->prevTypeform)
 	    {
-	      prevType = prevTypeform & EMPHASIS;
-	      curType = typebuf[src] & EMPHASIS;
+	      st->prevType = st->prevTypeform & EMPHASIS;
+	      st->curType = st->typebuf[st->src] & EMPHASIS;
 	      checkWhat = checkEndTypeform;
 	    }
 	  else if (!finish)
@@ -874,62 +2739,62 @@ insertBrailleIndicators (int finish)
 	  ok = 0;
 	  break;
 	case checkBeginTypeform:
-	  if (haveEmphasis)
-	    switch (curType)
+	  if (st->haveEmphasis)
+	    switch (st->curType)
 	      {
 	      case plain_text:
 		ok = 0;
 		break;
 	      case italic:
-		ok = beginEmphasis (&table->firstWordItal);
-		curType = 0;
+		ok = beginEmphasis (st, &st->table->firstWordItal);
+		st->curType = 0;
 		break;
 	      case bold:
-		ok = beginEmphasis (&table->firstWordBold);
-		curType = 0;
+		ok = beginEmphasis (st, &st->table->firstWordBold);
+		st->curType = 0;
 		break;
 	      case underline:
-		ok = beginEmphasis (&table->firstWordUnder);
-		curType = 0;
+		ok = beginEmphasis (st, &st->table->firstWordUnder);
+		st->curType = 0;
 		break;
 	      case computer_braille:
 		ok = 0;
-		doCompEmph ();
-		curType = 0;
+		doCompEmph (st);
+		st->curType = 0;
 		break;
 	      case italic + underline:
-		ok = beginEmphasis (&table->firstWordUnder);
-		curType -= underline;
+		ok = beginEmphasis (st, &st->table->firstWordUnder);
+		st->curType -= underline;
 		break;
 	      case italic + bold:
-		ok = beginEmphasis (&table->firstWordBold);
-		curType -= bold;
+		ok = beginEmphasis (st, &st->table->firstWordBold);
+		st->curType -= bold;
 		break;
 	      case italic + computer_braille:
 		ok = 0;
-		doCompEmph ();
-		curType -= computer_braille;
+		doCompEmph (st);
+		st->curType -= computer_braille;
 		break;
 	      case underline + bold:
-		beginEmphasis (&table->firstWordBold);
-		curType -= bold;
+		beginEmphasis (st, &st->table->firstWordBold);
+		st->curType -= bold;
 		break;
 	      case underline + computer_braille:
 		ok = 0;
-		doCompEmph ();
-		curType -= computer_braille;
+		doCompEmph (st);
+		st->curType -= computer_braille;
 		break;
 	      case bold + computer_braille:
 		ok = 0;
-		doCompEmph ();
-		curType -= computer_braille;
+		doCompEmph (st);
+		st->curType -= computer_braille;
 		break;
 	      default:
 		ok = 0;
-		curType = 0;
+		st->curType = 0;
 		break;
 	      }
-	  if (!curType)
+	  if (!st->curType)
 	    {
 	      if (!finish)
 		checkWhat = checkNothing;
@@ -938,68 +2803,69 @@ insertBrailleIndicators (int finish)
 	    }
 	  break;
 	case checkEndTypeform:
-	  if (haveEmphasis)
-	    switch (prevType)
+	  if (st->haveEmphasis)
+	    switch (st->prevType)
 	      {
 	      case plain_text:
 		ok = 0;
 		break;
 	      case italic:
-		ok = endEmphasis (&table->firstWordItal);
-		prevType = 0;
+		ok = endEmphasis (st, &st->table->firstWordItal);
+		st->prevType = 0;
 		break;
 	      case bold:
-		ok = endEmphasis (&table->firstWordBold);
-		prevType = 0;
+		ok = endEmphasis (st, &st->table->firstWordBold);
+		st->prevType = 0;
 		break;
 	      case underline:
-		ok = endEmphasis (&table->firstWordUnder);
-		prevType = 0;
+		ok = endEmphasis (st, &st->table->firstWordUnder);
+		st->prevType = 0;
 		break;
 	      case computer_braille:
 		ok = 0;
-		prevType = 0;
+		st->prevType = 0;
 		break;
 	      case italic + underline:
-		ok = endEmphasis (&table->firstWordUnder);
-		prevType -= underline;
+		ok = endEmphasis (st, &st->table->firstWordUnder);
+		st->prevType -= underline;
 		break;
 	      case italic + bold:
-		ok = endEmphasis (&table->firstWordBold);
-		prevType -= bold;
+		ok = endEmphasis (st, &st->table->firstWordBold);
+		st->prevType -= bold;
 		break;
 	      case italic + computer_braille:
 		ok = 1;
-		prevType -= computer_braille;
+		st->prevType -= computer_braille;
 		break;
 	      case underline + bold:
-		ok = endEmphasis (&table->firstWordBold);
-		prevType -= bold;
+		ok = endEmphasis (st, &st->table->firstWordBold);
+		st->prevType -= bold;
 		break;
 	      case underline + computer_braille:
 		ok = 0;
-		prevType -= computer_braille;
+		st->prevType -= computer_braille;
 		break;
 	      case bold + computer_braille:
-		ok = endEmphasis (&table->firstWordBold);
-		prevType -= bold;
+		ok = endEmphasis (st, &st->table->firstWordBold);
+		st->prevType -= bold;
 		break;
 	      default:
 		ok = 0;
-		prevType = 0;
+		st->prevType = 0;
 		break;
 	      }
-	  if (prevType == plain_text)
+	  if (st->prevType == plain_text)
 	    {
 	      checkWhat = checkBeginTypeform;
-	      prevTypeform = typebuf[src] & EMPHASIS;
+	      st->prevTypeform = st->typebuf[st->src] & EMPHASIS;
 	    }
 	  break;
 	case checkNumber:
-	  if (brailleIndicatorDefined(table->numberSign) &&
-	      checkAttr_safe(currentInput, src, CTC_Digit, 0) &&
-	      (prevTransOpcode == CTO_ExactDots || !(beforeAttributes & CTC_Digit)) &&
-	      prevTransOpcode != CTO_MidNum)
+	  if (brailleIndicatorDefined(st, st->table->numberSign) &&
+	      checkAttr_safe(st, st->currentInput, st->src, CTC_Digit, 0) &&
+	      (st->prevTransOpcode == CTO_ExactDots
+	       || !(st->beforeAttributes & CTC_Digit)) &&
+	      st->prevTransOpcode != CTO_MidNum)
 	    {
 	      ok = 1;
 	      checkWhat = checkNothing;
@@ -1008,40 +2874,41 @@ insertBrailleIndicators (int finish)
 	    checkWhat = checkLetter;
 	  break;
 	case checkLetter:
-	  if (!brailleIndicatorDefined (table->letterSign))
+	  if (!brailleIndicatorDefined (st, st->table->letterSign))
 	    {
 	      ok = 0;
 	      checkWhat = checkBeginMultCaps;
 	      break;
 	    }
-	  if (transOpcode == CTO_Contraction)
+	  if (st->transOpcode == CTO_Contraction)
 	    {
 	      ok = 1;
 	      checkWhat = checkBeginMultCaps;
 	      break;
 	    }
-	  if ((checkAttr_safe(currentInput, src, CTC_Letter, 0) &&
-	       !(beforeAttributes & CTC_Letter)) &&
-	      (!checkAttr_safe(currentInput, src + 1, CTC_Letter, 0) ||
-	       (beforeAttributes & CTC_Digit)))
+	  if ((checkAttr_safe(st, st->currentInput, st->src, CTC_Letter, 0) &&
+	       !(st->beforeAttributes & CTC_Letter)) &&
+	      (!checkAttr_safe(st, st->currentInput, st->src + 1, CTC_Letter,
+			       0) ||
+	       (st->beforeAttributes & CTC_Digit)))
 	    {
 	      ok = 1;
-	      if (src > 0)
-		for (k = 0; k < table->noLetsignBeforeCount; k++)
-		  if (currentInput[src - 1] == table->noLetsignBefore[k])
+	      if (st->src > 0)
+		for (k = 0; k < st->table->noLetsignBeforeCount; k++)
+		  if (st->currentInput[st->src - 1] == st->table->noLetsignBefore[k])
 		    {
 		      ok = 0;
 		      break;
 		    }
-	      for (k = 0; k < table->noLetsignCount; k++)
-		if (currentInput[src] == table->noLetsign[k])
+	      for (k = 0; k < st->table->noLetsignCount; k++)
+		if (st->currentInput[st->src] == st->table->noLetsign[k])
 		  {
 		    ok = 0;
 		    break;
 		  }
-	      if ((src + 1) < srcmax)
-		for (k = 0; k < table->noLetsignAfterCount; k++)
-		  if (currentInput[src + 1] == table->noLetsignAfter[k])
+	      if ((st->src + 1) < st->srcmax)
+		for (k = 0; k < st->table->noLetsignAfterCount; k++)
+		  if (st->currentInput[st->src + 1] == st->table->noLetsignAfter[k])
 		    {
 		      ok = 0;
 		      break;
@@ -1050,35 +2917,36 @@ insertBrailleIndicators (int finish)
 	  checkWhat = checkBeginMultCaps;
 	  break;
 	case checkBeginMultCaps:
-	  if (brailleIndicatorDefined (table->beginCapitalSign) &&
-	      !(beforeAttributes & CTC_UpperCase) && checkMultCaps ())
+	  if (brailleIndicatorDefined (st, st->table->beginCapitalSign) &&
+	      !(st->beforeAttributes & CTC_UpperCase) && checkMultCaps (st))
 	    {
 	      ok = 1;
-	      if (table->capsNoCont)
-		dontContract = 1;
+	      if (st->table->capsNoCont)
+		st->dontContract = 1;
 	      checkWhat = checkNothing;
 	    }
 	  else
 	    checkWhat = checkSingleCap;
 	  break;
 	case checkEndMultCaps:
-	  if (brailleIndicatorDefined (table->endCapitalSign) &&
-	      (prevPrevAttr & CTC_UpperCase) &&
-	      (beforeAttributes & CTC_UpperCase) &&
-	      checkAttr_safe(currentInput, src, CTC_LowerCase, 0))
+	  if (brailleIndicatorDefined (st, st->table->endCapitalSign) &&
+	      (st->prevPrevAttr & CTC_UpperCase) &&
+	      (st->beforeAttributes & CTC_UpperCase) &&
+	      checkAttr_safe(st, st->currentInput, st->src, CTC_LowerCase, 0))
 	    {
 	      ok = 1;
-	      if (table->capsNoCont)
-		dontContract = 0;
+	      if (st->table->capsNoCont)
+		st->dontContract = 0;
 	    }
 	  checkWhat = checkNothing;
 	  break;
 	case checkSingleCap:
-	  if (brailleIndicatorDefined (table->capitalSign) &&
-	      src < srcmax &&
-	      checkAttr_safe(currentInput, src, CTC_UpperCase, 0) &&
-	      (!(beforeAttributes & CTC_UpperCase) ||
-	       table->beginCapitalSign == 0))
+	  if (brailleIndicatorDefined (st, st->table->capitalSign) &&
+	      st->src < st->srcmax &&
+	      checkAttr_safe(st, st->currentInput, st->src, CTC_UpperCase,
+			     0) &&
+	      (!(st->beforeAttributes & CTC_UpperCase) ||
+	       st->table->beginCapitalSign == 0))
 	    {
 	      ok = 1;
 	      checkWhat = checkNothing;
@@ -1090,117 +2958,97 @@ insertBrailleIndicators (int finish)
 	  checkWhat = checkNothing;
 	  break;
 	}
-      if (ok && indicRule != NULL)
+      if (ok && st->indicRule != NULL)
 	{
 	  if (!for_updatePositions
-	      (&indicRule->charsdots[0], 0, indicRule->dotslen))
+	      (st, &st->indicRule->charsdots[0], 0, st->indicRule->dotslen))
 	    return 0;
-	  if (cursorStatus == 2)
+	  if (st->cursorStatus == 2)
 	    checkWhat = checkNothing;
 	}
     }
   while (checkWhat != checkNothing);
-  finishEmphasis = 0;
+  st->finishEmphasis = 0;
   return 1;
 }
 
 static int
-onlyLettersBehind ()
+insertBrailleIndicators (TranslationState *st, int finish)
+{
+  double start;
+  int result;
+  if (!st->ruleProfile)
+    return doInsertBrailleIndicators (st, finish);
+  start = currentTime ();
+  result = doInsertBrailleIndicators (st, finish);
+  st->profileTimes[ruleProfileIndicators] += currentTime () - start;
+  return result;
+}
+
+static int
+onlyLettersBehind (TranslationState *st)
 {
   /* Actually, spaces, then letters */
   int k;
-  if (!(beforeAttributes & CTC_Space))
+  if (!(st->beforeAttributes & CTC_Space))
     return 0;
-  for (k = src - 2; k >= 0; k--)
-    {
-      TranslationTableCharacterAttributes attr = (findCharOrDots
-						  (currentInput[k],
-						   0))->attributes;
-      if ((attr & CTC_Space))
-	continue;
-      if ((attr & CTC_Letter))
-	return 1;
-      else
-	return 0;
-    }
-  return 1;
+  k = previousInputAttr (st, st->src - 2, 0, CTC_Space, 0);
+  return k < 0 || checkInputAttr (st, k, CTC_Letter);
 }
 
 static int
-onlyLettersAhead ()
+onlyLettersAhead (TranslationState *st)
 {
   /* Actullly, spaces, then letters */
   int k;
-  if (!(afterAttributes & CTC_Space))
+  if (!(st->afterAttributes & CTC_Space))
     return 0;
-  for (k = src + transCharslen + 1; k < srcmax; k++)
-    {
-      TranslationTableCharacterAttributes attr = (findCharOrDots
-						  (currentInput[k],
-						   0))->attributes;
-      if ((attr & CTC_Space))
-	continue;
-      if ((attr & (CTC_Letter | CTC_LitDigit)))
-	return 1;
-      else
-	return 0;
-    }
-  return 0;
+  k = nextInputAttr (st, st->src + st->transCharslen + 1, st->srcmax,
+		     CTC_Space, 0);
+  return k < st->srcmax && checkInputAttr (st, k, CTC_Letter | CTC_LitDigit);
 }
 
 static int
-noCompbrlAhead ()
+noCompbrlAhead (TranslationState *st)
 {
-  int start = src + transCharslen;
+  int start = st->src + st->transCharslen;
   int end;
   int curSrc;
-  if (start >= srcmax)
+  if (start >= st->srcmax)
     return 1;
-  while (start < srcmax && checkAttr (currentInput[start], CTC_Space, 0))
-    start++;
-  if (start == srcmax || (transOpcode == CTO_JoinableWord && (!checkAttr
-							      (currentInput
-							       [start],
-							       CTC_Letter |
-							       CTC_Digit, 0)
+  start = nextInputAttr (st, start, st->srcmax, CTC_Space, 0);
+  if (start == st->srcmax || (st->transOpcode == CTO_JoinableWord
+			      && (!checkInputAttr
+				  (st, start, CTC_Letter | CTC_Digit)
 							      ||
-							      !checkAttr
-							      (currentInput
-							       [start - 1],
-							       CTC_Space,
-							       0))))
+				  !checkInputAttr (st, start - 1, CTC_Space))))
     return 1;
-  end = start;
-  while (end < srcmax && !checkAttr (currentInput[end], CTC_Space, 0))
-    end++;
-  if ((mode & (compbrlAtCursor | compbrlLeftCursor)) && cursorPosition
-      >= start && cursorPosition < end)
+  end = nextInputAttr (st, start, st->srcmax, CTC_Space, 1);
+  if ((st->mode & (compbrlAtCursor | compbrlLeftCursor)) && st->cursorPosition
+      >= start && st->cursorPosition < end)
     return 0;
   /* Look ahead for rules with CTO_CompBrl */
   for (curSrc = start; curSrc < end; curSrc++)
     {
-      int length = srcmax - curSrc;
+      int length = st->srcmax - curSrc;
       int tryThis;
       const TranslationTableCharacter *character1;
       const TranslationTableCharacter *character2;
       int k;
-      character1 = findCharOrDots (currentInput[curSrc], 0);
+      character1 = findCharOrDots (st, st->currentInput[curSrc], 0);
       for (tryThis = 0; tryThis < 2; tryThis++)
 	{
 	  TranslationTableOffset ruleOffset = 0;
 	  TranslationTableRule *testRule;
-	  unsigned long int makeHash = 0;
 	  switch (tryThis)
 	    {
 	    case 0:
 	      if (!(length >= 2))
 		break;
-	      /*Hash function optimized for forward translation */
-	      makeHash = (unsigned long int) character1->lowercase << 8;
-	      character2 = findCharOrDots (currentInput[curSrc + 1], 0);
-	      makeHash += (unsigned long int) character2->lowercase;
-	      makeHash %= HASHNUM;
-	      ruleOffset = table->forRules[makeHash];
+	      character2 = findCharOrDots (st, st->currentInput[curSrc + 1],
+					   0);
+	      ruleOffset = findForRules (st->table, character1->lowercase,
+					 character2->lowercase);
 	      break;
 	    case 1:
 	      if (!(length >= 1))
@@ -1212,11 +3060,12 @@ noCompbrlAhead ()
 	  while (ruleOffset)
 	    {
 	      testRule =
-		(TranslationTableRule *) & table->ruleArea[ruleOffset];
+		(TranslationTableRule *) & st->table->ruleArea[ruleOffset];
 	      for (k = 0; k < testRule->charslen; k++)
 		{
-		  character1 = findCharOrDots (testRule->charsdots[k], 0);
-		  character2 = findCharOrDots (currentInput[curSrc + k], 0);
+		  character1 = findCharOrDots (st, testRule->charsdots[k], 0);
+		  character2 = findCharOrDots (st,
+					       st->currentInput[curSrc + k], 0);
 		  if (character1->lowercase != character2->lowercase)
 		    break;
 		}
@@ -1233,874 +3082,1626 @@ noCompbrlAhead ()
   return 1;
 }
 
-static widechar const *repwordStart;
-static int repwordLength;
 static int
-isRepeatedWord ()
+isRepeatedWord (TranslationState *st)
 {
   int start;
-  if (src == 0 || !checkAttr (currentInput[src - 1], CTC_Letter, 0))
+  if (st->src == 0 || !checkInputAttr (st, st->src - 1, CTC_Letter))
     return 0;
-  if ((src + transCharslen) >= srcmax || !checkAttr (currentInput[src +
-								  transCharslen],
-						     CTC_Letter, 0))
+  if ((st->src + st->transCharslen) >= st->srcmax
+      || !checkInputAttr (st, st->src + st->transCharslen, CTC_Letter))
     return 0;
-  for (start = src - 2;
-       start >= 0 && checkAttr (currentInput[start], CTC_Letter, 0); start--);
-  start++;
-  repwordStart = &currentInput[start];
-  repwordLength = src - start;
-  if (compareChars (repwordStart, &currentInput[src
-						+ transCharslen],
-		    repwordLength, 0))
+  start = previousInputAttr (st, st->src - 2, 0, CTC_Letter, 0) + 1;
+  st->repwordStart = &st->currentInput[start];
+  st->repwordLength = st->src - start;
+  if (compareChars (st, st->repwordStart, &st->currentInput[st->src
+						+ st->transCharslen],
+		    st->repwordLength, 0))
     return 1;
   return 0;
 }
 
-static void
-for_selectRule ()
+static int
+for_checkRule (TranslationState *st)
 {
-/*check for valid Translations. Return value is in transRule. */
-  int length = srcmax - src;
-  int tryThis;
-  const TranslationTableCharacter *character2;
+/*Decide whether the rule in transRule, whose characters match, may be 
+* used at this position */
   int k;
-  curCharDef = findCharOrDots (currentInput[src], 0);
-  for (tryThis = 0; tryThis < 3; tryThis++)
-    {
-      TranslationTableOffset ruleOffset = 0;
-      unsigned long int makeHash = 0;
-      switch (tryThis)
-	{
-	case 0:
-	  if (!(length >= 2))
-	    break;
-	  /*Hash function optimized for forward translation */
-	  makeHash = (unsigned long int) curCharDef->lowercase << 8;
-	  character2 = findCharOrDots (currentInput[src + 1], 0);
-	  makeHash += (unsigned long int) character2->lowercase;
-	  makeHash %= HASHNUM;
-	  ruleOffset = table->forRules[makeHash];
+  switch (st->transOpcode)
+    {				/*these look beyond the word they are in */
+    case CTO_Context:
+    case CTO_RepWord:
+    case CTO_Repeated:
+    case CTO_NoCont:
+    case CTO_LargeSign:
+    case CTO_JoinNum:
+    case CTO_JoinableWord:
+    case CTO_CompBrl:
+    case CTO_Literal:
+    case CTO_PrePunc:
+    case CTO_PostPunc:
+      st->wordUnsafe = 1;
+      break;
+    default:
+      break;
+    }
+  setAfter (st, st->transCharslen);
+  if ((!st->transRule->after || (st->beforeAttributes
+			     & st->transRule->after)) &&
+      (!st->transRule->before || (st->afterAttributes
+			      & st->transRule->before)))
+    switch (st->transOpcode)
+      {				/*check validity of this Translation */
+      case CTO_Space:
+      case CTO_Letter:
+      case CTO_UpperCase:
+      case CTO_LowerCase:
+      case CTO_Digit:
+      case CTO_LitDigit:
+      case CTO_Punctuation:
+      case CTO_Math:
+      case CTO_Sign:
+      case CTO_Hyphen:
+      case CTO_Replace:
+      case CTO_CompBrl:
+      case CTO_Literal:
+	return 1;
+      case CTO_Repeated:
+	if ((st->mode & (compbrlAtCursor | compbrlLeftCursor))
+	    && st->src >= st->compbrlStart && st->src <= st->compbrlEnd)
 	  break;
-	case 1:
-	  if (!(length >= 1))
-	    break;
-	  length = 1;
-	  ruleOffset = curCharDef->otherRules;
+	return 1;
+      case CTO_RepWord:
+	if (st->dontContract || (st->mode & noContractions))
 	  break;
-	case 2:		/*No rule found */
-	  transRule = &pseudoRule;
-	  transOpcode = pseudoRule.opcode = CTO_None;
-	  transCharslen = pseudoRule.charslen = 1;
-	  pseudoRule.charsdots[0] = currentInput[src];
-	  pseudoRule.dotslen = 0;
-	  return;
+	if (isRepeatedWord (st))
+	  return 1;
+	break;
+      case CTO_NoCont:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	return 1;
+      case CTO_Syllable:
+	st->transOpcode = CTO_Always;
+	/* fall through */
+      case CTO_Always:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	return 1;
+      case CTO_ExactDots:
+	return 1;
+      case CTO_NoCross:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	if (syllableBreak (st))
 	  break;
+	return 1;
+      case CTO_Context:
+	if (!st->srcIncremented || !passDoTest (st))
+	  break;
+	return 1;
+      case CTO_LargeSign:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	if (!((st->beforeAttributes & (CTC_Space
+				   | CTC_Punctuation))
+	      || onlyLettersBehind (st))
+	    || !((st->afterAttributes & CTC_Space)
+		 || st->prevTransOpcode == CTO_LargeSign)
+	    || (st->afterAttributes & CTC_Letter)
+	    || !noCompbrlAhead (st))
+	  st->transOpcode = CTO_Always;
+	return 1;
+      case CTO_WholeWord:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	/* fall through */
+      case CTO_Contraction:
+	if ((st->beforeAttributes & (CTC_Space | CTC_Punctuation))
+	    && (st->afterAttributes & (CTC_Space | CTC_Punctuation)))
+	  return 1;
+	break;
+      case CTO_PartWord:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	if ((st->beforeAttributes & CTC_Letter)
+	    || (st->afterAttributes & CTC_Letter))
+	  return 1;
+	break;
+      case CTO_JoinNum:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	if ((st->beforeAttributes & (CTC_Space | CTC_Punctuation))
+	    &&
+	    (st->afterAttributes & CTC_Space) &&
+	    (st->dest + st->transRule->dotslen < st->destmax))
+	  {
+	    int cursrc = nextInputAttr (st, st->src + st->transCharslen + 1,
+					st->srcmax, CTC_Space, 0);
+	    if (cursrc < st->srcmax && checkInputAttr (st, cursrc, CTC_Digit))
+	      return 1;
+	  }
+	break;
+      case CTO_LowWord:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	if ((st->beforeAttributes & CTC_Space)
+	    && (st->afterAttributes & CTC_Space)
+	    && (st->prevTransOpcode != CTO_JoinableWord))
+	  return 1;
+	break;
+      case CTO_JoinableWord:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	if (st->beforeAttributes & (CTC_Space | CTC_Punctuation)
+	    && onlyLettersAhead (st) && noCompbrlAhead (st))
+	  return 1;
+	break;
+      case CTO_SuffixableWord:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	if ((st->beforeAttributes & (CTC_Space | CTC_Punctuation))
+	    && (st->afterAttributes &
+		(CTC_Space | CTC_Letter | CTC_Punctuation)))
+	  return 1;
+	break;
+      case CTO_PrefixableWord:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	if ((st->beforeAttributes &
+	     (CTC_Space | CTC_Letter | CTC_Punctuation))
+	    && (st->afterAttributes & (CTC_Space | CTC_Punctuation)))
+	  return 1;
+	break;
+      case CTO_BegWord:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	if ((st->beforeAttributes & (CTC_Space | CTC_Punctuation))
+	    && (st->afterAttributes & CTC_Letter))
+	  return 1;
+	break;
+      case CTO_BegMidWord:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	if ((st->beforeAttributes &
+	     (CTC_Letter | CTC_Space | CTC_Punctuation))
+	    && (st->afterAttributes & CTC_Letter))
+	  return 1;
+	break;
+      case CTO_MidWord:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	if (st->beforeAttributes & CTC_Letter
+	    && st->afterAttributes & CTC_Letter)
+	  return 1;
+	break;
+      case CTO_MidEndWord:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	if (st->beforeAttributes & CTC_Letter
+	    && st->afterAttributes & (CTC_Letter | CTC_Space |
+				  CTC_Punctuation))
+	  return 1;
+	break;
+      case CTO_EndWord:
+	if (st->dontContract || (st->mode & noContractions))
+	  break;
+	if (st->beforeAttributes & CTC_Letter
+	    && st->afterAttributes & (CTC_Space | CTC_Punctuation))
+	  return 1;
+	break;
+      case CTO_BegNum:
+	if (st->beforeAttributes & (CTC_Space | CTC_Punctuation)
+	    && st->afterAttributes & CTC_Digit)
+	  return 1;
+	break;
+      case CTO_MidNum:
+	if (st->prevTransOpcode != CTO_ExactDots
+	    && st->beforeAttributes & CTC_Digit
+	    && st->afterAttributes & CTC_Digit)
+	  return 1;
+	break;
+      case CTO_EndNum:
+	if (st->beforeAttributes & CTC_Digit &&
+	    st->prevTransOpcode != CTO_ExactDots)
+	  return 1;
+	break;
+      case CTO_DecPoint:
+	if (!(st->afterAttributes & CTC_Digit))
+	  break;
+	if (st->beforeAttributes & CTC_Digit)
+	  st->transOpcode = CTO_MidNum;
+	return 1;
+      case CTO_PrePunc:
+	if (!checkInputAttr (st, st->src, CTC_Punctuation)
+	    || (st->src > 0
+		&& checkInputAttr (st, st->src - 1, CTC_Letter)))
+	  break;
+	k = nextInputAttr (st, st->src + st->transCharslen, st->srcmax,
+			   CTC_Letter | CTC_Digit | CTC_Space, 1);
+	if (k < st->srcmax && checkInputAttr (st, k, CTC_Letter | CTC_Digit))
+	  return 1;
+	break;
+      case CTO_PostPunc:
+	if (!checkInputAttr (st, st->src, CTC_Punctuation)
+	    || (st->src < (st->srcmax - 1)
+		&& checkInputAttr (st, st->src + 1, CTC_Letter)))
+	  break;
+	k = previousInputAttr (st, st->src, 0,
+			       CTC_Letter | CTC_Digit | CTC_Space, 1);
+	if (k >= 0 && checkInputAttr (st, k, CTC_Letter | CTC_Digit))
+	  return 1;
+	break;
+      default:
+	break;
+      }
+  return 0;
+}
+
+static int
+matchTrieRule (TranslationState *st, const TrieRule * candidate, int from,
+	       int to)
+{
+/*How many of the lowercase characters of the candidate match the input 
+* from from up to to. The rule itself is only looked at past the 
+* characters kept with the trie. */
+  const TranslationTableRule *rule;
+  const widechar *lowercase;
+  int m;
+  for (m = from; m < to && m < TRIERULEPREFIX; m++)
+    if (candidate->prefix[m] != inputLowercase (st, st->src + m))
+      return m;
+  if (m >= to)
+    return m;
+  rule = (TranslationTableRule *) & st->table->ruleArea[candidate->rule];
+  lowercase = &rule->charsdots[rule->charslen + rule->dotslen];
+  for (; m < to; m++)
+    if (lowercase[m] != inputLowercase (st, st->src + m))
+      break;
+  return m;
+}
+
+static const TranslationTableRule *
+findIndexedWord (TranslationState *st, int length)
+{
+/*The rule of the whole-word index whose lowercase characters are those 
+* of the input from src up to the next space or punctuation, or NULL. 
+* Such a rule matches nowhere else, and only after a space or 
+* punctuation. */
+  const TranslationTableHeader *table = st->table;
+  const TranslationTableRule *rule;
+  const widechar *lowercase;
+  const TranslationTableSlot *index;
+  unsigned int hash = table->wordIndexSeed;
+  unsigned int slotHash = 0;
+  widechar ch;
+  int numBuckets, slot, end;
+  if (!table->wordIndex
+      || !(st->beforeAttributes & (CTC_Space | CTC_Punctuation)))
+    return NULL;
+  for (end = 0; end < length && !checkInputAttr (st, st->src + end,
+						 CTC_Space |
+						 CTC_Punctuation); end++)
+    {
+      if (end == table->longestIndexedWord)
+	return NULL;
+      ch = inputLowercase (st, st->src + end);
+      hash = WORDINDEXHASH (hash, ch);
+      slotHash = WORDINDEXSLOTHASH (slotHash, ch);
+    }
+  if (end < 2)
+    return NULL;
+  index = &table->ruleArea[table->wordIndex];
+  numBuckets = 1 << table->wordIndexBits;
+  slot = wordIndexSlot (slotHash, index[hash & (numBuckets - 1)],
+			table->numIndexedWords);
+  rule = (TranslationTableRule *) & table->ruleArea[index[numBuckets + slot]];
+  if (rule->charslen != end)
+    return NULL;
+  lowercase = &rule->charsdots[rule->charslen + rule->dotslen];
+  for (end = 0; end < rule->charslen; end++)
+    if (lowercase[end] != inputLowercase (st, st->src + end))
+      return NULL;
+  return rule;
+}
+
+static int
+for_tryIndexedWord (TranslationState *st, const TranslationTableRule * word)
+{
+/*Try the rule findIndexedWord found, whose characters match */
+  st->transRule = (TranslationTableRule *) word;
+  st->transOpcode = word->opcode;
+  st->transCharslen = word->charslen;
+  return validMatch (st, 1) && ruleTried (st) && for_checkRule (st);
+}
+
+static int
+for_selectTrieRule (TranslationState *st, int length,
+		    const TranslationTableRule * word)
+{
+/*Follow the input down the trie of forward rules, then try the rules 
+* found on the way back up, longest first and in the order of their 
+* chain. A node near the end of a branch holds the rules of the whole 
+* branch, so the rest of their characters is compared here. The rule of 
+* the whole-word index found for this position, if any, is tried in its 
+* place among them, before the first shorter one which matches. */
+  TranslationTableOffset offset = st->table->forRuleTrie;
+  const ForRuleNode *node;
+  const ForRuleEdge *edges;
+  const TrieRule *candidate;
+  widechar ch;
+  int depth, low, high, middle;
+  int k, m;
+  for (depth = 0; depth < length; depth++)
+    {
+      node = (ForRuleNode *) & st->table->ruleArea[offset];
+      edges = (ForRuleEdge *) & st->table->ruleArea[node->children];
+      if (st->src + depth > st->wordLimit && node->numChildren)
+	st->wordUnsafe = 1;
+      ch = inputLowercase (st, st->src + depth);
+      low = 0;
+      high = node->numChildren;
+      while (low < high)
+	{
+	  middle = (low + high) / 2;
+	  if (edges[middle].ch < ch)
+	    low = middle + 1;
+	  else
+	    high = middle;
 	}
-      while (ruleOffset)
+      if (low == node->numChildren || edges[low].ch != ch)
+	break;
+      offset = edges[low].node;
+    }
+  if (st->src + depth > st->wordLimit
+      && ((ForRuleNode *) & st->table->ruleArea[offset])->numChildren)
+    st->wordUnsafe = 1;
+  while (1)
+    {
+      node = (ForRuleNode *) & st->table->ruleArea[offset];
+      candidate = (TrieRule *) & st->table->ruleArea[node->rules];
+      for (k = 0; k < node->numRules; k++, candidate++)
 	{
-	  transRule = (TranslationTableRule *) & table->ruleArea[ruleOffset];
-	  transOpcode = transRule->opcode;
-	  transCharslen = transRule->charslen;
-	  if (tryThis == 1 || ((transCharslen <= length) && validMatch ()))
+	  m = matchTrieRule (st, candidate, depth, candidate->charslen < length ?
+			     candidate->charslen : length);
+	  /* Whether it matches may depend on what follows the word */
+	  if (st->src + candidate->charslen - 1 > st->wordLimit
+	      && st->src + m > st->wordLimit)
+	    st->wordUnsafe = 1;
+	  if (m < candidate->charslen)
+	    continue;
+	  /* The rules which match are all in the chain of word */
+	  if (word && candidate->charslen < word->charslen)
 	    {
-	      /* check this rule */
-	      setAfter (transCharslen);
-	      if ((!transRule->after || (beforeAttributes
-					 & transRule->after)) &&
-		  (!transRule->before || (afterAttributes
-					  & transRule->before)))
-		switch (transOpcode)
-		  {		/*check validity of this Translation */
-		  case CTO_Space:
-		  case CTO_Letter:
-		  case CTO_UpperCase:
-		  case CTO_LowerCase:
-		  case CTO_Digit:
-		  case CTO_LitDigit:
-		  case CTO_Punctuation:
-		  case CTO_Math:
-		  case CTO_Sign:
-		  case CTO_Hyphen:
-		  case CTO_Replace:
-		  case CTO_CompBrl:
-		  case CTO_Literal:
-		    return;
-		  case CTO_Repeated:
-		    if ((mode & (compbrlAtCursor | compbrlLeftCursor))
-			&& src >= compbrlStart && src <= compbrlEnd)
-		      break;
-		    return;
-		  case CTO_RepWord:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		    if (isRepeatedWord ())
-		      return;
-		    break;
-		  case CTO_NoCont:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		    return;
-		  case CTO_Syllable:
-		    transOpcode = CTO_Always;
-		  case CTO_Always:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		    return;
-		  case CTO_ExactDots:
-		    return;
-		  case CTO_NoCross:
-if (dontContract || (mode & noContractions))
-		      break;
-		    		    if (syllableBreak ())
-		      break;
-		    return;
-		  case CTO_Context:
-		    if (!srcIncremented || !passDoTest ())
-		      break;
-		    return;
-		  case CTO_LargeSign:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		    if (!((beforeAttributes & (CTC_Space
-					       | CTC_Punctuation))
-			  || onlyLettersBehind ())
-			|| !((afterAttributes & CTC_Space)
-			     || prevTransOpcode == CTO_LargeSign)
-			|| (afterAttributes & CTC_Letter)
-			|| !noCompbrlAhead ())
-		      transOpcode = CTO_Always;
-		    return;
-		  case CTO_WholeWord:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		  case CTO_Contraction:
-		    if ((beforeAttributes & (CTC_Space | CTC_Punctuation))
-			&& (afterAttributes & (CTC_Space | CTC_Punctuation)))
-		      return;
-		    break;
-		  case CTO_PartWord:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		    if ((beforeAttributes & CTC_Letter)
-			|| (afterAttributes & CTC_Letter))
-		      return;
-		    break;
-		  case CTO_JoinNum:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		    if ((beforeAttributes & (CTC_Space | CTC_Punctuation))
-			&&
-			(afterAttributes & CTC_Space) &&
-			(dest + transRule->dotslen < destmax))
-		      {
-			int cursrc = src + transCharslen + 1;
-			while (cursrc < srcmax)
-			  {
-			    if (!checkAttr
-				(currentInput[cursrc], CTC_Space, 0))
-			      {
-				if (checkAttr
-				    (currentInput[cursrc], CTC_Digit, 0))
-				  return;
-				break;
-			      }
-			    cursrc++;
-			  }
-		      }
-		    break;
-		  case CTO_LowWord:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		    if ((beforeAttributes & CTC_Space)
-			&& (afterAttributes & CTC_Space)
-			&& (prevTransOpcode != CTO_JoinableWord))
-		      return;
-		    break;
-		  case CTO_JoinableWord:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		    if (beforeAttributes & (CTC_Space | CTC_Punctuation)
-			&& onlyLettersAhead () && noCompbrlAhead ())
-		      return;
-		    break;
-		  case CTO_SuffixableWord:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		    if ((beforeAttributes & (CTC_Space | CTC_Punctuation))
-			&& (afterAttributes &
-			    (CTC_Space | CTC_Letter | CTC_Punctuation)))
-		      return;
-		    break;
-		  case CTO_PrefixableWord:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		    if ((beforeAttributes &
-			 (CTC_Space | CTC_Letter | CTC_Punctuation))
-			&& (afterAttributes & (CTC_Space | CTC_Punctuation)))
-		      return;
-		    break;
-		  case CTO_BegWord:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		    if ((beforeAttributes & (CTC_Space | CTC_Punctuation))
-			&& (afterAttributes & CTC_Letter))
-		      return;
-		    break;
-		  case CTO_BegMidWord:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		    if ((beforeAttributes &
-			 (CTC_Letter | CTC_Space | CTC_Punctuation))
-			&& (afterAttributes & CTC_Letter))
-		      return;
-		    break;
-		  case CTO_MidWord:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		    if (beforeAttributes & CTC_Letter
-			&& afterAttributes & CTC_Letter)
-		      return;
-		    break;
-		  case CTO_MidEndWord:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		    if (beforeAttributes & CTC_Letter
-			&& afterAttributes & (CTC_Letter | CTC_Space |
-					      CTC_Punctuation))
-		      return;
-		    break;
-		  case CTO_EndWord:
-		    if (dontContract || (mode & noContractions))
-		      break;
-		    if (beforeAttributes & CTC_Letter
-			&& afterAttributes & (CTC_Space | CTC_Punctuation))
-		      return;
-		    break;
-		  case CTO_BegNum:
-		    if (beforeAttributes & (CTC_Space | CTC_Punctuation)
-			&& afterAttributes & CTC_Digit)
-		      return;
-		    break;
-		  case CTO_MidNum:
-		    if (prevTransOpcode != CTO_ExactDots
-			&& beforeAttributes & CTC_Digit
-			&& afterAttributes & CTC_Digit)
-		      return;
-		    break;
-		  case CTO_EndNum:
-		    if (beforeAttributes & CTC_Digit &&
-			prevTransOpcode != CTO_ExactDots)
-		      return;
-		    break;
-		  case CTO_DecPoint:
-		    if (!(afterAttributes & CTC_Digit))
-		      break;
-		    if (beforeAttributes & CTC_Digit)
-		      transOpcode = CTO_MidNum;
+	      if (for_tryIndexedWord (st, word))
+		return 1;
+	      word = NULL;
+	    }
+	  st->transRule = (TranslationTableRule *) & st->table->ruleArea
+	    [candidate->rule];
+	  st->transOpcode = candidate->opcode;
+	  st->transCharslen = candidate->charslen;
+	  if (validMatch (st, 1) && ruleTried (st) && for_checkRule (st))
+	    return 1;
+	}
+      if (offset == st->table->forRuleTrie)
+	return word && for_tryIndexedWord (st, word);
+      offset = node->parent;
+      depth--;
+    }
+}
+
+static int
+for_selectOverlayRule (TranslationState *st, int length)
+{
+/*Try the rules of the user dictionary which begin with the lowercase of 
+* the current character, longest first (see lou_compileOverlay). */
+  const louOverlay *overlay = st->overlay;
+  const widechar *lowercase;
+  widechar ch = inputLowercase (st, st->src);
+  int low = 0, high = overlay->numRules, middle;
+  int m;
+  while (low < high)
+    {
+      middle = (low + high) / 2;
+      st->transRule = overlay->rules[middle];
+      if (st->transRule->charsdots[st->transRule->charslen
+				   + st->transRule->dotslen] < ch)
+	low = middle + 1;
+      else
+	high = middle;
+    }
+  for (; low < overlay->numRules; low++)
+    {
+      st->transRule = overlay->rules[low];
+      st->transOpcode = st->transRule->opcode;
+      st->transCharslen = st->transRule->charslen;
+      lowercase = &st->transRule->charsdots[st->transCharslen
+					    + st->transRule->dotslen];
+      if (lowercase[0] != ch)
+	break;
+      if (st->transCharslen > length)
+	continue;
+      for (m = 1; m < st->transCharslen
+	   && lowercase[m] == inputLowercase (st, st->src + m); m++);
+      if (m == st->transCharslen && validMatch (st, 1) && ruleTried (st)
+	  && for_checkRule (st))
+	return 1;
+    }
+  return 0;
+}
+
+static void
+doSelectRule (TranslationState *st)
+{
+/*check for valid Translations. Return value is in transRule. */
+  int length = st->srcmax - st->src;
+  int tryThis;
+  const TranslationTableCharacter *character2;
+  const TranslationTableRule *word;
+  st->curCharDef = findCharOrDots (st, st->currentInput[st->src], 0);
+  if (st->overlay && length >= 1 && for_selectOverlayRule (st, length))
+    return;
+  for (tryThis = 0; tryThis < 3; tryThis++)
+    {
+      TranslationTableOffset ruleOffset = 0;
+      switch (tryThis)
+	{
+	case 0:
+	  if (!(length >= 2))
+	    break;
+	  if (st->table->forRuleTrie)
+	    {
+	      word = findIndexedWord (st, length);
+	      /* No rule of the trie begins with these two characters, and 
+	       * none can match across the end of a remembered word */
+	      if (st->table->forRuleFilter && st->src + 1 <= st->wordLimit
+		  && !RULEPAIRBIT (st->table->ruleArea,
+				   st->table->forRuleFilter,
+				   st->table->forRuleFilterBits,
+				   inputLowercase (st, st->src),
+				   inputLowercase (st, st->src + 1)))
+		{
+		  if (word && for_tryIndexedWord (st, word))
 		    return;
-		  case CTO_PrePunc:
-		    if (!checkAttr (currentInput[src], CTC_Punctuation, 0)
-			|| (src > 0
-			    && checkAttr (currentInput[src - 1], CTC_Letter,
-					  0)))
-		      break;
-		    for (k = src + transCharslen; k < srcmax; k++)
-		      {
-			if (checkAttr
-			    (currentInput[k], (CTC_Letter | CTC_Digit), 0))
-			  return;
-			if (checkAttr (currentInput[k], CTC_Space, 0))
-			  break;
-		      }
-		    break;
-		  case CTO_PostPunc:
-		    if (!checkAttr (currentInput[src], CTC_Punctuation, 0)
-			|| (src < (srcmax - 1)
-			    && checkAttr (currentInput[src + 1], CTC_Letter,
-					  0)))
-		      break;
-		    for (k = src; k >= 0; k--)
-		      {
-			if (checkAttr
-			    (currentInput[k], (CTC_Letter | CTC_Digit), 0))
-			  return;
-			if (checkAttr (currentInput[k], CTC_Space, 0))
-			  break;
-		      }
-		    break;
-		  default:
-		    break;
-		  }
+		  break;
+		}
+	      if (for_selectTrieRule (st, length, word))
+		return;
+	      break;
 	    }
-/*Done with checking this rule */
-	  ruleOffset = transRule->charsnext;
+	  character2 = findCharOrDots (st, st->currentInput[st->src + 1], 0);
+	  ruleOffset = findForRules (st->table, st->curCharDef->lowercase,
+				     character2->lowercase);
+	  break;
+	case 1:
+	  if (!(length >= 1))
+	    break;
+	  length = 1;
+	  ruleOffset = st->curCharDef->otherRules;
+	  break;
+	case 2:		/*No rule found */
+	  st->transRule = &st->pseudoRule;
+	  st->transOpcode = st->pseudoRule.opcode = CTO_None;
+	  st->transCharslen = st->pseudoRule.charslen = 1;
+	  st->pseudoRule.charsdots[0] = st->currentInput[st->src];
+	  st->pseudoRule.dotslen = 0;
+	  return;
+	  break;
+	}
+      while (ruleOffset)
+	{
+	  st->transRule = (TranslationTableRule *) & st->table->ruleArea[ruleOffset];
+	  st->transOpcode = st->transRule->opcode;
+	  st->transCharslen = st->transRule->charslen;
+	  if ((tryThis == 1 || ((st->transCharslen <= length)
+				&& validMatch (st, 0))) && ruleTried (st)
+	      && for_checkRule (st))
+	    return;
+	  ruleOffset = st->transRule->charsnext;
 	}
     }
 }
 
+static void
+for_selectRule (TranslationState *st)
+{
+  double start;
+  if (!st->ruleProfile)
+    {
+      doSelectRule (st);
+      return;
+    }
+  start = currentTime ();
+  doSelectRule (st);
+  st->profileTimes[ruleProfileSelecting] += currentTime () - start;
+}
+
 static int
-undefinedCharacter (widechar c)
+undefinedCharacter (TranslationState *st, widechar c)
 {
 /*Display an undefined character in the output buffer*/
   int k;
   char *display;
+  char displayBuf[20];
   widechar displayDots[20];
-  if (table->undefined)
+  if (st->table->undefined)
     {
       TranslationTableRule *transRule = (TranslationTableRule *)
-	& table->ruleArea[table->undefined];
+	& st->table->ruleArea[st->table->undefined];
       if (!for_updatePositions
-	  (&transRule->charsdots[transRule->charslen],
+	  (st, &transRule->charsdots[transRule->charslen],
 	   transRule->charslen, transRule->dotslen))
 	return 0;
       return 1;
     }
-  display = showString (&c, 1);
+  display = showStringInBuffer (&c, 1, displayBuf, sizeof (displayBuf));
   for (k = 0; k < strlen (display); k++)
-    displayDots[k] = getDotsForChar (display[k]);
-  if (!for_updatePositions (displayDots, 1, strlen(display)))
+    displayDots[k] = getDotsForCharInTable (st->table, display[k]);
+  if (!for_updatePositions (st, displayDots, 1, strlen(display)))
     return 0;
   return 1;
 }
 
 static int
-putCharacter (widechar character)
+putCharacter (TranslationState *st, widechar character)
 {
 /*Insert the dots equivalent of a character into the output buffer */
   TranslationTableCharacter *chardef;
   TranslationTableOffset offset;
-  if (cursorStatus == 2)
+  if (st->cursorStatus == 2)
     return 1;
-  chardef = (findCharOrDots (character, 0));
+  chardef = (findCharOrDots (st, character, 0));
   if ((chardef->attributes & CTC_Letter) && (chardef->attributes &
 					     CTC_UpperCase))
-    chardef = findCharOrDots (chardef->lowercase, 0);
+    chardef = findCharOrDots (st, chardef->lowercase, 0);
   offset = chardef->definitionRule;
   if (offset)
     {
       const TranslationTableRule *rule = (TranslationTableRule *)
-	& table->ruleArea[offset];
+	& st->table->ruleArea[offset];
       if (rule->dotslen)
-	return for_updatePositions (&rule->charsdots[1], 1, rule->dotslen);
+	return for_updatePositions (st, &rule->charsdots[1], 1, rule->dotslen);
       {
-	widechar d = getDotsForChar (character);
-	return for_updatePositions (&d, 1, 1);
+	widechar d = getDotsForCharInTable (st->table, character);
+	return for_updatePositions (st, &d, 1, 1);
       }
     }
-  return undefinedCharacter (character);
+  return undefinedCharacter (st, character);
 }
 
 static int
-putCharacters (const widechar * characters, int count)
+putCharacters (TranslationState *st, const widechar * characters, int count)
 {
 /*Insert the dot equivalents of a series of characters in the output 
 * buffer */
   int k;
   for (k = 0; k < count; k++)
-    if (!putCharacter (characters[k]))
+    if (!putCharacter (st, characters[k]))
       return 0;
   return 1;
 }
 
 static int
-doCompbrl ()
+doCompbrl (TranslationState *st)
 {
 /*Handle strings containing substrings defined by the compbrl opcode*/
   int stringStart, stringEnd;
-  if (checkAttr (currentInput[src], CTC_Space, 0))
+  if (checkInputAttr (st, st->src, CTC_Space))
     return 1;
-  if (destword)
+  if (st->destword)
     {
-      src = srcword;
-      dest = destword;
+      st->src = st->srcword;
+      st->dest = st->destword;
     }
   else
     {
-      src = 0;
-      dest = 0;
+      st->src = 0;
+      st->dest = 0;
     }
-  for (stringStart = src; stringStart >= 0; stringStart--)
-    if (checkAttr (currentInput[stringStart], CTC_Space, 0))
-      break;
-  stringStart++;
-  for (stringEnd = src; stringEnd < srcmax; stringEnd++)
-    if (checkAttr (currentInput[stringEnd], CTC_Space, 0))
-      break;
-  return (doCompTrans (stringStart, stringEnd));
+  stringStart = previousInputAttr (st, st->src, 0, CTC_Space, 1) + 1;
+  stringEnd = nextInputAttr (st, st->src, st->srcmax, CTC_Space, 1);
+  return (doCompTrans (st, stringStart, stringEnd));
 }
 
 static int
-putCompChar (widechar character)
+putCompChar (TranslationState *st, widechar character)
 {
 /*Insert the dots equivalent of a character into the output buffer */
   TranslationTableOffset offset = (findCharOrDots
-				   (character, 0))->definitionRule;
+				   (st, character, 0))->definitionRule;
   if (offset)
     {
       const TranslationTableRule *rule = (TranslationTableRule *)
-	& table->ruleArea[offset];
+	& st->table->ruleArea[offset];
       if (rule->dotslen)
-	return for_updatePositions (&rule->charsdots[1], 1, rule->dotslen);
+	return for_updatePositions (st, &rule->charsdots[1], 1, rule->dotslen);
       {
-	widechar d = getDotsForChar (character);
-	return for_updatePositions (&d, 1, 1);
+	widechar d = getDotsForCharInTable (st->table, character);
+	return for_updatePositions (st, &d, 1, 1);
       }
     }
-  return undefinedCharacter (character);
+  return undefinedCharacter (st, character);
+}
+
+static int
+putCompCells (TranslationState *st, int end)
+{
+/* Put the cells of the characters from src on which have one, up to 
+* end, as putCompChar would one by one, and leave src after them */
+  const widechar *cells =
+    (const widechar *) & st->table->ruleArea[st->table->compCells];
+  int k, length;
+  for (length = 0; st->src + length < end; length++)
+    if (st->currentInput[st->src + length] >= 256
+	|| !cells[st->currentInput[st->src + length]])
+      break;
+  if (st->dest + length > st->destmax || st->src + length > st->srcmax)
+    {
+      /* Put what fits, as one by one */
+      if (length > st->destmax - st->dest)
+	length = st->destmax - st->dest;
+      if (length > st->srcmax - st->src)
+	length = st->srcmax - st->src;
+      putCompCells (st, st->src + length);
+      return 0;
+    }
+  for (k = 0; k < length; k++)
+    {
+      st->currentOutput[st->dest + k] =
+	cells[st->currentInput[st->src + k]];
+      if (st->inputPositions != NULL)
+	st->srcMapping[st->dest + k] = st->prevSrcMapping[st->src + k];
+      if (st->outputPositions != NULL)
+	st->outputPositions[st->prevSrcMapping[st->src + k]] = st->dest + k;
+    }
+  st->src += length;
+  st->dest += length;
+  return 1;
 }
 
 static int
-doCompTrans (int start, int end)
+doCompTrans (TranslationState *st, int start, int end)
 {
   int k;
   int haveEndsegment = 0;
-  if (cursorStatus != 2 && brailleIndicatorDefined (table->begComp))
+  if (st->cursorStatus != 2 && brailleIndicatorDefined (st,
+							st->table->begComp))
     if (!for_updatePositions
-	(&indicRule->charsdots[0], 0, indicRule->dotslen))
+	(st, &st->indicRule->charsdots[0], 0, st->indicRule->dotslen))
       return 0;
   for (k = start; k < end; k++)
     {
       TranslationTableOffset compdots = 0;
-      if (currentInput[k] == ENDSEGMENT)
+      if (st->currentInput[k] == ENDSEGMENT)
 	{
 	  haveEndsegment = 1;
 	  continue;
 	}
-      src = k;
-      if (currentInput[k] < 256)
-	compdots = table->compdotsPattern[currentInput[k]];
+      st->src = k;
+      /* Without a cursor to follow, a run of characters of one cell 
+       * each is put at once */
+      if (st->table->compCells && st->cursorStatus == 1
+	  && st->currentInput[k] < 256
+	  && ((widechar *) & st->table->ruleArea[st->table->compCells])
+	  [st->currentInput[k]])
+	{
+	  if (!putCompCells (st, end))
+	    return 0;
+	  /* src is left at the last character, as by the loop */
+	  st->src = k = st->src - 1;
+	  continue;
+	}
+      if (st->currentInput[k] < 256)
+	compdots = st->table->compdotsPattern[st->currentInput[k]];
       if (compdots != 0)
 	{
-	  transRule = (TranslationTableRule *) & table->ruleArea[compdots];
+	  st->transRule = (TranslationTableRule *) & st->table->ruleArea[compdots];
 	  if (!for_updatePositions
-	      (&transRule->charsdots[transRule->charslen],
-	       transRule->charslen, transRule->dotslen))
+	      (st, &st->transRule->charsdots[st->transRule->charslen],
+	       st->transRule->charslen, st->transRule->dotslen))
 	    return 0;
 	}
-      else if (!putCompChar (currentInput[k]))
+      else if (!putCompChar (st, st->currentInput[k]))
 	return 0;
     }
-  if (cursorStatus != 2 && brailleIndicatorDefined (table->endComp))
+  if (st->cursorStatus != 2 && brailleIndicatorDefined (st,
+							st->table->endComp))
     if (!for_updatePositions
-	(&indicRule->charsdots[0], 0, indicRule->dotslen))
+	(st, &st->indicRule->charsdots[0], 0, st->indicRule->dotslen))
       return 0;
-  src = end;
+  st->src = end;
   if (haveEndsegment)
     {
       widechar endSegment = ENDSEGMENT;
-      if (!for_updatePositions (&endSegment, 0, 1))
+      if (!for_updatePositions (st, &endSegment, 0, 1))
 	return 0;
     }
   return 1;
 }
 
 static int
-doNocont ()
+doNocont (TranslationState *st)
 {
 /*Handle strings containing substrings defined by the nocont opcode*/
-  if (checkAttr (currentInput[src], CTC_Space, 0) || dontContract
-      || (mode & noContractions))
+  if (checkInputAttr (st, st->src, CTC_Space)
+      || st->dontContract
+      || (st->mode & noContractions))
     return 1;
-  if (destword)
+  if (st->destword)
     {
-      src = srcword;
-      dest = destword;
+      st->src = st->srcword;
+      st->dest = st->destword;
     }
   else
     {
-      src = 0;
-      dest = 0;
+      st->src = 0;
+      st->dest = 0;
     }
-  dontContract = 1;
+  st->dontContract = 1;
   return 1;
 }
 
+static const TranslationTableRule *
+findSyllableRule (TranslationState *st)
+{
+/* The syllable rule at src: the first of those whose characters match 
+* where at least two are left, else the one of the character at src, 
+* as they come in the chains of rules */
+  const TranslationTableHeader *table = st->table;
+  const SyllableRule *rules =
+    (const SyllableRule *) & table->ruleArea[table->syllableRules];
+  const TranslationTableRule *rule;
+  const TranslationTableCharacter *character;
+  widechar c = st->currentInput[st->src];
+  int length = st->srcmax - st->src;
+  int k;
+  if (table->syllableFilter && length >= 2
+      && RULEPAIRBIT (table->ruleArea, table->syllableFilter,
+		      table->syllableFilterBits, inputLowercase (st, st->src),
+		      inputLowercase (st, st->src + 1)))
+    for (k = 0; k < table->numSyllableRules; k++)
+      {
+	rule = (const TranslationTableRule *) & table->ruleArea[rules[k].
+								rule];
+	if (rule->charslen <= length
+	    && matchRuleLowercase (st, rule, st->src))
+	  return rule;
+      }
+  if (!(table->syllableChars[(c & 0xff) >> 3] & (1 << (c & 7))))
+    return NULL;
+  character = findCharOrDots (st, c, 0);
+  for (k = table->numSyllableRules;
+       k < table->numSyllableRules + table->numSyllableChars; k++)
+    if (character == (const TranslationTableCharacter *) &
+	table->ruleArea[rules[k].character])
+      return (const TranslationTableRule *) & table->ruleArea[rules[k].
+							       rule];
+  return NULL;
+}
+
 static int
-markSyllables ()
+markSyllables (TranslationState *st)
 {
   int k;
   int syllableMarker = 0;
   int currentMark = 0;
-  if (typebuf == NULL || !table->syllables)
+  const TranslationTableRule *rule;
+  if (st->typebuf == NULL || !st->table->syllables)
     return 1;
-  src = 0;
-  while (src < srcmax)
-    {				/*the main multipass translation loop */
-      int length = srcmax - src;
-      const TranslationTableCharacter *character = findCharOrDots
-	(currentInput[src], 0);
-      const TranslationTableCharacter *character2;
-      int tryThis = 0;
-      while (tryThis < 3)
-	{
-	  TranslationTableOffset ruleOffset = 0;
-	  unsigned long int makeHash = 0;
-	  switch (tryThis)
-	    {
-	    case 0:
-	      if (!(length >= 2))
-		break;
-	      makeHash = (unsigned long int) character->lowercase << 8;
-		  //memory overflow when src == srcmax - 1
-	      character2 = findCharOrDots (currentInput[src + 1], 0);
-	      makeHash += (unsigned long int) character2->lowercase;
-	      makeHash %= HASHNUM;
-	      ruleOffset = table->forRules[makeHash];
-	      break;
-	    case 1:
-	      if (!(length >= 1))
-		break;
-	      length = 1;
-	      ruleOffset = character->otherRules;
-	      break;
-	    case 2:		/*No rule found */
-	      transOpcode = CTO_Always;
-	      ruleOffset = 0;
-	      break;
-	    }
-	  while (ruleOffset)
-	    {
-	      transRule =
-		(TranslationTableRule *) & table->ruleArea[ruleOffset];
-	      transOpcode = transRule->opcode;
-	      transCharslen = transRule->charslen;
-	      if (tryThis == 1 || (transCharslen <= length &&
-				   compareChars (&transRule->
-						 charsdots[0],
-						 &currentInput[src],
-						 transCharslen, 0)))
-		{
-		  if (transOpcode == CTO_Syllable)
-		    {
-		      tryThis = 4;
-		      break;
-		    }
-		}
-	      ruleOffset = transRule->charsnext;
-	    }
-	  tryThis++;
-	}
-      switch (transOpcode)
+  st->src = 0;
+  while (st->src < st->srcmax)
+    {
+      if (!st->table->syllableRules || !(rule = findSyllableRule (st)))
 	{
-	case CTO_Always:
-	  if (src >= srcmax)
-	    return 0;
-	  if (typebuf != NULL)
-	    typebuf[src++] |= currentMark;
-	  break;
-	case CTO_Syllable:
-	  syllableMarker++;
-	  if (syllableMarker > 3)
-	    syllableMarker = 1;
-	  currentMark = syllableMarker << 6;
-	  /*The syllable marker is bits 6 and 7 of typebuf. */
-	  if ((src + transCharslen) > srcmax)
-	    return 0;
-	  for (k = 0; k < transCharslen; k++)
-	    typebuf[src++] |= currentMark;
-	  break;
-	default:
-	  break;
+	  st->transOpcode = CTO_Always;
+	  st->typebuf[st->src++] |= currentMark;
+	  continue;
 	}
+      st->transRule = rule;
+      st->transOpcode = CTO_Syllable;
+      st->transCharslen = rule->charslen;
+      syllableMarker++;
+      if (syllableMarker > 3)
+	syllableMarker = 1;
+      currentMark = syllableMarker << 6;
+      /*The syllable marker is bits 6 and 7 of typebuf. */
+      if ((st->src + st->transCharslen) > st->srcmax)
+	return 0;
+      for (k = 0; k < st->transCharslen; k++)
+	st->typebuf[st->src++] |= currentMark;
+    }
+  return 1;
+}
+
+/* The word cache remembers the first pass translation of words of 
+* lowercase letters between spaces, with the state the translator is 
+* left in, and plays it back when the word comes again with the same 
+* surroundings. A word is remembered only if nothing outside it and the 
+* characters on either side was looked at to translate it. */
+
+#define WORDCACHEWORD 24	/*longest word remembered */
+#define WORDCACHEDOTS 48	/*longest translation remembered */
+
+typedef struct
+{
+  const TranslationTableHeader *table;
+  unsigned int hash;
+  int mode;
+  TranslationTableOpcode prevOpcode;	/*state before the word */
+  int dontContract;
+  int before;			/*character before the word, -1 at the start */
+  widechar after;
+  int length;
+  widechar chars[WORDCACHEWORD];
+  unsigned short marks[WORDCACHEWORD + 1];	/*typebuf of the word and 
+						   the character after it */
+  int dotslen;
+  widechar dots[WORDCACHEDOTS];
+  /*The state after the word */
+  TranslationTableOpcode transOpcode;
+  TranslationTableOpcode prevTransOpcode;
+  const TranslationTableRule *transRule;
+  int transCharslen;
+  TranslationTableCharacter *curCharDef;
+  int endDontContract;
+  int srcIncremented;
+  int prevSrc;			/*from the start of the word */
+  widechar beforeChar, afterChar;
+  TranslationTableCharacterAttributes beforeAttributes;
+  TranslationTableCharacterAttributes afterAttributes;
+  TranslationTableOpcode indicOpcode;
+  const TranslationTableRule *indicRule;
+  int newer, older;		/*least recently used list */
+  int chain;			/*next in the hash bucket */
+} WordCacheEntry;
+
+struct WordCache
+{
+  int size;
+  int used;
+  int generation;
+  int newest, oldest;
+  int numBuckets;		/*a power of two */
+  int *buckets;
+  WordCacheEntry *entries;
+};
+
+void
+freeWordCache (struct WordCache *cache)
+{
+  if (cache == NULL)
+    return;
+  free (cache->buckets);
+  free (cache->entries);
+  free (cache);
+}
+
+static void
+clearWordCache (struct WordCache *cache)
+{
+  int k;
+  for (k = 0; k < cache->numBuckets; k++)
+    cache->buckets[k] = -1;
+  cache->used = 0;
+  cache->newest = cache->oldest = -1;
+  cache->generation = getTableGeneration ();
+}
+
+static struct WordCache *
+getWordCache (louContext * ctx)
+{
+  struct WordCache *cache;
+  ctx = getContext (ctx);
+  if (!ctx->wordCacheSize)
+    return NULL;
+  if (!(cache = ctx->wordCache))
+    {
+      if (!(cache = calloc (1, sizeof (*cache)))
+	  || !(cache->entries = malloc (ctx->wordCacheSize
+					* sizeof (WordCacheEntry))))
+	outOfMemory ();
+      cache->size = ctx->wordCacheSize;
+      for (cache->numBuckets = 1; cache->numBuckets < cache->size;
+	   cache->numBuckets <<= 1);
+      if (!(cache->buckets = malloc (cache->numBuckets * sizeof (int))))
+	outOfMemory ();
+      clearWordCache (cache);
+      ctx->wordCache = cache;
+    }
+  else if (cache->generation != getTableGeneration ())
+    clearWordCache (cache);
+  return cache;
+}
+
+static void
+unlinkCachedWord (struct WordCache *cache, int k)
+{
+  WordCacheEntry *entry = &cache->entries[k];
+  if (entry->newer >= 0)
+    cache->entries[entry->newer].older = entry->older;
+  else
+    cache->newest = entry->older;
+  if (entry->older >= 0)
+    cache->entries[entry->older].newer = entry->newer;
+  else
+    cache->oldest = entry->newer;
+}
+
+static void
+makeNewestWord (struct WordCache *cache, int k)
+{
+  WordCacheEntry *entry = &cache->entries[k];
+  entry->newer = -1;
+  entry->older = cache->newest;
+  if (cache->newest >= 0)
+    cache->entries[cache->newest].newer = k;
+  else
+    cache->oldest = k;
+  cache->newest = k;
+}
+
+static int
+wordLength (TranslationState *st)
+{
+/*The number of lowercase letters starting a word at src and followed 
+* by a space, or 0 if it is not such a word */
+  TranslationTableCharacterAttributes attr;
+  int end;
+  if (st->src > 0 && (!checkInputAttr (st, st->src - 1, CTC_Space)
+		      || st->currentInput[st->src - 1] == ENDSEGMENT))
+    return 0;
+  for (end = st->src; end < st->srcmax && end - st->src <= WORDCACHEWORD;
+       end++)
+    {
+      attr = inputAttributes (st, end);
+      if (!(attr & CTC_Letter) || (attr & CTC_UpperCase))
+	break;
+    }
+  if (end == st->src || end == st->srcmax || end - st->src > WORDCACHEWORD
+      || !checkInputAttr (st, end, CTC_Space)
+      || st->currentInput[end] == ENDSEGMENT)
+    return 0;
+  return end - st->src;
+}
+
+static int
+isCachedWord (const WordCacheEntry * entry, TranslationState *st,
+	      int length)
+{
+  return entry->hash == st->wordHash && entry->table == st->table
+    && entry->mode == st->mode && entry->prevOpcode == st->prevTransOpcode
+    && entry->dontContract == st->dontContract && entry->length == length
+    && entry->before == (st->src > 0 ? st->currentInput[st->src - 1] : -1)
+    && entry->after == st->currentInput[st->src + length]
+    && !memcmp (entry->chars, &st->currentInput[st->src],
+		length * CHARSIZE)
+    && !memcmp (entry->marks, &st->typebuf[st->src],
+		(length + 1) * sizeof (unsigned short));
+}
+
+static int
+isStateAddress (TranslationState *st, const void *address)
+{
+  return (const char *) address >= (const char *) st
+    && (const char *) address < (const char *) (st + 1);
+}
+
+static void
+rememberWord (TranslationState *st)
+{
+/*Called when the translation of the word being remembered has reached 
+* its end */
+  struct WordCache *cache = st->wordCache;
+  WordCacheEntry *entry;
+  int length = st->wordLimit - st->wordStart;
+  int dotslen = st->dest - st->wordDest;
+  int k;
+  if (st->wordUnsafe || dotslen > WORDCACHEDOTS
+      || isStateAddress (st, st->transRule)
+      || isStateAddress (st, st->curCharDef))
+    return;
+  if (cache->used < cache->size)
+    k = cache->used++;
+  else
+    {
+      int *link;
+      k = cache->oldest;
+      unlinkCachedWord (cache, k);
+      for (link = &cache->buckets[cache->entries[k].hash
+				  & (cache->numBuckets - 1)];
+	   *link != k; link = &cache->entries[*link].chain);
+      *link = cache->entries[k].chain;
+    }
+  entry = &cache->entries[k];
+  entry->table = st->table;
+  entry->hash = st->wordHash;
+  entry->mode = st->mode;
+  entry->prevOpcode = st->wordPrevOpcode;
+  entry->dontContract = st->wordDontContract;
+  entry->before = st->wordStart > 0 ? st->currentInput[st->wordStart - 1] :
+    -1;
+  entry->after = st->currentInput[st->src];
+  entry->length = length;
+  memcpy (entry->chars, &st->currentInput[st->wordStart],
+	  length * CHARSIZE);
+  memcpy (entry->marks, &st->typebuf[st->wordStart],
+	  (length + 1) * sizeof (unsigned short));
+  entry->dotslen = dotslen;
+  memcpy (entry->dots, &st->currentOutput[st->wordDest],
+	  dotslen * CHARSIZE);
+  entry->transOpcode = st->transOpcode;
+  entry->prevTransOpcode = st->prevTransOpcode;
+  entry->transRule = st->transRule;
+  entry->transCharslen = st->transCharslen;
+  entry->curCharDef = st->curCharDef;
+  entry->endDontContract = st->dontContract;
+  entry->srcIncremented = st->srcIncremented;
+  entry->prevSrc = st->prevSrc - st->wordStart;
+  entry->beforeChar = st->before;
+  entry->afterChar = st->after;
+  entry->beforeAttributes = st->beforeAttributes;
+  entry->afterAttributes = st->afterAttributes;
+  entry->indicOpcode = st->indicOpcode;
+  entry->indicRule = st->indicRule;
+  entry->chain = cache->buckets[st->wordHash & (cache->numBuckets - 1)];
+  cache->buckets[st->wordHash & (cache->numBuckets - 1)] = k;
+  makeNewestWord (cache, k);
+}
+
+static int
+useWordCache (TranslationState *st)
+{
+/*Called at the top of the translation loop. Play back the translation 
+* of a remembered word starting at src and return 1, or start 
+* remembering it and return 0. */
+  struct WordCache *cache = st->wordCache;
+  const WordCacheEntry *entry;
+  unsigned int hash;
+  int length, k;
+  if (st->wordStart >= 0)
+    {
+      if (st->src == st->wordLimit)
+	rememberWord (st);
+      else if (st->src < st->wordLimit)
+	return 0;
+      st->wordStart = -1;
+      st->wordLimit = NOWORDLIMIT;
+    }
+  if (st->src == st->prevSrc || !(length = wordLength (st)))
+    return 0;
+  hash = 2166136261U;
+  for (k = -1; k <= length; k++)
+    hash = (hash ^ (st->src + k >= 0 ? st->currentInput[st->src + k] :
+		    0xffffffffU)) * 16777619U;
+  for (k = 0; k <= length; k++)
+    hash = (hash ^ st->typebuf[st->src + k]) * 16777619U;
+  hash = (hash ^ st->prevTransOpcode ^ (st->dontContract << 8)
+	  ^ ((unsigned int) st->mode << 9)) * 16777619U;
+  st->wordHash = hash;
+  for (k = cache->buckets[hash & (cache->numBuckets - 1)]; k >= 0;
+       k = entry->chain)
+    {
+      entry = &cache->entries[k];
+      if (isCachedWord (entry, st, length))
+	break;
+    }
+  if (k >= 0 && st->dest + entry->dotslen <= st->destmax)
+    {
+      memcpy (&st->currentOutput[st->dest], entry->dots,
+	      entry->dotslen * CHARSIZE);
+      st->dest += entry->dotslen;
+      st->transOpcode = entry->transOpcode;
+      st->prevTransOpcode = entry->prevTransOpcode;
+      st->transRule = entry->transRule;
+      st->transCharslen = entry->transCharslen;
+      st->curCharDef = entry->curCharDef;
+      st->dontContract = entry->endDontContract;
+      st->srcIncremented = entry->srcIncremented;
+      st->prevSrc = st->src + entry->prevSrc;
+      st->before = entry->beforeChar;
+      st->after = entry->afterChar;
+      st->beforeAttributes = entry->beforeAttributes;
+      st->afterAttributes = entry->afterAttributes;
+      st->indicOpcode = entry->indicOpcode;
+      st->indicRule = entry->indicRule;
+      st->src += length;
+      unlinkCachedWord (cache, k);
+      makeNewestWord (cache, k);
+      return 1;
+    }
+  st->wordStart = st->src;
+  st->wordLimit = st->src + length;
+  st->wordDest = st->dest;
+  st->wordUnsafe = 0;
+  st->wordPrevOpcode = st->prevTransOpcode;
+  st->wordDontContract = st->dontContract;
+  return 0;
+}
+
+static int
+copyFastLetters (TranslationState *st)
+{
+/*Called at the top of the translation loop. After a letter or a digit 
+* translated by its own rule, copy the cells of the plain letters, or 
+* digits, which follow (see markFastLetters), since the loop would find 
+* nothing else to do for them, and return 1. Otherwise return 0. A run 
+* stops where letters and digits meet, as a number or letter sign may 
+* go there. Within a run of emphasis the characters are copied up to 
+* where the emphasis changes or a word is marked for an indicator. */
+  TranslationTableCharacter *character = NULL;
+  TranslationTableCharacter *next;
+  TranslationTableCharacterAttributes kind;
+  if (st->transOpcode == CTO_Letter || st->transOpcode == CTO_LowerCase)
+    kind = CTC_Letter;
+  else if (st->transOpcode == CTO_Digit || st->transOpcode == CTO_LitDigit)
+    kind = CTC_Digit;
+  else
+    return 0;
+  if (st->transCharslen != 1 || st->prevSrc != st->src - 1
+      || st->cursorStatus != 1
+      || st->srcSpacing != NULL || st->appliedRules != NULL
+      || st->ruleProfile != NULL || st->overlay != NULL
+      || st->table->attribOrSwapRules[st->currentPass]
+      || !findCharOrDots (st, st->currentInput[st->src - 1], 0)->fastDots)
+    return 0;
+  /* Stop where a remembered word ends, for useWordCache */
+  while (st->src < st->srcmax && st->src < st->wordLimit
+	 && st->dest < st->destmax
+	 && (!st->haveEmphasis
+	     || (st->typebuf[st->src] & (EMPHASIS | STARTWORD | FIRSTWORD))
+	     == st->prevTypeform)
+	 && (next = findCharOrDots (st, st->currentInput[st->src],
+				    0))->fastDots && (next->attributes & kind))
+    {
+      character = next;
+      st->currentOutput[st->dest] = character->fastDots;
+      if (st->inputPositions != NULL)
+	st->srcMapping[st->dest] = st->prevSrcMapping[st->src];
+      if (st->outputPositions != NULL)
+	st->outputPositions[st->prevSrcMapping[st->src]] = st->dest;
+      st->dest++;
+      st->src++;
     }
+  if (character == NULL)
+    return 0;
+  st->curCharDef = character;
+  st->transRule = (TranslationTableRule *) &
+    st->table->ruleArea[character->otherRules];
+  st->transOpcode = st->prevTransOpcode = st->transRule->opcode;
+  st->prevSrc = st->src - 1;
+  st->srcIncremented = 1;
   return 1;
 }
 
 static int
-translateString ()
+translateString (TranslationState *st)
 {
 /*Main translation routine */
   int k;
-  markSyllables ();
-  srcword = 0;
-  destword = 0;        		/* last word translated */
-  dontContract = 0;
-  prevTransOpcode = CTO_None;
-  wordsMarked = 0;
-  prevType = prevPrevType = curType = nextType = prevTypeform = plain_text;
-  startType = prevSrc = -1;
-  src = dest = 0;
-  srcIncremented = 1;
-  memset (passVariables, 0, sizeof(int) * NUMVAR);
-  if (typebuf && table->capitalSign)
-    for (k = 0; k < srcmax; k++)
-      if (checkAttr (currentInput[k], CTC_UpperCase, 0))
-        typebuf[k] |= capsemph;
-  while (src < srcmax)
+  int swapped;
+  const TranslationTableCharacter *character;
+  /* Look up every input character once, for all the stages below, and 
+   * mark the capitals in typebuf */
+  for (k = 0; k < st->srcmax; k++)
+    {
+      character = findCharOrDots (st, st->currentInput[k], 0);
+      st->attributesBuffer[k] = character->attributes;
+      st->lowercaseBuffer[k] = character->lowercase;
+      if ((character->attributes & CTC_UpperCase) && st->typebuf
+	  && st->table->capitalSign)
+	st->typebuf[k] |= capsemph;
+    }
+  st->inputAttributesBuffer = st->attributesBuffer;
+  st->inputLowercaseBuffer = st->lowercaseBuffer;
+  markSyllables (st);
+  traceEvent (louTracePass, 0, 1, 0, 0, 0);
+  st->srcword = 0;
+  st->destword = 0;        		/* last word translated */
+  st->dontContract = 0;
+  st->prevTransOpcode = CTO_None;
+  st->wordsMarked = 0;
+  st->prevType = st->prevPrevType = st->curType = st->nextType = st->prevTypeform = plain_text;
+  st->startType = st->prevSrc = -1;
+  st->src = st->dest = 0;
+  st->hyphenInput = NULL;
+  st->srcIncremented = 1;
+  memset (st->passVariables, 0, sizeof(int) * NUMVAR);
+  while (st->src < st->srcmax)
     {        			/*the main translation loop */
-      setBefore ();
-      if (!insertBrailleIndicators (0))
+      if (outOfWork (&st->work))
+	goto failure;
+      if (st->wordCache && useWordCache (st))
+	continue;
+      if (copyFastLetters (st))
+	continue;
+      setBefore (st);
+      if (!insertBrailleIndicators (st, 0))
         goto failure;
-      if (src >= srcmax)
+      if (st->src >= st->srcmax)
         break;
-      if (!insertIndicators ())
+      if (!insertIndicators (st))
         goto failure;
-      for_selectRule ();
-      if (appliedRules != NULL && appliedRulesCount < maxAppliedRules)
-        appliedRules[appliedRulesCount++] = transRule;
-      srcIncremented = 1;
-      prevSrc = src;
-      switch (transOpcode)        /*Rules that pre-empt context and swap */
+      for_selectRule (st);
+      ruleApplied (st);
+      st->srcIncremented = 1;
+      st->prevSrc = st->src;
+      switch (st->transOpcode)        /*Rules that pre-empt context and swap */
         {
         case CTO_CompBrl:
         case CTO_Literal:
-          if (!doCompbrl ())
+          if (!doCompbrl (st))
             goto failure;
           continue;
         default:
           break;
         }
-      if (!insertBrailleIndicators (1))
+      if (!insertBrailleIndicators (st, 1))
         goto failure;
-      if (transOpcode == CTO_Context || findAttribOrSwapRules ())
-        switch (transOpcode)
+      swapped = 0;
+      if (st->transOpcode == CTO_Context
+	  || (swapped = findAttribOrSwapRules (st)))
+        switch (st->transOpcode)
           {
           case CTO_Context:
-            if (appliedRules != NULL && appliedRulesCount < maxAppliedRules)
-              appliedRules[appliedRulesCount++] = transRule;
-            if (!passDoAction ())
+	    /* A context rule of for_selectRule has been counted already */
+	    if (swapped)
+	      ruleApplied (st);
+	    else if (st->appliedRules != NULL
+		     && st->appliedRulesCount < st->maxAppliedRules)
+              st->appliedRules[st->appliedRulesCount++] = st->transRule;
+            if (!passDoAction (st))
               goto failure;
-            if (endReplace == src)
-              srcIncremented = 0;
-            src = endReplace;
+            if (st->endReplace == st->src)
+              st->srcIncremented = 0;
+            st->src = st->endReplace;
             continue;
           default:
             break;
           }
 
 /*Processing before replacement*/
-      switch (transOpcode)
+      switch (st->transOpcode)
         {
         case CTO_EndNum:
-          if (table->letterSign && checkAttr (currentInput[src],
-        				      CTC_Letter, 0))
-            dest--;
+	  if (st->table->letterSign
+	      && checkInputAttr (st, st->src, CTC_Letter))
+            st->dest--;
           break;
         case CTO_Repeated:
         case CTO_Space:
-          dontContract = 0;
+          st->dontContract = 0;
           break;
         case CTO_LargeSign:
-          if (prevTransOpcode == CTO_LargeSign)
+          if (st->prevTransOpcode == CTO_LargeSign)
           {
             int hasEndSegment = 0;
-            while (dest > 0 && checkAttr (currentOutput[dest - 1], CTC_Space, 1))
+	    while (st->dest > 0 && checkAttr (st,
+					      st->currentOutput[st->dest - 1], CTC_Space, 1))
             {
-              if (currentOutput[dest - 1] == ENDSEGMENT)
+              if (st->currentOutput[st->dest - 1] == ENDSEGMENT)
               {
                 hasEndSegment = 1;
               }
-              dest--;
+              st->dest--;
             }
             if (hasEndSegment != 0)
             {
-              currentOutput[dest] = 0xffff;
-              dest++;
+              st->currentOutput[st->dest] = 0xffff;
+              st->dest++;
             }
           }
           break;
         case CTO_DecPoint:
-          if (table->numberSign)
+          if (st->table->numberSign)
             {
               TranslationTableRule *numRule = (TranslationTableRule *)
-        	& table->ruleArea[table->numberSign];
+        	& st->table->ruleArea[st->table->numberSign];
               if (!for_updatePositions
-        	  (&numRule->charsdots[numRule->charslen],
+        	  (st, &numRule->charsdots[numRule->charslen],
         	   numRule->charslen, numRule->dotslen))
         	goto failure;
             }
-          transOpcode = CTO_MidNum;
+          st->transOpcode = CTO_MidNum;
           break;
         case CTO_NoCont:
-          if (!dontContract)
-            doNocont ();
+          if (!st->dontContract)
+            doNocont (st);
           continue;
         default:
           break;
         }			/*end of action */
 
       /* replacement processing */
-      switch (transOpcode)
+      switch (st->transOpcode)
         {
         case CTO_Replace:
-          src += transCharslen;
+          st->src += st->transCharslen;
           if (!putCharacters
-              (&transRule->charsdots[transCharslen], transRule->dotslen))
+	      (st, &st->transRule->charsdots[st->transCharslen],
+	       st->transRule->dotslen))
             goto failure;
           break;
         case CTO_None:
-          if (!undefinedCharacter (currentInput[src]))
+          if (!undefinedCharacter (st, st->currentInput[st->src]))
             goto failure;
-          src++;
+          st->src++;
           break;
         case CTO_UpperCase:
           /* Only needs special handling if not within compbrl and
            *the table defines a capital sign. */
           if (!
-              (mode & (compbrlAtCursor | compbrlLeftCursor) && src >=
-               compbrlStart
-               && src <= compbrlEnd) && (transRule->dotslen == 1
-        				 && table->capitalSign))
+              (st->mode & (compbrlAtCursor | compbrlLeftCursor) && st->src >=
+               st->compbrlStart
+               && st->src <= st->compbrlEnd) && (st->transRule->dotslen == 1
+        				 && st->table->capitalSign))
             {
-              putCharacter (curCharDef->lowercase);
-              src++;
+              putCharacter (st, st->curCharDef->lowercase);
+              st->src++;
               break;
             }
         default:
-          if (cursorStatus == 2)
-            cursorStatus = 1;
+          if (st->cursorStatus == 2)
+            st->cursorStatus = 1;
           else
             {
-              if (transRule->dotslen)
+              if (st->transRule->dotslen)
         	{
         	  if (!for_updatePositions
-        	      (&transRule->charsdots[transCharslen],
-        	       transCharslen, transRule->dotslen))
+        	      (st, &st->transRule->charsdots[st->transCharslen],
+        	       st->transCharslen, st->transRule->dotslen))
         	    goto failure;
         	}
               else
         	{
-        	  for (k = 0; k < transCharslen; k++)
+        	  for (k = 0; k < st->transCharslen; k++)
         	    {
-        	      if (!putCharacter (currentInput[src]))
+        	      if (!putCharacter (st, st->currentInput[st->src]))
         		goto failure;
-        	      src++;
+        	      st->src++;
         	    }
         	}
-              if (cursorStatus == 2)
-        	cursorStatus = 1;
-              else if (transRule->dotslen)
-        	src += transCharslen;
+              if (st->cursorStatus == 2)
+        	st->cursorStatus = 1;
+              else if (st->transRule->dotslen)
+        	st->src += st->transCharslen;
             }
           break;
         }
 
       /* processing after replacement */
-      switch (transOpcode)
+      switch (st->transOpcode)
         {
         case CTO_Repeated:
           {
             /* Skip repeated characters. */
-            int srclim = srcmax - transCharslen;
-            if (mode & (compbrlAtCursor | compbrlLeftCursor) &&
-        	compbrlStart < srclim)
+            int srclim = st->srcmax - st->transCharslen;
+            if (st->mode & (compbrlAtCursor | compbrlLeftCursor) &&
+        	st->compbrlStart < srclim)
               /* Don't skip characters from compbrlStart onwards. */
-              srclim = compbrlStart - 1;
-            while ((src <= srclim)
-        	   && compareChars (&transRule->charsdots[0],
-        			    &currentInput[src], transCharslen, 0))
+              srclim = st->compbrlStart - 1;
+            while ((st->src <= srclim)
+        	   && compareChars (st, &st->transRule->charsdots[0],
+        			    &st->currentInput[st->src], st->transCharslen, 0))
               {
         	/* Map skipped input positions to the previous output position. */
-        	if (outputPositions != NULL)
+        	if (st->outputPositions != NULL)
         	  {
         	    int tcc;
-        	    for (tcc = 0; tcc < transCharslen; tcc++)
-        	      outputPositions[prevSrcMapping[src + tcc]] = dest - 1;
+        	    for (tcc = 0; tcc < st->transCharslen; tcc++)
+        	      st->outputPositions[st->prevSrcMapping[st->src + tcc]] = st->dest - 1;
         	  }
-        	if (!cursorStatus && src <= cursorPosition
-        	    && cursorPosition < src + transCharslen)
+        	if (!st->cursorStatus && st->src <= st->cursorPosition
+        	    && st->cursorPosition < st->src + st->transCharslen)
         	  {
-        	    cursorStatus = 1;
-        	    cursorPosition = dest - 1;
+        	    st->cursorStatus = 1;
+        	    st->cursorPosition = st->dest - 1;
         	  }
-        	src += transCharslen;
+        	st->src += st->transCharslen;
               }
             break;
           }
         case CTO_RepWord:
           {
             /* Skip repeated characters. */
-            int srclim = srcmax - transCharslen;
-            if (mode & (compbrlAtCursor | compbrlLeftCursor) &&
-        	compbrlStart < srclim)
+            int srclim = st->srcmax - st->transCharslen;
+            if (st->mode & (compbrlAtCursor | compbrlLeftCursor) &&
+        	st->compbrlStart < srclim)
               /* Don't skip characters from compbrlStart onwards. */
-              srclim = compbrlStart - 1;
-            while ((src <= srclim)
-        	   && compareChars (repwordStart,
-        			    &currentInput[src], repwordLength, 0))
+              srclim = st->compbrlStart - 1;
+            while ((st->src <= srclim)
+        	   && compareChars (st, st->repwordStart,
+        			    &st->currentInput[st->src], st->repwordLength, 0))
               {
         	/* Map skipped input positions to the previous output position. */
-        	if (outputPositions != NULL)
+        	if (st->outputPositions != NULL)
         	  {
         	    int tcc;
-        	    for (tcc = 0; tcc < transCharslen; tcc++)
-        	      outputPositions[prevSrcMapping[src + tcc]] = dest - 1;
+        	    for (tcc = 0; tcc < st->transCharslen; tcc++)
+        	      st->outputPositions[st->prevSrcMapping[st->src + tcc]] = st->dest - 1;
         	  }
-        	if (!cursorStatus && src <= cursorPosition
-        	    && cursorPosition < src + transCharslen)
+        	if (!st->cursorStatus && st->src <= st->cursorPosition
+        	    && st->cursorPosition < st->src + st->transCharslen)
         	  {
-        	    cursorStatus = 1;
-        	    cursorPosition = dest - 1;
+        	    st->cursorStatus = 1;
+        	    st->cursorPosition = st->dest - 1;
         	  }
-        	src += repwordLength + transCharslen;
+        	st->src += st->repwordLength + st->transCharslen;
               }
-            src -= transCharslen;
+            st->src -= st->transCharslen;
             break;
           }
         case CTO_JoinNum:
         case CTO_JoinableWord:
-          while (src < srcmax
-        	 && checkAttr (currentInput[src], CTC_Space, 0) &&
-        	 currentInput[src] != ENDSEGMENT)
-            src++;
+          while (st->src < st->srcmax
+        	 && checkInputAttr (st, st->src, CTC_Space) &&
+        	 st->currentInput[st->src] != ENDSEGMENT)
+            st->src++;
           break;
         default:
           break;
         }
-      if (((src > 0) && checkAttr (currentInput[src - 1], CTC_Space, 0)
-           && (transOpcode != CTO_JoinableWord)))
+      if (((st->src > 0) && checkInputAttr (st, st->src - 1, CTC_Space)
+           && (st->transOpcode != CTO_JoinableWord)))
         {
-          srcword = src;
-          destword = dest;
+          st->srcword = st->src;
+          st->destword = st->dest;
         }
-      if (srcSpacing != NULL && srcSpacing[src] >= '0' && srcSpacing[src] <=
+      if (st->srcSpacing != NULL && st->srcSpacing[st->src] >= '0'
+	  && st->srcSpacing[st->src] <=
           '9')
-        destSpacing[dest] = srcSpacing[src];
-      if ((transOpcode >= CTO_Always && transOpcode <= CTO_None) ||
-          (transOpcode >= CTO_Digit && transOpcode <= CTO_LitDigit))
-        prevTransOpcode = transOpcode;
+        st->destSpacing[st->dest] = st->srcSpacing[st->src];
+      if ((st->transOpcode >= CTO_Always && st->transOpcode <= CTO_None) ||
+          (st->transOpcode >= CTO_Digit && st->transOpcode <= CTO_LitDigit))
+        st->prevTransOpcode = st->transOpcode;
     }        			/*end of translation loop */
-  if (haveEmphasis && !wordsMarked && prevTypeform != plain_text
-      && src > 2 && typebuf[src - 1] == typebuf[src - 2])
-    insertBrailleIndicators (2);
+  if (st->haveEmphasis && !st->wordsMarked && st->prevTypeform != plain_text
+      && st->src > 2 && st->typebuf[st->src - 1] == st->typebuf[st->src - 2])
+    insertBrailleIndicators (st, 2);
 failure:
-  if (destword != 0 && src < srcmax
-      && !checkAttr (currentInput[src], CTC_Space, 0))
+  if (st->destword != 0 && st->src < st->srcmax
+      && !checkInputAttr (st, st->src, CTC_Space))
     {
-      src = srcword;
-      dest = destword;
+      st->src = st->srcword;
+      st->dest = st->destword;
     }
-  if (src < srcmax)
+  if (st->src < st->srcmax)
     {
-      while (checkAttr (currentInput[src], CTC_Space, 0))
-        if (++src == srcmax)
+      /* Undefined characters count as spaces, but have not been put out */
+      while (checkInputAttr (st, st->src, CTC_Space)
+	     && findCharOrDots (st, st->currentInput[st->src], 0)
+	     != &st->noChar)
+        if (++st->src == st->srcmax)
           break;
     }
-  realInlen = src;
+  st->realInlen = st->src;
+  /* Later passes have other input */
+  st->inputAttributesBuffer = NULL;
+  st->inputLowercaseBuffer = NULL;
   return 1;
 }        			/*first pass translation completed */
 
 int EXPORT_CALL
 lou_hyphenate (const char *tableList, const widechar
 	       * inbuf, int inlen, char *hyphens, int mode)
+{
+  const louTable *handle = lou_openTable (tableList);
+  int rv = hyphenateWithTable (getTableFromHandle (handle), inbuf, inlen,
+			       hyphens, mode);
+  lou_closeTable (handle);
+  return rv;
+}
+
+int EXPORT_CALL
+lou_hyphenateWithTable (const louTable * handle, const widechar * inbuf,
+			int inlen, char *hyphens, int mode)
+{
+  return hyphenateWithTable (getTableFromHandle (handle), inbuf, inlen,
+			     hyphens, mode);
+}
+
+int EXPORT_CALL
+lou_hyphenateText (const char *tableList, const widechar * inbuf,
+		   int inlen, char *hyphens)
+{
+  const louTable *handle = lou_openTable (tableList);
+  int rv = hyphenateTextWithTable (getTableFromHandle (handle), inbuf,
+				   inlen, hyphens);
+  lou_closeTable (handle);
+  return rv;
+}
+
+int EXPORT_CALL
+lou_hyphenateTextWithTable (const louTable * handle,
+			    const widechar * inbuf, int inlen, char *hyphens)
+{
+  return hyphenateTextWithTable (getTableFromHandle (handle), inbuf, inlen,
+				 hyphens);
+}
+
+static int
+hyphenateTextWithTable (const TranslationTableHeader * table,
+			const widechar * inbuf, int inlen, char *hyphens)
+{
+/* Every run of letters is a word. The lowercase letters are laid out
+* once in prepText with a period in place of everything else, so that
+* each word is found there between two periods as hyphenateWord wants
+* it. */
+  widechar localText[MAXSTRING];
+  widechar *prepText = localText;
+  int k, wordStart;
+  TranslationState state;
+  TranslationState *st = &state;
+  TranslationTableCharacter *c;
+  initTranslationState (st);
+  if (table && table->lazyHyphenation)
+    table = completeTable (table, LOU_LAZY_HYPHENATION);
+  st->table = table;
+  if (table == NULL || inbuf == NULL || hyphens == NULL || inlen < 0
+      || table->hyphenStatesArray == 0)
+    return 0;
+  if (inlen + 2 > MAXSTRING && !(prepText = (widechar *)
+				 malloc ((inlen + 2) * CHARSIZE)))
+    outOfMemory ();
+  prepText[0] = '.';
+  for (k = 0; k < inlen; k++)
+    {
+      c = findCharOrDots (st, inbuf[k], 0);
+      prepText[k + 1] = (c->attributes & CTC_Letter) ? c->lowercase : '.';
+    }
+  prepText[inlen + 1] = '.';
+  k = 0;
+  while (k < inlen)
+    {
+      if (prepText[k + 1] == '.')
+	{
+	  hyphens[k++] = '0';
+	  continue;
+	}
+      wordStart = k;
+      while (k < inlen && prepText[k + 1] != '.')
+	k++;
+      hyphenateWord (table, &prepText[wordStart], k - wordStart,
+		     &hyphens[wordStart]);
+      hyphens[wordStart] = '0';
+    }
+  for (k = 0; k < inlen; k++)
+    if (hyphens[k] & 1)
+      hyphens[k] = '1';
+    else
+      hyphens[k] = '0';
+  hyphens[inlen] = 0;
+  if (prepText != localText)
+    free (prepText);
+  return 1;
+}
+
+static int
+hyphenateWithTable (const TranslationTableHeader * table,
+		    const widechar * inbuf, int inlen, char *hyphens,
+		    int mode)
 {
 #define HYPHSTRING 100
   widechar workingBuffer[HYPHSTRING];
   int k, kk;
   int wordStart;
   int wordEnd;
-  table = lou_getTable (tableList);
-  if (table == NULL || inbuf == NULL || hyphens
-      == NULL || table->hyphenStatesArray == 0 || inlen >= HYPHSTRING)
+  TranslationState state;
+  TranslationState *st = &state;
+  initTranslationState (st);
+  if (table && table->lazyHyphenation)
+    table = completeTable (table, LOU_LAZY_HYPHENATION);
+  st->table = table;
+  if (st->table == NULL || inbuf == NULL || hyphens
+      == NULL || st->table->hyphenStatesArray == 0 || inlen >= HYPHSTRING)
     return 0;
   if (mode != 0)
     {
       k = inlen;
       kk = HYPHSTRING;
-      if (!lou_backTranslate (tableList, inbuf, &k,
-			      &workingBuffer[0],
-			      &kk, NULL, NULL, NULL, NULL, NULL, 0))
+      if (!backTranslateWithTable (NULL, table, inbuf, &k,
+				   &workingBuffer[0], &kk, NULL, NULL, NULL,
+				   NULL, NULL, 0))
 	return 0;
     }
   else
@@ -2109,23 +4710,23 @@ lou_hyphenate (const char *tableList, const widechar
       kk = inlen;
     }
   for (wordStart = 0; wordStart < kk; wordStart++)
-    if (((findCharOrDots (workingBuffer[wordStart], 0))->attributes &
+    if (((findCharOrDots (st, workingBuffer[wordStart], 0))->attributes &
 	 CTC_Letter))
       break;
   if (wordStart == kk)
     return 0;
   for (wordEnd = kk - 1; wordEnd >= 0; wordEnd--)
-    if (((findCharOrDots (workingBuffer[wordEnd], 0))->attributes &
+    if (((findCharOrDots (st, workingBuffer[wordEnd], 0))->attributes &
 	 CTC_Letter))
       break;
   for (k = wordStart; k <= wordEnd; k++)
     {
-      TranslationTableCharacter *c = findCharOrDots (workingBuffer[k], 0);
+      TranslationTableCharacter *c = findCharOrDots (st, workingBuffer[k], 0);
       if (!(c->attributes & CTC_Letter))
 	return 0;
     }
   if (!hyphenate
-      (&workingBuffer[wordStart], wordEnd - wordStart + 1,
+      (st, &workingBuffer[wordStart], wordEnd - wordStart + 1,
        &hyphens[wordStart]))
     return 0;
   for (k = 0; k <= wordStart; k++)
@@ -2137,9 +4738,9 @@ lou_hyphenate (const char *tableList, const widechar
       char hyphens2[HYPHSTRING];
       kk = wordEnd - wordStart + 1;
       k = HYPHSTRING;
-      if (!lou_translate (tableList, &workingBuffer[wordStart], &kk,
-			  &workingBuffer2[0], &k, NULL,
-			  NULL, &outputPos[0], NULL, NULL, 0))
+      if (!translateWithTable (NULL, table, &workingBuffer[wordStart], &kk,
+			       &workingBuffer2[0], &k, NULL, NULL,
+			       &outputPos[0], NULL, NULL, NULL, NULL, 0))
 	return 0;
       for (kk = 0; kk < k; kk++)
 	{
@@ -2152,12 +4753,12 @@ lou_hyphenate (const char *tableList, const widechar
 	    hyphens2[hyphPos] = '0';
 	}
       for (kk = wordStart; kk < wordStart + k; kk++)
-	if (!table->noBreak || hyphens2[kk] == '0')
+	if (!st->table->noBreak || hyphens2[kk] == '0')
 	  hyphens[kk] = hyphens2[kk];
 	else
 	  {
 	    TranslationTableRule *noBreakRule = (TranslationTableRule *)
-	      & table->ruleArea[table->noBreak];
+	      & st->table->ruleArea[st->table->noBreak];
 	    int kkk;
 	    if (kk > 0)
 	      for (kkk = 0; kkk < noBreakRule->charslen; kkk++)
@@ -2188,22 +4789,34 @@ int EXPORT_CALL
 lou_dotsToChar (const char *tableList, widechar * inbuf, widechar * outbuf,
 		int length, int mode)
 {
-  int k;
-  widechar dots;
+  const louTable *handle;
+  int rv;
   if (tableList == NULL || inbuf == NULL || outbuf == NULL)
     return 0;
   if ((mode & otherTrans))
     return other_dotsToChar (tableList, inbuf, outbuf, length, mode);
-  table = lou_getTable (tableList);
-  if (table == NULL || length <= 0)
+  handle = lou_openTable (tableList);
+  rv = dotsToCharWithTable (getTableFromHandle (handle), inbuf, outbuf,
+			    length);
+  lou_closeTable (handle);
+  return rv;
+}
+
+int EXPORT_CALL
+lou_dotsToCharWithTable (const louTable * handle, widechar * inbuf,
+			 widechar * outbuf, int length, int mode)
+{
+  return dotsToCharWithTable (getTableFromHandle (handle), inbuf, outbuf,
+			      length);
+}
+
+static int
+dotsToCharWithTable (const TranslationTableHeader * table, widechar * inbuf,
+		     widechar * outbuf, int length)
+{
+  if (table == NULL || inbuf == NULL || outbuf == NULL || length <= 0)
     return 0;
-  for (k = 0; k < length; k++)
-    {
-      dots = inbuf[k];
-      if (!(dots & B16) && (dots & 0xff00) == 0x2800)	/*Unicode braille */
-	dots = (dots & 0x00ff) | B16;
-      outbuf[k] = getCharFromDots (dots);
-    }
+  getCharsFromDotsInTable (table, inbuf, outbuf, length);
   return 1;
 }
 
@@ -2211,19 +4824,38 @@ int EXPORT_CALL
 lou_charToDots (const char *tableList, const widechar * inbuf, widechar *
 		outbuf, int length, int mode)
 {
-  int k;
+  const louTable *handle;
+  int rv;
   if (tableList == NULL || inbuf == NULL || outbuf == NULL)
     return 0;
   if ((mode & otherTrans))
     return other_charToDots (tableList, inbuf, outbuf, length, mode);
+  handle = lou_openTable (tableList);
+  rv = charToDotsWithTable (getTableFromHandle (handle), inbuf, outbuf,
+			    length, mode);
+  lou_closeTable (handle);
+  return rv;
+}
+
+int EXPORT_CALL
+lou_charToDotsWithTable (const louTable * handle, const widechar * inbuf,
+			 widechar * outbuf, int length, int mode)
+{
+  return charToDotsWithTable (getTableFromHandle (handle), inbuf, outbuf,
+			      length, mode);
+}
 
-  table = lou_getTable (tableList);
-  if (table == NULL || length <= 0)
+static int
+charToDotsWithTable (const TranslationTableHeader * table,
+		     const widechar * inbuf, widechar * outbuf, int length,
+		     int mode)
+{
+  int k;
+  if (table == NULL || inbuf == NULL || outbuf == NULL || length <= 0)
     return 0;
-  for (k = 0; k < length; k++)
-    if ((mode & ucBrl))
-      outbuf[k] = ((getDotsForChar (inbuf[k]) & 0xff) | 0x2800);
-    else
-      outbuf[k] = getDotsForChar (inbuf[k]);
+  getDotsForCharsInTable (table, inbuf, outbuf, length);
+  if ((mode & ucBrl))
+    for (k = 0; k < length; k++)
+      outbuf[k] = (outbuf[k] & 0xff) | 0x2800;
   return 1;
 }
@@ -69,10 +69,72 @@ extern "C"
 /*HASHNUM must be prime */
 #define HASHNUM 1123
 
+/* The forRules chain of a rule whose characters begin with c1 and c2, 
+* once they are spread over 1 << bits chains to suit the table. The 
+* characters are mixed together so that those of any script spread 
+* well. */
+#define FORRULEHASH(c1, c2, bits) \
+  ((int) (((((unsigned long int) (c1) * 0x9e3779b1UL + (c2)) \
+	    * 0x85ebca6bUL) & 0xffffffffUL) >> (32 - (bits))))
+
+/* Whether a rule beginning with c1 and c2 may have set its bit in the 
+* filter of 1 << bits bits at filter in the rule area. A pair whose bit 
+* is clear begins no rule. */
+#define RULEPAIRBIT(ruleArea, filter, bits, c1, c2) \
+  ((ruleArea)[(filter) + FORRULEHASH (c1, c2, bits) / 32] \
+   & (1U << (FORRULEHASH (c1, c2, bits) % 32)))
+
+/* Characters and dot patterns below CHARINDEXSIZE are found through a 
+* two-level index of CHARINDEXPAGE-entry pages instead of the hash 
+* chains. */
+#define CHARINDEXPAGE 256
+#if UNICODEBITS == 16
+#define CHARINDEXSIZE 0x10000
+#define INCHARINDEX(c) 1	/*every 16-bit widechar is in the index */
+#else
+#define CHARINDEXSIZE 0x110000
+#define INCHARINDEX(c) ((c) < CHARINDEXSIZE)
+#endif
+
+/* The nodes of the trie of backward rules are no deeper than this, so 
+* back-translation can keep the nodes it passes in arrays. */
+#define BACKTRIEDEPTH 16
+
+/* How many of the first characters, or cells, of a rule of a trie are 
+* kept with the trie, so that choosing it need not look at the rule 
+* itself unless they match. */
+#define TRIERULEPREFIX 4
+
+/* A word of the whole-word index is hashed twice, a lowercase character 
+* at a time: from the seed of the index for the bucket, in the low bits, 
+* and from 0 for wordIndexSlot, which gives the slot of its rule from the 
+* displacement of the bucket. */
+#define WORDINDEXHASH(hash, c) (((hash) ^ (unsigned int) (c)) * 16777619U)
+#define WORDINDEXSLOTHASH(hash, c) \
+  (((hash) + (unsigned int) (c) + 1) * 0x9e3779b1U)
+
+/* Longer words are left in the trie */
+#define MAXINDEXEDWORD 64
+
 #define MAXSTRING 2048
 
+/* Offsets count the slots of ruleArea, which are four bytes, from its 
+* start. Tables compiled with 2-byte offsets, see OFFSETBITS, are 
+* smaller but cannot have more than 65535 slots. */
+#if OFFSETBITS == 16
+  typedef unsigned short int TranslationTableOffset;
+#else
   typedef unsigned int TranslationTableOffset;
+#endif
 #define OFFSETSIZE sizeof (TranslationTableOffset)
+#define MAXTABLEOFFSET ((TranslationTableOffset) -1)
+
+  typedef unsigned int TranslationTableSlot;
+#define SLOTSIZE sizeof (TranslationTableSlot)
+
+/* The array of offsets kept in ruleArea at offset */
+#define OFFSETARRAY(ruleArea, offset) \
+  ((TranslationTableOffset *) &(ruleArea)[offset])
 
   typedef enum
   {
@@ -178,9 +240,7 @@ extern "C"
     widechar realchar;
     widechar uppercase;
     widechar lowercase;
-#if UNICODEBITS == 16
-    widechar padding;
-#endif
+    widechar fastDots;		/*cell of a plain lowercase letter, or 0 */
   } TranslationTableCharacter;
 
   typedef enum
@@ -363,13 +423,15 @@ extern "C"
     short charslen;		/*length of string to be replaced */
     short dotslen;		/*length of replacement string */
     widechar charsdots[DEFAULTRULESIZE];	/*find and replacement 
-						   strings */
+						   strings, and for a rule 
+						   in a forRules chain the 
+						   find string in lowercase */
   } TranslationTableRule;
 
   typedef struct		/*state transition */
   {
     widechar ch;
-    widechar newState;
+    TranslationTableOffset newState;
   } HyphenationTrans;
 
   typedef union
@@ -380,12 +442,91 @@ extern "C"
 
   typedef struct		/*one state */
   {
-    PointOff trans;
-    TranslationTableOffset hyphenPattern;
-    widechar fallbackState;
+    PointOff trans;		/*sorted by character */
+    TranslationTableOffset hyphenPattern;	/*length byte, then digits */
+    TranslationTableOffset fallbackState;
     widechar numTrans;
   } HyphenationState;
 
+  typedef struct
+  {
+    widechar ch;
+    TranslationTableOffset node;
+  } ForRuleEdge;
+
+  typedef struct		/*where a character or cell is among the 
+				   matches of a swap rule */
+  {
+    widechar ch;
+    widechar match;		/*its first place */
+    widechar replacement;	/*where the replacement for that place 
+				   begins, or dotslen if it has none */
+  } SwapMatch;
+
+  typedef struct		/*the matches of a swap rule sorted by 
+				   character. The charsnext of a swap rule, 
+				   which is in no chain, points to it. */
+  {
+    int count;
+    SwapMatch matches[1];
+  } SwapIndex;
+
+  typedef struct		/*what the character at which a rule of an 
+				   attribOrSwapRules chain is tried must be */
+  {
+    TranslationTableOffset rule;	/*0 after the last rule */
+    TranslationTableCharacterAttributes attributes;	/*one of these, 
+							   if not 0 */
+    TranslationTableOffset swapRule;	/*one of the characters 
+					   replaced by this rule, if not 0 */
+    widechar ch;		/*this character, if not 0 */
+  } PassRuleGuard;
+
+  typedef struct		/*the characters at which a rule of a 
+				   pass may begin to match */
+  {
+    int anywhere;		/*any character */
+    TranslationTableCharacterAttributes attributes;	/*a character 
+							   with one of these */
+    unsigned char chars[32];	/*a character whose low eight bits are 
+				   set here */
+  } PassStartFilter;
+
+  typedef struct		/*a rule markSyllables tries */
+  {
+    TranslationTableOffset rule;
+    TranslationTableOffset character;	/*0 where the characters of the 
+					   rule match, else the character 
+					   in whose otherRules it is the 
+					   first syllable rule */
+  } SyllableRule;
+
+  typedef struct		/*node of the trie of forward or of 
+				   backward rules */
+  {
+    TranslationTableOffset parent;	/*0 for the root */
+    TranslationTableOffset children;	/*edges sorted by character */
+    TranslationTableOffset rules;	/*TrieRules of the rules whose 
+					   lowercase characters, or whose 
+					   dots, lead here */
+    int numChildren;
+    int numRules;
+  } ForRuleNode;
+
+  typedef struct		/*what choosing a rule of a trie looks 
+				   at first, kept together for the rules 
+				   of a node */
+  {
+    TranslationTableOffset rule;
+    TranslationTableOffset sequence;	/*place in the chain, for 
+					   backward rules */
+    TranslationTableOpcode opcode;
+    short charslen;
+    short dotslen;
+    widechar prefix[TRIERULEPREFIX];	/*the first lowercase 
+					   characters, or dots, of the rule */
+  } TrieRule;
+
   /*Translation table header */
   typedef struct
   {				/*translation table */
@@ -393,8 +534,8 @@ extern "C"
     int numPasses;
     int corrections;
     int syllables;
-    TranslationTableOffset tableSize;
-    TranslationTableOffset bytesUsed;
+    unsigned int tableSize;
+    unsigned int bytesUsed;
     TranslationTableOffset noBreak;
     TranslationTableOffset undefined;
     TranslationTableOffset letterSign;
@@ -447,23 +588,86 @@ extern "C"
     TranslationTableOffset compEndCaps;
     TranslationTableOffset endComp;
     TranslationTableOffset hyphenStatesArray;
+    TranslationTableOffset numHyphenStates;
+    TranslationTableOffset lazyHyphenation;	/*file name of patterns not 
+						   compiled yet */
+    TranslationTableOffset lazyBackRules;	/*rules not yet linked into 
+						   the backward chains */
+    TranslationTableOffset numLazyBackRules;
     widechar noLetsignBefore[LETSIGNSIZE];
     int noLetsignBeforeCount;
     widechar noLetsign[LETSIGNSIZE];
     int noLetsignCount;
     widechar noLetsignAfter[LETSIGNSIZE];
     int noLetsignAfterCount;
+    TranslationTableOffset characterIndex;	/*index of characters */
+    TranslationTableOffset dotsIndex;	/*index of dot patterns */
+    TranslationTableOffset charToDotsIndex;	/*index of charToDots, 
+						   each entry the dots + 1 */
+    TranslationTableOffset dotsToCharIndex;	/*index of dotsToChar, 
+						   each entry the character 
+						   + 1 */
+    TranslationTableOffset forRuleTrie;	/*root of the trie of forRules, 
+					   0 if there is none */
+    TranslationTableOffset backRuleTrie;	/*root of the trie of 
+						   backRules, 0 if there is 
+						   none */
+    TranslationTableOffset forRuleBuckets;	/*the forRules chains of 
+						   the finished table, 0 
+						   while they are in 
+						   forRules */
+    int forRuleHashBits;	/*there are 1 << forRuleHashBits of them */
+    TranslationTableOffset forRuleFilter;	/*filter of the pairs of 
+						   lowercase characters the 
+						   rules of forRuleTrie begin 
+						   with, see RULEPAIRBIT, 0 if 
+						   there is none */
+    int forRuleFilterBits;
+    TranslationTableOffset wordIndex;	/*the displacements of the 
+					   buckets of the whole-word index, 
+					   then the rule in each of its slots, 
+					   0 if there is none */
+    unsigned int wordIndexSeed;	/*no two words of a bucket have the 
+				   same hash for wordIndexSlot */
+    int wordIndexBits;		/*there are 1 << wordIndexBits buckets */
+    int numIndexedWords;	/*and as many slots as words */
+    int longestIndexedWord;	/*the characters of the longest word */
+    TranslationTableOffset backRuleFilter;	/*the same for the pairs 
+						   of cells of the backRules 
+						   chains */
+    int backRuleFilterBits;
+    TranslationTableOffset syllableRules;	/*the SyllableRules of a 
+						   table with syllables, 
+						   those tried where their 
+						   characters match first */
+    int numSyllableRules;	/*of these */
+    int numSyllableChars;	/*and of the others after them */
+    TranslationTableOffset syllableFilter;	/*filter of the pairs of 
+						   lowercase characters the 
+						   first begin with */
+    int syllableFilterBits;
+    unsigned char syllableChars[32];	/*the low eight bits of the 
+					   characters of the others */
     TranslationTableOffset characters[HASHNUM];	/*Character 
 						   definitions */
     TranslationTableOffset dots[HASHNUM];	/*Dot definitions */
     TranslationTableOffset charToDots[HASHNUM];
     TranslationTableOffset dotsToChar[HASHNUM];
     TranslationTableOffset compdotsPattern[256];
+    TranslationTableOffset compCells;	/*the cell of each character 
+					   below 256 in computer braille, 
+					   0 where it is not one cell */
     TranslationTableOffset swapDefinitions[NUMSWAPS];
     TranslationTableOffset attribOrSwapRules[5];
+    TranslationTableOffset passRuleGuards[5];	/*guards of the rules of 
+						   attribOrSwapRules, 0 if 
+						   there are none */
+    PassStartFilter passStarts[5];	/*where the rules of the 
+					   passes other than the first may 
+					   begin */
     TranslationTableOffset forRules[HASHNUM];	/*chains of forward rules */
     TranslationTableOffset backRules[HASHNUM];	/*Chains of backward rules */
-    TranslationTableOffset ruleArea[1];	/*Space for storing all 
+    TranslationTableSlot ruleArea[1];	/*Space for storing all 
 					   rules and values */
   } TranslationTableHeader;
   typedef enum
@@ -473,9 +677,66 @@ extern "C"
     alloc_passbuf1,
     alloc_passbuf2,
     alloc_srcMapping,
-    alloc_prevSrcMapping
+    alloc_prevSrcMapping,
+    alloc_inputAttributes,
+    alloc_inputLowercase,
+    alloc_result,
+    alloc_resultPositions,
+    alloc_hyphens
   } AllocBuf;
 
+/* Scratch buffers used by a translation. The library keeps one
+* default context for the functions which do not take one. */
+  struct louContext
+  {
+    unsigned short *typebuf;
+    int sizeTypebuf;
+    unsigned char *destSpacing;
+    int sizeDestSpacing;
+    widechar *passbuf1;
+    int sizePassbuf1;
+    widechar *passbuf2;
+    int sizePassbuf2;
+    int *srcMapping;
+    int sizeSrcMapping;
+    int *prevSrcMapping;
+    int sizePrevSrcMapping;
+    TranslationTableCharacterAttributes *inputAttributes;
+    int sizeInputAttributes;
+    widechar *inputLowercase;
+    int sizeInputLowercase;
+    widechar *result;		/*output of lou_translateAlloc */
+    int sizeResult;
+    int *resultPositions;
+    int sizeResultPositions;
+    char *hyphens;		/*hyphenation points for nocross rules */
+    int sizeHyphens;
+    int scratchLimit;		/*set by lou_setScratchLimit */
+    unsigned long scratchBytes;	/*held by the buffers above */
+    unsigned long peakScratchBytes;
+    unsigned long scratchAllocs;
+    unsigned long scratchShrinks;
+    long maxSteps;		/*set by lou_setWorkBudget */
+    double maxSeconds;
+    volatile int cancelled;	/*set by lou_cancelTranslation */
+    int workStatus;		/*of the last translation */
+    int wordCacheSize;		/*set by lou_setWordCacheSize */
+    struct WordCache *wordCache;
+    struct BackWordCache *backWordCache;	/*of the same size */
+    const struct louOverlay *overlay;	/*set by lou_setContextOverlay */
+  };
+
+/* A user dictionary made by lou_compileOverlay. Its rules are sorted by 
+* the lowercase of their first character, then longest first, and keep 
+* their characters in lowercase after the dots, as the rules of a 
+* forRules chain do. */
+  struct louOverlay
+  {
+    const louTable *table;	/*the rules were compiled for */
+    int numRules;
+    TranslationTableRule **rules;
+  };
+
 /* The following function definitions are hooks into 
 * compileTranslationTable.c. Some are used by other library modules. 
 * Others are used by tools like lou_allround.c and lou_debug.c. */
@@ -492,9 +753,207 @@ extern "C"
   widechar getCharFromDots (widechar d);
 /* Returns the character corresponding to a single-cell dot pattern. */
 
-  void *liblouis_allocMem (AllocBuf buffer, int srcmax, int destmax);
+  widechar getDotsForCharInTable (const TranslationTableHeader * table,
+				  widechar c);
+  widechar getCharFromDotsInTable (const TranslationTableHeader * table,
+				   widechar d);
+/* The same as the two functions above, but looking in the given table 
+* rather than in the one most recently returned by lou_getTable. */
+
+  void getDotsForCharsInTable (const TranslationTableHeader * table,
+			       const widechar * chars, widechar * dots,
+			       int length);
+  void getCharsFromDotsInTable (const TranslationTableHeader * table,
+				const widechar * dots, widechar * chars,
+				int length);
+/* The same for length characters or cells at once. Unicode braille 
+* patterns are taken as the dots they show. */
+
+  const SwapMatch *findSwapMatch (const TranslationTableHeader * table,
+				  const TranslationTableRule * swapRule,
+				  widechar c);
+/* Where c is among the matches of swapRule, or NULL if it is not one 
+* of them. */
+
+  void *liblouis_allocMem (louContext * ctx, AllocBuf buffer, int srcmax,
+			   int destmax);
 /* used by lou_translateString.c and lou_backTranslateString.c ONLY to 
-* allocate memory for internal buffers. */
+* allocate memory for internal buffers. A NULL ctx means the default 
+* context. */
+
+  void shrinkScratch (louContext * ctx);
+/* Free the buffers of a translation which are over the scratch limit 
+* of ctx once it is done. */
+
+  louContext *getContext (louContext * ctx);
+/* ctx, or the default context if it is NULL. */
+
+  void freeWordCache (struct WordCache *cache);
+/* Free the word cache of a context. Defined in lou_translateString.c. */
+
+  void freeBackWordCache (struct BackWordCache *cache);
+/* Free the back-translation word cache of a context. Defined in 
+* lou_backTranslateString.c. */
+
+  int getTableGeneration (void);
+/* A number which changes whenever a table which may have been used for 
+* translation is changed or freed, so that what is remembered about 
+* tables can be forgotten. */
+
+  void enableCompiledTables (int enable);
+/* Whether compiling a table may use an up to date precompiled image 
+* found next to it. Enabled by default. */
+
+  typedef enum
+  {
+    profileReading,		/*reading lines from table files */
+    profileResolving,		/*finding included files on the search path */
+    profileParsing,		/*everything else a rule needs */
+    profileInserting,		/*linking rules into the hash chains */
+    profileFinishing,		/*defaults and indexes, after the last file */
+    PROFILE_PHASES
+  } ProfilePhase;
+
+  typedef enum
+  {
+    profileCharacters,		/*character and dot pattern definitions */
+    profileTranslationRules,	/*contractions and other string rules */
+    profileMultipass,		/*correct, context and pass2 to pass4 rules */
+    profileHyphenation,		/*hyphenation patterns */
+    profileOther,		/*indicators, classes, includes and the like */
+    PROFILE_FAMILIES
+  } ProfileFamily;
+
+  typedef struct
+  {
+    char *fileName;
+    double time;		/*seconds, not counting included files */
+    int bytes;
+    int rules;
+  } ProfileFile;
+
+  typedef struct
+  {
+    double phaseTime[PROFILE_PHASES];
+    double familyTime[PROFILE_FAMILIES];
+    int familyBytes[PROFILE_FAMILIES];
+    int familyRules[PROFILE_FAMILIES];
+    int numFiles;
+    ProfileFile *files;
+  } CompileProfile;
+
+  void profileCompilation (CompileProfile * profile);
+/* Add up in profile, which must start zeroed, where the time and the 
+* table space go while tables are compiled on this thread, or stop if 
+* profile is NULL. Images and saved includes are not used meanwhile, so 
+* that every file is compiled. The time of a rule family includes 
+* reading only for hyphenation patterns. */
+
+  void freeCompileProfile (CompileProfile * profile);
+/* Free the file list of a profile */
+
+  typedef enum
+  {
+    ruleProfileSelecting,	/*for_selectRule, finding the rule to apply */
+    ruleProfileTesting,		/*passDoTest, testing context and pass rules */
+    ruleProfileIndicators,	/*insertBrailleIndicators */
+    RULEPROFILE_TIMES
+  } RuleProfileTime;
+
+  typedef struct RuleProfile RuleProfile;
+
+  RuleProfile *getRuleProfile (const TranslationTableHeader * table);
+/* The rule counters of table, made the first time, if rule profiling 
+* is on, otherwise NULL. */
+
+  void countRule (RuleProfile * profile, const TranslationTableRule * rule,
+		  int applied);
+/* Count rule of the table of profile as tried, or as applied. Rules not 
+* in the table, such as the pseudo rule for a character without one, 
+* are not counted. */
+
+  void addRuleProfileTimes (RuleProfile * profile, const double *times);
+/* Add the seconds a translation spent in each RuleProfileTime */
+
+  double currentTime (void);
+/* Seconds since some fixed time, for measuring how long things take */
+
+/* The counters of lou_getMetrics */
+  enum
+  {
+    metricTranslations,
+    metricTranslatedChars,
+    metricBackTranslations,
+    metricBackTranslatedCells,
+    metricOutputFull,
+    metricWorkStopped,
+    metricTableHits,
+    metricTableMisses,
+    metricTableCompiles,
+    metricCompileMicroseconds,
+    metricScratchBytes,
+    METRICS
+  };
+
+  void addMetric (int metric, long n);
+/* Add n to a counter of the calling thread */
+
+  void countTranslation (int backward, int length, int done, int status);
+/* Count a translation, or a back-translation if backward is set, of 
+* length characters or cells, done of which were translated. status is 
+* the louWorkStatus it ended with. */
+
+  extern volatile int traceEvents;
+  void addTraceEvent (int kind, int backward, int pass, int value, int src,
+		      int dest);
+/* Put an event in the trace buffer of the thread, see 
+* lou_setTraceEvents. traceEvent leaves out the call while tracing is 
+* off. */
+#define traceEvent(kind, backward, pass, value, src, dest) \
+  (traceEvents ? addTraceEvent ((kind), (backward), (pass), (value), \
+				(src), (dest)) : (void) 0)
+
+/* What is left of the work budget of a context for one translation, 
+* see lou_setWorkBudget. */
+  typedef struct
+  {
+    louContext *ctx;
+    int limited;		/*whether spendWork must be called */
+    long stepsLeft;		/*-1 without a limit */
+    double deadline;		/*0 without a limit */
+    int steps;
+    int status;			/*a louWorkStatus once it has run out */
+  } WorkBudget;
+
+  void startWork (louContext * ctx, WorkBudget * work);
+  int spendWork (WorkBudget * work);
+  void endWork (WorkBudget * work);
+/* startWork sets up the budget of a translation with ctx, which may be 
+* NULL, and endWork tells the context how it ended. outOfWork counts a 
+* step of a pass and is true once the translation must stop because its 
+* budget has run out or it has been cancelled. */
+#define outOfWork(work) \
+  ((work)->limited || ((work)->ctx != NULL && (work)->ctx->cancelled) \
+   ? spendWork (work) : 0)
+
+#define CHAINPREFIXES 4
+  typedef struct
+  {
+    int length;			/*entries in the chain */
+    int numPrefixes;		/*different beginnings of its entries */
+    widechar prefixes[CHAINPREFIXES][2];	/*the most common ones, 
+						   most common first */
+    int prefixCounts[CHAINPREFIXES];
+  } ChainReport;
+
+  int worstChains (const TranslationTableHeader * table, int kind,
+		   ChainReport * chains, int max, double *meanLength);
+/* Fill chains with up to max of the longest hash chains of table, the 
+* longest first, and return how many. kind is 0 for forward rules, 1 
+* for backward rules, 2 for characters and 3 for dots. A rule begins 
+* with its first two characters or cells, a character with itself. 
+* meanLength, unless NULL, is set to the mean length of the chain an 
+* entry is in. Used by lou_checktable --stats. */
 
   void *get_table (const char *name);
 /* Checks tables for errors and compiles shem. returns a pointer to the 
@@ -506,10 +965,24 @@ extern "C"
   int charHash (widechar c);
 /* Hash function for single characters */
 
+  int wordIndexSlot (unsigned int hash, unsigned int displacement,
+		     int numWords);
+/* The slot of the whole-word index of a word of this hash, see 
+* WORDINDEXSLOTHASH, in a bucket with this displacement */
+
+  TranslationTableOffset findForRules (const TranslationTableHeader *
+				       table, widechar c1, widechar c2);
+/* The first rule of the forRules chain for a text beginning with c1 and 
+* c2 in lowercase */
+
   char *showString (widechar const *chars, int length);
 /* Returns a string in the same format as the characters operand in 
 * opcodes */
 
+  char *showStringInBuffer (widechar const *chars, int length,
+			    char *buffer, int bufferSize);
+/* The same as showString, but writes into the caller's buffer. */
+
   char *showDots (widechar const *dots, int length);
 /* Returns a character string in the format of the dots operand */
 
@@ -564,6 +1037,40 @@ extern "C"
                        const TranslationTableRule** rules, int* rulesLen,
                        int mode);
 
+  int backTranslateWithTable (louContext * ctx,
+			      const TranslationTableHeader * table,
+			      const widechar * inbuf, int *inlen,
+			      widechar * outbuf, int *outlen,
+			      formtype *typeform, char *spacing,
+			      int *outputPos, int *inputPos, int *cursorPos,
+			      int mode);
+/* lou_backTranslateCtx with the table already looked up. */
+
+  int backTranslateWithStates (louContext * ctx,
+			       const TranslationTableHeader * table,
+			       const widechar * inbuf, int *inlen,
+			       widechar * outbuf, int *outlen,
+			       int *outputPos, int *inputPos,
+			       int *cursorPos, int *states, int mode);
+/* backTranslateWithTable without typeform and spacing, also setting 
+* states[k] where a space rule has just left nothing of the cells before 
+* k to carry over to the cells after them but the opcode of the rule 
+* before it, to that opcode + 1. states has *inlen + 1 places, which are 
+* 0 elsewhere. */
+
+  void *getTableFromHandle (const louTable * handle);
+/* Returns the compiled table for a handle from lou_openTable. */
+
+  void *completeTable (const void *table, int parts);
+/* Compile the parts of a table left out by lou_setLazyCompilation and 
+* return the complete table, which replaces the given one in the cache. 
+* parts is a combination of LOU_LAZY_HYPHENATION and 
+* LOU_LAZY_BACKTRANSLATION. */
+
+  int processorCount (void);
+/* The number of processors, for the number of worker threads to start 
+* by default. */
+
   char * getLastTableList();
   void debugHook ();
 /* Can be inserted in code to be used as a breakpoint in gdb */
@@ -574,6 +1081,10 @@ void logWidecharBuf(logLevels level, const char *msg, const widechar *wbuf, int
 /* Helper for logging a widechar buffer */
 
 void logMessage(logLevels level, const char *format, ...);
+extern logLevels logLevel;
+#define logEnabled(level) ((level) >= logLevel)
+/* Whether messages of level are logged, so that what goes into them 
+ * need not be worked out otherwise */
 void closeLogFile();
 /* Function for closing loggin file */
 #ifdef __cplusplus
@@ -0,0 +1,484 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+   This file is part of Liblouis.
+
+   Liblouis is free software: you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Liblouis is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with Liblouis. If not, see
+   <http://www.gnu.org/licenses/>.
+
+   */
+
+/* Translation queues. Jobs submitted to a queue wait in a list until
+* one of the worker threads of the queue takes them and runs them with
+* a context of its own. Finished jobs are given to the callback of the
+* queue on the worker thread, or, without a callback, are put in a list
+* of completions for the caller to take, with a byte in a pipe while the
+* list is not empty so that the caller can wait for them in its event
+* loop. The bytes of the jobs and completions in a queue are counted, and
+* a job which would take them past the cap of the queue is not
+* accepted until there is room. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "louis.h"
+#include "config.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#endif
+
+#if defined(_WIN32)
+#define QUEUETHREADS 1
+typedef CRITICAL_SECTION QueueLock;
+typedef CONDITION_VARIABLE QueueCondition;
+typedef HANDLE QueueThread;
+#define initLock(lock) InitializeCriticalSection (lock)
+#define destroyLock(lock) DeleteCriticalSection (lock)
+#define lockQueue(queue) EnterCriticalSection (&(queue)->lock)
+#define unlockQueue(queue) LeaveCriticalSection (&(queue)->lock)
+#define initCondition(cond) InitializeConditionVariable (cond)
+#define destroyCondition(cond)
+#define waitCondition(cond, lock) SleepConditionVariableCS (cond, lock, INFINITE)
+#define signalCondition(cond) WakeConditionVariable (cond)
+#define broadcastCondition(cond) WakeAllConditionVariable (cond)
+#elif defined(HAVE_PTHREAD_H)
+#define QUEUETHREADS 1
+typedef pthread_mutex_t QueueLock;
+typedef pthread_cond_t QueueCondition;
+typedef pthread_t QueueThread;
+#define initLock(lock) pthread_mutex_init (lock, NULL)
+#define destroyLock(lock) pthread_mutex_destroy (lock)
+#define lockQueue(queue) pthread_mutex_lock (&(queue)->lock)
+#define unlockQueue(queue) pthread_mutex_unlock (&(queue)->lock)
+#define initCondition(cond) pthread_cond_init (cond, NULL)
+#define destroyCondition(cond) pthread_cond_destroy (cond)
+#define waitCondition(cond, lock) pthread_cond_wait (cond, lock)
+#define signalCondition(cond) pthread_cond_signal (cond)
+#define broadcastCondition(cond) pthread_cond_broadcast (cond)
+#else
+typedef int QueueLock;
+typedef int QueueCondition;
+#define initLock(lock)
+#define destroyLock(lock)
+#define lockQueue(queue)
+#define unlockQueue(queue)
+#define initCondition(cond)
+#define destroyCondition(cond)
+#define waitCondition(cond, lock)
+#define signalCondition(cond)
+#define broadcastCondition(cond)
+#endif
+
+#if !defined(_WIN32) && defined(HAVE_UNISTD_H)
+#define QUEUEPIPE 1
+#endif
+
+typedef struct QueueJob
+{
+  struct QueueJob *next;
+  const louTable *table;
+  widechar *inbuf;
+  int inlen;
+  int mode;
+  int bytes;			/*counted against the cap of the queue */
+  widechar *outbuf;
+  char *hyphens;
+  louCompletion completion;
+} QueueJob;
+
+typedef struct
+{
+  louQueue *queue;
+  louContext *ctx;
+} QueueWorker;
+
+struct louQueue
+{
+  QueueLock lock;
+  QueueCondition jobReady;	/*a job was submitted or the queue is closing */
+  QueueCondition jobDone;	/*a job was finished or a completion taken */
+  louCompletionCallback callback;
+  void *data;
+  int maxBytes;
+  int queuedBytes;
+  int unfinished;		/*jobs submitted and not yet finished */
+  int closing;
+  QueueJob *firstJob;		/*jobs not yet started */
+  QueueJob *lastJob;
+  QueueJob *firstDone;		/*completions not yet taken */
+  QueueJob *lastDone;
+  QueueJob *taken;		/*the completion last taken */
+  int numThreads;
+  int numWorkers;
+  QueueWorker *workers;		/*one for each thread, or one to run jobs
+				   in lou_submit when there are none */
+#ifdef QUEUETHREADS
+  QueueThread *threads;
+#endif
+  int fds[2];
+};
+
+static void
+freeJob (QueueJob * job)
+{
+  free (job->inbuf);
+  free (job->outbuf);
+  free (job->hyphens);
+  free (job);
+}
+
+static void
+runJob (QueueJob * job, louContext * ctx)
+{
+  louCompletion *completion = &job->completion;
+  switch (completion->kind)
+    {
+    case louTranslateJob:
+      completion->status =
+	lou_translateAlloc (job->table, ctx, job->inbuf, job->inlen,
+			    &job->outbuf, &completion->outlen, NULL, NULL,
+			    NULL, job->mode, NULL, NULL);
+      completion->outbuf = job->outbuf;
+      break;
+    case louBackTranslateJob:
+      completion->status =
+	lou_backTranslateAlloc (job->table, ctx, job->inbuf, job->inlen,
+				&job->outbuf, &completion->outlen, NULL,
+				NULL, NULL, job->mode, NULL, NULL);
+      completion->outbuf = job->outbuf;
+      break;
+    case louHyphenateJob:
+      if (!(job->hyphens = malloc (job->inlen + 1)))
+	outOfMemory ();
+      completion->status =
+	lou_hyphenateTextWithTable (job->table, job->inbuf, job->inlen,
+				    job->hyphens);
+      completion->hyphens = job->hyphens;
+      completion->outlen = job->inlen + 1;
+      break;
+    }
+  if (completion->status != 1)
+    {
+      completion->status = 0;
+      completion->outlen = 0;
+    }
+}
+
+static void
+finishJob (louQueue * queue, QueueJob * job)
+{
+/* Give a job which has been run or cancelled to the callback, or put it
+* in the list of completions. Called without the lock. */
+  if (queue->callback != NULL)
+    {
+      queue->callback (&job->completion, queue->data);
+      lockQueue (queue);
+      queue->queuedBytes -= job->bytes;
+      freeJob (job);
+    }
+  else
+    {
+      lockQueue (queue);
+      /* Only the output is kept */
+      free (job->inbuf);
+      job->inbuf = NULL;
+      queue->queuedBytes -= job->bytes;
+      job->bytes = sizeof (QueueJob) + (job->outbuf != NULL ?
+					job->completion.outlen * CHARSIZE :
+					job->completion.outlen);
+      queue->queuedBytes += job->bytes;
+      job->next = NULL;
+      if (queue->lastDone != NULL)
+	queue->lastDone->next = job;
+      else
+	{
+	  queue->firstDone = job;
+#ifdef QUEUEPIPE
+	  if (write (queue->fds[1], "", 1) != 1)
+	    logMessage (LOG_ERROR, "Cannot signal a completion");
+#endif
+	}
+      queue->lastDone = job;
+    }
+  queue->unfinished--;
+  broadcastCondition (&queue->jobDone);
+  unlockQueue (queue);
+}
+
+static void
+runWorker (QueueWorker * worker)
+{
+  louQueue *queue = worker->queue;
+  QueueJob *job;
+  lockQueue (queue);
+  for (;;)
+    {
+      while (queue->firstJob == NULL && !queue->closing)
+	waitCondition (&queue->jobReady, &queue->lock);
+      if ((job = queue->firstJob) == NULL)
+	break;
+      if (!(queue->firstJob = job->next))
+	queue->lastJob = NULL;
+      unlockQueue (queue);
+      runJob (job, worker->ctx);
+      finishJob (queue, job);
+      lockQueue (queue);
+    }
+  unlockQueue (queue);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI
+queueThread (LPVOID arg)
+{
+  runWorker (arg);
+  return 0;
+}
+#elif defined(QUEUETHREADS)
+static void *
+queueThread (void *arg)
+{
+  runWorker (arg);
+  return NULL;
+}
+#endif
+
+louQueue *EXPORT_CALL
+lou_createQueue (int threads, int maxBytes, louCompletionCallback callback,
+		 void *data)
+{
+  louQueue *queue;
+  int k;
+  if (!(queue = calloc (1, sizeof (louQueue))))
+    outOfMemory ();
+  queue->callback = callback;
+  queue->data = data;
+  queue->maxBytes = maxBytes;
+  queue->fds[0] = queue->fds[1] = -1;
+#ifdef QUEUEPIPE
+  if (callback == NULL && pipe (queue->fds))
+    {
+      free (queue);
+      return NULL;
+    }
+#endif
+  initLock (&queue->lock);
+  initCondition (&queue->jobReady);
+  initCondition (&queue->jobDone);
+  if (threads <= 0)
+    threads = processorCount ();
+#ifndef QUEUETHREADS
+  threads = 0;
+#endif
+  queue->numWorkers = threads > 1 ? threads : 1;
+  if (!(queue->workers = calloc (queue->numWorkers, sizeof (QueueWorker))))
+    outOfMemory ();
+  for (k = 0; k < queue->numWorkers; k++)
+    {
+      queue->workers[k].queue = queue;
+      queue->workers[k].ctx = lou_createContext ();
+    }
+#ifdef QUEUETHREADS
+  if (!(queue->threads = malloc (queue->numWorkers * sizeof (QueueThread))))
+    outOfMemory ();
+  for (k = 0; k < threads; k++)
+    {
+#if defined(_WIN32)
+      if (!(queue->threads[k] = CreateThread (NULL, 0, queueThread,
+					      &queue->workers[k], 0, NULL)))
+	break;
+#else
+      if (pthread_create (&queue->threads[k], NULL, queueThread,
+			  &queue->workers[k]))
+	break;
+#endif
+    }
+  queue->numThreads = k;
+#endif
+  return queue;
+}
+
+int EXPORT_CALL
+lou_submit (louQueue * queue, int kind, const louTable * table,
+	    const widechar * inbuf, int inlen, int mode, void *user,
+	    int wait)
+{
+  QueueJob *job;
+  if (queue == NULL || table == NULL || inbuf == NULL || inlen < 0
+      || (kind != louTranslateJob && kind != louBackTranslateJob
+	  && kind != louHyphenateJob))
+    return 0;
+  if (!(job = calloc (1, sizeof (QueueJob)))
+      || !(job->inbuf = malloc ((inlen + 1) * CHARSIZE)))
+    outOfMemory ();
+  memcpy (job->inbuf, inbuf, inlen * CHARSIZE);
+  job->table = table;
+  job->inlen = inlen;
+  job->mode = mode;
+  job->bytes = sizeof (QueueJob) + inlen * CHARSIZE;
+  job->completion.user = user;
+  job->completion.kind = kind;
+  lockQueue (queue);
+  /* A job is accepted into an empty queue even if it is larger than the
+   * cap. Waiting stops when only taking completions can make room */
+  while (!queue->closing && queue->maxBytes > 0 && queue->queuedBytes > 0
+	 && queue->queuedBytes + job->bytes > queue->maxBytes)
+    {
+      if (!wait || !queue->unfinished)
+	break;
+      waitCondition (&queue->jobDone, &queue->lock);
+    }
+  if (queue->closing || (queue->maxBytes > 0 && queue->queuedBytes > 0
+			 && queue->queuedBytes + job->bytes >
+			 queue->maxBytes))
+    {
+      unlockQueue (queue);
+      freeJob (job);
+      return 0;
+    }
+  queue->queuedBytes += job->bytes;
+  queue->unfinished++;
+  if (queue->numThreads > 0)
+    {
+      if (queue->lastJob != NULL)
+	queue->lastJob->next = job;
+      else
+	queue->firstJob = job;
+      queue->lastJob = job;
+      signalCondition (&queue->jobReady);
+      unlockQueue (queue);
+    }
+  else
+    {
+      unlockQueue (queue);
+      runJob (job, queue->workers[0].ctx);
+      finishJob (queue, job);
+    }
+  return 1;
+}
+
+int EXPORT_CALL
+lou_queueFd (const louQueue * queue)
+{
+  return queue != NULL ? queue->fds[0] : -1;
+}
+
+const louCompletion *EXPORT_CALL
+lou_nextCompletion (louQueue * queue)
+{
+  QueueJob *job;
+#ifdef QUEUEPIPE
+  char byte;
+#endif
+  if (queue == NULL)
+    return NULL;
+  lockQueue (queue);
+  if (queue->taken != NULL)
+    {
+      queue->queuedBytes -= queue->taken->bytes;
+      freeJob (queue->taken);
+      broadcastCondition (&queue->jobDone);
+    }
+  if ((job = queue->firstDone) != NULL)
+    {
+      if (!(queue->firstDone = job->next))
+	{
+	  queue->lastDone = NULL;
+#ifdef QUEUEPIPE
+	  if (read (queue->fds[0], &byte, 1) != 1)
+	    logMessage (LOG_ERROR, "Cannot clear the signal of completions");
+#endif
+	}
+    }
+  queue->taken = job;
+  unlockQueue (queue);
+  return job != NULL ? &job->completion : NULL;
+}
+
+void EXPORT_CALL
+lou_waitQueue (louQueue * queue)
+{
+  if (queue == NULL)
+    return;
+  lockQueue (queue);
+  while (queue->unfinished > 0)
+    waitCondition (&queue->jobDone, &queue->lock);
+  unlockQueue (queue);
+}
+
+void EXPORT_CALL
+lou_freeQueue (louQueue * queue)
+{
+  QueueJob *job, *next;
+  int k;
+  if (queue == NULL)
+    return;
+  lockQueue (queue);
+  queue->closing = 1;
+  job = queue->firstJob;
+  queue->firstJob = queue->lastJob = NULL;
+  broadcastCondition (&queue->jobReady);
+  broadcastCondition (&queue->jobDone);
+  unlockQueue (queue);
+#ifdef QUEUETHREADS
+  for (k = 0; k < queue->numThreads; k++)
+    {
+#if defined(_WIN32)
+      WaitForSingleObject (queue->threads[k], INFINITE);
+      CloseHandle (queue->threads[k]);
+#else
+      pthread_join (queue->threads[k], NULL);
+#endif
+    }
+  free (queue->threads);
+#endif
+  /* The jobs which were never started are cancelled */
+  for (; job != NULL; job = next)
+    {
+      next = job->next;
+      job->completion.status = -1;
+      if (queue->callback != NULL)
+	queue->callback (&job->completion, queue->data);
+      freeJob (job);
+    }
+  for (job = queue->firstDone; job != NULL; job = next)
+    {
+      next = job->next;
+      freeJob (job);
+    }
+  if (queue->taken != NULL)
+    freeJob (queue->taken);
+  for (k = 0; k < queue->numWorkers; k++)
+    lou_freeContext (queue->workers[k].ctx);
+  free (queue->workers);
+#ifdef QUEUEPIPE
+  if (queue->fds[0] >= 0)
+    {
+      close (queue->fds[0]);
+      close (queue->fds[1]);
+    }
+#endif
+  destroyCondition (&queue->jobReady);
+  destroyCondition (&queue->jobDone);
+  destroyLock (&queue->lock);
+  free (queue);
+}
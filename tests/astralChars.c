@@ -0,0 +1,96 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that characters beyond the Basic Multilingual Plane go into
+   the character index, and that rules with them translate forward and
+   backward, also next to a character of the plane that shares their
+   hash chain. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+#if UNICODEBITS == 16
+
+int
+main (int argc, char **argv)
+{
+  /* Skip the test, the table cannot be compiled */
+  return 77;
+}
+
+#else
+
+#define BOLDA 0x1d400		/*mathematical bold capital A */
+#define BOLDB 0x1d401
+
+static const char *tableList = "empty.ctb";
+
+static int
+check (int backward, const widechar * input, int inlen,
+       const widechar * expected, int expectedLength)
+{
+  widechar outbuf[16];
+  int outlen = 16, k;
+  int ok = backward ?
+    lou_backTranslate (tableList, input, &inlen, outbuf, &outlen,
+		       NULL, NULL, NULL, NULL, NULL, dotsIO) :
+    lou_translate (tableList, input, &inlen, outbuf, &outlen,
+		   NULL, NULL, NULL, NULL, NULL, dotsIO);
+  if (ok && outlen == expectedLength
+      && !memcmp (outbuf, expected, outlen * CHARSIZE))
+    return 0;
+  printf ("%s translation gives", backward ? "Backward" : "Forward");
+  for (k = 0; ok && k < outlen; k++)
+    printf (" %x", outbuf[k]);
+  printf (" instead of");
+  for (k = 0; k < expectedLength; k++)
+    printf (" %x", expected[k]);
+  printf ("\n");
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  /* A character of the plane in the same hash chain as BOLDA */
+  widechar other = BOLDA % HASHNUM + HASHNUM;
+  widechar text[] = { BOLDA, BOLDB, other, BOLDA };
+  widechar dots[] = { B16 | 0x19, B16 | 0x09, B16 | 0x01 };
+  widechar cells[] = { B16 | 0x01, B16 | 0x03, B16 | 0x09 };
+  widechar chars[] = { BOLDA, BOLDB, other };
+  TranslationTableHeader *table;
+  char rule[32];
+  int result = 0;
+  lou_compileString (tableList, "letter \\y1d400 1");
+  lou_compileString (tableList, "letter \\y1d401 12");
+  sprintf (rule, "letter \\x%04x 14", other);
+  lou_compileString (tableList, rule);
+  lou_compileString (tableList, "letter d 145");
+  lou_compileString (tableList, "always \\y1d400\\y1d401 145");
+  if (!(table = lou_getTable (tableList)))
+    {
+      printf ("Cannot compile the table\n");
+      return 1;
+    }
+  if (!table->characterIndex
+      || !table->ruleArea[table->characterIndex + BOLDA / CHARINDEXPAGE])
+    {
+      printf ("%x is not in the character index\n", BOLDA);
+      result = 1;
+    }
+  result |= check (0, text, 4, dots, 3);
+  result |= check (1, cells, 3, chars, 3);
+  lou_free ();
+  return result;
+}
+
+#endif
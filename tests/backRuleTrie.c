@@ -0,0 +1,101 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that rules found through the trie of backward rules
+   back-translate the same as rules found by walking the hash chains,
+   and that a rule added with lou_compileString is not left out. */
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+#define BUFSIZE 512
+
+static const char *tables[] = {
+  "de-de-g2.ctb",
+  "de-ch-g2.ctb",
+  "ko-g2.ctb",
+  "zh-tw.ctb",
+  "zh-hk.ctb",
+};
+
+static const char *text = "The Quick BROWN fox, THE quick brown fox's "
+  "29 Jumps over the lazy dog: because together we should know 4.5 "
+  "themselves. Mit Freundlichen Gruessen, l'Eleve a REFLECHI; Det Er "
+  "Ikke Saerlig Svaert. Caf\\x00e9 na\\x00efve \\x00fcber, "
+  "d\\x00e9j\\x00e0 vu. \\x4e2d\\x6587 \\xd55c\\xad6d\\xc5b4.";
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static int
+backTranslate (const char *table, const widechar *inbuf, int inlen,
+	       widechar *outbuf, int *outlen, int mode)
+{
+  *outlen = BUFSIZE;
+  return lou_backTranslateString (table, inbuf, &inlen, outbuf, outlen,
+				  NULL, NULL, mode);
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar inbuf[BUFSIZE];
+  widechar braille[BUFSIZE];
+  widechar expected[BUFSIZE];
+  widechar outbuf[BUFSIZE];
+  int inlen, braillelen, expectedlen, outlen;
+  TranslationTableHeader *table;
+  int result = 0;
+  int i;
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  inlen = extParseChars (text, inbuf);
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      if (!(table = lou_getTable (tables[i])) || !table->backRuleTrie)
+	{
+	  printf ("%s has no trie of backward rules\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      braillelen = BUFSIZE;
+      lou_translateString (tables[i], inbuf, &inlen, braille, &braillelen,
+			   NULL, NULL, 0);
+      backTranslate (tables[i], braille, braillelen, expected, &expectedlen,
+		     0);
+      table->backRuleTrie = 0;
+      backTranslate (tables[i], braille, braillelen, outbuf, &outlen, 0);
+      if (outlen != expectedlen
+	  || memcmp (outbuf, expected, outlen * sizeof (widechar)))
+	{
+	  printf ("%s back-translates differently without the trie\n",
+		  tables[i]);
+	  result = 1;
+	}
+    }
+  lou_free ();
+
+  inlen = extParseChars ("\\x8033\\x8033\\x8033", inbuf);
+  if (!lou_compileString (tables[0], "always quux 1256-1256-1256"))
+    {
+      printf ("Cannot add a rule to %s\n", tables[0]);
+      result = 1;
+    }
+  else if (!backTranslate (tables[0], inbuf, inlen, outbuf, &outlen,
+			   dotsIO) || outlen != 4)
+    {
+      printf ("A rule added with lou_compileString is not used\n");
+      result = 1;
+    }
+
+  lou_free ();
+  return result;
+}
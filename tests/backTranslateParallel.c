@@ -0,0 +1,98 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that lou_backTranslateParallel gives the same output and maps
+   as one back-translation of the whole input, whatever the number of
+   threads, for braille with capitals, numbers and emphasis running
+   across the cuts. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#define TEXTSIZE 40000
+#define OUTSIZE (2 * TEXTSIZE)
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "en-ueb-g2.ctb",
+  "de-de-g2.ctb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static const char *words[] = {
+  "The", "quick", "BROWN", "fox", "jumps", "over", "the", "lazy", "dog",
+  "with", "knowledge", "of", "Braille", "123", "4.5", "AND", "together",
+  "THE END", "x1", "because", "mother's", "LOUD NOISES", "ok.",
+};
+
+static widechar text[TEXTSIZE];
+static widechar braille[OUTSIZE];
+static widechar expected[OUTSIZE];
+static widechar outbuf[OUTSIZE];
+static int expectedOutputPos[OUTSIZE], expectedInputPos[OUTSIZE];
+static int outputPos[OUTSIZE], inputPos[OUTSIZE];
+
+int
+main (int argc, char **argv)
+{
+  char word[32];
+  const louTable *table;
+  int threads[] = { 1, 2, 3, 8, 0 };
+  int textlen, braillelen, inlen, expectedlen, outlen;
+  int result = 0;
+  int i, k;
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  for (textlen = 0, i = 0; textlen < TEXTSIZE - 64; i++)
+    {
+      sprintf (word, "%s%s", words[(i * 7 + i / 11) % 23],
+	       i % 17 == 16 ? ".  " : " ");
+      textlen += extParseChars (word, &text[textlen]);
+    }
+  for (k = 0; k < NUMTABLES; k++)
+    {
+      if (!(table = lou_openTable (tables[k])))
+	return 1;
+      inlen = textlen;
+      braillelen = OUTSIZE;
+      lou_translateString (tables[k], text, &inlen, braille, &braillelen,
+			   NULL, NULL, 0);
+      inlen = braillelen;
+      expectedlen = OUTSIZE;
+      lou_backTranslate (tables[k], braille, &inlen, expected, &expectedlen,
+			 NULL, NULL, expectedOutputPos, expectedInputPos,
+			 NULL, 0);
+      for (i = 0; i < sizeof (threads) / sizeof (threads[0]); i++)
+	{
+	  inlen = braillelen;
+	  outlen = OUTSIZE;
+	  if (!lou_backTranslateParallel (table, threads[i], braille, &inlen,
+					  outbuf, &outlen, outputPos,
+					  inputPos, 0)
+	      || inlen != braillelen || outlen != expectedlen
+	      || memcmp (outbuf, expected, outlen * sizeof (widechar))
+	      || memcmp (inputPos, expectedInputPos, outlen * sizeof (int))
+	      || memcmp (outputPos, expectedOutputPos,
+			 inlen * sizeof (int)))
+	    {
+	      printf ("%s on %d threads differs from the serial run\n",
+		      tables[k], threads[i]);
+	      result = 1;
+	    }
+	}
+      lou_closeTable (table);
+    }
+  lou_free ();
+  return result;
+}
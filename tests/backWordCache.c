@@ -0,0 +1,324 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that back-translations using the word cache are the same as
+   back-translations without it, also when the cache is too small for
+   the text or the cells are made up, and that back-retranslating the cells after typing and
+   deleting them gives the same output, maps and cursor position as
+   back-translating them all again, also when an edit changes what a
+   word carries over to the words after it. The maps must also cover
+   a cell that no rule translates. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#define BUFSIZE 1024
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "en-us-g1.ctb",
+  "UEBC-g2.ctb",
+  "de-de-g2.ctb",
+  "nl-NL-g1.ctb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+/* Taking out the s makes "the" a word of its own, which gives "a" a
+   space before it */
+static const char *joined = "l c' won't x s! a ;b ;c ;d ;e";
+
+static const char *text =
+  "the cat and the dog went to the NASA park in 2015, and the cat sat "
+  "on the mat while the dog ran after the ball and the children of the "
+  "town watched the cat and the dog from the other side.";
+
+typedef struct
+{
+  widechar inbuf[BUFSIZE];
+  int inlen;
+  widechar outbuf[BUFSIZE];
+  int outlen;
+  int outputPos[BUFSIZE];
+  int inputPos[BUFSIZE];
+  int cursorPos;
+} Line;
+
+static int
+backTranslate (louContext * ctx, const char *table, widechar * inbuf,
+	       int inlen, widechar * outbuf, int mode)
+{
+  int outlen = BUFSIZE;
+  if (ctx == NULL)
+    {
+      if (!lou_backTranslate (table, inbuf, &inlen, outbuf, &outlen, NULL,
+			      NULL, NULL, NULL, NULL, mode))
+	return -1;
+    }
+  else if (!lou_backTranslateCtx (ctx, table, inbuf, &inlen, outbuf,
+				  &outlen, NULL, NULL, NULL, NULL, NULL,
+				  mode))
+    return -1;
+  return outlen;
+}
+
+static int
+checkCache (louContext * ctx, const char *table, widechar * inbuf,
+	    int inlen, int mode, const char *what)
+{
+  widechar expected[BUFSIZE];
+  widechar received[BUFSIZE];
+  int expectedlen, receivedlen;
+  int round;
+  expectedlen = backTranslate (NULL, table, inbuf, inlen, expected, mode);
+  if (expectedlen < 0)
+    {
+      printf ("%s back-translation with %s failed\n", table, what);
+      return 1;
+    }
+  for (round = 0; round < 2; round++)
+    {
+      receivedlen = backTranslate (ctx, table, inbuf, inlen, received,
+				   mode);
+      if (receivedlen != expectedlen || memcmp (expected, received,
+						expectedlen *
+						sizeof (widechar)))
+	{
+	  printf ("%s back-translation with %s differs with the word "
+		  "cache\n", table, what);
+	  return 1;
+	}
+    }
+  return 0;
+}
+
+static int
+checkMadeUpCells (louContext * ctx, const char *table)
+{
+/* Back-translate lines of cells picked from a few letters, punctuation 
+* and blanks, where rules running over blank cells are common */
+  static const char *cells = "abcdefgh,;:./-'      ";
+  widechar inbuf[BUFSIZE];
+  unsigned int seed = 1;
+  int line, k;
+  for (line = 0; line < 20; line++)
+    {
+      for (k = 0; k < 300; k++)
+	{
+	  seed = seed * 1103515245 + 12345;
+	  inbuf[k] = cells[(seed >> 16) % strlen (cells)];
+	}
+      if (checkCache (ctx, table, inbuf, 300, 0, "made up cells"))
+	return 1;
+    }
+  return 0;
+}
+
+static int
+checkUndefinedPositions (const char *table)
+{
+/* Back-translate a cell no rule translates, dot 7, between two a's */
+  widechar inbuf[] = { 0x8001, 0x8040, 0x8001 };
+  static const int expectedInputPos[] = { 0, 1, 1, 1, 2 };
+  static const int expectedOutputPos[] = { 0, 1, 4 };
+  widechar outbuf[BUFSIZE];
+  int outputPos[BUFSIZE];
+  int inputPos[BUFSIZE];
+  int inlen = 3;
+  int outlen = BUFSIZE;
+  int k;
+  for (k = 0; k < BUFSIZE; k++)
+    outputPos[k] = inputPos[k] = -7;
+  if (!lou_backTranslate (table, inbuf, &inlen, outbuf, &outlen, NULL,
+			  NULL, outputPos, inputPos, NULL, dotsIO)
+      || outlen != 5 || inlen != 3
+      || memcmp (inputPos, expectedInputPos, sizeof (expectedInputPos))
+      || memcmp (outputPos, expectedOutputPos, sizeof (expectedOutputPos)))
+    {
+      printf ("%s does not map the positions of an undefined cell\n",
+	      table);
+      return 1;
+    }
+  return 0;
+}
+
+static void
+keepLine (const Line * line, louTranslation * translation, int cursor)
+{
+  translation->inbuf = line->inbuf;
+  translation->inlen = line->inlen;
+  translation->outbuf = line->outbuf;
+  translation->outlen = line->outlen;
+  translation->outputPos = line->outputPos;
+  translation->inputPos = line->inputPos;
+  translation->cursorPos = cursor;
+}
+
+static int
+step (const louTable * table, const char *name, Line * previous,
+      Line * line, int cursor, int *previousCursor)
+{
+/* Back-retranslate line after previous and compare it with a
+* back-translation of the whole line. The result becomes the next
+* previous line. */
+  louTranslation translation;
+  Line expected;
+  if (cursor >= line->inlen)
+    cursor = line->inlen - 1;
+  memcpy (expected.inbuf, line->inbuf, line->inlen * sizeof (widechar));
+  expected.inlen = line->inlen;
+  expected.outlen = BUFSIZE;
+  expected.cursorPos = cursor;
+  if (!lou_backTranslateWithTable (table, NULL, expected.inbuf,
+				   &expected.inlen, expected.outbuf,
+				   &expected.outlen, NULL, NULL,
+				   expected.outputPos, expected.inputPos,
+				   &expected.cursorPos, 0))
+    {
+      printf ("%s: back-translation failed\n", name);
+      return 1;
+    }
+  keepLine (previous, &translation, *previousCursor);
+  line->outlen = BUFSIZE;
+  line->cursorPos = cursor;
+  if (!lou_backRetranslate (table, NULL, &translation, line->inbuf,
+			    &line->inlen, line->outbuf, &line->outlen,
+			    line->outputPos, line->inputPos, &line->cursorPos,
+			    0))
+    {
+      printf ("%s: back-retranslation failed\n", name);
+      return 1;
+    }
+  if (line->outlen != expected.outlen
+      || memcmp (line->outbuf, expected.outbuf,
+		 line->outlen * sizeof (widechar))
+      || memcmp (line->inputPos, expected.inputPos,
+		 line->outlen * sizeof (int))
+      || memcmp (line->outputPos, expected.outputPos,
+		 line->inlen * sizeof (int))
+      || line->cursorPos != expected.cursorPos)
+    {
+      printf ("%s: back-retranslation of %d cells differs\n", name,
+	      line->inlen);
+      return 1;
+    }
+  *previous = *line;
+  *previousCursor = cursor;
+  return 0;
+}
+
+static int
+checkEdits (const louTable * table, const char *name, const widechar * all,
+	    int alllen)
+{
+  static Line previous, line;
+  int previousCursor = -1;
+  int k;
+  previous.inlen = 0;
+  previous.outlen = 0;
+  /* Type the cells */
+  for (k = 1; k <= alllen; k++)
+    {
+      memcpy (line.inbuf, all, k * sizeof (widechar));
+      line.inlen = k;
+      if (step (table, name, &previous, &line, k, &previousCursor))
+	return 1;
+    }
+  /* Take out a cell here and there and put it back */
+  for (k = 1; k < alllen; k += 3)
+    {
+      line.inlen = alllen - 1;
+      memcpy (line.inbuf, all, k * sizeof (widechar));
+      memcpy (&line.inbuf[k], &all[k + 1],
+	      (alllen - k - 1) * sizeof (widechar));
+      if (step (table, name, &previous, &line, k, &previousCursor))
+	return 1;
+      memcpy (line.inbuf, all, alllen * sizeof (widechar));
+      line.inlen = alllen;
+      if (step (table, name, &previous, &line, k + 1, &previousCursor))
+	return 1;
+    }
+  /* Delete the cells from the front */
+  for (k = 1; k < alllen - 1; k++)
+    {
+      memcpy (line.inbuf, &all[k], (alllen - k) * sizeof (widechar));
+      line.inlen = alllen - k;
+      if (step (table, name, &previous, &line, 0, &previousCursor))
+	return 1;
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar inbuf[BUFSIZE];
+  widechar braille[BUFSIZE];
+  int inlen, braillelen;
+  static Line previous, line;
+  int previousCursor = -1;
+  louContext *ctx[2];
+  const louTable *table;
+  int result = 0;
+  int i;
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  inlen = extParseChars (text, inbuf);
+  ctx[0] = lou_createContext ();
+  ctx[1] = lou_createContext ();
+  lou_setWordCacheSize (ctx[0], 256);
+  lou_setWordCacheSize (ctx[1], 3);
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      braillelen = BUFSIZE;
+      if (!lou_translateString (tables[i], inbuf, &inlen, braille,
+				&braillelen, NULL, NULL, 0))
+	{
+	  printf ("%s translation failed\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      result |= checkCache (ctx[0], tables[i], braille, braillelen, 0,
+			    "a large cache");
+      result |= checkCache (ctx[1], tables[i], braille, braillelen, 0,
+			    "a small cache");
+      result |= checkCache (ctx[0], tables[i], braille, braillelen,
+			    pass1Only, "pass1Only");
+      result |= checkMadeUpCells (ctx[0], tables[i]);
+      if (!(table = lou_openTable (tables[i])))
+	{
+	  printf ("%s could not be opened\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      result |= checkEdits (table, tables[i], braille, braillelen);
+    }
+
+  /* An edit must be seen by the words that depend on it */
+  table = lou_openTable (tables[0]);
+  previous.inlen = previous.outlen = 0;
+  line.inlen = extParseChars (joined, line.inbuf);
+  result |= step (table, tables[0], &previous, &line, -1, &previousCursor);
+  for (i = 0; line.inbuf[i] != 's'; i++);
+  line.inlen--;
+  memmove (&line.inbuf[i], &line.inbuf[i + 1],
+	   (line.inlen - i) * sizeof (widechar));
+  result |= step (table, tables[0], &previous, &line, -1, &previousCursor);
+
+  result |= checkUndefinedPositions (tables[1]);
+
+  lou_freeContext (ctx[0]);
+  lou_freeContext (ctx[1]);
+  lou_free ();
+  return result;
+}
@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <ctype.h>
 #include <assert.h>
 #include "liblouis.h"
 #include "louis.h"
@@ -457,3 +459,617 @@ check_hyphenation(const char *tableList, const char *str, const char *expected)
   return rv;
 
 }
+
+/* Differential checks. Each optimized path of translation which is
+   turned off by clearing its part of the compiled table leaves the
+   reference code the library falls back to, so a translation with any
+   of the paths on must give the same braille, positions and cursor as
+   one with all of them off. */
+
+#define NUM_PATHS 10
+#define ALL_PATHS ((1 << NUM_PATHS) - 1)
+
+#define CHAR_INDEX_PATH (1 << 0)
+#define FOR_RULE_TRIE_PATH (1 << 1)
+#define BACK_RULE_TRIE_PATH (1 << 2)
+#define RULE_FILTER_PATH (1 << 3)
+#define FAST_LETTERS_PATH (1 << 4)
+#define COMP_CELLS_PATH (1 << 5)
+#define PASS_STARTS_PATH (1 << 6)
+#define PASS_RULE_GUARDS_PATH (1 << 7)
+#define WORD_CACHE_PATH (1 << 8)
+#define HYPHENATE_TEXT_PATH (1 << 9)
+
+static const char *path_names[NUM_PATHS] = {
+  "character index",
+  "forward rule trie",
+  "backward rule trie",
+  "rule filters",
+  "fast letters",
+  "computer braille cells",
+  "pass starts",
+  "pass rule guards",
+  "word cache",
+  "hyphenation of whole texts"
+};
+
+/* The fields of the table before ruleArea are copied whole, the cells
+   of the characters copied without selecting a rule one by one */
+#define HEADER_FIELDS_SIZE offsetof(TranslationTableHeader, ruleArea)
+
+typedef struct {
+  TranslationTableHeader *table;
+  TranslationTableHeader *header;
+  TranslationTableOffset *fast_chars;
+  widechar *fast_dots;
+  int num_fast;
+  louContext *plain_ctx;
+  louContext *cache_ctx;
+} path_switches;
+
+typedef struct {
+  int ok;
+  int inlen;
+  int outlen;
+  widechar *outbuf;
+  int *inpos;			/* NULL when no positions are asked for */
+  int *outpos;
+  int cursor;			/* -1 when no cursor is given */
+  char *hyphens;
+} path_result;
+
+#define MAX_FUZZ_LENGTH 200
+#define POOL_SIZE 256
+
+static widechar fuzz_pool[POOL_SIZE];
+static int fuzz_pool_length = 0;
+
+static int
+save_paths(const char *tableList, path_switches *sw)
+{
+  TranslationTableOffset bucket;
+  TranslationTableCharacter *character;
+  int k, pass;
+  memset(sw, 0, sizeof(*sw));
+  if (!(sw->table = lou_getTable(tableList)))
+    return 0;
+  sw->header = malloc(HEADER_FIELDS_SIZE);
+  assert(sw->header);
+  memcpy(sw->header, sw->table, HEADER_FIELDS_SIZE);
+  for (pass = 0; pass < 2; pass++)
+    {
+      sw->num_fast = 0;
+      for (k = 0; k < HASHNUM; k++)
+	for (bucket = sw->table->characters[k]; bucket;
+	     bucket = character->next)
+	  {
+	    character = (TranslationTableCharacter *)
+	      &sw->table->ruleArea[bucket];
+	    if (!character->fastDots)
+	      continue;
+	    if (pass)
+	      {
+		sw->fast_chars[sw->num_fast] = bucket;
+		sw->fast_dots[sw->num_fast] = character->fastDots;
+	      }
+	    sw->num_fast++;
+	  }
+      if (!pass)
+	{
+	  sw->fast_chars = malloc((sw->num_fast + 1)
+				  * sizeof(TranslationTableOffset));
+	  sw->fast_dots = malloc((sw->num_fast + 1) * sizeof(widechar));
+	  assert(sw->fast_chars && sw->fast_dots);
+	}
+    }
+  sw->plain_ctx = lou_createContext();
+  sw->cache_ctx = lou_createContext();
+  lou_setWordCacheSize(sw->cache_ctx, 256);
+  return 1;
+}
+
+static void
+set_paths(path_switches *sw, int paths)
+{
+  TranslationTableHeader *table = sw->table;
+  int k;
+  memcpy(table, sw->header, HEADER_FIELDS_SIZE);
+  for (k = 0; k < sw->num_fast; k++)
+    ((TranslationTableCharacter *) &table->ruleArea[sw->fast_chars[k]])
+      ->fastDots = paths & FAST_LETTERS_PATH ? sw->fast_dots[k] : 0;
+  if (!(paths & CHAR_INDEX_PATH))
+    table->characterIndex = table->dotsIndex = 0;
+  if (!(paths & FOR_RULE_TRIE_PATH))
+    table->forRuleTrie = 0;
+  if (!(paths & BACK_RULE_TRIE_PATH))
+    table->backRuleTrie = 0;
+  if (!(paths & RULE_FILTER_PATH))
+    table->forRuleFilter = table->backRuleFilter = 0;
+  if (!(paths & COMP_CELLS_PATH))
+    table->compCells = 0;
+  if (!(paths & PASS_STARTS_PATH))
+    for (k = 0; k < 5; k++)
+      table->passStarts[k].anywhere = 1;
+  if (!(paths & PASS_RULE_GUARDS_PATH))
+    memset(table->passRuleGuards, 0, sizeof(table->passRuleGuards));
+}
+
+static void
+restore_paths(path_switches *sw)
+{
+  set_paths(sw, ALL_PATHS);
+  free(sw->header);
+  free(sw->fast_chars);
+  free(sw->fast_dots);
+  lou_freeContext(sw->plain_ctx);
+  lou_freeContext(sw->cache_ctx);
+}
+
+/* Whether the table has c as a letter, which is what the words to
+   hyphenate are made of */
+static int
+is_letter(const path_switches *sw, widechar c)
+{
+  TranslationTableOffset bucket;
+  const TranslationTableCharacter *character;
+  for (bucket = sw->table->characters[charHash(c)]; bucket;
+       bucket = character->next)
+    {
+      character = (const TranslationTableCharacter *)
+	&sw->table->ruleArea[bucket];
+      if (character->realchar == c)
+	return (character->attributes & CTC_Letter) != 0;
+    }
+  return 0;
+}
+
+/* Hyphenate a text the way lou_hyphenateText does, but a word at a
+   time with lou_hyphenate. A word it refuses gets no hyphens. */
+static int
+hyphenate_words(path_switches *sw, const char *tableList,
+		const widechar *inbuf, int inlen, char *hyphens)
+{
+  int k, end;
+  memset(hyphens, '0', inlen);
+  for (k = 0; k < inlen; k = end)
+    {
+      if (!is_letter(sw, inbuf[k]))
+	{
+	  end = k + 1;
+	  continue;
+	}
+      for (end = k; end < inlen && is_letter(sw, inbuf[end]); end++);
+      if (!lou_hyphenate(tableList, &inbuf[k], end - k, &hyphens[k], 0))
+	memset(&hyphens[k], '0', end - k);
+      /* lou_hyphenate ends the hyphens of the word with a 0 byte */
+      hyphens[k] = hyphens[end] = '0';
+    }
+  hyphens[inlen] = 0;
+  return 1;
+}
+
+static void
+free_result(path_result *r)
+{
+  free(r->outbuf);
+  free(r->inpos);
+  free(r->outpos);
+  free(r->hyphens);
+}
+
+/* Translate with the given paths on. Variant 0 asks for the positions,
+   variant 1 gives a cursor in the middle of the input instead. A
+   hyphenation is of the whole input with lou_hyphenateText when that
+   path is on, and a word at a time otherwise. */
+static void
+run_paths(path_switches *sw, const char *tableList, const widechar *inbuf,
+	  const formtype *typeform, int inlen, int mode, int direction,
+	  int hyphenation, int variant, int paths, path_result *r)
+{
+  int outcap = inlen * 10 + 16;
+  formtype *typeformbuf = NULL;
+  louContext *ctx =
+    paths & WORD_CACHE_PATH ? sw->cache_ctx : sw->plain_ctx;
+  memset(r, 0, sizeof(*r));
+  set_paths(sw, paths);
+  if (hyphenation)
+    {
+      r->hyphens = calloc(inlen + 1, 1);
+      assert(r->hyphens);
+      if (paths & HYPHENATE_TEXT_PATH)
+	r->ok = lou_hyphenateText(tableList, inbuf, inlen, r->hyphens);
+      else
+	r->ok = hyphenate_words(sw, tableList, inbuf, inlen, r->hyphens);
+      return;
+    }
+  r->outbuf = malloc(outcap * sizeof(widechar));
+  assert(r->outbuf);
+  if (typeform)
+    {
+      typeformbuf = calloc(outcap, sizeof(formtype));
+      assert(typeformbuf);
+      memcpy(typeformbuf, typeform, inlen * sizeof(formtype));
+    }
+  r->cursor = -1;
+  if (variant == 0)
+    {
+      r->inpos = malloc(outcap * sizeof(int));
+      r->outpos = malloc((inlen + 1) * sizeof(int));
+      assert(r->inpos && r->outpos);
+      memset(r->inpos, 0xff, outcap * sizeof(int));
+      memset(r->outpos, 0xff, (inlen + 1) * sizeof(int));
+    }
+  else
+    r->cursor = inlen / 2;
+  r->inlen = inlen;
+  r->outlen = outcap;
+  if (direction == 0)
+    r->ok = lou_translateCtx(ctx, tableList, inbuf, &r->inlen, r->outbuf,
+			     &r->outlen, typeformbuf, NULL, r->outpos,
+			     r->inpos, variant ? &r->cursor : NULL, mode);
+  else
+    r->ok = lou_backTranslateCtx(ctx, tableList, inbuf, &r->inlen,
+				 r->outbuf, &r->outlen, typeformbuf, NULL,
+				 r->outpos, r->inpos,
+				 variant ? &r->cursor : NULL, mode);
+  free(typeformbuf);
+}
+
+static int
+same_result(const path_result *a, const path_result *b)
+{
+  if (a->ok != b->ok)
+    return 0;
+  if (!a->ok)
+    return 1;
+  if (a->hyphens)
+    return !strcmp(a->hyphens, b->hyphens);
+  return a->inlen == b->inlen && a->outlen == b->outlen
+    && a->cursor == b->cursor
+    && !memcmp(a->outbuf, b->outbuf, a->outlen * sizeof(widechar))
+    && (!a->inpos
+	|| (!memcmp(a->inpos, b->inpos, a->outlen * sizeof(int))
+	    && !memcmp(a->outpos, b->outpos, a->inlen * sizeof(int))));
+}
+
+static void
+print_result(const char *prefix, const path_result *r)
+{
+  printf("%s", prefix);
+  if (!r->ok)
+    printf("failed\n");
+  else if (r->hyphens)
+    printf("'%s'\n", r->hyphens);
+  else
+    {
+      printf("'");
+      print_widechars(r->outbuf, r->outlen);
+      printf("' (length %d, %d characters used", r->outlen, r->inlen);
+      if (r->cursor >= 0)
+	printf(", cursor at %d", r->cursor);
+      printf(")\n");
+      if (r->inpos)
+	{
+	  print_int_array("  inputPos:", r->inpos, r->outlen);
+	  print_int_array("  outputPos:", r->outpos, r->inlen);
+	}
+    }
+}
+
+/* Whether the input is translated differently with the paths on than
+   with all of them off. If report is set, the two translations are
+   printed. */
+static int
+paths_differ(path_switches *sw, const char *tableList, const widechar *inbuf,
+	     const formtype *typeform, int inlen, int mode, int direction,
+	     int hyphenation, int paths, int report)
+{
+  path_result reference, optimized;
+  int variant, differ = 0;
+  for (variant = 0; variant < (hyphenation ? 1 : 2) && !differ; variant++)
+    {
+      run_paths(sw, tableList, inbuf, typeform, inlen, mode, direction,
+		hyphenation, variant, 0, &reference);
+      run_paths(sw, tableList, inbuf, typeform, inlen, mode, direction,
+		hyphenation, variant, paths, &optimized);
+      if ((differ = !same_result(&reference, &optimized)) && report)
+	{
+	  print_result("Reference: ", &reference);
+	  print_result("Optimized: ", &optimized);
+	}
+      free_result(&reference);
+      free_result(&optimized);
+    }
+  return differ;
+}
+
+/* Remove as much of the input as can be removed with the translations
+   still differing, halving the length of the pieces tried each time
+   none can be removed. */
+static int
+minimize_input(path_switches *sw, const char *tableList, widechar *inbuf,
+	       formtype *typeform, int inlen, int mode, int direction,
+	       int hyphenation, int paths)
+{
+  widechar *candidate = malloc((inlen + 1) * sizeof(widechar));
+  formtype *candidate_typeform = typeform ?
+    malloc((inlen + 1) * sizeof(formtype)) : NULL;
+  int chunk = inlen / 2;
+  int start, removed;
+  assert(candidate && (!typeform || candidate_typeform));
+  while (chunk >= 1)
+    {
+      removed = 0;
+      for (start = 0; start + chunk <= inlen && inlen > chunk;)
+	{
+	  memcpy(candidate, inbuf, start * sizeof(widechar));
+	  memcpy(candidate + start, inbuf + start + chunk,
+		 (inlen - start - chunk) * sizeof(widechar));
+	  if (typeform)
+	    {
+	      memcpy(candidate_typeform, typeform, start * sizeof(formtype));
+	      memcpy(candidate_typeform + start, typeform + start + chunk,
+		     (inlen - start - chunk) * sizeof(formtype));
+	    }
+	  if (paths_differ(sw, tableList, candidate, candidate_typeform,
+			   inlen - chunk, mode, direction, hyphenation, paths,
+			   0))
+	    {
+	      inlen -= chunk;
+	      memcpy(inbuf, candidate, inlen * sizeof(widechar));
+	      if (typeform)
+		memcpy(typeform, candidate_typeform,
+		       inlen * sizeof(formtype));
+	      removed = 1;
+	    }
+	  else
+	    start += chunk;
+	}
+      if (!removed)
+	chunk /= 2;
+      else if (chunk > inlen / 2)
+	chunk = inlen / 2;
+    }
+  free(candidate);
+  free(candidate_typeform);
+  return inlen;
+}
+
+/* Find the path which makes the translation differ, minimize the input
+   and print it, the tables and both translations. */
+static void
+report_divergence(path_switches *sw, const char *tableList,
+		  const widechar *inbuf, const formtype *typeform, int inlen,
+		  int mode, int direction, int hyphenation)
+{
+  widechar *input = malloc((inlen + 1) * sizeof(widechar));
+  formtype *input_typeform = typeform ?
+    malloc((inlen + 1) * sizeof(formtype)) : NULL;
+  int paths = ALL_PATHS;
+  int k;
+  assert(input && (!typeform || input_typeform));
+  memcpy(input, inbuf, inlen * sizeof(widechar));
+  if (typeform)
+    memcpy(input_typeform, typeform, inlen * sizeof(formtype));
+  for (k = 0; k < NUM_PATHS; k++)
+    if (paths_differ(sw, tableList, input, input_typeform, inlen, mode,
+		     direction, hyphenation, 1 << k, 0))
+      {
+	paths = 1 << k;
+	break;
+      }
+  inlen = minimize_input(sw, tableList, input, input_typeform, inlen, mode,
+			 direction, hyphenation, paths);
+  printf("Tables: %s\n", tableList);
+  if (paths == ALL_PATHS)
+    printf("Path: all of them together\n");
+  else
+    printf("Path: %s\n", path_names[k]);
+  printf("%s: '", hyphenation ? "Hyphenation of" :
+	 direction ? "Back-translation of" : "Translation of");
+  print_widechars(input, inlen);
+  printf("' with mode %d\n", mode);
+  if (input_typeform)
+    {
+      printf("Typeform: '");
+      for (k = 0; k < inlen; k++)
+	printf("%d", input_typeform[k]);
+      printf("'\n");
+    }
+  paths_differ(sw, tableList, input, input_typeform, inlen, mode, direction,
+	       hyphenation, paths, 1);
+  free(input);
+  free(input_typeform);
+}
+
+static void
+add_to_pool(const widechar *inbuf, int inlen)
+{
+  int i, k;
+  for (i = 0; i < inlen && fuzz_pool_length < POOL_SIZE; i++)
+    {
+      for (k = 0; k < fuzz_pool_length && fuzz_pool[k] != inbuf[i]; k++);
+      if (k == fuzz_pool_length)
+	fuzz_pool[fuzz_pool_length++] = inbuf[i];
+    }
+}
+
+/* Change the input in one of a few ways chosen at random: add or remove
+   characters, repeat it, change the case of its letters, replace it by
+   characters of the tests seen so far, or give each character an
+   emphasis of its own. Returns the new length. */
+static int
+mutate_input(widechar *inbuf, formtype **typeform, int inlen, int direction)
+{
+  static const formtype emphases[] = {
+    plain_text, italic, underline, bold, computer_braille
+  };
+  int i, k, n;
+  switch (rand() % 6)
+    {
+    case 0:
+      for (n = 1 + rand() % 3; n > 0 && inlen < MAX_FUZZ_LENGTH; n--)
+	{
+	  k = rand() % (inlen + 1);
+	  memmove(inbuf + k + 1, inbuf + k, (inlen - k) * sizeof(widechar));
+	  if (*typeform)
+	    memmove(*typeform + k + 1, *typeform + k,
+		    (inlen - k) * sizeof(formtype));
+	  inbuf[k] = fuzz_pool[rand() % fuzz_pool_length];
+	  if (*typeform)
+	    (*typeform)[k] = plain_text;
+	  inlen++;
+	}
+      break;
+    case 1:
+      if (inlen > 1)
+	{
+	  k = rand() % inlen;
+	  n = 1 + rand() % (inlen - k);
+	  if (n == inlen)
+	    n--;
+	  memmove(inbuf + k, inbuf + k + n, (inlen - k - n) * sizeof(widechar));
+	  if (*typeform)
+	    memmove(*typeform + k, *typeform + k + n,
+		    (inlen - k - n) * sizeof(formtype));
+	  inlen -= n;
+	}
+      break;
+    case 2:
+      while (inlen * 2 + 1 <= MAX_FUZZ_LENGTH)
+	{
+	  inbuf[inlen] = ' ';
+	  memcpy(inbuf + inlen + 1, inbuf, inlen * sizeof(widechar));
+	  if (*typeform)
+	    {
+	      (*typeform)[inlen] = plain_text;
+	      memcpy(*typeform + inlen + 1, *typeform,
+		     inlen * sizeof(formtype));
+	    }
+	  inlen = inlen * 2 + 1;
+	}
+      break;
+    case 3:
+      for (i = 0; i < inlen; i++)
+	if (rand() % 2 && inbuf[i] < 128 && isalpha(inbuf[i]))
+	  inbuf[i] ^= 0x20;
+      break;
+    case 4:
+      inlen = 1 + rand() % 40;
+      for (i = 0; i < inlen; i++)
+	inbuf[i] = fuzz_pool[rand() % fuzz_pool_length];
+      if (*typeform)
+	memset(*typeform, 0, inlen * sizeof(formtype));
+      break;
+    case 5:
+      if (direction)
+	break;
+      if (!*typeform)
+	{
+	  *typeform = calloc(MAX_FUZZ_LENGTH + 1, sizeof(formtype));
+	  assert(*typeform);
+	}
+      for (i = 0; i < inlen; i++)
+	(*typeform)[i] = emphases[rand() % 5];
+      break;
+    }
+  return inlen;
+}
+
+/* Seed the fuzzing and compile tables from their source, so that they
+   are not mapped read-only from an image. Called before the first
+   check_differential. */
+void
+start_differential(unsigned int seed)
+{
+  srand(seed);
+  enableCompiledTables(0);
+}
+
+/* Check that a string, and fuzz variants of it made at random, are
+   translated the same with the optimized paths on as with all of them
+   off. Return 0 if so and 1 after printing the smallest input found to
+   be translated differently. */
+int
+check_differential(const char *tableList, const char *str,
+		   const char *typeform, int mode, int direction,
+		   int hyphenation, int fuzz)
+{
+  static const char *extra = " A1.-'";
+  path_switches sw;
+  widechar *inbuf, *fuzzbuf;
+  formtype *typeformbuf = NULL, *fuzz_typeform = NULL;
+  int inlen, fuzzlen;
+  int i, rv = 0;
+
+  inlen = strlen(str);
+  inbuf = malloc(sizeof(widechar) * (inlen + 1));
+  fuzzbuf = malloc(sizeof(widechar) * (MAX_FUZZ_LENGTH + 1));
+  assert(inbuf && fuzzbuf);
+  inlen = extParseChars(str, inbuf);
+  if (inlen <= 0 || inlen > MAX_FUZZ_LENGTH)
+    {
+      free(inbuf);
+      free(fuzzbuf);
+      return 0;
+    }
+  if (typeform)
+    {
+      typeformbuf = calloc(inlen + 1, sizeof(formtype));
+      assert(typeformbuf);
+      for (i = 0; i < inlen; i++)
+	typeformbuf[i] = typeform[i];
+    }
+  if (!save_paths(tableList, &sw))
+    {
+      printf("Cannot compile %s\n", tableList);
+      free(inbuf);
+      free(fuzzbuf);
+      free(typeformbuf);
+      return 1;
+    }
+  add_to_pool(inbuf, inlen);
+  for (i = 0; extra[i] && !direction; i++)
+    {
+      widechar c = extra[i];
+      add_to_pool(&c, 1);
+    }
+
+  if (paths_differ(&sw, tableList, inbuf, typeformbuf, inlen, mode,
+		   direction, hyphenation, ALL_PATHS, 0))
+    {
+      report_divergence(&sw, tableList, inbuf, typeformbuf, inlen, mode,
+			direction, hyphenation);
+      rv = 1;
+    }
+  for (i = 0; i < fuzz && !rv; i++)
+    {
+      fuzzlen = inlen;
+      memcpy(fuzzbuf, inbuf, inlen * sizeof(widechar));
+      free(fuzz_typeform);
+      fuzz_typeform = NULL;
+      if (typeformbuf)
+	{
+	  fuzz_typeform = calloc(MAX_FUZZ_LENGTH + 1, sizeof(formtype));
+	  assert(fuzz_typeform);
+	  memcpy(fuzz_typeform, typeformbuf, inlen * sizeof(formtype));
+	}
+      fuzzlen = mutate_input(fuzzbuf, &fuzz_typeform, fuzzlen, direction);
+      if (rand() % 2)
+	fuzzlen = mutate_input(fuzzbuf, &fuzz_typeform, fuzzlen, direction);
+      if (paths_differ(&sw, tableList, fuzzbuf, fuzz_typeform, fuzzlen, mode,
+		       direction, hyphenation, ALL_PATHS, 0))
+	{
+	  report_divergence(&sw, tableList, fuzzbuf, fuzz_typeform, fuzzlen,
+			    mode, direction, hyphenation);
+	  rv = 1;
+	}
+    }
+
+  restore_paths(&sw);
+  free(inbuf);
+  free(fuzzbuf);
+  free(typeformbuf);
+  free(fuzz_typeform);
+  return rv;
+}
@@ -39,6 +39,18 @@ int check_with_mode(const char *tableList, const char *str, const char *typeform
    hyphenation is as expected and 1 otherwise. */
 int check_hyphenation(const char *tableList, const char *str, const char *expected);
 
+/* Prepare for check_differential, seeding rand() with seed. */
+void start_differential(unsigned int seed);
+
+/* Check that a string is translated, or hyphenated, the same with the
+   optimized paths of the library on as with all of them off, and so
+   are fuzz variants of it made at random with rand(). Return 0 if so
+   and 1 after printing the smallest input found to differ and the path
+   which made it differ. */
+int check_differential(const char *tableList, const char *str,
+		       const char *typeform, int mode, int direction,
+		       int hyphenation, int fuzz);
+
 /* Helper function to convert a typeform string of '0's, '1's, '2's etc.
    to the required format, which is an array of 0s, 1s, 2s, etc.
    For example, "0000011111000" is converted to {0,0,0,0,0,1,1,1,1,1,0,0,0}
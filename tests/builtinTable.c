@@ -0,0 +1,145 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that an image registered with lou_registerCompiledTable is
+   used for its table list without looking for any files, also after
+   it has been evicted and when a rule is added to it, and that an
+   image made by another version of liblouis is refused. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#define BUFSIZE 256
+
+static const char *table = "en-us-g2.ctb";
+static const char *builtin = "builtin-en-us-g2";
+static const char *imageFile = "builtinTable.lbt";
+static const char *text = "the quick brown fox jumps over the lazy dog";
+
+static int
+translate (const char *tableList, widechar *outbuf, int *outlen)
+{
+  widechar inbuf[BUFSIZE];
+  int inlen = extParseChars (text, inbuf);
+  *outlen = BUFSIZE;
+  return lou_translate (tableList, inbuf, &inlen, outbuf, outlen, NULL,
+			NULL, NULL, NULL, NULL, 0);
+}
+
+static unsigned char *
+readImage (int *size)
+{
+  FILE *f;
+  unsigned char *image = NULL;
+  long length;
+  if (!(f = fopen (imageFile, "rb")))
+    return NULL;
+  if (fseek (f, 0, SEEK_END) == 0 && (length = ftell (f)) > 0
+      && fseek (f, 0, SEEK_SET) == 0 && (image = malloc (length))
+      && fread (image, length, 1, f) != 1)
+    {
+      free (image);
+      image = NULL;
+    }
+  fclose (f);
+  *size = length;
+  return image;
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar expected[BUFSIZE];
+  widechar outbuf[BUFSIZE];
+  int expectedlen, outlen, size;
+  unsigned char *image;
+  int result = 0;
+
+  if (!translate (table, expected, &expectedlen)
+      || !lou_saveCompiledTable (table, imageFile))
+    {
+      printf ("Cannot compile %s\n", table);
+      return 1;
+    }
+  image = readImage (&size);
+  remove (imageFile);
+  lou_free ();
+  if (!image)
+    {
+      printf ("Cannot read the image of %s\n", table);
+      return 1;
+    }
+
+  if (lou_getTable (builtin))
+    {
+      printf ("%s is found before it is registered\n", builtin);
+      result = 1;
+    }
+  if (!lou_registerCompiledTable (builtin, image, size))
+    {
+      printf ("Cannot register the image of %s\n", table);
+      free (image);
+      return 1;
+    }
+  if (!translate (builtin, outbuf, &outlen) || outlen != expectedlen
+      || memcmp (outbuf, expected, outlen * sizeof (widechar)))
+    {
+      printf ("%s translates differently from %s\n", builtin, table);
+      result = 1;
+    }
+
+  /* Evict it by using another table */
+  lou_setTableCacheSize (1);
+  lou_getTable ("en-us-g1.ctb");
+  if (!translate (builtin, outbuf, &outlen) || outlen != expectedlen
+      || memcmp (outbuf, expected, outlen * sizeof (widechar)))
+    {
+      printf ("%s translates differently after being evicted\n", builtin);
+      result = 1;
+    }
+  lou_setTableCacheSize (0);
+
+  if (!lou_compileString (builtin, "word quick 1-2-3"))
+    {
+      printf ("Cannot add a rule to %s\n", builtin);
+      result = 1;
+    }
+  else if (!translate (builtin, outbuf, &outlen)
+	   || (outlen == expectedlen
+	       && !memcmp (outbuf, expected, outlen * sizeof (widechar))))
+    {
+      printf ("A rule added to %s is not used\n", builtin);
+      result = 1;
+    }
+
+  /* Another format version, after the magic */
+  image[8] ^= 1;
+  if (lou_registerCompiledTable ("builtin-damaged", image, size))
+    {
+      printf ("An image of another version is registered\n");
+      result = 1;
+    }
+  image[8] ^= 1;
+  if (lou_registerCompiledTable ("builtin-short", image, size - 1))
+    {
+      printf ("A short image is registered\n");
+      result = 1;
+    }
+
+  lou_free ();
+  /* Registering lasts beyond lou_free */
+  if (!lou_getTable (builtin))
+    {
+      printf ("%s is lost by lou_free\n", builtin);
+      result = 1;
+    }
+  lou_free ();
+  free (image);
+  return result;
+}
@@ -0,0 +1,69 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that the report of lou_checktable --stats finds the longest
+   chain of forward rules, that of the rules beginning with "th", with
+   the number of rules of each beginning, and the mean length of the
+   chain a rule is in. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "liblouis.h"
+#include "louis.h"
+
+static const char *tableName = "chainReport.ctb";
+
+int
+main (int argc, char **argv)
+{
+  const TranslationTableHeader *table;
+  ChainReport chains[2];
+  double mean;
+  FILE *file;
+  int n;
+  int result = 0;
+
+  if (!(file = fopen (tableName, "w")))
+    {
+      printf ("%s could not be written\n", tableName);
+      return 1;
+    }
+  fputs ("include latinLetterDef6Dots.uti\n"
+	 "always tha 1\n" "always thb 12\n" "always thc 14\n"
+	 "always thd 15\n" "always theme 145\n" "always ab 1\n", file);
+  fclose (file);
+  if (!(table = lou_getTable (tableName)))
+    {
+      printf ("%s could not be compiled\n", tableName);
+      return 1;
+    }
+  n = worstChains (table, 0, chains, 2, &mean);
+  if (n != 2 || chains[0].length != 5 || chains[0].numPrefixes != 1
+      || chains[0].prefixCounts[0] != 5 || chains[0].prefixes[0][0] != 't'
+      || chains[0].prefixes[0][1] != 'h' || chains[1].length != 1)
+    {
+      printf ("The longest chains are not the ones of th and ab\n");
+      result = 1;
+    }
+  /* Five rules in a chain of five and one alone */
+  if (mean < 26.0 / 6 - 0.001 || mean > 26.0 / 6 + 0.001)
+    {
+      printf ("The mean chain length is %g instead of %g\n", mean,
+	      26.0 / 6);
+      result = 1;
+    }
+  if (worstChains (table, 2, chains, 1, NULL) != 1
+      || chains[0].length < 1 || chains[0].prefixes[0][1] != 0)
+    {
+      printf ("No chain of characters was found\n");
+      result = 1;
+    }
+  lou_free ();
+  remove (tableName);
+  return result;
+}
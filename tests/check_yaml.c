@@ -1,8 +1,11 @@
 #include <config.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <error.h>
+#include <getopt.h>
+#include <time.h>
 #include "liblouis.h"
 #include "brl_checks.h"
 
@@ -23,11 +26,49 @@ yaml_parser_t parser;
 yaml_event_t event;
 
 char *file_name;
-int translation_mode = 0;
 
 int errors = 0;
 int count = 0;
 
+/* timing mode, see print_help */
+int timing = 0;
+int repeat = 10;
+double tolerance = 25;
+char *baseline_dir = NULL;
+char *save_dir = NULL;
+double max_test = 0;		/* milliseconds, from the timing section */
+double max_total = 0;
+
+/* differential mode, see print_help */
+int differential = 0;
+int fuzz = 0;
+unsigned int seed = 1;
+int diverged = 0;
+
+/* a regression of a single test smaller than this many seconds is noise */
+#define TIMING_NOISE 0.0001
+
+typedef struct {
+  size_t line;
+  double seconds;		/* per run */
+} test_time;
+
+test_time *times = NULL;
+int num_times = 0;
+int slow = 0;
+
+#if OFFSETBITS == 16
+/* a compact build cannot compile the largest tables, see main */
+int too_large = 0;
+
+void
+note_too_large(int level, const char *message) {
+  fprintf(stderr, "%s\n", message);
+  if (strstr(message, "Table too large"))
+    too_large = 1;
+}
+#endif
+
 void
 simple_error (const char *msg, yaml_event_t *event) {
   error_at_line(EXIT_FAILURE, 0, file_name, event->start_mark.line, "%s", msg);
@@ -117,6 +158,42 @@ read_flags (yaml_parser_t *parser, int *direction, int *hyphenation) {
   yaml_event_delete(&event);
 }
 
+void
+read_timing (yaml_parser_t *parser) {
+  yaml_event_t event;
+  int parse_error = 1;
+  double *limit = NULL;
+
+  if (!yaml_parser_parse(parser, &event) ||
+      (event.type != YAML_MAPPING_START_EVENT))
+    yaml_error(YAML_MAPPING_START_EVENT, &event);
+
+  yaml_event_delete(&event);
+
+  while ((parse_error = yaml_parser_parse(parser, &event)) &&
+	 (event.type == YAML_SCALAR_EVENT)) {
+    if (!strcmp(event.data.scalar.value, "max-test")) {
+      limit = &max_test;
+    } else if (!strcmp(event.data.scalar.value, "max-total")) {
+      limit = &max_total;
+    } else {
+      error_at_line(EXIT_FAILURE, 0, file_name, event.start_mark.line,
+		    "Timing limit '%s' not supported\n", event.data.scalar.value);
+    }
+    yaml_event_delete(&event);
+    if (!yaml_parser_parse(parser, &event) ||
+	(event.type != YAML_SCALAR_EVENT))
+      yaml_error(YAML_SCALAR_EVENT, &event);
+    *limit = atof(event.data.scalar.value);
+    yaml_event_delete(&event);
+  }
+  if (!parse_error)
+    simple_error("Error in YAML", &event);
+  if (event.type != YAML_MAPPING_END_EVENT)
+    yaml_error(YAML_MAPPING_END_EVENT, &event);
+  yaml_event_delete(&event);
+}
+
 int
 read_xfail (yaml_parser_t *parser) {
   yaml_event_t event;
@@ -265,6 +342,139 @@ my_strlen_utf8_c(char *s) {
    return j;
 }
 
+double
+now () {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int
+run_test(char *tables_list, char *word, char *translation, char *typeform,
+	 int *cursorPos, int mode, int direction, int hyphenation) {
+  if (cursorPos)
+    return check_cursor_pos(tables_list, word, cursorPos);
+  else if (hyphenation)
+    return check_hyphenation(tables_list, word, translation);
+  else
+    return check_with_mode(tables_list, word, typeform,
+			   translation, mode, direction);
+}
+
+void
+time_test(size_t line, char *tables_list, char *word, char *translation,
+	  char *typeform, int *cursorPos, int mode, int direction,
+	  int hyphenation) {
+  double start = now();
+  int i;
+  for (i = 0; i < repeat; i++)
+    run_test(tables_list, word, translation, typeform, cursorPos, mode,
+	     direction, hyphenation);
+  times = realloc(times, sizeof(test_time) * (num_times + 1));
+  assert(times);
+  times[num_times].line = line;
+  times[num_times].seconds = (now() - start) / repeat;
+  num_times++;
+}
+
+char *
+timing_file_name (const char *dir) {
+  const char *base = strrchr(file_name, '/') ? strrchr(file_name, '/') + 1 : file_name;
+  char *name = malloc(strlen(dir) + strlen(base) + 9);
+  assert(name);
+  sprintf(name, "%s/%s.timing", dir, base);
+  return name;
+}
+
+void
+save_times (double total) {
+  char *name = timing_file_name(save_dir);
+  FILE *file = fopen(name, "w");
+  int i;
+  if (!file)
+    error(EXIT_FAILURE, 0, "%s could not be written", name);
+  fprintf(file, "total %.9f\n", total);
+  for (i = 0; i < num_times; i++)
+    fprintf(file, "%zu %.9f\n", times[i].line, times[i].seconds);
+  fclose(file);
+  free(name);
+}
+
+int
+regressed (double seconds, double base, double noise) {
+  return base > 0 && seconds > base * (1 + tolerance / 100)
+    && seconds - base > noise;
+}
+
+void
+compare_times (double total) {
+  char *name = timing_file_name(baseline_dir);
+  FILE *file = fopen(name, "r");
+  char key[32];
+  double base;
+  size_t line;
+  int i = 0;
+  if (!file) {
+    fprintf(stderr, "%s: no baseline in %s\n", file_name, name);
+    free(name);
+    return;
+  }
+  while (fscanf(file, "%31s %lf", key, &base) == 2) {
+    if (!strcmp(key, "total")) {
+      if (regressed(total, base, 0)) {
+	fprintf(stderr, "%s: %.3f ms per run instead of %.3f ms\n", file_name,
+		total * 1000, base * 1000);
+	slow++;
+      }
+      continue;
+    }
+    /* both are in the order of the lines of the tests */
+    line = strtoul(key, NULL, 10);
+    while (i < num_times && times[i].line < line)
+      i++;
+    if (i < num_times && times[i].line == line
+	&& regressed(times[i].seconds, base, TIMING_NOISE)) {
+      fprintf(stderr, "%s:%zu %.3f ms per run instead of %.3f ms\n",
+	      file_name, line, times[i].seconds * 1000, base * 1000);
+      slow++;
+    }
+  }
+  fclose(file);
+  free(name);
+}
+
+void
+report_times (char *tables_list) {
+  double total = 0;
+  int slowest = -1;
+  int i;
+  for (i = 0; i < num_times; i++) {
+    total += times[i].seconds;
+    if (slowest < 0 || times[i].seconds > times[slowest].seconds)
+      slowest = i;
+    if (max_test > 0 && times[i].seconds * 1000 > max_test) {
+      fprintf(stderr, "%s:%zu %.3f ms per run, more than %g ms\n", file_name,
+	      times[i].line, times[i].seconds * 1000, max_test);
+      slow++;
+    }
+  }
+  printf("%s: %d tests of %s timed over %d runs, %.3f ms per run",
+	 file_name, num_times, tables_list, repeat, total * 1000);
+  if (slowest >= 0)
+    printf(", slowest at line %zu with %.3f ms",
+	   times[slowest].line, times[slowest].seconds * 1000);
+  printf("\n");
+  if (max_total > 0 && total * 1000 > max_total) {
+    fprintf(stderr, "%s: %.3f ms per run, more than %g ms\n", file_name,
+	    total * 1000, max_total);
+    slow++;
+  }
+  if (baseline_dir)
+    compare_times(total);
+  if (save_dir)
+    save_times(total);
+}
+
 void
 read_test(yaml_parser_t *parser, char *tables_list, int direction, int hyphenation) {
   yaml_event_t event;
@@ -307,31 +517,23 @@ read_test(yaml_parser_t *parser, char *tables_list, int direction, int hyphenati
 		  event_names[event.type]);
   }
 
-  if (cursorPos) {
-    if (xfail != check_cursor_pos(tables_list, word, cursorPos)) {
-      char *error_msg = "Failure";
-      if (xfail)
-	error_msg = "Unexpected Pass";
-      fprintf(stderr, "%s:%zu %s\n", file_name, event.start_mark.line, error_msg);
-      errors++;
-    }
-  } else if (hyphenation) {
-    if (xfail != check_hyphenation(tables_list, word, translation)) {
-      char *error_msg = "Failure";
-      if (xfail)
-	error_msg = "Unexpected Pass";
-      fprintf(stderr, "%s:%zu %s\n", file_name, event.start_mark.line, error_msg);
-      errors++;
-    }
-  } else {
-    if (xfail != check_with_mode(tables_list, word, typeform,
-				 translation, translation_mode, direction)) {
-      char *error_msg = "Failure";
-      if (xfail)
-	error_msg = "Unexpected Pass";
-      fprintf(stderr, "%s:%zu %s\n", file_name, event.start_mark.line, error_msg);
-      errors++;
-    }
+  if (xfail != run_test(tables_list, word, translation, typeform, cursorPos,
+		       mode, direction, hyphenation)) {
+    char *error_msg = "Failure";
+    if (xfail)
+      error_msg = "Unexpected Pass";
+    fprintf(stderr, "%s:%zu %s\n", file_name, event.start_mark.line, error_msg);
+    errors++;
+  } else if (timing && !xfail) {
+    /* only passing tests are timed, failing ones print their failure */
+    time_test(event.start_mark.line, tables_list, word, translation,
+	      typeform, cursorPos, mode, direction, hyphenation);
+  }
+  if (differential && check_differential(tables_list, word, typeform, mode,
+					  direction, hyphenation, fuzz)) {
+    fprintf(stderr, "%s:%zu Optimized paths differ\n", file_name,
+	    event.start_mark.line);
+    diverged++;
   }
   yaml_event_delete(&event);
   count++;
@@ -373,15 +575,89 @@ read_tests(yaml_parser_t *parser, char *tables_list, int direction, int hyphenat
 
 #endif
 
+static const struct option longopts[] = {
+  {"help", no_argument, NULL, 'h'},
+  {"timing", no_argument, NULL, 't'},
+  {"repeat", required_argument, NULL, 'r'},
+  {"tolerance", required_argument, NULL, 'T'},
+  {"baseline", required_argument, NULL, 'b'},
+  {"save-baseline", required_argument, NULL, 's'},
+  {"differential", no_argument, NULL, 'd'},
+  {"fuzz", required_argument, NULL, 'f'},
+  {"seed", required_argument, NULL, 'S'},
+  {NULL, 0, NULL, 0}
+};
+
+static void
+print_help (const char *program_name) {
+  printf("Usage: %s [OPTIONS] file.yaml\n", program_name);
+  fputs("\
+Run the tests of a YAML file.\n\
+\n\
+  -h, --help                display this help and exit\n\
+  -t, --timing              time each passing test, and fail where it is\n\
+                            slower than the limits of the timing section\n\
+                            of the file or than the baseline\n\
+  -r, --repeat=N            run each timed test N times, 10 by default\n\
+  -T, --tolerance=PERCENT   how much slower than the baseline a test may\n\
+                            be, 25 by default\n\
+  -b, --baseline=DIR        compare with the times saved in DIR\n\
+  -s, --save-baseline=DIR   save the times in DIR\n\
+  -d, --differential        also check that each test is translated the\n\
+                            same with every optimized path of the library\n\
+                            on as with all of them off, and print the\n\
+                            smallest input found to differ\n\
+  -f, --fuzz=N              with --differential, also check N variants of\n\
+                            each test made at random\n\
+  -S, --seed=N              seed the random variants with N, 1 by default\n", stdout);
+}
+
 int
 main(int argc, char *argv[]) {
-  if (argc != 2) {
-    printf("Usage: %s file.yaml\n", argv[0]);
+  int optc;
+  while ((optc = getopt_long(argc, argv, "htr:T:b:s:df:S:", longopts, NULL)) != -1) {
+    switch (optc) {
+    case 'h':
+      print_help(argv[0]);
+      return 0;
+    case 't':
+      timing = 1;
+      break;
+    case 'r':
+      repeat = atoi(optarg);
+      if (repeat < 1)
+	repeat = 1;
+      break;
+    case 'T':
+      tolerance = atof(optarg);
+      break;
+    case 'b':
+      baseline_dir = optarg;
+      break;
+    case 's':
+      save_dir = optarg;
+      break;
+    case 'd':
+      differential = 1;
+      break;
+    case 'f':
+      fuzz = atoi(optarg);
+      break;
+    case 'S':
+      seed = strtoul(optarg, NULL, 10);
+      break;
+    default:
+      fprintf(stderr, "Try `%s --help' for more information.\n", argv[0]);
+      return 1;
+    }
+  }
+  if (optind != argc - 1) {
+    printf("Usage: %s [OPTIONS] file.yaml\n", argv[0]);
     return 0;
   }
 
 #ifndef HAVE_LIBYAML
-  fprintf(stderr, "Skipping tests for %s as libyaml was not found\n", argv[1]);
+  fprintf(stderr, "Skipping tests for %s as libyaml was not found\n", argv[optind]);
   return EXIT_SKIPPED;
 
 #else
@@ -393,10 +669,13 @@ main(int argc, char *argv[]) {
   int direction = 0;
   int hyphenation = 0;
 
-  file = fopen(argv[1], "rb");
+  if (differential)
+    start_differential(seed);
+
+  file = fopen(argv[optind], "rb");
   assert(file);
 
-  file_name = argv[1];
+  file_name = argv[optind];
 
   assert(yaml_parser_initialize(&parser));
 
@@ -428,6 +707,16 @@ main(int argc, char *argv[]) {
   char *tables_list = malloc(sizeof(char) * 512);
   read_tables(&parser, tables_list);
 
+#if OFFSETBITS == 16
+  lou_registerLogCallback(note_too_large);
+  if (!lou_getTable(tables_list) && too_large) {
+    fprintf(stderr, "Skipping tests for %s as %s does not fit in 16-bit offsets\n",
+	    file_name, tables_list);
+    return EXIT_SKIPPED;
+  }
+  lou_registerLogCallback(NULL);
+#endif
+
   if (!yaml_parser_parse(&parser, &event) ||
       (event.type != YAML_SCALAR_EVENT)) {
     yaml_error(YAML_SCALAR_EVENT, &event);
@@ -438,18 +727,26 @@ main(int argc, char *argv[]) {
     read_flags(&parser, &direction, &hyphenation);
 
     if (!yaml_parser_parse(&parser, &event) ||
-	(event.type != YAML_SCALAR_EVENT) ||
-	strcmp(event.data.scalar.value, "tests")) {
-      simple_error("tests expected", &event);
+	(event.type != YAML_SCALAR_EVENT)) {
+      simple_error("timing or tests expected", &event);
     }
+  }
+
+  if (!strcmp(event.data.scalar.value, "timing")) {
     yaml_event_delete(&event);
-    read_tests(&parser, tables_list, direction, hyphenation);
+    read_timing(&parser);
+
+    if (!yaml_parser_parse(&parser, &event) ||
+	(event.type != YAML_SCALAR_EVENT)) {
+      simple_error("tests expected", &event);
+    }
+  }
 
-  } else if (!strcmp(event.data.scalar.value, "tests")) {
+  if (!strcmp(event.data.scalar.value, "tests")) {
     yaml_event_delete(&event);
     read_tests(&parser, tables_list, direction, hyphenation);
   } else {
-    simple_error("flags or tests expected", &event);
+    simple_error("flags, timing or tests expected", &event);
   }
 
   if (!yaml_parser_parse(&parser, &event) ||
@@ -472,14 +769,24 @@ main(int argc, char *argv[]) {
 
   yaml_parser_delete(&parser);
 
+  if (timing)
+    report_times(tables_list);
+
   lou_free();
 
   assert(!fclose(file));
 
-  printf("%s (%d tests, %d failure%s)\n", (errors ? "FAILURE" : "SUCCESS"),
-	 count, errors, ((errors != 1) ? "s" : ""));
-
-  return errors ? 1 : 0;
+  if (slow)
+    printf("FAILURE (%d tests, %d failure%s, %d too slow)\n", count, errors,
+	   ((errors != 1) ? "s" : ""), slow);
+  else if (diverged)
+    printf("FAILURE (%d tests, %d failure%s, %d differing)\n", count, errors,
+	   ((errors != 1) ? "s" : ""), diverged);
+  else
+    printf("%s (%d tests, %d failure%s)\n", (errors ? "FAILURE" : "SUCCESS"),
+	   count, errors, ((errors != 1) ? "s" : ""));
+
+  return errors || slow || diverged ? 1 : 0;
 
 #endif
 }
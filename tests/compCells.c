@@ -0,0 +1,143 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that runs of computer braille put at once translate the same,
+   with the same input and output positions and when the output does
+   not hold them, as character by character, and that a computer
+   braille rule added with lou_compileString is used. */
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+#define BUFSIZE 512
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "en-ueb-g2.ctb",
+  "de-de-g2.ctb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static const char *text = "See http://www.example.com/path/file_1.html?x=2&y=abc "
+  "or mail user.name@example.org; int main (void) { return a[i] * 2; }";
+
+/* Computer braille over "int main (void)" */
+static const char *emphasis = "                                             "
+  "                                        CCCCCCCCCCCCCCC";
+
+static const int outlens[] = { BUFSIZE, 40, 13 };
+
+#define NUMOUTLENS (sizeof (outlens) / sizeof (outlens[0]))
+
+typedef struct
+{
+  widechar outbuf[BUFSIZE];
+  int inlen;
+  int outlen;
+  int inputPos[BUFSIZE];
+  int outputPos[BUFSIZE];
+  int ok;
+} Result;
+
+/* With emphasized 1 the text is translated with the emphasis above, with
+   2 all of it is computer braille */
+static void
+translate (const char *table, const widechar *inbuf, int inlen,
+	   Result *result, int outlen, int emphasized)
+{
+  formtype typeform[BUFSIZE];
+  int k;
+  for (k = 0; k < inlen; k++)
+    typeform[k] = emphasized == 2 || (k < strlen (emphasis)
+				      && emphasis[k] != ' ') ?
+      computer_braille : plain_text;
+  memset (result, 0, sizeof (*result));
+  result->inlen = inlen;
+  result->outlen = outlen;
+  result->ok = lou_translate (table, inbuf, &result->inlen, result->outbuf,
+			      &result->outlen, emphasized ? typeform : NULL,
+			      NULL, result->outputPos, result->inputPos,
+			      NULL, 0);
+}
+
+static int
+sameResult (const Result *a, const Result *b)
+{
+  return a->ok == b->ok && a->inlen == b->inlen && a->outlen == b->outlen
+    && !memcmp (a->outbuf, b->outbuf, a->outlen * sizeof (widechar))
+    && !memcmp (a->inputPos, b->inputPos, a->outlen * sizeof (int))
+    && !memcmp (a->outputPos, b->outputPos, a->inlen * sizeof (int));
+}
+
+int
+main (int argc, char **argv)
+{
+  static Result expected[2 * NUMOUTLENS], received;
+  widechar inbuf[BUFSIZE];
+  int inlen;
+  TranslationTableHeader *table;
+  TranslationTableOffset compCells;
+  int result = 0;
+  int i, m;
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  inlen = extParseChars (text, inbuf);
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      if (!(table = lou_getTable (tables[i])) || !table->compCells)
+	{
+	  printf ("%s has no cells of computer braille\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      compCells = table->compCells;
+      for (m = 0; m < 2 * NUMOUTLENS; m++)
+	translate (tables[i], inbuf, inlen, &expected[m],
+		   outlens[m % NUMOUTLENS], m >= NUMOUTLENS);
+      table->compCells = 0;
+      for (m = 0; m < 2 * NUMOUTLENS; m++)
+	{
+	  translate (tables[i], inbuf, inlen, &received,
+		     outlens[m % NUMOUTLENS], m >= NUMOUTLENS);
+	  if (!sameResult (&expected[m], &received))
+	    {
+	      printf ("%s translates differently into %d cells%s one "
+		      "character at a time\n", tables[i],
+		      outlens[m % NUMOUTLENS],
+		      m >= NUMOUTLENS ? " with emphasis" : "");
+	      result = 1;
+	    }
+	}
+      table->compCells = compCells;
+    }
+
+  inlen = extParseChars ("~", inbuf);
+  translate (tables[0], inbuf, inlen, &expected[0], BUFSIZE, 2);
+  if (!lou_compileString (tables[0], "comp6 ~ 12456"))
+    {
+      printf ("Cannot add a rule to %s\n", tables[0]);
+      result = 1;
+    }
+  else
+    {
+      translate (tables[0], inbuf, inlen, &received, BUFSIZE, 2);
+      if (sameResult (&expected[0], &received))
+	{
+	  printf ("A rule added with lou_compileString is not used\n");
+	  result = 1;
+	}
+    }
+
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,88 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that profiling a compilation charges the rules and the table
+   space to the files and rule families they belong to, and that
+   nothing is added once profiling has stopped. */
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+static const char *table = "en-us-g2.ctb,hyph_en_US.dic";
+
+int
+main (int argc, char **argv)
+{
+  CompileProfile profile;
+  TranslationTableHeader *compiled;
+  int result = 0;
+  int bytes = 0;
+  int rules = 0;
+  int hyphenationFile = 0;
+  int k;
+
+#if OFFSETBITS == 16
+  /* en-us-g2 with hyph_en_US does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  memset (&profile, 0, sizeof (profile));
+  profileCompilation (&profile);
+  compiled = lou_getTable (table);
+  profileCompilation (NULL);
+  if (!compiled)
+    {
+      printf ("%s does not compile\n", table);
+      return 1;
+    }
+  for (k = 0; k < profile.numFiles; k++)
+    {
+      bytes += profile.files[k].bytes;
+      rules += profile.files[k].rules;
+      if (strstr (profile.files[k].fileName, "hyph_en_US.dic"))
+	hyphenationFile = profile.files[k].rules == 1;
+    }
+  if (profile.numFiles < 3 || !hyphenationFile)
+    {
+      printf ("The files of %s were not all profiled\n", table);
+      result = 1;
+    }
+  if (bytes <= 0 || bytes > compiled->bytesUsed)
+    {
+      printf ("%d bytes charged to files, table uses %d\n", bytes,
+	      compiled->bytesUsed);
+      result = 1;
+    }
+  for (k = 0; k < PROFILE_FAMILIES; k++)
+    rules -= profile.familyRules[k];
+  if (rules > 0 || !profile.familyRules[profileCharacters]
+      || !profile.familyRules[profileTranslationRules]
+      || profile.familyRules[profileHyphenation] != 1
+      || profile.familyBytes[profileHyphenation] <= 0)
+    {
+      printf ("Rules were not charged to their families\n");
+      result = 1;
+    }
+  for (k = 0; k < PROFILE_PHASES; k++)
+    if (profile.phaseTime[k] < 0)
+      {
+	printf ("Phase %d took negative time\n", k);
+	result = 1;
+      }
+
+  k = profile.numFiles;
+  if (!lou_getTable ("en-us-g1.ctb") || profile.numFiles != k)
+    {
+      printf ("A table was profiled after profiling stopped\n");
+      result = 1;
+    }
+
+  freeCompileProfile (&profile);
+  lou_free ();
+  return result;
+}
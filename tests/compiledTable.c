@@ -0,0 +1,121 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that a table saved with lou_saveCompiledTable and loaded again
+   with lou_loadCompiledTable translates and hyphenates exactly like
+   the compiled table, and that a damaged image is refused. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#define BUFSIZE 256
+
+static const char *table = "en-us-g2.ctb,hyph_en_US.dic";
+static const char *imageFile = "compiledTable.lbt";
+static const char *text = "the quick brown fox jumps over the lazy dog";
+static const char *word = "hyphenation";
+
+static int
+translate (widechar *inbuf, int inlen, widechar *outbuf, int *outlen)
+{
+  int k = inlen;
+  *outlen = BUFSIZE;
+  return lou_translate (table, inbuf, &k, outbuf, outlen, NULL, NULL,
+			NULL, NULL, NULL, 0);
+}
+
+static int
+damageImage (void)
+{
+  FILE *f;
+  int c;
+  if (!(f = fopen (imageFile, "r+b")) || fseek (f, -1, SEEK_END)
+      || (c = fgetc (f)) == EOF || fseek (f, -1, SEEK_END)
+      || fputc (c ^ 1, f) == EOF)
+    return 0;
+  return fclose (f) == 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar inbuf[BUFSIZE];
+  widechar expected[BUFSIZE];
+  widechar outbuf[BUFSIZE];
+  widechar wordbuf[BUFSIZE];
+  char expectedHyphens[BUFSIZE];
+  char hyphens[BUFSIZE];
+  int inlen, expectedlen, outlen, wordlen;
+  void *loaded;
+  int result = 0;
+
+#if OFFSETBITS == 16
+  /* en-us-g2 with hyph_en_US does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  inlen = extParseChars (text, inbuf);
+  if (!translate (inbuf, inlen, expected, &expectedlen))
+    {
+      printf ("Translation with %s failed\n", table);
+      return 1;
+    }
+  wordlen = extParseChars (word, wordbuf);
+  if (!lou_hyphenate (table, wordbuf, wordlen, expectedHyphens, 0))
+    {
+      printf ("Hyphenation with %s failed\n", table);
+      return 1;
+    }
+  if (!lou_saveCompiledTable (table, imageFile))
+    {
+      printf ("Cannot save %s\n", table);
+      return 1;
+    }
+  lou_free ();
+
+  if (!(loaded = lou_loadCompiledTable (table, imageFile)))
+    {
+      printf ("Cannot load %s\n", imageFile);
+      result = 1;
+    }
+  else if (lou_getTable (table) != loaded)
+    {
+      printf ("lou_getTable does not return the loaded table\n");
+      result = 1;
+    }
+  else if (!translate (inbuf, inlen, outbuf, &outlen)
+	   || outlen != expectedlen
+	   || memcmp (outbuf, expected, outlen * sizeof (widechar)))
+    {
+      printf ("The loaded table translates differently\n");
+      result = 1;
+    }
+  else if (!lou_hyphenate (table, wordbuf, wordlen, hyphens, 0)
+	   || memcmp (hyphens, expectedHyphens, wordlen))
+    {
+      printf ("The loaded table hyphenates differently\n");
+      result = 1;
+    }
+  lou_free ();
+
+  if (!damageImage ())
+    {
+      printf ("Cannot change %s\n", imageFile);
+      result = 1;
+    }
+  else if (lou_loadCompiledTable (table, imageFile))
+    {
+      printf ("A damaged image was loaded\n");
+      result = 1;
+    }
+  lou_free ();
+
+  remove (imageFile);
+  return result;
+}
@@ -0,0 +1,176 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that an image next to a table, or in the compiled table path,
+   is used while the files it was made from are unchanged, and is no
+   longer used once a file included by the table has changed. A table
+   mapped from an image must also be reloaded by lou_reloadTables when
+   an include changes. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#if defined(_WIN32) || !defined(HAVE_UNISTD_H)
+
+int
+main (int argc, char **argv)
+{
+  /* Skip the test */
+  return 77;
+}
+
+#else
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <time.h>
+#include <utime.h>
+#include <dirent.h>
+
+static const char *dir = "compiledTableIncludesTables";
+static const char *catTable = "compiledTableIncludesTables/cat.ctb";
+static const char *imageFile = "compiledTableIncludesTables/cat.ctb.lbt";
+
+static int
+writeFile (const char *name, const char *contents, time_t modified)
+{
+  char path[256];
+  FILE *file;
+  struct utimbuf times;
+  sprintf (path, "%s/%s", dir, name);
+  if (!(file = fopen (path, "w")))
+    return 0;
+  fputs (contents, file);
+  fclose (file);
+  times.actime = times.modtime = modified;
+  return utime (path, &times) == 0;
+}
+
+static int
+translateDots (widechar * dots)
+{
+  widechar inbuf[] = { 'c', 'a', 't' };
+  int inlen = 3;
+  int outlen = 1;
+  if (!lou_translateString (catTable, inbuf, &inlen, dots, &outlen, NULL,
+			    NULL, dotsIO))
+    return 0;
+  return outlen == 1;
+}
+
+static void
+removeFiles ()
+{
+/* Remove the tables and all the images made of them */
+  DIR *d;
+  struct dirent *entry;
+  char path[256];
+  if ((d = opendir (dir)))
+    {
+      while ((entry = readdir (d)))
+	if (entry->d_name[0] != '.')
+	  {
+	    sprintf (path, "%s/%s", dir, entry->d_name);
+	    remove (path);
+	  }
+      closedir (d);
+    }
+  rmdir (dir);
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar dots;
+  time_t now = time (NULL);
+  int result = 0;
+
+  mkdir (dir, 0777);
+  if (!writeFile ("base.cti", "include chardefs.cti\nalways cat 14\n",
+		  now - 30)
+      || !writeFile ("cat.ctb", "include base.cti\n", now - 30))
+    {
+      printf ("Cannot write the tables in %s\n", dir);
+      removeFiles ();
+      return 1;
+    }
+  if (!lou_saveCompiledTable (catTable, imageFile))
+    {
+      printf ("Cannot save %s\n", catTable);
+      removeFiles ();
+      return 1;
+    }
+  lou_free ();
+
+  /* The include is changed but keeps its time, so the image, which
+     still has the old rule, is used. */
+  writeFile ("base.cti", "include chardefs.cti\nalways cat 1245\n",
+	     now - 30);
+  if (!translateDots (&dots) || dots != 0x8009)
+    {
+      printf ("The image of %s was not used\n", catTable);
+      result = 1;
+    }
+  lou_free ();
+
+  /* Now the include is newer than the image. The table mapped from it 
+     is reloaded, and the image is not used again. */
+  if (!translateDots (&dots))
+    {
+      printf ("Cannot map the image of %s\n", catTable);
+      result = 1;
+    }
+  writeFile ("base.cti", "include chardefs.cti\nalways cat 1245\n",
+	     now + 30);
+  if (lou_reloadTables () != 1 || !translateDots (&dots) || dots != 0x801b)
+    {
+      printf ("The table mapped from its image was not reloaded\n");
+      result = 1;
+    }
+  lou_free ();
+  if (!translateDots (&dots) || dots != 0x801b)
+    {
+      printf ("The image was used although an include changed\n");
+      result = 1;
+    }
+  lou_free ();
+  remove (imageFile);
+
+  /* The same for an image in the compiled table path */
+  if (!lou_setCompiledTablePath (dir))
+    {
+      printf ("Cannot set the compiled table path\n");
+      removeFiles ();
+      return 1;
+    }
+  writeFile ("base.cti", "include chardefs.cti\nalways cat 14\n", now - 30);
+  if (!translateDots (&dots) || dots != 0x8009)
+    {
+      printf ("Cannot translate with the shared image of %s\n", catTable);
+      result = 1;
+    }
+  lou_free ();
+  writeFile ("base.cti", "include chardefs.cti\nalways cat 1245\n",
+	     now + 30);
+  if (!translateDots (&dots) || dots != 0x801b)
+    {
+      printf ("The shared image was used although an include changed\n");
+      result = 1;
+    }
+  lou_free ();
+  lou_setCompiledTablePath (NULL);
+  removeFiles ();
+  return result;
+}
+
+#endif
@@ -0,0 +1,158 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that several threads asking for the same table at once all
+   get the same compiled table, and that translating with one context
+   per thread gives the same results as translating in a single
+   thread. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#ifndef HAVE_PTHREAD_H
+
+int
+main (int argc, char **argv)
+{
+  /* Skip the test */
+  return 77;
+}
+
+#else
+
+#include <pthread.h>
+
+#define NUMTHREADS 8
+#define ITERATIONS 200
+#define BUFSIZE 256
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "en-us-g1.ctb",
+};
+
+static const char *text = "the quick brown fox jumps over the lazy dog";
+
+static widechar inbuf[BUFSIZE];
+static int inlen;
+static widechar expected[2][BUFSIZE];
+static int expectedlen[2];
+
+typedef struct
+{
+  int number;
+  void *table;
+  int failed;
+} ThreadInfo;
+
+static void *
+loadTable (void *arg)
+{
+  ThreadInfo *info = arg;
+  info->table = lou_getTable (tables[info->number % 2]);
+  return NULL;
+}
+
+static void *
+translate (void *arg)
+{
+  ThreadInfo *info = arg;
+  const char *tableList = tables[info->number % 2];
+  louContext *ctx = lou_createContext ();
+  widechar outbuf[BUFSIZE];
+  int k, outlen, i;
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      k = inlen;
+      outlen = BUFSIZE;
+      if (!lou_translateCtx (ctx, tableList, inbuf, &k, outbuf, &outlen,
+			     NULL, NULL, NULL, NULL, NULL, 0)
+	  || outlen != expectedlen[info->number % 2]
+	  || memcmp (outbuf, expected[info->number % 2],
+		     outlen * sizeof (widechar)))
+	{
+	  info->failed = 1;
+	  break;
+	}
+    }
+  lou_freeContext (ctx);
+  return NULL;
+}
+
+static int
+runThreads (void *(*function) (void *), ThreadInfo *info)
+{
+  pthread_t threads[NUMTHREADS];
+  int i;
+  for (i = 0; i < NUMTHREADS; i++)
+    {
+      info[i].number = i;
+      info[i].failed = 0;
+      if (pthread_create (&threads[i], NULL, function, &info[i]))
+	{
+	  printf ("Cannot create thread\n");
+	  return 0;
+	}
+    }
+  for (i = 0; i < NUMTHREADS; i++)
+    pthread_join (threads[i], NULL);
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  ThreadInfo info[NUMTHREADS];
+  int result = 0;
+  int i, k;
+
+  inlen = extParseChars (text, inbuf);
+
+  /* No table is loaded yet, so all the threads miss the cache at
+     about the same time. */
+  if (!runThreads (loadTable, info))
+    return 1;
+  for (i = 0; i < NUMTHREADS; i++)
+    if (info[i].table == NULL || info[i].table != info[i % 2].table)
+      {
+	printf ("Thread %d got a different table for %s\n", i,
+		tables[i % 2]);
+	result = 1;
+      }
+
+  for (i = 0; i < 2; i++)
+    {
+      k = inlen;
+      expectedlen[i] = BUFSIZE;
+      if (!lou_translate (tables[i], inbuf, &k, expected[i], &expectedlen[i],
+			  NULL, NULL, NULL, NULL, NULL, 0))
+	{
+	  printf ("Translation with %s failed\n", tables[i]);
+	  return 1;
+	}
+    }
+  if (!runThreads (translate, info))
+    return 1;
+  for (i = 0; i < NUMTHREADS; i++)
+    if (info[i].failed)
+      {
+	printf ("Thread %d got a wrong translation with %s\n", i,
+		tables[i % 2]);
+	result = 1;
+      }
+
+  lou_free ();
+  return result;
+}
+
+#endif
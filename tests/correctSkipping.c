@@ -0,0 +1,128 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that skipping the characters at which no correct rule can begin
+   to match changes neither the translation nor the back-translation of
+   a text, nor their positions. */
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+#define BUFSIZE 512
+
+static const char *tables[] = {
+  "da-dk-g26.ctb",
+  "en-us-mathtext.ctb",
+  "marburg.ctb",
+  "eo-g1-x-system.ctb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static const char *texts[] = {
+  "the Cornfield ( by the river ) was , as they said ... worn - out",
+  "\\x201eHun sagde\\x201c: \\x2018det\\x2019s \\x00a0fint\\x0097 "
+    "cx gx hx jx sx ux",
+  "x\\x00ady -\"so\" he said ?",
+};
+
+#define NUMTEXTS (sizeof (texts) / sizeof (texts[0]))
+
+typedef struct
+{
+  widechar outbuf[BUFSIZE];
+  int outlen;
+  int inputPos[BUFSIZE];
+  int outputPos[BUFSIZE];
+} Result;
+
+static int
+translate (const char *table, const widechar *inbuf, int inlen,
+	   Result *result, int backward)
+{
+  result->outlen = BUFSIZE;
+  if (backward)
+    return lou_backTranslate (table, inbuf, &inlen, result->outbuf,
+			      &result->outlen, NULL, NULL, result->outputPos,
+			      result->inputPos, NULL, 0);
+  return lou_translate (table, inbuf, &inlen, result->outbuf,
+			&result->outlen, NULL, NULL, result->outputPos,
+			result->inputPos, NULL, 0);
+}
+
+static int
+sameResult (const Result *a, const Result *b, int inlen)
+{
+  return a->outlen == b->outlen
+    && !memcmp (a->outbuf, b->outbuf, a->outlen * sizeof (widechar))
+    && !memcmp (a->inputPos, b->inputPos, a->outlen * sizeof (int))
+    && !memcmp (a->outputPos, b->outputPos, inlen * sizeof (int));
+}
+
+int
+main (int argc, char **argv)
+{
+  static Result expected[NUMTEXTS][2], received;
+  static widechar inbuf[NUMTEXTS][BUFSIZE];
+  static widechar cells[NUMTEXTS][BUFSIZE];
+  int inlen[NUMTEXTS], cellslen[NUMTEXTS];
+  TranslationTableHeader *table;
+  int result = 0;
+  int i, j, k;
+
+#if OFFSETBITS == 16
+  /* da-dk-g26 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  for (j = 0; j < NUMTEXTS; j++)
+    inlen[j] = extParseChars (texts[j], inbuf[j]);
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      if (!(table = lou_getTable (tables[i])))
+	{
+	  printf ("Cannot compile %s\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      if (!table->corrections || table->passStarts[0].anywhere)
+	{
+	  printf ("%s has no correct rule that can be skipped\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      for (j = 0; j < NUMTEXTS; j++)
+	{
+	  translate (tables[i], inbuf[j], inlen[j], &expected[j][0], 0);
+	  cellslen[j] = expected[j][0].outlen;
+	  memcpy (cells[j], expected[j][0].outbuf,
+		  cellslen[j] * sizeof (widechar));
+	  translate (tables[i], cells[j], cellslen[j], &expected[j][1], 1);
+	}
+      table->passStarts[0].anywhere = 1;
+      for (j = 0; j < NUMTEXTS; j++)
+	for (k = 0; k < 2; k++)
+	  {
+	    if (!k)
+	      translate (tables[i], inbuf[j], inlen[j], &received, 0);
+	    else
+	      translate (tables[i], cells[j], cellslen[j], &received, 1);
+	    if (!sameResult (&expected[j][k], &received,
+			     k ? cellslen[j] : inlen[j]))
+	      {
+		printf ("%s %s \"%s\" differently when no character is "
+			"skipped\n", tables[i],
+			k ? "back-translates" : "translates", texts[j]);
+		result = 1;
+	      }
+	  }
+    }
+
+  lou_free ();
+  return result;
+}
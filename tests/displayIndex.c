@@ -0,0 +1,115 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that lou_charToDots and lou_dotsToChar, which look characters
+   and cells up in an index, give what the charToDots and dotsToChar
+   chains of the table give, also for Unicode braille, and also after a
+   display rule is added with lou_compileString. */
+
+#include <stdio.h>
+#include <string.h>
+#include "liblouis.h"
+#include "louis.h"
+
+#define NUMCHARS 0x10000
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "de-de-g2.ctb",
+  "text_nabcc.dis",
+  "zh-tw.ctb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static widechar inbuf[NUMCHARS];
+static widechar outbuf[NUMCHARS];
+static widechar expected[NUMCHARS];
+
+static int
+checkTable (const char *tableList)
+{
+  TranslationTableHeader *table = lou_getTable (tableList);
+  TranslationTableOffset charToDotsIndex, dotsToCharIndex;
+  int k;
+  if (table == NULL)
+    {
+      printf ("Cannot compile %s\n", tableList);
+      return 1;
+    }
+  for (k = 0; k < NUMCHARS; k++)
+    inbuf[k] = k;
+  /* Without the indexes the chains are walked */
+  charToDotsIndex = table->charToDotsIndex;
+  dotsToCharIndex = table->dotsToCharIndex;
+  if (!charToDotsIndex || !dotsToCharIndex)
+    {
+      printf ("%s has no index of its display rules\n", tableList);
+      return 1;
+    }
+  table->charToDotsIndex = table->dotsToCharIndex = 0;
+  for (k = 0; k < NUMCHARS; k++)
+    expected[k] = getDotsForCharInTable (table, k);
+  table->charToDotsIndex = charToDotsIndex;
+  table->dotsToCharIndex = dotsToCharIndex;
+  lou_charToDots (tableList, inbuf, outbuf, NUMCHARS, 0);
+  if (memcmp (outbuf, expected, sizeof (outbuf)))
+    {
+      printf ("%s: lou_charToDots differs from the chains\n", tableList);
+      return 1;
+    }
+  table->charToDotsIndex = table->dotsToCharIndex = 0;
+  for (k = 0; k < NUMCHARS; k++)
+    expected[k] = getCharFromDotsInTable (table, k >= 0x2800 && k < 0x2900 ?
+					  B16 | (k & 0xff) : k);
+  table->charToDotsIndex = charToDotsIndex;
+  table->dotsToCharIndex = dotsToCharIndex;
+  lou_dotsToChar (tableList, inbuf, outbuf, NUMCHARS, 0);
+  if (memcmp (outbuf, expected, sizeof (outbuf)))
+    {
+      printf ("%s: lou_dotsToChar differs from the chains\n", tableList);
+      return 1;
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar c = 0x263a;
+  widechar dots;
+  int i;
+  int result = 0;
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  for (i = 0; i < NUMTABLES; i++)
+    result |= checkTable (tables[i]);
+
+  if (!lou_compileString (tables[0], "display \\x263a 12345678"))
+    {
+      printf ("Cannot add a display rule to %s\n", tables[0]);
+      result = 1;
+    }
+  else
+    {
+      result |= checkTable (tables[0]);
+      lou_charToDots (tables[0], &c, &dots, 1, 0);
+      if (dots != (B1 | B2 | B3 | B4 | B5 | B6 | B7 | B8 | B16))
+	{
+	  printf ("A display rule added with lou_compileString is not "
+		  "used\n");
+	  result = 1;
+	}
+    }
+
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,79 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that a compiled table is trimmed to the size it uses, and that
+   a rule which repeats an earlier one takes no space but leaves the
+   translation unchanged. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+static const char *tableList = "en-us-g1.ctb";
+
+static int
+translateDots (widechar * dots, int *outlen)
+{
+  widechar inbuf[] = { 'x', 'y', 'z', 'q' };
+  int inlen = 4;
+  *outlen = 8;
+  return lou_translateString (tableList, inbuf, &inlen, dots, outlen, NULL,
+			      NULL, dotsIO);
+}
+
+int
+main (int argc, char **argv)
+{
+  TranslationTableHeader *table;
+  widechar expected[8];
+  widechar dots[8];
+  int expectedLength;
+  int length;
+  int bytesUsed;
+  int result = 0;
+
+  if (!(table = lou_getTable (tableList)))
+    {
+      printf ("Cannot compile %s\n", tableList);
+      return 1;
+    }
+  if (table->tableSize != table->bytesUsed)
+    {
+      printf ("The table takes %d bytes but uses %d\n", table->tableSize,
+	      table->bytesUsed);
+      result = 1;
+    }
+  if (!lou_compileString (tableList, "always xyzq 123")
+      || !translateDots (expected, &expectedLength))
+    {
+      printf ("Cannot add a rule to %s\n", tableList);
+      return 1;
+    }
+  table = lou_getTable (tableList);
+  bytesUsed = table->bytesUsed;
+  if (!lou_compileString (tableList, "always xyzq 123"))
+    {
+      printf ("Cannot add the same rule again\n");
+      result = 1;
+    }
+  table = lou_getTable (tableList);
+  if (table->bytesUsed != bytesUsed)
+    {
+      printf ("The repeated rule took %d bytes\n",
+	      table->bytesUsed - bytesUsed);
+      result = 1;
+    }
+  if (!translateDots (dots, &length) || length != expectedLength
+      || memcmp (dots, expected, length * sizeof (widechar)))
+    {
+      printf ("The repeated rule changed the translation\n");
+      result = 1;
+    }
+  lou_free ();
+  return result;
+}
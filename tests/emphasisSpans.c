@@ -0,0 +1,159 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that lou_translateWithSpans gives the same output, positions
+   and cursor as lou_translateWithTable with a typeform having the
+   emphasis of the spans, also for spans out of order, overlapping or
+   past the end of the input, and that it refuses negative spans. */
+
+#include <stdio.h>
+#include <string.h>
+#include "liblouis.h"
+#include "louis.h"
+
+#define BUFSIZE 512
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "de-de-g2.ctb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static const char *text =
+  "The quick brown fox jumps over the lazy dog, and then 123 more times.";
+
+static const louEmphasisSpan none[] = {
+  {0, 0, 0},
+};
+
+static const louEmphasisSpan words[] = {
+  {4, 5, italic},
+  {10, 15, bold},
+  {35, 4, underline},
+};
+
+static const louEmphasisSpan overlapping[] = {
+  {40, 30, bold},
+  {0, 20, italic},
+  {16, 10, bold},
+  {54, 3, computer_braille},
+};
+
+static const louEmphasisSpan pastTheEnd[] = {
+  {60, 100, italic},
+  {200, 4, bold},
+  {8, 0, bold},
+  {0, 3, plain_text},
+  {3, 1, 0xf0 | italic},
+};
+
+typedef struct
+{
+  const char *name;
+  const louEmphasisSpan *spans;
+  int numSpans;
+} SpanSet;
+
+#define SPANSET(spans) { #spans, spans, sizeof (spans) / sizeof (spans[0]) }
+
+static const SpanSet spanSets[] = {
+  {"no spans", NULL, 0},
+  SPANSET (none),
+  SPANSET (words),
+  SPANSET (overlapping),
+  SPANSET (pastTheEnd),
+};
+
+#define NUMSPANSETS (sizeof (spanSets) / sizeof (spanSets[0]))
+
+static int
+check (const louTable *table, const char *name, const widechar *inbuf,
+       int inlen, const SpanSet *set)
+{
+  formtype typeform[BUFSIZE];
+  widechar expected[BUFSIZE], outbuf[BUFSIZE];
+  int expectedOutputPos[BUFSIZE], expectedInputPos[BUFSIZE];
+  int outputPos[BUFSIZE], inputPos[BUFSIZE];
+  int expectedlen = BUFSIZE, outlen = BUFSIZE;
+  int length = inlen, expectedLength = inlen;
+  int expectedCursor = inlen / 3, cursor = inlen / 3;
+  int k, j;
+  memset (typeform, 0, sizeof (typeform));
+  for (k = 0; k < set->numSpans; k++)
+    for (j = set->spans[k].start;
+	 j < set->spans[k].start + set->spans[k].length && j < inlen; j++)
+      typeform[j] |= set->spans[k].emphasis;
+  if (!lou_translateWithTable (table, NULL, inbuf, &expectedLength,
+			       expected, &expectedlen, typeform, NULL,
+			       expectedOutputPos, expectedInputPos,
+			       &expectedCursor, 0))
+    {
+      printf ("%s: no translation with a typeform for %s\n", name,
+	      set->name);
+      return 1;
+    }
+  if (!lou_translateWithSpans (table, NULL, inbuf, &length, outbuf, &outlen,
+			       set->spans, set->numSpans, outputPos, inputPos,
+			       &cursor, 0))
+    {
+      printf ("%s: no translation with %s\n", name, set->name);
+      return 1;
+    }
+  if (length != expectedLength || outlen != expectedlen
+      || memcmp (outbuf, expected, outlen * sizeof (widechar))
+      || memcmp (inputPos, expectedInputPos, outlen * sizeof (int))
+      || memcmp (outputPos, expectedOutputPos, length * sizeof (int))
+      || cursor != expectedCursor)
+    {
+      printf ("%s: the translation with %s differs\n", name, set->name);
+      return 1;
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  static const louEmphasisSpan negative[] = {
+    {2, 3, italic},
+    {-1, 3, bold},
+  };
+  widechar inbuf[BUFSIZE], outbuf[BUFSIZE];
+  const louTable *table;
+  int inlen, outlen;
+  int result = 0;
+  int i, j;
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      if (!(table = lou_openTable (tables[i])))
+	{
+	  printf ("%s could not be opened\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      inlen = extParseChars (text, inbuf);
+      for (j = 0; j < NUMSPANSETS; j++)
+	result |= check (table, tables[i], inbuf, inlen, &spanSets[j]);
+      outlen = BUFSIZE;
+      if (lou_translateWithSpans (table, NULL, inbuf, &inlen, outbuf,
+				  &outlen, negative, 2, NULL, NULL, NULL, 0))
+	{
+	  printf ("%s: a negative span is taken\n", tables[i]);
+	  result = 1;
+	}
+    }
+
+  lou_free ();
+  return result;
+}
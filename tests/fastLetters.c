@@ -0,0 +1,148 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that letters and digits copied without selecting a rule
+   translate the same, with the same input and output positions, as
+   those whose rule is selected, in plain text and in runs of emphasis,
+   and that a rule added with lou_compileString stops them from being
+   copied. */
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+#define BUFSIZE 512
+
+static const char *tables[] = {
+  "en-us-g1.ctb",
+  "UEBC-g1.utb",
+  "it-it-comp6.utb",
+  "de-de-g0.utb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static const char *text = "the quick brown fox jumps over the lazy dog, "
+  "Quickly; BROWN fox's 29th jump: hyphen-ated xyzzy words. Lazy. "
+  "1,234,567.89 up 12.5% from 98765; 2024-10-14 x42y.";
+
+typedef struct
+{
+  widechar outbuf[BUFSIZE];
+  int outlen;
+  int inputPos[BUFSIZE];
+  int outputPos[BUFSIZE];
+  int cursorPos;
+} Result;
+
+/* Italic over "jumps over the lazy", bold over "jump" and underline
+   over "words", and emphasis changing inside "brown", "Quickly" and
+   "xyzzy" */
+static const char *emphasis = "           22       1111111111111111111      "
+  "  111                     4444                44  22222";
+
+static int
+translate (const char *table, const widechar *inbuf, int inlen,
+	   Result *result, int mode, int emphasized)
+{
+  formtype typeform[BUFSIZE];
+  int k;
+  for (k = 0; k < inlen; k++)
+    typeform[k] = k < strlen (emphasis) && emphasis[k] != ' ' ?
+      emphasis[k] - '0' : plain_text;
+  result->outlen = BUFSIZE;
+  result->cursorPos = 12;
+  return lou_translate (table, inbuf, &inlen, result->outbuf,
+			&result->outlen, emphasized ? typeform : NULL, NULL,
+			result->outputPos, result->inputPos,
+			&result->cursorPos, mode);
+}
+
+static int
+sameResult (const Result *a, const Result *b, int inlen)
+{
+  return a->outlen == b->outlen && a->cursorPos == b->cursorPos
+    && !memcmp (a->outbuf, b->outbuf, a->outlen * sizeof (widechar))
+    && !memcmp (a->inputPos, b->inputPos, a->outlen * sizeof (int))
+    && !memcmp (a->outputPos, b->outputPos, inlen * sizeof (int));
+}
+
+static int
+unmarkLetters (TranslationTableHeader *table)
+{
+  TranslationTableCharacter *character;
+  TranslationTableOffset bucket;
+  int k, marked = 0;
+  for (k = 0; k < HASHNUM; k++)
+    for (bucket = table->characters[k]; bucket; bucket = character->next)
+      {
+	character = (TranslationTableCharacter *) & table->ruleArea[bucket];
+	if (character->fastDots)
+	  marked++;
+	character->fastDots = 0;
+      }
+  return marked;
+}
+
+int
+main (int argc, char **argv)
+{
+  static const int modes[] = { 0, noContractions, compbrlAtCursor, 0 };
+  static Result expected[4], received;
+  widechar inbuf[BUFSIZE];
+  int inlen, outlen;
+  TranslationTableHeader *table;
+  int result = 0;
+  int i, m;
+
+  inlen = extParseChars (text, inbuf);
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      if (!(table = lou_getTable (tables[i])))
+	{
+	  printf ("Cannot compile %s\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      for (m = 0; m < 4; m++)
+	translate (tables[i], inbuf, inlen, &expected[m], modes[m], m == 3);
+      if (!unmarkLetters (table))
+	{
+	  printf ("%s has no letters to copy\n", tables[i]);
+	  result = 1;
+	}
+      for (m = 0; m < 4; m++)
+	{
+	  translate (tables[i], inbuf, inlen, &received, modes[m], m == 3);
+	  if (!sameResult (&expected[m], &received, inlen))
+	    {
+	      printf ("%s translates differently in mode %d%s when letters "
+		      "are not copied\n", tables[i], modes[m],
+		      m == 3 ? " with emphasis" : "");
+	      result = 1;
+	    }
+	}
+    }
+  lou_free ();
+
+  inlen = extParseChars ("xab", inbuf);
+  outlen = BUFSIZE;
+  if (!lou_compileString (tables[0], "always ab 1234"))
+    {
+      printf ("Cannot add a rule to %s\n", tables[0]);
+      result = 1;
+    }
+  else if (!lou_translateString (tables[0], inbuf, &inlen, received.outbuf,
+				 &outlen, NULL, NULL, 0) || outlen != 2)
+    {
+      printf ("A rule added with lou_compileString is not used\n");
+      result = 1;
+    }
+
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,170 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that lou_indexTablesCached takes the metadata of tables that
+   have not changed from its cache file, reads the tables that have
+   changed again, and that lou_findTable gives the same matches as
+   before the index was inverted. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "liblouis.h"
+#include "louis.h"
+
+#if defined(_WIN32) || !defined(HAVE_UNISTD_H)
+
+int
+main (int argc, char **argv)
+{
+  /* Skip the test */
+  return 77;
+}
+
+#else
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char *dir = "findTableCacheTables";
+static const char *cacheFile = "findTableCacheTables/index";
+
+static void
+writeFile (const char *name, const char *text)
+{
+  char path[256];
+  FILE *file;
+  sprintf (path, "%s/%s", dir, name);
+  if ((file = fopen (path, "w")))
+    {
+      fputs (text, file);
+      fclose (file);
+    }
+}
+
+static void
+removeFiles ()
+{
+  const char *names[] = { "a", "b", "c", "d", "e", "index", "index.tmp",
+    NULL
+  };
+  char path[256];
+  int k;
+  for (k = 0; names[k]; k++)
+    {
+      sprintf (path, "%s/%s", dir, names[k]);
+      remove (path);
+    }
+  rmdir (dir);
+}
+
+static int
+finds (const char *query, const char *expected)
+{
+  char *match = lou_findTable (query);
+  char path[256];
+  int same;
+  if (expected)
+    sprintf (path, "%s/%s", dir, expected);
+  same = expected ? match && !strcmp (match, path) : match == NULL;
+  if (!same)
+    printf ("%s finds %s instead of %s\n", query, match ? match : "nothing",
+	    expected ? path : "nothing");
+  free (match);
+  return same;
+}
+
+/* Replace the first occurrence of a string in the cache file */
+static int
+editCache (const char *old, const char *new)
+{
+  static char text[4096];
+  char *found;
+  FILE *file;
+  int length;
+  if (!(file = fopen (cacheFile, "r")))
+    return 0;
+  length = fread (text, 1, sizeof (text) - 1, file);
+  fclose (file);
+  text[length] = 0;
+  if (!(found = strstr (text, old)))
+    return 0;
+  memcpy (found, new, strlen (new));
+  if (!(file = fopen (cacheFile, "w")))
+    return 0;
+  fputs (text, file);
+  fclose (file);
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *tables[] = { "findTableCacheTables/a", "findTableCacheTables/b",
+    "findTableCacheTables/c", "findTableCacheTables/d",
+    "findTableCacheTables/e", NULL
+  };
+  int result = 0;
+
+  removeFiles ();
+  if (mkdir (dir, 0777))
+    {
+      printf ("%s could not be made\n", dir);
+      return 1;
+    }
+  writeFile ("a", "#+id: a\n#+language:en\n");
+  writeFile ("b", "#+id: b\n#+type: contracted\n");
+  writeFile ("c", "# No metadata\n");
+  writeFile ("d", "#+language:en\n");
+  writeFile ("e", "#+language:en\n");
+
+  lou_indexTablesCached (tables, cacheFile);
+  if (!finds ("id:a", "a") || !finds ("id:b type:contracted", "b")
+      || !finds ("id:c", NULL))
+    result = 1;
+  /* Of tables matching as well the last one indexed is found */
+  if (!finds ("language:en", "e"))
+    result = 1;
+
+  /* The metadata of tables that have not changed is taken from the cache */
+  if (!editCache ("id\ta", "id\tz"))
+    {
+      printf ("The cache has no feature id:a\n");
+      result = 1;
+    }
+  lou_indexTablesCached (tables, cacheFile);
+  if (!finds ("id:z", "a") || !finds ("id:a", NULL) || !finds ("id:b", "b"))
+    result = 1;
+
+  /* A table that has changed is read again */
+  writeFile ("a", "#+id: changed\n");
+  lou_indexTablesCached (tables, cacheFile);
+  if (!finds ("id:changed", "a") || !finds ("id:z", NULL)
+      || !finds ("id:b", "b"))
+    result = 1;
+
+  /* An invalid cache is not used */
+  writeFile ("index", "not an index\n");
+  lou_indexTablesCached (tables, cacheFile);
+  if (!finds ("id:changed", "a") || !finds ("language:en", "e"))
+    result = 1;
+
+  /* The same without a cache */
+  lou_indexTables (tables);
+  if (!finds ("id:changed", "a") || !finds ("language:en", "e"))
+    result = 1;
+
+  lou_free ();
+  removeFiles ();
+  return result;
+}
+
+#endif
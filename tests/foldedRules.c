@@ -0,0 +1,108 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that the rules in the forRules chains, which are compared with
+   the input through the lowercase copy of their characters the table
+   keeps, match the same whether they are found through the trie or by
+   walking the chains, and that a rule added with lou_compileString
+   matches without regard to case. */
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+#define BUFSIZE 512
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "de-de-g2.ctb",
+  "fr-bfu-comp6.utb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static const char *texts[] = {
+  "The QUICK Brown fox JUMPS over the Lazy Dog's BACK",
+  "Sch\\x00d6NE Gr\\x00fc\\x00dfe aus der STRASSE, Ihr \\x00c4rger",
+  "\\x00c9t\\x00c9 \\x00e0 l'\\x00c9COLE, o\\x00f9 \\x0152uvre",
+};
+
+#define NUMTEXTS (sizeof (texts) / sizeof (texts[0]))
+
+static int
+translate (const char *table, const char *text, widechar * outbuf)
+{
+  widechar inbuf[BUFSIZE];
+  int inlen = extParseChars (text, inbuf);
+  int outlen = BUFSIZE;
+  if (!lou_translateString (table, inbuf, &inlen, outbuf, &outlen, NULL,
+			    NULL, 0))
+    return -1;
+  return outlen;
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar outbuf[BUFSIZE];
+  widechar expected[NUMTEXTS][BUFSIZE];
+  int expectedlen[NUMTEXTS];
+  TranslationTableHeader *table;
+  TranslationTableOffset forRuleTrie;
+  int result = 0;
+  int i, j, outlen;
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      if (!(table = lou_getTable (tables[i])) || !table->forRuleTrie)
+	{
+	  printf ("%s has no trie of its forward rules\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      for (j = 0; j < NUMTEXTS; j++)
+	expectedlen[j] = translate (tables[i], texts[j], expected[j]);
+      forRuleTrie = table->forRuleTrie;
+      table->forRuleTrie = 0;
+      for (j = 0; j < NUMTEXTS; j++)
+	{
+	  outlen = translate (tables[i], texts[j], outbuf);
+	  if (outlen != expectedlen[j]
+	      || memcmp (outbuf, expected[j], outlen * sizeof (widechar)))
+	    {
+	      printf ("%s translates \"%s\" differently without the trie\n",
+		      tables[i], texts[j]);
+	      result = 1;
+	    }
+	}
+      table->forRuleTrie = forRuleTrie;
+    }
+
+  if (!lou_compileString (tables[0], "always qxJ 1234"))
+    {
+      printf ("Cannot add a rule to %s\n", tables[0]);
+      result = 1;
+    }
+  else
+    {
+      outlen = translate (tables[0], "qxj", outbuf);
+      if (outlen != 1 || outbuf[0] != 'p')
+	{
+	  printf ("A rule added with lou_compileString does not match "
+		  "without regard to case\n");
+	  result = 1;
+	}
+    }
+
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,102 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that the forward rules of a finished table are spread over
+   chains sized for it, that each rule is in the chain of the
+   characters it begins with, and that few pairs of characters share a
+   chain, also for scripts other than Latin and after a rule is added
+   with lou_compileString. */
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+#define MAXPAIRS 16
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "zh-tw.ctb",
+  "ko-g2.ctb",
+  "hi-in-g1.utb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static int
+checkTable (const char *tableList)
+{
+  TranslationTableHeader *table = lou_getTable (tableList);
+  const TranslationTableOffset *chains;
+  const TranslationTableRule *rule;
+  TranslationTableOffset offset;
+  widechar pairs[MAXPAIRS][2];
+  int numPairs, bucket, k;
+  if (!table || !table->forRuleBuckets)
+    {
+      printf ("%s has no chains of forward rules sized for it\n", tableList);
+      return 1;
+    }
+  chains = &table->ruleArea[table->forRuleBuckets];
+  for (bucket = 0; bucket < 1 << table->forRuleHashBits; bucket++)
+    {
+      numPairs = 0;
+      for (offset = chains[bucket]; offset; offset = rule->charsnext)
+	{
+	  rule = (TranslationTableRule *) & table->ruleArea[offset];
+	  if (rule->charslen < 2)
+	    continue;
+	  if (findForRules (table, rule->charsdots[0], rule->charsdots[1])
+	      != chains[bucket])
+	    {
+	      printf ("%s: a rule is not in the chain of its characters\n",
+		      tableList);
+	      return 1;
+	    }
+	  for (k = 0; k < numPairs; k++)
+	    if (pairs[k][0] == rule->charsdots[0]
+		&& pairs[k][1] == rule->charsdots[1])
+	      break;
+	  if (k < numPairs)
+	    continue;
+	  if (numPairs == MAXPAIRS)
+	    {
+	      printf ("%s: more than %d pairs of characters share a chain\n",
+		      tableList, MAXPAIRS);
+	      return 1;
+	    }
+	  pairs[numPairs][0] = rule->charsdots[0];
+	  pairs[numPairs++][1] = rule->charsdots[1];
+	}
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  int result = 0;
+  int i;
+
+#if OFFSETBITS == 16
+  /* ko-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  for (i = 0; i < NUMTABLES; i++)
+    result |= checkTable (tables[i]);
+
+  if (!lou_compileString (tables[0], "always qxj 1234"))
+    {
+      printf ("Cannot add a rule to %s\n", tables[0]);
+      result = 1;
+    }
+  else
+    result |= checkTable (tables[0]);
+
+  lou_free ();
+  return result;
+}
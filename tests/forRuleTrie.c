@@ -0,0 +1,94 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that rules found through the trie of forward rules translate
+   the same as rules found by walking the hash chains, and that a rule
+   added with lou_compileString is not left out. */
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+#define BUFSIZE 512
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "de-de-g2.ctb",
+  "fr-bfu-g2.ctb",
+  "da-dk-g28.ctb",
+  "nl-NL-g1.ctb",
+};
+
+static const char *text = "The Quick BROWN fox, THE quick brown fox's "
+  "29 Jumps: overtaking Knowledge. Mit Freundlichen Gruessen, "
+  "l'Eleve a REFLECHI; Det Er Ikke Saerlig Svaert.";
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static int
+translate (const char *table, const widechar *inbuf, int inlen,
+	   widechar *outbuf, int *outlen)
+{
+  *outlen = BUFSIZE;
+  return lou_translateString (table, inbuf, &inlen, outbuf, outlen, NULL,
+			      NULL, 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar inbuf[BUFSIZE];
+  widechar expected[BUFSIZE];
+  widechar outbuf[BUFSIZE];
+  int inlen, expectedlen, outlen;
+  TranslationTableHeader *table;
+  int result = 0;
+  int i;
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  inlen = extParseChars (text, inbuf);
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      if (!(table = lou_getTable (tables[i])) || !table->forRuleTrie)
+	{
+	  printf ("%s has no trie of forward rules\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      translate (tables[i], inbuf, inlen, expected, &expectedlen);
+      table->forRuleTrie = 0;
+      translate (tables[i], inbuf, inlen, outbuf, &outlen);
+      if (outlen != expectedlen
+	  || memcmp (outbuf, expected, outlen * sizeof (widechar)))
+	{
+	  printf ("%s translates differently without the trie\n",
+		  tables[i]);
+	  result = 1;
+	}
+    }
+  lou_free ();
+
+  inlen = extParseChars ("quux", inbuf);
+  if (!lou_compileString (tables[0], "always quux 1234"))
+    {
+      printf ("Cannot add a rule to %s\n", tables[0]);
+      result = 1;
+    }
+  else if (!translate (tables[0], inbuf, inlen, outbuf, &outlen)
+	   || outlen != 1)
+    {
+      printf ("A rule added with lou_compileString is not used\n");
+      result = 1;
+    }
+
+  lou_free ();
+  return result;
+}
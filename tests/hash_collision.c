@@ -18,6 +18,11 @@ main (int argc, char **argv)
   char *table = "empty.ctb";
   char rule[18];
 
+#if OFFSETBITS == 16
+  /* 17576 rules do not fit in 16-bit offsets */
+  return 77;
+#endif
+
   lou_compileString(table, "include latinLetterDef6Dots.uti");
 
   for (char c1 = 'a'; c1 <= 'z'; c1++) {
@@ -0,0 +1,103 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that hyphenating a whole text at once puts the hyphens where
+   hyphenating each of its words alone does, also in a text too long to
+   be laid out on the stack, and that a table without patterns is
+   refused. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "liblouis.h"
+#include "louis.h"
+
+#define BUFSIZE 8192
+
+static const char *tables[] = {
+  "da-dk-g26.ctb",
+  "en-us-g2.ctb,hyph_en_US.dic",
+  "de-de-g0.utb,hyph_de_DE.dic",
+  "cs-g1.ctb,hyph_cs_CZ.dic",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static const char *text =
+  "Alderen og achena, (hyphenation) \"supercalifragilistic\" words: "
+  "Donaudampfschifffahrt xxx--mechanically I a; Translation-tables "
+  "internationalization.";
+
+static int
+checkText (const char *table, const widechar * inbuf, int inlen)
+{
+  static char expected[BUFSIZE + 1];
+  static char received[BUFSIZE + 1];
+  int k, wordStart;
+  memset (expected, '0', inlen);
+  expected[inlen] = 0;
+  for (k = 0; k < inlen; k = wordStart)
+    {
+      for (wordStart = k; wordStart < inlen
+	   && inbuf[wordStart] != ' ' && inbuf[wordStart] != '-'; wordStart++);
+      if (wordStart > k
+	  && !lou_hyphenate (table, &inbuf[k], wordStart - k, &expected[k],
+			     0))
+	memset (&expected[k], '0', wordStart - k);
+      expected[wordStart] = '0';
+      wordStart++;
+    }
+  expected[inlen] = 0;
+  if (!lou_hyphenateText (table, inbuf, inlen, received))
+    {
+      printf ("%s cannot hyphenate %d characters\n", table, inlen);
+      return 1;
+    }
+  if (strcmp (expected, received))
+    {
+      printf ("%s hyphenates %d characters differently\n%s\n%s\n", table,
+	      inlen, expected, received);
+      return 1;
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar inbuf[BUFSIZE];
+  char hyphens[BUFSIZE + 1];
+  int inlen, k;
+  int result = 0;
+  int i;
+
+#if OFFSETBITS == 16
+  /* da-dk-g26 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  inlen = extParseChars (text, inbuf);
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      result |= checkText (tables[i], inbuf, inlen);
+      for (k = inlen; k + inlen + 1 <= BUFSIZE; k += inlen + 1)
+	{
+	  inbuf[k] = ' ';
+	  memcpy (&inbuf[k + 1], inbuf, inlen * sizeof (widechar));
+	}
+      result |= checkText (tables[i], inbuf, k);
+    }
+
+  if (lou_hyphenateText ("en-us-g1.ctb", inbuf, inlen, hyphens))
+    {
+      printf ("en-us-g1.ctb hyphenates without patterns\n");
+      result = 1;
+    }
+
+  lou_free ();
+  return result;
+}
@@ -11,6 +11,11 @@ int main(int argc, char **argv)
   char *word = "achena";
   char * hyphens = calloc(8, sizeof(char));
 
+#if OFFSETBITS == 16
+  /* da-dk-g26 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
   hyphens[0] = '0';
   hyphens[1] = '1';
   hyphens[2] = '0';
@@ -0,0 +1,38 @@
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include "liblouis.h"
+#include "brl_checks.h"
+
+/* The Hungarian patterns make more than 65535 states, whose numbers
+ * used not to fit in a transition, and hyphenating words with an
+ * accented letter then never ended. The alarm turns such a hang into
+ * a failure. */
+int main(int argc, char **argv)
+{
+  int ret = 0;
+  char *tables = "hu-hu-g1.ctb,hyph_hu_HU.dic";
+
+#if OFFSETBITS == 16
+  /* hyph_hu_HU does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+#ifdef HAVE_UNISTD_H
+  alarm(60);
+#endif
+  ret |= check_hyphenation(tables,
+			   "megszents\\x00e9gtelen\\x00edthetetlens\\x00e9g",
+			   "00010000100101010010100100100");
+  ret |= check_hyphenation(tables, "agyaggy\\x0171r\\x0171iken",
+			   "00000100101100");
+  ret |= check_hyphenation(tables, "ad\\x00f3ssz\\x00e1mla", "0000100010");
+  ret |= check_hyphenation(tables, "agyonnyom", "000001000");
+  return ret;
+}
@@ -0,0 +1,152 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that a table starting with an include which was compiled
+   before is the same as one compiled from source, and that the
+   include is compiled again once it has changed. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#if defined(_WIN32) || !defined(HAVE_UNISTD_H)
+
+int
+main (int argc, char **argv)
+{
+  /* Skip the test */
+  return 77;
+}
+
+#else
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <time.h>
+#include <utime.h>
+
+/* The second table of each pair is included by the first one. */
+static const char *tables[][2] = {
+  {"en-us-g2.ctb", "en-us-g1.ctb"},
+  {"UEBC-g2.ctb", "UEBC-g1.utb"},
+};
+
+static const char *dir = "includeCacheTables";
+
+static int
+writeFile (const char *name, const char *contents, time_t modified)
+{
+  char path[256];
+  FILE *file;
+  struct utimbuf times;
+  sprintf (path, "%s/%s", dir, name);
+  if (!(file = fopen (path, "w")))
+    return 0;
+  fputs (contents, file);
+  fclose (file);
+  times.actime = times.modtime = modified;
+  return utime (path, &times) == 0;
+}
+
+static int
+translateDots (const char *table, widechar * dots)
+{
+  widechar inbuf[] = { 'c', 'a', 't' };
+  int inlen = 3;
+  int outlen = 1;
+  if (!lou_translateString (table, inbuf, &inlen, dots, &outlen, NULL,
+			    NULL, dotsIO))
+    return 0;
+  return outlen == 1;
+}
+
+static void
+removeFiles ()
+{
+  remove ("includeCacheTables/base.cti");
+  remove ("includeCacheTables/first.ctb");
+  remove ("includeCacheTables/second.ctb");
+  rmdir (dir);
+}
+
+int
+main (int argc, char **argv)
+{
+  TranslationTableHeader *table;
+  void *expected;
+  int expectedSize;
+  widechar dots;
+  time_t now = time (NULL);
+  int result = 0;
+  int i;
+
+  for (i = 0; i < sizeof (tables) / sizeof (tables[0]); i++)
+    {
+      lou_free ();
+      if (!(table = lou_getTable (tables[i][1])))
+	{
+	  printf ("Cannot compile %s\n", tables[i][1]);
+	  return 1;
+	}
+      expectedSize = table->bytesUsed;
+      expected = malloc (expectedSize);
+      memcpy (expected, table, expectedSize);
+      lou_free ();
+      if (!lou_getTable (tables[i][0])
+	  || !(table = lou_getTable (tables[i][1])))
+	{
+	  printf ("Cannot compile %s after %s\n", tables[i][1], tables[i][0]);
+	  result = 1;
+	}
+      else if (table->bytesUsed != expectedSize
+	       || memcmp (table, expected, expectedSize))
+	{
+	  printf ("%s differs when compiled after %s\n", tables[i][1],
+		  tables[i][0]);
+	  result = 1;
+	}
+      free (expected);
+    }
+  lou_free ();
+
+  /* Change an include after it was compiled. Its modification time is
+     set explicitly, as the file may be written twice within a second. */
+  mkdir (dir, 0777);
+  if (!writeFile ("base.cti", "include chardefs.cti\nalways cat 14\n",
+		  now - 20)
+      || !writeFile ("first.ctb", "include base.cti\n", now - 20)
+      || !writeFile ("second.ctb", "include base.cti\n", now - 20))
+    {
+      printf ("Cannot write the tables in %s\n", dir);
+      removeFiles ();
+      return 1;
+    }
+  if (!translateDots ("includeCacheTables/first.ctb", &dots)
+      || dots != 0x8009)
+    {
+      printf ("first.ctb does not translate as expected\n");
+      result = 1;
+    }
+  writeFile ("base.cti", "include chardefs.cti\nalways cat 1245\n",
+	     now - 10);
+  if (!translateDots ("includeCacheTables/second.ctb", &dots)
+      || dots != 0x801b)
+    {
+      printf ("The changed include was not compiled again\n");
+      result = 1;
+    }
+  lou_free ();
+  removeFiles ();
+  return result;
+}
+
+#endif
@@ -0,0 +1,118 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that a table compiled lazily translates, back-translates and
+   hyphenates the same as one compiled at once, and that its parts are
+   only compiled when they are first used. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+static const char *tableList = "en-us-g2.ctb,hyph_en_US.dic";
+static const char *text = "Straightforward knowledge of the international "
+  "conference, together with the afternoon's themes.";
+
+typedef struct
+{
+  widechar braille[200];
+  int brailleLength;
+  widechar back[200];
+  int backLength;
+  char hyphens[20];
+} Results;
+
+static int
+getResults (Results * results)
+{
+  widechar inbuf[200];
+  widechar word[] = { 'c', 'o', 'n', 'f', 'e', 'r', 'e', 'n', 'c', 'e' };
+  int inlen;
+  int k;
+  memset (results, 0, sizeof (*results));
+  for (inlen = 0; text[inlen]; inlen++)
+    inbuf[inlen] = text[inlen];
+  results->brailleLength = 200;
+  if (!lou_translateString (tableList, inbuf, &inlen, results->braille,
+			    &results->brailleLength, NULL, NULL, 0))
+    return 0;
+  k = results->brailleLength;
+  results->backLength = 200;
+  if (!lou_backTranslateString (tableList, results->braille, &k,
+				results->back, &results->backLength, NULL,
+				NULL, 0))
+    return 0;
+  return lou_hyphenate (tableList, word, 10, results->hyphens, 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  TranslationTableHeader *table;
+  Results expected;
+  Results results;
+  widechar dots[] = { 0x8001 | 0x8002 };
+  widechar c;
+  int result = 0;
+
+#if OFFSETBITS == 16
+  /* en-us-g2 with hyph_en_US does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  if (!getResults (&expected))
+    {
+      printf ("Cannot use %s\n", tableList);
+      return 1;
+    }
+  lou_free ();
+
+  lou_setLazyCompilation (LOU_LAZY_HYPHENATION | LOU_LAZY_BACKTRANSLATION);
+  if (!(table = lou_getTable (tableList)) || table->hyphenStatesArray
+      || !table->lazyHyphenation || !table->lazyBackRules)
+    {
+      printf ("The lazy parts were compiled at once\n");
+      result = 1;
+    }
+  /* Neither of these needs the lazy parts */
+  c = 0;
+  lou_dotsToChar (tableList, dots, &c, 1, 0);
+  if (lou_getTable (tableList) != table)
+    {
+      printf ("The table was completed when it was not needed\n");
+      result = 1;
+    }
+  if (!getResults (&results))
+    {
+      printf ("Cannot use %s when it is compiled lazily\n", tableList);
+      result = 1;
+    }
+  else if (results.brailleLength != expected.brailleLength
+	   || memcmp (results.braille, expected.braille,
+		      results.brailleLength * sizeof (widechar))
+	   || results.backLength != expected.backLength
+	   || memcmp (results.back, expected.back,
+		      results.backLength * sizeof (widechar))
+	   || memcmp (results.hyphens, expected.hyphens,
+		      sizeof (results.hyphens)))
+    {
+      printf ("The results differ when the table is compiled lazily\n");
+      result = 1;
+    }
+  table = lou_getTable (tableList);
+  if (!table->hyphenStatesArray || table->lazyHyphenation
+      || table->lazyBackRules)
+    {
+      printf ("The lazy parts were not compiled when used\n");
+      result = 1;
+    }
+
+  lou_setLazyCompilation (0);
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,90 @@
+#!/usr/bin/perl
+use warnings;
+use strict;
+use POSIX ":sys_wait_h";
+$|++;
+
+# Test that lou_translate --socket translates through lou_daemon as
+# lou_translate --file does by itself, with a table the daemon compiled
+# when it started and with one it compiles on request, and that
+# lou_daemon does not remove a file in place of its socket.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved. This file is offered as-is,
+# without any warranty.
+
+my $corpora = "$ENV{srcdir}/../tools/benchmark";
+my $socket = "lou_daemon.socket";
+
+my @cases = (
+    [ "en-us-g2.ctb", "english.txt" ],
+    [ "ru-litbrl.ctb", "russian.txt" ],
+    );
+
+sub start {
+    my ($quiet, @tables) = @_;
+    my $pid = fork ();
+    defined $pid or die "cannot fork\n";
+    if (!$pid) {
+	open (STDERR, ">", "/dev/null") if $quiet;
+	exec ("../tools/lou_daemon", "--quiet", $socket, @tables);
+	exit 1;
+    }
+    return $pid;
+}
+
+sub translate {
+    my ($options, $table, $input) = @_;
+    my $output = `../tools/lou_translate $options $table < $input 2> /dev/null`;
+    $? == 0 or die "lou_translate $options $table failed on $input\n";
+    return $output;
+}
+
+# A file which is not a socket is left where it is
+unlink $socket;
+open (my $fh, ">", $socket) or die "$socket cannot be written\n";
+print $fh "not a socket\n";
+close $fh;
+my $pid = start (1);
+my $k;
+for ($k = 0; $k < 50 && waitpid ($pid, WNOHANG) == 0; $k++) {
+    select (undef, undef, undef, 0.1);
+}
+if ($k == 50) {
+    kill "TERM", $pid;
+    waitpid ($pid, 0);
+    die "lou_daemon listens in place of a file\n";
+}
+-f $socket or die "lou_daemon removes a file in place of its socket\n";
+unlink $socket;
+
+$pid = start (0, "en-us-g2.ctb");
+for ($k = 0; $k < 100 && !-S $socket; $k++) {
+    waitpid ($pid, WNOHANG) == 0 or die "lou_daemon does not start\n";
+    select (undef, undef, undef, 0.1);
+}
+my $result = eval {
+    -S $socket or die "lou_daemon does not listen on $socket\n";
+    foreach my $case (@cases) {
+	my ($table, $corpus) = @$case;
+	my $input = "$corpora/$corpus";
+	my $expected = translate ("--file", $table, $input);
+	translate ("--socket=$socket", $table, $input) eq $expected
+	    or die "lou_daemon translates $corpus with $table differently\n";
+	open ($fh, ">", $socket . ".brl")
+	    or die "$socket.brl cannot be written\n";
+	print $fh $expected;
+	close $fh;
+	translate ("--socket=$socket --backward", $table, "$socket.brl")
+	    eq translate ("--file --backward", $table, "$socket.brl")
+	    or die "lou_daemon back-translates $corpus with $table "
+	    . "differently\n";
+    }
+    1;
+};
+my $error = $@;
+kill "TERM", $pid;
+waitpid ($pid, 0);
+unlink $socket, "$socket.brl";
+$result or die $error;
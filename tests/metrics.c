@@ -0,0 +1,154 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that lou_getMetrics counts the calls, the characters, the
+   tables looked up and the calls which ran out of output space or
+   work, and adds up what each thread counted. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#define NUMTHREADS 4
+#define ITERATIONS 50
+#define BUFSIZE 256
+
+static const char *tableList = "en-us-g2.ctb";
+
+static const char *text = "the quick brown fox jumps over the lazy dog";
+
+static int
+translate (louContext * ctx, int outlen)
+{
+  widechar inbuf[BUFSIZE];
+  widechar outbuf[BUFSIZE];
+  int inlen = extParseChars (text, inbuf);
+  return lou_translateCtx (ctx, tableList, inbuf, &inlen, outbuf, &outlen,
+			   NULL, NULL, NULL, NULL, NULL, 0);
+}
+
+static void *
+translateMany (void *arg)
+{
+  louContext *ctx = lou_createContext ();
+  int i;
+  for (i = 0; i < ITERATIONS; i++)
+    translate (ctx, BUFSIZE);
+  lou_freeContext (ctx);
+  return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+  louMetrics before, after;
+  louContext *ctx;
+  widechar cells[BUFSIZE];
+  widechar outbuf[BUFSIZE];
+  int inlen, outlen, calls;
+  int result = 0;
+  int i;
+#ifdef HAVE_PTHREAD_H
+  pthread_t threads[NUMTHREADS];
+#endif
+
+  if (lou_getMetrics (NULL))
+    {
+      printf ("lou_getMetrics takes NULL\n");
+      result = 1;
+    }
+  lou_getMetrics (&before);
+  ctx = lou_createContext ();
+  translate (ctx, BUFSIZE);
+  lou_getMetrics (&after);
+  if (after.tableMisses != before.tableMisses + 1
+      || after.tableCompiles != before.tableCompiles + 1
+      || after.compileSeconds <= before.compileSeconds)
+    {
+      printf ("Compiling %s is not counted\n", tableList);
+      result = 1;
+    }
+  if (after.translations != before.translations + 1
+      || after.translatedChars != before.translatedChars + strlen (text))
+    {
+      printf ("A translation is not counted\n");
+      result = 1;
+    }
+  if (after.scratchBytes <= before.scratchBytes)
+    {
+      printf ("The working buffers are not counted\n");
+      result = 1;
+    }
+
+  lou_getMetrics (&before);
+  translate (ctx, 10);
+  lou_setWorkBudget (ctx, 5, 0);
+  translate (ctx, BUFSIZE);
+  lou_setWorkBudget (ctx, 0, 0);
+  inlen = extParseChars ("!k ,brn fox", cells);
+  outlen = BUFSIZE;
+  lou_backTranslateCtx (ctx, tableList, cells, &inlen, outbuf, &outlen,
+			NULL, NULL, NULL, NULL, NULL, 0);
+  lou_getMetrics (&after);
+  if (after.tableHits != before.tableHits + 3
+      || after.tableMisses != before.tableMisses)
+    {
+      printf ("Looking %s up is not counted\n", tableList);
+      result = 1;
+    }
+  if (after.outputFull != before.outputFull + 1
+      || after.workStopped != before.workStopped + 1)
+    {
+      printf ("Translations stopped short are not counted\n");
+      result = 1;
+    }
+  if (after.backTranslations != before.backTranslations + 1
+      || after.backTranslatedCells != before.backTranslatedCells + 11)
+    {
+      printf ("A back-translation is not counted\n");
+      result = 1;
+    }
+
+  lou_getMetrics (&before);
+  lou_freeContext (ctx);
+  lou_getMetrics (&after);
+  if (after.scratchBytes >= before.scratchBytes)
+    {
+      printf ("Freeing the working buffers is not counted\n");
+      result = 1;
+    }
+
+  lou_getMetrics (&before);
+#ifdef HAVE_PTHREAD_H
+  for (i = 0; i < NUMTHREADS; i++)
+    pthread_create (&threads[i], NULL, translateMany, NULL);
+  for (i = 0; i < NUMTHREADS; i++)
+    pthread_join (threads[i], NULL);
+  calls = NUMTHREADS * ITERATIONS;
+#else
+  translateMany (NULL);
+  calls = ITERATIONS;
+#endif
+  lou_getMetrics (&after);
+  if (after.translations != before.translations + calls
+      || after.tableHits != before.tableHits + calls)
+    {
+      printf ("The translations of several threads are not all counted\n");
+      result = 1;
+    }
+
+  lou_free ();
+  return result;
+}
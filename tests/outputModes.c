@@ -0,0 +1,106 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that a translation put out as dots, as Unicode braille and as
+   the characters of the display table are the same cells, and that
+   back-translating each of them gives the same text. */
+
+#include <stdio.h>
+#include <string.h>
+#include "liblouis.h"
+#include "louis.h"
+
+#define BUFSIZE 512
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "unicode.dis,en-us-g1.ctb",
+  "de-de-g2.ctb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static const char *text =
+  "The quick brown fox, 123 jumps over the lazy dog! \\x00fcber Stra\\x00dfe";
+
+static int
+translate (const char *table, const widechar * inbuf, int inlen,
+	   widechar * outbuf, widechar * backbuf, int *backlen, int mode)
+{
+  int outlen = BUFSIZE;
+  *backlen = BUFSIZE;
+  if (!lou_translateString (table, inbuf, &inlen, outbuf, &outlen, NULL,
+			    NULL, mode))
+    return -1;
+  inlen = outlen;
+  if (!lou_backTranslateString (table, outbuf, &inlen, backbuf, backlen,
+				NULL, NULL, mode))
+    return -1;
+  return outlen;
+}
+
+static int
+checkTable (const char *table, const widechar * inbuf, int inlen)
+{
+  widechar dots[BUFSIZE], unicode[BUFSIZE], display[BUFSIZE];
+  widechar expected[BUFSIZE];
+  widechar back[3][BUFSIZE];
+  int backlen[3];
+  int dotslen, k;
+  dotslen = translate (table, inbuf, inlen, dots, back[0], &backlen[0],
+		       dotsIO);
+  if (dotslen < 0
+      || translate (table, inbuf, inlen, unicode, back[1], &backlen[1],
+		    dotsIO | ucBrl) != dotslen
+      || translate (table, inbuf, inlen, display, back[2], &backlen[2],
+		    0) != dotslen)
+    {
+      printf ("%s gives braille of different lengths\n", table);
+      return 1;
+    }
+  for (k = 0; k < dotslen; k++)
+    if (unicode[k] != (0x2800 | (dots[k] & 0xff)))
+      {
+	printf ("%s: Unicode braille differs from the dots\n", table);
+	return 1;
+      }
+  lou_dotsToChar (table, dots, expected, dotslen, 0);
+  if (memcmp (display, expected, dotslen * sizeof (widechar)))
+    {
+      printf ("%s: characters differ from the dots\n", table);
+      return 1;
+    }
+  for (k = 1; k < 3; k++)
+    if (backlen[k] != backlen[0]
+	|| memcmp (back[k], back[0], backlen[0] * sizeof (widechar)))
+      {
+	printf ("%s: back-translations differ\n", table);
+	return 1;
+      }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar inbuf[BUFSIZE];
+  int inlen;
+  int result = 0;
+  int i;
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  inlen = extParseChars (text, inbuf);
+  for (i = 0; i < NUMTABLES; i++)
+    result |= checkTable (tables[i], inbuf, inlen);
+
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,130 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that multipass rules tried through their guards translate the
+   same as rules tried one by one along their chains, that a rule
+   added with lou_compileString is not left out and is read to the end
+   of its text and no further, and that a rule which matches nothing
+   is not tried again at the same place. */
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+#define BUFSIZE 512
+
+static const char *tables[] = {
+  "ru-litbrl.ctb",
+  "nl-NL-g1.ctb",
+  "wiskunde.ctb",
+  "nemeth.ctb",
+  "marburg.ctb",
+  "da-dk-g26.ctb",
+};
+
+static const char *text = "The Quick BROWN fox, 29 Jumps: (3+4)=7; "
+  "x^2-1/2 over 1.5 and 17%. Mit \"Gruessen\" - 'Det Er' 42nd! "
+  "\\x041f\\x0440\\x0438\\x0432\\x0435\\x0442, 2014 \\x0433.";
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static int
+translate (const char *table, const widechar *inbuf, int inlen,
+	   widechar *outbuf, int *outlen)
+{
+  *outlen = BUFSIZE;
+  return lou_translateString (table, inbuf, &inlen, outbuf, outlen, NULL,
+			      NULL, 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar inbuf[BUFSIZE];
+  widechar expected[BUFSIZE];
+  widechar outbuf[BUFSIZE];
+  int inlen, expectedlen, outlen;
+  TranslationTableHeader *table;
+  int result = 0;
+  int i, pass, guarded;
+
+#if OFFSETBITS == 16
+  /* da-dk-g26 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  inlen = extParseChars (text, inbuf);
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      if (!(table = lou_getTable (tables[i])))
+	{
+	  printf ("Cannot compile %s\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      for (guarded = pass = 0; pass < 5; pass++)
+	if (table->passRuleGuards[pass])
+	  guarded = 1;
+      if (!guarded)
+	{
+	  printf ("%s has no guarded multipass rules\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      translate (tables[i], inbuf, inlen, expected, &expectedlen);
+      memset (table->passRuleGuards, 0, sizeof (table->passRuleGuards));
+      translate (tables[i], inbuf, inlen, outbuf, &outlen);
+      if (outlen != expectedlen
+	  || memcmp (outbuf, expected, outlen * sizeof (widechar)))
+	{
+	  printf ("%s translates differently without the guards\n",
+		  tables[i]);
+	  result = 1;
+	}
+    }
+  lou_free ();
+
+  inlen = extParseChars ("a quux b", inbuf);
+  translate (tables[1], inbuf, inlen, expected, &expectedlen);
+  if (!lou_compileString (tables[1], "context $l[$l]$l @1234"))
+    {
+      printf ("Cannot add a rule to %s\n", tables[1]);
+      result = 1;
+    }
+  else if (!translate (tables[1], inbuf, inlen, outbuf, &outlen)
+	   || (outlen == expectedlen
+	       && !memcmp (outbuf, expected, outlen * sizeof (widechar))))
+    {
+      printf ("A rule added with lou_compileString is not used\n");
+      result = 1;
+    }
+
+  /* compileString did not set the length of the line, so a multipass 
+     rule was read from stack garbage after its text */
+  inlen = extParseChars ("e", inbuf);
+  outlen = BUFSIZE;
+  if (!lou_compileString ("pass2.ctb", "pass2 @15 @1245")
+      || !lou_translateString ("pass2.ctb", inbuf, &inlen, outbuf, &outlen,
+			       NULL, NULL, dotsIO)
+      || outlen != 1 || outbuf[0] != 0x801b)
+    {
+      printf ("A multipass rule given to lou_compileString is misread\n");
+      result = 1;
+    }
+
+  /* The not-class rule of ru-litbrl matches nothing at the end of a 
+     segment, where it must not be tried again and again */
+  inlen = extParseChars ("a\\xffff", inbuf);
+  if (!translate (tables[0], inbuf, inlen, outbuf, &outlen))
+    {
+      printf ("%s cannot translate the end of a segment\n", tables[0]);
+      result = 1;
+    }
+
+  lou_free ();
+  return result;
+}
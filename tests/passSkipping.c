@@ -0,0 +1,141 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that skipping the passes none of whose rules can match the text
+   changes neither the translation nor its positions, that translating
+   without keeping the positions gives the same braille, and that a rule
+   added with lou_compileString is not skipped. */
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+#define BUFSIZE 512
+
+static const char *tables[] = {
+  "marburg.ctb",
+  "ukmaths.ctb",
+  "nl-NL-g1.ctb",
+  "ru-litbrl.ctb",
+  "hi-in-g1.utb",
+  "no-no-g2.ctb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static const char *texts[] = {
+  "the quick brown fox jumps over the lazy dog",
+  "The Quick BROWN fox, 29 Jumps: (3+4)=7; x^2-1/2 over 1.5 and 17%.",
+  "\\x041f\\x0440\\x0438\\x0432\\x0435\\x0442, 2014 \\x0433. "
+    "\\x0928\\x092e\\x0938\\x094d\\x0924\\x0947 1/2",
+};
+
+#define NUMTEXTS (sizeof (texts) / sizeof (texts[0]))
+
+typedef struct
+{
+  widechar outbuf[BUFSIZE];
+  int outlen;
+  int inputPos[BUFSIZE];
+  int outputPos[BUFSIZE];
+} Result;
+
+static int
+translate (const char *table, const widechar *inbuf, int inlen,
+	   Result *result, int positions)
+{
+  result->outlen = BUFSIZE;
+  return lou_translate (table, inbuf, &inlen, result->outbuf,
+			&result->outlen, NULL, NULL,
+			positions ? result->outputPos : NULL,
+			positions ? result->inputPos : NULL, NULL, 0);
+}
+
+static int
+sameResult (const Result *a, const Result *b, int inlen, int positions)
+{
+  return a->outlen == b->outlen
+    && !memcmp (a->outbuf, b->outbuf, a->outlen * sizeof (widechar))
+    && (!positions
+	|| (!memcmp (a->inputPos, b->inputPos, a->outlen * sizeof (int))
+	    && !memcmp (a->outputPos, b->outputPos, inlen * sizeof (int))));
+}
+
+int
+main (int argc, char **argv)
+{
+  static Result expected[NUMTEXTS][2], received;
+  widechar inbuf[NUMTEXTS][BUFSIZE];
+  int inlen[NUMTEXTS];
+  TranslationTableHeader *table;
+  int result = 0;
+  int i, j, k, filtered;
+
+  for (j = 0; j < NUMTEXTS; j++)
+    inlen[j] = extParseChars (texts[j], inbuf[j]);
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      if (!(table = lou_getTable (tables[i])))
+	{
+	  printf ("Cannot compile %s\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      for (j = 0; j < NUMTEXTS; j++)
+	{
+	  for (k = 0; k < 2; k++)
+	    translate (tables[i], inbuf[j], inlen[j], &expected[j][k], k);
+	  if (!sameResult (&expected[j][0], &expected[j][1], inlen[j], 0))
+	    {
+	      printf ("%s translates \"%s\" differently when the positions "
+		      "are kept\n", tables[i], texts[j]);
+	      result = 1;
+	    }
+	}
+      for (filtered = k = 0; k < 5; k++)
+	{
+	  if (k != 1 && !table->passStarts[k].anywhere)
+	    filtered = 1;
+	  table->passStarts[k].anywhere = 1;
+	}
+      if (!filtered)
+	{
+	  printf ("%s has no pass that can be skipped\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      for (j = 0; j < NUMTEXTS; j++)
+	for (k = 0; k < 2; k++)
+	  {
+	    translate (tables[i], inbuf[j], inlen[j], &received, k);
+	    if (!sameResult (&expected[j][k], &received, inlen[j], k))
+	      {
+		printf ("%s translates \"%s\" differently when no pass is "
+			"skipped\n", tables[i], texts[j]);
+		result = 1;
+	      }
+	  }
+    }
+  lou_free ();
+
+  inlen[0] = extParseChars ("a", inbuf[0]);
+  translate (tables[2], inbuf[0], inlen[0], &expected[0][0], 0);
+  if (!lou_compileString (tables[2], "pass2 @1 @1234"))
+    {
+      printf ("Cannot add a rule to %s\n", tables[2]);
+      result = 1;
+    }
+  else if (!translate (tables[2], inbuf[0], inlen[0], &received, 0)
+	   || sameResult (&expected[0][0], &received, inlen[0], 0))
+    {
+      printf ("A rule added with lou_compileString is not used\n");
+      result = 1;
+    }
+
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,85 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that tables preloaded in the background can be used while they
+   are still being compiled, that they are then the tables cached, and
+   that lou_free waits for a preload it was not told about. */
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "de-de-g2.ctb",
+  "fr-bfu-g2.ctb",
+  "en-ueb-g2.ctb",
+  "nonexistent.ctb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static int
+translate (const char *tableList, widechar * outbuf, int *outlen)
+{
+  widechar inbuf[32];
+  int inlen = extParseChars ("the quick brown fox", inbuf);
+  *outlen = 64;
+  return lou_translateString (tableList, inbuf, &inlen, outbuf, outlen,
+			      NULL, NULL, 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar expected[64], outbuf[64];
+  int expectedlen, outlen;
+  void *early[NUMTABLES];
+  int result = 0;
+  int loaded, i;
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  translate (tables[0], expected, &expectedlen);
+  lou_free ();
+
+  lou_preloadTablesAsync (tables, NUMTABLES, 2);
+  if (!translate (tables[0], outbuf, &outlen) || outlen != expectedlen
+      || memcmp (outbuf, expected, outlen * sizeof (widechar)))
+    {
+      printf ("Translation during the preload went wrong\n");
+      result = 1;
+    }
+  for (i = 0; i < NUMTABLES; i++)
+    early[i] = lou_getTable (tables[i]);
+  loaded = lou_waitForPreload ();
+  if (loaded != NUMTABLES - 1)
+    {
+      printf ("%d of %d tables were preloaded\n", loaded,
+	      (int) NUMTABLES - 1);
+      result = 1;
+    }
+  for (i = 0; i < NUMTABLES; i++)
+    if (lou_getTable (tables[i]) != early[i])
+      {
+	printf ("%s changed after the preload\n", tables[i]);
+	result = 1;
+      }
+  if (lou_waitForPreload () != 0)
+    {
+      printf ("A finished preload was counted again\n");
+      result = 1;
+    }
+  lou_free ();
+
+  lou_preloadTablesAsync (tables, NUMTABLES, 0);
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,85 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that tables preloaded on several threads are the same as
+   tables compiled one after another, and that a list with errors is
+   not counted. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "en-us-g1.ctb",
+  "UEBC-g2.ctb",
+  "en-ueb-g2.ctb",
+  "fr-bfu-g2.ctb",
+  "de-de-g2.ctb",
+  "nl-NL-g1.ctb",
+  "en-us-g1.ctb,en-us-compbrl.ctb",
+  "nonexistent.ctb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+int
+main (int argc, char **argv)
+{
+  void *expected[NUMTABLES];
+  int expectedSize[NUMTABLES];
+  TranslationTableHeader *table;
+  int result = 0;
+  int loaded;
+  int i;
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      expected[i] = NULL;
+      if ((table = lou_getTable (tables[i])))
+	{
+	  expectedSize[i] = table->bytesUsed;
+	  expected[i] = malloc (expectedSize[i]);
+	  memcpy (expected[i], table, expectedSize[i]);
+	}
+      lou_free ();
+    }
+
+  loaded = lou_preloadTables (tables, NUMTABLES, 4);
+  if (loaded != NUMTABLES - 1)
+    {
+      printf ("%d of %d tables were preloaded\n", loaded,
+	      (int) NUMTABLES - 1);
+      result = 1;
+    }
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      table = lou_getTable (tables[i]);
+      if ((table == NULL) != (expected[i] == NULL))
+	{
+	  printf ("%s %s\n", tables[i], table ? "should have failed" :
+		  "was not preloaded");
+	  result = 1;
+	}
+      else if (table && (table->bytesUsed != expectedSize[i]
+			 || memcmp (table, expected[i], expectedSize[i])))
+	{
+	  printf ("%s differs when preloaded\n", tables[i]);
+	  result = 1;
+	}
+      free (expected[i]);
+    }
+
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,267 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that the jobs of a translation queue give the same results as
+   translating, back-translating and hyphenating directly, whether they
+   are given to a callback or taken when the file descriptor of the
+   queue is readable, that a queue with a cap refuses jobs until
+   completions are taken, and that freeing a queue gives every job to
+   the callback once. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include "liblouis.h"
+#include "louis.h"
+
+#define BUFSIZE 1024
+#define NUMJOBS 300
+
+static const char *words[] = {
+  "The", "quick", "brown", "fox", "jumps", "over", "the", "lazy", "dog",
+  "and", "then", "123", "more", "times,", "unbelievably", "quickly!",
+};
+
+#define NUMWORDS (sizeof (words) / sizeof (words[0]))
+
+typedef struct
+{
+  widechar inbuf[BUFSIZE];
+  int inlen;
+  widechar expected[BUFSIZE];
+  int expectedlen;
+  int kind;
+  int completions;
+  int status;
+  int same;
+} Job;
+
+static Job jobs[NUMJOBS];
+
+static void
+makeJobs (const louTable *table)
+{
+  char text[BUFSIZE];
+  char hyphens[BUFSIZE];
+  int k, j, length;
+  for (k = 0; k < NUMJOBS; k++)
+    {
+      text[0] = 0;
+      for (j = 0; j < 1 + k % 40; j++)
+	{
+	  strcat (text, words[(k + 7 * j) % NUMWORDS]);
+	  strcat (text, " ");
+	}
+      jobs[k].inlen = extParseChars (text, jobs[k].inbuf);
+      jobs[k].kind = k % 10 == 3 ? louBackTranslateJob :
+	k % 10 == 7 ? louHyphenateJob : louTranslateJob;
+      jobs[k].expectedlen = BUFSIZE;
+      length = jobs[k].inlen;
+      if (jobs[k].kind == louHyphenateJob)
+	{
+	  lou_hyphenateTextWithTable (table, jobs[k].inbuf, length, hyphens);
+	  jobs[k].expectedlen = length + 1;
+	  for (j = 0; j < jobs[k].expectedlen; j++)
+	    jobs[k].expected[j] = hyphens[j];
+	}
+      else if (jobs[k].kind == louBackTranslateJob)
+	{
+	  /* Back-translate the braille of the text */
+	  lou_translateWithTable (table, NULL, jobs[k].inbuf, &length,
+				  jobs[k].expected, &jobs[k].expectedlen,
+				  NULL, NULL, NULL, NULL, NULL, 0);
+	  memcpy (jobs[k].inbuf, jobs[k].expected,
+		  jobs[k].expectedlen * sizeof (widechar));
+	  jobs[k].inlen = length = jobs[k].expectedlen;
+	  jobs[k].expectedlen = BUFSIZE;
+	  lou_backTranslateWithTable (table, NULL, jobs[k].inbuf, &length,
+				      jobs[k].expected, &jobs[k].expectedlen,
+				      NULL, NULL, NULL, NULL, NULL, 0);
+	}
+      else
+	lou_translateWithTable (table, NULL, jobs[k].inbuf, &length,
+				jobs[k].expected, &jobs[k].expectedlen, NULL,
+				NULL, NULL, NULL, NULL, 0);
+    }
+}
+
+static void
+complete (const louCompletion *completion, void *data)
+{
+  Job *job = completion->user;
+  int k;
+  job->completions++;
+  job->status = completion->status;
+  job->same = completion->kind == job->kind
+    && completion->outlen == job->expectedlen;
+  if (job->same && completion->kind == louHyphenateJob)
+    {
+      for (k = 0; k < completion->outlen; k++)
+	if (completion->hyphens[k] != job->expected[k])
+	  job->same = 0;
+    }
+  else if (job->same)
+    job->same = !memcmp (completion->outbuf, job->expected,
+			 completion->outlen * sizeof (widechar));
+  if (data != NULL)
+    (*(int *) data)++;
+}
+
+static void
+resetJobs (void)
+{
+  int k;
+  for (k = 0; k < NUMJOBS; k++)
+    jobs[k].completions = jobs[k].same = jobs[k].status = 0;
+}
+
+static int
+checkJobs (const char *what, int cancelled)
+{
+  int k;
+  for (k = 0; k < NUMJOBS; k++)
+    if (jobs[k].completions != 1
+	|| (jobs[k].status != 1 && !(cancelled && jobs[k].status == -1))
+	|| (jobs[k].status == 1 && !jobs[k].same))
+      {
+	printf ("%s: job %d was completed %d times with status %d%s\n",
+		what, k, jobs[k].completions, jobs[k].status,
+		jobs[k].same ? "" : " and a different result");
+	return 1;
+      }
+  return 0;
+}
+
+static int
+takeCompletions (louQueue *queue, int timeout)
+{
+  struct pollfd fd;
+  const louCompletion *completion;
+  int taken = 0;
+  fd.fd = lou_queueFd (queue);
+  fd.events = POLLIN;
+  if (poll (&fd, 1, timeout) != 1)
+    return 0;
+  while ((completion = lou_nextCompletion (queue)) != NULL)
+    {
+      complete (completion, NULL);
+      taken++;
+    }
+  return taken;
+}
+
+int
+main (int argc, char **argv)
+{
+  const louTable *table;
+  louQueue *queue;
+  int result = 0;
+  int k, taken, refused, calls;
+  struct pollfd fd;
+
+#if OFFSETBITS == 16
+  /* en-us-g2 with hyph_en_US does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  if (!(table = lou_openTable ("en-us-g2.ctb,hyph_en_US.dic")))
+    {
+      printf ("en-us-g2.ctb could not be opened\n");
+      return 1;
+    }
+  makeJobs (table);
+
+  /* Completions given to a callback */
+  resetJobs ();
+  queue = lou_createQueue (4, 0, complete, NULL);
+  for (k = 0; k < NUMJOBS; k++)
+    if (!lou_submit (queue, jobs[k].kind, table, jobs[k].inbuf,
+		     jobs[k].inlen, 0, &jobs[k], 0))
+      {
+	printf ("Job %d was refused by a queue without a cap\n", k);
+	result = 1;
+      }
+  lou_waitQueue (queue);
+  result |= checkJobs ("callback", 0);
+  lou_freeQueue (queue);
+
+  /* Completions taken when the queue is readable, with a cap */
+  resetJobs ();
+  queue = lou_createQueue (3, 8000, NULL, NULL);
+  if (lou_queueFd (queue) < 0)
+    {
+      printf ("A queue without a callback has no file descriptor\n");
+      return 1;
+    }
+  taken = refused = 0;
+  for (k = 0; k < NUMJOBS;)
+    {
+      if (lou_submit (queue, jobs[k].kind, table, jobs[k].inbuf,
+		      jobs[k].inlen, 0, &jobs[k], 0))
+	k++;
+      else
+	{
+	  refused++;
+	  taken += takeCompletions (queue, 10000);
+	}
+    }
+  while (taken < NUMJOBS)
+    {
+      int more = takeCompletions (queue, 10000);
+      if (!more)
+	break;
+      taken += more;
+    }
+  result |= checkJobs ("polling", 0);
+  if (!refused)
+    {
+      printf ("No job was refused by a queue with a cap\n");
+      result = 1;
+    }
+  fd.fd = lou_queueFd (queue);
+  fd.events = POLLIN;
+  if (poll (&fd, 1, 0) != 0 || lou_nextCompletion (queue) != NULL)
+    {
+      printf ("An empty queue is readable\n");
+      result = 1;
+    }
+  lou_freeQueue (queue);
+
+  /* Waiting for room instead of being refused */
+  resetJobs ();
+  queue = lou_createQueue (2, 4000, complete, NULL);
+  for (k = 0; k < NUMJOBS; k++)
+    if (!lou_submit (queue, jobs[k].kind, table, jobs[k].inbuf,
+		     jobs[k].inlen, 0, &jobs[k], 1))
+      {
+	printf ("Job %d was refused while waiting for room\n", k);
+	result = 1;
+      }
+  lou_waitQueue (queue);
+  result |= checkJobs ("waiting", 0);
+  lou_freeQueue (queue);
+
+  /* Jobs not started when a queue is freed are cancelled */
+  resetJobs ();
+  calls = 0;
+  queue = lou_createQueue (1, 0, complete, &calls);
+  for (k = 0; k < NUMJOBS; k++)
+    lou_submit (queue, jobs[k].kind, table, jobs[k].inbuf, jobs[k].inlen,
+		0, &jobs[k], 0);
+  lou_freeQueue (queue);
+  result |= checkJobs ("cancelling", 1);
+  if (calls != NUMJOBS)
+    {
+      printf ("The callback was called %d times for %d jobs\n", calls,
+	      NUMJOBS);
+      result = 1;
+    }
+
+  lou_free ();
+  return result;
+}
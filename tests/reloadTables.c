@@ -0,0 +1,144 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that lou_reloadTables compiles again only the tables whose
+   files have changed, that a table which was in use stays valid, and
+   that a table which no longer compiles is kept. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#if defined(_WIN32) || !defined(HAVE_UNISTD_H)
+
+int
+main (int argc, char **argv)
+{
+  /* Skip the test */
+  return 77;
+}
+
+#else
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <time.h>
+#include <utime.h>
+
+static const char *dir = "reloadTablesTables";
+
+static int
+writeFile (const char *name, const char *contents, time_t modified)
+{
+  char path[256];
+  FILE *file;
+  struct utimbuf times;
+  sprintf (path, "%s/%s", dir, name);
+  if (!(file = fopen (path, "w")))
+    return 0;
+  fputs (contents, file);
+  fclose (file);
+  times.actime = times.modtime = modified;
+  return utime (path, &times) == 0;
+}
+
+static int
+translateDots (const char *table, widechar * dots)
+{
+  widechar inbuf[] = { 'c', 'a', 't' };
+  int inlen = 3;
+  int outlen = 1;
+  if (!lou_translateString (table, inbuf, &inlen, dots, &outlen, NULL,
+			    NULL, dotsIO))
+    return 0;
+  return outlen == 1;
+}
+
+static void
+removeFiles ()
+{
+  remove ("reloadTablesTables/base.cti");
+  remove ("reloadTablesTables/cat.ctb");
+  rmdir (dir);
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *catTable = "reloadTablesTables/cat.ctb";
+  TranslationTableHeader *oldTable;
+  TranslationTableHeader *table;
+  widechar dots;
+  time_t now = time (NULL);
+  int result = 0;
+  int reloaded;
+
+  mkdir (dir, 0777);
+  if (!writeFile ("base.cti", "include chardefs.cti\nalways cat 14\n",
+		  now - 30)
+      || !writeFile ("cat.ctb", "include base.cti\n", now - 30))
+    {
+      printf ("Cannot write the tables in %s\n", dir);
+      removeFiles ();
+      return 1;
+    }
+  if (!lou_getTable ("en-us-g1.ctb")
+      || !(oldTable = lou_getTable (catTable)))
+    {
+      printf ("Cannot compile the tables\n");
+      removeFiles ();
+      return 1;
+    }
+  if ((reloaded = lou_reloadTables ()) != 0)
+    {
+      printf ("%d tables were reloaded although none changed\n", reloaded);
+      result = 1;
+    }
+
+  /* Change the include. Its modification time is set explicitly, as
+     the file may be written twice within a second. */
+  writeFile ("base.cti", "include chardefs.cti\nalways cat 1245\n",
+	     now - 20);
+  if ((reloaded = lou_reloadTables ()) != 1)
+    {
+      printf ("%d tables were reloaded instead of 1\n", reloaded);
+      result = 1;
+    }
+  table = lou_getTable (catTable);
+  if (table == oldTable || !translateDots (catTable, &dots)
+      || dots != 0x801b)
+    {
+      printf ("The changed table was not reloaded\n");
+      result = 1;
+    }
+  if (oldTable->bytesUsed <= 0 || oldTable->tableSize < oldTable->bytesUsed)
+    {
+      printf ("The old table was freed while it could be in use\n");
+      result = 1;
+    }
+
+  /* A table with errors must not replace the one in use */
+  writeFile ("base.cti",
+	     "include chardefs.cti\nalways cat 1245\nnotanopcode\n",
+	     now - 10);
+  if ((reloaded = lou_reloadTables ()) != 0
+      || lou_getTable (catTable) != table)
+    {
+      printf ("A table with errors was reloaded\n");
+      result = 1;
+    }
+  lou_free ();
+  removeFiles ();
+  return result;
+}
+
+#endif
@@ -0,0 +1,161 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that a table resolved before is found where it was found
+   without searching again, and that it is looked for again once the
+   search path changes, lou_setDataPath is called or lou_free. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#if defined(_WIN32) || !defined(HAVE_UNISTD_H)
+
+int
+main (int argc, char **argv)
+{
+  /* Skip the test */
+  return 77;
+}
+
+#else
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char *dir = "resolveCacheTables";
+
+static void
+writeFile (const char *name)
+{
+  char path[256];
+  FILE *file;
+  sprintf (path, "%s/%s", dir, name);
+  if ((file = fopen (path, "w")))
+    {
+      fputs ("include latinLetterDef6Dots.uti\n", file);
+      fclose (file);
+    }
+}
+
+static void
+removeFile (const char *name)
+{
+  char path[256];
+  sprintf (path, "%s/%s", dir, name);
+  remove (path);
+}
+
+static void
+removeFiles ()
+{
+  removeFile ("a/x.ctb");
+  removeFile ("b/x.ctb");
+  removeFile ("b/y.cti");
+  removeFile ("a");
+  removeFile ("b");
+  rmdir (dir);
+}
+
+static int
+resolvesTo (const char *tableList, const char *base, const char *expected)
+{
+  char **tableFiles = resolveTable (tableList, base);
+  char path[256];
+  int same;
+  sprintf (path, "%s/%s", dir, expected);
+  same = tableFiles && tableFiles[0] && !strcmp (tableFiles[0], path);
+  if (!same)
+    printf ("%s is resolved to %s instead of %s\n", tableList,
+	    tableFiles && tableFiles[0] ? tableFiles[0] : "nothing", path);
+  if (tableFiles)
+    {
+      char **file;
+      for (file = tableFiles; *file; file++)
+	free (*file);
+      free (tableFiles);
+    }
+  return same;
+}
+
+int
+main (int argc, char **argv)
+{
+  char searchPath[4096];
+  int result = 0;
+
+  removeFiles ();
+  if (mkdir (dir, 0777) || mkdir ("resolveCacheTables/a", 0777)
+      || mkdir ("resolveCacheTables/b", 0777))
+    {
+      printf ("%s could not be made\n", dir);
+      return 1;
+    }
+  sprintf (searchPath, "%s/a,%s/b,%s", dir, dir,
+	   getenv ("LOUIS_TABLEPATH") ? getenv ("LOUIS_TABLEPATH") : "");
+  setenv ("LOUIS_TABLEPATH", searchPath, 1);
+  writeFile ("b/x.ctb");
+  writeFile ("b/y.cti");
+  if (!resolvesTo ("x.ctb", NULL, "b/x.ctb"))
+    result = 1;
+
+  /* A new file earlier on the search path is not looked for */
+  writeFile ("a/x.ctb");
+  if (!resolvesTo ("x.ctb", NULL, "b/x.ctb"))
+    result = 1;
+  if (!lou_getTable ("x.ctb"))
+    {
+      printf ("x.ctb could not be compiled\n");
+      result = 1;
+    }
+
+  /* Until lou_setDataPath is called */
+  lou_setDataPath (lou_getDataPath ());
+  if (!resolvesTo ("x.ctb", NULL, "a/x.ctb"))
+    result = 1;
+
+  /* Or lou_free */
+  removeFile ("a/x.ctb");
+  lou_free ();
+  if (!resolvesTo ("x.ctb", NULL, "b/x.ctb"))
+    result = 1;
+
+  /* Or the search path changes */
+  writeFile ("a/x.ctb");
+  sprintf (searchPath, "%s/b,%s/a", dir, dir);
+  setenv ("LOUIS_TABLEPATH", searchPath, 1);
+  if (!resolvesTo ("x.ctb", NULL, "b/x.ctb"))
+    result = 1;
+  sprintf (searchPath, "%s/a,%s/b", dir, dir);
+  setenv ("LOUIS_TABLEPATH", searchPath, 1);
+  if (!resolvesTo ("x.ctb", NULL, "a/x.ctb"))
+    result = 1;
+
+  /* Tables are remembered for the directory of the base they were
+   * resolved against */
+  sprintf (searchPath, "%s/a", dir);
+  setenv ("LOUIS_TABLEPATH", searchPath, 1);
+  if (!resolvesTo ("y.cti", "resolveCacheTables/b/x.ctb", "b/y.cti")
+      || !resolvesTo ("y.cti", "resolveCacheTables/b/x.ctb", "b/y.cti"))
+    result = 1;
+  if (resolveTable ("y.cti", "resolveCacheTables/a/x.ctb") != NULL)
+    {
+      printf ("y.cti is resolved against the wrong directory\n");
+      result = 1;
+    }
+
+  lou_free ();
+  removeFiles ();
+  return result;
+}
+
+#endif
@@ -0,0 +1,124 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that the filters of the pairs of characters and cells rules
+   begin with leave the translation and the back-translation as they
+   are without them, and that a rule added with lou_compileString is
+   not filtered out. */
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+#define BUFSIZE 512
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "de-de-g2.ctb",
+  "nl-NL-g1.ctb",
+  "ko-g2.ctb",
+};
+
+static const char *text = "The Quick BROWN fox, THE quick brown fox's "
+  "29 Jumps over the lazy dog: because together we should know 4.5 "
+  "themselves. Mit Freundlichen Gruessen, l'Eleve a REFLECHI; Det Er "
+  "Ikke Saerlig Svaert. Caf\\x00e9 na\\x00efve \\x00fcber, "
+  "d\\x00e9j\\x00e0 vu. \\xd55c\\xad6d\\xc5b4.";
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static int
+translate (const char *table, const widechar *inbuf, int inlen,
+	   widechar *outbuf, int *outlen, int backward)
+{
+  *outlen = BUFSIZE;
+  if (backward)
+    return lou_backTranslateString (table, inbuf, &inlen, outbuf, outlen,
+				    NULL, NULL, 0);
+  return lou_translateString (table, inbuf, &inlen, outbuf, outlen,
+			      NULL, NULL, 0);
+}
+
+static int
+same (const widechar *outbuf, int outlen, const widechar *expected,
+      int expectedlen)
+{
+  return outlen == expectedlen
+    && !memcmp (outbuf, expected, outlen * sizeof (widechar));
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar inbuf[BUFSIZE];
+  widechar braille[BUFSIZE];
+  widechar expected[BUFSIZE];
+  widechar outbuf[BUFSIZE];
+  int inlen, braillelen, expectedlen, outlen;
+  TranslationTableHeader *table;
+  TranslationTableOffset forRuleFilter, backRuleFilter;
+  int result = 0;
+  int i;
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  inlen = extParseChars (text, inbuf);
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      if (!(table = lou_getTable (tables[i])) || !table->forRuleFilter)
+	{
+	  printf ("%s has no filter of forward rules\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      forRuleFilter = table->forRuleFilter;
+      backRuleFilter = table->backRuleFilter;
+      translate (tables[i], inbuf, inlen, braille, &braillelen, 0);
+      translate (tables[i], braille, braillelen, expected, &expectedlen, 1);
+      table->forRuleFilter = table->backRuleFilter = 0;
+      translate (tables[i], inbuf, inlen, outbuf, &outlen, 0);
+      if (!same (outbuf, outlen, braille, braillelen))
+	{
+	  printf ("%s translates differently without the filter\n",
+		  tables[i]);
+	  result = 1;
+	}
+      translate (tables[i], braille, braillelen, outbuf, &outlen, 1);
+      if (!same (outbuf, outlen, expected, expectedlen))
+	{
+	  printf ("%s back-translates differently without the filter\n",
+		  tables[i]);
+	  result = 1;
+	}
+      table->forRuleFilter = forRuleFilter;
+      table->backRuleFilter = backRuleFilter;
+    }
+
+  inlen = extParseChars ("qzqz", inbuf);
+  if (!lou_compileString (tables[0], "always qzqz 1256-1256"))
+    {
+      printf ("Cannot add a rule to %s\n", tables[0]);
+      result = 1;
+    }
+  else
+    {
+      outlen = BUFSIZE;
+      if (!lou_translate (tables[0], inbuf, &inlen, outbuf, &outlen,
+			  NULL, NULL, NULL, NULL, NULL, dotsIO)
+	  || outlen != 2)
+	{
+	  printf ("A rule added with lou_compileString is not used\n");
+	  result = 1;
+	}
+    }
+
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,143 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that a table compiled with a rule order profile has the rules
+   of a forward rule chain most often applied first, but keeps rules of
+   the same characters in the order they were defined in, and that it
+   translates the same. Also check that a profile written by
+   lou_writeRuleProfile can be read back. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "liblouis.h"
+#include "louis.h"
+
+static const char *tableName = "ruleOrder.ctb";
+static const char *profileName = "ruleOrder.prof";
+
+static int
+translate (const louTable *table, const char *text, widechar *outbuf,
+	   int *outlen)
+{
+  widechar inbuf[100];
+  int inlen = extParseChars (text, inbuf);
+  *outlen = 100;
+  return lou_translateWithTable (table, NULL, inbuf, &inlen, outbuf,
+				 outlen, NULL, NULL, NULL, NULL, NULL, 0);
+}
+
+static int
+chainIs (const louTable *table, const char *expected)
+{
+/* Whether the rules of the chain of "ab" have the third characters and
+ * the dots given in expected, as "c1d12" */
+  const TranslationTableHeader *header = getTableFromHandle (table);
+  TranslationTableOffset offset = findForRules (header, 'a', 'b');
+  char chain[100];
+  int length = 0;
+  while (offset && length < 90)
+    {
+      const TranslationTableRule *rule = (const TranslationTableRule *)
+	& header->ruleArea[offset];
+      if (rule->charslen == 3 && rule->charsdots[0] == 'a')
+	length += sprintf (&chain[length], "%c%s", rule->charsdots[2],
+			   rule->charsdots[3] == 0x8001 ? "1" :
+			   rule->charsdots[3] == 0x8003 ? "12" :
+			   rule->charsdots[3] == 0x8009 ? "14" : "15");
+      offset = rule->charsnext;
+    }
+  chain[length] = 0;
+  if (strcmp (chain, expected))
+    {
+      printf ("The chain of ab is %s instead of %s\n", chain, expected);
+      return 0;
+    }
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  const louTable *table;
+  widechar before[100], after[100];
+  int beforelen, afterlen;
+  FILE *file;
+  int result = 0;
+
+  if (!(file = fopen (tableName, "w")))
+    {
+      printf ("%s could not be written\n", tableName);
+      return 1;
+    }
+  fputs ("include latinLetterDef6Dots.uti\n"
+	 "space \\s 0\n"
+	 "always abc 1\n" "always abd 12\n" "always abe 14\n"
+	 "always abd 15\n", file);
+  fclose (file);
+  if (!(file = fopen (profileName, "w")))
+    {
+      printf ("%s could not be written\n", profileName);
+      return 1;
+    }
+  fputs ("10 10 5 ruleOrder.ctb\n"
+	 "5 5 6 /elsewhere/ruleOrder.ctb\n" "1 1 3 ruleOrder.ctb\n", file);
+  fclose (file);
+
+  /* The rules in the order they were defined in */
+  table = lou_openTable (tableName);
+  if (!table || !chainIs (table, "c1d12e14d15")
+      || !translate (table, "abc abd abe", before, &beforelen))
+    result = 1;
+  lou_closeTable (table);
+  lou_free ();
+
+  /* abe is applied most often and comes first, but the second abd
+   * cannot come before the first */
+  if (!lou_setRuleOrderProfile (profileName))
+    {
+      printf ("%s could not be read\n", profileName);
+      return 1;
+    }
+  table = lou_openTable (tableName);
+  if (!table || !chainIs (table, "e14c1d12d15")
+      || !translate (table, "abc abd abe", after, &afterlen))
+    result = 1;
+  else if (afterlen != beforelen
+	   || memcmp (before, after, beforelen * CHARSIZE))
+    {
+      printf ("The table translates differently with its rules ordered\n");
+      result = 1;
+    }
+  lou_closeTable (table);
+  lou_free ();
+
+  /* A profile written by lou_writeRuleProfile */
+  lou_setRuleOrderProfile (NULL);
+  lou_setRuleProfiling (1);
+  table = lou_openTable (tableName);
+  translate (table, "abe abe abd", after, &afterlen);
+  if (!lou_writeRuleProfile (table, profileName)
+      || !lou_setRuleOrderProfile (profileName))
+    {
+      printf ("A profile could not be written and read back\n");
+      result = 1;
+    }
+  lou_setRuleProfiling (0);
+  lou_closeTable (table);
+  lou_free ();
+  table = lou_openTable (tableName);
+  if (!table || !chainIs (table, "e14d12c1d15"))
+    result = 1;
+  lou_closeTable (table);
+
+  lou_setRuleOrderProfile (NULL);
+  lou_free ();
+  remove (tableName);
+  remove (profileName);
+  return result;
+}
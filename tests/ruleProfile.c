@@ -0,0 +1,150 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that while rules are profiled each rule is counted as tried and
+   applied under the file and line it came from, that the counts can be
+   set back to 0, and that nothing is counted while profiling is off. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "liblouis.h"
+#include "louis.h"
+
+static const char *tableName = "ruleProfile.ctb";
+
+static int
+translate (const louTable *table, const char *text)
+{
+  widechar inbuf[100];
+  widechar outbuf[200];
+  int inlen = extParseChars (text, inbuf);
+  int outlen = 200;
+  return lou_translateWithTable (table, NULL, inbuf, &inlen, outbuf,
+				 &outlen, NULL, NULL, NULL, NULL, NULL, 0);
+}
+
+static const louRuleCount *
+findRule (const louRuleProfile *profile, const char *fileName, int line)
+{
+  int k;
+  for (k = 0; k < profile->numRules; k++)
+    {
+      const char *name = profile->rules[k].fileName;
+      if (name && strlen (name) >= strlen (fileName)
+	  && !strcmp (name + strlen (name) - strlen (fileName), fileName)
+	  && profile->rules[k].line == line)
+	return &profile->rules[k];
+    }
+  return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+  const louTable *table;
+  const louRuleCount *rule;
+  louRuleProfile profile;
+  FILE *file;
+  int result = 0;
+  int k;
+
+  if (!(file = fopen (tableName, "w")))
+    {
+      printf ("%s could not be written\n", tableName);
+      return 1;
+    }
+  fputs ("include latinLetterDef6Dots.uti\n"
+	 "space \\s 0\n"
+	 "always the 1\n" "always th 12\n" "word me 14\n", file);
+  fclose (file);
+
+  /* Nothing is counted while profiling is off */
+  if (!(table = lou_openTable (tableName)) || !translate (table, "the theme"))
+    {
+      printf ("%s could not be used\n", tableName);
+      return 1;
+    }
+  if (lou_getRuleProfile (table, &profile))
+    {
+      printf ("A table was profiled while profiling was off\n");
+      result = 1;
+    }
+  lou_closeTable (table);
+  lou_free ();
+
+  lou_setRuleProfiling (1);
+  table = lou_openTable (tableName);
+  if (!translate (table, "the theme thin") || !translate (table, "the me"))
+    {
+      printf ("%s could not be used while profiling\n", tableName);
+      return 1;
+    }
+  if (!lou_getRuleProfile (table, &profile) || !profile.numRules)
+    {
+      printf ("No rules were profiled\n");
+      return 1;
+    }
+  for (k = 0; k < profile.numRules; k++)
+    {
+      if (profile.rules[k].applied > profile.rules[k].tried)
+	{
+	  printf ("%s:%d was applied %lu times but tried %lu times\n",
+		  profile.rules[k].fileName, profile.rules[k].line,
+		  profile.rules[k].applied, profile.rules[k].tried);
+	  result = 1;
+	}
+      if (k && profile.rules[k].tried > profile.rules[k - 1].tried)
+	{
+	  printf ("The rules are not sorted by how often they were tried\n");
+	  result = 1;
+	}
+    }
+  if (!(rule = findRule (&profile, tableName, 3)) || rule->applied != 3
+      || rule->opcode != CTO_Always)
+    {
+      printf ("always the was not counted at line 3 of %s\n", tableName);
+      result = 1;
+    }
+  if (!(rule = findRule (&profile, tableName, 4)) || rule->applied != 1)
+    {
+      printf ("always th was not counted at line 4 of %s\n", tableName);
+      result = 1;
+    }
+  if (!(rule = findRule (&profile, tableName, 5)) || rule->applied != 1
+      || rule->tried < 2)
+    {
+      printf ("word me was not counted at line 5 of %s\n", tableName);
+      result = 1;
+    }
+  for (k = 0; k < profile.numRules; k++)
+    if (profile.rules[k].fileName
+	&& strstr (profile.rules[k].fileName, "latinLetterDef6Dots.uti"))
+      break;
+  if (k == profile.numRules)
+    {
+      printf ("No rule of an included table was counted\n");
+      result = 1;
+    }
+  lou_freeRuleProfile (&profile);
+
+  /* Counts set back to 0 */
+  lou_resetRuleProfile (table);
+  if (!lou_getRuleProfile (table, &profile) || profile.numRules
+      || profile.selectTime != 0)
+    {
+      printf ("The counts were not set back to 0\n");
+      result = 1;
+    }
+  lou_freeRuleProfile (&profile);
+
+  lou_setRuleProfiling (0);
+  lou_closeTable (table);
+  lou_free ();
+  remove (tableName);
+  return result;
+}
@@ -0,0 +1,104 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that a context keeps the working buffers of a long translation
+   until it is given a scratch limit, and that with one it lets go of
+   them once each translation is done, without translating any
+   differently. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "liblouis.h"
+#include "louis.h"
+
+#define LONGTEXT 100000
+#define LIMIT 16384
+
+static const char *table = "en-us-g2.ctb";
+static widechar inbuf[LONGTEXT];
+static widechar before[2 * LONGTEXT];
+static widechar after[2 * LONGTEXT];
+
+static int
+translate (louContext * ctx, int length, widechar * outbuf, int *outlen)
+{
+  int inlen = length;
+  *outlen = 2 * length;
+  return lou_translateCtx (ctx, table, inbuf, &inlen, outbuf, outlen, NULL,
+			   NULL, NULL, NULL, NULL, 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  louContext *ctx = lou_createContext ();
+  louContextStats stats;
+  int beforelen, afterlen;
+  int k;
+  int result = 0;
+
+  for (k = 0; k < LONGTEXT; k++)
+    inbuf[k] = "the quick brown fox "[k % 20];
+  if (!translate (ctx, LONGTEXT, before, &beforelen))
+    {
+      printf ("%s could not be used\n", table);
+      return 1;
+    }
+  if (!lou_getContextStats (ctx, &stats)
+      || stats.scratchBytes < LONGTEXT * sizeof (widechar)
+      || stats.peakScratchBytes < stats.scratchBytes || stats.scratchShrinks)
+    {
+      printf ("The buffers of the translation were not kept: %lu bytes\n",
+	      stats.scratchBytes);
+      result = 1;
+    }
+
+  /* Setting a limit frees the big buffers at once */
+  lou_setScratchLimit (ctx, LIMIT);
+  lou_getContextStats (ctx, &stats);
+  if (stats.scratchBytes > 8 * LIMIT || !stats.scratchShrinks)
+    {
+      printf ("%lu bytes are kept over the limit\n", stats.scratchBytes);
+      result = 1;
+    }
+
+  /* And after each translation */
+  if (!translate (ctx, LONGTEXT, after, &afterlen))
+    result = 1;
+  else if (afterlen != beforelen
+	   || memcmp (before, after, beforelen * CHARSIZE))
+    {
+      printf ("The text translates differently with a scratch limit\n");
+      result = 1;
+    }
+  lou_getContextStats (ctx, &stats);
+  if (stats.scratchBytes > 8 * LIMIT
+      || stats.peakScratchBytes < LONGTEXT * sizeof (widechar))
+    {
+      printf ("%lu bytes are kept after a translation\n", stats.scratchBytes);
+      result = 1;
+    }
+
+  /* Short translations keep reusing their buffers */
+  translate (ctx, 20, after, &afterlen);
+  lou_getContextStats (ctx, &stats);
+  k = stats.scratchAllocs;
+  translate (ctx, 20, after, &afterlen);
+  lou_getContextStats (ctx, &stats);
+  if (stats.scratchAllocs != k || !stats.scratchBytes)
+    {
+      printf ("The buffers of short translations are not reused\n");
+      result = 1;
+    }
+
+  lou_freeContext (ctx);
+  if (lou_getContextStats (NULL, NULL))
+    result = 1;
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,133 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that with a compiled table path set, a table is stored there
+   once and mapped from there afterwards, and that it still translates
+   like a table compiled in memory. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#if defined(_WIN32) || !defined(HAVE_UNISTD_H)
+
+int
+main (int argc, char **argv)
+{
+  /* Skip the test */
+  return 77;
+}
+
+#else
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#define BUFSIZE 256
+
+static const char *table = "en-us-g2.ctb";
+static const char *dir = "sharedTables";
+static const char *text = "the quick brown fox jumps over the lazy dog";
+
+static int
+translate (widechar *inbuf, int inlen, widechar *outbuf, int *outlen)
+{
+  int k = inlen;
+  *outlen = BUFSIZE;
+  return lou_translate (table, inbuf, &k, outbuf, outlen, NULL, NULL,
+			NULL, NULL, NULL, 0);
+}
+
+static int
+findImage (char *name, struct stat *info)
+{
+/* Return the number of files in dir, and the last one in name. */
+  DIR *d;
+  struct dirent *entry;
+  int count = 0;
+  if (!(d = opendir (dir)))
+    return 0;
+  while ((entry = readdir (d)))
+    if (entry->d_name[0] != '.')
+      {
+	sprintf (name, "%s/%s", dir, entry->d_name);
+	count++;
+      }
+  closedir (d);
+  if (count && stat (name, info))
+    return 0;
+  return count;
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar inbuf[BUFSIZE];
+  widechar expected[BUFSIZE];
+  widechar outbuf[BUFSIZE];
+  int inlen, expectedlen, outlen;
+  char name[BUFSIZE];
+  struct stat first, second;
+  int result = 0;
+
+  inlen = extParseChars (text, inbuf);
+  if (!translate (inbuf, inlen, expected, &expectedlen))
+    {
+      printf ("Translation with %s failed\n", table);
+      return 1;
+    }
+  lou_free ();
+
+  mkdir (dir, 0777);
+  if (!lou_setCompiledTablePath (dir))
+    {
+      printf ("Cannot set the compiled table path\n");
+      return 1;
+    }
+  if (!translate (inbuf, inlen, outbuf, &outlen)
+      || outlen != expectedlen
+      || memcmp (outbuf, expected, outlen * sizeof (widechar)))
+    {
+      printf ("The shared table translates differently\n");
+      result = 1;
+    }
+  lou_free ();
+  if (findImage (name, &first) != 1)
+    {
+      printf ("Expected one image in %s\n", dir);
+      result = 1;
+    }
+
+  /* The second time the image is mapped, not written again. */
+  else if (!translate (inbuf, inlen, outbuf, &outlen)
+	   || outlen != expectedlen
+	   || memcmp (outbuf, expected, outlen * sizeof (widechar)))
+    {
+      printf ("The mapped table translates differently\n");
+      result = 1;
+    }
+  else if (findImage (name, &second) != 1 || first.st_ino != second.st_ino)
+    {
+      printf ("The image was written again\n");
+      result = 1;
+    }
+  lou_free ();
+
+  lou_setCompiledTablePath (NULL);
+  if (findImage (name, &first))
+    remove (name);
+  rmdir (dir);
+  return result;
+}
+
+#endif
@@ -0,0 +1,87 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that the swapcc, swapcd and swapdd opcodes find each of their
+   matches among many, and that each match is swapped for the
+   replacement in the same place, also when the replacements of a
+   swapdd rule are of more than one cell. The places of the cells of a
+   swapdd rule used to be counted as if the matches were replacements,
+   which read past the replacements after the first few. */
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+#define BUFSIZE 256
+
+static const char *table = "en-us-g1.ctb";
+
+static const char *rules[] = {
+  "swapcc rot abcdefghijklmnopqrstuvwxyzABC nopqrstuvwxyzabcdefghijklmXYZ",
+  "swapcd dropped 0123456789 356,2,23,25,256,26,235,2356,236,35",
+  "swapdd low 1,12,14,145,15,124,1245,125,24,245 "
+    "2,23,25-25,256,26,235,2356,236,35,356",
+  "swapdd up 2,23,25,256,26,235,2356,236,35,356 "
+    "1,12,14,145,15,124,1245,125,24,245",
+  "correct \"`\"[%rot1-8] %rot",
+  "context \"\\x00a7\"$d1-10 %dropped",
+  "pass2 @3456[%low1-3] %low",
+  "pass2 @6[%up1-5] %up",
+  "swapdd wide 1,12,14 4-4,45-45,456-456",
+  "pass2 @6[%wide1-3] %wide",
+};
+
+#define NUMRULES (sizeof (rules) / sizeof (rules[0]))
+
+static const char *texts[][2] = {
+  {"`hello `ABCxyz `zzz", ",huryyb ,h,,xyz,'klm ,hmm"},
+  {"a\\x00a7123 b\\x00a79 98 \\x00a70c", ";a123 ;b9 #98 0;c"},
+  {"23 \\x00a7567 4 \\x00a7123", "#233 567 #4 123"},
+  {"Abc Cab", ",``~~__ ,__``~~"},
+};
+
+#define NUMTEXTS (sizeof (texts) / sizeof (texts[0]))
+
+int
+main (int argc, char **argv)
+{
+  widechar inbuf[BUFSIZE];
+  widechar outbuf[BUFSIZE];
+  widechar expected[BUFSIZE];
+  int inlen, outlen, expectedlen;
+  int result = 0;
+  int i;
+
+  for (i = 0; i < NUMRULES; i++)
+    if (!lou_compileString (table, rules[i]))
+      {
+	printf ("Cannot add \"%s\" to %s\n", rules[i], table);
+	result = 1;
+      }
+  for (i = 0; i < NUMTEXTS; i++)
+    {
+      inlen = extParseChars (texts[i][0], inbuf);
+      expectedlen = extParseChars (texts[i][1], expected);
+      outlen = BUFSIZE;
+      if (!lou_translateString (table, inbuf, &inlen, outbuf, &outlen, NULL,
+				NULL, 0))
+	{
+	  printf ("Cannot translate \"%s\"\n", texts[i][0]);
+	  result = 1;
+	  continue;
+	}
+      if (outlen != expectedlen
+	  || memcmp (outbuf, expected, outlen * sizeof (widechar)))
+	{
+	  printf ("\"%s\" is not swapped as expected\n", texts[i][0]);
+	  result = 1;
+	}
+    }
+
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,61 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that the syllable rules gathered when a table is finished
+   keep contractions from crossing syllables, and that a syllable rule
+   added with lou_compileString is gathered too. */
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+#define BUFSIZE 128
+
+static const char *tableList = "en-us-g2.ctb";
+
+static int
+check (const char *text, const char *expected)
+{
+  widechar inbuf[BUFSIZE];
+  widechar outbuf[BUFSIZE];
+  widechar expectedbuf[BUFSIZE];
+  int inlen, outlen = BUFSIZE, expectedlen;
+  inlen = extParseChars (text, inbuf);
+  expectedlen = extParseChars (expected, expectedbuf);
+  if (lou_translateString (tableList, inbuf, &inlen, outbuf, &outlen,
+			   NULL, NULL, 0)
+      && outlen == expectedlen
+      && !memcmp (outbuf, expectedbuf, outlen * sizeof (widechar)))
+    return 0;
+  printf ("%s is not translated to %s\n", text, expected);
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  TranslationTableHeader *table;
+  int result = 0;
+  if (!(table = lou_getTable (tableList)) || !table->syllableRules
+      || !table->numSyllableRules)
+    {
+      printf ("%s has no syllable rules\n", tableList);
+      result = 1;
+    }
+  /* syllable bleed, syllable chand */
+  result |= check ("nosebleed merchandise", "noseble$ m}*&ise");
+  result |= check ("theater", "!at}");
+  if (!lou_compileString (tableList, "syllable eat 15-1-2345"))
+    {
+      printf ("Cannot add a rule to %s\n", tableList);
+      result = 1;
+    }
+  else
+    result |= check ("theater", "?eat}");
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,172 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that with a cap on the table cache the tables in no use are
+   evicted, least recently used first, that tables with open handles
+   are kept, that an evicted table is compiled again when it is asked
+   for, and that lists of the same files share one table. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "liblouis.h"
+#include "louis.h"
+
+#define BUFSIZE 256
+
+static int evictions;
+static char lastEvicted[BUFSIZE];
+
+static void
+countEvictions (int level, const char *message)
+{
+  if (strstr (message, "Evicting") == message)
+    {
+      evictions++;
+      strncpy (lastEvicted, message, BUFSIZE - 1);
+    }
+}
+
+static long
+tableSize (const char *tableList)
+{
+  const louTable *handle = lou_openTable (tableList);
+  louTableStats stats;
+  long size = 0;
+  if (handle && lou_getTableStats (handle, &stats))
+    size = stats.tableSize;
+  lou_closeTable (handle);
+  return size;
+}
+
+static int
+translate (const char *tableList, widechar * outbuf)
+{
+  widechar inbuf[BUFSIZE];
+  int inlen = extParseChars ("Quickly, the brown fox jumped over 42 dogs",
+			     inbuf);
+  int outlen = BUFSIZE;
+  if (!lou_translateString (tableList, inbuf, &inlen, outbuf, &outlen, NULL,
+			    NULL, 0))
+    return 0;
+  return outlen;
+}
+
+static int
+translatesAsBefore (const char *tableList, const widechar * before,
+		    int beforeLength)
+{
+  widechar outbuf[BUFSIZE];
+  int outlen = translate (tableList, outbuf);
+  if (outlen != beforeLength
+      || memcmp (outbuf, before, outlen * sizeof (widechar)))
+    {
+      printf ("%s translates differently after being evicted\n", tableList);
+      return 0;
+    }
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar g1[BUFSIZE], g2[BUFSIZE], comp6[BUFSIZE];
+  int g1len, g2len, comp6len;
+  long total = 0;
+  const louTable *handle;
+  const louTable *same;
+  void *pinned;
+  char **files;
+  int result = 0;
+
+  lou_registerLogCallback (countEvictions);
+  lou_setLogLevel (LOG_DEBUG);
+  if (!(handle = lou_openTable ("en-us-g1.ctb"))
+      || !(g1len = translate ("en-us-g1.ctb", g1))
+      || !(g2len = translate ("en-us-g2.ctb", g2)))
+    {
+      printf ("The tables could not be compiled\n");
+      return 1;
+    }
+
+  /* Every table in no use goes, but not the one with a handle */
+  evictions = 0;
+  lou_setTableCacheSize (1);
+  if (evictions != 1)
+    {
+      printf ("%d tables were evicted instead of 1\n", evictions);
+      result = 1;
+    }
+  if (!translatesAsBefore ("en-us-g2.ctb", g2, g2len)
+      || !(comp6len = translate ("it-it-comp6.utb", comp6)))
+    result = 1;
+  if (evictions != 2)
+    {
+      printf ("en-us-g2.ctb was not evicted for it-it-comp6.utb\n");
+      result = 1;
+    }
+  if (lou_openTable ("en-us-g1.ctb") != handle
+      || !translatesAsBefore ("en-us-g1.ctb", g1, g1len))
+    {
+      printf ("en-us-g1.ctb was evicted while open\n");
+      result = 1;
+    }
+  lou_closeTable (handle);
+
+  /* The least recently used goes first */
+  lou_closeTable (handle);
+  lou_setTableCacheSize (0);
+  if (!translatesAsBefore ("en-us-g2.ctb", g2, g2len)
+      || !(total = tableSize ("en-us-g1.ctb") + tableSize ("en-us-g2.ctb")
+	   + tableSize ("it-it-comp6.utb")))
+    result = 1;
+  lou_setTableCacheSize (total);
+  if (!translatesAsBefore ("en-us-g1.ctb", g1, g1len)
+      || !translatesAsBefore ("it-it-comp6.utb", comp6, comp6len)
+      || !translatesAsBefore ("en-us-g2.ctb", g2, g2len))
+    result = 1;
+  evictions = 0;
+  lou_setTableCacheSize (total - 1);
+  if (evictions != 1 || !strstr (lastEvicted, "en-us-g1.ctb"))
+    {
+      printf ("%d tables were evicted, the last one by '%s'\n", evictions,
+	      lastEvicted);
+      result = 1;
+    }
+
+  /* Another name for the same file shares its table */
+  files = resolveTable ("en-us-g1.ctb", NULL);
+  handle = lou_openTable ("en-us-g1.ctb");
+  same = files ? lou_openTable (files[0]) : NULL;
+  if (same != handle)
+    {
+      printf ("%s has a table of its own\n", files ? files[0] : "nothing");
+      result = 1;
+    }
+  lou_closeTable (handle);
+  lou_closeTable (same);
+  if (files)
+    {
+      free (files[0]);
+      free (files);
+    }
+
+  /* A table from lou_getTable is never evicted */
+  lou_setTableCacheSize (0);
+  pinned = lou_getTable ("it-it-comp6.utb");
+  lou_setTableCacheSize (1);
+  if (lou_getTable ("it-it-comp6.utb") != pinned
+      || !translatesAsBefore ("it-it-comp6.utb", comp6, comp6len))
+    {
+      printf ("A table from lou_getTable was evicted\n");
+      result = 1;
+    }
+
+  lou_setTableCacheSize (0);
+  lou_free ();
+  return result;
+}
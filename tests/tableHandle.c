@@ -0,0 +1,124 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that the functions taking a table handle give the same results
+   as the ones taking a table list. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#define BUFSIZE 256
+
+static int
+compare (const char *what, widechar *expected, int expectedlen,
+	 widechar *received, int receivedlen)
+{
+  if (expectedlen != receivedlen
+      || memcmp (expected, received, expectedlen * sizeof (widechar)))
+    {
+      printf ("%s with a handle differs from using the table list\n", what);
+      return 1;
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *tableList = "da-dk-g26.ctb";
+  const char *text = "achena er en lille frugt";
+  widechar inbuf[BUFSIZE];
+  widechar expected[BUFSIZE];
+  widechar outbuf[BUFSIZE];
+  char hyphens[BUFSIZE];
+  char expectedHyphens[BUFSIZE];
+  int inlen, expectedlen, outlen, k;
+  louTable *table;
+  louContext *ctx;
+  int result = 0;
+
+#if OFFSETBITS == 16
+  /* da-dk-g26 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  inlen = extParseChars (text, inbuf);
+  if (!(table = lou_openTable (tableList)))
+    {
+      printf ("Cannot open %s\n", tableList);
+      return 1;
+    }
+  if (lou_openTable (tableList) != table)
+    {
+      printf ("Opening a table twice gives different handles\n");
+      result = 1;
+    }
+  if (lou_openTable ("nonexistent.ctb"))
+    {
+      printf ("Opening a missing table succeeded\n");
+      result = 1;
+    }
+  ctx = lou_createContext ();
+
+  k = inlen;
+  expectedlen = BUFSIZE;
+  lou_translate (tableList, inbuf, &k, expected, &expectedlen, NULL, NULL,
+		 NULL, NULL, NULL, 0);
+  k = inlen;
+  outlen = BUFSIZE;
+  if (!lou_translateWithTable (table, ctx, inbuf, &k, outbuf, &outlen, NULL,
+			       NULL, NULL, NULL, NULL, 0))
+    result = 1;
+  result |= compare ("Translation", expected, expectedlen, outbuf, outlen);
+
+  memcpy (inbuf, expected, expectedlen * sizeof (widechar));
+  inlen = expectedlen;
+  k = inlen;
+  expectedlen = BUFSIZE;
+  lou_backTranslate (tableList, inbuf, &k, expected, &expectedlen, NULL,
+		     NULL, NULL, NULL, NULL, 0);
+  k = inlen;
+  outlen = BUFSIZE;
+  if (!lou_backTranslateWithTable (table, NULL, inbuf, &k, outbuf, &outlen,
+				   NULL, NULL, NULL, NULL, NULL, 0))
+    result = 1;
+  result |= compare ("Back-translation", expected, expectedlen, outbuf,
+		     outlen);
+
+  lou_charToDots (tableList, expected, inbuf, expectedlen, 0);
+  if (!lou_charToDotsWithTable (table, expected, outbuf, expectedlen, 0))
+    result = 1;
+  result |= compare ("lou_charToDots", inbuf, expectedlen, outbuf,
+		     expectedlen);
+  lou_dotsToChar (tableList, inbuf, expected, expectedlen, 0);
+  if (!lou_dotsToCharWithTable (table, inbuf, outbuf, expectedlen, 0))
+    result = 1;
+  result |= compare ("lou_dotsToChar", expected, expectedlen, outbuf,
+		     expectedlen);
+
+  inlen = extParseChars ("achena", inbuf);
+  if (!lou_hyphenate (tableList, inbuf, inlen, expectedHyphens, 0)
+      || !lou_hyphenateWithTable (table, inbuf, inlen, hyphens, 0)
+      || strcmp (hyphens, expectedHyphens))
+    {
+      printf ("Hyphenation with a handle differs from using the table list\n");
+      result = 1;
+    }
+
+  if (lou_translateWithTable (NULL, ctx, inbuf, &k, outbuf, &outlen, NULL,
+			      NULL, NULL, NULL, NULL, 0))
+    {
+      printf ("Translation with a NULL handle succeeded\n");
+      result = 1;
+    }
+
+  lou_freeContext (ctx);
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,101 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that the statistics of a table add up. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+static int
+sumChains (const int *histogram)
+{
+  int sum = 0;
+  int k;
+  for (k = 0; k < LOU_CHAINLENGTHS; k++)
+    sum += histogram[k];
+  return sum;
+}
+
+int
+main (int argc, char **argv)
+{
+  louTable *handle;
+  louTableStats stats;
+  TranslationTableHeader *table;
+  int result = 0;
+  int numRules;
+  int always = -1;
+  int k;
+
+  if (lou_getTableStats (NULL, &stats))
+    {
+      printf ("Statistics for no table\n");
+      result = 1;
+    }
+  if (!(handle = lou_openTable ("en-us-g2.ctb"))
+      || !lou_getTableStats (handle, &stats))
+    {
+      printf ("Cannot get the statistics of en-us-g2.ctb\n");
+      return 1;
+    }
+  numRules = stats.otherRules;
+  for (k = 0; k < LOU_OPCODES; k++)
+    {
+      numRules += stats.ruleCounts[k];
+      if (lou_getOpcodeName (k) && strcmp (lou_getOpcodeName (k),
+					   "always") == 0)
+	always = k;
+    }
+  if (numRules != stats.numRules || stats.numRules < 1000)
+    {
+      printf ("The rule counts add up to %d of %d rules\n", numRules,
+	      stats.numRules);
+      result = 1;
+    }
+  if (always < 0 || stats.ruleCounts[always] == 0)
+    {
+      printf ("No always rules were counted\n");
+      result = 1;
+    }
+  if (lou_getOpcodeName (-1) || lou_getOpcodeName (LOU_OPCODES))
+    {
+      printf ("Names for opcodes that do not exist\n");
+      result = 1;
+    }
+  table = lou_getTable ("en-us-g2.ctb");
+  if (!table->forRuleBuckets
+      || sumChains (stats.forRuleChains) != 1 << table->forRuleHashBits
+      || sumChains (stats.backRuleChains) != HASHNUM
+      || stats.longestForRuleChain == 0
+      || stats.longestCharacterChain == 0)
+    {
+      printf ("The chain histograms are wrong\n");
+      result = 1;
+    }
+  if (stats.bytesUsed <= 0 || stats.bytesUsed > stats.tableSize
+      || stats.compileTime < 0)
+    {
+      printf ("The sizes of the table are wrong\n");
+      result = 1;
+    }
+  if (stats.hyphenStates != 0)
+    {
+      printf ("en-us-g2.ctb has no hyphenation patterns\n");
+      result = 1;
+    }
+  if (!(handle = lou_openTable ("en-us-g1.ctb,hyph_en_US.dic"))
+      || !lou_getTableStats (handle, &stats) || stats.hyphenStates == 0
+      || stats.hyphenTransitions < stats.hyphenStates - 1)
+    {
+      printf ("The hyphenation states were not counted\n");
+      result = 1;
+    }
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,144 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that no trace events are recorded while tracing is off, that
+   translation and back-translation record where they begin and end,
+   their passes and the rules they apply, that taking the events empties
+   the buffer, and that events dropped for want of room are counted. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "liblouis.h"
+#include "louis.h"
+
+static const char *table = "en-us-g2.ctb";
+
+static int
+translate (const char *text, int backward)
+{
+  widechar inbuf[100];
+  widechar outbuf[200];
+  int inlen = extParseChars (text, inbuf);
+  int outlen = 200;
+  if (backward)
+    return lou_backTranslateString (table, inbuf, &inlen, outbuf, &outlen,
+				    NULL, NULL, 0);
+  return lou_translateString (table, inbuf, &inlen, outbuf, &outlen, NULL,
+			      NULL, 0);
+}
+
+static int
+checkEvents (const louTraceEvent *events, int count, int backward,
+	     int inlen)
+{
+  int k;
+  int passes = 0, rules = 0;
+  if (count < 2 || events[0].kind != louTraceStart
+      || events[count - 1].kind != louTraceEnd)
+    {
+      printf ("The events do not begin with a start and end with an end\n");
+      return 0;
+    }
+  if (events[0].src != inlen || events[count - 1].value != 1)
+    {
+      printf ("The start or end event has the wrong values\n");
+      return 0;
+    }
+  for (k = 0; k < count; k++)
+    {
+      if (events[k].backward != backward)
+	{
+	  printf ("An event is marked with the wrong direction\n");
+	  return 0;
+	}
+      if (k && events[k].time < events[k - 1].time)
+	{
+	  printf ("The events are not in order of time\n");
+	  return 0;
+	}
+      if (events[k].kind == louTracePass)
+	passes++;
+      else if (events[k].kind == louTraceRule)
+	{
+	  if (lou_getOpcodeName (events[k].value) == NULL)
+	    {
+	      printf ("A rule event has no opcode\n");
+	      return 0;
+	    }
+	  rules++;
+	}
+    }
+  if (!passes || !rules)
+    {
+      printf ("%d passes and %d rules were traced\n", passes, rules);
+      return 0;
+    }
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  static louTraceEvent events[5000];
+  unsigned long dropped;
+  int count, k;
+  int result = 0;
+
+  /* Nothing is recorded while tracing is off */
+  if (!translate ("the cat", 0))
+    {
+      printf ("%s could not be used\n", table);
+      return 1;
+    }
+  if (lou_takeTraceEvents (events, 5000, &dropped) || dropped)
+    {
+      printf ("Events were recorded while tracing was off\n");
+      result = 1;
+    }
+
+  lou_setTraceEvents (1);
+  translate ("the cat", 0);
+  count = lou_takeTraceEvents (events, 5000, &dropped);
+  if (!checkEvents (events, count, 0, 7) || dropped)
+    result = 1;
+  if (lou_takeTraceEvents (events, 5000, NULL))
+    {
+      printf ("Taking the events did not empty the buffer\n");
+      result = 1;
+    }
+  translate ("! cat", 1);
+  count = lou_takeTraceEvents (events, 5000, &dropped);
+  if (!checkEvents (events, count, 1, 5))
+    result = 1;
+
+  /* Events of many translations do not fit */
+  for (k = 0; k < 1000; k++)
+    translate ("the cat", 0);
+  count = lou_takeTraceEvents (events, 5000, &dropped);
+  if (count != 4096 || !dropped)
+    {
+      printf ("%d events were kept and %lu dropped\n", count, dropped);
+      result = 1;
+    }
+  lou_takeTraceEvents (events, 5000, &dropped);
+  if (dropped)
+    {
+      printf ("The dropped events were not set back to 0\n");
+      result = 1;
+    }
+
+  lou_setTraceEvents (0);
+  translate ("the cat", 0);
+  if (lou_takeTraceEvents (events, 5000, NULL))
+    {
+      printf ("Events were recorded after tracing was turned off\n");
+      result = 1;
+    }
+  lou_free ();
+  return result;
+}
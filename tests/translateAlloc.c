@@ -0,0 +1,193 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that lou_translateAlloc and lou_backTranslateAlloc give the
+   same output, positions and cursor as lou_translateWithTable and
+   lou_backTranslateWithTable with a buffer large enough, in buffers
+   got from the allocator of just the size of the output, also when the
+   output is many times longer than the input. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "liblouis.h"
+#include "louis.h"
+
+#define BUFSIZE 40000
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "de-de-g2.ctb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static const char *text =
+  "The quick brown fox, 123 jumps over the lazy dog! \\x00fcber Stra\\x00dfe";
+
+static const char *overText = "r >i<--J";
+static const char *underCells = ";r  .1 ;i \"k ---;,j";
+
+typedef struct
+{
+  int calls;
+  int sizes[2];
+} Allocations;
+
+static void *
+allocate (int size, void *data)
+{
+  Allocations *allocations = data;
+  if (allocations->calls < 2)
+    allocations->sizes[allocations->calls] = size;
+  allocations->calls++;
+  return malloc (size);
+}
+
+static int
+check (const louTable *table, const char *name, const widechar *inbuf,
+       int inlen, int backward)
+{
+  static widechar expected[BUFSIZE];
+  static int expectedInputPos[BUFSIZE], expectedOutputPos[BUFSIZE];
+  static int outputPos[BUFSIZE];
+  Allocations allocations;
+  widechar *outbuf = NULL;
+  int *inputPos = NULL;
+  int length = inlen, expectedlen = BUFSIZE, outlen = -1;
+  int expectedCursor = inlen / 2, cursor = inlen / 2;
+  int result = 0;
+  const char *what = backward ? "back-translation" : "translation";
+  if (!(backward ? lou_backTranslateWithTable : lou_translateWithTable)
+      (table, NULL, inbuf, &length, expected, &expectedlen, NULL, NULL,
+       expectedOutputPos, expectedInputPos, &expectedCursor, 0)
+      || length != inlen)
+    {
+      printf ("%s: no complete %s\n", name, what);
+      return 1;
+    }
+  memset (&allocations, 0, sizeof (allocations));
+  if (!(backward ? lou_backTranslateAlloc : lou_translateAlloc)
+      (table, NULL, inbuf, inlen, &outbuf, &outlen, outputPos, &inputPos,
+       &cursor, 0, allocate, &allocations))
+    {
+      printf ("%s: no %s with an allocator\n", name, what);
+      return 1;
+    }
+  if (outlen != expectedlen
+      || memcmp (outbuf, expected, outlen * sizeof (widechar))
+      || outbuf[outlen] != 0
+      || memcmp (inputPos, expectedInputPos, outlen * sizeof (int))
+      || memcmp (outputPos, expectedOutputPos, inlen * sizeof (int))
+      || cursor != expectedCursor)
+    {
+      printf ("%s: the %s with an allocator differs\n", name, what);
+      result = 1;
+    }
+  if (allocations.calls != 2
+      || allocations.sizes[0] != (outlen + 1) * sizeof (widechar)
+      || allocations.sizes[1] != (outlen + 1) * sizeof (int))
+    {
+      printf ("%s: the %s allocates %d buffers, of %d and %d bytes\n",
+	      name, what, allocations.calls, allocations.sizes[0],
+	      allocations.sizes[1]);
+      result = 1;
+    }
+  free (outbuf);
+  free (inputPos);
+  return result;
+}
+
+static int
+checkMathtext (const char *chars, int backward)
+{
+/* The output with an allocator is the one without it, whatever input 
+   is reported consumed */
+  static widechar inbuf[BUFSIZE], expected[BUFSIZE];
+  const char *name = "en-us-mathtext.ctb";
+  const char *what = backward ? "back-translation" : "translation";
+  widechar *outbuf;
+  int inlen, length, expectedlen = BUFSIZE, outlen;
+  int result = 0;
+  length = inlen = extParseChars (chars, inbuf);
+  if (!(backward ? lou_backTranslateString : lou_translateString)
+      (name, inbuf, &length, expected, &expectedlen, NULL, NULL, 0))
+    {
+      printf ("%s: no %s\n", name, what);
+      return 1;
+    }
+  if (!(backward ? lou_backTranslateAlloc : lou_translateAlloc)
+      (lou_openTable (name), NULL, inbuf, inlen, &outbuf, &outlen, NULL,
+       NULL, NULL, 0, NULL, NULL))
+    {
+      printf ("%s: no %s with an allocator\n", name, what);
+      return 1;
+    }
+  if (outlen != expectedlen
+      || memcmp (outbuf, expected, outlen * sizeof (widechar)))
+    {
+      printf ("%s: the %s with an allocator differs\n", name, what);
+      result = 1;
+    }
+  free (outbuf);
+  return result;
+}
+
+int
+main (int argc, char **argv)
+{
+  static widechar inbuf[BUFSIZE], cells[BUFSIZE];
+  const louTable *table;
+  widechar *outbuf;
+  int inlen, cellslen, outlen;
+  int result = 0;
+  int i, k;
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      if (!(table = lou_openTable (tables[i])))
+	{
+	  printf ("%s could not be opened\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      inlen = extParseChars (text, inbuf);
+      result |= check (table, tables[i], inbuf, inlen, 0);
+      cellslen = BUFSIZE;
+      lou_translateWithTable (table, NULL, inbuf, &inlen, cells, &cellslen,
+			      NULL, NULL, NULL, NULL, NULL, 0);
+      result |= check (table, tables[i], cells, cellslen, 1);
+      /* Undefined characters come out as escapes many cells long */
+      for (k = 0; k < 3000; k++)
+	inbuf[k] = 0x4e00 + k;
+      result |= check (table, tables[i], inbuf, 3000, 0);
+    }
+
+  /* en-us-mathtext reports more of this input consumed than there is, 
+     and back-translates only part of its translation */
+  result |= checkMathtext (overText, 0);
+  result |= checkMathtext (underCells, 1);
+
+  /* Without an allocator the buffer is got from malloc */
+  inlen = extParseChars (text, inbuf);
+  if (!lou_translateAlloc (lou_openTable (tables[0]), NULL, inbuf, inlen,
+			   &outbuf, &outlen, NULL, NULL, NULL, 0, NULL, NULL))
+    {
+      printf ("No translation without an allocator\n");
+      result = 1;
+    }
+  else
+    free (outbuf);
+
+  lou_free ();
+  return result;
+}
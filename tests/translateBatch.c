@@ -0,0 +1,86 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that lou_translateBatch gives the same results as translating
+   each string on its own, and that it stops when the output is full. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#define BUFSIZE 1024
+#define COUNT 4
+
+static const char *tableList = "en-us-g2.ctb";
+
+int
+main (int argc, char **argv)
+{
+  const char *strings[COUNT] = {
+    "Hello world",
+    "the quick brown fox",
+    "",
+    "jumps over the lazy dog",
+  };
+  widechar inbuf[BUFSIZE];
+  int inOffsets[COUNT], inLengths[COUNT];
+  widechar expected[COUNT][BUFSIZE];
+  int expectedlen[COUNT];
+  widechar outbuf[BUFSIZE];
+  int outOffsets[COUNT], outLengths[COUNT];
+  louTable *table;
+  int result = 0;
+  int i, k, used = 0;
+
+  if (!(table = lou_openTable (tableList)))
+    return 1;
+  for (i = 0; i < COUNT; i++)
+    {
+      inOffsets[i] = used;
+      inLengths[i] = extParseChars (strings[i], &inbuf[used]);
+      used += inLengths[i];
+      k = inLengths[i];
+      expectedlen[i] = BUFSIZE;
+      if (!lou_translate (tableList, &inbuf[inOffsets[i]], &k, expected[i],
+			  &expectedlen[i], NULL, NULL, NULL, NULL, NULL, 0))
+	{
+	  printf ("Translation of '%s' failed\n", strings[i]);
+	  return 1;
+	}
+    }
+
+  if (lou_translateBatch (table, NULL, COUNT, inbuf, inOffsets, inLengths,
+			  NULL, outbuf, BUFSIZE, outOffsets, outLengths,
+			  0) != COUNT)
+    {
+      printf ("The batch was not translated completely\n");
+      return 1;
+    }
+  for (i = 0; i < COUNT; i++)
+    if (outLengths[i] != expectedlen[i]
+	|| memcmp (&outbuf[outOffsets[i]], expected[i],
+		   expectedlen[i] * sizeof (widechar))
+	|| (i > 0 && outOffsets[i] != outOffsets[i - 1] + outLengths[i - 1]))
+      {
+	printf ("Batch translation of '%s' differs\n", strings[i]);
+	result = 1;
+      }
+
+  /* Leave room for the first three strings (the third is empty) but
+     not for the fourth */
+  k = expectedlen[0] + expectedlen[1] + 2;
+  if (lou_translateBatch (table, NULL, COUNT, inbuf, inOffsets, inLengths,
+			  NULL, outbuf, k, outOffsets, outLengths, 0) != 3)
+    {
+      printf ("A full output arena was not reported\n");
+      result = 1;
+    }
+
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,191 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that lou_translateBatchParallel gives the same results as
+   lou_translateBatch, whatever the number of threads, also for strings
+   translated many times longer, and that neither changes the typeforms
+   passed to it. Both rely on lou_translateString not counting undefined
+   characters it had no room for as translated. A string whose
+   translation exactly fills the room first tried for it must be
+   translated again with more room, not cut short. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#define COUNT 500
+#define INSIZE (COUNT * 64)
+#define OUTSIZE (COUNT * 128)
+#define GREEKCOUNT 64
+
+static const char *tableList = "en-us-g2.ctb";
+static const char *greekTable = "ru-litbrl.ctb";
+
+static const char *words[] = {
+  "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+  "and", "with", "knowledge", "braille", "translation", "123",
+};
+
+static widechar inbuf[INSIZE];
+static formtype typeform[INSIZE];
+static formtype typeformCopy[INSIZE];
+static int inOffsets[COUNT], inLengths[COUNT];
+static widechar expected[OUTSIZE];
+static int expectedOffsets[COUNT], expectedLengths[COUNT];
+static widechar outbuf[OUTSIZE];
+static int outOffsets[COUNT], outLengths[COUNT];
+
+static int
+check (const char *what, int got, int wanted)
+{
+  int i;
+  if (got != wanted)
+    {
+      printf ("%s translated %d strings instead of %d\n", what, got, wanted);
+      return 1;
+    }
+  for (i = 0; i < got; i++)
+    if (outOffsets[i] != expectedOffsets[i]
+	|| outLengths[i] != expectedLengths[i]
+	|| memcmp (&outbuf[outOffsets[i]], &expected[expectedOffsets[i]],
+		   outLengths[i] * sizeof (widechar)))
+      {
+	printf ("%s gave a different translation of string %d\n", what, i);
+	return 1;
+      }
+  if (memcmp (typeform, typeformCopy, sizeof (typeform)))
+    {
+      printf ("%s changed the typeforms\n", what);
+      return 1;
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  char text[64];
+  louTable *table;
+  louTable *greek;
+  louContext *ctx;
+  int threads[] = { 1, 2, 4, 0 };
+  int result = 0;
+  int i, k, n, used = 0, outUsed;
+  int inlen, outlen;
+
+  if (!(table = lou_openTable (tableList)))
+    return 1;
+  /* Strings of different lengths, so the workers get uneven loads */
+  for (i = 0; i < COUNT; i++)
+    {
+      text[0] = 0;
+      for (n = 0; n <= (i * 7) % 9; n++)
+	{
+	  if (n)
+	    strcat (text, " ");
+	  strcat (text, words[(i + n * 5) % (sizeof (words) / sizeof (*words))]);
+	}
+      inOffsets[i] = used;
+      inLengths[i] = extParseChars (text, &inbuf[used]);
+      /* Undefined characters, whose escapes are many cells long */
+      if (i % 50 == 49)
+	for (inLengths[i] = 0; inLengths[i] < 40; inLengths[i]++)
+	  inbuf[used + inLengths[i]] = 0x4e00 + inLengths[i];
+      for (k = 0; k < inLengths[i]; k++)
+	typeform[used + k] = (i % 3 == 0) ? italic : plain_text;
+      used += inLengths[i];
+    }
+  memcpy (typeformCopy, typeform, sizeof (typeform));
+
+  ctx = lou_createContext ();
+  if (lou_translateBatch (table, ctx, COUNT, inbuf, inOffsets, inLengths,
+			  typeform, expected, OUTSIZE, expectedOffsets,
+			  expectedLengths, 0) != COUNT)
+    {
+      printf ("The batch was not translated completely\n");
+      return 1;
+    }
+  if (memcmp (typeform, typeformCopy, sizeof (typeform)))
+    {
+      printf ("lou_translateBatch changed the typeforms\n");
+      result = 1;
+    }
+  lou_freeContext (ctx);
+
+  for (i = 0; i < sizeof (threads) / sizeof (*threads); i++)
+    {
+      sprintf (text, "%d threads", threads[i]);
+      result |= check (text,
+		       lou_translateBatchParallel (table, threads[i], COUNT,
+						   inbuf, inOffsets,
+						   inLengths, typeform, outbuf,
+						   OUTSIZE, outOffsets,
+						   outLengths, 0), COUNT);
+    }
+
+  /* Stop after the first 100 strings */
+  outUsed = expectedOffsets[100] + expectedLengths[100] - 1;
+  result |= check ("A full output buffer",
+		   lou_translateBatchParallel (table, 4, COUNT, inbuf,
+					       inOffsets, inLengths, typeform,
+					       outbuf, outUsed, outOffsets,
+					       outLengths, 0), 100);
+
+  /* Only "ab " fits, so the undefined characters after it, which count
+     as spaces, must not be skipped */
+  inlen = extParseChars ("ab \\x4e00\\x4e01 c", inbuf);
+  outlen = 10;
+  if (!lou_translateString (tableList, inbuf, &inlen, outbuf, &outlen,
+			    NULL, NULL, 0) || inlen != 3)
+    {
+      printf ("%d characters were counted as translated instead of 3\n",
+	      inlen);
+      result = 1;
+    }
+
+  /* Greek letters, undefined in the table, each make an escape of many 
+     cells, so that for some of the lengths the translation exactly 
+     fills the room first tried for it */
+  if (!(greek = lou_openTable (greekTable)))
+    return 1;
+  for (i = 0; i < GREEKCOUNT; i++)
+    inbuf[i] = 0x3b1 + i % 24;
+  for (i = 0; i < GREEKCOUNT; i++)
+    {
+      inOffsets[i] = 0;
+      inLengths[i] = i + 1;
+      inlen = i + 1;
+      outlen = OUTSIZE / GREEKCOUNT;
+      expectedOffsets[i] = i * outlen;
+      if (!lou_translateString (greekTable, inbuf, &inlen,
+				&expected[expectedOffsets[i]], &outlen, NULL,
+				NULL, 0))
+	return 1;
+      expectedLengths[i] = outlen;
+    }
+  for (i = 0; i < sizeof (threads) / sizeof (*threads); i++)
+    {
+      n = lou_translateBatchParallel (greek, threads[i], GREEKCOUNT, inbuf,
+				      inOffsets, inLengths, NULL, outbuf,
+				      OUTSIZE, outOffsets, outLengths, 0);
+      for (k = 0; k < n; k++)
+	if (outLengths[k] != expectedLengths[k]
+	    || memcmp (&outbuf[outOffsets[k]], &expected[expectedOffsets[k]],
+		       outLengths[k] * sizeof (widechar)))
+	  break;
+      if (n != GREEKCOUNT || k < n)
+	{
+	  printf ("The Greek letters were not translated in full with "
+		  "%d threads\n", threads[i]);
+	  result = 1;
+	}
+    }
+
+  lou_free ();
+  return result;
+}
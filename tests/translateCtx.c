@@ -0,0 +1,122 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that translations done with explicit contexts give the same
+   results as the functions using the default context, also when
+   calls with different contexts are interleaved. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#define BUFSIZE 256
+
+static const char *table = "en-us-g2.ctb";
+
+static int
+compare (const char *what, const char *str, widechar *expected,
+	 int expectedlen, widechar *received, int receivedlen)
+{
+  if (expectedlen != receivedlen
+      || memcmp (expected, received, expectedlen * sizeof (widechar)))
+    {
+      printf ("%s of '%s' differs from the default context\n", what, str);
+      return 1;
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *strings[] = {
+    "Hello world",
+    "the quick brown fox jumps over the lazy dog",
+  };
+  widechar inbuf[2][BUFSIZE];
+  int inlen[2];
+  widechar expected[2][BUFSIZE];
+  int expectedlen[2];
+  widechar backExpected[2][BUFSIZE];
+  int backExpectedlen[2];
+  widechar outbuf[2][BUFSIZE];
+  int outlen[2];
+  louContext *ctx[2];
+  int result = 0;
+  int i, k;
+
+  for (i = 0; i < 2; i++)
+    {
+      inlen[i] = extParseChars (strings[i], inbuf[i]);
+      k = inlen[i];
+      expectedlen[i] = BUFSIZE;
+      if (!lou_translate (table, inbuf[i], &k, expected[i],
+			  &expectedlen[i], NULL, NULL, NULL, NULL, NULL, 0))
+	{
+	  printf ("Translation of '%s' failed\n", strings[i]);
+	  return 1;
+	}
+      k = expectedlen[i];
+      backExpectedlen[i] = BUFSIZE;
+      if (!lou_backTranslate (table, expected[i], &k, backExpected[i],
+			      &backExpectedlen[i], NULL, NULL, NULL, NULL,
+			      NULL, 0))
+	{
+	  printf ("Back-translation of '%s' failed\n", strings[i]);
+	  return 1;
+	}
+      ctx[i] = lou_createContext ();
+    }
+
+  /* Interleave the calls so that each context keeps its own buffers. */
+  for (i = 0; i < 2; i++)
+    {
+      k = inlen[i];
+      outlen[i] = BUFSIZE;
+      if (!lou_translateCtx (ctx[i], table, inbuf[i], &k, outbuf[i],
+			     &outlen[i], NULL, NULL, NULL, NULL, NULL, 0))
+	{
+	  printf ("Translation of '%s' with a context failed\n", strings[i]);
+	  result = 1;
+	}
+    }
+  for (i = 0; i < 2; i++)
+    result |= compare ("Translation", strings[i], expected[i],
+		       expectedlen[i], outbuf[i], outlen[i]);
+
+  for (i = 0; i < 2; i++)
+    {
+      k = expectedlen[i];
+      outlen[i] = BUFSIZE;
+      if (!lou_backTranslateCtx (ctx[1 - i], table, expected[i], &k,
+				 outbuf[i], &outlen[i], NULL, NULL, NULL,
+				 NULL, NULL, 0))
+	{
+	  printf ("Back-translation of '%s' with a context failed\n",
+		  strings[i]);
+	  result = 1;
+	}
+    }
+  for (i = 0; i < 2; i++)
+    result |= compare ("Back-translation", strings[i], backExpected[i],
+		       backExpectedlen[i], outbuf[i], outlen[i]);
+
+  k = inlen[0];
+  outlen[0] = BUFSIZE;
+  if (lou_translateCtx (NULL, table, inbuf[0], &k, outbuf[0], &outlen[0],
+			NULL, NULL, NULL, NULL, NULL, 0))
+    {
+      printf ("Translation with a NULL context succeeded\n");
+      result = 1;
+    }
+
+  for (i = 0; i < 2; i++)
+    lou_freeContext (ctx[i]);
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,124 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that the hyphens lou_translateHyphenated puts in the braille of
+   a text are those lou_hyphenate finds in the braille of each word,
+   that in contracted braille they only come before a cell starting a
+   syllable and never inside a contraction, and that a table without
+   patterns is refused. */
+
+#include <stdio.h>
+#include <string.h>
+#include "liblouis.h"
+#include "louis.h"
+
+#define BUFSIZE 2048
+
+static const char *text =
+  "the internationalization of hyphenation mechanically together "
+  "information computer supercalifragilistic words";
+
+static int
+checkWords (const char *table, const widechar * inbuf, int inlen)
+{
+  widechar outbuf[BUFSIZE];
+  widechar word[BUFSIZE];
+  char hyphens[BUFSIZE];
+  char wordHyphens[BUFSIZE + 1];
+  int inputPos[BUFSIZE];
+  int outlen = BUFSIZE;
+  int wordStart, cell, wordlen, k;
+  if (!lou_translateHyphenated (table, inbuf, &inlen, outbuf, &outlen,
+				NULL, NULL, NULL, inputPos, NULL, hyphens, 0))
+    {
+      printf ("%s cannot translate with hyphens\n", table);
+      return 1;
+    }
+  for (cell = 0; cell < outlen; cell = k + 1)
+    {
+      wordStart = cell;
+      for (k = cell; k < outlen && inbuf[inputPos[k]] != ' '; k++);
+      wordlen = k - wordStart;
+      memcpy (word, &outbuf[wordStart], wordlen * sizeof (widechar));
+      if (!lou_hyphenate (table, word, wordlen, wordHyphens, 1))
+	continue;
+      if (memcmp (&hyphens[wordStart], wordHyphens, wordlen))
+	{
+	  printf ("%s hyphenates the braille of a word differently\n",
+		  table);
+	  return 1;
+	}
+    }
+  return 0;
+}
+
+static int
+checkContractions (const char *table, const widechar * inbuf, int inlen)
+{
+  widechar outbuf[BUFSIZE];
+  char hyphens[BUFSIZE];
+  char textHyphens[BUFSIZE + 1];
+  int inputPos[BUFSIZE];
+  int outlen = BUFSIZE;
+  int k, found = 0;
+  if (!lou_translateHyphenated (table, inbuf, &inlen, outbuf, &outlen,
+				NULL, NULL, NULL, inputPos, NULL, hyphens, 0)
+      || !lou_hyphenateText (table, inbuf, inlen, textHyphens))
+    {
+      printf ("%s cannot translate with hyphens\n", table);
+      return 1;
+    }
+  for (k = 0; k < outlen; k++)
+    if (hyphens[k] == '1')
+      {
+	found = 1;
+	if (textHyphens[inputPos[k]] != '1'
+	    || (k > 0 && inputPos[k - 1] == inputPos[k]))
+	  {
+	    printf ("%s puts a hyphen inside a contraction\n", table);
+	    return 1;
+	  }
+      }
+  if (!found)
+    {
+      printf ("%s puts no hyphens in the braille\n", table);
+      return 1;
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar inbuf[BUFSIZE];
+  widechar outbuf[BUFSIZE];
+  char hyphens[BUFSIZE];
+  int inlen, outlen;
+  int result = 0;
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  inlen = extParseChars (text, inbuf);
+  result |= checkWords ("en-us-g1.ctb,hyph_en_US.dic", inbuf, inlen);
+  result |= checkContractions ("en-us-g2.ctb,hyph_en_US.dic", inbuf, inlen);
+  result |= checkContractions ("de-de-g2.ctb,hyph_de_DE.dic", inbuf, inlen);
+
+  outlen = BUFSIZE;
+  if (lou_translateHyphenated ("en-us-g1.ctb", inbuf, &inlen, outbuf,
+			       &outlen, NULL, NULL, NULL, NULL, NULL, hyphens,
+			       0))
+    {
+      printf ("en-us-g1.ctb translates with hyphens without patterns\n");
+      result = 1;
+    }
+
+  lou_free ();
+  return result;
+}
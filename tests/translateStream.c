@@ -0,0 +1,131 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that a long text fed to a stream in small pieces translates
+   exactly like the whole text at once, with the same input
+   positions, also where a piece translates to many cells more than
+   its characters. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#define TEXTSIZE 60000
+#define OUTSIZE (2 * TEXTSIZE)
+#define GREEKSIZE 5000
+#define FEEDSIZE 777
+
+static const char *words[] = {
+  "The", "quick", "brown", "fox", "jumps", "over", "the", "lazy", "dog.",
+  "Knowledge", "and", "braille", "translation", "123", "USA", "went",
+  "between", "children",
+};
+
+static widechar text[TEXTSIZE];
+static widechar expected[OUTSIZE];
+static int expectedPos[OUTSIZE];
+static widechar streamed[OUTSIZE];
+static int streamedPos[OUTSIZE];
+static int streamedLength;
+
+static void
+collect (const widechar *outbuf, int outlen, const int *inputPos,
+	 void *userData)
+{
+  if (streamedLength + outlen > OUTSIZE)
+    {
+      *(int *) userData = 1;
+      return;
+    }
+  memcpy (&streamed[streamedLength], outbuf, outlen * sizeof (widechar));
+  memcpy (&streamedPos[streamedLength], inputPos, outlen * sizeof (int));
+  streamedLength += outlen;
+}
+
+static int
+checkStream (const char *tableList, int textLength, int cut)
+{
+/* Stream text in pieces of FEEDSIZE and compare with the whole of it. 
+ * If cut, some of it must be translated before the end. */
+  louTable *table;
+  louStream *stream;
+  int expectedLength = OUTSIZE;
+  int overflow = 0;
+  int i, k;
+
+  k = textLength;
+  streamedLength = 0;
+  if (!lou_translate (tableList, text, &k, expected, &expectedLength, NULL,
+		      NULL, NULL, expectedPos, NULL, 0) || k != textLength)
+    {
+      printf ("Translation of the whole text with %s failed\n", tableList);
+      return 1;
+    }
+
+  if (!(table = lou_openTable (tableList))
+      || !(stream = lou_openStream (table, 0, collect, &overflow)))
+    return 1;
+  for (i = 0; i < textLength; i += FEEDSIZE)
+    if (!lou_feedStream (stream, &text[i],
+			 i + FEEDSIZE < textLength ? FEEDSIZE : textLength - i,
+			 NULL))
+      {
+	printf ("Feeding the stream with %s failed\n", tableList);
+	return 1;
+      }
+  if (cut && streamedLength == 0)
+    {
+      printf ("Nothing was translated with %s before the end of the "
+	      "stream\n", tableList);
+      return 1;
+    }
+  if (!lou_flushStream (stream))
+    {
+      printf ("Flushing the stream with %s failed\n", tableList);
+      return 1;
+    }
+  lou_closeStream (stream);
+
+  if (overflow || streamedLength != expectedLength
+      || memcmp (streamed, expected, expectedLength * sizeof (widechar)))
+    {
+      printf ("The streamed translation with %s differs\n", tableList);
+      return 1;
+    }
+  if (memcmp (streamedPos, expectedPos, expectedLength * sizeof (int)))
+    {
+      printf ("The streamed input positions with %s differ\n", tableList);
+      return 1;
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  char word[32];
+  int textLength = 0;
+  int result = 0;
+  int i;
+
+  for (i = 0; textLength < TEXTSIZE - 64; i++)
+    {
+      sprintf (word, "%s ", words[(i * 7) % (sizeof (words) / sizeof (*words))]);
+      textLength += extParseChars (word, &text[textLength]);
+    }
+  result |= checkStream ("en-us-g2.ctb", textLength, 1);
+
+  /* Greek letters, undefined in the table, each make an escape of many 
+     cells. With no space to cut at, they are one piece at the end. */
+  for (textLength = 0; textLength < GREEKSIZE; textLength++)
+    text[textLength] = 0x3b1 + textLength % 24;
+  result |= checkStream ("ru-litbrl.ctb", textLength, 0);
+
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,61 @@
+#!/usr/bin/perl
+use warnings;
+use strict;
+use Encode;
+$|++;
+
+# Test that lou_translate with --file, alone and with --jobs, translates
+# each line of a file as lou_translate does line by line, also with a
+# table which reports more or less input consumed than it was given.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved. This file is offered as-is,
+# without any warranty.
+
+my $corpora = "$ENV{srcdir}/../tools/benchmark";
+my $text = "translate_file.txt";
+
+my @cases = (
+    [ "en-us-g2.ctb", "english.txt" ],
+    [ "en-us-mathtext.ctb", "english.txt" ],
+    [ "de-de-g2.ctb", "german.txt" ],
+    [ "ru-litbrl.ctb", "russian.txt" ],
+    );
+
+sub translate {
+    my ($options, $table, $input) = @_;
+    my $output = `../tools/lou_translate $options $table < $input 2> /dev/null`;
+    $? == 0 or die "lou_translate $options $table failed on $input\n";
+    return $output;
+}
+
+foreach my $case (@cases) {
+    my ($table, $corpus) = @$case;
+    # a build with 16-bit offsets cannot compile de-de-g2
+    next if `../tools/lou_checktable --quiet $table 2>&1`
+	=~ /Table too large for 16-bit offsets/;
+    # en-us-mathtext reports more input consumed than the last line has
+    open (my $fh, ">", $text) or die "$text cannot be written\n";
+    open (my $in, "<", "$corpora/$corpus") or die "$corpus cannot be read\n";
+    print $fh $_ while <$in>;
+    print $fh "r >i<--J\n";
+    close $in;
+    close $fh;
+    my $expected = translate ("", $table, $text);
+    foreach my $options ("--file", "--file --jobs=3", "--file --jobs=0") {
+	translate ($options, $table, $text) eq $expected
+	    or die "lou_translate $options $table differs on $corpus\n";
+    }
+    # and back again, where line by line the characters which are not
+    # ASCII come out as escapes
+    open ($fh, ">", $text) or die "$text cannot be written\n";
+    print $fh $expected;
+    close $fh;
+    $expected = translate ("--backward", $table, $text);
+    $expected =~ s/\\x([0-9a-f]{4})/encode ("UTF-8", chr (hex ($1)))/ge;
+    translate ("--backward --file", $table, $text) eq $expected
+	or die "lou_translate --backward --file $table differs on $corpus\n";
+}
+
+unlink $text;
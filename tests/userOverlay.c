@@ -0,0 +1,154 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that the rules of a user dictionary are used by the context it
+   is set for, in the same way as if lou_compileString had added them,
+   and that the table and the other contexts are left alone. */
+
+#include <stdio.h>
+#include <string.h>
+#include "louis.h"
+
+#define BUFSIZE 256
+
+static const char *tables[] = {
+  "en-us-g1.ctb",
+  "en-us-g2.ctb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static const char *rules = "# names\n"
+  "word liblouis 123-24-12-123-135-136-24-234\n"
+  "\n"
+  "begword braille 12-1235-1246\n";
+
+static const char *text = "Liblouis translates braille and Braillemark, "
+  "but not myliblouis or braille.";
+
+typedef struct
+{
+  widechar outbuf[BUFSIZE];
+  int outlen;
+} Result;
+
+static void
+translate (const louTable * table, louContext * ctx, Result * result)
+{
+  widechar inbuf[BUFSIZE];
+  int inlen = extParseChars (text, inbuf);
+  result->outlen = BUFSIZE;
+  if (!lou_translateWithTable (table, ctx, inbuf, &inlen, result->outbuf,
+			       &result->outlen, NULL, NULL, NULL, NULL, NULL,
+			       0))
+    result->outlen = -1;
+}
+
+static int
+sameResult (const Result * a, const Result * b)
+{
+  return a->outlen == b->outlen
+    && !memcmp (a->outbuf, b->outbuf, a->outlen * sizeof (widechar));
+}
+
+int
+main (int argc, char **argv)
+{
+  Result base, overlaid, other, added;
+  const louTable *table;
+  louOverlay *overlay;
+  louContext *ctx, *otherCtx;
+  int bytesUsed;
+  int result = 0;
+  int i;
+
+  ctx = lou_createContext ();
+  otherCtx = lou_createContext ();
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      if (!(table = lou_openTable (tables[i])))
+	{
+	  printf ("Cannot open %s\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      translate (table, NULL, &base);
+      bytesUsed = ((TranslationTableHeader *)
+		   getTableFromHandle (table))->bytesUsed;
+      if (!(overlay = lou_compileOverlay (table, rules)))
+	{
+	  printf ("Cannot compile a user dictionary for %s\n", tables[i]);
+	  result = 1;
+	  lou_closeTable (table);
+	  continue;
+	}
+      lou_setWordCacheSize (ctx, 100);
+      lou_setContextOverlay (ctx, overlay);
+      translate (table, ctx, &overlaid);
+      translate (table, otherCtx, &other);
+      if (sameResult (&base, &overlaid))
+	{
+	  printf ("The user dictionary is not used with %s\n", tables[i]);
+	  result = 1;
+	}
+      if (!sameResult (&base, &other)
+	  || ((TranslationTableHeader *)
+	      getTableFromHandle (table))->bytesUsed != bytesUsed)
+	{
+	  printf ("The user dictionary changes %s\n", tables[i]);
+	  result = 1;
+	}
+      lou_setContextOverlay (ctx, NULL);
+      translate (table, ctx, &other);
+      if (!sameResult (&base, &other))
+	{
+	  printf ("The user dictionary is still used with %s\n", tables[i]);
+	  result = 1;
+	}
+      lou_freeOverlay (overlay);
+      if (!lou_compileString (tables[i], "word liblouis "
+			      "123-24-12-123-135-136-24-234")
+	  || !lou_compileString (tables[i], "begword braille 12-1235-1246"))
+	{
+	  printf ("Cannot add a rule to %s\n", tables[i]);
+	  result = 1;
+	}
+      else
+	{
+	  translate (table, NULL, &added);
+	  if (!sameResult (&added, &overlaid))
+	    {
+	      printf ("The user dictionary translates differently from "
+		      "rules added to %s\n", tables[i]);
+	      result = 1;
+	    }
+	}
+      lou_closeTable (table);
+    }
+
+  if ((table = lou_openTable (tables[0])))
+    {
+      if ((overlay = lou_compileOverlay (table, "pass2 @1 @2\n")))
+	{
+	  printf ("A user dictionary takes a pass2 rule\n");
+	  lou_freeOverlay (overlay);
+	  result = 1;
+	}
+      if ((overlay = lou_compileOverlay (table, "word liblouis =\n")))
+	{
+	  printf ("A user dictionary takes a rule without dots\n");
+	  lou_freeOverlay (overlay);
+	  result = 1;
+	}
+      lou_closeTable (table);
+    }
+
+  lou_freeContext (ctx);
+  lou_freeContext (otherCtx);
+  lou_free ();
+  return result;
+}
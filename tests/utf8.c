@@ -0,0 +1,245 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that translating and back-translating UTF-8 text gives the
+   translation of the same characters as widechars, with the positions
+   in bytes or characters where they are in widechars, taking those of
+   the first half of a surrogate pair for the character, that a short
+   output buffer ends the output between two characters, that invalid
+   UTF-8 is refused, and that hyphenating UTF-8 marks the first byte of
+   each character. */
+
+#include <stdio.h>
+#include <string.h>
+#include "liblouis.h"
+#include "louis.h"
+
+#define BUFSIZE 512
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "de-de-g2.ctb",
+  "hu-hu-g1.ctb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static const char *texts[] = {
+  "The quick brown fox, 123.",
+  "\xc3\xbc" "ber Stra\xc3\x9f" "e \xe2\x80\x9esch\xc3\xb6n\xe2\x80\x9c",
+  "\xf0\x9d\x90\x80 caf\xc3\xa9 \xe2\x82\xac" "5 \xf0\x9f\x98\x80!",
+};
+
+#define NUMTEXTS (sizeof (texts) / sizeof (texts[0]))
+
+static const char *invalid[] = {
+  "ab\xc3",
+  "\xc0\x80",
+  "\xed\xa0\x80",
+  "\xf4\x90\x80\x80",
+  "a\x80z",
+};
+
+#define NUMINVALID (sizeof (invalid) / sizeof (invalid[0]))
+
+typedef struct
+{
+  widechar chars[BUFSIZE];
+  int length;
+  int byteOf[BUFSIZE + 1];	/*offset of the bytes of each widechar */
+  int charOf[BUFSIZE + 1];	/*index of its character */
+} Decoded;
+
+static void
+decode (const char *text, int length, Decoded *d)
+{
+  const unsigned char *s = (const unsigned char *) text;
+  int in = 0, chars = 0;
+  unsigned long ch;
+  int numBytes;
+  d->length = 0;
+  while (in < length)
+    {
+      if (s[in] < 0x80)
+	ch = s[in], numBytes = 1;
+      else if (s[in] < 0xe0)
+	ch = s[in] & 0x1f, numBytes = 2;
+      else if (s[in] < 0xf0)
+	ch = s[in] & 0x0f, numBytes = 3;
+      else
+	ch = s[in] & 0x07, numBytes = 4;
+      d->byteOf[d->length] = in;
+      d->charOf[d->length] = chars;
+      for (in++; --numBytes > 0; in++)
+	ch = (ch << 6) | (s[in] & 0x3f);
+      if (sizeof (widechar) == 2 && ch > 0xffff)
+	{
+	  ch -= 0x10000;
+	  d->chars[d->length++] = 0xd800 | (ch >> 10);
+	  d->byteOf[d->length] = d->byteOf[d->length - 1];
+	  d->charOf[d->length] = chars;
+	  ch = 0xdc00 | (ch & 0x3ff);
+	}
+      d->chars[d->length++] = ch;
+      chars++;
+    }
+  d->byteOf[d->length] = length;
+  d->charOf[d->length] = chars;
+}
+
+static int
+checkText (const louTable *table, const char *name, const char *text,
+	   int textlen, int backward, int mode, char *utf8out, int *utf8len)
+{
+  static Decoded in, out;
+  widechar wideout[BUFSIZE];
+  int wideOutputPos[BUFSIZE], wideInputPos[BUFSIZE];
+  int outputPos[BUFSIZE], inputPos[BUFSIZE];
+  int inlen, outlen, k, charUnits;
+  const char *what = backward ? "back-translated" : "translated";
+  decode (text, textlen, &in);
+  for (charUnits = 0; charUnits < 2; charUnits++)
+    {
+      int *inUnit = charUnits ? in.charOf : in.byteOf;
+      int *outUnit = charUnits ? out.charOf : out.byteOf;
+      int umode = mode | (charUnits ? utf8CharPositions : 0);
+      inlen = in.length;
+      outlen = BUFSIZE;
+      if (!(backward ? lou_backTranslateWithTable : lou_translateWithTable)
+	  (table, NULL, in.chars, &inlen, wideout, &outlen, NULL, NULL,
+	   wideOutputPos, wideInputPos, NULL, mode))
+	{
+	  printf ("%s: \"%s\" cannot be %s\n", name, text, what);
+	  return 1;
+	}
+      *utf8len = BUFSIZE;
+      inlen = textlen;
+      if (!(backward ? lou_backTranslateUtf8 : lou_translateUtf8)
+	  (table, NULL, text, &inlen, utf8out, utf8len, outputPos,
+	   inputPos, umode))
+	{
+	  printf ("%s: \"%s\" cannot be %s as UTF-8\n", name, text, what);
+	  return 1;
+	}
+      decode (utf8out, *utf8len, &out);
+      if (inlen != textlen || out.length != outlen
+	  || memcmp (out.chars, wideout, outlen * sizeof (widechar)))
+	{
+	  printf ("%s: \"%s\" is %s differently as UTF-8\n", name, text,
+		  what);
+	  return 1;
+	}
+      for (k = 0; k < in.length; k++)
+	if ((!k || inUnit[k] != inUnit[k - 1])
+	    && outputPos[inUnit[k]] != outUnit[wideOutputPos[k]])
+	  {
+	    printf ("%s: \"%s\" %s has a wrong outputPos at %d\n", name,
+		    text, what, inUnit[k]);
+	    return 1;
+	  }
+      for (k = 0; k < outlen; k++)
+	if ((!k || outUnit[k] != outUnit[k - 1])
+	    && inputPos[outUnit[k]] != inUnit[wideInputPos[k]])
+	  {
+	    printf ("%s: \"%s\" %s has a wrong inputPos at %d\n", name,
+		    text, what, outUnit[k]);
+	    return 1;
+	  }
+    }
+  return 0;
+}
+
+static int
+checkTruncation (const louTable *table, const char *name, const char *text,
+		 const char *full, int fulllen)
+{
+  char outbuf[BUFSIZE];
+  int inlen, outlen, size;
+  for (size = 0; size < fulllen; size++)
+    {
+      inlen = strlen (text);
+      outlen = size;
+      if (!lou_translateUtf8 (table, NULL, text, &inlen, outbuf, &outlen,
+			      NULL, NULL, dotsIO | ucBrl))
+	{
+	  printf ("%s: \"%s\" cannot be translated into %d bytes\n", name,
+		  text, size);
+	  return 1;
+	}
+      if (outlen > size || outlen % 3 || memcmp (outbuf, full, outlen)
+	  || (text[inlen] & 0xc0) == 0x80)
+	{
+	  printf ("%s: \"%s\" is cut wrongly at %d bytes\n", name, text,
+		  size);
+	  return 1;
+	}
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  const louTable *table;
+  char braille[BUFSIZE], back[BUFSIZE], outbuf[BUFSIZE];
+  char hyphens[BUFSIZE];
+  int braillelen, backlen, inlen, outlen;
+  int result = 0;
+  int i, j;
+  const char *word = "megszents\xc3\xa9gtelen\xc3\xadthetetlens\xc3\xa9g";
+  const char *expected =
+    "00010000100010101000101001001000";
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      if (!(table = lou_openTable (tables[i])))
+	{
+	  printf ("%s could not be opened\n", tables[i]);
+	  result = 1;
+	  continue;
+	}
+      for (j = 0; j < NUMTEXTS; j++)
+	{
+	  if (checkText (table, tables[i], texts[j], strlen (texts[j]), 0,
+			 0, outbuf, &outlen)
+	      || checkText (table, tables[i], texts[j], strlen (texts[j]), 0,
+			    dotsIO | ucBrl, braille, &braillelen)
+	      || checkText (table, tables[i], braille, braillelen, 1,
+			    dotsIO | ucBrl, back, &backlen)
+	      || checkTruncation (table, tables[i], texts[j], braille,
+				  braillelen))
+	    result = 1;
+	}
+      for (j = 0; j < NUMINVALID; j++)
+	{
+	  inlen = strlen (invalid[j]);
+	  outlen = BUFSIZE;
+	  if (lou_translateUtf8 (table, NULL, invalid[j], &inlen, outbuf,
+				 &outlen, NULL, NULL, 0))
+	    {
+	      printf ("%s: invalid UTF-8 %d is translated\n", tables[i], j);
+	      result = 1;
+	    }
+	}
+    }
+
+  table = lou_openTable ("hu-hu-g1.ctb,hyph_hu_HU.dic");
+  if (!table || !lou_hyphenateUtf8 (table, word, strlen (word), hyphens, 0)
+      || strcmp (hyphens, expected))
+    {
+      printf ("\"%s\" is not hyphenated as expected\n", word);
+      result = 1;
+    }
+
+  lou_free ();
+  return result;
+}
@@ -0,0 +1,130 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that translations using the word cache are the same as
+   translations without it, also when the cache is too small for the
+   text, and that the cache forgets words when a table is changed. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#define BUFSIZE 1024
+
+static const char *tables[] = {
+  "en-us-g2.ctb",
+  "en-us-g1.ctb",
+  "UEBC-g2.ctb",
+  "de-de-g2.ctb",
+  "fr-bfu-g2.ctb",
+};
+
+#define NUMTABLES (sizeof (tables) / sizeof (tables[0]))
+
+static const char *text =
+  "the cat and the dog went to the park and the cat sat on the mat "
+  "while the dog ran after the ball and the children of the town "
+  "watched the cat and the dog from the other side of the street the "
+  "end";
+
+static int
+translate (louContext * ctx, const char *table, widechar * inbuf,
+	   int inlen, widechar * outbuf, int mode)
+{
+  int outlen = BUFSIZE;
+  if (ctx == NULL)
+    {
+      if (!lou_translate (table, inbuf, &inlen, outbuf, &outlen, NULL,
+			  NULL, NULL, NULL, NULL, mode))
+	return -1;
+    }
+  else if (!lou_translateCtx (ctx, table, inbuf, &inlen, outbuf, &outlen,
+			      NULL, NULL, NULL, NULL, NULL, mode))
+    return -1;
+  return outlen;
+}
+
+static int
+check (louContext * ctx, const char *table, widechar * inbuf, int inlen,
+       int mode, const char *what)
+{
+  widechar expected[BUFSIZE];
+  widechar received[BUFSIZE];
+  int expectedlen, receivedlen;
+  int round;
+  expectedlen = translate (NULL, table, inbuf, inlen, expected, mode);
+  if (expectedlen < 0)
+    {
+      printf ("%s translation with %s failed\n", table, what);
+      return 1;
+    }
+  for (round = 0; round < 2; round++)
+    {
+      receivedlen = translate (ctx, table, inbuf, inlen, received, mode);
+      if (receivedlen != expectedlen || memcmp (expected, received,
+						expectedlen *
+						sizeof (widechar)))
+	{
+	  printf ("%s translation with %s differs with the word cache\n",
+		  table, what);
+	  return 1;
+	}
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  widechar inbuf[BUFSIZE];
+  widechar before[BUFSIZE];
+  widechar after[BUFSIZE];
+  int inlen;
+  int beforelen, afterlen;
+  louContext *ctx[2];
+  int result = 0;
+  int i;
+
+#if OFFSETBITS == 16
+  /* de-de-g2 does not fit in 16-bit offsets */
+  return 77;
+#endif
+
+  inlen = extParseChars (text, inbuf);
+  ctx[0] = lou_createContext ();
+  ctx[1] = lou_createContext ();
+  lou_setWordCacheSize (ctx[0], 256);
+  lou_setWordCacheSize (ctx[1], 3);
+  for (i = 0; i < NUMTABLES; i++)
+    {
+      result |= check (ctx[0], tables[i], inbuf, inlen, 0, "a large cache");
+      result |= check (ctx[1], tables[i], inbuf, inlen, 0, "a small cache");
+      result |= check (ctx[0], tables[i], inbuf, inlen, noContractions,
+		       "noContractions");
+      result |= check (ctx[0], tables[i], inbuf, inlen, dotsIO, "dotsIO");
+    }
+
+  /* A rule added to the table must be seen by words already cached. */
+  beforelen = translate (ctx[0], tables[0], inbuf, inlen, before, 0);
+  lou_compileString (tables[0], "word cat 1-2-3-4-5-6");
+  afterlen = translate (ctx[0], tables[0], inbuf, inlen, after, 0);
+  if (afterlen == beforelen
+      && !memcmp (before, after, afterlen * sizeof (widechar)))
+    {
+      printf ("A word cached before lou_compileString was reused\n");
+      result = 1;
+    }
+  result |= check (ctx[0], tables[0], inbuf, inlen, 0, "a changed table");
+
+  lou_setWordCacheSize (ctx[1], 0);
+  result |= check (ctx[1], tables[1], inbuf, inlen, 0, "the cache off");
+  lou_freeContext (ctx[0]);
+  lou_freeContext (ctx[1]);
+  lou_free ();
+  return result;
+}
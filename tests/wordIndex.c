@@ -0,0 +1,135 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that a table with many whole-word rules has them in the
+   whole-word index, and that it translates the same as when the rules
+   are found by walking the hash chains, also where a longer rule or a
+   shorter rule of another chain begins with the same letters as an
+   indexed word. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "louis.h"
+
+#define NUMWORDS 1500
+#define BUFSIZE 40000
+
+static const char *tableName = "wordIndex.ctb";
+
+static const char *cells[] = { "1", "12", "14", "145", "15", "124", "1245",
+  "125", "24", "245"
+};
+
+static void
+makeWord (int k, char *word)
+{
+/* A word of three letters or more made of k, none beginning with a to e */
+  int n = 0;
+  word[n++] = 'g' + k % 20;
+  k /= 20;
+  do
+    {
+      word[n++] = 'a' + k % 26;
+      k /= 26;
+    }
+  while (k || n < 3);
+  word[n] = 0;
+}
+
+static int
+translate (const widechar *inbuf, int inlen, widechar *outbuf, int *outlen)
+{
+  *outlen = BUFSIZE;
+  return lou_translateString (tableName, inbuf, &inlen, outbuf, outlen,
+			      NULL, NULL, 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  static char text[BUFSIZE];
+  static widechar inbuf[BUFSIZE];
+  static widechar expected[BUFSIZE];
+  static widechar outbuf[BUFSIZE];
+  char word[16];
+  int inlen, expectedlen, outlen;
+  TranslationTableHeader *table;
+  FILE *file;
+  int result = 0;
+  int c, k;
+
+  if (!(file = fopen (tableName, "w")))
+    {
+      printf ("%s could not be written\n", tableName);
+      return 1;
+    }
+  fputs ("include latinLetterDef6Dots.uti\n"
+	 "space \\s 0\n"
+	 "punctuation - 36\n"
+	 "punctuation , 2\n" "always or 135\n", file);
+  /* Whether a shorter rule of another chain comes first in the trie 
+     depends on the hash of the chains, so there are five of each */
+  for (c = 'a'; c <= 'e'; c++)
+    fprintf (file, "word %cor 124\n" "begword %cor- 124-1346-36\n"
+	     "always %ca 12\n" "always %ce 15\n" "always %ci 24\n"
+	     "always %cu 136\n" "always %c- 1236\n", c, c, c, c, c, c, c);
+  for (k = 0; k < NUMWORDS; k++)
+    {
+      makeWord (k, word);
+      fprintf (file, "word %s %s-%s\n", word, cells[k % 10],
+	       cells[k / 10 % 10]);
+    }
+  fclose (file);
+
+  for (c = 'a'; c <= 'e'; c++)
+    sprintf (text + strlen (text), "%cor %cor-%cun %cor, or-%cor %ca-%cor ",
+	     c, c, c, c - 'a' + 'A', c, c, c);
+  for (k = 0; k < NUMWORDS; k += 3)
+    {
+      makeWord (k, word);
+      strcat (text, k % 2 ? " " : "-");
+      strcat (text, word);
+      if (k % 5 == 0)
+	strcat (text, "s");
+      if (k % 7 == 0)
+	word[0] = word[0] - 'a' + 'A';
+      strcat (text, " ");
+      strcat (text, word);
+    }
+  for (inlen = 0; text[inlen]; inlen++)
+    inbuf[inlen] = (unsigned char) text[inlen];
+
+  if (!(table = lou_getTable (tableName)) || !table->wordIndex
+      || table->numIndexedWords < NUMWORDS)
+    {
+      printf ("The words of %s are not in the whole-word index\n",
+	      tableName);
+      result = 1;
+    }
+  else if (!translate (inbuf, inlen, expected, &expectedlen))
+    {
+      printf ("%s could not be used\n", tableName);
+      result = 1;
+    }
+  else
+    {
+      table->forRuleTrie = 0;
+      if (!translate (inbuf, inlen, outbuf, &outlen)
+	  || outlen != expectedlen
+	  || memcmp (outbuf, expected, outlen * sizeof (widechar)))
+	{
+	  printf ("%s translates differently without the index\n",
+		  tableName);
+	  result = 1;
+	}
+    }
+
+  lou_free ();
+  remove (tableName);
+  return result;
+}
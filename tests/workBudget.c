@@ -0,0 +1,140 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+Copying and distribution of this file, with or without modification,
+are permitted in any medium without royalty provided the copyright
+notice and this notice are preserved. This file is offered as-is,
+without any warranty. */
+
+/* Check that a translation which would never end, the one of
+   infiniteTranslationLoop, stops once it has used up the steps or the
+   time of the work budget of its context, or is cancelled from another
+   thread, and that other translations are not affected. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "liblouis.h"
+#include "louis.h"
+
+static const char *loopTable = "UEBC-g2.ctb";
+static const char *loopText = "---.com";
+
+static int
+translate (louContext * ctx, const char *tableList, const char *text)
+{
+  widechar inbuf[100];
+  widechar outbuf[200];
+  int inlen = extParseChars (text, inbuf);
+  int outlen = 200;
+  return lou_translateCtx (ctx, tableList, inbuf, &inlen, outbuf, &outlen,
+			   NULL, NULL, NULL, NULL, NULL, 0);
+}
+
+static int
+stopsWith (louContext * ctx, int expected)
+{
+  double start = currentTime ();
+  int status;
+  if (translate (ctx, loopTable, loopText))
+    {
+      printf ("The endless translation succeeded\n");
+      return 0;
+    }
+  if ((status = lou_getWorkStatus (ctx)) != expected)
+    {
+      printf ("It stopped with status %d instead of %d\n", status,
+	      expected);
+      return 0;
+    }
+  if (currentTime () - start > 5)
+    {
+      printf ("It took %g seconds to stop\n", currentTime () - start);
+      return 0;
+    }
+  return 1;
+}
+
+#ifdef HAVE_PTHREAD_H
+
+#include <pthread.h>
+
+static volatile int finished;
+
+static void *
+translateForever (void *ctx)
+{
+  translate (ctx, loopTable, loopText);
+  finished = 1;
+  return NULL;
+}
+
+static int
+cancels (louContext * ctx)
+{
+  pthread_t thread;
+  finished = 0;
+  if (pthread_create (&thread, NULL, translateForever, ctx))
+    return 0;
+  /* Until the translation has begun and seen it */
+  while (!finished)
+    lou_cancelTranslation (ctx);
+  pthread_join (thread, NULL);
+  if (lou_getWorkStatus (ctx) != louWorkCancelled)
+    {
+      printf ("The translation was not cancelled\n");
+      return 0;
+    }
+  return 1;
+}
+
+#else
+
+static int
+cancels (louContext * ctx)
+{
+  return 1;
+}
+
+#endif
+
+int
+main (int argc, char **argv)
+{
+  louContext *ctx = lou_createContext ();
+  int result = 0;
+
+  /* Within the budget */
+  lou_setWorkBudget (ctx, 100000, 10);
+  if (!translate (ctx, "en-us-g2.ctb", "the quick brown fox")
+      || lou_getWorkStatus (ctx) != louWorkDone)
+    {
+      printf ("A translation within its budget did not succeed\n");
+      result = 1;
+    }
+
+  if (!stopsWith (ctx, louWorkExhausted))
+    result = 1;
+  lou_setWorkBudget (ctx, 0, 0.2);
+  if (!stopsWith (ctx, louWorkTimedOut))
+    result = 1;
+
+  /* The next translation starts afresh */
+  if (!translate (ctx, "en-us-g2.ctb", "the quick brown fox")
+      || lou_getWorkStatus (ctx) != louWorkDone)
+    {
+      printf ("A translation after one stopped did not succeed\n");
+      result = 1;
+    }
+
+  lou_setWorkBudget (ctx, 0, 0);
+  if (!cancels (ctx))
+    result = 1;
+
+  lou_freeContext (ctx);
+  lou_free ();
+  return result;
+}
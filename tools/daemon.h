@@ -0,0 +1,61 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   */
+
+/* The protocol of lou_daemon. A client sends any number of requests on
+   one connection and gets a response to each in turn. A request is a
+   header of DAEMON_REQUEST_SIZE bytes, the table list and the text:
+
+     4 bytes  the kind of request, DAEMON_TRANSLATE, DAEMON_BACKTRANSLATE,
+              DAEMON_HYPHENATE or DAEMON_METRICS
+     4 bytes  the mode of the translation or hyphenation
+     4 bytes  the length of the table list in bytes
+     4 bytes  the length of the text in bytes
+
+   A response is a header of DAEMON_RESPONSE_SIZE bytes and its output:
+
+     4 bytes  1 if the request was done, 0 if it failed
+     4 bytes  the length of the output in bytes
+
+   The numbers are unsigned and big-endian. The table list, the text
+   and the translations are in UTF-8, and the output of a hyphenation
+   is the hyphens of lou_hyphenateUtf8, one for each byte of the text.
+   The output of DAEMON_METRICS, whose table list and text are ignored,
+   is the counts of lou_getMetrics, a line "name value" for each. */
+
+#ifndef __DAEMON_H_
+#define __DAEMON_H_
+
+#define DAEMON_TRANSLATE 0
+#define DAEMON_BACKTRANSLATE 1
+#define DAEMON_HYPHENATE 2
+#define DAEMON_METRICS 3
+
+#define DAEMON_REQUEST_SIZE 16
+#define DAEMON_RESPONSE_SIZE 8
+
+#define DAEMON_MAXTABLELIST 4096	/*longest table list accepted */
+#define DAEMON_MAXTEXT (64 * 1024 * 1024)	/*longest text accepted */
+
+#define getBigEndian(bytes) \
+  (((unsigned long) (bytes)[0] << 24) | ((unsigned long) (bytes)[1] << 16) \
+   | ((unsigned long) (bytes)[2] << 8) | (unsigned long) (bytes)[3])
+
+#define putBigEndian(bytes, number) \
+  ((bytes)[0] = ((number) >> 24) & 0xff, (bytes)[1] = ((number) >> 16) & 0xff, \
+   (bytes)[2] = ((number) >> 8) & 0xff, (bytes)[3] = (number) & 0xff)
+
+#endif /* __DAEMON_H_ */
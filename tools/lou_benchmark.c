@@ -0,0 +1,1321 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   */
+
+# include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#include "liblouis.h"
+#include "louis.h"
+#include "progname.h"
+#include "version-etc.h"
+
+#define MAXWORD 99		/*longest word lou_hyphenate takes */
+#define ADVERSARIALLENGTH 1000	/*characters of an adversarial text */
+#define ADVERSARIALTEXTS 16	/*texts of each kind */
+#define BUSIESTCHAINS 8		/*forRules chains the texts are made from */
+
+enum
+{
+  FORWARD,
+  BACKWARD,
+  HYPHENATE,
+  CHARTODOTS,
+  NUMMEASURES
+};
+
+static const char *measureNames[NUMMEASURES] = {
+  "forward", "backward", "hyphenate", "charToDots"
+};
+
+enum
+{
+  CHAINS,
+  PASSES,
+  SWAPS,
+  EMPHASIS,
+  COMPBRL,
+  NUMKINDS
+};
+
+static const char *kindNames[NUMKINDS] = {
+  "chains", "passes", "swaps", "emphasis", "compbrl"
+};
+
+static const char *phaseNames[PROFILE_PHASES] = {
+  "reading", "resolving", "parsing", "inserting", "finishing"
+};
+
+static double min_seconds = 1.0;
+static int json_flag = 0;
+static int compile_flag = 0;
+static int images_flag = 0;
+static int adversarial_flag = 0;
+static int measures = (1 << NUMMEASURES) - 1;
+static const char *suite_name = NULL;
+static int results = 0;
+
+static const struct option longopts[] =
+{
+  { "help", no_argument, NULL, 'h' },
+  { "version", no_argument, NULL, 'v' },
+  { "suite", required_argument, NULL, 's' },
+  { "time", required_argument, NULL, 't' },
+  { "measure", required_argument, NULL, 'm' },
+  { "json", no_argument, NULL, 'j' },
+  { "compile", no_argument, NULL, 'c' },
+  { "images", no_argument, NULL, 'i' },
+  { "adversarial", no_argument, NULL, 'a' },
+  { NULL, 0, NULL, 0 }
+};
+
+const char version_etc_copyright[] =
+  "Copyright %s %d by the liblouis team.";
+
+#define AUTHORS "the liblouis team"
+
+typedef struct
+{
+  widechar *chars;
+  int length;
+  louEmphasisSpan *spans;	/*the emphasis, if not NULL */
+  int numSpans;
+} Text;
+
+typedef struct
+{
+  Text *texts;
+  int count;
+  int size;
+  long chars;
+} Texts;
+
+typedef struct
+{
+  double *values;
+  long count;
+  long size;
+} Latencies;
+
+typedef struct
+{
+  widechar *chars;
+  int count;
+  int size;
+} CharList;
+
+typedef struct
+{
+  TranslationTableOffset *offsets;
+  int count;
+  int size;
+} OffsetList;
+
+static void *
+allocate (void *block, size_t size)
+{
+  if (!(block = realloc (block, size)))
+    {
+      fprintf (stderr, "%s: out of memory\n", program_name);
+      exit (EXIT_FAILURE);
+    }
+  return block;
+}
+
+static double
+now (void)
+{
+/* Seconds from some fixed time, as finely as the system can tell */
+#ifdef CLOCK_MONOTONIC
+  struct timespec time;
+  if (!clock_gettime (CLOCK_MONOTONIC, &time))
+    return time.tv_sec + time.tv_nsec / 1e9;
+#endif
+  {
+    struct timeval tv;
+    gettimeofday (&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+  }
+}
+
+static Text *
+addText (Texts * texts, const widechar * chars, int length)
+{
+  Text *text;
+  if (texts->count == texts->size)
+    {
+      texts->size = texts->size ? 2 * texts->size : 64;
+      texts->texts = allocate (texts->texts, texts->size * sizeof (Text));
+    }
+  text = &texts->texts[texts->count++];
+  text->chars = allocate (NULL, (length + 1) * CHARSIZE);
+  memcpy (text->chars, chars, length * CHARSIZE);
+  text->length = length;
+  text->spans = NULL;
+  text->numSpans = 0;
+  texts->chars += length;
+  return text;
+}
+
+static void
+freeTexts (Texts * texts)
+{
+  int k;
+  for (k = 0; k < texts->count; k++)
+    {
+      free (texts->texts[k].chars);
+      free (texts->texts[k].spans);
+    }
+  free (texts->texts);
+  memset (texts, 0, sizeof (*texts));
+}
+
+static long
+nextChar (const unsigned char **bytes, const unsigned char *end)
+{
+/* Decode the next character of UTF-8. Bytes which are not UTF-8 are
+ * taken as U+FFFD. */
+  const unsigned char *pos = *bytes;
+  int lead, more;
+  long ch;
+  lead = *pos++;
+  if (lead < 0x80)
+    ch = lead, more = 0;
+  else if (lead >= 0xc2 && lead < 0xe0)
+    ch = lead & 0x1f, more = 1;
+  else if (lead >= 0xe0 && lead < 0xf0)
+    ch = lead & 0x0f, more = 2;
+  else if (lead >= 0xf0 && lead < 0xf5)
+    ch = lead & 0x07, more = 3;
+  else
+    ch = 0xfffd, more = 0;
+  while (more--)
+    {
+      if (pos == end || (*pos & 0xc0) != 0x80)
+	{
+	  *bytes = pos;
+	  return 0xfffd;
+	}
+      ch = (ch << 6) | (*pos++ & 0x3f);
+    }
+  *bytes = pos;
+  if ((ch >= 0xd800 && ch < 0xe000) || ch > 0x10ffff
+      || (lead >= 0xe0 && ch < 0x800) || (lead >= 0xf0 && ch < 0x10000))
+    return 0xfffd;
+  return ch;
+}
+
+static void
+readCorpus (const char *fileName, Texts * lines, Texts * words)
+{
+/* Read the lines of the corpus, leaving out empty ones, and split them
+ * into words at spaces for hyphenation. */
+  FILE *file;
+  unsigned char *bytes = NULL;
+  const unsigned char *pos, *end;
+  widechar *line;
+  long size = 0, length = 0, got;
+  int lineLength, start, k;
+  long ch;
+  if (!(file = fopen (fileName, "rb")))
+    {
+      fprintf (stderr, "%s: cannot open %s\n", program_name, fileName);
+      exit (EXIT_FAILURE);
+    }
+  do
+    {
+      if (length == size)
+	{
+	  size = size ? 2 * size : 65536;
+	  bytes = allocate (bytes, size);
+	}
+      got = fread (bytes + length, 1, size - length, file);
+      length += got;
+    }
+  while (got > 0);
+  fclose (file);
+  line = allocate (NULL, (2 * length + 1) * CHARSIZE);
+  pos = bytes;
+  end = bytes + length;
+  while (pos < end)
+    {
+      lineLength = 0;
+      while (pos < end && (ch = nextChar (&pos, end)) != '\n')
+	{
+	  if (ch == '\r')
+	    continue;
+	  if (sizeof (widechar) == 2 && ch > 0xffff)
+	    {
+	      ch -= 0x10000;
+	      line[lineLength++] = 0xd800 | (ch >> 10);
+	      ch = 0xdc00 | (ch & 0x3ff);
+	    }
+	  line[lineLength++] = ch;
+	}
+      if (!lineLength)
+	continue;
+      addText (lines, line, lineLength);
+      for (start = k = 0; k <= lineLength; k++)
+	if (k == lineLength || line[k] == ' ')
+	  {
+	    if (k > start && k - start <= MAXWORD)
+	      addText (words, &line[start], k - start);
+	    start = k + 1;
+	  }
+    }
+  free (line);
+  free (bytes);
+}
+
+static void
+addLatency (Latencies * latencies, double seconds)
+{
+  if (latencies->count == latencies->size)
+    {
+      latencies->size = latencies->size ? 2 * latencies->size : 4096;
+      latencies->values = allocate (latencies->values,
+				    latencies->size * sizeof (double));
+    }
+  latencies->values[latencies->count++] = seconds;
+}
+
+static int
+compareLatencies (const void *a, const void *b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+  return x < y ? -1 : x > y;
+}
+
+static double
+percentile (const Latencies * latencies, double fraction, double scale)
+{
+/* The nearest rank of the sorted latencies, in seconds times scale */
+  long rank = (long) (fraction * latencies->count + 0.999999);
+  if (rank < 1)
+    rank = 1;
+  if (rank > latencies->count)
+    rank = latencies->count;
+  return latencies->values[rank - 1] * scale;
+}
+
+static int
+callOnce (int measure, const louTable * table, const Text * text,
+	  widechar * outbuf, int outSize, char *hyphens, int *outlen)
+{
+  int inlen = text->length;
+  *outlen = outSize;
+  switch (measure)
+    {
+    case FORWARD:
+      if (text->spans != NULL)
+	return lou_translateWithSpans (table, NULL, text->chars, &inlen,
+				       outbuf, outlen, text->spans,
+				       text->numSpans, NULL, NULL, NULL, 0);
+      return lou_translateWithTable (table, NULL, text->chars, &inlen,
+				     outbuf, outlen, NULL, NULL, NULL, NULL,
+				     NULL, 0);
+    case BACKWARD:
+      return lou_backTranslateWithTable (table, NULL, text->chars, &inlen,
+					 outbuf, outlen, NULL, NULL, NULL,
+					 NULL, NULL, 0);
+    case HYPHENATE:
+      return lou_hyphenateWithTable (table, text->chars, text->length,
+				     hyphens, 0);
+    default:
+      *outlen = text->length;
+      return lou_charToDotsWithTable (table, text->chars, outbuf,
+				      text->length, 0);
+    }
+}
+
+static void
+printField (const char *name, const char *value, int last)
+{
+  const char *c;
+  if (!json_flag)
+    {
+      fputs (value, stdout);
+      putchar (last ? '\n' : '\t');
+      return;
+    }
+  printf ("\"%s\": \"", name);
+  for (c = value; *c; c++)
+    if (*c == '"' || *c == '\\')
+      printf ("\\%c", *c);
+    else if ((unsigned char) *c < 0x20)
+      printf ("\\u%04x", *c);
+    else
+      putchar (*c);
+  printf (last ? "\"" : "\", ");
+}
+
+static void
+printResult (const char *tableList, const char *corpus, int measure,
+	     Latencies * latencies, long chars, double seconds)
+{
+  /* Adversarial latencies are per character, and much shorter */
+  const char *suffix = adversarial_flag ? "PerChar" : "";
+  double scale = adversarial_flag ? 1e9 : 1e6;
+  qsort (latencies->values, latencies->count, sizeof (double),
+	 compareLatencies);
+  if (json_flag)
+    printf ("%s  { ", results ? ",\n" : "[\n");
+  printField ("table", tableList, 0);
+  printField ("corpus", corpus, 0);
+  printField ("measure", measureNames[measure], 0);
+  if (json_flag)
+    printf ("\"calls\": %ld, \"chars\": %ld, \"seconds\": %.6f, "
+	    "\"charsPerSecond\": %.0f, \"p50%s\": %.2f, \"p90%s\": %.2f, "
+	    "\"p99%s\": %.2f, \"max%s\": %.2f }",
+	    latencies->count, chars, seconds, chars / seconds,
+	    suffix, percentile (latencies, 0.5, scale),
+	    suffix, percentile (latencies, 0.9, scale),
+	    suffix, percentile (latencies, 0.99, scale),
+	    suffix, percentile (latencies, 1.0, scale));
+  else
+    printf ("%ld\t%ld\t%.6f\t%.0f\t%.2f\t%.2f\t%.2f\t%.2f\n",
+	    latencies->count, chars, seconds, chars / seconds,
+	    percentile (latencies, 0.5, scale),
+	    percentile (latencies, 0.9, scale),
+	    percentile (latencies, 0.99, scale),
+	    percentile (latencies, 1.0, scale));
+  results++;
+  fflush (stdout);
+}
+
+static const louTable *
+openBenchmarkTable (const char *tableList)
+{
+  const louTable *table;
+  if (!(table = lou_openTable (tableList)))
+    {
+      fprintf (stderr, "%s: %s cannot be compiled\n", program_name,
+	       tableList);
+      exit (EXIT_FAILURE);
+    }
+  return table;
+}
+
+static void
+measureTexts (const char *tableList, const char *corpusName,
+	      const louTable * table, Texts * lines, Texts * words)
+{
+/* Measure each kind of call on the lines, or for hyphenation the words.
+ * Each text is first done once untimed, so that the table is compiled
+ * completely and the braille to back-translate is known, and then all
+ * of them are done again and again until min_seconds have been spent in
+ * the calls. */
+  Texts braille = { NULL, 0, 0, 0 };
+  Texts *texts;
+  Latencies latencies = { NULL, 0, 0 };
+  widechar *outbuf;
+  char *hyphens;
+  int outSize, size, outlen, measure, done, k;
+  long chars;
+  double seconds, start, elapsed;
+  outSize = MAXWORD + 1;
+  for (k = 0; k < lines->count; k++)
+    {
+      /* Adversarial texts may take many indicators or undefined
+       * characters shown as text */
+      size = (adversarial_flag ? 16 : 4) * lines->texts[k].length + 64;
+      if (size > outSize)
+	outSize = size;
+    }
+  outbuf = allocate (NULL, outSize * CHARSIZE);
+  hyphens = allocate (NULL, outSize);
+  for (measure = 0; measure < NUMMEASURES; measure++)
+    {
+      if (!(measures & (1 << measure)))
+	continue;
+      /* Adversarial texts are made only for translating */
+      if (adversarial_flag && measure != FORWARD && measure != BACKWARD)
+	continue;
+      texts = measure == HYPHENATE ? words :
+	measure == BACKWARD ? &braille : lines;
+      if (measure == BACKWARD && !(measures & (1 << FORWARD)))
+	for (k = 0; k < lines->count; k++)
+	  if (callOnce (FORWARD, table, &lines->texts[k], outbuf, outSize,
+			hyphens, &outlen))
+	    addText (&braille, outbuf, outlen);
+      for (done = k = 0; k < texts->count; k++)
+	if (callOnce (measure, table, &texts->texts[k], outbuf, outSize,
+		      hyphens, &outlen))
+	  {
+	    done++;
+	    if (measure == FORWARD && (measures & (1 << BACKWARD)))
+	      addText (&braille, outbuf, outlen);
+	  }
+      /* Tables without hyphenation patterns hyphenate nothing */
+      if (!done)
+	continue;
+      latencies.count = 0;
+      chars = 0;
+      seconds = 0;
+      do
+	for (k = 0; k < texts->count; k++)
+	  {
+	    start = now ();
+	    callOnce (measure, table, &texts->texts[k], outbuf, outSize,
+		      hyphens, &outlen);
+	    elapsed = now () - start;
+	    addLatency (&latencies, adversarial_flag && texts->texts[k].length
+			? elapsed / texts->texts[k].length : elapsed);
+	    seconds += elapsed;
+	    chars += texts->texts[k].length;
+	  }
+      while (seconds < min_seconds);
+      if (seconds <= 0)
+	seconds = 1e-9;
+      printResult (tableList, corpusName, measure, &latencies, chars,
+		   seconds);
+    }
+  free (latencies.values);
+  free (outbuf);
+  free (hyphens);
+  freeTexts (&braille);
+}
+
+static void
+benchmark (const char *tableList, const char *corpusName,
+	   const char *corpus)
+{
+/* Measure the calls on the lines of the corpus and on its words */
+  const louTable *table = openBenchmarkTable (tableList);
+  Texts lines = { NULL, 0, 0, 0 };
+  Texts words = { NULL, 0, 0, 0 };
+  readCorpus (corpus, &lines, &words);
+  measureTexts (tableList, corpusName, table, &lines, &words);
+  freeTexts (&lines);
+  freeTexts (&words);
+  lou_closeTable (table);
+}
+
+static unsigned long randomState;
+
+static int
+randomNumber (int limit)
+{
+/* A number from 0 below limit, the same on every system so that the
+ * adversarial texts of a table are */
+  randomState = (randomState * 1103515245UL + 12345UL) & 0x7fffffffUL;
+  return (int) ((randomState >> 8) % limit);
+}
+
+static void
+addChar (CharList * list, widechar c)
+{
+  if (list->count == list->size)
+    {
+      list->size = list->size ? 2 * list->size : 64;
+      list->chars = allocate (list->chars, list->size * CHARSIZE);
+    }
+  list->chars[list->count++] = c;
+}
+
+static void
+addOffset (OffsetList * list, TranslationTableOffset offset)
+{
+  if (list->count == list->size)
+    {
+      list->size = list->size ? 2 * list->size : 64;
+      list->offsets = allocate (list->offsets, list->size * OFFSETSIZE);
+    }
+  list->offsets[list->count++] = offset;
+}
+
+static int
+hasChar (const CharList * list, widechar c)
+{
+  int k;
+  for (k = 0; k < list->count; k++)
+    if (list->chars[k] == c)
+      return 1;
+  return 0;
+}
+
+static const TranslationTableRule *
+ruleAt (const TranslationTableHeader * header, TranslationTableOffset offset)
+{
+  return (const TranslationTableRule *) &header->ruleArea[offset];
+}
+
+static const TranslationTableCharacter *
+characterAt (const TranslationTableHeader * header,
+	     TranslationTableOffset offset)
+{
+  return (const TranslationTableCharacter *) &header->ruleArea[offset];
+}
+
+static const TranslationTableOffset *
+forRuleChains (const TranslationTableHeader * header, int *count)
+{
+  if (header->forRuleBuckets)
+    {
+      *count = 1 << header->forRuleHashBits;
+      return OFFSETARRAY (header->ruleArea, header->forRuleBuckets);
+    }
+  *count = HASHNUM;
+  return header->forRules;
+}
+
+static void
+findCharacters (const TranslationTableHeader * header,
+		TranslationTableCharacterAttributes attributes,
+		const CharList * cells, CharList * chars)
+{
+/* Add to chars the characters with one of attributes, or if cells is
+ * not NULL those defined as one of its cells */
+  const TranslationTableCharacter *character;
+  const TranslationTableRule *rule;
+  TranslationTableOffset offset;
+  int k;
+  for (k = 0; k < HASHNUM; k++)
+    for (offset = header->characters[k]; offset; offset = character->next)
+      {
+	character = characterAt (header, offset);
+	if (cells == NULL)
+	  {
+	    if ((character->attributes & attributes))
+	      addChar (chars, character->realchar);
+	    continue;
+	  }
+	if (!character->definitionRule)
+	  continue;
+	rule = ruleAt (header, character->definitionRule);
+	if (rule->dotslen == 1
+	    && hasChar (cells, rule->charsdots[rule->charslen]))
+	  addChar (chars, character->realchar);
+      }
+}
+
+static void
+findDots (const TranslationTableHeader * header,
+	  TranslationTableCharacterAttributes attributes, CharList * cells)
+{
+  const TranslationTableCharacter *dots;
+  TranslationTableOffset offset;
+  int k;
+  for (k = 0; k < HASHNUM; k++)
+    for (offset = header->dots[k]; offset; offset = dots->next)
+      {
+	dots = characterAt (header, offset);
+	if ((dots->attributes & attributes))
+	  addChar (cells, dots->realchar);
+      }
+}
+
+static void
+findPassChars (const TranslationTableHeader * header, int swaps,
+	       CharList * chars)
+{
+/* The characters at which the pass rules whose test begins with a class
+ * of characters, or with those replaced by a swap rule, are tried. The
+ * passes after the second look at cells, which are made from the
+ * characters defined as them. */
+  const int guardSize = sizeof (PassRuleGuard) / SLOTSIZE;
+  const PassRuleGuard *guard;
+  const TranslationTableRule *swapRule;
+  CharList cells = { NULL, 0, 0 };
+  int pass, k, j, step;
+  for (pass = 0; pass < 5; pass++)
+    {
+      if (!header->passRuleGuards[pass])
+	continue;
+      for (k = 0;; k++)
+	{
+	  guard = (const PassRuleGuard *)
+	    &header->ruleArea[header->passRuleGuards[pass] + k * guardSize];
+	  if (!guard->rule)
+	    break;
+	  if (guard->ch)
+	    continue;
+	  if (swaps && guard->swapRule)
+	    {
+	      swapRule = ruleAt (header, guard->swapRule);
+	      step = swapRule->opcode == CTO_SwapDd ? 2 : 1;
+	      for (j = step - 1; j < swapRule->charslen; j += step)
+		addChar (pass < 2 ? chars : &cells, swapRule->charsdots[j]);
+	    }
+	  else if (!swaps && !guard->swapRule && guard->attributes)
+	    {
+	      if (pass < 2)
+		findCharacters (header, guard->attributes, NULL, chars);
+	      else
+		findDots (header, guard->attributes, &cells);
+	    }
+	}
+    }
+  if (cells.count)
+    findCharacters (header, 0, &cells, chars);
+  free (cells.chars);
+}
+
+static void
+findLetters (const TranslationTableHeader * header, CharList * letters)
+{
+  const TranslationTableCharacter *character;
+  TranslationTableOffset offset;
+  int k;
+  for (k = 0; k < HASHNUM; k++)
+    for (offset = header->characters[k]; offset; offset = character->next)
+      {
+	character = characterAt (header, offset);
+	if ((character->attributes & CTC_Letter)
+	    && !(character->attributes & CTC_UpperCase))
+	  addChar (letters, character->realchar);
+      }
+  if (!letters->count)
+    for (k = 'a'; k <= 'z'; k++)
+      addChar (letters, k);
+}
+
+static int
+addRandomChars (widechar * text, int length, const CharList * chars,
+		int count)
+{
+/* Put count characters picked from chars at the end of the text of
+ * length characters, as far as ADVERSARIALLENGTH, and return the new
+ * length */
+  while (count-- > 0 && length < ADVERSARIALLENGTH)
+    text[length++] = chars->chars[randomNumber (chars->count)];
+  return length;
+}
+
+static void
+findRules (const TranslationTableHeader * header,
+	   TranslationTableOffset offset, TranslationTableOpcode opcode,
+	   OffsetList * rules)
+{
+/* Add to rules the rules of the chain from offset, or those of opcode
+ * if it is not CTO_None */
+  const TranslationTableRule *rule;
+  for (; offset; offset = rule->charsnext)
+    {
+      rule = ruleAt (header, offset);
+      if (opcode == CTO_None || rule->opcode == opcode)
+	addOffset (rules, offset);
+    }
+}
+
+static void
+makeChainTexts (const TranslationTableHeader * header, Texts * texts)
+{
+/* Runs of the characters of the rules in the busiest forRules chains,
+ * for a rule of more than two all but the last, so that the whole
+ * chain is gone through at each of them and most rules just miss */
+  const TranslationTableOffset *chains;
+  const TranslationTableRule *rule;
+  TranslationTableOffset busiest[BUSIESTCHAINS];
+  int lengths[BUSIESTCHAINS];
+  OffsetList rules = { NULL, 0, 0 };
+  widechar text[ADVERSARIALLENGTH];
+  TranslationTableOffset offset;
+  int count, length, numBusiest = 0, k, j, t;
+  chains = forRuleChains (header, &count);
+  for (k = 0; k < count; k++)
+    {
+      for (length = 0, offset = chains[k]; offset; length++)
+	offset = ruleAt (header, offset)->charsnext;
+      if (!length)
+	continue;
+      /* Keep the busiest in order, longest first */
+      if (numBusiest < BUSIESTCHAINS)
+	numBusiest++;
+      else if (length <= lengths[numBusiest - 1])
+	continue;
+      for (j = numBusiest - 1; j > 0 && lengths[j - 1] < length; j--)
+	{
+	  lengths[j] = lengths[j - 1];
+	  busiest[j] = busiest[j - 1];
+	}
+      lengths[j] = length;
+      busiest[j] = chains[k];
+    }
+  for (k = 0; k < numBusiest; k++)
+    findRules (header, busiest[k], CTO_None, &rules);
+  for (t = 0; rules.count && t < ADVERSARIALTEXTS; t++)
+    {
+      for (length = 0; length < ADVERSARIALLENGTH;)
+	{
+	  rule = ruleAt (header, rules.offsets[randomNumber (rules.count)]);
+	  count = rule->charslen > 2 ? rule->charslen - 1 : rule->charslen;
+	  for (k = 0; k < count && length < ADVERSARIALLENGTH; k++)
+	    text[length++] = rule->charsdots[k];
+	}
+      addText (texts, text, length);
+    }
+  free (rules.offsets);
+}
+
+static void
+makeCharTexts (const CharList * chars, Texts * texts)
+{
+/* Runs of characters picked from chars, without a space */
+  widechar text[ADVERSARIALLENGTH];
+  int t;
+  for (t = 0; chars->count && t < ADVERSARIALTEXTS; t++)
+    addText (texts, text, addRandomChars (text, 0, chars,
+					  ADVERSARIALLENGTH));
+}
+
+static int
+addWords (widechar * text, int length, const CharList * letters, int end)
+{
+/* Put words of two to nine letters after the text up to end */
+  while (length < end)
+    {
+      length = addRandomChars (text, length, letters, 2 + randomNumber (8));
+      if (length < end)
+	text[length++] = ' ';
+    }
+  return length;
+}
+
+static void
+makeEmphasisTexts (const CharList * letters, Texts * texts)
+{
+/* Words whose emphasis is different at every character */
+  static const formtype emphases[] = { italic, underline, bold,
+    plain_text
+  };
+  widechar text[ADVERSARIALLENGTH];
+  Text *added;
+  int length, k, t;
+  for (t = 0; t < ADVERSARIALTEXTS; t++)
+    {
+      length = addWords (text, 0, letters, ADVERSARIALLENGTH);
+      added = addText (texts, text, length);
+      added->spans = allocate (NULL, length * sizeof (louEmphasisSpan));
+      for (k = 0; k < length; k++)
+	if (emphases[(k + t) % 4] != plain_text)
+	  {
+	    added->spans[added->numSpans].start = k;
+	    added->spans[added->numSpans].length = 1;
+	    added->spans[added->numSpans++].emphasis = emphases[(k + t) % 4];
+	  }
+    }
+}
+
+static void
+makeCompbrlTexts (const TranslationTableHeader * header,
+		  const CharList * letters, Texts * texts)
+{
+/* Computer braille which goes on to the end of the text: a word made of
+ * letters and the characters of the compbrl rules of the table, which
+ * has no space to end it, and words in computer braille from somewhere
+ * in the first half of the text on */
+  const TranslationTableCharacter *character;
+  const TranslationTableRule *rule;
+  const TranslationTableOffset *chains;
+  OffsetList rules = { NULL, 0, 0 };
+  widechar text[ADVERSARIALLENGTH];
+  TranslationTableOffset offset;
+  Text *added;
+  int count, length, start, k, t;
+  chains = forRuleChains (header, &count);
+  for (k = 0; k < count; k++)
+    findRules (header, chains[k], CTO_CompBrl, &rules);
+  for (k = 0; k < HASHNUM; k++)
+    for (offset = header->characters[k]; offset; offset = character->next)
+      {
+	character = characterAt (header, offset);
+	findRules (header, character->otherRules, CTO_CompBrl, &rules);
+      }
+  for (t = 0; t < ADVERSARIALTEXTS; t++)
+    {
+      if (rules.count && t % 2 == 0)
+	{
+	  for (length = 0; length < ADVERSARIALLENGTH;)
+	    {
+	      length = addRandomChars (text, length, letters,
+				       2 + randomNumber (5));
+	      rule = ruleAt (header, rules.offsets[randomNumber (rules.count)]);
+	      for (k = 0; k < rule->charslen && length < ADVERSARIALLENGTH;
+		   k++)
+		text[length++] = rule->charsdots[k];
+	    }
+	  addText (texts, text, length);
+	  continue;
+	}
+      length = addWords (text, 0, letters, ADVERSARIALLENGTH);
+      start = randomNumber (length / 2);
+      added = addText (texts, text, length);
+      added->spans = allocate (NULL, sizeof (louEmphasisSpan));
+      added->spans[0].start = start;
+      added->spans[0].length = length - start;
+      added->spans[0].emphasis = computer_braille;
+      added->numSpans = 1;
+    }
+  free (rules.offsets);
+}
+
+static void
+benchmarkAdversarial (const char *tableList)
+{
+/* Measure the calls on texts made from the table to be slow for it,
+ * some of each kind, named in the corpus field. The latencies are per
+ * character. */
+  const louTable *table = openBenchmarkTable (tableList);
+  const TranslationTableHeader *header = getTableFromHandle (table);
+  Texts lines = { NULL, 0, 0, 0 };
+  Texts words = { NULL, 0, 0, 0 };
+  CharList letters = { NULL, 0, 0 };
+  CharList chars = { NULL, 0, 0 };
+  int kind;
+  randomState = 1;
+  findLetters (header, &letters);
+  for (kind = 0; kind < NUMKINDS; kind++)
+    {
+      switch (kind)
+	{
+	case CHAINS:
+	  makeChainTexts (header, &lines);
+	  break;
+	case PASSES:
+	case SWAPS:
+	  chars.count = 0;
+	  findPassChars (header, kind == SWAPS, &chars);
+	  makeCharTexts (&chars, &lines);
+	  break;
+	case EMPHASIS:
+	  makeEmphasisTexts (&letters, &lines);
+	  break;
+	default:
+	  makeCompbrlTexts (header, &letters, &lines);
+	  break;
+	}
+      /* A table may have nothing of a kind */
+      if (lines.count)
+	measureTexts (tableList, kindNames[kind], table, &lines, &words);
+      freeTexts (&lines);
+    }
+  free (letters.chars);
+  free (chars.chars);
+  lou_closeTable (table);
+}
+
+static void
+runSuite (const char *suite)
+{
+/* Each line of the suite is a table list and a corpus, which is looked
+ * for in the directory of the suite. Empty lines and lines beginning
+ * with # are left out. With adversarial_flag only the table lists are
+ * used. */
+  FILE *file;
+  char line[MAXSTRING];
+  char *tableList, *corpus, *path;
+  const char *slash;
+  int dirLength;
+  if (!(file = fopen (suite, "r")))
+    {
+      fprintf (stderr, "%s: cannot open %s\n", program_name, suite);
+      exit (EXIT_FAILURE);
+    }
+  slash = strrchr (suite, '/');
+#ifdef _WIN32
+  if (strrchr (suite, '\\') > slash)
+    slash = strrchr (suite, '\\');
+#endif
+  dirLength = slash ? slash - suite + 1 : 0;
+  while (fgets (line, sizeof (line), file))
+    {
+      if (line[0] == '#' || !(tableList = strtok (line, " \t\r\n"))
+	  || !(corpus = strtok (NULL, " \t\r\n")))
+	continue;
+      path = allocate (NULL, dirLength + strlen (corpus) + 1);
+      memcpy (path, suite, dirLength);
+      strcpy (path + dirLength, corpus);
+      if (adversarial_flag)
+	benchmarkAdversarial (tableList);
+      else
+	benchmark (tableList, corpus, path);
+      free (path);
+    }
+  fclose (file);
+}
+
+static long
+peakMemory (void)
+{
+/* The peak resident set size of the process in kilobytes, or 0 where
+ * it is not known */
+#ifndef _WIN32
+  struct rusage usage;
+  if (!getrusage (RUSAGE_SELF, &usage))
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+  return 0;
+}
+
+static void
+printCompileResult (const char *tableList, int runs, double seconds,
+		    const double *phaseTime, long bytesUsed)
+{
+  int k;
+  if (json_flag)
+    printf ("%s  { ", results ? ",\n" : "[\n");
+  printField ("table", tableList, 0);
+  if (json_flag)
+    {
+      printf ("\"runs\": %d, \"milliseconds\": %.3f, ", runs,
+	      seconds * 1000);
+      for (k = 0; k < PROFILE_PHASES; k++)
+	printf ("\"%s\": %.3f, ", phaseNames[k], phaseTime[k] * 1000);
+      printf ("\"bytesUsed\": %ld, \"peakRss\": %ld }", bytesUsed,
+	      peakMemory ());
+    }
+  else
+    {
+      printf ("%d\t%.3f", runs, seconds * 1000);
+      for (k = 0; k < PROFILE_PHASES; k++)
+	printf ("\t%.3f", phaseTime[k] * 1000);
+      printf ("\t%ld\t%ld\n", bytesUsed, peakMemory ());
+    }
+  results++;
+  fflush (stdout);
+}
+
+static double totalSeconds;
+static double totalPhaseTime[PROFILE_PHASES];
+static long totalBytes;
+static int totalRuns;
+
+static int
+benchmarkCompilation (const char *tableList, const char *name)
+{
+/* Compile the table from nothing, again and again until min_seconds
+ * have been spent, and report the mean time of a compilation and of
+ * each phase of it. Without images_flag the table source is always
+ * compiled and profiled, with it an up to date image is mapped. */
+  CompileProfile profile;
+  louTableStats stats;
+  const louTable *table;
+  double start, seconds = 0;
+  int runs = 0, k;
+  memset (&profile, 0, sizeof (profile));
+  memset (&stats, 0, sizeof (stats));
+  do
+    {
+      lou_free ();
+      if (!images_flag)
+	profileCompilation (&profile);
+      start = now ();
+      table = lou_openTable (tableList);
+      seconds += now () - start;
+      profileCompilation (NULL);
+      runs++;
+      if (!table)
+	{
+	  fprintf (stderr, "%s: %s cannot be compiled\n", program_name,
+		   tableList);
+	  freeCompileProfile (&profile);
+	  lou_free ();
+	  return 0;
+	}
+      lou_getTableStats (table, &stats);
+      lou_closeTable (table);
+    }
+  while (seconds < min_seconds);
+  for (k = 0; k < PROFILE_PHASES; k++)
+    {
+      profile.phaseTime[k] /= runs;
+      totalPhaseTime[k] += profile.phaseTime[k];
+    }
+  totalSeconds += seconds / runs;
+  totalBytes += stats.bytesUsed;
+  totalRuns += runs;
+  printCompileResult (name, runs, seconds / runs, profile.phaseTime,
+		      stats.bytesUsed);
+  freeCompileProfile (&profile);
+  lou_free ();
+  return 1;
+}
+
+static int
+compareNames (const void *a, const void *b)
+{
+  return strcmp (*(char *const *) a, *(char *const *) b);
+}
+
+static int
+benchmarkDirectory (const char *dirName)
+{
+/* Compile each .ctb and .utb file of the directory, in the order of
+ * their names, like tests/check_all_tables.pl */
+  DIR *dir;
+  struct dirent *file;
+  char **names = NULL;
+  char *path;
+  int numNames = 0, length, ok = 1, k;
+  if (!(dir = opendir (dirName)))
+    {
+      fprintf (stderr, "%s: cannot open %s\n", program_name, dirName);
+      return 0;
+    }
+  while ((file = readdir (dir)))
+    {
+      length = strlen (file->d_name);
+      if (length < 4 || (strcmp (file->d_name + length - 4, ".ctb")
+			 && strcmp (file->d_name + length - 4, ".utb")))
+	continue;
+      names = allocate (names, (numNames + 1) * sizeof (char *));
+      names[numNames] = allocate (NULL, length + 1);
+      strcpy (names[numNames++], file->d_name);
+    }
+  closedir (dir);
+  qsort (names, numNames, sizeof (char *), compareNames);
+  for (k = 0; k < numNames; k++)
+    {
+      path = allocate (NULL, strlen (dirName) + strlen (names[k]) + 2);
+      sprintf (path, "%s/%s", dirName, names[k]);
+      if (!benchmarkCompilation (path, names[k]))
+	ok = 0;
+      free (path);
+      free (names[k]);
+    }
+  free (names);
+  return ok;
+}
+
+static int
+benchmarkCompilations (char **tables, int numTables)
+{
+/* Each of the tables may also be a directory of tables. Without any,
+ * those of the first directory of LOUIS_TABLEPATH are compiled. */
+  char *dirName = NULL;
+  const char *path;
+  struct stat info;
+  int ok = 1, k;
+  if (!json_flag)
+    {
+      printf ("table\truns\tms");
+      for (k = 0; k < PROFILE_PHASES; k++)
+	printf ("\t%s_ms", phaseNames[k]);
+      printf ("\tbytes_used\tpeak_rss_kb\n");
+    }
+  if (!numTables)
+    {
+      if (!(path = getenv ("LOUIS_TABLEPATH")) || !*path)
+	{
+	  fprintf (stderr, "%s: no tables specified and "
+		   "LOUIS_TABLEPATH is not set\n", program_name);
+	  exit (EXIT_FAILURE);
+	}
+      dirName = allocate (NULL, strlen (path) + 1);
+      strcpy (dirName, path);
+      if (strchr (dirName, ','))
+	*strchr (dirName, ',') = 0;
+      tables = &dirName;
+      numTables = 1;
+    }
+  for (k = 0; k < numTables; k++)
+    if (stat (tables[k], &info) == 0 && S_ISDIR (info.st_mode))
+      ok &= benchmarkDirectory (tables[k]);
+    else
+      ok &= benchmarkCompilation (tables[k], tables[k]);
+  free (dirName);
+  printCompileResult ("total", totalRuns, totalSeconds, totalPhaseTime,
+		      totalBytes);
+  return ok;
+}
+
+static int
+parseMeasures (char *list)
+{
+  char *name;
+  int k, found = 0;
+  for (name = strtok (list, ","); name; name = strtok (NULL, ","))
+    {
+      for (k = 0; k < NUMMEASURES; k++)
+	if (!strcmp (name, measureNames[k]))
+	  break;
+      if (k == NUMMEASURES)
+	{
+	  fprintf (stderr, "%s: unknown measure %s\n", program_name, name);
+	  exit (EXIT_FAILURE);
+	}
+      found |= 1 << k;
+    }
+  return found;
+}
+
+static void
+print_help (void)
+{
+  printf ("\
+Usage: %s [OPTIONS] TABLE[,TABLE,...] FILE...\n\
+  or:  %s [OPTIONS] --suite=SUITE\n\
+  or:  %s --adversarial [OPTIONS] TABLE[,TABLE,...]...|--suite=SUITE\n\
+  or:  %s --compile [OPTIONS] [TABLE[,TABLE,...]|DIRECTORY...]\n",
+	  program_name, program_name, program_name, program_name);
+
+  fputs ("\
+Measure how fast the table translates, back-translates, hyphenates and\n\
+turns into dots the lines of each UTF-8 FILE, or of each file listed in\n\
+SUITE with its table. For each measure the number of calls, the\n\
+characters done, the seconds spent in the calls, the characters per\n\
+second and the 50th, 90th and 99th percentile and the longest latency of\n\
+a call in microseconds are written as a line of tab-separated fields,\n\
+after a line of their names.\n\n", stdout);
+
+  fputs ("\
+With --adversarial, translate and back-translate texts made from each\n\
+table to be slow for it instead of files, a kind at a time: runs of the\n\
+characters of the rules in its busiest hash chains (chains), of those at\n\
+which pass rules testing a class (passes) or a swap set (swaps) are\n\
+tried, words whose emphasis changes at every character (emphasis) and\n\
+computer braille with no end (compbrl). The kind is written as the\n\
+file, and the latencies are in nanoseconds per character.\n\n", stdout);
+
+  fputs ("\
+With --compile, compile each table, or each .ctb and .utb table of each\n\
+DIRECTORY, or of the first directory of LOUIS_TABLEPATH if none is\n\
+given, and write the number of compilations, the mean milliseconds of\n\
+one, of reading the files, of finding included files, of parsing rules,\n\
+of inserting them and of finishing the table, the bytes used by the\n\
+table and the peak resident set size in kilobytes so far.\n\n", stdout);
+
+  fputs ("\
+  -h, --help          display this help and exit\n\
+  -v, --version       display version information and exit\n\
+  -s, --suite=SUITE   benchmark each table and file listed in SUITE\n\
+  -t, --time=SECONDS  spend at least SECONDS on each measure (default 1,\n\
+                        or 0 with --compile, which compiles once)\n\
+  -m, --measure=LIST  only the comma-separated measures of LIST, of\n\
+                        forward, backward, hyphenate and charToDots\n\
+  -j, --json          write the results as a JSON array of objects\n\
+  -c, --compile       measure compiling tables instead of using them\n\
+  -i, --images        with --compile, map up to date compiled images\n\
+                        instead of compiling the table source\n\
+  -a, --adversarial   measure the worst cases of each table instead of\n\
+                        the files\n", stdout);
+  printf ("\n");
+  printf ("Report bugs to %s.\n", PACKAGE_BUGREPORT);
+
+#ifdef PACKAGE_PACKAGER_BUG_REPORTS
+  printf ("Report %s bugs to: %s\n", PACKAGE_PACKAGER, PACKAGE_PACKAGER_BUG_REPORTS);
+#endif
+#ifdef PACKAGE_URL
+  printf ("%s home page: <%s>\n", PACKAGE_NAME, PACKAGE_URL);
+#endif
+}
+
+int
+main (int argc, char **argv)
+{
+  int optc, k, time_flag = 0, ok;
+
+  set_program_name (argv[0]);
+
+  while ((optc = getopt_long (argc, argv, "hvs:t:m:jcia", longopts, NULL))
+	 != -1)
+    switch (optc)
+      {
+      /* --help and --version exit immediately, per GNU coding standards.  */
+      case 'v':
+        version_etc (stdout, program_name, PACKAGE_NAME, VERSION, AUTHORS, (char *) NULL);
+        exit (EXIT_SUCCESS);
+        break;
+      case 'h':
+        print_help ();
+        exit (EXIT_SUCCESS);
+        break;
+      case 's':
+	suite_name = optarg;
+	break;
+      case 't':
+	min_seconds = atof (optarg);
+	time_flag = 1;
+	break;
+      case 'm':
+	measures = parseMeasures (optarg);
+	break;
+      case 'j':
+	json_flag = 1;
+	break;
+      case 'c':
+	compile_flag = 1;
+	break;
+      case 'i':
+	images_flag = 1;
+	break;
+      case 'a':
+	adversarial_flag = 1;
+	break;
+      default:
+	fprintf (stderr, "Try `%s --help' for more information.\n",
+		 program_name);
+	exit (EXIT_FAILURE);
+        break;
+      }
+
+  if (compile_flag)
+    {
+      if (!time_flag)
+	min_seconds = 0;
+      /* The table source is compiled unless images are asked for */
+      enableCompiledTables (images_flag);
+      ok = benchmarkCompilations (&argv[optind], argc - optind);
+      if (json_flag)
+	printf ("\n]\n");
+      lou_free ();
+      return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+  if (suite_name == NULL && optind + (adversarial_flag ? 1 : 2) > argc)
+    {
+      fprintf (stderr, adversarial_flag ? "%s: no table specified\n"
+	       : "%s: no table and file specified\n", program_name);
+      fprintf (stderr, "Try `%s --help' for more information.\n",
+               program_name);
+      exit (EXIT_FAILURE);
+    }
+
+  if (!json_flag && adversarial_flag)
+    printf ("table\tcorpus\tmeasure\tcalls\tchars\tseconds\t"
+	    "chars_per_second\tp50_ns_per_char\tp90_ns_per_char\t"
+	    "p99_ns_per_char\tmax_ns_per_char\n");
+  else if (!json_flag)
+    printf ("table\tcorpus\tmeasure\tcalls\tchars\tseconds\t"
+	    "chars_per_second\tp50_us\tp90_us\tp99_us\tmax_us\n");
+  if (suite_name != NULL)
+    runSuite (suite_name);
+  else if (adversarial_flag)
+    for (k = optind; k < argc; k++)
+      benchmarkAdversarial (argv[k]);
+  else
+    for (k = optind + 1; k < argc; k++)
+      benchmark (argv[optind], argv[k], argv[k]);
+  if (json_flag)
+    printf (results ? "\n]\n" : "[]\n");
+  lou_free ();
+  return EXIT_SUCCESS;
+}
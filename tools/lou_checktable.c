@@ -26,6 +26,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
 #include "louis.h"
 #include <getopt.h>
 #include "progname.h"
@@ -36,6 +39,11 @@ static const struct option longopts[] =
   { "help", no_argument, NULL, 'h' },
   { "version", no_argument, NULL, 'v' },
   { "quiet", no_argument, NULL, 'q' },
+  { "save", required_argument, NULL, 's' },
+  { "profile", no_argument, NULL, 'p' },
+  { "stats", no_argument, NULL, 'S' },
+  { "corpus", required_argument, NULL, 'c' },
+  { "jobs", required_argument, NULL, 'j' },
   { NULL, 0, NULL, 0 }
 };
 
@@ -45,23 +53,46 @@ const char version_etc_copyright[] =
 #define AUTHORS "John J. Boyer"
 
 static int quiet_flag = 0;
+static int profile_flag = 0;
+static int stats_flag = 0;
+static const char *save_file = NULL;
+static const char *corpus_file = NULL;
+static int jobs = 0;
 
 static void
 print_help (void)
 {
   printf ("\
-Usage: %s [OPTIONS] TABLE[,TABLE,...]\n", program_name);
+Usage: %s [OPTIONS] TABLE[,TABLE,...] [TABLE[,TABLE,...]|DIRECTORY...]\n",
+	  program_name);
   
   fputs ("\
 Test a Braille translation table. If the table contains errors,\n\
 appropriate messages are displayed. If there are no errors the\n\
 message \"no errors found.\" is shown unless you specify the --quiet\n\
-option.\n", stdout);
+option. With --save the compiled table is also written to FILE,\n\
+so that it can be mapped instead of compiled next time. With\n\
+--profile the time and table space taken by each file, by each\n\
+family of rules and by each phase of compilation are shown. With\n\
+--stats the lengths of the hash chains of rules, characters and dots\n\
+and the beginnings of the entries of the longest chains are shown,\n\
+and with --corpus also how many rules forward translation of the\n\
+text in FILE tries for each character. Given more than one table,\n\
+or a directory, whose .ctb and .utb files are then all checked, the\n\
+tables are compiled at the same time by several threads and the\n\
+result and the time taken are shown for each.\n", stdout);
 
   fputs ("\
   -h, --help          display this help and exit\n\
   -v, --version       display version information and exit\n\
-  -q, --quiet         do not write to standard error if there are no errors.\n", stdout);
+  -q, --quiet         do not write to standard error if there are no errors.\n\
+  -s, --save=FILE     write the compiled table to FILE\n\
+  -p, --profile       show where the time goes while compiling\n\
+  -S, --stats         show how evenly the hash chains are filled\n\
+  -c, --corpus=FILE   with --stats, translate the UTF-8 text in FILE\n\
+                      and count the rules tried\n\
+  -j, --jobs=N        compile N tables at a time, by default one for\n\
+                      each processor\n", stdout);
 
   printf ("\n");
   printf ("Report bugs to %s.\n", PACKAGE_BUGREPORT);
@@ -74,15 +105,248 @@ option.\n", stdout);
 #endif
 }
 
+static const char *phase_names[PROFILE_PHASES] = {
+  "reading", "resolving", "parsing", "inserting", "finishing"
+};
+
+static const char *family_names[PROFILE_FAMILIES] = {
+  "characters", "translation rules", "multipass rules", "hyphenation",
+  "other"
+};
+
+static void
+print_profile (const CompileProfile *profile)
+{
+  double total = 0;
+  int k;
+  for (k = 0; k < PROFILE_PHASES; k++)
+    total += profile->phaseTime[k];
+  if (total <= 0)
+    total = 1;
+  printf ("%10s %10s %8s  %s\n", "ms", "bytes", "rules",
+	  "file (not counting the files it includes)");
+  for (k = 0; k < profile->numFiles; k++)
+    printf ("%10.3f %10d %8d  %s\n", profile->files[k].time * 1000,
+	    profile->files[k].bytes, profile->files[k].rules,
+	    profile->files[k].fileName);
+  printf ("\n%10s %10s %8s  %s\n", "ms", "bytes", "rules", "family");
+  for (k = 0; k < PROFILE_FAMILIES; k++)
+    printf ("%10.3f %10d %8d  %s\n", profile->familyTime[k] * 1000,
+	    profile->familyBytes[k], profile->familyRules[k],
+	    family_names[k]);
+  printf ("\n%10s %10s  %s\n", "ms", "share", "phase");
+  for (k = 0; k < PROFILE_PHASES; k++)
+    printf ("%10.3f %9.1f%%  %s\n", profile->phaseTime[k] * 1000,
+	    100 * profile->phaseTime[k] / total, phase_names[k]);
+}
+
+/* The chains shown for each kind */
+#define WORST_CHAINS 5
+
+static const char *chain_names[4] = {
+  "forward rules", "backward rules", "characters", "dots"
+};
+
+static void
+print_prefix (const widechar *prefix, int kind)
+{
+  int length = prefix[1] ? 2 : 1;
+  if (kind == 1 || kind == 3)
+    printf ("%s", showDots (prefix, length));
+  else
+    printf ("%s", showString (prefix, length));
+}
+
+static void
+print_chains (const TranslationTableHeader *table, const louTableStats *stats)
+{
+  const int *histograms[4] = {
+    stats->forRuleChains, stats->backRuleChains, stats->characterChains,
+    stats->dotsChains
+  };
+  const int longest[4] = {
+    stats->longestForRuleChain, stats->longestBackRuleChain,
+    stats->longestCharacterChain, stats->longestDotsChain
+  };
+  ChainReport chains[WORST_CHAINS];
+  double mean;
+  int kind, k, j, n;
+  printf ("%-15s %7s %7s %6s", "chains of", "longest", "mean", "empty");
+  for (k = 1; k < LOU_CHAINLENGTHS; k++)
+    printf (k < LOU_CHAINLENGTHS - 1 ? " %6d" : " %5d+", k);
+  printf ("\n");
+  for (kind = 0; kind < 4; kind++)
+    {
+      worstChains (table, kind, chains, 1, &mean);
+      printf ("%-15s %7d %7.2f", chain_names[kind], longest[kind], mean);
+      for (k = 0; k < LOU_CHAINLENGTHS; k++)
+	printf (" %6d", histograms[kind][k]);
+      printf ("\n");
+    }
+  for (kind = 0; kind < 4; kind++)
+    {
+      n = worstChains (table, kind, chains, WORST_CHAINS, NULL);
+      if (!n)
+	continue;
+      printf ("\nlongest chains of %s, with the most common beginnings of "
+	      "their entries\n", chain_names[kind]);
+      for (k = 0; k < n; k++)
+	{
+	  printf ("%7d", chains[k].length);
+	  for (j = 0; j < CHAINPREFIXES && chains[k].prefixCounts[j]; j++)
+	    {
+	      printf (j ? ", " : "  ");
+	      print_prefix (chains[k].prefixes[j], kind);
+	      printf (" %d", chains[k].prefixCounts[j]);
+	    }
+	  if (chains[k].numPrefixes > CHAINPREFIXES)
+	    printf (" and %d more", chains[k].numPrefixes - CHAINPREFIXES);
+	  printf ("\n");
+	}
+    }
+}
+
+static int
+print_corpus (const louTable *table)
+{
+/* The rules forward translation of the corpus tries for each character */
+  louRuleProfile profile;
+  FILE *file;
+  char line[4096];
+  char outbuf[4 * sizeof (line)];
+  unsigned long characters = 0, tried = 0, applied = 0;
+  int inlen, outlen, k;
+  if (!(file = fopen (corpus_file, "r")))
+    {
+      fprintf (stderr, "%s: %s cannot be read\n", program_name, corpus_file);
+      return 0;
+    }
+  lou_resetRuleProfile (table);
+  while (fgets (line, sizeof (line), file))
+    {
+      inlen = strlen (line);
+      if (inlen && line[inlen - 1] == '\n')
+	line[--inlen] = 0;
+      outlen = sizeof (outbuf);
+      if (!lou_translateUtf8 (table, NULL, line, &inlen, outbuf, &outlen,
+			      NULL, NULL, 0))
+	continue;
+      for (k = 0; k < inlen; k++)
+	if ((line[k] & 0xc0) != 0x80)
+	  characters++;
+    }
+  fclose (file);
+  if (!lou_getRuleProfile (table, &profile))
+    return 0;
+  for (k = 0; k < profile.numRules; k++)
+    {
+      tried += profile.rules[k].tried;
+      applied += profile.rules[k].applied;
+    }
+  lou_freeRuleProfile (&profile);
+  printf ("\n%lu characters of %s translated, %.2f rules tried and %.2f "
+	  "applied for each\n", characters, corpus_file,
+	  characters ? (double) tried / characters : 0,
+	  characters ? (double) applied / characters : 0);
+  return 1;
+}
+
+static void *
+allocate (void *block, size_t size)
+{
+  if (!(block = realloc (block, size)))
+    {
+      fprintf (stderr, "%s: out of memory\n", program_name);
+      exit (EXIT_FAILURE);
+    }
+  return block;
+}
+
+static int
+compare_names (const void *a, const void *b)
+{
+  return strcmp (*(char *const *) a, *(char *const *) b);
+}
+
+static int
+add_table (char ***tables, int numTables, const char *name)
+{
+  *tables = allocate (*tables, (numTables + 1) * sizeof (char *));
+  (*tables)[numTables] = allocate (NULL, strlen (name) + 1);
+  strcpy ((*tables)[numTables], name);
+  return numTables + 1;
+}
+
+static int
+add_directory (char ***tables, int numTables, const char *dirName)
+{
+/* Add each .ctb and .utb file of the directory, in the order of their
+ * names, like tests/check_all_tables.pl */
+  DIR *dir;
+  struct dirent *file;
+  char *path;
+  int first = numTables, length;
+  if (!(dir = opendir (dirName)))
+    {
+      fprintf (stderr, "%s: cannot open %s\n", program_name, dirName);
+      return -1;
+    }
+  while ((file = readdir (dir)))
+    {
+      length = strlen (file->d_name);
+      if (length < 4 || (strcmp (file->d_name + length - 4, ".ctb")
+			 && strcmp (file->d_name + length - 4, ".utb")))
+	continue;
+      path = allocate (NULL, strlen (dirName) + length + 2);
+      sprintf (path, "%s/%s", dirName, file->d_name);
+      numTables = add_table (tables, numTables, path);
+      free (path);
+    }
+  closedir (dir);
+  qsort (*tables + first, numTables - first, sizeof (char *),
+	 compare_names);
+  return numTables;
+}
+
+static int
+check_tables (char **tables, int numTables)
+{
+/* Compile all the tables at once, sharing the files they include */
+  int *results = allocate (NULL, numTables * sizeof (int));
+  double *seconds = allocate (NULL, numTables * sizeof (double));
+  double elapsed = currentTime ();
+  int failed, k;
+  failed = numTables - lou_compileTables ((const char **) tables,
+					  numTables, jobs, results,
+					  seconds);
+  elapsed = currentTime () - elapsed;
+  for (k = 0; k < numTables; k++)
+    if (!quiet_flag || !results[k])
+      printf ("%-6s %10.1f ms  %s\n", results[k] ? "ok" : "FAILED",
+	      seconds[k] * 1000, tables[k]);
+  if (failed)
+    fprintf (stderr, "%d of %d tables have errors.\n", failed, numTables);
+  else if (quiet_flag == 0)
+    fprintf (stderr, "No errors found in %d tables, %.1f s.\n",
+	     numTables, elapsed);
+  free (results);
+  free (seconds);
+  return !failed;
+}
+
 int
 main (int argc, char **argv)
 {
   const TranslationTableHeader *table;
-  int optc;
+  CompileProfile profile;
+  struct stat info;
+  char **tables = NULL;
+  int numTables = 0, ok, optc, k;
 
   set_program_name (argv[0]);
+  memset (&profile, 0, sizeof (profile));
 
-  while ((optc = getopt_long (argc, argv, "hvq", longopts, NULL)) != -1)
+  while ((optc = getopt_long (argc, argv, "hvqps:Sc:j:", longopts, NULL)) != -1)
     switch (optc)
       {
       /* --help and --version exit immediately, per GNU coding standards.  */
@@ -97,6 +361,21 @@ main (int argc, char **argv)
       case 'q':
 	quiet_flag = 1;
         break;
+      case 's':
+	save_file = optarg;
+        break;
+      case 'p':
+	profile_flag = 1;
+        break;
+      case 'S':
+	stats_flag = 1;
+        break;
+      case 'c':
+	corpus_file = optarg;
+        break;
+      case 'j':
+	jobs = atoi (optarg);
+        break;
       default:
 	fprintf (stderr, "Try `%s --help' for more information.\n",
 		 program_name);
@@ -104,21 +383,73 @@ main (int argc, char **argv)
         break;
       }
 
-  if (optind != argc - 1)
+  if (optind == argc)
     {
       /* Print error message and exit.  */
-      if (optind < argc - 1)
-	fprintf (stderr, "%s: extra operand: %s\n",
-		 program_name, argv[optind + 1]);
-      else
-	fprintf (stderr, "%s: no table specified\n", 
-		 program_name);
+      fprintf (stderr, "%s: no table specified\n", 
+	       program_name);
       fprintf (stderr, "Try `%s --help' for more information.\n",
                program_name);
       exit (EXIT_FAILURE);
     }
 
-  if (!(table = lou_getTable (argv[optind])))
+  /* Check the table source, not an image saved earlier */
+  enableCompiledTables (0);
+  if (optind < argc - 1
+      || (stat (argv[optind], &info) == 0 && S_ISDIR (info.st_mode)))
+    {
+      if (profile_flag || stats_flag || save_file)
+	{
+	  fprintf (stderr, "%s: --profile, --stats and --save take a "
+		   "single table\n", program_name);
+	  exit (EXIT_FAILURE);
+	}
+      for (k = optind; k < argc && numTables >= 0; k++)
+	if (stat (argv[k], &info) == 0 && S_ISDIR (info.st_mode))
+	  numTables = add_directory (&tables, numTables, argv[k]);
+	else
+	  numTables = add_table (&tables, numTables, argv[k]);
+      ok = numTables > 0 && check_tables (tables, numTables);
+      if (numTables == 0)
+	fprintf (stderr, "%s: no tables found\n", program_name);
+      for (k = 0; k < numTables; k++)
+	free (tables[k]);
+      free (tables);
+      lou_free ();
+      exit (ok ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+  if (profile_flag)
+    profileCompilation (&profile);
+  /* The rules tried on the corpus are counted by rule profiling */
+  if (stats_flag && corpus_file)
+    lou_setRuleProfiling (1);
+  table = lou_getTable (argv[optind]);
+  profileCompilation (NULL);
+  if (!table)
+    {
+      freeCompileProfile (&profile);
+      lou_free ();
+      exit (EXIT_FAILURE);
+    }
+  if (profile_flag)
+    print_profile (&profile);
+  freeCompileProfile (&profile);
+  if (stats_flag)
+    {
+      const louTable *handle = lou_openTable (argv[optind]);
+      louTableStats stats;
+      lou_getTableStats (handle, &stats);
+      print_chains (table, &stats);
+      if (corpus_file && !print_corpus (handle))
+	{
+	  lou_closeTable (handle);
+	  lou_free ();
+	  exit (EXIT_FAILURE);
+	}
+      lou_setRuleProfiling (0);
+      lou_closeTable (handle);
+    }
+  if (save_file && !lou_saveCompiledTable (argv[optind], save_file))
     {
       lou_free ();
       exit (EXIT_FAILURE);
@@ -0,0 +1,384 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   */
+
+# include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#include "liblouis.h"
+#include "louis.h"
+#include "daemon.h"
+#include "progname.h"
+#include "version-etc.h"
+
+static int quiet_flag = 0;
+
+static const struct option longopts[] =
+{
+  { "help", no_argument, NULL, 'h' },
+  { "version", no_argument, NULL, 'v' },
+  { "quiet", no_argument, NULL, 'q' },
+  { NULL, 0, NULL, 0 }
+};
+
+const char version_etc_copyright[] =
+  "Copyright %s %d by the liblouis team.";
+
+#define AUTHORS "the liblouis team"
+
+typedef struct
+{
+  int socket;
+  louContext *ctx;
+  char tableList[DAEMON_MAXTABLELIST + 1];	/*of the last request */
+  const louTable *table;
+  char *text;
+  int textSize;
+  char *output;
+  int outputSize;
+} Client;
+
+static int
+readFully (int fd, void *buffer, int length)
+{
+/* Returns 1 when all of length bytes were read, 0 at the end of the
+ * connection or on an error. */
+  char *bytes = buffer;
+  int got;
+  while (length > 0)
+    {
+      if ((got = read (fd, bytes, length)) <= 0)
+	{
+	  if (got < 0 && errno == EINTR)
+	    continue;
+	  return 0;
+	}
+      bytes += got;
+      length -= got;
+    }
+  return 1;
+}
+
+static int
+writeFully (int fd, const void *buffer, int length)
+{
+  const char *bytes = buffer;
+  int put;
+  while (length > 0)
+    {
+      if ((put = write (fd, bytes, length)) <= 0)
+	{
+	  if (put < 0 && errno == EINTR)
+	    continue;
+	  return 0;
+	}
+      bytes += put;
+      length -= put;
+    }
+  return 1;
+}
+
+static void
+growBuffer (char **buffer, int *size, int length)
+{
+  if (length <= *size)
+    return;
+  *size = length;
+  if (!(*buffer = realloc (*buffer, *size)))
+    {
+      fprintf (stderr, "%s: out of memory\n", program_name);
+      exit (EXIT_FAILURE);
+    }
+}
+
+static int
+doRequest (Client * client, int kind, int mode, int textLength,
+	   int *outputLength)
+{
+/* Translate, back-translate or hyphenate the text into the output
+ * buffer of the client. The output buffer is made larger until the
+ * whole text is translated. */
+  int inlen, outlen, ok;
+  if (kind == DAEMON_HYPHENATE)
+    {
+      growBuffer (&client->output, &client->outputSize, textLength + 1);
+      *outputLength = textLength;
+      return lou_hyphenateUtf8 (client->table, client->text, textLength,
+				client->output, mode);
+    }
+  growBuffer (&client->output, &client->outputSize, 2 * textLength + 64);
+  for (;;)
+    {
+      inlen = textLength;
+      outlen = client->outputSize;
+      if (kind == DAEMON_TRANSLATE)
+	ok = lou_translateUtf8 (client->table, client->ctx, client->text,
+				&inlen, client->output, &outlen, NULL, NULL,
+				mode);
+      else
+	ok = lou_backTranslateUtf8 (client->table, client->ctx, client->text,
+				    &inlen, client->output, &outlen, NULL,
+				    NULL, mode);
+      if (!ok)
+	return 0;
+      if (inlen >= textLength)
+	break;
+      if (client->outputSize > DAEMON_MAXTEXT)
+	return 0;
+      growBuffer (&client->output, &client->outputSize,
+		  2 * client->outputSize);
+    }
+  *outputLength = outlen;
+  return 1;
+}
+
+static int
+putMetrics (Client * client, int *outputLength)
+{
+/* Write the counts of lou_getMetrics into the output buffer, one line 
+ * for each, for monitoring tools to read */
+  louMetrics metrics;
+  if (!lou_getMetrics (&metrics))
+    return 0;
+  growBuffer (&client->output, &client->outputSize, 1024);
+  *outputLength = snprintf (client->output, client->outputSize,
+			    "translations %lu\n"
+			    "translated_chars %lu\n"
+			    "back_translations %lu\n"
+			    "back_translated_cells %lu\n"
+			    "output_full %lu\n"
+			    "work_stopped %lu\n"
+			    "table_hits %lu\n"
+			    "table_misses %lu\n"
+			    "table_compiles %lu\n"
+			    "compile_seconds %.6f\n"
+			    "scratch_bytes %ld\n",
+			    metrics.translations, metrics.translatedChars,
+			    metrics.backTranslations,
+			    metrics.backTranslatedCells, metrics.outputFull,
+			    metrics.workStopped, metrics.tableHits,
+			    metrics.tableMisses, metrics.tableCompiles,
+			    metrics.compileSeconds, metrics.scratchBytes);
+  return 1;
+}
+
+static void
+serveClient (Client * client)
+{
+  unsigned char header[DAEMON_REQUEST_SIZE];
+  unsigned char response[DAEMON_RESPONSE_SIZE];
+  char tableList[DAEMON_MAXTABLELIST + 1];
+  unsigned long kind, mode, tableLength, textLength;
+  int ok, outputLength;
+  while (readFully (client->socket, header, DAEMON_REQUEST_SIZE))
+    {
+      kind = getBigEndian (header);
+      mode = getBigEndian (header + 4);
+      tableLength = getBigEndian (header + 8);
+      textLength = getBigEndian (header + 12);
+      if (kind > DAEMON_METRICS || tableLength > DAEMON_MAXTABLELIST
+	  || textLength > DAEMON_MAXTEXT)
+	break;
+      growBuffer (&client->text, &client->textSize, textLength + 1);
+      if (!readFully (client->socket, tableList, tableLength)
+	  || !readFully (client->socket, client->text, textLength))
+	break;
+      tableList[tableLength] = 0;
+      outputLength = 0;
+      if (kind == DAEMON_METRICS)
+	ok = putMetrics (client, &outputLength);
+      else
+	{
+	  /* Looking the table up is skipped while it stays the same */
+	  if (client->table == NULL
+	      || strcmp (tableList, client->tableList))
+	    {
+	      strcpy (client->tableList, tableList);
+	      if (!(client->table = lou_openTable (tableList))
+		  && !quiet_flag)
+		fprintf (stderr, "%s: %s cannot be compiled\n",
+			 program_name, tableList);
+	    }
+	  ok = client->table != NULL
+	    && doRequest (client, kind, mode, textLength, &outputLength);
+	}
+      if (!ok)
+	outputLength = 0;
+      putBigEndian (response, (unsigned long) ok);
+      putBigEndian (response + 4, (unsigned long) outputLength);
+      if (!writeFully (client->socket, response, DAEMON_RESPONSE_SIZE)
+	  || !writeFully (client->socket, client->output, outputLength))
+	break;
+    }
+  close (client->socket);
+  lou_freeContext (client->ctx);
+  free (client->text);
+  free (client->output);
+  free (client);
+}
+
+#ifdef HAVE_PTHREAD_H
+static void *
+clientThread (void *arg)
+{
+  serveClient (arg);
+  return NULL;
+}
+#endif
+
+static void
+print_help (void)
+{
+  printf ("\
+Usage: %s [OPTIONS] SOCKET [TABLE[,TABLE,...]...]\n", program_name);
+
+  fputs ("\
+Compile the tables given and serve requests to translate, back-translate\n\
+and hyphenate with them, or with other tables, on the Unix socket SOCKET,\n\
+so that the tables are compiled only once. lou_translate --socket is a\n\
+client of it.\n\n", stdout);
+
+  fputs ("\
+  -h, --help          display this help and exit\n\
+  -v, --version       display version information and exit\n\
+  -q, --quiet         do not report the tables compiled\n", stdout);
+  printf ("\n");
+  printf ("Report bugs to %s.\n", PACKAGE_BUGREPORT);
+
+#ifdef PACKAGE_PACKAGER_BUG_REPORTS
+  printf ("Report %s bugs to: %s\n", PACKAGE_PACKAGER, PACKAGE_PACKAGER_BUG_REPORTS);
+#endif
+#ifdef PACKAGE_URL
+  printf ("%s home page: <%s>\n", PACKAGE_NAME, PACKAGE_URL);
+#endif
+}
+
+int
+main (int argc, char **argv)
+{
+  struct sockaddr_un address;
+  struct stat status;
+  Client *client;
+  int optc, listener, k;
+#ifdef HAVE_PTHREAD_H
+  pthread_t thread;
+#endif
+
+  set_program_name (argv[0]);
+
+  while ((optc = getopt_long (argc, argv, "hvq", longopts, NULL)) != -1)
+    switch (optc)
+      {
+      /* --help and --version exit immediately, per GNU coding standards.  */
+      case 'v':
+        version_etc (stdout, program_name, PACKAGE_NAME, VERSION, AUTHORS, (char *) NULL);
+        exit (EXIT_SUCCESS);
+        break;
+      case 'h':
+        print_help ();
+        exit (EXIT_SUCCESS);
+        break;
+      case 'q':
+	quiet_flag = 1;
+	break;
+      default:
+	fprintf (stderr, "Try `%s --help' for more information.\n",
+		 program_name);
+	exit (EXIT_FAILURE);
+        break;
+      }
+
+  if (optind >= argc)
+    {
+      fprintf (stderr, "%s: no socket specified\n", program_name);
+      fprintf (stderr, "Try `%s --help' for more information.\n",
+               program_name);
+      exit (EXIT_FAILURE);
+    }
+  if (strlen (argv[optind]) >= sizeof (address.sun_path))
+    {
+      fprintf (stderr, "%s: the name of the socket is too long\n",
+	       program_name);
+      exit (EXIT_FAILURE);
+    }
+
+  /* The tables are compiled before any client can connect */
+  for (k = optind + 1; k < argc; k++)
+    {
+      if (!lou_openTable (argv[k]))
+	{
+	  fprintf (stderr, "%s: %s cannot be compiled\n", program_name,
+		   argv[k]);
+	  exit (EXIT_FAILURE);
+	}
+      if (!quiet_flag)
+	fprintf (stderr, "%s: compiled %s\n", program_name, argv[k]);
+    }
+
+  signal (SIGPIPE, SIG_IGN);
+  memset (&address, 0, sizeof (address));
+  address.sun_family = AF_UNIX;
+  strcpy (address.sun_path, argv[optind]);
+  /* A socket left by an earlier daemon is replaced, but nothing else */
+  if (lstat (address.sun_path, &status) == 0 && S_ISSOCK (status.st_mode))
+    unlink (address.sun_path);
+  if ((listener = socket (AF_UNIX, SOCK_STREAM, 0)) < 0
+      || bind (listener, (struct sockaddr *) &address, sizeof (address))
+      || listen (listener, 64))
+    {
+      fprintf (stderr, "%s: cannot listen on %s: %s\n", program_name,
+	       argv[optind], strerror (errno));
+      exit (EXIT_FAILURE);
+    }
+
+  /* Each client is served on a thread of its own with a context of its
+   * own, or in turn where there are no threads */
+  for (;;)
+    {
+      if (!(client = calloc (1, sizeof (Client))))
+	{
+	  fprintf (stderr, "%s: out of memory\n", program_name);
+	  exit (EXIT_FAILURE);
+	}
+      while ((client->socket = accept (listener, NULL, NULL)) < 0)
+	if (errno != EINTR && errno != ECONNABORTED)
+	  {
+	    fprintf (stderr, "%s: cannot accept a connection: %s\n",
+		     program_name, strerror (errno));
+	    exit (EXIT_FAILURE);
+	  }
+      client->ctx = lou_createContext ();
+#ifdef HAVE_PTHREAD_H
+      if (!pthread_create (&thread, NULL, clientThread, client))
+	{
+	  pthread_detach (thread);
+	  continue;
+	}
+#endif
+      serveClient (client);
+    }
+}
@@ -0,0 +1,227 @@
+/* liblouis Braille Translation and Back-Translation Library
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+   */
+
+# include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "louis.h"
+#include <getopt.h>
+#include "progname.h"
+#include "version-etc.h"
+
+static const struct option longopts[] =
+{
+  { "help", no_argument, NULL, 'h' },
+  { "version", no_argument, NULL, 'v' },
+  { "name", required_argument, NULL, 'n' },
+  { NULL, 0, NULL, 0 }
+};
+
+const char version_etc_copyright[] =
+  "Copyright %s %d ViewPlus Technologies, Inc. and JJB Software, Inc.";
+
+#define AUTHORS "John J. Boyer"
+
+#define BYTESPERLINE 12
+
+static const char *function_name = NULL;
+
+static void
+print_help (void)
+{
+  printf ("\
+Usage: %s [OPTIONS] TABLE[,TABLE,...] FILE\n", program_name);
+
+  fputs ("\
+Compile a table list and write its compiled table to the C source\n\
+FILE as constant data, with a function which registers it with\n\
+lou_registerCompiledTable. A program linked with FILE which calls\n\
+the function gets the table list from it without reading any files.\n\
+The function returns 1 on success and 0 if the program runs with\n\
+another version of liblouis than this one.\n\n", stdout);
+
+  fputs ("\
+  -h, --help          display this help and exit\n\
+  -v, --version       display version information and exit\n\
+  -n, --name=NAME     call the function NAME rather than\n\
+                        louRegister_ followed by the table list\n", stdout);
+
+  printf ("\n");
+  printf ("Report bugs to %s.\n", PACKAGE_BUGREPORT);
+
+#ifdef PACKAGE_PACKAGER_BUG_REPORTS
+  printf ("Report %s bugs to: %s\n", PACKAGE_PACKAGER, PACKAGE_PACKAGER_BUG_REPORTS);
+#endif
+#ifdef PACKAGE_URL
+  printf ("%s home page: <%s>\n", PACKAGE_NAME, PACKAGE_URL);
+#endif
+}
+
+static char *
+make_function_name (const char *tableList)
+{
+/* louRegister_ followed by the table list, with every character which
+* cannot be in a C identifier replaced by an underscore. */
+  static const char prefix[] = "louRegister_";
+  char *name;
+  int k;
+  if (!(name = malloc (sizeof (prefix) + strlen (tableList))))
+    return NULL;
+  strcpy (name, prefix);
+  for (k = 0; tableList[k]; k++)
+    name[sizeof (prefix) - 1 + k] =
+      isalnum ((unsigned char) tableList[k]) ? tableList[k] : '_';
+  name[sizeof (prefix) - 1 + k] = 0;
+  return name;
+}
+
+static void
+put_string (FILE *file, const char *string)
+{
+  putc ('"', file);
+  for (; *string; string++)
+    {
+      if (*string == '"' || *string == '\\')
+	putc ('\\', file);
+      putc (*string, file);
+    }
+  putc ('"', file);
+}
+
+static int
+write_source (const char *tableList, const char *imageFile,
+	      const char *sourceFile, const char *name)
+{
+  FILE *image;
+  FILE *source;
+  long size;
+  long k;
+  int c;
+  int ok;
+  if (!(image = fopen (imageFile, "rb")))
+    {
+      fprintf (stderr, "%s: cannot read %s\n", program_name, imageFile);
+      return 0;
+    }
+  if (fseek (image, 0, SEEK_END) != 0 || (size = ftell (image)) <= 0
+      || fseek (image, 0, SEEK_SET) != 0)
+    {
+      fprintf (stderr, "%s: cannot read %s\n", program_name, imageFile);
+      fclose (image);
+      return 0;
+    }
+  if (!(source = fopen (sourceFile, "w")))
+    {
+      fprintf (stderr, "%s: cannot create %s\n", program_name, sourceFile);
+      fclose (image);
+      return 0;
+    }
+  fprintf (source, "/* Made by lou_table2c from %s\n"
+	   "   with %s %s, which is the only version it works with.\n"
+	   "   Do not edit. */\n\n", tableList, PACKAGE_NAME, VERSION);
+  fprintf (source, "#include \"liblouis.h\"\n\n");
+  /* The union aligns the image as if it had been mapped */
+  fprintf (source, "static const union\n{\n"
+	   "  unsigned char bytes[%ld];\n"
+	   "  double alignDouble;\n"
+	   "  long alignLong;\n"
+	   "  void *alignPointer;\n"
+	   "} image = { {", size);
+  for (k = 0; k < size && (c = getc (image)) != EOF; k++)
+    fprintf (source, "%s0x%02x", k % BYTESPERLINE ? ", " :
+	     k ? ",\n  " : "\n  ", c);
+  fprintf (source, "\n} };\n\n");
+  fprintf (source, "int\n%s (void)\n{\n"
+	   "  return lou_registerCompiledTable\n    (", name);
+  put_string (source, tableList);
+  fprintf (source, ", image.bytes, sizeof (image.bytes));\n}\n");
+  ok = k == size && !ferror (image);
+  fclose (image);
+  if (fclose (source) != 0)
+    ok = 0;
+  if (!ok)
+    {
+      fprintf (stderr, "%s: cannot write %s\n", program_name, sourceFile);
+      remove (sourceFile);
+    }
+  return ok;
+}
+
+int
+main (int argc, char **argv)
+{
+  char *imageFile;
+  char *name;
+  int ok, optc;
+
+  set_program_name (argv[0]);
+
+  while ((optc = getopt_long (argc, argv, "hvn:", longopts, NULL)) != -1)
+    switch (optc)
+      {
+      /* --help and --version exit immediately, per GNU coding standards.  */
+      case 'v':
+        version_etc (stdout, program_name, PACKAGE_NAME, VERSION, AUTHORS, (char *) NULL);
+        exit (EXIT_SUCCESS);
+        break;
+      case 'h':
+        print_help ();
+        exit (EXIT_SUCCESS);
+        break;
+      case 'n':
+	function_name = optarg;
+        break;
+      default:
+	fprintf (stderr, "Try `%s --help' for more information.\n",
+		 program_name);
+	exit (EXIT_FAILURE);
+        break;
+      }
+
+  if (optind != argc - 2)
+    {
+      /* Print error message and exit.  */
+      fprintf (stderr, "%s: a table list and a file are needed\n",
+	       program_name);
+      fprintf (stderr, "Try `%s --help' for more information.\n",
+               program_name);
+      exit (EXIT_FAILURE);
+    }
+
+  /* Compile the table source, not an image saved earlier */
+  enableCompiledTables (0);
+  name = function_name ? strdup (function_name)
+    : make_function_name (argv[optind]);
+  if (!name
+      || !(imageFile = malloc (strlen (argv[optind + 1]) + sizeof (".lbt"))))
+    {
+      fprintf (stderr, "%s: out of memory\n", program_name);
+      exit (EXIT_FAILURE);
+    }
+  /* The image is written next to the source and read back */
+  strcpy (imageFile, argv[optind + 1]);
+  strcat (imageFile, ".lbt");
+  ok = lou_saveCompiledTable (argv[optind], imageFile)
+    && write_source (argv[optind], imageFile, argv[optind + 1], name);
+  remove (imageFile);
+  free (imageFile);
+  free (name);
+  lou_free ();
+  exit (ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
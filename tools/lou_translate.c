@@ -27,15 +27,34 @@
 #include <string.h>
 #include <stdlib.h>
 #include <getopt.h>
+#include <sys/time.h>
+#ifndef _WIN32
+#include <poll.h>
+#endif
+#ifdef HAVE_SYS_UN_H
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
 #include "liblouis.h"
 #include "louis.h"
+#include "daemon.h"
 #include "progname.h"
 #include "version-etc.h"
 
 #define BUFSIZE MAXSTRING - 4
+#define BLOCKSIZE 65536		/*bytes read and written at a time */
+#define QUEUEBYTES (16 * 1024 * 1024)	/*cap of the queue of the workers */
 
 static int forward_flag = 0;
 static int backward_flag = 0;
+static int file_flag = 0;
+static int jobs = 1;
+static int profile_flag = 0;
+static const char *profile_name = NULL;
+static const char *socket_name = NULL;
+static int metrics_flag = 0;
 
 static const struct option longopts[] =
 {
@@ -43,6 +62,13 @@ static const struct option longopts[] =
   { "version", no_argument, NULL, 'v' },
   { "forward", no_argument, NULL, 'f' },
   { "backward", no_argument, NULL, 'b' },
+  { "file", no_argument, NULL, 'F' },
+  { "jobs", required_argument, NULL, 'j' },
+  { "socket", required_argument, NULL, 's' },
+  { "profile", no_argument, NULL, 'p' },
+  { "write-profile", required_argument, NULL, 'w' },
+  { "rule-order", required_argument, NULL, 'o' },
+  { "metrics", no_argument, NULL, 'm' },
   { NULL, 0, NULL, 0 }
 };
 
@@ -51,6 +77,40 @@ const char version_etc_copyright[] =
 
 #define AUTHORS "John J. Boyer"
 
+#define PROFILED_RULES 25	/*rules shown by --profile */
+
+static void
+print_profile (const char *table_name)
+{
+/* Show on standard error the rules of the table tried most often */
+  const louTable *table = lou_openTable (table_name);
+  louRuleProfile profile;
+  int k;
+  if (!table || !lou_getRuleProfile (table, &profile))
+    {
+      fprintf (stderr, "%s: no rules of %s were profiled\n", program_name,
+	       table_name);
+      return;
+    }
+  fprintf (stderr, "%.3f seconds finding rules, %.3f testing them, "
+	   "%.3f inserting indicators\n", profile.selectTime,
+	   profile.testTime, profile.indicatorTime);
+  fprintf (stderr, "%10s %10s  %s\n", "tried", "applied", "rule");
+  for (k = 0; k < profile.numRules && k < PROFILED_RULES; k++)
+    {
+      const louRuleCount *rule = &profile.rules[k];
+      fprintf (stderr, "%10lu %10lu  %s:%d %s\n", rule->tried, rule->applied,
+	       rule->fileName ? rule->fileName : "?", rule->line,
+	       lou_getOpcodeName (rule->opcode));
+    }
+  if (profile.numRules > PROFILED_RULES)
+    fprintf (stderr, "and %d rules more\n", profile.numRules - PROFILED_RULES);
+  lou_freeRuleProfile (&profile);
+  if (profile_name && !lou_writeRuleProfile (table, profile_name))
+    fprintf (stderr, "%s: cannot write %s\n", program_name, profile_name);
+  lou_closeTable (table);
+}
+
 static void 
 translate_input (int forward_translation, char *table_name)
 {
@@ -86,27 +146,565 @@ translate_input (int forward_translation, char *table_name)
       outputbuf[k] = 0;
       printf ("%s\n", &outputbuf[1]);
     }
+  if (profile_flag)
+    print_profile (table_name);
   lou_free ();
 }
 
+/* File mode. The input is read in blocks as UTF-8 and each line is 
+ * translated whole however long it is, through a stream for forward 
+ * translation or by a queue of worker threads whose results are written 
+ * in the order of the lines. */
+
+typedef struct
+{
+  FILE *file;
+  unsigned char bytes[BLOCKSIZE];
+  int length;
+  int pos;
+} Input;
+
+typedef struct
+{
+  widechar *chars;
+  int length;
+  int size;
+} Line;
+
+typedef struct
+{
+  widechar *chars;		/*NULL until the line is translated */
+  int length;
+  int done;
+} Result;
+
+static long numLines = 0;
+static long charsIn = 0;
+static long charsOut = 0;
+static int failed = 0;
+
+static int
+fillInput (Input * input)
+{
+/* Read the next block when all of the last one has been decoded. 
+ * Returns 0 at the end of input. */
+  if (input->pos < input->length)
+    return 1;
+  input->length = fread (input->bytes, 1, BLOCKSIZE, input->file);
+  input->pos = 0;
+  if (input->length > 0)
+    return 1;
+  input->length = 0;
+  return 0;
+}
+
+static long
+nextChar (Input * input)
+{
+/* Decode the next character of UTF-8. Bytes which are not UTF-8 are 
+ * taken as U+FFFD. */
+  int lead, more;
+  long ch;
+  if (!fillInput (input))
+    return EOF;
+  lead = input->bytes[input->pos++];
+  if (lead < 0x80)
+    return lead;
+  if (lead >= 0xc2 && lead < 0xe0)
+    ch = lead & 0x1f, more = 1;
+  else if (lead >= 0xe0 && lead < 0xf0)
+    ch = lead & 0x0f, more = 2;
+  else if (lead >= 0xf0 && lead < 0xf5)
+    ch = lead & 0x07, more = 3;
+  else
+    return 0xfffd;
+  while (more--)
+    {
+      if (!fillInput (input) || (input->bytes[input->pos] & 0xc0) != 0x80)
+	return 0xfffd;
+      ch = (ch << 6) | (input->bytes[input->pos++] & 0x3f);
+    }
+  if ((ch >= 0xd800 && ch < 0xe000) || ch > 0x10ffff
+      || (lead >= 0xe0 && ch < 0x800) || (lead >= 0xf0 && ch < 0x10000))
+    return 0xfffd;
+  return ch;
+}
+
+static void
+growLine (Line * line)
+{
+  line->size = 2 * line->size + BUFSIZE;
+  if (!(line->chars = realloc (line->chars, line->size * sizeof (widechar))))
+    {
+      fprintf (stderr, "%s: out of memory\n", program_name);
+      exit (EXIT_FAILURE);
+    }
+}
+
+static void
+addChar (Line * line, long ch)
+{
+  if (line->length + 2 > line->size)
+    growLine (line);
+  if (sizeof (widechar) == 2 && ch > 0xffff)
+    {
+      ch -= 0x10000;
+      line->chars[line->length++] = 0xd800 | (ch >> 10);
+      ch = 0xdc00 | (ch & 0x3ff);
+    }
+  line->chars[line->length++] = ch;
+}
+
+static int
+readLine (Input * input, Line * line)
+{
+/* Read a line without its newline. Returns 0 at the end of input. */
+  long ch;
+  if (line->chars == NULL)
+    growLine (line);
+  line->length = 0;
+  while ((ch = nextChar (input)) != EOF && ch != '\n')
+    addChar (line, ch);
+  if (ch == EOF && line->length == 0)
+    return 0;
+  numLines++;
+  charsIn += line->length;
+  return 1;
+}
+
+static void
+writeChars (const widechar * chars, int length)
+{
+  long ch;
+  int k;
+  charsOut += length;
+  for (k = 0; k < length; k++)
+    {
+      ch = chars[k];
+      if (ch >= 0xd800 && ch < 0xdc00 && k + 1 < length
+	  && chars[k + 1] >= 0xdc00 && chars[k + 1] < 0xe000)
+	ch = 0x10000 + ((ch - 0xd800) << 10) + (chars[++k] - 0xdc00);
+      if (ch < 0x80)
+	putchar (ch);
+      else if (ch < 0x800)
+	{
+	  putchar (0xc0 | (ch >> 6));
+	  putchar (0x80 | (ch & 0x3f));
+	}
+      else if (ch < 0x10000)
+	{
+	  putchar (0xe0 | (ch >> 12));
+	  putchar (0x80 | ((ch >> 6) & 0x3f));
+	  putchar (0x80 | (ch & 0x3f));
+	}
+      else
+	{
+	  putchar (0xf0 | (ch >> 18));
+	  putchar (0x80 | ((ch >> 12) & 0x3f));
+	  putchar (0x80 | ((ch >> 6) & 0x3f));
+	  putchar (0x80 | (ch & 0x3f));
+	}
+    }
+}
+
+static void
+writePiece (const widechar * outbuf, int outlen, const int *inputPos,
+	    void *userData)
+{
+  writeChars (outbuf, outlen);
+}
+
+static void
+translateAlone (int forward_translation, const louTable * table,
+		Input * input)
+{
+  Line line = { NULL, 0, 0 };
+  louStream *stream = NULL;
+  widechar *outbuf;
+  int outlen;
+  if (forward_translation)
+    stream = lou_openStream (table, 0, writePiece, NULL);
+  while (readLine (input, &line))
+    {
+      if (stream != NULL)
+	{
+	  if (!lou_feedStream (stream, line.chars, line.length, NULL)
+	      || !lou_flushStream (stream))
+	    failed = 1;
+	}
+      else if (lou_backTranslateAlloc (table, NULL, line.chars, line.length,
+				       &outbuf, &outlen, NULL, NULL, NULL, 0,
+				       NULL, NULL))
+	{
+	  writeChars (outbuf, outlen);
+	  free (outbuf);
+	}
+      else
+	failed = 1;
+      putchar ('\n');
+    }
+  if (stream != NULL)
+    lou_closeStream (stream);
+  free (line.chars);
+}
+
+static void
+writeResults (Result * results, int size, long *written, long submitted)
+{
+  Result *result;
+  while (*written < submitted && (result = &results[*written % size])->done)
+    {
+      writeChars (result->chars, result->length);
+      putchar ('\n');
+      free (result->chars);
+      result->chars = NULL;
+      result->done = 0;
+      (*written)++;
+    }
+}
+
+static int
+takeCompletions (louQueue * queue, Result * results, int size, int wait)
+{
+/* Keep the results of the lines finished, waiting for one if wait. */
+  const louCompletion *completion;
+  Result *result;
+  int taken = 0;
+#ifndef _WIN32
+  struct pollfd fd;
+  fd.fd = lou_queueFd (queue);
+  fd.events = POLLIN;
+  if (poll (&fd, 1, wait ? -1 : 0) != 1)
+    return 0;
+#else
+  if (wait)
+    lou_waitQueue (queue);
+#endif
+  while ((completion = lou_nextCompletion (queue)) != NULL)
+    {
+      result = &results[(size_t) completion->user % size];
+      result->done = 1;
+      result->length = completion->outlen;
+      if (!(result->chars = malloc ((result->length + 1) *
+				    sizeof (widechar))))
+	{
+	  fprintf (stderr, "%s: out of memory\n", program_name);
+	  exit (EXIT_FAILURE);
+	}
+      memcpy (result->chars, completion->outbuf,
+	      result->length * sizeof (widechar));
+      if (completion->status != 1)
+	failed = 1;
+      taken++;
+    }
+  return taken;
+}
+
+static void
+translateInParallel (int forward_translation, const louTable * table,
+		     Input * input)
+{
+  Line line = { NULL, 0, 0 };
+  louQueue *queue = lou_createQueue (jobs, QUEUEBYTES, NULL, NULL);
+  Result *results = NULL;
+  int size = 0;
+  long submitted = 0, written = 0;
+  int kind = forward_translation ? louTranslateJob : louBackTranslateJob;
+  int k;
+  while (readLine (input, &line))
+    {
+      /* The results not yet written are kept in a ring indexed by the 
+       * number of the line */
+      if (submitted - written == size)
+	{
+	  Result *grown = calloc (2 * size + 1024, sizeof (Result));
+	  if (grown == NULL)
+	    {
+	      fprintf (stderr, "%s: out of memory\n", program_name);
+	      exit (EXIT_FAILURE);
+	    }
+	  for (k = 0; k < size; k++)
+	    grown[(written + k) % (2 * size + 1024)] =
+	      results[(written + k) % size];
+	  free (results);
+	  results = grown;
+	  size = 2 * size + 1024;
+	}
+      while (!lou_submit (queue, kind, table, line.chars, line.length, 0,
+			  (void *) (size_t) submitted, 0))
+	{
+	  takeCompletions (queue, results, size, 1);
+	  writeResults (results, size, &written, submitted);
+	}
+      submitted++;
+      takeCompletions (queue, results, size, 0);
+      writeResults (results, size, &written, submitted);
+    }
+  while (written < submitted)
+    {
+      takeCompletions (queue, results, size, 1);
+      writeResults (results, size, &written, submitted);
+    }
+  lou_freeQueue (queue);
+  free (results);
+  free (line.chars);
+}
+
+#ifdef HAVE_SYS_UN_H
+/* Client mode. Each line is sent to lou_daemon, which has the table 
+ * compiled already, and its translation is printed as it comes back. */
+
+static int
+connectToDaemon (void)
+{
+  struct sockaddr_un address;
+  int fd;
+  memset (&address, 0, sizeof (address));
+  address.sun_family = AF_UNIX;
+  if (strlen (socket_name) >= sizeof (address.sun_path))
+    {
+      fprintf (stderr, "%s: the name of the socket is too long\n",
+	       program_name);
+      exit (EXIT_FAILURE);
+    }
+  strcpy (address.sun_path, socket_name);
+  if ((fd = socket (AF_UNIX, SOCK_STREAM, 0)) < 0
+      || connect (fd, (struct sockaddr *) &address, sizeof (address)))
+    {
+      fprintf (stderr, "%s: cannot connect to %s: %s\n", program_name,
+	       socket_name, strerror (errno));
+      exit (EXIT_FAILURE);
+    }
+  return fd;
+}
+
+static void
+transfer (int fd, void *buffer, int length, int sending)
+{
+  char *bytes = buffer;
+  int done;
+  while (length > 0)
+    {
+      done = sending ? write (fd, bytes, length) : read (fd, bytes, length);
+      if (done <= 0)
+	{
+	  if (done < 0 && errno == EINTR)
+	    continue;
+	  fprintf (stderr, "%s: the connection to %s was lost\n",
+		   program_name, socket_name);
+	  exit (EXIT_FAILURE);
+	}
+      bytes += done;
+      length -= done;
+    }
+}
+
+static void
+translateRemotely (int forward_translation, const char *table_name, int fd,
+		   Input * input)
+{
+  unsigned char header[DAEMON_REQUEST_SIZE];
+  char *text = NULL, *output = NULL;
+  int textSize = 0, outputSize = 0;
+  unsigned long length, tableLength = strlen (table_name);
+  int k, ch = 0;
+  for (;;)
+    {
+      for (length = 0; fillInput (input)
+	   && (ch = input->bytes[input->pos++]) != '\n'; length++)
+	{
+	  if (length == textSize)
+	    {
+	      textSize = 2 * textSize + BLOCKSIZE;
+	      if (!(text = realloc (text, textSize)))
+		{
+		  fprintf (stderr, "%s: out of memory\n", program_name);
+		  exit (EXIT_FAILURE);
+		}
+	    }
+	  text[length] = ch;
+	  if ((ch & 0xc0) != 0x80)
+	    charsIn++;
+	}
+      if (length == 0 && ch != '\n')
+	break;
+      ch = 0;
+      numLines++;
+      putBigEndian (header, (unsigned long) (forward_translation ?
+					     DAEMON_TRANSLATE :
+					     DAEMON_BACKTRANSLATE));
+      putBigEndian (header + 4, 0UL);
+      putBigEndian (header + 8, tableLength);
+      putBigEndian (header + 12, length);
+      transfer (fd, header, DAEMON_REQUEST_SIZE, 1);
+      transfer (fd, (char *) table_name, tableLength, 1);
+      transfer (fd, text, length, 1);
+      transfer (fd, header, DAEMON_RESPONSE_SIZE, 0);
+      if (!getBigEndian (header))
+	failed = 1;
+      length = getBigEndian (header + 4);
+      if (length > outputSize)
+	{
+	  outputSize = length;
+	  if (!(output = realloc (output, outputSize)))
+	    {
+	      fprintf (stderr, "%s: out of memory\n", program_name);
+	      exit (EXIT_FAILURE);
+	    }
+	}
+      transfer (fd, output, length, 0);
+      fwrite (output, 1, length, stdout);
+      putchar ('\n');
+      for (k = 0; k < length; k++)
+	if ((output[k] & 0xc0) != 0x80)
+	  charsOut++;
+    }
+  free (text);
+  free (output);
+}
+
+static void
+printRemoteMetrics (void)
+{
+/* Ask lou_daemon for its metrics and print them */
+  unsigned char header[DAEMON_REQUEST_SIZE];
+  char *output;
+  unsigned long length;
+  int fd = connectToDaemon ();
+  putBigEndian (header, (unsigned long) DAEMON_METRICS);
+  putBigEndian (header + 4, 0UL);
+  putBigEndian (header + 8, 0UL);
+  putBigEndian (header + 12, 0UL);
+  transfer (fd, header, DAEMON_REQUEST_SIZE, 1);
+  transfer (fd, header, DAEMON_RESPONSE_SIZE, 0);
+  length = getBigEndian (header + 4);
+  if (!getBigEndian (header) || !(output = malloc (length + 1)))
+    {
+      fprintf (stderr, "%s: %s sent no metrics\n", program_name,
+	       socket_name);
+      exit (EXIT_FAILURE);
+    }
+  transfer (fd, output, length, 0);
+  fwrite (output, 1, length, stdout);
+  free (output);
+  close (fd);
+}
+#endif
+
+static void
+translate_files (int forward_translation, char *table_name, char **files,
+		 int numFiles)
+{
+  static Input input;
+  const louTable *table = NULL;
+  struct timeval start, end;
+  double seconds;
+  int k, fd = -1;
+  gettimeofday (&start, NULL);
+  if (socket_name != NULL)
+    {
+#ifdef HAVE_SYS_UN_H
+      fd = connectToDaemon ();
+#else
+      fprintf (stderr, "%s: there are no Unix sockets here\n",
+	       program_name);
+      exit (EXIT_FAILURE);
+#endif
+    }
+  else if (!(table = lou_openTable (table_name)))
+    {
+      fprintf (stderr, "%s: %s cannot be compiled\n", program_name,
+	       table_name);
+      exit (EXIT_FAILURE);
+    }
+  setvbuf (stdout, NULL, _IOFBF, BLOCKSIZE);
+  for (k = 0; k < (numFiles ? numFiles : 1); k++)
+    {
+      if (!numFiles || !strcmp (files[k], "-"))
+	input.file = stdin;
+      else if (!(input.file = fopen (files[k], "rb")))
+	{
+	  fprintf (stderr, "%s: cannot open %s\n", program_name, files[k]);
+	  exit (EXIT_FAILURE);
+	}
+      input.length = input.pos = 0;
+      if (fd >= 0)
+	{
+#ifdef HAVE_SYS_UN_H
+	  translateRemotely (forward_translation, table_name, fd, &input);
+#endif
+	}
+      else if (jobs == 1)
+	translateAlone (forward_translation, table, &input);
+      else
+	translateInParallel (forward_translation, table, &input);
+      if (input.file != stdin)
+	fclose (input.file);
+    }
+  fflush (stdout);
+#ifdef HAVE_SYS_UN_H
+  if (fd >= 0)
+    close (fd);
+#endif
+  gettimeofday (&end, NULL);
+  seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  fprintf (stderr, "%ld lines, %ld characters into %ld in %.3f seconds",
+	   numLines, charsIn, charsOut, seconds);
+  if (seconds > 0)
+    fprintf (stderr, ", %.0f characters per second", charsIn / seconds);
+  fprintf (stderr, "\n");
+  if (failed)
+    fprintf (stderr, "%s: some lines could not be translated\n",
+	     program_name);
+  if (profile_flag)
+    print_profile (table_name);
+  lou_free ();
+  if (failed)
+    exit (EXIT_FAILURE);
+}
+
 static void
 print_help (void)
 {
   printf ("\
-Usage: %s [OPTIONS] TABLE[,TABLE,...]\n", program_name);
+Usage: %s [OPTIONS] TABLE[,TABLE,...]\n\
+  or:  %s -F [OPTIONS] TABLE[,TABLE,...] [FILE...]\n\
+  or:  %s --socket=SOCKET [OPTIONS] TABLE[,TABLE,...] [FILE...]\n",
+	  program_name, program_name, program_name);
   
   fputs ("\
 Translate whatever is on standard input and print it on standard\n\
 output. It is intended for large-scale testing of the accuracy of\n\
 Braille translation and back-translation.\n\n", stdout);
 
+  fputs ("\
+With -F, translate the UTF-8 text of the files, or of standard input,\n\
+line by line however long the lines are, and print a summary of the\n\
+throughput on standard error.\n\n", stdout);
+
   fputs ("\
   -h, --help          display this help and exit\n\
   -v, --version       display version information and exit\n\
   -f, --forward       forward translation using the given table\n\
   -b, --backward      backward translation using the given table\n\
                       If neither -f nor -b are specified forward translation\n\
-                      is assumed\n", stdout);
+                      is assumed\n\
+  -F, --file          translate whole files as UTF-8\n\
+  -j, --jobs=N        with -F, translate with N worker threads, or one\n\
+                      for each processor if N is 0\n\
+  -s, --socket=SOCKET as -F, but have lou_daemon listening on SOCKET\n\
+                      translate\n\
+  -p, --profile       count how often each rule is tried and applied in\n\
+                      forward translation and show the rules tried most\n\
+                      often on standard error\n\
+  -w, --write-profile=FILE\n\
+                      as -p, and write the counts to FILE\n\
+  -o, --rule-order=FILE\n\
+                      compile the table with its rules ordered by the\n\
+                      counts in FILE written by --write-profile\n\
+  -m, --metrics       with --socket, print the metrics of lou_daemon,\n\
+                      such as the calls and characters it translated,\n\
+                      and exit; no table is needed\n", stdout);
   printf ("\n");
   printf ("Report bugs to %s.\n", PACKAGE_BUGREPORT);
 
@@ -125,7 +723,7 @@ main (int argc, char **argv)
   
   set_program_name (argv[0]);
 
-  while ((optc = getopt_long (argc, argv, "hvfb", longopts, NULL)) != -1)
+  while ((optc = getopt_long (argc, argv, "hvfbFj:s:pw:o:m", longopts, NULL)) != -1)
     switch (optc)
       {
       /* --help and --version exit immediately, per GNU coding standards.  */
@@ -143,6 +741,39 @@ main (int argc, char **argv)
       case 'b':
 	backward_flag = 1;
         break;
+      case 'F':
+	file_flag = 1;
+        break;
+      case 's':
+	socket_name = optarg;
+	file_flag = 1;
+        break;
+      case 'p':
+	profile_flag = 1;
+	break;
+      case 'm':
+	metrics_flag = 1;
+	break;
+      case 'w':
+	profile_flag = 1;
+	profile_name = optarg;
+	break;
+      case 'o':
+	if (!lou_setRuleOrderProfile (optarg))
+	  {
+	    fprintf (stderr, "%s: cannot read %s\n", program_name, optarg);
+	    exit (EXIT_FAILURE);
+	  }
+	break;
+      case 'j':
+	jobs = atoi (optarg);
+	if (jobs < 0)
+	  {
+	    fprintf (stderr, "%s: invalid number of jobs: %s\n",
+		     program_name, optarg);
+	    exit (EXIT_FAILURE);
+	  }
+        break;
       default:
 	fprintf (stderr, "Try `%s --help' for more information.\n",
 		 program_name);
@@ -159,6 +790,39 @@ main (int argc, char **argv)
       exit (EXIT_FAILURE);
     }
 
+  if (metrics_flag)
+    {
+      if (socket_name == NULL)
+	{
+	  fprintf (stderr, "%s: --metrics needs --socket\n", program_name);
+	  exit (EXIT_FAILURE);
+	}
+#ifdef HAVE_SYS_UN_H
+      printRemoteMetrics ();
+      exit (EXIT_SUCCESS);
+#else
+      fprintf (stderr, "%s: there are no Unix sockets here\n",
+	       program_name);
+      exit (EXIT_FAILURE);
+#endif
+    }
+
+  if (profile_flag && (backward_flag || socket_name != NULL))
+    {
+      fprintf (stderr, "%s: only forward translation here can be profiled\n",
+	       program_name);
+      exit (EXIT_FAILURE);
+    }
+  if (profile_flag)
+    lou_setRuleProfiling (1);
+
+  if (file_flag && optind < argc)
+    {
+      translate_files (!backward_flag, argv[optind], &argv[optind + 1],
+		       argc - optind - 1);
+      exit (EXIT_SUCCESS);
+    }
+
   if (optind != argc - 1)
     {
       /* Print error message and exit.  */
@@ -34,6 +34,10 @@ extern "C"
 #define UNICODEBITS 16
 #endif
 
+#ifndef OFFSETBITS
+#define OFFSETBITS 32
+#endif
+
 #define widechar WIDECHAR_TYPE
 #define formtype unsigned char
 